@@ -40,7 +40,11 @@ def run_benchmark(device, filename):
             ser.read(1) 
           time.sleep(0.1)
 
-        command = "echo(0);\nvar ___start = getTime();{"+benchmark+"}\nvar ___end = getTime();print('<<'+'<<<',JSON.stringify({time:___end-___start,mem:process.memory().usage}),'>>>'+'>>');\necho(1);\n"
+        # E.bench runs the benchmark on-device with overhead subtracted and
+        # reports min/median (cycle-accurate on Cortex-M), so the numbers
+        # don't include serial round-trip noise. Older firmware without it
+        # falls back to the old single getTime() measurement.
+        command = "echo(0);\nfunction ___bench() {"+benchmark+"}\nvar ___res;\nif (E.bench) { var ___r = E.bench(___bench,{n:5}); ___res={time:___r.median,min:___r.min,cycles:___r.cycles,mem:process.memory().usage}; } else { var ___start = getTime();___bench();var ___end = getTime();___res={time:___end-___start,mem:process.memory().usage}; }\nprint('<<'+'<<<',JSON.stringify(___res),'>>>'+'>>');\necho(1);\n"
         
 	#ser.write(command)
         for c in command:
@@ -156,6 +156,9 @@ void jsble_set_services(JsVar *data);
 /// Disconnect from the given connection
 uint32_t jsble_disconnect(uint16_t conn_handle);
 
+/// Set the connection interval (in ms) preferred (and, if connected as a peripheral, requested) for connections
+uint32_t jsble_set_periph_connection_interval(JsVarFloat min, JsVarFloat max);
+
 /// For BLE HID, send an input report to the receiver. Must be <= HID_KEYS_MAX_LEN
 void jsble_send_hid_input_report(uint8_t *data, int length);
 
@@ -1607,6 +1607,48 @@ void jswrap_nrf_bluetooth_setLowPowerConnection(bool lowPower) {
   }
 }
 
+/*JSON{
+    "type" : "staticmethod",
+    "class" : "NRF",
+    "name" : "setConnectionInterval",
+    "generate" : "jswrap_nrf_setConnectionInterval",
+    "params" : [
+      ["interval","JsVar","The connection interval to use in milliseconds (between 7.5 and 4000), or a `{minInterval,maxInterval}` object"]
+    ]
+}
+This sets the preferred connection interval - the time between transfers
+over an active connection. A short interval (eg 7.5ms) gives the highest
+transfer rate at the cost of power, a long one (eg 500ms) drastically cuts
+power usage while connected but makes transfers very slow.
+
+Giving a `{minInterval,maxInterval}` range lets the device on the other
+end pick something suitable within it.
+
+Unlike `NRF.setLowPowerConnection` this takes effect immediately - if
+something is currently connected to us we ask it to renegotiate, and the
+values are also used for any new connection.
+*/
+void jswrap_nrf_setConnectionInterval(JsVar *interval) {
+  JsVarFloat min, max;
+  if (jsvIsNumeric(interval)) {
+    min = max = jsvGetFloat(interval);
+  } else if (jsvIsObject(interval)) {
+    min = jsvGetFloatAndUnLock(jsvObjectGetChild(interval, "minInterval", 0));
+    max = jsvGetFloatAndUnLock(jsvObjectGetChild(interval, "maxInterval", 0));
+  } else {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a number or {minInterval,maxInterval}, got %t", interval);
+    return;
+  }
+  if (!(min>=7.5 && max>=min && max<=4000)) {
+    jsExceptionHere(JSET_ERROR, "Intervals must be 7.5..4000ms, min <= max");
+    return;
+  }
+#ifdef NRF5X
+  uint32_t err_code = jsble_set_periph_connection_interval(min, max);
+  jsble_check_error(err_code);
+#endif
+}
+
 
 /*JSON{
     "type" : "staticmethod",
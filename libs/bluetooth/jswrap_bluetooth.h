@@ -77,6 +77,7 @@ void jswrap_nrf_bluetooth_findDevices(JsVar *callback, JsVar *timeout);
 void jswrap_nrf_bluetooth_setRSSIHandler(JsVar *callback);
 void jswrap_nrf_bluetooth_setTxPower(JsVarInt pwr);
 void jswrap_nrf_bluetooth_setLowPowerConnection(bool lowPower);
+void jswrap_nrf_setConnectionInterval(JsVar *interval);
 
 void jswrap_nrf_nfcURL(JsVar *url);
 void jswrap_nrf_nfcRaw(JsVar *payload);
@@ -0,0 +1,243 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Streaming heatshrink compression for JavaScript - E.compress/E.decompress
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_compression.h"
+#include "jsparse.h"
+#include "jsinteractive.h"
+#include "heatshrink_encoder.h"
+#include "heatshrink_decoder.h"
+
+/*JSON{
+  "type" : "class",
+  "class" : "Compressor",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+A streaming compressor or decompressor, as returned by `E.compress()` or
+`E.decompress()` when they're called without data. Feed it chunks with
+`write` (which returns whatever output those chunks produced) and call
+`end` to flush out the last of the output:
+
+```
+var c = E.compress();
+var out = c.write(chunk1);
+out += c.write(chunk2);
+out += c.end();
+```
+
+The codec's whole state lives inside the object, so neither the full
+input nor the full output ever has to be in RAM at once - batches can be
+compressed chunk by chunk as they're sent over a radio or serial link.
+ */
+
+// the codec state is kept in a flat string child between calls, like the
+// context in hashlib's HASH objects
+#define COMPRESSOR_CONTEXT_NAME "context"
+#define COMPRESSOR_DECOMPRESS_NAME "decompress"
+
+/// Feed one chunk of a JS string/array through the codec, appending any output to 'out'
+static void compressorWrite(void *ctx, bool decompress, JsVar *data, JsVar *out) {
+  unsigned char inBuf[64];
+  unsigned char outBuf[128];
+  size_t i, len = jsvGetStringLength(data);
+  for (i=0;i<len;i+=sizeof(inBuf)) {
+    size_t chunkLen = jsvGetStringChars(data, i, (char*)inBuf, sizeof(inBuf));
+    size_t sunk = 0;
+    while (sunk < chunkLen) {
+      size_t count = 0;
+      if (decompress)
+        heatshrink_decoder_sink((heatshrink_decoder*)ctx, &inBuf[sunk], chunkLen-sunk, &count);
+      else
+        heatshrink_encoder_sink((heatshrink_encoder*)ctx, &inBuf[sunk], chunkLen-sunk, &count);
+      sunk += count;
+      int pres;
+      do {
+        if (decompress)
+          pres = heatshrink_decoder_poll((heatshrink_decoder*)ctx, outBuf, sizeof(outBuf), &count);
+        else
+          pres = heatshrink_encoder_poll((heatshrink_encoder*)ctx, outBuf, sizeof(outBuf), &count);
+        jsvAppendStringBuf(out, (char*)outBuf, count);
+      } while (pres == HSER_POLL_MORE);
+    }
+  }
+}
+
+/// Tell the codec there's no more input, appending whatever is left to 'out'
+static void compressorEnd(void *ctx, bool decompress, JsVar *out) {
+  unsigned char outBuf[128];
+  int fres;
+  do {
+    if (decompress)
+      fres = heatshrink_decoder_finish((heatshrink_decoder*)ctx);
+    else
+      fres = heatshrink_encoder_finish((heatshrink_encoder*)ctx);
+    size_t count = 0;
+    int pres;
+    do {
+      if (decompress)
+        pres = heatshrink_decoder_poll((heatshrink_decoder*)ctx, outBuf, sizeof(outBuf), &count);
+      else
+        pres = heatshrink_encoder_poll((heatshrink_encoder*)ctx, outBuf, sizeof(outBuf), &count);
+      jsvAppendStringBuf(out, (char*)outBuf, count);
+    } while (pres == HSER_POLL_MORE);
+  } while (fres == HSER_FINISH_MORE);
+}
+
+/// Make a new Compressor object with a freshly reset codec inside it
+static JsVar *compressorNew(bool decompress) {
+  JsVar *obj = jspNewObject(0, "Compressor");
+  if (!obj) return 0; // out of memory
+  size_t ctxSize = decompress ? sizeof(heatshrink_decoder) : sizeof(heatshrink_encoder);
+  JsVar *ctx = jsvNewFlatStringOfLength((unsigned int)ctxSize);
+  if (!ctx) {
+    jsvUnLock(obj);
+    return 0;
+  }
+  if (decompress)
+    heatshrink_decoder_reset((heatshrink_decoder*)jsvGetFlatStringPointer(ctx));
+  else
+    heatshrink_encoder_reset((heatshrink_encoder*)jsvGetFlatStringPointer(ctx));
+  jsvObjectSetChildAndUnLock(obj, COMPRESSOR_CONTEXT_NAME, ctx);
+  jsvObjectSetChildAndUnLock(obj, COMPRESSOR_DECOMPRESS_NAME, jsvNewFromBool(decompress));
+  return obj;
+}
+
+/// Get the codec state out of a Compressor object - 0 (with exception) if there isn't one
+static void *compressorGetContext(JsVar *parent, bool *decompress, JsVar **ctxOut) {
+  JsVar *ctx = jsvObjectGetChild(parent, COMPRESSOR_CONTEXT_NAME, 0);
+  if (!ctx || !jsvIsFlatString(ctx)) {
+    jsExceptionHere(JSET_ERROR, "Not a valid Compressor object");
+    jsvUnLock(ctx);
+    return 0;
+  }
+  *decompress = jsvGetBoolAndUnLock(jsvObjectGetChild(parent, COMPRESSOR_DECOMPRESS_NAME, 0));
+  *ctxOut = ctx;
+  return jsvGetFlatStringPointer(ctx);
+}
+
+static JsVar *compressorOneShot(bool decompress, JsVar *data) {
+  if (!jsvIsString(data)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a string, got %t", data);
+    return 0;
+  }
+  JsVar *out = jsvNewFromEmptyString();
+  if (!out) return 0; // out of memory
+  if (decompress) {
+    heatshrink_decoder hsd;
+    heatshrink_decoder_reset(&hsd);
+    compressorWrite(&hsd, true, data, out);
+    compressorEnd(&hsd, true, out);
+  } else {
+    heatshrink_encoder hse;
+    heatshrink_encoder_reset(&hse);
+    compressorWrite(&hse, false, data, out);
+    compressorEnd(&hse, false, out);
+  }
+  return out;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "compress",
+  "generate" : "jswrap_compression_compress",
+  "params" : [
+    ["data","JsVar","[optional] The String of data to compress"]
+  ],
+  "return" : ["JsVar","The compressed data as a String, or a `Compressor` if no data was given"]
+}
+Compress data using [heatshrink](https://github.com/atomicobject/heatshrink)
+(the same algorithm `save()` uses). With an argument the whole buffer is
+compressed in one go and the result returned. With no argument a streaming
+`Compressor` object is returned instead, which can be fed a chunk at a time
+so only one chunk of input and output need fit in RAM.
+ */
+JsVar *jswrap_compression_compress(JsVar *data) {
+  if (jsvIsUndefined(data)) return compressorNew(false);
+  return compressorOneShot(false, data);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "decompress",
+  "generate" : "jswrap_compression_decompress",
+  "params" : [
+    ["data","JsVar","[optional] The String of data to decompress"]
+  ],
+  "return" : ["JsVar","The decompressed data as a String, or a `Compressor` if no data was given"]
+}
+Decompress data that was compressed with `E.compress`. With no argument a
+streaming `Compressor` object is returned, as for `E.compress`.
+ */
+JsVar *jswrap_compression_decompress(JsVar *data) {
+  if (jsvIsUndefined(data)) return compressorNew(true);
+  return compressorOneShot(true, data);
+}
+
+/*JSON{
+  "type" : "method",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Compressor",
+  "name" : "write",
+  "generate" : "jswrap_compression_stream_write",
+  "params" : [
+    ["data","JsVar","The chunk of data to feed in - a String"]
+  ],
+  "return" : ["JsVar","A String of whatever output this chunk produced (often empty)"]
+}
+Feed a chunk of data into the codec, and get back whatever output it
+produced. The codec buffers internally, so a given write may return an
+empty string - call `end` to flush the remainder out.
+ */
+JsVar *jswrap_compression_stream_write(JsVar *parent, JsVar *data) {
+  bool decompress;
+  JsVar *ctxVar;
+  void *ctx = compressorGetContext(parent, &decompress, &ctxVar);
+  if (!ctx) return 0;
+  JsVar *out = jsvNewFromEmptyString();
+  if (out) {
+    if (jsvIsString(data))
+      compressorWrite(ctx, decompress, data, out);
+    else
+      jsExceptionHere(JSET_TYPEERROR, "Expecting a string, got %t", data);
+  }
+  jsvUnLock(ctxVar);
+  return out;
+}
+
+/*JSON{
+  "type" : "method",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Compressor",
+  "name" : "end",
+  "generate" : "jswrap_compression_stream_end",
+  "return" : ["JsVar","A String of any remaining output"]
+}
+Tell the codec there is no more input, and get the rest of the output.
+After calling this the Compressor can't be written to any more.
+ */
+JsVar *jswrap_compression_stream_end(JsVar *parent) {
+  bool decompress;
+  JsVar *ctxVar;
+  void *ctx = compressorGetContext(parent, &decompress, &ctxVar);
+  if (!ctx) return 0;
+  JsVar *out = jsvNewFromEmptyString();
+  if (out)
+    compressorEnd(ctx, decompress, out);
+  jsvUnLock(ctxVar);
+  return out;
+}
@@ -0,0 +1,19 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Streaming heatshrink compression for JavaScript
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_compression_compress(JsVar *data);
+JsVar *jswrap_compression_decompress(JsVar *data);
+JsVar *jswrap_compression_stream_write(JsVar *parent, JsVar *data);
+JsVar *jswrap_compression_stream_end(JsVar *parent);
@@ -15,7 +15,12 @@
  */
 #include "jsvar.h"
 #include "jsvariterator.h"
+#include "jsparse.h"
+#include "jshardware.h"
 #include "jswrap_crypto.h"
+#ifdef USE_TLS
+#include "jswrap_promise.h"
+#endif
 
 #ifdef USE_AES
 #include "mbedtls/include/mbedtls/aes.h"
@@ -118,11 +123,11 @@ CryptoMode jswrap_crypto_getMode(JsVar *mode) {
 }
 
 mbedtls_md_type_t jswrap_crypto_getHasher(JsVar *hasher) {
-  if (jsvIsStringEqual(hasher, "SHA1")) return MBEDTLS_MD_SHA1;
-  if (jsvIsStringEqual(hasher, "SHA224")) return MBEDTLS_MD_SHA224;
-  if (jsvIsStringEqual(hasher, "SHA256")) return MBEDTLS_MD_SHA256;
-  if (jsvIsStringEqual(hasher, "SHA384")) return MBEDTLS_MD_SHA384;
-  if (jsvIsStringEqual(hasher, "SHA512")) return MBEDTLS_MD_SHA512;
+  if (jsvIsStringEqual(hasher, "SHA1") || jsvIsStringEqual(hasher, "sha1")) return MBEDTLS_MD_SHA1;
+  if (jsvIsStringEqual(hasher, "SHA224") || jsvIsStringEqual(hasher, "sha224")) return MBEDTLS_MD_SHA224;
+  if (jsvIsStringEqual(hasher, "SHA256") || jsvIsStringEqual(hasher, "sha256")) return MBEDTLS_MD_SHA256;
+  if (jsvIsStringEqual(hasher, "SHA384") || jsvIsStringEqual(hasher, "sha384")) return MBEDTLS_MD_SHA384;
+  if (jsvIsStringEqual(hasher, "SHA512") || jsvIsStringEqual(hasher, "sha512")) return MBEDTLS_MD_SHA512;
   jsExceptionHere(JSET_ERROR, "Unknown Hasher %q", hasher);
   return MBEDTLS_MD_NONE;
 }
@@ -141,6 +146,10 @@ JsVar *jswrap_crypto_SHAx(JsVar *message, int shaNum) {
     return 0;
   }
 
+#ifdef JSH_HAS_CRYPTO
+  if (jshSHA(shaNum, (unsigned char *)msgPtr, msgLen, (unsigned char *)outPtr))
+    return outArr;
+#endif
   if (shaNum==1) mbedtls_sha1((unsigned char *)msgPtr, msgLen, (unsigned char *)outPtr);
   else if (shaNum==224) mbedtls_sha256((unsigned char *)msgPtr, msgLen, (unsigned char *)outPtr, true/*224*/);
   else if (shaNum==256) mbedtls_sha256((unsigned char *)msgPtr, msgLen, (unsigned char *)outPtr, false/*256*/);
@@ -225,6 +234,283 @@ Performs a SHA384 hash and returns the result as a 48 byte ArrayBuffer
 Performs a SHA512 hash and returns the result as a 64 byte ArrayBuffer
 */
 
+// ---------------------------------------------------------------------------
+//                                                            STREAMING HASHES
+
+#define HASH_BLOCK_MAX 128 ///< biggest hash block size (SHA384/512) - HMAC pads keys to the block size
+
+/** Everything a Hash object needs between calls. This lives in a flat string
+ * child of the object, so to the interpreter it's just bytes - the mbedTLS
+ * SHA contexts contain no pointers, so the state is safe to copy around. */
+typedef struct {
+  mbedtls_md_type_t type;
+  bool hmac; ///< if set, 'opad' is valid and digest() runs the HMAC outer pass
+  unsigned char opad[HASH_BLOCK_MAX]; ///< HMAC outer padding, already XORed with the key
+  union {
+    mbedtls_sha1_context sha1;
+    mbedtls_sha256_context sha256;
+    mbedtls_sha512_context sha512;
+  } ctx;
+} JsCryptoHash;
+
+static int jswrap_crypto_hashSize(mbedtls_md_type_t type) {
+  switch (type) {
+  case MBEDTLS_MD_SHA1: return 20;
+  case MBEDTLS_MD_SHA224: return 28;
+  case MBEDTLS_MD_SHA256: return 32;
+  case MBEDTLS_MD_SHA384: return 48;
+  case MBEDTLS_MD_SHA512: return 64;
+  default: return 0;
+  }
+}
+
+static int jswrap_crypto_hashBlockSize(mbedtls_md_type_t type) {
+  return (type==MBEDTLS_MD_SHA384 || type==MBEDTLS_MD_SHA512) ? 128 : 64;
+}
+
+static void jswrap_crypto_hashStart(JsCryptoHash *hash) {
+  switch (hash->type) {
+  case MBEDTLS_MD_SHA1: mbedtls_sha1_init(&hash->ctx.sha1); mbedtls_sha1_starts(&hash->ctx.sha1); break;
+  case MBEDTLS_MD_SHA224: mbedtls_sha256_init(&hash->ctx.sha256); mbedtls_sha256_starts(&hash->ctx.sha256, true); break;
+  case MBEDTLS_MD_SHA256: mbedtls_sha256_init(&hash->ctx.sha256); mbedtls_sha256_starts(&hash->ctx.sha256, false); break;
+  case MBEDTLS_MD_SHA384: mbedtls_sha512_init(&hash->ctx.sha512); mbedtls_sha512_starts(&hash->ctx.sha512, true); break;
+  case MBEDTLS_MD_SHA512: mbedtls_sha512_init(&hash->ctx.sha512); mbedtls_sha512_starts(&hash->ctx.sha512, false); break;
+  default: break;
+  }
+}
+
+static void jswrap_crypto_hashUpdate(JsCryptoHash *hash, const unsigned char *data, size_t len) {
+  switch (hash->type) {
+  case MBEDTLS_MD_SHA1: mbedtls_sha1_update(&hash->ctx.sha1, data, len); break;
+  case MBEDTLS_MD_SHA224:
+  case MBEDTLS_MD_SHA256: mbedtls_sha256_update(&hash->ctx.sha256, data, len); break;
+  case MBEDTLS_MD_SHA384:
+  case MBEDTLS_MD_SHA512: mbedtls_sha512_update(&hash->ctx.sha512, data, len); break;
+  default: break;
+  }
+}
+
+static void jswrap_crypto_hashFinish(JsCryptoHash *hash, unsigned char *out) {
+  switch (hash->type) {
+  case MBEDTLS_MD_SHA1: mbedtls_sha1_finish(&hash->ctx.sha1, out); break;
+  case MBEDTLS_MD_SHA224:
+  case MBEDTLS_MD_SHA256: mbedtls_sha256_finish(&hash->ctx.sha256, out); break;
+  case MBEDTLS_MD_SHA384:
+  case MBEDTLS_MD_SHA512: mbedtls_sha512_finish(&hash->ctx.sha512, out); break;
+  default: break;
+  }
+  if (hash->hmac) {
+    // HMAC outer pass - H(opad || innerDigest), RFC2104
+    JsCryptoHash outer;
+    outer.type = hash->type;
+    outer.hmac = false;
+    jswrap_crypto_hashStart(&outer);
+    jswrap_crypto_hashUpdate(&outer, hash->opad, (size_t)jswrap_crypto_hashBlockSize(hash->type));
+    jswrap_crypto_hashUpdate(&outer, out, (size_t)jswrap_crypto_hashSize(hash->type));
+    jswrap_crypto_hashFinish(&outer, out);
+  }
+}
+
+/** Set up a JsCryptoHash, optionally keyed as an HMAC. Returns false (with an
+ * error already reported) if the key couldn't be read. */
+static bool jswrap_crypto_hashInit(JsCryptoHash *hash, mbedtls_md_type_t type, JsVar *key) {
+  hash->type = type;
+  hash->hmac = false;
+  jswrap_crypto_hashStart(hash);
+  if (key) {
+    int blockSize = jswrap_crypto_hashBlockSize(type);
+    unsigned char keyBlock[HASH_BLOCK_MAX];
+    memset(keyBlock, 0, sizeof(keyBlock));
+    JSV_GET_AS_CHAR_ARRAY(keyPtr, keyLen, key);
+    if (!keyPtr) return false;
+    if (keyLen > (size_t)blockSize) {
+      // keys longer than a hash block get hashed down first (RFC2104)
+      JsCryptoHash keyHash;
+      keyHash.type = type;
+      keyHash.hmac = false;
+      jswrap_crypto_hashStart(&keyHash);
+      jswrap_crypto_hashUpdate(&keyHash, (unsigned char*)keyPtr, keyLen);
+      jswrap_crypto_hashFinish(&keyHash, keyBlock);
+    } else
+      memcpy(keyBlock, keyPtr, keyLen);
+    unsigned char ipad[HASH_BLOCK_MAX];
+    int i;
+    for (i=0;i<blockSize;i++) {
+      ipad[i] = (unsigned char)(keyBlock[i] ^ 0x36);
+      hash->opad[i] = (unsigned char)(keyBlock[i] ^ 0x5C);
+    }
+    hash->hmac = true;
+    jswrap_crypto_hashUpdate(hash, ipad, (size_t)blockSize);
+  }
+  return true;
+}
+
+/// Get the hash state out of a Hash object (and lock its flat string into *ctxVar)
+static JsCryptoHash *jswrap_crypto_getHashFromVar(JsVar *parent, JsVar **ctxVar) {
+  *ctxVar = jsvObjectGetChild(parent, JS_HIDDEN_CHAR_STR"hash", 0);
+  if (*ctxVar && jsvIsFlatString(*ctxVar))
+    return (JsCryptoHash*)jsvGetFlatStringPointer(*ctxVar);
+  jsExceptionHere(JSET_ERROR, "Not a valid Hash object");
+  return 0;
+}
+
+/*JSON{
+  "type" : "class",
+  "class" : "Hash",
+  "ifdef" : "USE_CRYPTO"
+}
+An incremental hash or HMAC, created with `require('crypto').createHash(...)`
+or `createHmac(...)`. Feed it data a chunk at a time with `update` and read
+the result with `digest` - memory use stays constant however much data goes
+through it, unlike `crypto.SHA256(wholeMessage)` which needs the whole
+message in RAM at once.
+
+`Hash.write` is an alias of `update`, so a Hash can be used directly as the
+destination of a pipe - eg. to checksum a firmware file as it streams in:
+
+```
+var hash = require('crypto').createHash('SHA256');
+E.openFile('firmware.bin','r').pipe(hash, {
+  complete : function() { console.log(hash.digest()); }
+});
+```
+*/
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "crypto",
+  "name" : "createHash",
+  "generate" : "jswrap_crypto_createHash",
+  "params" : [
+    ["algorithm","JsVar","The hash to use - `'SHA1'/'SHA224'/'SHA256'/'SHA384'/'SHA512'`"]
+  ],
+  "return" : ["JsVar","A `Hash` object"],
+  "return_object" : "Hash",
+  "ifdef" : "USE_CRYPTO"
+}
+Create an incremental hash object - see `Hash` for how to use it.
+*/
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "crypto",
+  "name" : "createHmac",
+  "generate" : "jswrap_crypto_createHmac",
+  "params" : [
+    ["algorithm","JsVar","The hash to use - `'SHA1'/'SHA224'/'SHA256'/'SHA384'/'SHA512'`"],
+    ["key","JsVar","The HMAC key (a String or ArrayBuffer)"]
+  ],
+  "return" : ["JsVar","A `Hash` object computing an HMAC"],
+  "return_object" : "Hash",
+  "ifdef" : "USE_CRYPTO"
+}
+Create an incremental HMAC object - used exactly like a `Hash`, but
+`digest()` returns the keyed HMAC of everything passed to `update`.
+*/
+static JsVar *jswrap_crypto_newHash(mbedtls_md_type_t type, JsVar *key) {
+  if (type == MBEDTLS_MD_NONE) return 0; // error already reported
+  JsVar *obj = jspNewObject(0, "Hash");
+  if (!obj) return 0;
+  JsVar *ctxVar = jsvNewFlatStringOfLength(sizeof(JsCryptoHash));
+  if (!ctxVar) {
+    jsvUnLock(obj);
+    jsError("Not enough memory for hash context");
+    return 0;
+  }
+  JsCryptoHash *hash = (JsCryptoHash*)jsvGetFlatStringPointer(ctxVar);
+  if (!jswrap_crypto_hashInit(hash, type, key)) {
+    jsvUnLock2(ctxVar, obj);
+    return 0;
+  }
+  jsvObjectSetChildAndUnLock(obj, JS_HIDDEN_CHAR_STR"hash", ctxVar);
+  return obj;
+}
+
+JsVar *jswrap_crypto_createHash(JsVar *algo) {
+  return jswrap_crypto_newHash(jswrap_crypto_getHasher(algo), 0);
+}
+
+JsVar *jswrap_crypto_createHmac(JsVar *algo, JsVar *key) {
+  return jswrap_crypto_newHash(jswrap_crypto_getHasher(algo), key);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Hash",
+  "name" : "update",
+  "generate" : "jswrap_crypto_hash_update",
+  "params" : [
+    ["data","JsVar","A String or ArrayBuffer with the next chunk of the message"]
+  ],
+  "return" : ["JsVar","The Hash object (for chaining)"],
+  "return_object" : "Hash",
+  "ifdef" : "USE_CRYPTO"
+}
+Add a chunk of data to the hash. Chunking makes no difference to the result -
+`update(a).update(b)` produces the same digest as `update(a+b)`.
+*/
+/*JSON{
+  "type" : "method",
+  "class" : "Hash",
+  "name" : "write",
+  "generate" : "jswrap_crypto_hash_update",
+  "params" : [
+    ["data","JsVar","A String or ArrayBuffer with the next chunk of the message"]
+  ],
+  "return" : ["JsVar","The Hash object (for chaining)"],
+  "return_object" : "Hash",
+  "ifdef" : "USE_CRYPTO"
+}
+An alias of `Hash.update`, so a Hash can be the destination of a pipe.
+*/
+JsVar *jswrap_crypto_hash_update(JsVar *parent, JsVar *data) {
+  JsVar *ctxVar;
+  JsCryptoHash *hash = jswrap_crypto_getHashFromVar(parent, &ctxVar);
+  if (!hash) {
+    jsvUnLock(ctxVar);
+    return 0;
+  }
+  if (!jsvIsUndefined(data)) {
+    JSV_GET_AS_CHAR_ARRAY(dataPtr, dataLen, data);
+    if (dataPtr && dataLen)
+      jswrap_crypto_hashUpdate(hash, (unsigned char*)dataPtr, dataLen);
+  }
+  jsvUnLock(ctxVar);
+  return jsvLockAgain(parent);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Hash",
+  "name" : "digest",
+  "generate" : "jswrap_crypto_hash_digest",
+  "return" : ["JsVar","An ArrayBuffer with the hash (or HMAC) of everything passed to `update` so far"],
+  "return_object" : "ArrayBuffer",
+  "ifdef" : "USE_CRYPTO"
+}
+Return the digest of everything fed in with `update` so far. The hash is
+finished on a copy of the internal state, so the object stays usable - you
+can keep calling `update` and take further digests of the longer stream.
+*/
+JsVar *jswrap_crypto_hash_digest(JsVar *parent) {
+  JsVar *ctxVar;
+  JsCryptoHash *hash = jswrap_crypto_getHashFromVar(parent, &ctxVar);
+  if (!hash) {
+    jsvUnLock(ctxVar);
+    return 0;
+  }
+  // finish on a copy so the stream can carry on being updated afterwards
+  JsCryptoHash finished = *hash;
+  jsvUnLock(ctxVar);
+  char *outPtr = 0;
+  JsVar *outArr = jsvNewArrayBufferWithPtr((unsigned int)jswrap_crypto_hashSize(finished.type), &outPtr);
+  if (!outPtr) {
+    jsError("Not enough memory for result");
+    return 0;
+  }
+  jswrap_crypto_hashFinish(&finished, (unsigned char*)outPtr);
+  return outArr;
+}
+
 #ifdef USE_TLS
 /*JSON{
   "type" : "staticmethod",
@@ -300,6 +586,191 @@ JsVar *jswrap_crypto_PBKDF2(JsVar *passphrase, JsVar *salt, JsVar *options) {
   }
 }
 
+#define CRYPTO_PBKDF2_QUEUE JS_HIDDEN_CHAR_STR"pbkdf2"
+#define CRYPTO_PBKDF2_ITERS_PER_IDLE 128 ///< HMAC iterations per idle pass - keeps each slice well under a millisecond
+
+/** Resumable PBKDF2 state - like JsCryptoHash this is pointer-free and lives
+ * in a flat string, so it survives garbage collection between idle passes. */
+typedef struct {
+  JsCryptoHash prf;       ///< SHA context pre-seeded with passphrase^ipad - cloned for every HMAC
+  unsigned char u[64];    ///< U from the last iteration
+  unsigned char t[64];    ///< running XOR of the U's for the current block
+  uint32_t iterations;    ///< total iterations per block
+  uint32_t iterDone;      ///< iterations finished for the current block (0 = block not started)
+  uint32_t blockIdx;      ///< 1-based output block we're working on
+  uint32_t saltLen;       ///< real salt length (the stored salt string is padded to at least 1 byte)
+  uint32_t keyLen;        ///< total key bytes wanted
+  uint32_t keyDone;       ///< key bytes already written to the result
+} JsCryptoPBKDF2;
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "crypto",
+  "name" : "PBKDF2Async",
+  "generate" : "jswrap_crypto_PBKDF2Async",
+  "params" : [
+    ["passphrase","JsVar","Passphrase"],
+    ["salt","JsVar","Salt for turning passphrase into a key"],
+    ["options","JsVar","Object of Options, `{ keySize: 8 (in 32 bit words), iterations: 10, hasher: 'SHA1'/'SHA224'/'SHA256'/'SHA384'/'SHA512' }`"]
+  ],
+  "return" : ["JsVar","A Promise that resolves to an ArrayBuffer"],
+  "ifdef" : "USE_TLS"
+}
+
+As `crypto.PBKDF2`, but the work is done in small slices from the idle loop
+and a Promise is returned. `crypto.PBKDF2` with a realistic iteration count
+blocks JavaScript for seconds, so timers fire late and serial data can be
+lost - this version keeps the device responsive while the key is derived:
+
+```
+require("crypto").PBKDF2Async(password, salt, {
+  iterations : 10000, keySize : 8
+}).then(function(key) { ... });
+```
+*/
+JsVar *jswrap_crypto_PBKDF2Async(JsVar *passphrase, JsVar *salt, JsVar *options) {
+  int iterations = 1;
+  int keySize = 128/32;
+  mbedtls_md_type_t hasher = MBEDTLS_MD_SHA1;
+
+  if (jsvIsObject(options)) {
+    keySize = jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "keySize", 0));
+    if (keySize<=0) keySize=128/32;
+    iterations = jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "iterations", 0));
+    if (iterations<1) iterations = 1;
+
+    JsVar *hashVar = jsvObjectGetChild(options, "hasher", 0);
+    if (!jsvIsUndefined(hashVar))
+      hasher = jswrap_crypto_getHasher(hashVar);
+    jsvUnLock(hashVar);
+
+  } else if (!jsvIsUndefined(options))
+    jsError("Options should be an object or undefined, got %t", options);
+
+  if (hasher == MBEDTLS_MD_NONE)
+    return 0; // already shown an error
+
+  JSV_GET_AS_CHAR_ARRAY(saltPtr, saltLen, salt);
+  if (!saltPtr) return 0;
+
+  JsVar *stateVar = jsvNewFlatStringOfLength(sizeof(JsCryptoPBKDF2));
+  // salt kept as a flat string too, so the idle loop can get at the bytes without copying
+  JsVar *saltVar = jsvNewFlatStringOfLength(saltLen ? (unsigned int)saltLen : 1);
+  JsVar *resultVar = jsvNewFlatStringOfLength((unsigned int)keySize*4);
+  if (!stateVar || !saltVar || !resultVar) {
+    jsvUnLock3(stateVar, saltVar, resultVar);
+    jsError("Not enough memory for result");
+    return 0;
+  }
+  memcpy(jsvGetFlatStringPointer(saltVar), saltPtr, saltLen);
+
+  JsCryptoPBKDF2 *state = (JsCryptoPBKDF2*)jsvGetFlatStringPointer(stateVar);
+  if (!jswrap_crypto_hashInit(&state->prf, hasher, passphrase)) {
+    jsvUnLock3(stateVar, saltVar, resultVar);
+    return 0;
+  }
+  state->iterations = (uint32_t)iterations;
+  state->iterDone = 0;
+  state->blockIdx = 1;
+  state->saltLen = (uint32_t)saltLen;
+  state->keyLen = (uint32_t)keySize*4;
+  state->keyDone = 0;
+
+  JsVar *promise = jspromise_create();
+  if (promise) {
+    JsVar *queue = jsvObjectGetChild(execInfo.hiddenRoot, CRYPTO_PBKDF2_QUEUE, JSV_ARRAY);
+    JsVar *job = jsvNewObject();
+    if (queue && job) {
+      jsvObjectSetChild(job, "state", stateVar);
+      jsvObjectSetChild(job, "salt", saltVar);
+      jsvObjectSetChild(job, "result", resultVar);
+      jsvObjectSetChild(job, "promise", promise);
+      jsvArrayPush(queue, job);
+    }
+    jsvUnLock2(job, queue);
+  }
+  jsvUnLock3(stateVar, saltVar, resultVar);
+  return promise;
+}
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_crypto_idle",
+  "ifdef" : "USE_TLS"
+}*/
+bool jswrap_crypto_idle() {
+  JsVar *queue = jsvObjectGetChild(execInfo.hiddenRoot, CRYPTO_PBKDF2_QUEUE, 0);
+  if (!queue) return false;
+  bool busy = false;
+  // jobs run one at a time, in the order they were queued (note elements
+  // keep their original indices after a pop, so walk rather than index)
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, queue);
+  JsVar *job = jsvObjectIteratorGetValue(&it);
+  jsvObjectIteratorFree(&it);
+  if (job) {
+    JsVar *stateVar = jsvObjectGetChild(job, "state", 0);
+    JsVar *saltVar = jsvObjectGetChild(job, "salt", 0);
+    JsVar *resultVar = jsvObjectGetChild(job, "result", 0);
+    JsCryptoPBKDF2 *state = (stateVar && jsvIsFlatString(stateVar)) ? (JsCryptoPBKDF2*)jsvGetFlatStringPointer(stateVar) : 0;
+    unsigned char *saltPtr = (saltVar && jsvIsFlatString(saltVar)) ? (unsigned char*)jsvGetFlatStringPointer(saltVar) : 0;
+    unsigned char *result = (resultVar && jsvIsFlatString(resultVar)) ? (unsigned char*)jsvGetFlatStringPointer(resultVar) : 0;
+    if (state && saltPtr && result) {
+      size_t hashSize = (size_t)jswrap_crypto_hashSize(state->prf.type);
+      int budget = CRYPTO_PBKDF2_ITERS_PER_IDLE;
+      while (budget>0 && state->keyDone < state->keyLen) {
+        if (state->iterDone == 0) {
+          // first iteration of a block: U1 = PRF(salt || INT32BE(blockIdx))
+          unsigned char blockIdxBE[4];
+          blockIdxBE[0] = (unsigned char)(state->blockIdx>>24);
+          blockIdxBE[1] = (unsigned char)(state->blockIdx>>16);
+          blockIdxBE[2] = (unsigned char)(state->blockIdx>>8);
+          blockIdxBE[3] = (unsigned char)(state->blockIdx);
+          JsCryptoHash h = state->prf;
+          jswrap_crypto_hashUpdate(&h, saltPtr, state->saltLen);
+          jswrap_crypto_hashUpdate(&h, blockIdxBE, 4);
+          jswrap_crypto_hashFinish(&h, state->u);
+          memcpy(state->t, state->u, hashSize);
+          state->iterDone = 1;
+          budget--;
+        } else if (state->iterDone < state->iterations) {
+          // U_i = PRF(U_i-1), XORed into the block total
+          JsCryptoHash h = state->prf;
+          jswrap_crypto_hashUpdate(&h, state->u, hashSize);
+          jswrap_crypto_hashFinish(&h, state->u);
+          size_t i;
+          for (i=0;i<hashSize;i++) state->t[i] ^= state->u[i];
+          state->iterDone++;
+          budget--;
+        } else {
+          // block complete - copy out and move on to the next one
+          uint32_t n = state->keyLen - state->keyDone;
+          if (n > hashSize) n = (uint32_t)hashSize;
+          memcpy(&result[state->keyDone], state->t, n);
+          state->keyDone += n;
+          state->blockIdx++;
+          state->iterDone = 0;
+        }
+      }
+      busy = true;
+      if (state->keyDone >= state->keyLen) {
+        // all blocks done - resolve with the key and drop the job
+        JsVar *promise = jsvObjectGetChild(job, "promise", 0);
+        JsVar *keyArr = jsvNewArrayBufferFromString(resultVar, 0);
+        if (promise) jspromise_resolve(promise, keyArr);
+        jsvUnLock3(promise, keyArr, jsvArrayPopFirst(queue));
+      }
+    } else {
+      jsvUnLock(jsvArrayPopFirst(queue)); // job is broken - drop it
+    }
+    jsvUnLock3(stateVar, saltVar, resultVar);
+    jsvUnLock(job);
+  }
+  if (!jsvGetArrayLength(queue))
+    jsvObjectRemoveChild(execInfo.hiddenRoot, CRYPTO_PBKDF2_QUEUE);
+  jsvUnLock(queue);
+  return busy;
+}
 
 static NO_INLINE JsVar *jswrap_crypto_AEScrypt(JsVar *message, JsVar *key, JsVar *options, bool encrypt) {
   int err;
@@ -352,7 +823,21 @@ static NO_INLINE JsVar *jswrap_crypto_AEScrypt(JsVar *message, JsVar *key, JsVar
     return 0;
   }
 
-
+#ifdef JSH_HAS_CRYPTO
+  // Try the hardware engine first - if it can't handle this mode or key
+  // size it returns false and we fall through to software mbedTLS
+  if (mode==CM_ECB || mode==CM_CBC || mode==CM_CTR) {
+    unsigned char hwIV[16];
+    if (mode==CM_CTR) memset(hwIV, 0, sizeof(hwIV)); // CTR always starts from a zero counter (as the software path below)
+    else memcpy(hwIV, iv, sizeof(hwIV));
+    if (jshAES((mode==CM_ECB) ? JSHAES_ECB : (mode==CM_CBC) ? JSHAES_CBC : JSHAES_CTR,
+               encrypt, (const unsigned char*)keyPtr, (unsigned int)keyLen*8, hwIV,
+               (const unsigned char*)messagePtr, (unsigned char*)outPtr, messageLen)) {
+      mbedtls_aes_free( &aes );
+      return outVar;
+    }
+  }
+#endif
 
   switch (mode) {
   case CM_CBC:
@@ -16,8 +16,14 @@
 #include "jsvar.h"
 JsVar *jswrap_crypto_error_to_jsvar(int err);
 JsVar *jswrap_crypto_SHAx(JsVar *message, int shaNum);
+JsVar *jswrap_crypto_createHash(JsVar *algo);
+JsVar *jswrap_crypto_createHmac(JsVar *algo, JsVar *key);
+JsVar *jswrap_crypto_hash_update(JsVar *parent, JsVar *data);
+JsVar *jswrap_crypto_hash_digest(JsVar *parent);
 #ifdef USE_TLS
 JsVar *jswrap_crypto_PBKDF2(JsVar *passphrase, JsVar *salt, JsVar *options);
+JsVar *jswrap_crypto_PBKDF2Async(JsVar *passphrase, JsVar *salt, JsVar *options);
+bool jswrap_crypto_idle();
 #endif
 #ifdef USE_AES
 JsVar *jswrap_crypto_AES_encrypt(JsVar *message, JsVar *key, JsVar *options);
@@ -2027,6 +2027,33 @@ FRESULT create_name (
 
 
 
+#if _USE_DIRCACHE
+/*-----------------------------------------------------------------------*/
+/* Directory path cache                                                  */
+/*-----------------------------------------------------------------------*/
+/* Remembers the directory part of the last path followed from the root
+/  and its start cluster, so that repeated operations on objects in the
+/  same directory (eg. logging to the same folder) skip re-walking the
+/  FAT chains of every parent directory. Must be invalidated by anything
+/  that could delete or move a directory. */
+
+#define DIRCACHE_PATH_LEN 64
+
+static FATFS *DirCacheFs;		/* File system the cache is valid on (0:invalid) */
+static DWORD DirCacheClust;		/* Start cluster of the cached directory */
+static UINT DirCachePathLen;	/* Length of the cached directory part */
+static TCHAR DirCachePath[DIRCACHE_PATH_LEN];	/* Directory part of the path, including trailing separator */
+
+static
+void dircache_invalidate (void)
+{
+	DirCacheFs = 0;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Follow a file path                                                    */
 /*-----------------------------------------------------------------------*/
@@ -2039,6 +2066,9 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 {
 	FRESULT res;
 	BYTE *dir, ns;
+#if _USE_DIRCACHE
+	const TCHAR *dcStart, *dcTail, *dcp;
+#endif
 
 
 #if _FS_RPATH
@@ -2053,6 +2083,24 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 	dp->sclust = 0;							/* Always start from the root directory */
 #endif
 
+#if _USE_DIRCACHE
+	dcTail = 0;
+	if (dp->sclust == 0) {					/* Only cache paths that resolve from the root directory */
+		dcStart = dcTail = path;
+		for (dcp = path; *dcp; dcp++)
+			if (*dcp == '/' || *dcp == '\\') dcTail = dcp + 1;
+		if (dcTail == dcStart || (UINT)*dcTail < ' ')
+			dcTail = 0;						/* No directory part, or no final segment after it */
+	}
+	if (dcTail && dp->fs == DirCacheFs
+		&& (UINT)(dcTail - dcStart) == DirCachePathLen
+		&& !mem_cmp(dcStart, DirCachePath, DirCachePathLen * sizeof (TCHAR))) {
+		dp->sclust = DirCacheClust;			/* Cache hit - start at the directory itself */
+		path = dcTail;
+		dcTail = 0;							/* Already cached - nothing to store below */
+	}
+#endif
+
 	if ((UINT)*path < ' ') {				/* Null path name is the origin directory itself */
 		res = dir_sdi(dp, 0);
 		dp->dir = 0;
@@ -2083,6 +2131,16 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 		}
 	}
 
+#if _USE_DIRCACHE
+	if (dcTail && (res == FR_OK || res == FR_NO_FILE)	/* All parent directories were resolved */
+		&& (UINT)(dcTail - dcStart) <= DIRCACHE_PATH_LEN) {
+		DirCacheClust = dp->sclust;			/* The directory the final segment was searched in */
+		DirCachePathLen = (UINT)(dcTail - dcStart);
+		mem_cpy(DirCachePath, dcStart, DirCachePathLen * sizeof (TCHAR));
+		DirCacheFs = dp->fs;
+	}
+#endif
+
 	return res;
 }
 
@@ -2400,6 +2458,9 @@ FRESULT f_mount (
 	vol = get_ldnumber(&rp);
 	if (vol < 0) return FR_INVALID_DRIVE;
 	cfs = FatFs[vol];					/* Pointer to fs object */
+#if _USE_DIRCACHE
+	dircache_invalidate();				/* The media may be changing */
+#endif
 
 	if (cfs) {
 #if _FS_LOCK
@@ -3471,6 +3532,9 @@ FRESULT f_unlink (
 	/* Get logical drive number */
 	res = find_volume(&dj.fs, &path, 1);
 	if (res == FR_OK) {
+#if _USE_DIRCACHE
+		dircache_invalidate();				/* The object removed may be a cached directory */
+#endif
 		INIT_BUF(dj);
 		res = follow_path(&dj, path);		/* Follow the file path */
 		if (_FS_RPATH && res == FR_OK && (dj.fn[NSFLAG] & NS_DOT))
@@ -3657,6 +3721,9 @@ FRESULT f_rename (
 	/* Get logical drive number of the source object */
 	res = find_volume(&djo.fs, &path_old, 1);
 	if (res == FR_OK) {
+#if _USE_DIRCACHE
+		dircache_invalidate();				/* The object moved may be a cached directory */
+#endif
 		djn.fs = djo.fs;
 		INIT_BUF(djo);
 		res = follow_path(&djo, path_old);		/* Check old object */
@@ -4015,6 +4082,9 @@ FRESULT f_mkfs (
 	fs = FatFs[vol];
 	if (!fs) return FR_NOT_ENABLED;
 	fs->fs_type = 0;
+#if _USE_DIRCACHE
+	dircache_invalidate();
+#endif
 	pdrv = LD2PD(vol);	/* Physical drive */
 	part = LD2PT(vol);	/* Partition (0:auto detect, 1-4:get from partition table)*/
 
@@ -61,6 +61,14 @@
 /* To enable it, also _FS_TINY need to be set to 1. */
 
 
+#define	_USE_DIRCACHE	1
+/* This option enables a one-entry cache of the last directory path that
+/  was resolved from the root, along with its start cluster, so repeated
+/  operations on files in the same directory skip re-walking the parent
+/  FAT chains. Invalidated by f_mount/f_unlink/f_rename/f_mkfs.
+/  (0:Disable or 1:Enable) */
+
+
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
 /---------------------------------------------------------------------------*/
@@ -82,6 +82,57 @@ static BYTE CardType;			/* Card type flags */
 static Pin sdCSPin = PIN_UNDEFINED; // SD_CS_PIN
 static JsVar *sdSPI = 0;
 
+/* Small LRU sector cache + sequential read-ahead. Single-sector reads are
+ * what hurt over SPI - FAT and directory sectors get re-read constantly, and
+ * streaming a file in small chunks advances one sector at a time. Multi-sector
+ * reads (big File.read calls) already stream via CMD18 and bypass the cache.
+ * Boards can override SD_CACHE_SECTORS (0 disables, 512 bytes RAM each). */
+#ifndef SD_CACHE_SECTORS
+#ifdef SAVE_ON_FLASH
+#define SD_CACHE_SECTORS 0
+#else
+#define SD_CACHE_SECTORS 4
+#endif
+#endif
+#if SD_CACHE_SECTORS>0
+/* How many sectors to fetch in one CMD18 when a sequential read misses */
+#ifndef SD_CACHE_READAHEAD
+#define SD_CACHE_READAHEAD (SD_CACHE_SECTORS<4 ? SD_CACHE_SECTORS : 4)
+#endif
+#define SD_CACHE_EMPTY 0xFFFFFFFFUL
+static BYTE cacheData[SD_CACHE_SECTORS][512];
+static DWORD cacheSector[SD_CACHE_SECTORS]; /* SD_CACHE_EMPTY = unused - set up by cache_flush in disk_initialize */
+static UINT cacheAge[SD_CACHE_SECTORS];
+static UINT cacheAgeCounter;
+static DWORD lastReadSector = SD_CACHE_EMPTY; /* for spotting sequential access */
+
+static void cache_flush (void)
+{
+	UINT i;
+	for (i=0;i<SD_CACHE_SECTORS;i++) cacheSector[i] = SD_CACHE_EMPTY;
+	lastReadSector = SD_CACHE_EMPTY;
+}
+
+/* Drop any cached copies of the given sector range (they're about to change) */
+static void cache_invalidate (DWORD sector, UINT count)
+{
+	UINT i;
+	for (i=0;i<SD_CACHE_SECTORS;i++)
+		if (cacheSector[i]-sector < count) cacheSector[i] = SD_CACHE_EMPTY;
+}
+
+/* Pick the entry to (re)use - an empty one if possible, else the oldest */
+static UINT cache_evict (void)
+{
+	UINT i, oldest = 0;
+	for (i=0;i<SD_CACHE_SECTORS;i++) {
+		if (cacheSector[i] == SD_CACHE_EMPTY) return i;
+		if (cacheAge[i] < cacheAge[oldest]) oldest = i;
+	}
+	return oldest;
+}
+#endif /* SD_CACHE_SECTORS */
+
 static inline bool chk_power() { return 1; }
 
 
@@ -356,6 +407,9 @@ DSTATUS disk_initialize (
 
 	if (ty) {			/* Initialization succeeded */
 		Stat &= ~STA_NOINIT;		/* Clear STA_NOINIT */
+#if SD_CACHE_SECTORS>0
+		cache_flush();	/* The card may have been swapped */
+#endif
 		// TODO: can now increase speed
 	} else {			/* Initialization failed */
 		power_off();
@@ -394,6 +448,53 @@ DRESULT disk_read (
 	if (drv || !count) return RES_PARERR;
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 
+#if SD_CACHE_SECTORS>0
+	if (count == 1) {
+		UINT i;
+		bool sequential = (sector == lastReadSector+1);
+		lastReadSector = sector;
+		for (i=0;i<SD_CACHE_SECTORS;i++) {
+			if (cacheSector[i] == sector) { /* Cache hit - no SPI at all */
+				memcpy(buff, cacheData[i], 512);
+				cacheAge[i] = ++cacheAgeCounter;
+				return RES_OK;
+			}
+		}
+		/* Cache miss. If we're being read sequentially, assume a stream and
+		 * fetch the next few sectors in one CMD18 - the requested one goes
+		 * straight to the caller, the rest into evicted cache entries */
+		UINT readAhead = sequential ? SD_CACHE_READAHEAD : 1;
+		DWORD addr = (CardType & CT_BLOCK) ? sector : sector*512;
+		UINT got = 0;
+		if (readAhead > 1) {
+			if (send_cmd(CMD18, addr) == 0) {	/* READ_MULTIPLE_BLOCK */
+				for (got=0;got<readAhead;got++) {
+					BYTE *dst = got ? cacheData[cache_evict()] : buff;
+					if (!rcvr_datablock(dst, 512)) break;
+					if (got) { /* dst was an evicted entry - claim it */
+						UINT e = (UINT)((dst-&cacheData[0][0])/512);
+						cacheSector[e] = sector+got;
+						cacheAge[e] = ++cacheAgeCounter;
+					}
+				}
+				send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+			}
+		} else {
+			if (send_cmd(CMD17, addr) == 0 && rcvr_datablock(buff, 512)) /* READ_SINGLE_BLOCK */
+				got = 1;
+		}
+		release_spi();
+		if (!got) return RES_ERROR; /* couldn't even get the requested sector */
+		/* cache the requested sector too - FAT sectors come round again quickly */
+		i = cache_evict();
+		memcpy(cacheData[i], buff, 512);
+		cacheSector[i] = sector;
+		cacheAge[i] = ++cacheAgeCounter;
+		return RES_OK;
+	}
+	lastReadSector = sector+count-1;
+#endif
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
 
 	if (count == 1) {	/* Single block read */
@@ -437,6 +538,10 @@ DRESULT disk_write (
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 	if (Stat & STA_PROTECT) return RES_WRPRT;
 
+#if SD_CACHE_SECTORS>0
+	cache_invalidate(sector, count);	/* Cached copies are stale now */
+#endif
+
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
 
 	if (count == 1) {	/* Single block write */
@@ -19,6 +19,11 @@
 
 #define JS_FS_DATA_NAME JS_HIDDEN_CHAR_STR"FSd" // the data in each file
 #define JS_FS_OPEN_FILES_NAME JS_HIDDEN_CHAR_STR"FSo" // the list of open files
+#define JS_FS_BUF_NAME JS_HIDDEN_CHAR_STR"FSb" // the RAM write buffer of an 'ab' file
+#ifndef FS_APPEND_BUF_SIZE
+#define FS_APPEND_BUF_SIZE 512 // one sector - keeps buffered writes aligned
+#endif
+#define FS_APPEND_FLUSH_MS 1000 // flush a quiet buffered file after this long
 #if !defined(LINUX) && !defined(USE_FILESYSTEM_SDIO) && !defined(USE_FLASHFS)
 #define SD_CARD_ANYWHERE
 #endif
@@ -180,6 +185,28 @@ static bool fileGetFromVar(JsFile *file, JsVar *parent) {
   return ret;
 }
 
+/* Write out any bytes queued up in a buffered append file's RAM buffer.
+ * This doesn't sync the FAT - that's left to file.flush/close or the idle loop */
+static FRESULT fileFlushBuffer(JsFile *file) {
+  FRESULT res = FR_OK;
+  if (!file->data->bufUsed) return res;
+  JsVar *bufVar = jsvObjectGetChild(file->fileVar, JS_FS_BUF_NAME, 0);
+  if (bufVar) {
+    char *bufPtr = jsvGetFlatStringPointer(bufVar);
+    size_t written = 0;
+#ifndef LINUX
+    res = f_write(&file->data->handle, bufPtr, file->data->bufUsed, &written);
+    if (!res && written != file->data->bufUsed) res = FR_DISK_ERR;
+#else
+    written = fwrite(bufPtr, 1, file->data->bufUsed, file->data->handle);
+    if (written != file->data->bufUsed) res = FR_DISK_ERR;
+#endif
+    file->data->bufUsed = 0;
+    jsvUnLock(bufVar);
+  }
+  return res;
+}
+
 /*JSON{
   "type" : "kill",
   "generate" : "jswrap_file_kill"
@@ -239,6 +266,9 @@ static bool allocateJsFile(JsFile* file,FileMode mode, FileType type) {
   file->data->mode = mode;
   file->data->type = type;
   file->data->state = FS_NONE;
+  file->data->buffered = false;
+  file->data->bufUsed = 0;
+  file->data->lastWrite = 0;
   return true;
 }
 
@@ -249,12 +279,19 @@ static bool allocateJsFile(JsFile* file,FileMode mode, FileType type) {
   "generate" : "jswrap_E_openFile",
   "params" : [
     ["path","JsVar","the path to the file to open."],
-    ["mode","JsVar","The mode to use when opening the file. Valid values for mode are 'r' for read, 'w' for write new, 'w+' for write existing, and 'a' for append. If not specified, the default is 'r'."]
+    ["mode","JsVar","The mode to use when opening the file. Valid values for mode are 'r' for read, 'w' for write new, 'w+' for write existing, 'a' for append, and 'ab' for buffered append. If not specified, the default is 'r'."]
   ],
   "return" : ["JsVar","A File object"],
   "return_object" : "File"
 }
 Open a file
+
+In `'ab'` (buffered append) mode, writes are batched up in a small RAM
+buffer and only hit the card when the buffer fills, when `file.flush()`
+or `file.close()` is called, or after the file has been left unwritten
+for a second. This makes writing many small chunks (eg. logging) much
+faster, at the cost of losing at most a buffer's worth of data if power
+is removed before a flush.
 */
 JsVar *jswrap_E_openFile(JsVar* path, JsVar* mode) {
   FRESULT res = FR_INVALID_NAME;
@@ -297,6 +334,12 @@ JsVar *jswrap_E_openFile(JsVar* path, JsVar* mode) {
         fMode = FM_WRITE;
 #ifndef LINUX
         ff_mode = FA_WRITE | FA_CREATE_ALWAYS;
+#endif
+      } else if(strcmp(modeStr,"ab") == 0) {
+        fMode = FM_WRITE;
+#ifndef LINUX
+        ff_mode = FA_WRITE | FA_OPEN_ALWAYS;
+        append = true;
 #endif
       } else if(strcmp(modeStr,"w+") == 0) {
         fMode = FM_READ_WRITE;
@@ -314,6 +357,15 @@ JsVar *jswrap_E_openFile(JsVar* path, JsVar* mode) {
           res=FR_OK;
 #endif
           file.data->state = FS_OPEN;
+          if (strcmp(modeStr,"ab") == 0) {
+            // buffered append - writes go via a RAM buffer (if we can't
+            // allocate one we just fall back to plain appending)
+            JsVar *buf = jsvNewFlatStringOfLength(FS_APPEND_BUF_SIZE);
+            if (buf) {
+              jsvObjectSetChildAndUnLock(file.fileVar, JS_FS_BUF_NAME, buf);
+              file.data->buffered = true;
+            }
+          }
           // add to list of open files
           jsvArrayPush(arr, file.fileVar);
         } else {
@@ -349,6 +401,11 @@ void jswrap_file_close(JsVar* parent) {
   if (jsfsInit()) {
     JsFile file;
     if (fileGetFromVar(&file, parent) && file.data->state == FS_OPEN) {
+      fileFlushBuffer(&file);
+      if (file.data->buffered) {
+        file.data->buffered = false;
+        jsvObjectRemoveChild(parent, JS_FS_BUF_NAME); // free the buffer now rather than waiting for a GC
+      }
 #ifndef LINUX
       f_close(&file.data->handle);
 #else
@@ -389,6 +446,10 @@ SD card, which makes it slow (but also safe!). You can use
 really speed up writes - but then you must be sure to close
 all files you are writing before power is lost or you will
 cause damage to your SD card's filesystem.
+
+For files opened in `'ab'` mode, data is instead batched up in
+a RAM buffer and written out a whole buffer at a time - the
+return value counts bytes accepted into the buffer.
 */
 size_t jswrap_file_write(JsVar* parent, JsVar* buffer) {
   FRESULT res = 0;
@@ -396,7 +457,25 @@ size_t jswrap_file_write(JsVar* parent, JsVar* buffer) {
   if (jsfsInit()) {
     JsFile file;
     if (fileGetFromVar(&file, parent)) {
-      if(file.data->mode == FM_WRITE || file.data->mode == FM_READ_WRITE) {
+      JsVar *bufVar = file.data->buffered ? jsvObjectGetChild(parent, JS_FS_BUF_NAME, 0) : 0;
+      if (bufVar) {
+        // buffered append - just queue bytes up, writing out whole
+        // buffers as they fill. Syncing is deferred until the buffer
+        // has been quiet for a while (see jswrap_file_idle)
+        char *bufPtr = jsvGetFlatStringPointer(bufVar);
+        JsvIterator it;
+        jsvIteratorNew(&it, buffer, JSIF_EVERY_ARRAY_ELEMENT);
+        while (jsvIteratorHasElement(&it) && !res) {
+          bufPtr[file.data->bufUsed++] = (char)jsvIteratorGetIntegerValue(&it);
+          jsvIteratorNext(&it);
+          bytesWritten++;
+          if (file.data->bufUsed >= FS_APPEND_BUF_SIZE)
+            res = fileFlushBuffer(&file);
+        }
+        jsvIteratorFree(&it);
+        file.data->lastWrite = jshGetSystemTime();
+        jsvUnLock(bufVar);
+      } else if(file.data->mode == FM_WRITE || file.data->mode == FM_READ_WRITE) {
         JsvIterator it;
         jsvIteratorNew(&it, buffer, JSIF_EVERY_ARRAY_ELEMENT);
         char buf[32];
@@ -548,6 +627,7 @@ void jswrap_file_skip_or_seek(JsVar* parent, int nBytes, bool is_skip) {
     JsFile file;
     if (fileGetFromVar(&file, parent)) {
       if(file.data->mode == FM_READ || file.data->mode == FM_WRITE || file.data->mode == FM_READ_WRITE) {
+        fileFlushBuffer(&file); // make sure buffered data lands before we move the file pointer
   #ifndef LINUX
         res = (FRESULT)f_lseek(&file.data->handle, (DWORD)(is_skip ? f_tell(&file.data->handle) : 0) + (DWORD)nBytes);
   #else
@@ -559,6 +639,67 @@ void jswrap_file_skip_or_seek(JsVar* parent, int nBytes, bool is_skip) {
   if (res) jsfsReportError(is_skip?"Unable to skip":"Unable to seek", res);
 }
 
+/*JSON{
+  "type" : "method",
+  "class" : "File",
+  "name" : "flush",
+  "generate" : "jswrap_file_flush"
+}
+Flush any buffered writes out to the card and sync the filesystem.
+
+This is mainly useful for files opened in `'ab'` (buffered append) mode,
+where it guarantees everything written so far is safely on the card -
+for other modes writes are already synced (unless `unsyncFiles` is set).
+*/
+void jswrap_file_flush(JsVar* parent) {
+  FRESULT res = 0;
+  if (jsfsInit()) {
+    JsFile file;
+    if (fileGetFromVar(&file, parent)) {
+      res = fileFlushBuffer(&file);
+#ifndef LINUX
+      if (!res) res = f_sync(&file.data->handle);
+#else
+      fflush(file.data->handle);
+#endif
+    }
+  }
+  if (res) jsfsReportError("Unable to flush file", res);
+}
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_file_idle"
+}*/
+bool jswrap_file_idle() {
+  JsVar *arr = fsGetArray(false);
+  if (!arr) return false;
+  JsSysTime flushBefore = jshGetSystemTime() - jshGetTimeFromMilliseconds(FS_APPEND_FLUSH_MS);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, arr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *fileVar = jsvObjectIteratorGetValue(&it);
+    JsFile file;
+    if (fileGetFromVar(&file, fileVar) &&
+        file.data->buffered && file.data->bufUsed &&
+        file.data->lastWrite < flushBefore) {
+      // this file has unwritten data but has gone quiet - get it on the card
+      FRESULT res = fileFlushBuffer(&file);
+#ifndef LINUX
+      if (!res) res = f_sync(&file.data->handle);
+#else
+      if (!res) fflush(file.data->handle);
+#endif
+      if (res) jsfsReportError("Unable to flush file", res);
+    }
+    jsvUnLock(fileVar);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(arr);
+  return false;
+}
+
 /*JSON{
   "type" : "method",
   "class" : "File",
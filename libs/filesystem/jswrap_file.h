@@ -55,6 +55,9 @@ typedef struct {
   FileType type;
   FileMode mode;
   FileState state;
+  bool buffered; //< is this an 'ab' file with a RAM write buffer?
+  unsigned short bufUsed; //< bytes queued in the write buffer
+  JsSysTime lastWrite; //< when data was last written (for idle flush)
 } PACKED_FLAGS JsFileData;
 
 typedef struct JsFile {
@@ -64,6 +67,8 @@ typedef struct JsFile {
 
 // Called when stopping, to make sure all files are closed
 void jswrap_file_kill();
+// Called on idle - flushes buffered append files that have sat unwritten for a while
+bool jswrap_file_idle();
 
 void jswrap_E_connectSDCard(JsVar *spi, Pin csPin);
 JsVar* jswrap_E_openFile(JsVar* path, JsVar* mode);
@@ -72,6 +77,7 @@ void jswrap_E_unmountSD();
 size_t jswrap_file_write(JsVar* parent, JsVar* buffer);
 JsVar *jswrap_file_read(JsVar* parent, int length);
 void jswrap_file_skip_or_seek(JsVar* parent, int length, bool is_skip);
+void jswrap_file_flush(JsVar* parent);
 void jswrap_file_close(JsVar* parent);
 #ifdef USE_FLASHFS
 void jsfsReportError(const char *msg, FRESULT res);
@@ -169,9 +169,17 @@ void graphicsDrawChar4x6(JsGraphics *gfx, short x1, short y1, char ch) {
   int y;
   for (y=0;y<6;y++) {
     unsigned int line = READ_FLASH_UINT16(&LCD_FONT_4X6[idx + y]) >> (cidx*3);
-    if (line&4) graphicsSetPixel(gfx, (short)(x1+0), (short)(y+y1), gfx->data.fgColor);
-    if (line&2) graphicsSetPixel(gfx, (short)(x1+1), (short)(y+y1), gfx->data.fgColor);
-    if (line&1) graphicsSetPixel(gfx, (short)(x1+2), (short)(y+y1), gfx->data.fgColor);
+    // draw each row as horizontal runs - fillRect can write a whole run
+    // at once on backends that support it, rather than pixel by pixel
+    int x = 0;
+    while (x<3) {
+      if (line & (4U>>x)) {
+        int xe = x;
+        while (xe+1<3 && (line & (4U>>(xe+1)))) xe++;
+        graphicsFillRect(gfx, (short)(x1+x), (short)(y+y1), (short)(x1+xe), (short)(y+y1));
+        x = xe+1;
+      } else x++;
+    }
   }
 }
 
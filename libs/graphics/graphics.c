@@ -29,6 +29,9 @@
 #ifdef USE_LCD_FSMC
 #include "lcd_fsmc.h"
 #endif
+#ifdef USE_LCD_PCD8544
+#include "lcd_pcd8544.h"
+#endif
 
 // ----------------------------------------------------------------------------------------------
 
@@ -55,6 +58,25 @@ void graphicsFallbackFillRect(JsGraphics *gfx, short x1, short y1, short x2, sho
       graphicsSetPixelDevice(gfx,x,y, gfx->data.fgColor);
 }
 
+void graphicsFallbackScroll(JsGraphics *gfx, int xdir, int ydir) {
+  if (!xdir && !ydir) return;
+  int w = gfx->data.width, h = gfx->data.height;
+  int x,y;
+  /* iterate so the destination is always written before it would be
+   * read as a source - down/right scrolls must copy backwards */
+  for (y=0;y<h;y++) {
+    int dy = (ydir>0) ? (h-1-y) : y;
+    int sy = dy - ydir;
+    for (x=0;x<w;x++) {
+      int dx = (xdir>0) ? (w-1-x) : x;
+      int sx = dx - xdir;
+      unsigned int col = (sx>=0 && sy>=0 && sx<w && sy<h) ?
+          gfx->getPixel(gfx,(short)sx,(short)sy) : gfx->data.bgColor;
+      gfx->setPixel(gfx,(short)dx,(short)dy,col);
+    }
+  }
+}
+
 // ----------------------------------------------------------------------------------------------
 
 bool graphicsGetFromVar(JsGraphics *gfx, JsVar *parent) {
@@ -67,6 +89,7 @@ bool graphicsGetFromVar(JsGraphics *gfx, JsVar *parent) {
     gfx->setPixel = graphicsFallbackSetPixel;
     gfx->getPixel = graphicsFallbackGetPixel;
     gfx->fillRect = graphicsFallbackFillRect;
+    gfx->scroll = graphicsFallbackScroll;
 #ifdef USE_LCD_SDL
     if (gfx->data.type == JSGRAPHICSTYPE_SDL) {
       lcdSetCallbacks_SDL(gfx);
@@ -76,6 +99,11 @@ bool graphicsGetFromVar(JsGraphics *gfx, JsVar *parent) {
     if (gfx->data.type == JSGRAPHICSTYPE_FSMC) {
       lcdSetCallbacks_FSMC(gfx);
     } else
+#endif
+#ifdef USE_LCD_PCD8544
+    if (gfx->data.type == JSGRAPHICSTYPE_PCD8544) {
+      lcdSetCallbacks_PCD8544(gfx);
+    } else
 #endif
     if (gfx->data.type == JSGRAPHICSTYPE_ARRAYBUFFER) {
       lcdSetCallbacks_ArrayBuffer(gfx);
@@ -265,6 +293,21 @@ void graphicsDrawString(JsGraphics *gfx, short x1, short y1, const char *str) {
   }
 }
 
+void graphicsScroll(JsGraphics *gfx, int xdir, int ydir) {
+  // apply any rotation to the scroll direction
+  if (gfx->data.flags & JSGRAPHICSFLAGS_SWAP_XY) {
+    int t = xdir; xdir = ydir; ydir = t;
+  }
+  if (gfx->data.flags & JSGRAPHICSFLAGS_INVERT_X) xdir = -xdir;
+  if (gfx->data.flags & JSGRAPHICSFLAGS_INVERT_Y) ydir = -ydir;
+  gfx->scroll(gfx, xdir, ydir);
+  // every pixel could have changed
+  gfx->data.modMinX = 0;
+  gfx->data.modMinY = 0;
+  gfx->data.modMaxX = (short)(gfx->data.width-1);
+  gfx->data.modMaxY = (short)(gfx->data.height-1);
+}
+
 void graphicsDrawLine(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
   graphicsToDeviceCoordinates(gfx, &x1, &y1);
   graphicsToDeviceCoordinates(gfx, &x2, &y2);
@@ -312,18 +355,25 @@ static inline void graphicsFillPolyCreateScanLines(JsGraphics *gfx, short *minx,
     int yl = y2-y1;
     if (yl==0) yl=1;
     int stepx = (x2-x1)*256 / yl;
+    /* only walk the visible part of the edge - a scaled-up poly can have
+     * edges spanning thousands of off-screen rows, and walking those made
+     * this O(poly area) rather than O(visible area) */
+    short ys = y1, ye = y2;
+    if (ys<0) {
+      xh += stepx*(0-ys); // advance to the first visible row
+      ys = 0;
+    }
+    if (ye>=gfx->data.height) ye = (short)(gfx->data.height-1);
     short y;
-    for (y=y1;y<=y2;y++) {
+    for (y=ys;y<=ye;y++) {
         int x = xh>>8;
         if (x<-32768) x=-32768;
         if (x>32767) x=32767;
-        if (y>=0 && y<gfx->data.height) {
-            if (x<minx[y]) {
-                minx[y] = (short)x;
-            }
-            if (x>maxx[y]) {
-                maxx[y] = (short)x;
-            }
+        if (x<minx[y]) {
+            minx[y] = (short)x;
+        }
+        if (x>maxx[y]) {
+            maxx[y] = (short)x;
         }
         xh += stepx;
     }
@@ -371,6 +421,63 @@ void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices) {
 }
 
 #ifndef SAVE_ON_FLASH
+/* Filling polygons for every character makes scrolling text expensive, so
+ * glyphs get rasterised to a small 1 bit bitmap the first time they are
+ * drawn and the bitmap is blitted (as horizontal runs of fillRect) from
+ * then on. The cache holds coverage only - colour and any rotation are
+ * applied when blitting - and glyphs too big for an entry just take the
+ * old fillPoly path. */
+#define VECTORFONT_CACHE_ENTRIES 8
+#define VECTORFONT_CACHE_BYTES 96 ///< bitmap bytes per cached glyph
+typedef struct {
+  char ch; ///< 0 = entry unused
+  short size;
+  unsigned char width, height; ///< bitmap size in pixels
+  unsigned char bmp[VECTORFONT_CACHE_BYTES];
+} VectorFontCacheEntry;
+static VectorFontCacheEntry vectorFontCache[VECTORFONT_CACHE_ENTRIES];
+static unsigned char vectorFontCacheNext = 0;
+/// the entry currently being rendered into (drawing is single-threaded)
+static VectorFontCacheEntry *vectorFontCacheTarget = 0;
+
+static void vectorFontCacheSetPixel(JsGraphics *gfx, short x, short y, unsigned int col) {
+  NOT_USED(gfx);
+  if (!col) return;
+  unsigned int idx = (unsigned int)x + (unsigned int)y*vectorFontCacheTarget->width;
+  if (idx < VECTORFONT_CACHE_BYTES*8)
+    vectorFontCacheTarget->bmp[idx>>3] |= (unsigned char)(1<<(idx&7));
+}
+
+static void vectorFontCacheFillRect(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  short x,y;
+  for (y=y1;y<=y2;y++)
+    for (x=x1;x<=x2;x++)
+      vectorFontCacheSetPixel(gfx, x, y, 1);
+}
+
+static unsigned int vectorFontCacheGetPixel(JsGraphics *gfx, short x, short y) {
+  NOT_USED(gfx); NOT_USED(x); NOT_USED(y);
+  return 0;
+}
+
+/// fill the glyph's polygons at x1,y1 - used both for direct drawing and cache rendering
+static void graphicsFillVectorCharPolys(JsGraphics *gfx, short x1, short y1, short size, int vertOffset, int vertCount) {
+  short verts[VECTOR_FONT_MAX_POLY_SIZE*2];
+  int i;
+  int idx=0;
+  for (i=0;i<vertCount;i+=2) {
+    verts[idx+0] = (short)(x1 + (((READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+0])&0x7F)*size + (VECTOR_FONT_POLY_SIZE/2)) / VECTOR_FONT_POLY_SIZE));
+    verts[idx+1] = (short)(y1 + (((READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+1])&0x7F)*size + (VECTOR_FONT_POLY_SIZE/2)) / VECTOR_FONT_POLY_SIZE));
+    idx+=2;
+    if (READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+1]) & VECTOR_FONT_POLY_SEPARATOR) {
+      graphicsFillPoly(gfx,idx/2, verts);
+
+      if (jspIsInterrupted()) break;
+      idx=0;
+    }
+  }
+}
+
 // prints character, returns width
 unsigned int graphicsFillVectorChar(JsGraphics *gfx, short x1, short y1, short size, char ch) {
   // no need to modify coordinates as graphicsFillPoly does that
@@ -386,19 +493,72 @@ unsigned int graphicsFillVectorChar(JsGraphics *gfx, short x1, short y1, short s
   VectorFontChar vector;
   vector.vertCount = READ_FLASH_UINT8(&vectorFonts[fontOffset].vertCount);
   vector.width = READ_FLASH_UINT8(&vectorFonts[fontOffset].width);
-  short verts[VECTOR_FONT_MAX_POLY_SIZE*2];
-  int idx=0;
-  for (i=0;i<vector.vertCount;i+=2) {
-    verts[idx+0] = (short)(x1 + (((READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+0])&0x7F)*size + (VECTOR_FONT_POLY_SIZE/2)) / VECTOR_FONT_POLY_SIZE));
-    verts[idx+1] = (short)(y1 + (((READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+1])&0x7F)*size + (VECTOR_FONT_POLY_SIZE/2)) / VECTOR_FONT_POLY_SIZE));
-    idx+=2;
-    if (READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+1]) & VECTOR_FONT_POLY_SEPARATOR) {
-      graphicsFillPoly(gfx,idx/2, verts);
-
-      if (jspIsInterrupted()) break;
-      idx=0;
+  // is the glyph cached already?
+  VectorFontCacheEntry *entry = 0;
+  for (i=0;i<VECTORFONT_CACHE_ENTRIES;i++)
+    if (vectorFontCache[i].ch==ch && vectorFontCache[i].size==size) {
+      entry = &vectorFontCache[i];
+      break;
+    }
+  if (!entry) {
+    // work out the ink bounds so we only cache glyphs that fit
+    int maxX = 0, maxY = 0;
+    for (i=0;i<vector.vertCount;i+=2) {
+      int vx = READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+0])&0x7F;
+      int vy = READ_FLASH_UINT8(&vectorFontPolys[vertOffset+i+1])&0x7F;
+      if (vx>maxX) maxX = vx;
+      if (vy>maxY) maxY = vy;
+    }
+    int w = ((maxX*size + (VECTOR_FONT_POLY_SIZE/2)) / VECTOR_FONT_POLY_SIZE) + 1;
+    int h = ((maxY*size + (VECTOR_FONT_POLY_SIZE/2)) / VECTOR_FONT_POLY_SIZE) + 1;
+    if (w<=VECTORFONT_CACHE_BYTES*8 && h<=VECTORFONT_CACHE_BYTES*8 &&
+        w*h<=VECTORFONT_CACHE_BYTES*8) {
+      entry = &vectorFontCache[vectorFontCacheNext];
+      vectorFontCacheNext = (unsigned char)((vectorFontCacheNext+1) % VECTORFONT_CACHE_ENTRIES);
+      entry->ch = ch;
+      entry->size = size;
+      entry->width = (unsigned char)w;
+      entry->height = (unsigned char)h;
+      memset(entry->bmp, 0, sizeof(entry->bmp));
+      // render via a throwaway JsGraphics that plots into the bitmap
+      JsGraphics cacheGfx;
+      graphicsStructInit(&cacheGfx);
+      cacheGfx.graphicsVar = 0;
+      cacheGfx.data.type = JSGRAPHICSTYPE_ARRAYBUFFER;
+      cacheGfx.data.width = (unsigned short)w;
+      cacheGfx.data.height = (unsigned short)h;
+      cacheGfx.data.bpp = 1;
+      cacheGfx.setPixel = vectorFontCacheSetPixel;
+      cacheGfx.fillRect = vectorFontCacheFillRect;
+      cacheGfx.getPixel = vectorFontCacheGetPixel;
+      vectorFontCacheTarget = entry;
+      graphicsFillVectorCharPolys(&cacheGfx, 0, 0, size, vertOffset, vector.vertCount);
+      if (jspIsInterrupted()) {
+        entry->ch = 0; // don't keep a half-rendered glyph
+        entry = 0;
+      }
     }
   }
+  if (entry) {
+    // blit the cached glyph as horizontal runs
+    int x,y;
+    for (y=0;y<entry->height;y++) {
+      unsigned int rowIdx = (unsigned int)y*entry->width;
+      x = 0;
+      while (x<entry->width) {
+        if (entry->bmp[(rowIdx+(unsigned int)x)>>3] & (1<<((rowIdx+(unsigned int)x)&7))) {
+          int xe = x;
+          while (xe+1<entry->width &&
+                 (entry->bmp[(rowIdx+(unsigned int)(xe+1))>>3] & (1<<((rowIdx+(unsigned int)(xe+1))&7))))
+            xe++;
+          graphicsFillRect(gfx, (short)(x1+x), (short)(y1+y), (short)(x1+xe), (short)(y1+y));
+          x = xe+1;
+        } else x++;
+      }
+    }
+  } else {
+    graphicsFillVectorCharPolys(gfx, x1, y1, size, vertOffset, vector.vertCount);
+  }
   return (vector.width * (unsigned int)size)/(VECTOR_FONT_POLY_SIZE*2);
 }
 
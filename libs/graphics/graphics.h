@@ -23,6 +23,7 @@ typedef enum {
   JSGRAPHICSTYPE_JS,          ///< Call JavaScript when we want to write something
   JSGRAPHICSTYPE_FSMC,        ///< FSMC (or fake FSMC) ILI9325 16bit-wide LCDs
   JSGRAPHICSTYPE_SDL,         ///< SDL graphics library for linux
+  JSGRAPHICSTYPE_PCD8544,     ///< PCD8544 (Nokia 5110) LCD - ArrayBuffer storage with a dirty-window SPI flip
 } JsGraphicsType;
 
 typedef enum {
@@ -71,6 +72,7 @@ typedef struct JsGraphics {
   void (*setPixel)(struct JsGraphics *gfx, short x, short y, unsigned int col);
   void (*fillRect)(struct JsGraphics *gfx, short x1, short y1, short x2, short y2);
   unsigned int (*getPixel)(struct JsGraphics *gfx, short x, short y);
+  void (*scroll)(struct JsGraphics *gfx, int xdir, int ydir); ///< scroll in DEVICE coordinates - exposed area is filled with bgColor
 } PACKED_FLAGS JsGraphics;
 
 static inline void graphicsStructInit(JsGraphics *gfx) {
@@ -98,11 +100,13 @@ unsigned int graphicsGetPixel(JsGraphics *gfx, short x, short y);
 void         graphicsClear(JsGraphics *gfx);
 void         graphicsFillRect(JsGraphics *gfx, short x1, short y1, short x2, short y2);
 void graphicsFallbackFillRect(JsGraphics *gfx, short x1, short y1, short x2, short y2); // Simple fillrect - doesn't call device-specific FR
+void graphicsFallbackScroll(JsGraphics *gfx, int xdir, int ydir); // Simple scroll - doesn't call device-specific scroll
 void graphicsDrawRect(JsGraphics *gfx, short x1, short y1, short x2, short y2);
 void graphicsDrawCircle(JsGraphics *gfx, short posX, short posY, short rad);
 void graphicsFillCircle(JsGraphics *gfx, short x, short y, short rad);
 void graphicsDrawString(JsGraphics *gfx, short x1, short y1, const char *str);
 void graphicsDrawLine(JsGraphics *gfx, short x1, short y1, short x2, short y2);
+void graphicsScroll(JsGraphics *gfx, int xdir, int ydir); ///< scroll - leftover area is filled with the background color
 void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices); // may overwrite vertices...
 #ifndef SAVE_ON_FLASH
 unsigned int graphicsFillVectorChar(JsGraphics *gfx, short x1, short y1, short size, char ch); ///< prints character, returns width
@@ -25,6 +25,9 @@
 #ifdef USE_LCD_FSMC
 #include "lcd_fsmc.h"
 #endif
+#ifdef USE_LCD_PCD8544
+#include "lcd_pcd8544.h"
+#endif
 #include "bitmap_font_4x6.h"
 
 /*JSON{
@@ -44,6 +47,16 @@ Use Graphics.createXXX to create a graphics object that renders in the way you w
 }*/
 bool jswrap_graphics_idle() {
   graphicsIdle();
+#if defined(USE_LCD_FSMC) && !defined(SAVE_ON_FLASH)
+  if (lcdFSMC_idle()) {
+    // a background flip finished - let JS know it can render the next frame
+    JsVar *lcd = jsvObjectGetChild(execInfo.root, "LCD", 0);
+    if (lcd) {
+      jsiQueueObjectCallbacks(lcd, JS_EVENT_PREFIX"flip", NULL, 0);
+      jsvUnLock(lcd);
+    }
+  }
+#endif
   return false;
 }
 
@@ -70,6 +83,25 @@ void jswrap_graphics_init() {
     jsvUnLock2(parentObj, parent);
   }
 #endif
+#ifdef USE_LCD_PCD8544
+  JsVar *parent = jspNewObject("LCD", "Graphics");
+  if (parent) {
+    JsVar *parentObj = jsvSkipName(parent);
+    JsGraphics gfx;
+    graphicsStructInit(&gfx);
+    gfx.data.type = JSGRAPHICSTYPE_PCD8544;
+    gfx.graphicsVar = parentObj;
+    gfx.data.flags = JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE;
+    lcdSetCallbacks_PCD8544(&gfx); // sets width/height/bpp
+    lcdInit_ArrayBuffer(&gfx); // allocate the offscreen buffer
+    lcdInit_PCD8544(&gfx); // set the panel up
+    graphicsSplash(&gfx);
+    graphicsSetVar(&gfx);
+    lcdFlip_PCD8544(&gfx);
+    graphicsSetVar(&gfx);
+    jsvUnLock2(parentObj, parent);
+  }
+#endif
 }
 
 
@@ -839,6 +871,91 @@ void jswrap_graphics_fillPoly(JsVar *parent, JsVar *poly) {
   graphicsSetVar(&gfx); // gfx data changed because modified area
 }
 
+#ifndef SAVE_ON_FLASH
+/// read scale/offset options and stream (x,y) pairs from an iterable, drawing line segments natively
+static void _jswrap_graphics_drawLineList(JsGraphics *gfx, JsVar *lines, JsVar *options, bool connected, bool closed) {
+  if (!jsvIsIterable(lines)) return;
+  JsVarFloat scaleX = 1, scaleY = 1, offsetX = 0, offsetY = 0;
+  if (jsvIsObject(options)) {
+    JsVar *v = jsvObjectGetChild(options, "scale", 0);
+    if (v) scaleX = scaleY = jsvGetFloatAndUnLock(v);
+    v = jsvObjectGetChild(options, "scaleX", 0);
+    if (v) scaleX = jsvGetFloatAndUnLock(v);
+    v = jsvObjectGetChild(options, "scaleY", 0);
+    if (v) scaleY = jsvGetFloatAndUnLock(v);
+    offsetX = jsvGetFloatAndUnLock(jsvObjectGetChild(options, "x", 0));
+    offsetY = jsvGetFloatAndUnLock(jsvObjectGetChild(options, "y", 0));
+    if (isnan(offsetX)) offsetX = 0;
+    if (isnan(offsetY)) offsetY = 0;
+  }
+  short firstX = 0, firstY = 0, lastX = 0, lastY = 0;
+  int points = 0; // x,y pairs read so far
+  JsvIterator it;
+  jsvIteratorNew(&it, lines, JSIF_EVERY_ARRAY_ELEMENT);
+  while (jsvIteratorHasElement(&it)) {
+    JsVarFloat vf = jsvIteratorGetFloatValue(&it)*scaleX + offsetX;
+    short x = (short)((vf<0) ? (vf-0.5) : (vf+0.5));
+    jsvIteratorNext(&it);
+    if (!jsvIteratorHasElement(&it)) break; // stray X without a Y
+    vf = jsvIteratorGetFloatValue(&it)*scaleY + offsetY;
+    short y = (short)((vf<0) ? (vf-0.5) : (vf+0.5));
+    jsvIteratorNext(&it);
+    if (points==0) {
+      firstX = x; firstY = y;
+    } else if (connected || (points&1)) // drawLines pairs points up, drawPoly connects them all
+      graphicsDrawLine(gfx, lastX, lastY, x, y);
+    lastX = x; lastY = y;
+    points++;
+    if (jspIsInterrupted()) break;
+  }
+  jsvIteratorFree(&it);
+  if (closed && points>2)
+    graphicsDrawLine(gfx, lastX, lastY, firstX, firstY);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "drawPoly",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_drawPoly",
+  "params" : [
+    ["poly","JsVar","An array of vertices, of the form ```[x1,y1,x2,y2,x3,y3,etc]```"],
+    ["closed","bool","Draw another line between the last element of the array and the first"],
+    ["options","JsVar","Optional `{x,y,scale,scaleX,scaleY}` - every vertex is scaled then offset before drawing"]
+  ]
+}
+Draw a polyline (connected line segments) in the current foreground color. The
+whole array is walked natively, so plotting a several hundred point sensor
+graph is one call rather than one `drawLine` per segment
+*/
+void jswrap_graphics_drawPoly(JsVar *parent, JsVar *poly, bool closed, JsVar *options) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  _jswrap_graphics_drawLineList(&gfx, poly, options, true, closed);
+  graphicsSetVar(&gfx); // gfx data changed because modified area
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "drawLines",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_drawLines",
+  "params" : [
+    ["lines","JsVar","An array of line segments, of the form ```[x1,y1,x2,y2, x3,y3,x4,y4, etc]```"],
+    ["options","JsVar","Optional `{x,y,scale,scaleX,scaleY}` - every vertex is scaled then offset before drawing"]
+  ]
+}
+Draw unconnected line segments in the current foreground color - each group of
+4 array elements is one line
+*/
+void jswrap_graphics_drawLines(JsVar *parent, JsVar *lines, JsVar *options) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  _jswrap_graphics_drawLineList(&gfx, lines, options, false, false);
+  graphicsSetVar(&gfx); // gfx data changed because modified area
+}
+#endif
+
 /*JSON{
   "type" : "method",
   "class" : "Graphics",
@@ -887,7 +1004,7 @@ void jswrap_graphics_setRotation(JsVar *parent, int rotation, bool reflect) {
   "name" : "drawImage",
   "generate" : "jswrap_graphics_drawImage",
   "params" : [
-    ["image","JsVar","An object with the following fields `{ width : int, height : int, bpp : int, buffer : ArrayBuffer, transparent: optional int }`. bpp = bits per pixel, transparent (if defined) is the colour that will be treated as transparent"],
+    ["image","JsVar","An object with the following fields `{ width : int, height : int, bpp : int, buffer : ArrayBuffer, transparent: optional int }`. bpp = bits per pixel, transparent (if defined) is the colour that will be treated as transparent, and palette (if defined) is an array of 2^bpp colours that pixel values are looked up in, so a 1/2/4/8 bit image can be drawn to a 16 bit display without converting it in JS first. Another ArrayBuffer Graphics of the same format can also be supplied, in which case its contents are copied row by row"],
     ["x","int32","The X offset to draw the image"],
     ["y","int32","The Y offset to draw the image"]
   ]
@@ -900,14 +1017,42 @@ void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos)
     jsExceptionHere(JSET_ERROR, "Expecting first argument to be an object");
     return;
   }
-  int imageWidth = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "width", 0));
-  int imageHeight = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "height", 0));
-  int imageBpp = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "bpp", 0));
+  int imageWidth, imageHeight, imageBpp;
+  bool imageIsTransparent = false;
+  unsigned int imageTransparentCol = 0;
+  bool imageIsGraphics = false;
+#ifndef SAVE_ON_FLASH
+  JsVar *srcGfxData = jsvObjectGetChild(image, JS_HIDDEN_CHAR_STR"gfx", 0);
+  if (srcGfxData) {
+    // the image is another Graphics instance - we can blit it
+    jsvUnLock(srcGfxData);
+    JsGraphics srcGfx;
+    if (!graphicsGetFromVar(&srcGfx, image)) return;
+    imageIsGraphics = true;
+    imageWidth = srcGfx.data.width;
+    imageHeight = srcGfx.data.height;
+    imageBpp = srcGfx.data.bpp;
+    // blitting copies raw rows, so both sides must share a plain layout
+    if (srcGfx.data.type!=JSGRAPHICSTYPE_ARRAYBUFFER ||
+        imageBpp!=gfx.data.bpp || (imageBpp&7) ||
+        ((srcGfx.data.flags|gfx.data.flags) &
+         (JSGRAPHICSFLAGS_SWAP_XY|JSGRAPHICSFLAGS_INVERT_X|JSGRAPHICSFLAGS_INVERT_Y|
+          JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG|JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE))) {
+      jsExceptionHere(JSET_ERROR, "Can only draw a Graphics onto a flat ArrayBuffer Graphics with matching bpp and no rotation");
+      return;
+    }
+  } else
+#endif
+  {
+    imageWidth = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "width", 0));
+    imageHeight = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "height", 0));
+    imageBpp = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "bpp", 0));
+    JsVar *transpVar = jsvObjectGetChild(image, "transparent", 0);
+    imageIsTransparent = transpVar!=0;
+    imageTransparentCol = (unsigned int)jsvGetInteger(transpVar);
+    jsvUnLock(transpVar);
+  }
   unsigned int imageBitMask = (unsigned int)((1L<<imageBpp)-1L);
-  JsVar *transpVar = jsvObjectGetChild(image, "transparent", 0);
-  bool imageIsTransparent = transpVar!=0;
-  unsigned int imageTransparentCol = (unsigned int)jsvGetInteger(transpVar);
-  jsvUnLock(transpVar);
   JsVar *imageBuffer = jsvObjectGetChild(image, "buffer", 0);
   if (!(jsvIsArrayBuffer(imageBuffer) && imageWidth>0 && imageHeight>0 && imageBpp>0 && imageBpp<=32)) {
     jsExceptionHere(JSET_ERROR, "Expecting first argument to a valid Image");
@@ -916,7 +1061,136 @@ void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos)
   }
   JsVar *imageBufferString = jsvGetArrayBufferBackingString(imageBuffer);
   jsvUnLock(imageBuffer);
+#ifndef SAVE_ON_FLASH
+  /* optional palette - lets a low-bpp image be expanded to the target's
+   * color depth through a lookup table as it is drawn */
+  unsigned int imagePalette[256];
+  int imagePaletteLen = 0;
+  JsVar *paletteVar = imageIsGraphics ? 0 : jsvObjectGetChild(image, "palette", 0);
+  if (paletteVar) {
+    bool paletteOk = jsvIsIterable(paletteVar) && imageBpp<=8;
+    if (paletteOk) {
+      JsvIterator pit;
+      jsvIteratorNew(&pit, paletteVar, JSIF_EVERY_ARRAY_ELEMENT);
+      while (jsvIteratorHasElement(&pit) && imagePaletteLen<256) {
+        imagePalette[imagePaletteLen++] = (unsigned int)jsvIteratorGetIntegerValue(&pit);
+        jsvIteratorNext(&pit);
+      }
+      jsvIteratorFree(&pit);
+      if (imagePaletteLen < (1<<imageBpp)) paletteOk = false;
+    }
+    jsvUnLock(paletteVar);
+    if (!paletteOk) {
+      jsExceptionHere(JSET_ERROR, "Image palette must have 2^bpp entries (bpp up to 8)");
+      jsvUnLock(imageBufferString);
+      return;
+    }
+  }
+#endif
 
+#ifndef SAVE_ON_FLASH
+  /* Fast path - when drawing into an unrotated whole-byte ArrayBuffer
+   * Graphics we can work on rows directly: a straight memcpy when the
+   * formats match, or a per-row decode loop for other image formats.
+   * Everything else (rotation, zigzag, vertical byte, sub-byte targets)
+   * drops through to the per-pixel loop below. */
+  if (gfx.data.type==JSGRAPHICSTYPE_ARRAYBUFFER &&
+      (gfx.data.bpp&7)==0 &&
+      !(gfx.data.flags & (JSGRAPHICSFLAGS_SWAP_XY|JSGRAPHICSFLAGS_INVERT_X|JSGRAPHICSFLAGS_INVERT_Y|
+                          JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG|JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE))) {
+    size_t tgtLen = 0, srcLen = 0;
+    char *tgtPtr = 0;
+    unsigned int tgtOffset = 0;
+    JsVar *tgtBuf = jsvObjectGetChild(gfx.graphicsVar, "buffer", 0);
+    if (tgtBuf && jsvIsArrayBuffer(tgtBuf)) {
+      JsVar *tgtBacking = jsvGetArrayBufferBackingString(tgtBuf);
+      if (tgtBacking) {
+        tgtPtr = jsvGetDataPointer(tgtBacking, &tgtLen); // 0 unless flat
+        jsvUnLock(tgtBacking);
+      }
+      tgtOffset = tgtBuf->varData.arraybuffer.byteOffset;
+    }
+    jsvUnLock(tgtBuf);
+    char *srcPtr = jsvGetDataPointer(imageBufferString, &srcLen);
+    if (tgtPtr && srcPtr) {
+      // visible part of the image
+      int sx0 = (xPos<0) ? -xPos : 0;
+      int sy0 = (yPos<0) ? -yPos : 0;
+      int sx1 = imageWidth-1;
+      if (xPos+sx1 >= gfx.data.width) sx1 = gfx.data.width-1-xPos;
+      int sy1 = imageHeight-1;
+      if (yPos+sy1 >= gfx.data.height) sy1 = gfx.data.height-1-yPos;
+      if (sx1>=sx0 && sy1>=sy0) {
+        unsigned int tgtBytesPP = (unsigned int)gfx.data.bpp>>3;
+        /* images pack pixels MSB-first but the ArrayBuffer layout is LSB
+         * first, so byte-identical row copies only work for 8 bit images -
+         * or for Graphics sources, which share the target's layout */
+        bool rowCopy = (imageBpp==gfx.data.bpp) && !imageIsTransparent &&
+                       !imagePaletteLen && (imageBpp==8 || imageIsGraphics);
+        bool ok = true;
+        int ix,iy;
+        for (iy=sy0;ok && iy<=sy1;iy++) {
+          unsigned int tgtByte = tgtOffset + (unsigned int)((xPos+sx0) + (yPos+iy)*gfx.data.width)*tgtBytesPP;
+          char *t = tgtPtr + tgtByte;
+          if (rowCopy) {
+            unsigned int srcByte = (unsigned int)(sx0 + iy*imageWidth)*tgtBytesPP;
+            unsigned int n = (unsigned int)(1+sx1-sx0)*tgtBytesPP;
+            if (srcByte+n>srcLen || tgtByte+n>tgtLen) { ok = false; break; }
+            memcpy(t, srcPtr+srcByte, n);
+          } else {
+            if (tgtByte+(unsigned int)(1+sx1-sx0)*tgtBytesPP > tgtLen) { ok = false; break; }
+            for (ix=sx0;ix<=sx1;ix++) {
+              // gather this pixel's bits (images are packed MSB-first)
+              unsigned int bitIdx = (unsigned int)(ix + iy*imageWidth)*(unsigned int)imageBpp;
+              unsigned int byteIdx = bitIdx>>3;
+              int bitOff = (int)(bitIdx&7);
+              unsigned int acc = 0;
+              int got = 0;
+              while (got < bitOff+imageBpp) {
+                acc = (acc<<8) | (byteIdx<srcLen ? (unsigned char)srcPtr[byteIdx] : 0);
+                byteIdx++;
+                got += 8;
+              }
+              unsigned int col = (acc >> (got-bitOff-imageBpp)) & imageBitMask;
+              if (imageIsTransparent && col==imageTransparentCol) { t += tgtBytesPP; continue; }
+              if (imagePaletteLen)
+                col = imagePalette[col];
+              else if (imageBpp==1)
+                col = col ? gfx.data.fgColor : gfx.data.bgColor;
+              unsigned int b;
+              for (b=0;b<tgtBytesPP;b++) // LSB first, matching lcdSetPixels_ArrayBuffer
+                *(t++) = (char)(col >> (b<<3));
+            }
+          }
+        }
+        if (ok) {
+          // update the modified area in one go
+          if (xPos+sx0 < gfx.data.modMinX) gfx.data.modMinX=(short)(xPos+sx0);
+          if (xPos+sx1 > gfx.data.modMaxX) gfx.data.modMaxX=(short)(xPos+sx1);
+          if (yPos+sy0 < gfx.data.modMinY) gfx.data.modMinY=(short)(yPos+sy0);
+          if (yPos+sy1 > gfx.data.modMaxY) gfx.data.modMaxY=(short)(yPos+sy1);
+          jsvUnLock(imageBufferString);
+          graphicsSetVar(&gfx);
+          return;
+        }
+      } else {
+        // nothing visible
+        jsvUnLock(imageBufferString);
+        return;
+      }
+    }
+  }
+#endif
+
+#ifndef SAVE_ON_FLASH
+  if (imageIsGraphics) {
+    /* the per-pixel loop below decodes MSB-first image data, which isn't how
+     * a Graphics buffer is laid out - we only support the blit above */
+    jsExceptionHere(JSET_ERROR, "Can only draw a Graphics onto a flat ArrayBuffer Graphics with matching bpp and no rotation");
+    jsvUnLock(imageBufferString);
+    return;
+  }
+#endif
 
   int x=0, y=0;
   int bits=0;
@@ -935,6 +1209,11 @@ void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos)
     bits -= imageBpp;
     // Try and write pixel!
     if (!imageIsTransparent || imageTransparentCol!=col) {
+#ifndef SAVE_ON_FLASH
+      if (imagePaletteLen)
+        col = imagePalette[col];
+      else
+#endif
       if (imageBpp==1)
         col = col ? gfx.data.fgColor : gfx.data.bgColor;
       graphicsSetPixel(&gfx, (short)(x+xPos), (short)(y+yPos), col);
@@ -953,6 +1232,29 @@ void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos)
   graphicsSetVar(&gfx); // gfx data changed because modified area
 }
 
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "scroll",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_scroll",
+  "params" : [
+    ["x","int32","X direction. >0 = to right"],
+    ["y","int32","Y direction. >0 = down"]
+  ]
+}
+Scroll the contents of this graphics in a certain direction. The remaining area
+is filled with the background color.
+
+On ArrayBuffer-backed graphics this moves whole rows of the buffer at once, so
+scrolling a terminal-style display up a line is vastly faster than redrawing it
+*/
+void jswrap_graphics_scroll(JsVar *parent, int xdir, int ydir) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  graphicsScroll(&gfx, xdir, ydir);
+  graphicsSetVar(&gfx); // gfx data changed because modified area
+}
+
 /*JSON{
   "type" : "method",
   "class" : "Graphics",
@@ -989,3 +1291,73 @@ JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
   }
   return obj;
 }
+
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "flip",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_flip",
+  "params" : [
+    ["source","JsVar","(FSMC LCDs only) a 16 bit ArrayBuffer Graphics of the panel's size holding the frame to display"]
+  ]
+}
+Send an offscreen buffer to the display.
+
+On PCD8544 displays only the modified window of this Graphics' own buffer is
+transferred, so small updates are quick.
+
+On FSMC LCDs the panel has no local buffer, so pass an offscreen 16 bit
+ArrayBuffer Graphics of the same size - where DMA is available the frame
+streams out in the background while your code keeps running, and a `flip`
+event is emitted on `LCD` when the transfer completes. Keep a reference to
+the buffer until then
+*/
+void jswrap_graphics_flip(JsVar *parent, JsVar *source) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+#ifdef USE_LCD_PCD8544
+  if (gfx.data.type == JSGRAPHICSTYPE_PCD8544) {
+    NOT_USED(source);
+    lcdFlip_PCD8544(&gfx); // resets the modified area
+    graphicsSetVar(&gfx);
+    return;
+  }
+#endif
+#ifdef USE_LCD_FSMC
+  if (gfx.data.type == JSGRAPHICSTYPE_FSMC) {
+    JsGraphics src;
+    if (!jsvIsObject(source) || !graphicsGetFromVar(&src, source)) {
+      jsExceptionHere(JSET_ERROR, "Expecting an ArrayBuffer Graphics to flip from");
+      return;
+    }
+    char *ptr = 0;
+    size_t len = 0;
+    if (src.data.type==JSGRAPHICSTYPE_ARRAYBUFFER && src.data.bpp==16 &&
+        !(src.data.flags&(JSGRAPHICSFLAGS_SWAP_XY|JSGRAPHICSFLAGS_INVERT_X|JSGRAPHICSFLAGS_INVERT_Y|
+                          JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG|JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE)) &&
+        src.data.width==gfx.data.width && src.data.height==gfx.data.height) {
+      JsVar *buf = jsvObjectGetChild(source, "buffer", 0);
+      if (buf && jsvIsArrayBuffer(buf)) {
+        JsVar *backing = jsvGetArrayBufferBackingString(buf);
+        if (backing) {
+          ptr = jsvGetDataPointer(backing, &len); // 0 unless flat
+          if (ptr) {
+            ptr += buf->varData.arraybuffer.byteOffset;
+            len -= buf->varData.arraybuffer.byteOffset;
+          }
+          jsvUnLock(backing);
+        }
+      }
+      jsvUnLock(buf);
+    }
+    unsigned int pixels = (unsigned int)(gfx.data.width*gfx.data.height);
+    if (!ptr || (size_t)(pixels*2) > len) {
+      jsExceptionHere(JSET_ERROR, "Source must be a flat unrotated 16 bit ArrayBuffer Graphics matching the panel size");
+      return;
+    }
+    lcdFSMC_flip(&gfx, (unsigned short*)ptr, pixels);
+    return;
+  }
+#endif
+  NOT_USED(source);
+}
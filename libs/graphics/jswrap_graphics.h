@@ -47,5 +47,9 @@ void jswrap_graphics_lineTo(JsVar *parent, int x, int y);
 void jswrap_graphics_moveTo(JsVar *parent, int x, int y);
 void jswrap_graphics_fillPoly(JsVar *parent, JsVar *poly);
 void jswrap_graphics_setRotation(JsVar *parent, int rotation, bool reflect);
+void jswrap_graphics_drawPoly(JsVar *parent, JsVar *poly, bool closed, JsVar *options);
+void jswrap_graphics_drawLines(JsVar *parent, JsVar *lines, JsVar *options);
 void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos);
+void jswrap_graphics_scroll(JsVar *parent, int xdir, int ydir);
 JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset);
+void jswrap_graphics_flip(JsVar *parent, JsVar *source);
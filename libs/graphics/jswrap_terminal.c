@@ -0,0 +1,204 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * VT100-ish text terminal rendered to a Graphics instance, usable as a
+ * console device
+ *
+ * Characters sent to EV_TERMINAL land in a cell grid here; each changed
+ * cell is flagged and only those cells are redrawn (from the idle loop, so
+ * a burst of output repaints each cell once). Scrolling a line uses the
+ * native Graphics scroll rather than redrawing the whole grid.
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_terminal.h"
+#include "jsdevices.h"
+#include "jsinteractive.h"
+#include "jsparse.h"
+#include "graphics.h"
+#include "jswrap_graphics.h"
+#include "bitmap_font_4x6.h"
+
+// cell size of the built-in 4x6 font
+#define TERMINAL_CHAR_W 4
+#define TERMINAL_CHAR_H 6
+// grid size - boards should set these in their platform config to match their display
+#ifndef TERMINAL_COLS
+#define TERMINAL_COLS 40
+#endif
+#ifndef TERMINAL_ROWS
+#define TERMINAL_ROWS 8
+#endif
+
+static char terminalChars[TERMINAL_ROWS][TERMINAL_COLS];
+static unsigned char terminalDirty[TERMINAL_ROWS][(TERMINAL_COLS+7)>>3];
+static unsigned char terminalX = 0, terminalY = 0;
+static unsigned char terminalScrollPending = 0; ///< rows scrolled off since the last flush
+static bool terminalNeedsFlush = false;
+/// escape sequence decoding: 0=none, 1=had ESC, 2=had ESC [ (+ any digits/modifiers)
+static unsigned char terminalEscState = 0;
+
+static void terminalSetCell(int x, int y, char ch) {
+  if (x<0 || y<0 || x>=TERMINAL_COLS || y>=TERMINAL_ROWS) return;
+  if (terminalChars[y][x] == ch) return;
+  terminalChars[y][x] = ch;
+  terminalDirty[y][x>>3] |= (unsigned char)(1<<(x&7));
+  terminalNeedsFlush = true;
+}
+
+/// clear from the cursor to the end of the line, and every line below (ESC [ J)
+static void terminalClearBelow() {
+  int x, y;
+  for (x=terminalX;x<TERMINAL_COLS;x++)
+    terminalSetCell(x, terminalY, ' ');
+  for (y=terminalY+1;y<TERMINAL_ROWS;y++)
+    for (x=0;x<TERMINAL_COLS;x++)
+      terminalSetCell(x, y, ' ');
+}
+
+static void terminalScrollUp() {
+  memmove(terminalChars[0], terminalChars[1], sizeof(terminalChars)-TERMINAL_COLS);
+  memmove(terminalDirty[0], terminalDirty[1], sizeof(terminalDirty)-sizeof(terminalDirty[0]));
+  int x;
+  memset(terminalDirty[TERMINAL_ROWS-1], 0, sizeof(terminalDirty[0]));
+  for (x=0;x<TERMINAL_COLS;x++) {
+    terminalChars[TERMINAL_ROWS-1][x] = ' ';
+    // the graphics scroll clears the exposed line so these cells aren't dirtied
+  }
+  if (terminalScrollPending < TERMINAL_ROWS)
+    terminalScrollPending++;
+  terminalNeedsFlush = true;
+}
+
+void terminalSendChar(char c) {
+  if (terminalEscState==1) {
+    terminalEscState = (c=='[') ? 2 : 0;
+    return;
+  }
+  if (terminalEscState==2) {
+    if ((c>='0' && c<='9') || c=='?' || c==';') return; // parameters - ignored
+    terminalEscState = 0;
+    if (c=='A' && terminalY>0) terminalY--;
+    if (c=='B' && terminalY+1<TERMINAL_ROWS) terminalY++;
+    if (c=='C' && terminalX+1<TERMINAL_COLS) terminalX++;
+    if (c=='D' && terminalX>0) terminalX--;
+    if (c=='J') terminalClearBelow();
+    return;
+  }
+  if (c==27) {
+    terminalEscState = 1;
+  } else if (c=='\r') {
+    terminalX = 0;
+  } else if (c=='\n') {
+    terminalY++;
+  } else if (c==8) { // backspace just moves the cursor - the console overwrites
+    if (terminalX>0) terminalX--;
+  } else if ((unsigned char)c>=32) {
+    terminalSetCell(terminalX, terminalY, c);
+    terminalX++;
+    if (terminalX>=TERMINAL_COLS) {
+      terminalX = 0;
+      terminalY++;
+    }
+  }
+  while (terminalY>=TERMINAL_ROWS) {
+    terminalScrollUp();
+    terminalY--;
+  }
+}
+
+/// the Graphics instance to render to - the global `LCD` (boards create it, or assign your own)
+static JsVar *terminalGetGraphicsVar() {
+  return jsvObjectGetChild(execInfo.root, "LCD", 0);
+}
+
+/// redraw just the cells that changed since the last flush
+static void terminalFlush() {
+  terminalNeedsFlush = false;
+  JsVar *gfxVar = terminalGetGraphicsVar();
+  if (!gfxVar) {
+    terminalScrollPending = 0; // nowhere to draw - forget pending scrolls too
+    return;
+  }
+  JsGraphics gfx;
+  if (!graphicsGetFromVar(&gfx, gfxVar)) {
+    jsvUnLock(gfxVar);
+    return;
+  }
+  if (terminalScrollPending) {
+    if (terminalScrollPending >= TERMINAL_ROWS ||
+        terminalScrollPending*TERMINAL_CHAR_H >= gfx.data.height) {
+      graphicsClear(&gfx);
+      // everything was cleared, so every cell with a character needs a redraw
+      int x, y;
+      for (y=0;y<TERMINAL_ROWS;y++)
+        for (x=0;x<TERMINAL_COLS;x++)
+          if (terminalChars[y][x]!=' ')
+            terminalDirty[y][x>>3] |= (unsigned char)(1<<(x&7));
+    } else {
+      graphicsScroll(&gfx, 0, -TERMINAL_CHAR_H*terminalScrollPending);
+    }
+    terminalScrollPending = 0;
+  }
+  int x, y;
+  for (y=0;y<TERMINAL_ROWS;y++) {
+    for (x=0;x<TERMINAL_COLS;x++) {
+      if (!(terminalDirty[y][x>>3] & (1<<(x&7)))) continue;
+      short px = (short)(x*TERMINAL_CHAR_W), py = (short)(y*TERMINAL_CHAR_H);
+      // the font only plots foreground pixels, so clear the cell first
+      unsigned int c = gfx.data.fgColor;
+      gfx.data.fgColor = gfx.data.bgColor;
+      graphicsFillRect(&gfx, px, py, (short)(px+TERMINAL_CHAR_W-1), (short)(py+TERMINAL_CHAR_H-1));
+      gfx.data.fgColor = c;
+      graphicsDrawChar4x6(&gfx, px, py, terminalChars[y][x]);
+    }
+    memset(terminalDirty[y], 0, sizeof(terminalDirty[0]));
+  }
+  graphicsSetVar(&gfx);
+#ifdef USE_LCD_PCD8544
+  if (gfx.data.type == JSGRAPHICSTYPE_PCD8544)
+    jswrap_graphics_flip(gfxVar, 0); // only sends the cells we just touched
+#endif
+  jsvUnLock(gfxVar);
+}
+
+/*JSON{
+  "type" : "object",
+  "name" : "Terminal",
+  "instanceof" : "Serial",
+  "ifdef" : "USE_TERMINAL"
+}
+A simple text terminal rendered to the `LCD` Graphics instance using the 4x6
+font and its current foreground/background colours. Use `Terminal.setConsole()`
+to run the interactive console on a display
+*/
+
+/*JSON{
+  "type" : "init",
+  "generate" : "jswrap_terminal_init"
+}*/
+void jswrap_terminal_init() {
+  memset(terminalChars, ' ', sizeof(terminalChars));
+  memset(terminalDirty, 0, sizeof(terminalDirty));
+  terminalX = 0;
+  terminalY = 0;
+  terminalEscState = 0;
+  terminalScrollPending = 0;
+  terminalNeedsFlush = false;
+}
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_terminal_idle"
+}*/
+bool jswrap_terminal_idle() {
+  if (terminalNeedsFlush)
+    terminalFlush();
+  return false;
+}
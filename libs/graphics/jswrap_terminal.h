@@ -0,0 +1,21 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * VT100-ish text terminal rendered to a Graphics instance, usable as a
+ * console device
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+/// called by jshTransmit when a character is sent to EV_TERMINAL
+void terminalSendChar(char c);
+
+void jswrap_terminal_init();
+bool jswrap_terminal_idle();
@@ -111,10 +111,127 @@ void lcdSetPixel_ArrayBuffer(JsGraphics *gfx, short x, short y, unsigned int col
 
 void  lcdFillRect_ArrayBuffer(struct JsGraphics *gfx, short x1, short y1, short x2, short y2) {
   short y;
+#ifndef SAVE_ON_FLASH
+  /* Fast path: whole-byte pixels in a flat-string-backed buffer can be
+   * filled with straight memory writes rather than one iterator step per
+   * pixel. Zigzag only reverses a row so a solid fill covers the same bytes,
+   * but vertical-byte layouts interleave rows and must take the slow path. */
+  if ((gfx->data.bpp&7)==0 && !(gfx->data.flags&JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE)) {
+    JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
+    char *ptr = 0;
+    size_t flatLen = 0;
+    if (buf && jsvIsArrayBuffer(buf)) {
+      JsVar *backing = jsvGetArrayBufferBackingString(buf);
+      if (backing) {
+        ptr = jsvGetDataPointer(backing, &flatLen); // 0 unless flat
+        jsvUnLock(backing); // buf still references it so the data stays put
+      }
+    }
+    if (ptr) {
+      unsigned int col = gfx->data.fgColor;
+      unsigned int bytesPerPixel = (unsigned int)gfx->data.bpp>>3;
+      unsigned int rowPixels = (unsigned int)(1+x2-x1);
+      unsigned int rowBytes = rowPixels*bytesPerPixel;
+      for (y=y1;y<=y2;y++) {
+        unsigned int startByte = (unsigned int)buf->varData.arraybuffer.byteOffset +
+            (lcdGetPixelIndex_ArrayBuffer(gfx,x1,y,(int)rowPixels)>>3);
+        if (startByte+rowBytes > flatLen) break; // sanity check - fall back for the rest
+        char *p = ptr + startByte;
+        if (bytesPerPixel==1) {
+          memset(p, (int)(col&0xFF), rowBytes);
+        } else {
+          unsigned int i, b;
+          for (i=0;i<rowBytes;) // fill with the pixel's bytes, LSB first
+            for (b=0;b<bytesPerPixel;b++)
+              p[i++] = (char)(col >> (b<<3));
+        }
+      }
+      if (y>y2) { // did every row without falling back
+        jsvUnLock(buf);
+        return;
+      }
+      y1 = y;
+    }
+    jsvUnLock(buf);
+  }
+#endif
   for (y=y1;y<=y2;y++)
     lcdSetPixels_ArrayBuffer(gfx, x1, y, (short)(1+x2-x1), gfx->data.fgColor);
 }
 
+#ifndef SAVE_ON_FLASH
+/// fill a rect with the background color (used to clear the area a scroll exposes)
+static void lcdScrollFillRect_ArrayBuffer(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  unsigned int c = gfx->data.fgColor;
+  gfx->data.fgColor = gfx->data.bgColor;
+  lcdFillRect_ArrayBuffer(gfx, x1, y1, x2, y2);
+  gfx->data.fgColor = c;
+}
+
+void lcdScroll_ArrayBuffer(JsGraphics *gfx, int xdir, int ydir) {
+  if (!xdir && !ydir) return;
+  int w = gfx->data.width, h = gfx->data.height;
+  if (xdir<=-w || xdir>=w || ydir<=-h || ydir>=h) {
+    // nothing of the old contents is left
+    lcdScrollFillRect_ArrayBuffer(gfx, 0, 0, (short)(w-1), (short)(h-1));
+    return;
+  }
+  /* Scroll with memmove where rows are contiguous bytes - that's
+   * whole-byte pixels in normal layout, or vertical-byte 1bpp buffers
+   * when scrolling by whole 8 pixel 'pages' (the terminal case). */
+  char *ptr = 0;
+  size_t flatLen = 0;
+  JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
+  if (buf && jsvIsArrayBuffer(buf) && !(gfx->data.flags&JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG)) {
+    JsVar *backing = jsvGetArrayBufferBackingString(buf);
+    if (backing) {
+      ptr = jsvGetDataPointer(backing, &flatLen); // 0 unless flat
+      jsvUnLock(backing);
+    }
+  }
+  bool verticalByte = (gfx->data.flags&JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE)!=0;
+  int rowBytes = 0, rowCount = 0, rowShift = 0; // a 'row' is a line of contiguous bytes
+  if (verticalByte) {
+    if (gfx->data.bpp==1 && !(ydir&7)) {
+      rowBytes = w;
+      rowCount = h>>3;
+      rowShift = ydir>>3;
+    }
+  } else if ((gfx->data.bpp&7)==0) {
+    rowBytes = w*(gfx->data.bpp>>3);
+    rowCount = h;
+    rowShift = ydir;
+  }
+  size_t bufBytes = (size_t)(rowBytes*rowCount);
+  if (ptr && rowBytes &&
+      (size_t)buf->varData.arraybuffer.byteOffset+bufBytes <= flatLen) {
+    ptr += buf->varData.arraybuffer.byteOffset;
+    if (rowShift) // whole rows move in one go
+      memmove(ptr + ((rowShift>0)?rowShift*rowBytes:0),
+              ptr + ((rowShift>0)?0:-rowShift*rowBytes),
+              bufBytes - (size_t)((rowShift>0)?rowShift:-rowShift)*(size_t)rowBytes);
+    if (xdir) {
+      int shiftBytes = verticalByte ? xdir : xdir*(gfx->data.bpp>>3);
+      int r;
+      for (r=0;r<rowCount;r++) {
+        char *row = ptr + r*rowBytes;
+        if (shiftBytes>0) memmove(row+shiftBytes, row, (size_t)(rowBytes-shiftBytes));
+        else memmove(row, row-shiftBytes, (size_t)(rowBytes+shiftBytes));
+      }
+    }
+    // fill the exposed edges with the background color
+    if (ydir>0) lcdScrollFillRect_ArrayBuffer(gfx, 0, 0, (short)(w-1), (short)(ydir-1));
+    else if (ydir<0) lcdScrollFillRect_ArrayBuffer(gfx, 0, (short)(h+ydir), (short)(w-1), (short)(h-1));
+    if (xdir>0) lcdScrollFillRect_ArrayBuffer(gfx, 0, 0, (short)(xdir-1), (short)(h-1));
+    else if (xdir<0) lcdScrollFillRect_ArrayBuffer(gfx, (short)(w+xdir), 0, (short)(w-1), (short)(h-1));
+    jsvUnLock(buf);
+    return;
+  }
+  jsvUnLock(buf);
+  graphicsFallbackScroll(gfx, xdir, ydir);
+}
+#endif
+
 void lcdInit_ArrayBuffer(JsGraphics *gfx) {
   // create buffer
   JsVar *buf = jswrap_arraybuffer_constructor((gfx->data.width * gfx->data.height * gfx->data.bpp + 7) >> 3);
@@ -125,4 +242,7 @@ void lcdSetCallbacks_ArrayBuffer(JsGraphics *gfx) {
   gfx->setPixel = lcdSetPixel_ArrayBuffer;
   gfx->getPixel = lcdGetPixel_ArrayBuffer;
   gfx->fillRect = lcdFillRect_ArrayBuffer;
+#ifndef SAVE_ON_FLASH
+  gfx->scroll = lcdScroll_ArrayBuffer;
+#endif
 }
@@ -14,4 +14,7 @@
 #include "graphics.h"
 
 void lcdInit_ArrayBuffer(JsGraphics *gfx);
+#ifndef SAVE_ON_FLASH
+void lcdScroll_ArrayBuffer(JsGraphics *gfx, int xdir, int ydir);
+#endif
 void lcdSetCallbacks_ArrayBuffer(JsGraphics *gfx);
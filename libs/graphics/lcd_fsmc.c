@@ -1347,8 +1347,103 @@ static inline void lcdSetFullWindow(JsGraphics *gfx) {
 
 
 
+#ifndef SAVE_ON_FLASH
+// ----------------------------------------------------- background frame flip
+#if !defined(ILI9325_BITBANG) && !defined(FSMC_BITBANG)
+/* A completed offscreen frame can be pushed out by DMA (memory-to-memory,
+ * fixed destination of the FSMC data register) while the interpreter gets on
+ * with the next frame. The F1 DMA counter is 16 bit so big panels need the
+ * frame in chunks - the next chunk is started from the idle loop or by
+ * whichever panel access comes next. */
+#define LCD_DMA            DMA2_Channel1
+#define LCD_DMA_FLAG_TC    DMA2_FLAG_TC1
+#define LCD_DMA_MAX_PIXELS 65535
+static unsigned short *lcdDMANext = 0; ///< start of the chunk still to send (0 = none)
+static unsigned int lcdDMANextPixels = 0;
+static bool lcdDMAActive = false;
+static bool lcdDMAFinished = false; ///< a whole flip completed - idle reports it
+
+static void lcdStartDMA(unsigned short *data, unsigned int pixels) {
+  static bool clockEnabled = false;
+  if (!clockEnabled) {
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA2, ENABLE);
+    clockEnabled = true;
+  }
+  unsigned int chunk = (pixels > LCD_DMA_MAX_PIXELS) ? LCD_DMA_MAX_PIXELS : pixels;
+  lcdDMANext = (pixels > chunk) ? data+chunk : 0;
+  lcdDMANextPixels = pixels - chunk;
+  DMA_InitTypeDef DMA_InitStructure;
+  DMA_StructInit(&DMA_InitStructure);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)data; // source (DMA_DIR_PeripheralSRC)
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Enable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+  DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&LCD_RAM; // destination, never incremented
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_BufferSize = (uint16_t)chunk;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Enable; // transfer starts when the channel is enabled
+  DMA_DeInit(LCD_DMA);
+  DMA_Init(LCD_DMA, &DMA_InitStructure);
+  DMA_ClearFlag(LCD_DMA_FLAG_TC);
+  DMA_Cmd(LCD_DMA, ENABLE);
+  lcdDMAActive = true;
+}
+
+/// move a finished transfer on to its next chunk. Returns true while DMA is still busy
+static bool lcdPumpDMA() {
+  if (!lcdDMAActive) return false;
+  if (!DMA_GetFlagStatus(LCD_DMA_FLAG_TC)) return true;
+  DMA_ClearFlag(LCD_DMA_FLAG_TC);
+  DMA_Cmd(LCD_DMA, DISABLE);
+  lcdDMAActive = false;
+  if (lcdDMANext) {
+    lcdStartDMA(lcdDMANext, lcdDMANextPixels);
+    return true;
+  }
+  lcdDMAFinished = true;
+  return false;
+}
+
+/// block until a background flip has completely finished
+static void lcdWaitDMA() {
+  while (lcdPumpDMA());
+}
+#else
+static void lcdWaitDMA() {} // bitbanged LCDs flip synchronously
+#endif
+
+bool lcdFSMC_idle() {
+#if !defined(ILI9325_BITBANG) && !defined(FSMC_BITBANG)
+  lcdPumpDMA();
+  if (lcdDMAFinished) {
+    lcdDMAFinished = false;
+    return true;
+  }
+#endif
+  return false;
+}
+
+void lcdFSMC_flip(JsGraphics *gfx, unsigned short *data, unsigned int pixels) {
+  lcdWaitDMA(); // a previous flip must finish before the window is reprogrammed
+  lcdSetFullWindow(gfx);
+  lcdSetCursor(gfx,(unsigned short)(gfx->data.width-1),0);
+  LCD_WR_REG(0x22); // start data tx
+#if !defined(ILI9325_BITBANG) && !defined(FSMC_BITBANG)
+  lcdStartDMA(data, pixels);
+#else
+  unsigned int i;
+  for (i=0;i<pixels;i++)
+    LCD_WR_Data(data[i]);
+#endif
+}
+#else
+#define lcdWaitDMA()
+#endif // SAVE_ON_FLASH
+
 void lcdFillRect_FSMC(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
   // finally!
+  lcdWaitDMA();
   if (x1==x2) { // special case for single vertical line - no window needed
     lcdSetCursor(gfx,x2,y1);
     LCD_WR_REG(0x22); // start data tx
@@ -1365,6 +1460,7 @@ void lcdFillRect_FSMC(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
 }
 
 unsigned int lcdGetPixel_FSMC(JsGraphics *gfx, short x, short y) {
+  lcdWaitDMA();
   lcdSetCursor(gfx,x,y);
   LCD_WR_REG(0x22); // start data tx
   return LCD_RD_Data();
@@ -1372,6 +1468,7 @@ unsigned int lcdGetPixel_FSMC(JsGraphics *gfx, short x, short y) {
 
 
 void lcdSetPixel_FSMC(JsGraphics *gfx, short x, short y, unsigned int col) {
+  lcdWaitDMA();
   lcdSetCursor(gfx,x,y);
   LCD_WR_REG(34);
   LCD_WR_Data(col);
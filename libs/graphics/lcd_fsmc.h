@@ -15,3 +15,11 @@
 
 void lcdInit_FSMC(JsGraphics *gfx);
 void lcdSetCallbacks_FSMC(JsGraphics *gfx);
+#ifndef SAVE_ON_FLASH
+/** Stream a whole 16 bit frame to the panel. Where DMA is available the
+ * transfer continues in the background and the interpreter keeps running -
+ * any other panel access (or another flip) waits for it to finish first. */
+void lcdFSMC_flip(JsGraphics *gfx, unsigned short *data, unsigned int pixels);
+/// called when idling - moves a background flip along. Returns true when a flip has just finished
+bool lcdFSMC_idle();
+#endif
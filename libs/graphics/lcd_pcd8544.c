@@ -10,89 +10,96 @@
  * ----------------------------------------------------------------------------
  * Graphics Backend for drawing to simple black and white SPI displays
  * (PCD8544 - Nokia 5110 LCD)
- * FIXME: UNFINISHED
+ *
+ * Pixels live in an ordinary vertical-byte ArrayBuffer (so all the
+ * lcd_arraybuffer drawing code and dirty-rectangle tracking is reused),
+ * and `flip` pushes just the modified window over SPI - a one line
+ * status update only costs a few dozen bytes of traffic, not the whole
+ * 504 byte framebuffer.
  * ----------------------------------------------------------------------------
  */
 
 #include "platform_config.h"
 #include "jsutils.h"
-#include "lcd.h"
-
-#define LCD_WIDTH 84
-#define LCD_HEIGHT 48
-
-typedef struct {
-  unsigned char changeX1,changeY1,changeX2,changeY2;
-  unsigned char pixels[LCD_WIDTH*LCD_HEIGHT/8];  
-} LCDDataPCD8544 PACKED_FLAGS;
-
-unsigned int lcdGetPixel_PCD8544(JsGraphics *gfx, short x, short y) {
-  int yp = y>>3;
-  int addr = x + (yp*gfx->data.width);
-  return (pixels[addr]>>(y&7)) & 1;
-}
-
+#include "jsvar.h"
+#include "jshardware.h"
+#include "lcd_pcd8544.h"
+#include "lcd_arraybuffer.h"
 
-void lcdSetPixel_PCD8544(JsGraphics *gfx, short x, short y, unsigned int col) {
-  int yp = y>>3;
-  int addr = x + (yp*gfx->data.width);
-  if (col) pixels[addr] |= 1<<(y&7);
-  else pixels[addr] &= ~(1<<(y&7));
-  if (x<changeX1) changeX1=x;
-  if (y<changeY1) changeY1=y;
-  if (x>changeX2) changeX2=x;
-  if (y>changeY2) changeY2=y;
-}
+// boards using this should define these in their platform config
+#ifndef PCD8544_SPI
+#define PCD8544_SPI EV_SPI1
+#endif
+#ifndef PCD8544_PIN_DC
+#define PCD8544_PIN_DC (Pin)0
+#endif
+#ifndef PCD8544_PIN_CE
+#define PCD8544_PIN_CE (Pin)1
+#endif
 
-void lcdIdle_PCD8544(JsGraphics *gfx) {
-  if (changeX1>=changeX2 && changeY1>=changeY2) {
-    // write...
-    int cy1 = changeY1 >> 3;
-    int cy2 = changeY2 >> 3;
-    int x,y;
-    jshPinOutput(CE, 0);
-    for (y=cy1;y<=cy2;y++) {
-      jshPinOutput(DC, 0); // command
-      jshSPISend(dev, 0x40 | y); // Y addr
-      jshSPISend(dev, 0x80); // X addr
-      jshPinOutput(DC, 1); // data
-      for (x=changeX1;x<=changeX2;x++) 
-        jshSPISend(dev, pixels[x+y*LCD_WIDTH]);
-    }      
-    jshPinOutput(DC, 0); // command
-    jshSPISend(dev, 0x40); // reset?
-    jshPinOutput(CE, 1);
-
-    changeX1 = LCD_WIDTH;
-    changeY1 = LCD_HEIGHT;
-    changeX2 = 0;
-    changeY2 = 0;
-  }
-}
+#define PCD8544_WIDTH 84
+#define PCD8544_HEIGHT 48
 
 void lcdInit_PCD8544(JsGraphics *gfx) {
   assert(gfx->data.bpp == 1);
+  jshPinOutput(PCD8544_PIN_CE, 0);
+  jshPinOutput(PCD8544_PIN_DC, 0); // command
+  jshSPISend(PCD8544_SPI, 0x21); // fnset extended
+  jshSPISend(PCD8544_SPI, 0x80 | 0x40); // setvop (experiment with 2nd val to get the right contrast)
+  jshSPISend(PCD8544_SPI, 0x14); // setbias 4
+  jshSPISend(PCD8544_SPI, 0x04 | 0x02); // temp control
+  jshSPISend(PCD8544_SPI, 0x20); // fnset normal
+  jshSPISend(PCD8544_SPI, 0x08 | 0x04); // dispctl normal
+  jshPinSetValue(PCD8544_PIN_CE, 1);
+}
 
-  IOEventFlags dev = EV_SPI1;
-  jshPinOutput(CE, 0);
-  // pulse reset 10ms?
-  jshPinOutput(DC, 0); // command
-  jshSPISend(dev, 0x21); // fnset extended
-  jshSPISend(dev, 0x80 | 0x40); // setvop (experiment with 2nd val to get the right contrast)
-  jshSPISend(dev, 0x14); // setbias 4
-  jshSPISend(dev, 0x04 | 0x02); // temp control
-  jshSPISend(dev, 0x20); // fnset normal
-  jshSPISend(dev, 0x08 | 0x04); // dispctl normal
-  jshPinOutput(CE, 1);
+/// Send the modified area of the buffer to the display
+void lcdFlip_PCD8544(JsGraphics *gfx) {
+  if (gfx->data.modMinX > gfx->data.modMaxX) return; // nothing was changed
+  JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
+  char *ptr = 0;
+  size_t len = 0;
+  if (buf && jsvIsArrayBuffer(buf)) {
+    JsVar *backing = jsvGetArrayBufferBackingString(buf);
+    if (backing) {
+      ptr = jsvGetDataPointer(backing, &len);
+      jsvUnLock(backing);
+    }
+  }
+  if (ptr) {
+    // vertical-byte layout - one byte covers 8 rows, so send whole 'pages'
+    int p1 = gfx->data.modMinY>>3;
+    int p2 = gfx->data.modMaxY>>3;
+    int x1 = gfx->data.modMinX;
+    int x2 = gfx->data.modMaxX;
+    int x,p;
+    jshPinSetValue(PCD8544_PIN_CE, 0);
+    for (p=p1;p<=p2;p++) {
+      jshPinSetValue(PCD8544_PIN_DC, 0); // command
+      jshSPISend(PCD8544_SPI, 0x40 | p); // Y addr
+      jshSPISend(PCD8544_SPI, 0x80 | x1); // X addr
+      jshPinSetValue(PCD8544_PIN_DC, 1); // data
+      for (x=x1;x<=x2;x++) {
+        size_t idx = (size_t)(x + p*gfx->data.width);
+        if (idx<len) jshSPISend(PCD8544_SPI, (unsigned char)ptr[idx]);
+      }
+    }
+    jshPinSetValue(PCD8544_PIN_DC, 0); // command
+    jshSPISend(PCD8544_SPI, 0x40);
+    jshPinSetValue(PCD8544_PIN_CE, 1);
+    // mark the whole area as sent
+    gfx->data.modMaxX = -32768;
+    gfx->data.modMaxY = -32768;
+    gfx->data.modMinX = 32767;
+    gfx->data.modMinY = 32767;
+  }
+  jsvUnLock(buf);
 }
 
 void lcdSetCallbacks_PCD8544(JsGraphics *gfx) {
-  gfx->data.width = LCD_WIDTH;
-  gfx->data.height = LCD_HEIGHT;
+  gfx->data.width = PCD8544_WIDTH;
+  gfx->data.height = PCD8544_HEIGHT;
   gfx->data.bpp = 1;
-  gfx->setPixel = lcdSetPixel_PCD8544;
-  gfx->getPixel = lcdGetPixel_PCD8544;
-  gfx->idle = lcdIdle_PCD8544;
-
+  // pixel storage (and dirty rectangle tracking) is plain lcd_arraybuffer
+  lcdSetCallbacks_ArrayBuffer(gfx);
 }
-
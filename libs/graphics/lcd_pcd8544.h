@@ -16,3 +16,5 @@
 
 void lcdInit_PCD8544(JsGraphics *gfx);
 void lcdSetCallbacks_PCD8544(JsGraphics *gfx);
+/// Send the modified area of the buffer to the display
+void lcdFlip_PCD8544(JsGraphics *gfx);
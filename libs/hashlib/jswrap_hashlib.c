@@ -128,7 +128,8 @@ JsVar *jswrap_hashlib_sha2(JsHashType hash_type) {
 */
 void jswrap_hashlib_hash_update(JsVar *parent, JsVar *message) {
   int type;
-  char buff[SHA256_DIGEST_SIZE];
+  // whole blocks, so the hash can process straight from the buffer
+  char buff[SHA256_BLOCK_SIZE*2];
 
   JsVar *jsCtx = jsvObjectGetChild(parent, "context", 0);
   JsVar *child = jsvObjectGetChild(parent, "hash_type", 0);
@@ -139,11 +140,18 @@ void jswrap_hashlib_hash_update(JsVar *parent, JsVar *message) {
   jsvGetString(jsCtx, hashFunctions[type].data, hashFunctions[type].ctx_size + 1);  // trailing zero
 
   if (jsvIsString(message)) {
-    size_t i;
-    size_t len = jsvGetStringLength(message);
-    for(i = 0; i < len; i += sizeof(buff)) {
-      int read = (int)jsvGetStringChars(message, i, buff, sizeof(buff));
-      hashFunctions[type].update(hashFunctions[type].data, buff, read);
+    size_t flatLen = 0;
+    char *flatPtr = jsvGetDataPointer(message, &flatLen);
+    if (flatPtr) {
+      // message is a flat string - hash it in one go, no staging copies
+      hashFunctions[type].update(hashFunctions[type].data, flatPtr, (unsigned int)flatLen);
+    } else {
+      size_t i;
+      size_t len = jsvGetStringLength(message);
+      for(i = 0; i < len; i += sizeof(buff)) {
+        int read = (int)jsvGetStringChars(message, i, buff, sizeof(buff));
+        hashFunctions[type].update(hashFunctions[type].data, buff, read);
+      }
     }
     jsvSetString(jsCtx, hashFunctions[type].data, hashFunctions[type].ctx_size);
   }
@@ -71,6 +71,20 @@
            | ((uint32) *((str) + 0) << 24);   \
 }
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Big-endian load of a whole aligned word - the byte-swap idiom compiles
+   to a single rev/bswap instruction. Only usable when str is 32-bit
+   aligned (see the fast path in sha256_transf) */
+#define PACK32_ALIGNED(str, x)                \
+{                                             \
+    uint32 pw = *(const uint32 *)(str);       \
+    *(x) =   ( pw >> 24)                      \
+           | ((pw >>  8) & 0x0000FF00)        \
+           | ((pw <<  8) & 0x00FF0000)        \
+           | ( pw << 24);                     \
+}
+#endif
+
 #define UNPACK64(x, str)                      \
 {                                             \
     *((str) + 7) = (uint8) ((x)      );       \
@@ -226,6 +240,13 @@ void sha256_transf(sha256_ctx *ctx, const unsigned char *message,
         sub_block = message + (i << 6);
 
 #ifndef UNROLL_LOOPS
+#ifdef PACK32_ALIGNED
+        if (!((unsigned long)(const void *)sub_block & 3)) {
+            for (j = 0; j < 16; j++) {
+                PACK32_ALIGNED(&sub_block[j << 2], &w[j]);
+            }
+        } else
+#endif
         for (j = 0; j < 16; j++) {
             PACK32(&sub_block[j << 2], &w[j]);
         }
@@ -355,34 +376,41 @@ void sha256_update(sha256_ctx *ctx, const unsigned char *message,
                    unsigned int len)
 {
     unsigned int block_nb;
-    unsigned int new_len, rem_len, tmp_len;
-    const unsigned char *shifted_message;
+    unsigned int rem_len, tmp_len;
 
-    tmp_len = SHA256_BLOCK_SIZE - ctx->len;
-    rem_len = len < tmp_len ? len : tmp_len;
+    if (ctx->len) {
+        /* Top up and flush the partially-filled staging block first */
+        tmp_len = SHA256_BLOCK_SIZE - ctx->len;
+        rem_len = len < tmp_len ? len : tmp_len;
 
-    memcpy(&ctx->block[ctx->len], message, rem_len);
+        memcpy(&ctx->block[ctx->len], message, rem_len);
 
-    if (ctx->len + len < SHA256_BLOCK_SIZE) {
-        ctx->len += len;
-        return;
-    }
+        if (ctx->len + len < SHA256_BLOCK_SIZE) {
+            ctx->len += len;
+            return;
+        }
 
-    new_len = len - rem_len;
-    block_nb = new_len / SHA256_BLOCK_SIZE;
+        sha256_transf(ctx, ctx->block, 1);
+        ctx->tot_len += SHA256_BLOCK_SIZE;
+        ctx->len = 0;
 
-    shifted_message = message + rem_len;
+        message += rem_len;
+        len -= rem_len;
+    }
 
-    sha256_transf(ctx, ctx->block, 1);
-    sha256_transf(ctx, shifted_message, block_nb);
+    /* Hash whole blocks straight from the input, with no staging copy */
+    block_nb = len / SHA256_BLOCK_SIZE;
 
-    rem_len = new_len % SHA256_BLOCK_SIZE;
+    if (block_nb) {
+        sha256_transf(ctx, message, block_nb);
+        ctx->tot_len += block_nb << 6;
 
-    memcpy(ctx->block, &shifted_message[block_nb << 6],
-           rem_len);
+        message += block_nb << 6;
+        len -= block_nb << 6;
+    }
 
-    ctx->len = rem_len;
-    ctx->tot_len += (block_nb + 1) << 6;
+    memcpy(ctx->block, message, len);
+    ctx->len = len;
 }
 
 void sha256_final(sha256_ctx *ctx, unsigned char *digest)
@@ -754,34 +782,41 @@ void sha224_update(sha224_ctx *ctx, const unsigned char *message,
                    unsigned int len)
 {
     unsigned int block_nb;
-    unsigned int new_len, rem_len, tmp_len;
-    const unsigned char *shifted_message;
+    unsigned int rem_len, tmp_len;
 
-    tmp_len = SHA224_BLOCK_SIZE - ctx->len;
-    rem_len = len < tmp_len ? len : tmp_len;
+    if (ctx->len) {
+        /* Top up and flush the partially-filled staging block first */
+        tmp_len = SHA224_BLOCK_SIZE - ctx->len;
+        rem_len = len < tmp_len ? len : tmp_len;
 
-    memcpy(&ctx->block[ctx->len], message, rem_len);
+        memcpy(&ctx->block[ctx->len], message, rem_len);
 
-    if (ctx->len + len < SHA224_BLOCK_SIZE) {
-        ctx->len += len;
-        return;
-    }
+        if (ctx->len + len < SHA224_BLOCK_SIZE) {
+            ctx->len += len;
+            return;
+        }
 
-    new_len = len - rem_len;
-    block_nb = new_len / SHA224_BLOCK_SIZE;
+        sha256_transf(ctx, ctx->block, 1);
+        ctx->tot_len += SHA224_BLOCK_SIZE;
+        ctx->len = 0;
 
-    shifted_message = message + rem_len;
+        message += rem_len;
+        len -= rem_len;
+    }
 
-    sha256_transf(ctx, ctx->block, 1);
-    sha256_transf(ctx, shifted_message, block_nb);
+    /* Hash whole blocks straight from the input, with no staging copy */
+    block_nb = len / SHA224_BLOCK_SIZE;
 
-    rem_len = new_len % SHA224_BLOCK_SIZE;
+    if (block_nb) {
+        sha256_transf(ctx, message, block_nb);
+        ctx->tot_len += block_nb << 6;
 
-    memcpy(ctx->block, &shifted_message[block_nb << 6],
-           rem_len);
+        message += block_nb << 6;
+        len -= block_nb << 6;
+    }
 
-    ctx->len = rem_len;
-    ctx->tot_len += (block_nb + 1) << 6;
+    memcpy(ctx->block, message, len);
+    ctx->len = len;
 }
 
 void sha224_final(sha224_ctx *ctx, unsigned char *digest)
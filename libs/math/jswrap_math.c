@@ -15,6 +15,7 @@
  */
 #include "jswrap_math.h"
 #include "jsvariterator.h"
+#include "jsflags.h"
 
 static bool isNegativeZero(double x) {
   double NEGATIVE_ZERO = -0.0;
@@ -22,6 +23,9 @@ static bool isNegativeZero(double x) {
 }
 
 double jswrap_math_sin(double x) {
+#ifndef SAVE_ON_FLASH
+  if (jsfGetFlag(JSF_FAST_MATH)) return (double)sinf((float)x);
+#endif
 #ifdef SAVE_ON_FLASH_MATH
   /* To save on flash, do our own sin function that's slower/nastier
    * but is smaller! If we pull in gcc's it adds:
@@ -166,6 +170,9 @@ JsVarFloat jswrap_math_abs(JsVarFloat x) {
   "return" : ["float","The arc tangent of x, between -PI/2 and PI/2"]
 }*/
 double jswrap_math_atan(double x) {
+#ifndef SAVE_ON_FLASH
+  if (jsfGetFlag(JSF_FAST_MATH)) return (double)atanf((float)x);
+#endif
 #ifdef SAVE_ON_FLASH_MATH
   /* To save on flash, do our own atan function that's slower/nastier
    * but is smaller! */
@@ -206,13 +213,19 @@ double jswrap_math_atan(double x) {
   "ifndef" : "SAVE_ON_FLASH",
   "class" : "Math",
   "name" : "atan2",
-  "generate" : "atan2",
+  "generate" : "jswrap_math_atan2",
   "params" : [
     ["y","float","The Y-part of the angle to get the arc tangent of"],
     ["x","float","The X-part of the angle to get the arc tangent of"]
   ],
   "return" : ["float","The arctangent of Y/X, between -PI and PI"]
 }*/
+double jswrap_math_atan2(double y, double x) {
+#ifndef SAVE_ON_FLASH
+  if (jsfGetFlag(JSF_FAST_MATH)) return (double)atan2f((float)y, (float)x);
+#endif
+  return atan2(y, x);
+}
 
 /* we use sin here, not cos, to try and save a bit of code space */
 /*JSON{
@@ -362,6 +375,9 @@ JsVar *jswrap_math_round(double x) {
 }*/
 
 double jswrap_math_sqrt(double x) {
+#ifndef SAVE_ON_FLASH
+  if (jsfGetFlag(JSF_FAST_MATH)) return (x>=0) ? (double)sqrtf((float)x) : NAN;
+#endif
   return (x>=0) ? exp(log(x) * 0.5) : NAN;
 }
 
@@ -428,6 +444,84 @@ JsVarFloat jswrap_math_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max) {
   return x;
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "isin",
+  "generate" : "jswrap_math_isin",
+  "params" : [
+    ["angle","int32","The angle, where 65536 is a full circle (so 0x4000 = 90 degrees). Values wrap, so negatives and multiple turns are fine"]
+  ],
+  "return" : ["int32","The sine of angle, scaled so that 32767 = 1.0"]
+}
+Integer sine for control loops - no floating point at all, so it's fast
+enough to call at commutation rates and doesn't need a precomputed table
+taking up JsVar memory. The angle is a 16 bit binary fraction of a
+revolution and the result is a signed 15 bit fraction:
+
+```
+duty = 32768 + E.isin(phase); // 0..65535, phase advances by (freq*65536)/rate each step
+```
+
+For cosine, use `E.isin(angle + 0x4000)`. Worst-case error is about 3
+counts in 32767.
+ */
+int jswrap_math_isin(int angle) {
+  // quarter wave table, 65 entries of sin(0..90 degrees) scaled to 32767,
+  // with linear interpolation between entries
+  static const short isinTable[65] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767
+  };
+  unsigned int a = (unsigned int)angle & 0xFFFF;
+  // fold down to the first quarter - quadrants 1 and 3 run backwards
+  unsigned int pos = (a & 0x4000) ? 0x4000-(a & 0x3FFF) : (a & 0x3FFF);
+  unsigned int idx = pos >> 8, frac = pos & 0xFF;
+  int s = isinTable[idx] + (((isinTable[idx+1]-isinTable[idx]) * (int)frac) >> 8);
+  return (a & 0x8000) ? -s : s;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "iatan2",
+  "generate" : "jswrap_math_iatan2",
+  "params" : [
+    ["y","int32","The Y-part of the angle"],
+    ["x","int32","The X-part of the angle"]
+  ],
+  "return" : ["int32","The angle of (x,y), where 65536 is a full circle - in the range 0..65535"]
+}
+Integer arctangent, the counterpart of `E.isin` - takes integer
+coordinates (for instance raw encoder or hall sensor counts) and returns
+the angle as a 16 bit binary fraction of a revolution, counting
+anticlockwise from the positive X axis. No floating point is used.
+Worst-case error is about a quarter of a degree; `E.iatan2(0,0)` returns 0.
+ */
+int jswrap_math_iatan2(int y, int x) {
+  if (x==0 && y==0) return 0;
+  unsigned int ax = (unsigned int)(x<0 ? -x : x);
+  unsigned int ay = (unsigned int)(y<0 ? -y : y);
+  // ratio of the smaller to the larger side, as a 15 bit fraction
+  unsigned int z = (unsigned int)((((long long)(ax<ay ? ax : ay))<<15) / (ax<ay ? ay : ax));
+  /* atan(z) ~ (pi/4)z + 0.273 z(1-z) for 0<=z<=1 - in 1/65536ths of a
+   * revolution that's 8192*z + 2847*z*(1-z), good to ~0.22 degrees */
+  unsigned int t = (unsigned int)((8192*(long long)z + (2847*(long long)z*(32768-z)>>15)) >> 15);
+  if (ay>ax) t = 16384-t;          // fold out of the first octant
+  if (x<0) t = 32768-t;            // and into the right quadrant
+  if (y<0) t = (65536-t) & 0xFFFF;
+  return (int)t;
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
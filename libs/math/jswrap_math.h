@@ -27,5 +27,8 @@ JsVar *jswrap_math_round(double x);
 double jswrap_math_sqrt(double x);
 double jswrap_math_sin(double x);
 double jswrap_math_atan(double x);
+double jswrap_math_atan2(double y, double x);
+int jswrap_math_isin(int angle);
+int jswrap_math_iatan2(int y, int x);
 JsVarFloat jswrap_math_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max);
 JsVarFloat jswrap_math_minmax(JsVar *args, bool isMax);
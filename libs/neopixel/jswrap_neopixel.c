@@ -33,6 +33,8 @@
 #include "jspininfo.h"
 #include "jshardware.h"
 #include "jsspi.h"
+#include "jstimer.h"
+#include "jsparse.h"
 
 /** Send the given RGB pixel data out to neopixel/WS2811/APA104/etc */
 bool neopixelWrite(Pin pin, unsigned char *rgbData, size_t rgbSize);
@@ -120,6 +122,112 @@ void jswrap_neopixel_write(Pin pin, JsVar *data) {
   neopixelWrite(pin, (unsigned char *)rgbData, rgbSize);
 }
 
+#ifndef SAVE_ON_FLASH
+#define JSI_NEOPIXEL_NAME JS_HIDDEN_CHAR_STR"npx"
+
+/* Background refresh state. One strip can be refreshed at a time - the
+ * bound data var is kept alive in hiddenRoot under JSI_NEOPIXEL_NAME so
+ * this pointer stays valid until jswrap_neopixel_stopRefresh/kill */
+static struct {
+  Pin pin;
+  unsigned char *rgbData;
+  size_t rgbSize;
+} neopixelRefresh;
+
+static void neopixelRefreshFn(JsSysTime time, void *userdata) {
+  NOT_USED(time);
+  NOT_USED(userdata);
+  neopixelWrite(neopixelRefresh.pin, neopixelRefresh.rgbData, neopixelRefresh.rgbSize);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "neopixel",
+  "name" : "startRefresh",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_neopixel_startRefresh",
+  "params" : [
+    ["pin", "pin", "The Pin the LEDs are connected to"],
+    ["data","JsVar","A flat typed array/ArrayBuffer of RGB data to keep sending to the LED strip"],
+    ["fps","float","How many times a second to re-send the data"]
+  ]
+}
+Bind `data` to the LED strip and re-send it at the given rate from a timer,
+with no JavaScript call needed per frame. Modify the contents of `data` and
+the changes appear on the strip at the next refresh:
+
+```
+var rgb = new Uint8Array(25*3);
+require("neopixel").startRefresh(B15, rgb, 30);
+// ... just write to rgb from now on
+```
+
+Only one strip can be background-refreshed at a time - a new call replaces
+the previous binding. Use `stopRefresh` to stop.
+
+**Note:** the data must be a flat (contiguous) buffer, so make it a typed
+array rather than a normal Array.
+ */
+void jswrap_neopixel_startRefresh(Pin pin, JsVar *data, JsVarFloat fps) {
+  if (!jshIsPinValid(pin)) {
+    jsExceptionHere(JSET_ERROR, "Pin is not valid.");
+    return;
+  }
+  if (!(fps>0) || fps>1000) {
+    jsExceptionHere(JSET_ERROR, "Invalid frame rate %f", fps);
+    return;
+  }
+  JsVar *backing = jsvGetArrayBufferBackingString(data);
+  if (!backing && jsvIsString(data)) backing = jsvLockAgain(data);
+  size_t rgbSize = 0;
+  unsigned char *rgbData = backing ? (unsigned char *)jsvGetDataPointer(backing, &rgbSize) : 0;
+  if (!rgbData) {
+    jsExceptionHere(JSET_ERROR, "Data must be a flat typed array or ArrayBuffer");
+    jsvUnLock(backing);
+    return;
+  }
+  if (rgbSize == 0 || (rgbSize % 3) != 0) {
+    jsExceptionHere(JSET_ERROR, "Data length must be a non-zero multiple of 3 (RGB).");
+    jsvUnLock(backing);
+    return;
+  }
+  jswrap_neopixel_stopRefresh(); // replace any existing binding
+  neopixelRefresh.pin = pin;
+  neopixelRefresh.rgbData = rgbData;
+  neopixelRefresh.rgbSize = rgbSize;
+  // keep the data alive while the timer is reading it
+  jsvObjectSetChild(execInfo.hiddenRoot, JSI_NEOPIXEL_NAME, backing);
+  JsSysTime period = jshGetTimeFromMilliseconds(1000.0 / fps);
+  if (!jstExecuteFn(neopixelRefreshFn, NULL, jshGetSystemTime() + period, (uint32_t)period)) {
+    jsvObjectRemoveChild(execInfo.hiddenRoot, JSI_NEOPIXEL_NAME);
+    jsExceptionHere(JSET_ERROR, "Timer is full");
+  }
+  jsvUnLock(backing);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "neopixel",
+  "name" : "stopRefresh",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_neopixel_stopRefresh"
+}
+Stop a background refresh started with `startRefresh`.
+ */
+void jswrap_neopixel_stopRefresh() {
+  jstStopExecuteFn(neopixelRefreshFn, NULL);
+  jsvObjectRemoveChild(execInfo.hiddenRoot, JSI_NEOPIXEL_NAME);
+}
+
+/*JSON{
+  "type" : "kill",
+  "generate" : "jswrap_neopixel_kill",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+void jswrap_neopixel_kill() { // stop the timer before the bound data is freed
+  jswrap_neopixel_stopRefresh();
+}
+#endif // SAVE_ON_FLASH
 
 // -----------------------------------------------------------------------------------
 // -------------------------------------------------------------- Platform specific
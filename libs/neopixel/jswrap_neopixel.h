@@ -16,3 +16,6 @@
 #include "jsvar.h"
 
 void jswrap_neopixel_write(Pin pin, JsVar *data);
+void jswrap_neopixel_startRefresh(Pin pin, JsVar *data, JsVarFloat fps);
+void jswrap_neopixel_stopRefresh();
+void jswrap_neopixel_kill();
@@ -85,6 +85,24 @@ Return how many bytes are available to read. If there is already a listener for
 }
 Return a string containing characters that have been received
 */
+/*JSON{
+  "type" : "method",
+  "class" : "httpSRq",
+  "name" : "pause",
+  "generate" : "jswrap_net_socket_pause"
+}
+Stop reading from this request - see `Socket.pause`. `maxReceiveBuffer` can
+be set on the request to pause automatically once that much unread data is
+buffered
+*/
+/*JSON{
+  "type" : "method",
+  "class" : "httpSRq",
+  "name" : "resume",
+  "generate" : "jswrap_net_socket_resume"
+}
+Start reading from this request again after a call to `pause`
+*/
 /*JSON{
   "type" : "method",
   "class" : "httpSRq",
@@ -98,6 +116,32 @@ Return a string containing characters that have been received
 }
 Pipe this to a stream (an object with a 'write' method)
 */
+/*JSON{
+  "type" : "method",
+  "class" : "httpSRq",
+  "name" : "wsMode",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_net_socket_wsMode",
+  "params" : [
+    ["enabled","bool","true to decode WebSocket frames natively, false to go back to raw data"]
+  ]
+}
+Decode incoming data on this connection as WebSocket frames (call after
+you've sent the upgrade response) - see `Socket.wsMode`
+*/
+/*JSON{
+  "type" : "event",
+  "class" : "httpSRq",
+  "name" : "message",
+  "ifndef" : "SAVE_ON_FLASH",
+  "params" : [
+    ["data","JsVar","The (unmasked) frame payload, as a flat string"],
+    ["opcode","int","The WebSocket opcode (1=text, 2=binary, 8=close, 9=ping, 10=pong)"]
+  ]
+}
+Called when `wsMode` is enabled and a complete WebSocket frame has been
+received
+*/
 
 /*JSON{
   "type" : "class",
@@ -174,6 +218,24 @@ Called when the connection closes with one `hadError` boolean parameter, which i
 }
 An event that is fired if there is an error receiving the response. The error event function receives an error object as parameter with a `code` field and a `message` field. After the error event the close even will also be triggered to conclude the HTTP request/response.
 */
+/*JSON{
+  "type" : "method",
+  "class" : "httpCRs",
+  "name" : "pause",
+  "generate" : "jswrap_net_socket_pause"
+}
+Stop reading from this response - see `Socket.pause`. `maxReceiveBuffer` can
+be set on the response to pause automatically once that much unread data is
+buffered
+*/
+/*JSON{
+  "type" : "method",
+  "class" : "httpCRs",
+  "name" : "resume",
+  "generate" : "jswrap_net_socket_resume"
+}
+Start reading from this response again after a call to `pause`
+*/
 /*JSON{
   "type" : "method",
   "class" : "httpCRs",
@@ -262,6 +324,11 @@ var options = {
     path: '/',           // path sent to server
     method: 'GET',       // HTTP command sent to server (must be uppercase 'GET', 'POST', etc)
     protocol: 'http:',   // optional protocol - https: or http:
+    keepAlive: false,    // (optional) request a keep-alive connection. When the
+                         // response (which must have a `Content-Length` header)
+                         // is complete, the connection is kept for a few seconds
+                         // and the next request to the same host and port will
+                         // reuse it - avoiding a fresh DNS lookup and connect
     headers: { key : value, key : value } // (optional) HTTP headers
   };
 require("http").request(options, function(res) {
@@ -413,6 +480,29 @@ void jswrap_httpSRs_writeHead(JsVar *parent, int statusCode, JsVar *headers) {
   serverResponseWriteHead(parent, statusCode, headers);
 }
 
+/*JSON{
+  "type" : "method",
+  "class" : "httpSRs",
+  "name" : "wsSend",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_httpSRs_wsSend",
+  "params" : [
+    ["data","JsVar","The message payload"],
+    ["opcode","int","The WebSocket opcode (optional - defaults to 1, a text frame)"]
+  ],
+  "return" : ["bool","For note on return value, see `Socket.write`"]
+}
+Send `data` as a single (unmasked - this is the server side) WebSocket frame -
+see `Socket.wsMode`
+*/
+bool jswrap_httpSRs_wsSend(JsVar *parent, JsVar *data, int opcode) {
+  JsVar *frame = socketWsFrame(data, opcode ? opcode : 1, false/*servers don't mask*/);
+  if (!frame) return false;
+  bool r = jswrap_httpSRs_write(parent, frame);
+  jsvUnLock(frame);
+  return r;
+}
+
 // ---------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------
@@ -21,6 +21,7 @@ JsVar *jswrap_http_get(JsVar *options, JsVar *callback);
 void jswrap_httpSRs_writeHead(JsVar *parent, int statusCode, JsVar *headers);
 bool jswrap_httpSRs_write(JsVar *parent, JsVar *data);
 void jswrap_httpSRs_end(JsVar *parent, JsVar *data);
+bool jswrap_httpSRs_wsSend(JsVar *parent, JsVar *data, int opcode);
 
 bool jswrap_httpCRq_write(JsVar *parent, JsVar *data);
 void jswrap_httpCRq_end(JsVar *parent, JsVar *data);
@@ -328,6 +328,93 @@ Pipe this to a stream (an object with a 'write' method)
 }
 An event that is fired when the buffer is empty and it can accept more data to send.
 */
+/*JSON{
+  "type" : "method",
+  "class" : "Socket",
+  "name" : "pause",
+  "generate" : "jswrap_net_socket_pause"
+}
+Stop reading from this socket. Received data stays queued in the network
+layer (where TCP flow control will eventually throttle the sender), so
+nothing more is buffered in Espruino until `resume` is called.
+
+You can also set `socket.maxReceiveBuffer` to a number of bytes to pause
+reception automatically whenever that much unread data is buffered, which
+keeps a fast sender at a bounded memory footprint
+*/
+void jswrap_net_socket_pause(JsVar *parent) {
+  socketSetPaused(parent, true);
+}
+/*JSON{
+  "type" : "method",
+  "class" : "Socket",
+  "name" : "resume",
+  "generate" : "jswrap_net_socket_resume"
+}
+Start reading from this socket again after a call to `pause`
+*/
+void jswrap_net_socket_resume(JsVar *parent) {
+  socketSetPaused(parent, false);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Socket",
+  "name" : "wsMode",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_net_socket_wsMode",
+  "params" : [
+    ["enabled","bool","true to decode WebSocket frames natively, false to go back to raw data"]
+  ]
+}
+Treat incoming data on this socket as WebSocket frames. Instead of `data`
+events you'll get a `message` event for each complete frame, with the
+unmasked payload (a flat string) and the opcode as arguments. Framing is
+done in C so this is a lot faster than deframing in JavaScript.
+
+You're still expected to do the HTTP upgrade handshake yourself (in a module
+or your own code) - call this once the handshake has completed
+*/
+void jswrap_net_socket_wsMode(JsVar *parent, bool enabled) {
+  socketWsSetMode(parent, enabled);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Socket",
+  "name" : "wsSend",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_net_socket_wsSend",
+  "params" : [
+    ["data","JsVar","The message payload"],
+    ["opcode","int","The WebSocket opcode (optional - defaults to 1, a text frame)"],
+    ["mask","bool","Whether to mask the frame (clients must mask, servers must not)"]
+  ],
+  "return" : ["bool","For note on return value, see `Socket.write`"]
+}
+Send `data` as a single WebSocket frame (built natively - see `Socket.wsMode`)
+*/
+bool jswrap_net_socket_wsSend(JsVar *parent, JsVar *data, int opcode, bool mask) {
+  JsVar *frame = socketWsFrame(data, opcode ? opcode : 1, mask);
+  if (!frame) return false;
+  bool r = jswrap_net_socket_write(parent, frame);
+  jsvUnLock(frame);
+  return r;
+}
+
+/*JSON{
+  "type" : "event",
+  "class" : "Socket",
+  "name" : "message",
+  "ifndef" : "SAVE_ON_FLASH",
+  "params" : [
+    ["data","JsVar","The (unmasked) frame payload, as a flat string"],
+    ["opcode","int","The WebSocket opcode (1=text, 2=binary, 8=close, 9=ping, 10=pong)"]
+  ]
+}
+Called when `Socket.wsMode` is enabled and a complete WebSocket frame has
+been received
+*/
 
 
 
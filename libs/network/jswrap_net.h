@@ -29,6 +29,10 @@ JsVar *jswrap_net_connect(JsVar *options, JsVar *callback, SocketType socketType
 JsVar *jswrap_net_server_listen(JsVar *parent, int port, SocketType socketType);
 void jswrap_net_server_close(JsVar *parent);
 
+void jswrap_net_socket_pause(JsVar *parent);
+void jswrap_net_socket_resume(JsVar *parent);
+void jswrap_net_socket_wsMode(JsVar *parent, bool enabled);
+bool jswrap_net_socket_wsSend(JsVar *parent, JsVar *data, int opcode, bool mask);
 bool jswrap_net_socket_write(JsVar *parent, JsVar *data);
 void jswrap_net_socket_end(JsVar *parent, JsVar *data);
 
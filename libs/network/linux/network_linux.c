@@ -42,6 +42,16 @@
 
 #define closesocket(SOCK) close(SOCK)
 
+#ifdef __linux__
+// let jshSleep block in epoll and still wake when socket data arrives
+// (see targets/linux/jshardware.c)
+extern void jshPollWatchFd(int fd);
+extern void jshPollUnwatchFd(int fd);
+#else
+#define jshPollWatchFd(FD)
+#define jshPollUnwatchFd(FD)
+#endif
+
 #if NET_DBG > 0
  #include "jsinteractive.h"
  #define DBG(format, ...) jsiConsolePrintf(format, ## __VA_ARGS__)
@@ -96,6 +106,7 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
       int optval = 1;
       if (setsockopt(sckt,SOL_SOCKET,SO_BROADCAST,(const char *)&optval,sizeof(optval))<0)
         jsWarn("setsockopt(SO_BROADCAST) failed\n");
+      jshPollWatchFd(sckt);
       return sckt;
     }
 
@@ -193,12 +204,14 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
     jsWarn("setsockopt(SO_NOSIGPIPE) failed\n");
 #endif
 
+  jshPollWatchFd(sckt);
   return sckt;
 }
 
 /// destroys the given socket
 void net_linux_closesocket(JsNetwork *net, int sckt) {
   NOT_USED(net);
+  jshPollUnwatchFd(sckt);
   closesocket(sckt);
 }
 
@@ -217,6 +230,7 @@ int net_linux_accept(JsNetwork *net, int sckt) {
   if (n>0) {
     // we have a client waiting to connect... try to connect and see what happens
     int theClient = accept(sckt,0,0);
+    if (theClient>=0) jshPollWatchFd(theClient);
     return theClient;
   }
   return -1;
@@ -301,6 +315,31 @@ int net_linux_send(JsNetwork *net, SocketType socketType, int sckt, const void *
     return 0; // just not ready
 }
 
+/// Check all our sockets with one select() rather than one each
+bool net_linux_poll(JsNetwork *net, const int *sockets, unsigned int nSockets, uint32_t *readyMask) {
+  NOT_USED(net);
+  fd_set s;
+  FD_ZERO(&s);
+  int maxfd = -1;
+  unsigned int i;
+  *readyMask = 0;
+  for (i=0;i<nSockets && i<32;i++) {
+    if (sockets[i]<0) continue;
+    FD_SET(sockets[i],&s);
+    if (sockets[i]>maxfd) maxfd = sockets[i];
+  }
+  if (maxfd<0) return true; // nothing open, nothing ready
+  struct timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 0;
+  int n = select(maxfd+1,&s,NULL,NULL,&timeout);
+  if (n==SOCKET_ERROR) return false; // can't tell - let the caller check each socket
+  for (i=0;i<nSockets && i<32;i++)
+    if (sockets[i]>=0 && FD_ISSET(sockets[i],&s))
+      *readyMask |= 1UL<<i;
+  return true;
+}
+
 void netSetCallbacks_linux(JsNetwork *net) {
   net->idle = net_linux_idle;
   net->checkError = net_linux_checkError;
@@ -310,5 +349,6 @@ void netSetCallbacks_linux(JsNetwork *net) {
   net->gethostbyname = net_linux_gethostbyname;
   net->recv = net_linux_recv;
   net->send = net_linux_send;
+  net->poll = net_linux_poll;
   net->chunkSize = 536;
 }
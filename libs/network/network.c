@@ -151,6 +151,25 @@ unsigned long networkFlipIPAddress(unsigned long addr) {
       ((addr&0xFF000000)>>24);
 }
 
+#ifndef SAVE_ON_FLASH
+/* A small cache of recent DNS lookups. On many network adapters (especially
+ * GPRS/WiFi-over-serial) a lookup takes hundreds of milliseconds, and it's
+ * common to make several requests to the same host in quick succession. */
+#define DNS_CACHE_ENTRIES 4
+#define DNS_CACHE_TTL_MS 60000
+typedef struct {
+  char hostName[64];
+  uint32_t ip_addr; ///< 0 = entry unused
+  JsSysTime expiryTime;
+} DnsCacheEntry;
+static DnsCacheEntry dnsCache[DNS_CACHE_ENTRIES];
+static unsigned char dnsCacheNext = 0; ///< next entry to overwrite
+
+void networkClearDnsCache() {
+  memset(dnsCache, 0, sizeof(dnsCache));
+}
+#endif
+
 /**
  * Get the IP address of a hostname.
  * Retrieve the IP address of a hostname and return it in the address of the
@@ -174,17 +193,44 @@ void networkGetHostByName(
 
   // first try and simply parse the IP address as a string
   *out_ip_addr = networkParseIPAddress(hostName);
+  if (*out_ip_addr) return;
+
+#ifndef SAVE_ON_FLASH
+  // have we resolved this host recently?
+  JsSysTime now = jshGetSystemTime();
+  int i;
+  for (i=0;i<DNS_CACHE_ENTRIES;i++) {
+    if (dnsCache[i].ip_addr && dnsCache[i].expiryTime>now &&
+        strcmp(dnsCache[i].hostName, hostName)==0) {
+      *out_ip_addr = dnsCache[i].ip_addr;
+      return;
+    }
+  }
+#endif
 
   // If we did not get an IP address from the string, then try and resolve it by
   // calling the network gethostbyname.
-  if (!*out_ip_addr) {
-    net->gethostbyname(net, hostName, out_ip_addr);
+  net->gethostbyname(net, hostName, out_ip_addr);
+
+#ifndef SAVE_ON_FLASH
+  // cache the result (but not failures, or 0xFFFFFFFF = 'still looking')
+  if (*out_ip_addr && *out_ip_addr!=0xFFFFFFFF &&
+      strlen(hostName) < sizeof(dnsCache[0].hostName)) {
+    DnsCacheEntry *e = &dnsCache[dnsCacheNext];
+    dnsCacheNext = (unsigned char)((dnsCacheNext+1) % DNS_CACHE_ENTRIES);
+    strcpy(e->hostName, hostName);
+    e->ip_addr = *out_ip_addr;
+    e->expiryTime = now + jshGetTimeFromMilliseconds(DNS_CACHE_TTL_MS);
   }
+#endif
 }
 
 
 
 void networkCreate(JsNetwork *net, JsNetworkType type) {
+#ifndef SAVE_ON_FLASH
+  networkClearDnsCache();
+#endif
   net->networkVar = jsvNewStringOfLength(sizeof(JsNetworkData), NULL);
   if (!net->networkVar) return;
   net->data.type = type;
@@ -228,6 +274,7 @@ bool networkGetFromVar(JsNetwork *net) {
 
   // Now we know which kind of network we are working with, invoke the corresponding initialization
   // function to set the callbacks for this network tyoe.
+  net->poll = 0; // optional - only some drivers provide it
   switch (net->data.type) {
 #if defined(USE_CC3000)
   case JSNETWORKTYPE_CC3000 : netSetCallbacks_cc3000(net); break;
@@ -286,6 +333,8 @@ JsNetwork *networkGetCurrent() {
 typedef struct {
   int sckt;
   bool connecting; // are we in the process of connecting?
+  uint32_t host; ///< who we connected to (for the session cache)
+  unsigned short port;
   mbedtls_ctr_drbg_context ctr_drbg;
   mbedtls_pk_context pkey;
   mbedtls_x509_crt owncert;
@@ -294,6 +343,51 @@ typedef struct {
   mbedtls_ssl_config conf;
 } SSLSocketData;
 
+/* Sessions from recent successful handshakes, kept so that reconnecting to
+ * the same server can use the abbreviated handshake (one round trip, no
+ * public-key operations) instead of a full one - on slow MCUs the full
+ * handshake can take seconds. */
+#define TLS_SESSION_CACHE_ENTRIES 2
+typedef struct {
+  uint32_t host; ///< 0 = entry unused
+  unsigned short port;
+  mbedtls_ssl_session session;
+} TLSSessionCacheEntry;
+static TLSSessionCacheEntry tlsSessionCache[TLS_SESSION_CACHE_ENTRIES];
+static unsigned char tlsSessionCacheNext = 0; ///< next entry to overwrite
+
+static TLSSessionCacheEntry *tls_session_find(uint32_t host, unsigned short port) {
+  int i;
+  for (i=0;i<TLS_SESSION_CACHE_ENTRIES;i++)
+    if (tlsSessionCache[i].host==host && tlsSessionCache[i].port==port)
+      return &tlsSessionCache[i];
+  return 0;
+}
+
+/// Remember this socket's session for later resumption
+static void tls_session_save(SSLSocketData *sd) {
+  if (!sd->host) return;
+  TLSSessionCacheEntry *e = tls_session_find(sd->host, sd->port);
+  if (!e) {
+    e = &tlsSessionCache[tlsSessionCacheNext];
+    tlsSessionCacheNext = (unsigned char)((tlsSessionCacheNext+1) % TLS_SESSION_CACHE_ENTRIES);
+  }
+  mbedtls_ssl_session_free(&e->session); // also zeroes it, ready for the copy
+  if (mbedtls_ssl_get_session(&sd->ssl, &e->session)==0) {
+    e->host = sd->host;
+    e->port = sd->port;
+  } else
+    e->host = 0;
+}
+
+/// Forget any session for this server (eg. after a failed handshake)
+static void tls_session_drop(uint32_t host, unsigned short port) {
+  TLSSessionCacheEntry *e = tls_session_find(host, port);
+  if (!e) return;
+  mbedtls_ssl_session_free(&e->session);
+  e->host = 0;
+}
+
 static void ssl_debug( void *ctx, int level,
                       const char *file, int line, const char *str )
 {
@@ -496,7 +590,7 @@ bool ssl_load_cacert(SSLSocketData *sd, JsVar *options) {
   return true;
 }
 
-bool ssl_newSocketData(int sckt, JsVar *options) {
+bool ssl_newSocketData(int sckt, JsVar *options, uint32_t host, unsigned short port) {
   /* FIXME Warning:
    *
    * MBEDTLS_SSL_MAX_CONTENT_LEN = 16kB, so we need over double this = 32kB memory
@@ -531,6 +625,8 @@ bool ssl_newSocketData(int sckt, JsVar *options) {
   // Now initialise this
   sd->sckt = sckt;
   sd->connecting = true;
+  sd->host = host;
+  sd->port = port;
 
   // jsiConsolePrintf( "Connecting with TLS...\n" );
 
@@ -605,6 +701,12 @@ bool ssl_newSocketData(int sckt, JsVar *options) {
     return false;
   }
 
+  // offer the session from our last visit to this server, if we kept one -
+  // the server can then do the abbreviated handshake
+  TLSSessionCacheEntry *cached = tls_session_find(host, port);
+  if (cached)
+    mbedtls_ssl_set_session( &sd->ssl, &cached->session );
+
   mbedtls_ssl_set_bio( &sd->ssl, &sd->sckt, ssl_send, ssl_recv, NULL );
 
   // jsiConsolePrintf("Performing the SSL/TLS handshake...\n" );
@@ -634,6 +736,7 @@ SSLSocketData *ssl_getSocketData(int sckt) {
         JsVar *e = jswrap_crypto_error_to_jsvar(ret);
         jsExceptionHere(JSET_INTERNALERROR,  "Failed! mbedtls_ssl_handshake returned %v\n", e );
         jsvUnLock(e);
+        tls_session_drop(sd->host, sd->port); // in case a stale session was to blame
         return 0; // this signals an error
       }
       // else we just continue - connecting=true so other things should wait
@@ -650,6 +753,7 @@ SSLSocketData *ssl_getSocketData(int sckt) {
         return 0;
       }
       sd->connecting = false;
+      tls_session_save(sd); // so the next connection to this server is quick
     }
   }
 
@@ -671,7 +775,7 @@ int netCreateSocket(JsNetwork *net, SocketType socketType, uint32_t host, unsign
 #ifdef USE_TLS
   assert(sckt>=0 && sckt<32);
   if (socketType & ST_TLS) {
-    if (ssl_newSocketData(sckt, options)) {
+    if (ssl_newSocketData(sckt, options, host, port)) {
     } else {
       return -1; // fail!
     }
@@ -697,6 +801,11 @@ void netGetHostByName(JsNetwork *net, char * hostName, uint32_t* out_ip_addr) {
   net->gethostbyname(net, hostName, out_ip_addr);
 }
 
+bool netPoll(JsNetwork *net, const int *sockets, unsigned int nSockets, uint32_t *readyMask) {
+  if (!net->poll) return false;
+  return net->poll(net, sockets, nSockets, readyMask);
+}
+
 int netRecv(JsNetwork *net, SocketType socketType, int sckt, void *buf, size_t len) {
 #ifdef USE_TLS
   if (socketType & ST_TLS) {
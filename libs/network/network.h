@@ -83,6 +83,11 @@ typedef struct JsNetwork {
   int (*recv)(struct JsNetwork *net, SocketType socketType, int sckt, void *buf, size_t len);
   /// Send data if possible. returns nBytes on success, 0 on no data, or -1 on failure
   int (*send)(struct JsNetwork *net, SocketType socketType, int sckt, const void *buf, size_t len);
+  /** Optional (may be 0): report which of the given sockets need attention
+   * (data/close/incoming connection waiting), in one driver operation - bit n
+   * of readyMask corresponds to sockets[n]. Returns false if it couldn't
+   * tell, in which case callers fall back to checking every socket. */
+  bool (*poll)(struct JsNetwork *net, const int *sockets, unsigned int nSockets, uint32_t *readyMask);
 } PACKED_FLAGS JsNetwork;
 
 // ---------------------------------- these are in network.c
@@ -99,6 +104,9 @@ JsNetwork *networkGetCurrent(); ///< Get the currently active network structure.
 
 /// Use this for getting the hostname, as it parses the name to see if it is an IP address first
 void networkGetHostByName(JsNetwork *net, char * hostName, uint32_t* out_ip_addr);
+#ifndef SAVE_ON_FLASH
+void networkClearDnsCache(); ///< Forget cached DNS lookups (eg. when changing networks)
+#endif
 uint32_t networkParseIPAddress(const char *ip);
 /* given 6 pairs of 8 bit hex numbers separated by ':', parse them into a
  * 6 byte array. returns false on failure */
@@ -125,6 +133,10 @@ int netAccept(JsNetwork *net, int sckt);
 
 void netGetHostByName(JsNetwork *net, char * hostName, uint32_t* out_ip_addr);
 
+/** One-call status check of many sockets (see JsNetwork.poll). Returns false
+ * if the driver can't do this - check each socket individually then. */
+bool netPoll(JsNetwork *net, const int *sockets, unsigned int nSockets, uint32_t *readyMask);
+
 int netRecv(JsNetwork *net, SocketType socketType, int sckt, void *buf, size_t len);
 int netSend(JsNetwork *net, SocketType socketType, int sckt, const void *buf, size_t len);
 
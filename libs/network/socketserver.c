@@ -23,14 +23,18 @@
 #define HTTP_NAME_PORT "port"
 #define HTTP_NAME_SOCKET "sckt"
 #define HTTP_NAME_HAD_HEADERS "hdrs"
+#define HTTP_NAME_HEADER_STATE "hScn" // header scan position*4 + \r\n\r\n match state
 #define HTTP_NAME_RECEIVE_DATA "dRcv"
 #define HTTP_NAME_RECEIVE_COUNT "cRcv"
 #define HTTP_NAME_SEND_DATA "dSnd"
+#define HTTP_NAME_SEND_OFFSET "oSnd" // how much of the head send buffer has gone out
 #define HTTP_NAME_RESPONSE_VAR "res"
 #define HTTP_NAME_OPTIONS_VAR "opt"
 #define HTTP_NAME_SERVER_VAR "svr"
 #define HTTP_NAME_CHUNKED "chunked"
 #define HTTP_NAME_CLOSENOW "clsNow"  // boolean: gotta close
+#define HTTP_NAME_PAUSED "paus"      // boolean: set by pause() - don't netRecv while set
+#define HTTP_NAME_MAX_RECEIVE "maxReceiveBuffer" // user-visible: cap on buffered unread receive data
 #define HTTP_NAME_CONNECTED "conn"     // boolean: we are connected
 #define HTTP_NAME_CLOSE "cls"        // close after sending
 #define HTTP_NAME_ON_CONNECT JS_EVENT_PREFIX"connect"
@@ -39,10 +43,26 @@
 #define HTTP_NAME_ON_DRAIN JS_EVENT_PREFIX"drain"
 #define HTTP_NAME_ON_ERROR JS_EVENT_PREFIX"error"
 
+// don't let a hostile/broken peer stream us an endless header
+#define HTTP_MAX_HEADER_LENGTH 2048
+
 #define HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS "HttpCC"
 #define HTTP_ARRAY_HTTP_SERVERS "HttpS"
 #define HTTP_ARRAY_HTTP_SERVER_CONNECTIONS "HttpSC"
 
+#ifndef SAVE_ON_FLASH
+/* Keep-alive pooling for HTTP client sockets. When a request was made with
+ * `keepAlive:true` and the response declared a Content-Length, the TCP
+ * connection is parked here once the response is complete, and the next
+ * request to the same host:port reuses it rather than paying for DNS +
+ * connect again. */
+#define HTTP_ARRAY_HTTP_CLIENT_POOL "HttpPool"
+#define HTTP_NAME_HOST_ADDR "addr"   // client connection: resolved address, set if keep-alive was requested
+#define HTTP_NAME_RECEIVE_REMAINING "bRcv" // client connection: response body bytes still expected (from Content-Length)
+#define HTTP_CLIENT_POOL_SIZE 4
+#define HTTP_CLIENT_POOL_TIMEOUT_MS 10000
+#endif
+
 #ifdef ESP8266
 // esp8266 debugging, need to remove this eventually
 extern int os_printf_plus(const char *format, ...)  __attribute__((format(printf, 1, 2)));
@@ -79,15 +99,17 @@ static void httpAppendHeaders(JsVar *string, JsVar *headerObject) {
   // free headers
 }
 
-// httpParseHeaders(&receiveData, reqVar, true) // server
-// httpParseHeaders(&receiveData, resVar, false) // client
-bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer) {
-  // find /r/n/r/n
-  int newlineIdx = 0;
-  int strIdx = 0;
+// httpParseHeaders(&receiveData, connection, reqVar, true) // server
+// httpParseHeaders(&receiveData, connection, resVar, false) // client
+bool httpParseHeaders(JsVar **receiveData, JsVar *connection, JsVar *objectForData, bool isServer) {
+  // find /r/n/r/n - resuming from where the last chunk's scan stopped rather
+  // than rescanning receiveData from the start every time more arrives
+  JsVarInt scanState = jsvGetIntegerAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_HEADER_STATE, 0));
+  int newlineIdx = (int)(scanState&3);
+  int strIdx = (int)(scanState>>2);
   int headerEnd = -1;
   JsvStringIterator it;
-  jsvStringIteratorNew(&it, *receiveData, 0);
+  jsvStringIteratorNew(&it, *receiveData, (size_t)strIdx);
   while (jsvStringIteratorHasChar(&it)) {
     char ch = jsvStringIteratorGetChar(&it);
     if (ch == '\r') {
@@ -104,8 +126,17 @@ bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer)
     strIdx++;
   }
   jsvStringIteratorFree(&it);
-  // skip if we have no header
-  if (headerEnd<0) return false;
+  // skip if we have no header (yet)
+  if (headerEnd<0) {
+    if (strIdx > HTTP_MAX_HEADER_LENGTH) {
+      // far too big - close rather than buffering it until we run out of memory
+      jsvObjectSetChildAndUnLock(connection, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
+    } else {
+      jsvObjectSetChildAndUnLock(connection, HTTP_NAME_HEADER_STATE, jsvNewFromInteger((JsVarInt)(strIdx<<2) | newlineIdx));
+    }
+    return false;
+  }
+  jsvObjectRemoveChild(connection, HTTP_NAME_HEADER_STATE);
   // Now parse the header
   JsVar *vHeaders = jsvNewObject();
   if (!vHeaders) return true;
@@ -199,6 +230,65 @@ static NO_INLINE void socketSetType(JsVar *var, SocketType socketType) {
   jsvObjectSetChildAndUnLock(var, HTTP_NAME_SOCKETTYPE, jsvNewFromInteger((JsVarInt)socketType));
 }
 
+// -----------------------------
+
+/* One driver-level poll at the start of each idle, covering every socket we
+ * have open. Drivers that can check all their sockets in one operation (a
+ * select() on Linux/lwip, one AT status query on serial WiFi modules) report
+ * which ones need attention, and the idle loops below skip the per-socket
+ * recv for the rest - so idle cost scales with ready sockets, not open ones.
+ * If the driver has no poll (or it fails), every socket is treated as ready
+ * and behaviour is exactly as before. */
+static bool pollValid;            ///< the driver gave us a (still current) answer
+static uint32_t pollReadyMask;    ///< bit n = pollSockets[n] needs attention
+static int pollSockets[32];
+static unsigned int pollSocketCount;
+
+static void socketPollAddArray(const char *name) {
+  JsVar *arr = socketGetArray(name, false);
+  if (!arr) return;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, arr);
+  while (jsvObjectIteratorHasValue(&it) && pollSocketCount < 32) {
+    JsVar *connection = jsvObjectIteratorGetValue(&it);
+#ifdef USE_TLS
+    if (socketGetType(connection) & ST_TLS) {
+      // mbedtls can be holding decrypted data even when the socket is quiet
+      jsvUnLock(connection);
+      jsvObjectIteratorNext(&it);
+      continue;
+    }
+#endif
+    int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1;
+    if (sckt>=0) pollSockets[pollSocketCount++] = sckt;
+    jsvUnLock(connection);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(arr);
+}
+
+static void socketPoll(JsNetwork *net) {
+  pollValid = false;
+  pollSocketCount = 0;
+  socketPollAddArray(HTTP_ARRAY_HTTP_SERVERS);
+  socketPollAddArray(HTTP_ARRAY_HTTP_SERVER_CONNECTIONS);
+  socketPollAddArray(HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS);
+#ifndef SAVE_ON_FLASH
+  socketPollAddArray(HTTP_ARRAY_HTTP_CLIENT_POOL);
+#endif
+  pollValid = netPoll(net, pollSockets, pollSocketCount, &pollReadyMask);
+}
+
+/// Does this socket need attention? Anything we couldn't poll is assumed to need it
+static bool socketPollReady(int sckt) {
+  if (!pollValid || sckt<0) return true;
+  unsigned int i;
+  for (i=0;i<pollSocketCount;i++)
+    if (pollSockets[i]==sckt) return (pollReadyMask>>i)&1;
+  return true; // not in the list (TLS, or opened since the poll)
+}
+
 void _socketConnectionKill(JsNetwork *net, JsVar *connection) {
   if (!net || networkState != NETWORKSTATE_ONLINE) return;
   int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
@@ -218,6 +308,251 @@ bool _socketConnectionOpen(JsVar *connection) {
 
 // -----------------------------
 
+#ifndef SAVE_ON_FLASH
+/// Park a kept-alive client socket for later reuse (closes it if the pool is full)
+static void socketPoolPut(JsNetwork *net, uint32_t host_addr, unsigned short port, int sckt) {
+  JsVar *pool = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_POOL, true);
+  if (!pool) {
+    netCloseSocket(net, ST_HTTP, sckt);
+    return;
+  }
+  if (jsvGetArrayLength(pool) >= HTTP_CLIENT_POOL_SIZE) {
+    // full - drop the oldest entry to make room
+    JsVar *old = jsvArrayPopFirst(pool);
+    int oldSckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(old, HTTP_NAME_SOCKET, 0))-1;
+    if (oldSckt>=0) netCloseSocket(net, ST_HTTP, oldSckt);
+    jsvUnLock(old);
+  }
+  JsVar *entry = jsvNewObject();
+  if (entry) {
+    jsvObjectSetChildAndUnLock(entry, HTTP_NAME_HOST_ADDR, jsvNewFromInteger((JsVarInt)host_addr));
+    jsvObjectSetChildAndUnLock(entry, HTTP_NAME_PORT, jsvNewFromInteger(port));
+    jsvObjectSetChildAndUnLock(entry, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1));
+    jsvObjectSetChildAndUnLock(entry, "tmo", jsvNewFromLongInteger(
+        jshGetSystemTime() + jshGetTimeFromMilliseconds(HTTP_CLIENT_POOL_TIMEOUT_MS)));
+    jsvArrayPush(pool, entry);
+    jsvUnLock(entry);
+  } else
+    netCloseSocket(net, ST_HTTP, sckt);
+  jsvUnLock(pool);
+}
+
+/// Take a pooled client socket for this host:port if we have one, else -1
+static int socketPoolTake(uint32_t host_addr, unsigned short port) {
+  JsVar *pool = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_POOL, false);
+  if (!pool) return -1;
+  int sckt = -1;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, pool);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *entry = jsvObjectIteratorGetValue(&it);
+    if (jsvGetIntegerAndUnLock(jsvObjectGetChild(entry, HTTP_NAME_HOST_ADDR, 0))==(JsVarInt)host_addr &&
+        jsvGetIntegerAndUnLock(jsvObjectGetChild(entry, HTTP_NAME_PORT, 0))==(JsVarInt)port) {
+      sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(entry, HTTP_NAME_SOCKET, 0))-1;
+      JsVar *idx = jsvObjectIteratorGetKey(&it);
+      jsvRemoveChild(pool, idx);
+      jsvUnLock2(idx, entry);
+      break;
+    }
+    jsvUnLock(entry);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(pool);
+  return sckt;
+}
+
+/// Close pooled sockets that have expired, or that the server has closed on us
+static void socketPoolIdle(JsNetwork *net) {
+  JsVar *pool = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_POOL, false);
+  if (!pool) return;
+  JsSysTime now = jshGetSystemTime();
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, pool);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *entry = jsvObjectIteratorGetValue(&it);
+    int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(entry, HTTP_NAME_SOCKET, 0))-1;
+    char buf[16];
+    /* a parked socket should be silent - any data (stray bytes or a FIN)
+     * means we can't safely reuse it */
+    bool dead = jsvGetLongIntegerAndUnLock(jsvObjectGetChild(entry, "tmo", 0)) < now ||
+                (sckt>=0 && socketPollReady(sckt) && netRecv(net, ST_HTTP, sckt, buf, sizeof(buf))!=0);
+    if (dead) {
+      if (sckt>=0) netCloseSocket(net, ST_HTTP, sckt);
+      JsVar *idx = jsvObjectIteratorGetKey(&it);
+      jsvObjectIteratorNext(&it);
+      jsvRemoveChild(pool, idx);
+      jsvUnLock(idx);
+    } else
+      jsvObjectIteratorNext(&it);
+    jsvUnLock(entry);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(pool);
+}
+
+/// Close and forget all pooled client sockets
+static void socketPoolCloseAll(JsNetwork *net) {
+  JsVar *pool = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_POOL, false);
+  if (!pool) return;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, pool);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *entry = jsvObjectIteratorGetValue(&it);
+    int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(entry, HTTP_NAME_SOCKET, 0))-1;
+    if (sckt>=0 && net && networkState==NETWORKSTATE_ONLINE)
+      netCloseSocket(net, ST_HTTP, sckt);
+    jsvUnLock(entry);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvRemoveAllChildren(pool);
+  jsvUnLock(pool);
+}
+/* ===== WebSocket framing ====================================================
+ * Native encode/decode of WebSocket frames, for use by a JS ws module once
+ * it has done the HTTP upgrade handshake. Deframing byte-by-byte in JS costs
+ * more than the network transfer itself at any real message rate, so once
+ * `wsMode` is set on a socket its incoming data is parsed here instead of
+ * being pushed as 'data', and each complete frame fires a 'message' event
+ * with the unmasked payload as a flat string. */
+
+#define HTTP_NAME_WS_MODE "wsMode"  // set on a socket: deframe incoming data as WebSocket frames
+#define HTTP_NAME_WS_BUFFER "wsBuf" // partial frame waiting for the rest to arrive
+#define HTTP_NAME_ON_MESSAGE JS_EVENT_PREFIX"message"
+
+/// XOR the 4-byte mask over the payload, a word at a time where possible
+static void wsApplyMask(char *data, size_t len, const unsigned char *key) {
+  size_t i = 0;
+  while (i<len && ((size_t)&data[i] & 3)) { // unaligned leading bytes
+    data[i] = (char)(data[i] ^ key[i&3]);
+    i++;
+  }
+  if (i+4<=len) {
+    unsigned char rotkey[4]; // the key rotated to match our offset
+    unsigned int j;
+    for (j=0;j<4;j++) rotkey[j] = key[(i+j)&3];
+    uint32_t k;
+    memcpy(&k, rotkey, 4);
+    uint32_t *w = (uint32_t*)&data[i];
+    while (i+4<=len) {
+      *w++ ^= k;
+      i+=4;
+    }
+  }
+  while (i<len) {
+    data[i] = (char)(data[i] ^ key[i&3]);
+    i++;
+  }
+}
+
+void socketWsSetMode(JsVar *socket, bool enabled) {
+  if (enabled) {
+    jsvObjectSetChildAndUnLock(socket, HTTP_NAME_WS_MODE, jsvNewFromBool(true));
+  } else {
+    jsvObjectRemoveChild(socket, HTTP_NAME_WS_MODE);
+    jsvObjectRemoveChild(socket, HTTP_NAME_WS_BUFFER);
+  }
+}
+
+/// Wrap `data` in a single WebSocket frame. Returns a flat string, or 0 on failure
+JsVar *socketWsFrame(JsVar *data, int opcode, bool mask) {
+  JsVar *str = jsvAsString(data, false);
+  if (!str) return 0;
+  size_t len = jsvGetStringLength(str);
+  size_t headerLen = (size_t)(2 + (len>125 ? (len>65535?8:2) : 0) + (mask?4:0));
+  JsVar *frame = jsvNewFlatStringOfLength((unsigned int)(headerLen+len));
+  if (!frame) {
+    jsvUnLock(str);
+    return 0;
+  }
+  unsigned char *p = (unsigned char*)jsvGetFlatStringPointer(frame);
+  *p++ = (unsigned char)(0x80 | (opcode&15)); // FIN + opcode
+  if (len>65535) {
+    *p++ = (unsigned char)((mask?0x80:0) | 127);
+    int sh;
+    for (sh=56;sh>=0;sh-=8)
+      *p++ = (unsigned char)(((unsigned long long)len)>>sh);
+  } else if (len>125) {
+    *p++ = (unsigned char)((mask?0x80:0) | 126);
+    *p++ = (unsigned char)(len>>8);
+    *p++ = (unsigned char)len;
+  } else {
+    *p++ = (unsigned char)((mask?0x80:0) | len);
+  }
+  unsigned char key[4];
+  if (mask) {
+    uint32_t r = (uint32_t)jshGetRandomNumber();
+    memcpy(key, &r, 4);
+    memcpy(p, key, 4);
+    p += 4;
+  }
+  jsvGetStringChars(str, 0, (char*)p, len);
+  if (mask) wsApplyMask((char*)p, len, key);
+  jsvUnLock(str);
+  return frame;
+}
+
+/** If this socket is in WebSocket mode, consume `data` and fire a 'message'
+ * event (payload, opcode) for each complete frame. Returns true if the data
+ * was handled here (so it mustn't also be pushed as 'data'). */
+bool socketWsDeframe(JsVar *socket, JsVar *data) {
+  if (!jsvGetBoolAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_WS_MODE, 0)))
+    return false;
+  JsVar *buf = jsvObjectGetChild(socket, HTTP_NAME_WS_BUFFER, 0);
+  if (buf) jsvAppendStringVarComplete(buf, data);
+  else buf = jsvLockAgain(data);
+  size_t avail = jsvGetStringLength(buf);
+  size_t pos = 0;
+  for (;;) {
+    unsigned char hdr[14]; // the longest possible header
+    if (pos+2 > avail) break;
+    jsvGetStringChars(buf, pos, (char*)hdr, (avail-pos)<14 ? (avail-pos) : 14);
+    int opcode = hdr[0]&15;
+    bool masked = (hdr[1]&0x80)!=0;
+    size_t plen = hdr[1]&0x7F;
+    size_t off = 2;
+    if (plen==126) {
+      if (pos+4 > avail) break;
+      plen = (size_t)((hdr[2]<<8) | hdr[3]);
+      off = 4;
+    } else if (plen==127) {
+      if (pos+10 > avail) break;
+      plen = 0;
+      int i;
+      for (i=2;i<10;i++) plen = (plen<<8) | hdr[i];
+      off = 10;
+    }
+    if (masked && pos+off+4 > avail) break;
+    size_t dataStart = off + (masked?4:0);
+    if (pos+dataStart+plen > avail) break; // payload not all here yet
+    JsVar *payload = jsvNewFlatStringOfLength((unsigned int)plen);
+    if (!payload) break; // out of memory - leave it buffered and try again later
+    char *pp = jsvGetFlatStringPointer(payload);
+    jsvGetStringChars(buf, pos+dataStart, pp, plen);
+    if (masked) wsApplyMask(pp, plen, &hdr[off]);
+    JsVar *args[2] = { payload, jsvNewFromInteger(opcode) };
+    jsiQueueObjectCallbacks(socket, HTTP_NAME_ON_MESSAGE, args, 2);
+    jsvUnLock2(args[0], args[1]);
+    pos += dataStart + plen;
+  }
+  // keep anything left over for when the rest arrives
+  if (pos>=avail) {
+    jsvObjectRemoveChild(socket, HTTP_NAME_WS_BUFFER);
+  } else if (pos==0) {
+    jsvObjectSetChild(socket, HTTP_NAME_WS_BUFFER, buf); // nothing used - no need to copy
+  } else {
+    JsVar *rest = jsvNewFromStringVar(buf, pos, JSVAPPENDSTRINGVAR_MAXLENGTH);
+    if (rest) jsvObjectSetChildAndUnLock(socket, HTTP_NAME_WS_BUFFER, rest);
+  }
+  jsvUnLock(buf);
+  return true;
+}
+
+#endif // SAVE_ON_FLASH
+
+// -----------------------------
+
 NO_INLINE static void _socketCloseAllConnectionsFor(JsNetwork *net, char *name) {
   JsVar *arr = socketGetArray(name, false);
   if (!arr) return;
@@ -239,47 +574,113 @@ NO_INLINE static void _socketCloseAllConnections(JsNetwork *net) {
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_SERVER_CONNECTIONS);
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS);
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_SERVERS);
+#ifndef SAVE_ON_FLASH
+  socketPoolCloseAll(net);
+#endif
 }
 
 // returns 0 on success and a (negative) error number on failure
+/* sendData on a socket is a queue (array) of strings consumed front-to-back,
+ * so each write is an O(1) enqueue however much is already waiting and netSend
+ * only ever walks the head buffer. How much of the head buffer has already
+ * been sent is kept in HTTP_NAME_SEND_OFFSET on the socket. */
+static JsVar *socketSendQueuePeek(JsVar *sendData) {
+  // can't use jsvGetArrayItem(sendData,0) - popping the head doesn't renumber
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, sendData);
+  JsVar *head = jsvObjectIteratorGetValue(&it);
+  jsvObjectIteratorFree(&it);
+  return head;
+}
+
+static bool socketSendQueueEmpty(JsVar *sendData) {
+  return !sendData || jsvGetChildren(sendData)==0;
+}
+
+/* How much we're prepared to netRecv for this socket right now: the usual
+ * chunk, less if maxReceiveBuffer says the buffer is nearly full, or 0 if
+ * the socket is paused or the buffer is full. This is what keeps a download
+ * at a bounded memory footprint when JS can't keep up. */
+static size_t socketRecvLimit(JsVar *socket, JsVar *receiveData, size_t chunkSize) {
+  if (jsvGetBoolAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_PAUSED, 0)))
+    return 0;
+  JsVarInt max = jsvGetIntegerAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_MAX_RECEIVE, 0));
+  if (max>0) {
+    JsVarInt buffered = receiveData ? (JsVarInt)jsvGetStringLength(receiveData) : 0;
+    // unread data the stream layer has claimed (no 'data' listener) counts too
+    JsVar *streamBuf = jsvObjectGetChild(socket, STREAM_BUFFER_NAME, 0);
+    if (streamBuf) buffered += (JsVarInt)jsvGetStringLength(streamBuf);
+    jsvUnLock(streamBuf);
+    if (buffered >= max) return 0;
+    if (max-buffered < (JsVarInt)chunkSize) return (size_t)(max-buffered);
+  }
+  return chunkSize;
+}
+
+void socketSetPaused(JsVar *socket, bool paused) {
+  if (paused)
+    jsvObjectSetChildAndUnLock(socket, HTTP_NAME_PAUSED, jsvNewFromBool(true));
+  else
+    jsvObjectRemoveChild(socket, HTTP_NAME_PAUSED);
+}
+
 int socketSendData(JsNetwork *net, JsVar *connection, int sckt, JsVar **sendData) {
   SocketType socketType = socketGetType(connection);
 
-  assert(!jsvIsEmptyString(*sendData));
-
-  size_t sndBufLen;
-  if ((socketType&ST_TYPE_MASK)==ST_UDP) {
-      sndBufLen = (size_t)jsvGetStringLength(*sendData);
+  assert(!socketSendQueueEmpty(*sendData));
+  JsVar *buf = socketSendQueuePeek(*sendData);
+  if (!buf) return 0;
+  size_t offset = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_SEND_OFFSET, 0));
+  size_t bufLen = jsvGetStringLength(buf);
+  size_t sndLen = bufLen - offset;
+
+  int num;
+  size_t dataLen;
+  char *sndPtr = jsvGetDataPointer(buf, &dataLen);
+  if (sndPtr) {
+    // flat/native string - transmit straight out of it, no stack copy
+    sndPtr += offset;
+    if ((socketType&ST_TYPE_MASK)!=ST_UDP && sndLen > (size_t)net->chunkSize)
+      sndLen = (size_t)net->chunkSize;
+    num = netSend(net, socketType, sckt, sndPtr, sndLen);
+    DBG("socketSendData direct (%d -> %d)\n", sndLen, num);
+  } else {
+    size_t sndBufLen = sndLen;
+    if ((socketType&ST_TYPE_MASK)==ST_UDP) {
+      // UDP datagrams (address prefix + payload) must go out in one piece
       if (sndBufLen+1024 > jsuGetFreeStack()) {
           jsExceptionHere(JSET_ERROR, "Not enough free stack to send this amount of data");
+          jsvUnLock(buf);
           return -1;
       }
-  } else {
-      sndBufLen = (size_t)net->chunkSize;
-  }
-  char *buf = alloca(sndBufLen); // allocate on stack
+    } else {
+      if (sndBufLen > (size_t)net->chunkSize)
+        sndBufLen = (size_t)net->chunkSize;
+    }
+    char *stackBuf = alloca(sndBufLen); // allocate on stack
 
-  size_t bufLen = httpStringGet(*sendData, buf, sndBufLen);
-  int num = netSend(net, socketType, sckt, buf, bufLen);
-  DBG("socketSendData %x:%d (%d -> %d)\n", *(uint32_t*)buf, *(unsigned short*)(buf+sizeof(uint32_t)), bufLen, num);
+    size_t len = jsvGetStringChars(buf, offset, stackBuf, sndBufLen);
+    num = netSend(net, socketType, sckt, stackBuf, len);
+    DBG("socketSendData (%d -> %d)\n", len, num);
+  }
+  jsvUnLock(buf);
   if (num < 0) return num; // an error occurred
-  // Now cut what we managed to send off the beginning of sendData
   if (num > 0) {
-    JsVar *newSendData = 0;
-    if (num < (int)jsvGetStringLength(*sendData)) {
-      // we didn't send all of it... cut out what we did send
-      newSendData = jsvNewFromStringVar(*sendData, (size_t)num, JSVAPPENDSTRINGVAR_MAXLENGTH);
-    } else {
+    offset += (size_t)num;
+    if (offset >= bufLen) {
+      // head buffer fully sent - drop it off the front of the queue
+      jsvUnLock(jsvArrayPopFirst(*sendData));
+      offset = 0;
+    }
+    jsvObjectSetChildAndUnLock(connection, HTTP_NAME_SEND_OFFSET, jsvNewFromInteger((JsVarInt)offset));
+    if (socketSendQueueEmpty(*sendData)) {
       // we sent all of it! Issue a drain event, unless we want to close, then we shouldn't
       // callback for more data
       bool wantClose = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_CLOSE,0));
       if (!wantClose) {
         jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
       }
-      newSendData = jsvNewFromEmptyString();
     }
-    jsvUnLock(*sendData);
-    *sendData = newSendData;
   }
 
   return 0;
@@ -307,6 +708,12 @@ void socketReceivedUDP(JsVar *connection, JsVar *receiveData, char *buf, int num
 
 // -----------------------------
 
+/** A pooled flat string that netRecv reads straight into, so drivers write
+ * directly to JS-visible memory. When a whole chunk arrives and nothing is
+ * buffered it is handed to the 'data' event as-is (no copy) and we pool a
+ * fresh one on the next receive. Kept between idle calls to avoid churn. */
+static JsVar *socketRecvBuffer = 0;
+
 void socketInit() {
 #ifdef WIN32
   // Init winsock 1.1
@@ -319,6 +726,8 @@ void socketInit() {
 
 void socketKill(JsNetwork *net) {
   _socketCloseAllConnections(net);
+  jsvUnLock(socketRecvBuffer);
+  socketRecvBuffer = 0;
 #ifdef WIN32
    // Shutdown Winsock
    WSACleanup();
@@ -346,8 +755,21 @@ static bool fireErrorEvent(int error, JsVar *obj1, JsVar *obj2) {
 
 // -----------------------------
 
+/* Get a pointer to receive into - the pooled flat string if we can get one,
+ * or stackBuf (which forces the old copying path) if memory is too low */
+static char *socketGetRecvBuffer(JsNetwork *net, char *stackBuf) {
+  if (socketRecvBuffer && jsvGetStringLength(socketRecvBuffer)!=(size_t)net->chunkSize) {
+    // wrong size - the active network's chunk size must have changed
+    jsvUnLock(socketRecvBuffer);
+    socketRecvBuffer = 0;
+  }
+  if (!socketRecvBuffer)
+    socketRecvBuffer = jsvNewFlatStringOfLength((unsigned int)net->chunkSize);
+  return socketRecvBuffer ? jsvGetFlatStringPointer(socketRecvBuffer) : stackBuf;
+}
+
 bool socketServerConnectionsIdle(JsNetwork *net) {
-  char *buf = alloca((size_t)net->chunkSize); // allocate on stack
+  char *buf = alloca((size_t)net->chunkSize); // fallback buffer on stack
 
   JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVER_CONNECTIONS,false);
   if (!arr) return false;
@@ -368,23 +790,37 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
     int error = 0;
 
     if (!closeConnectionNow) {
-      int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+      int num = 0;
+      char *recvPtr = 0;
+      JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+      size_t recvLen = socketRecvLimit(connection, receiveData, (size_t)net->chunkSize);
+      if (recvLen && socketPollReady(sckt)) {
+        recvPtr = socketGetRecvBuffer(net, buf);
+        num = netRecv(net, socketType, sckt, recvPtr, recvLen);
+      }
       if (num<0) {
         // we probably disconnected so just get rid of this
         closeConnectionNow = true;
         error = num;
       } else {
         if (num>0) {
-          JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
           JsVar *oldReceiveData = receiveData;
           if (!receiveData) receiveData = jsvNewFromEmptyString();
           if (receiveData) {
             if ((socketType&ST_TYPE_MASK)==ST_UDP) {
-              socketReceivedUDP(connection, receiveData, buf, num);
+              socketReceivedUDP(connection, receiveData, recvPtr, num);
             } else {
-              jsvAppendStringBuf(receiveData, buf, (size_t)num);
               bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_HAD_HEADERS,0));
-              if (!hadHeaders && httpParseHeaders(&receiveData, connection, true)) {
+              if (recvPtr!=buf && num==(int)net->chunkSize &&
+                  hadHeaders && jsvIsEmptyString(receiveData)) {
+                // a full chunk with nothing buffered - hand the flat string over as-is
+                jsvUnLock(receiveData);
+                receiveData = socketRecvBuffer; // take the pool's reference
+                socketRecvBuffer = 0;
+              } else {
+                jsvAppendStringBuf(receiveData, recvPtr, (size_t)num);
+              }
+              if (!hadHeaders && httpParseHeaders(&receiveData, connection, connection, true)) {
                 hadHeaders = true;
                 jsvObjectSetChildAndUnLock(connection, HTTP_NAME_HAD_HEADERS, jsvNewFromBool(hadHeaders));
                 JsVar *server = jsvObjectGetChild(connection,HTTP_NAME_SERVER_VAR,0);
@@ -402,7 +838,11 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
                       ));
                 }
                 // execute 'data' callback or save data
-                if (jswrap_stream_pushData(connection, receiveData, false)) {
+                if (
+#ifndef SAVE_ON_FLASH
+                    socketWsDeframe(connection, receiveData) ||
+#endif
+                    jswrap_stream_pushData(connection, receiveData, false)) {
                   // clear received data
                   jsvUnLock(receiveData);
                   receiveData = 0;
@@ -412,14 +852,14 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
               if (receiveData != oldReceiveData)
                 jsvObjectSetChild(connection,HTTP_NAME_RECEIVE_DATA,receiveData);
             }
-            jsvUnLock(receiveData);
           }
         }
       }
+      jsvUnLock(receiveData);
 
       // send data if possible
       JsVar *sendData = jsvObjectGetChild(socket,HTTP_NAME_SEND_DATA,0);
-      if (sendData && !jsvIsEmptyString(sendData)) {
+      if (!socketSendQueueEmpty(sendData)) {
         int sent = socketSendData(net, socket, sckt, &sendData);
         // FIXME? checking for errors is a bit iffy. With the esp8266 network that returns
         // varied error codes we'd want to skip SOCKET_ERR_CLOSED and let the recv side deal
@@ -434,7 +874,7 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
       }
       // only close if we want to close, have no data to send, and aren't receiving data
       bool wantClose = jsvGetBoolAndUnLock(jsvObjectGetChild(socket,HTTP_NAME_CLOSE,0));
-      if (wantClose && (!sendData || jsvIsEmptyString(sendData)) && num<=0) {
+      if (wantClose && socketSendQueueEmpty(sendData) && num<=0) {
         bool reallyCloseNow = true;
         if ((socketType&ST_TYPE_MASK)==ST_HTTP) {
           // Check if we had a Content-Length header - if so, we need to wait until we have received that amount
@@ -497,6 +937,9 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
 void socketClientPushReceiveData(JsVar *connection, JsVar *socket, JsVar **receiveData) {
   if (*receiveData) {
     if (jsvIsEmptyString(*receiveData) ||
+#ifndef SAVE_ON_FLASH
+        socketWsDeframe(socket, *receiveData) ||
+#endif
         jswrap_stream_pushData(socket, *receiveData, false)) {
       // clear - because we have issued a callback
       jsvObjectRemoveChild(connection,HTTP_NAME_RECEIVE_DATA);
@@ -524,6 +967,9 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
     JsVar *socket = ((socketType&ST_TYPE_MASK)==ST_HTTP) ? jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0) : jsvLockAgain(connection);
     bool socketClosed = false;
     JsVar *receiveData = 0;
+#ifndef SAVE_ON_FLASH
+    bool responseDone = false; // the HTTP response's Content-Length has all arrived
+#endif
 
     bool hadHeaders = false;
     int error = 0; // error code received from netXxxx functions
@@ -538,6 +984,20 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
         hadHeaders = true;
       receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
 
+#ifndef SAVE_ON_FLASH
+      /* If the response declared a Content-Length and we've counted it all in,
+       * it's complete - finish up now rather than waiting (possibly for a very
+       * long time with keep-alive) for the server to close the connection */
+      if (isHttp && hadHeaders && !closeConnectionNow) {
+        JsVar *remaining = jsvObjectGetChild(connection, HTTP_NAME_RECEIVE_REMAINING, 0);
+        if (remaining && jsvGetInteger(remaining)<=0) {
+          responseDone = true;
+          closeConnectionNow = true;
+        }
+        jsvUnLock(remaining);
+      }
+#endif
+
       /* We do this up here because we want to wait until we have been once
        * around the idle loop (=callbacks have been executed) before we run this */
       if (hadHeaders)
@@ -546,7 +1006,7 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
       if (!closeConnectionNow) {
         JsVar *sendData = jsvObjectGetChild(connection,HTTP_NAME_SEND_DATA,0);
         // send data if possible
-        if (sendData && !jsvIsEmptyString(sendData)) {
+        if (!socketSendQueueEmpty(sendData)) {
           // don't try to send if we're already in error state
           int num = 0;
           if (error == 0) {
@@ -567,9 +1027,13 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
           if (jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSE, false)))
             closeConnectionNow = true;
         }
-        // Now read data if possible (and we have space for it)
-        if (!receiveData || !hadHeaders) {
-          int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+        // Now read data if possible (and we have space for it, and we've not been paused)
+        size_t recvLen = socketRecvLimit(socket, receiveData, (size_t)net->chunkSize);
+        if ((!receiveData || !hadHeaders) && recvLen &&
+            (!alreadyConnected || socketPollReady(sckt))) { // must recv before connected - it's how we spot the connection
+
+          char *recvPtr = socketGetRecvBuffer(net, buf);
+          int num = netRecv(net, socketType, sckt, recvPtr, recvLen);
           if (!alreadyConnected && num == SOCKET_ERR_NO_CONN) {
             ; // ignore... it's just telling us we're not connected yet
           } else if (num < 0) {
@@ -584,31 +1048,58 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
               jsvObjectSetChildAndUnLock(connection, HTTP_NAME_CONNECTED, jsvNewFromBool(true));
               alreadyConnected = true;
               // if we do not have any data to send, issue a drain event
-              if (!sendData || (int)jsvGetStringLength(sendData) == 0)
+              if (socketSendQueueEmpty(sendData))
                 jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
             }
             // got data add it to our receive buffer
             if (num > 0) {
-              if (!receiveData) {
-                receiveData = jsvNewFromEmptyString();
+#ifndef SAVE_ON_FLASH
+              if (isHttp && hadHeaders) {
+                // count down the expected response body
+                JsVar *remaining = jsvObjectGetChild(connection, HTTP_NAME_RECEIVE_REMAINING, 0);
+                if (remaining)
+                  jsvObjectSetChildAndUnLock(connection, HTTP_NAME_RECEIVE_REMAINING,
+                      jsvNewFromInteger(jsvGetInteger(remaining)-num));
+                jsvUnLock(remaining);
               }
-              if (receiveData) { // could be out of memory
-                if ((socketType&ST_TYPE_MASK)==ST_UDP) {
-                  socketReceivedUDP(connection, receiveData, buf, num);
-                } else {
-                  jsvAppendStringBuf(receiveData, buf, (size_t)num);
-                  jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
-
-                  if ((socketType&ST_TYPE_MASK)==ST_HTTP && !hadHeaders) {
-                    // for HTTP see whether we now have full response headers
-                    JsVar *resVar = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
-                    if (httpParseHeaders(&receiveData, resVar, false)) {
-                      hadHeaders = true;
-                      jsvObjectSetChildAndUnLock(connection, HTTP_NAME_HAD_HEADERS, jsvNewFromBool(hadHeaders));
-                      jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_CONNECT, &resVar, 1);
-                    }
-                    jsvUnLock(resVar);
+#endif
+              if (!receiveData && recvPtr!=buf && num==(int)net->chunkSize && hadHeaders &&
+                  (socketType&ST_TYPE_MASK)!=ST_UDP) {
+                // a full chunk with nothing buffered - hand the flat string over as-is
+                receiveData = socketRecvBuffer; // take the pool's reference
+                socketRecvBuffer = 0;
+                jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
+              } else {
+                if (!receiveData) {
+                  receiveData = jsvNewFromEmptyString();
+                }
+                if (receiveData) { // could be out of memory
+                  if ((socketType&ST_TYPE_MASK)==ST_UDP) {
+                    socketReceivedUDP(connection, receiveData, recvPtr, num);
+                  } else {
+                    jsvAppendStringBuf(receiveData, recvPtr, (size_t)num);
                     jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
+
+                    if ((socketType&ST_TYPE_MASK)==ST_HTTP && !hadHeaders) {
+                      // for HTTP see whether we now have full response headers
+                      JsVar *resVar = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
+                      if (httpParseHeaders(&receiveData, connection, resVar, false)) {
+                        hadHeaders = true;
+                        jsvObjectSetChildAndUnLock(connection, HTTP_NAME_HAD_HEADERS, jsvNewFromBool(hadHeaders));
+#ifndef SAVE_ON_FLASH
+                        // note how much body to expect (anything after the header already counts)
+                        JsVar *headers = jsvObjectGetChild(resVar, "headers", 0);
+                        JsVar *contentLength = jsvObjectGetChild(headers, "Content-Length", 0);
+                        if (contentLength)
+                          jsvObjectSetChildAndUnLock(connection, HTTP_NAME_RECEIVE_REMAINING,
+                              jsvNewFromInteger(jsvGetInteger(contentLength) - (JsVarInt)jsvGetStringLength(receiveData)));
+                        jsvUnLock2(headers, contentLength);
+#endif
+                        jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_CONNECT, &resVar, 1);
+                      }
+                      jsvUnLock(resVar);
+                      jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
+                    }
                   }
                 }
               }
@@ -626,10 +1117,25 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
       if (!receiveData) {
         // If we had data to send but the socket closed, this is an error
         JsVar *sendData = jsvObjectGetChild(connection,HTTP_NAME_SEND_DATA,0);
-        if (sendData && jsvGetStringLength(sendData) > 0 && error == SOCKET_ERR_CLOSED)
+        if (!socketSendQueueEmpty(sendData) && error == SOCKET_ERR_CLOSED)
           error = SOCKET_ERR_UNSENT_DATA;
         jsvUnLock(sendData);
 
+#ifndef SAVE_ON_FLASH
+        if (responseDone && error==0) {
+          // keep-alive request completed cleanly - park the socket for reuse
+          JsVar *addr = jsvObjectGetChild(connection, HTTP_NAME_HOST_ADDR, 0);
+          if (addr) {
+            int liveSckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1;
+            if (liveSckt>=0) {
+              jsvObjectRemoveChild(connection, HTTP_NAME_SOCKET); // so the kill below won't close it
+              socketPoolPut(net, (uint32_t)jsvGetInteger(addr),
+                  (unsigned short)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_PORT,0)), liveSckt);
+            }
+            jsvUnLock(addr);
+          }
+        }
+#endif
         _socketConnectionKill(net, connection);
         JsVar *connectionName = jsvObjectIteratorGetKey(&it);
         jsvObjectIteratorNext(&it);
@@ -667,6 +1173,7 @@ bool socketIdle(JsNetwork *net) {
     _socketCloseAllConnections(net);
     return false;
   }
+  socketPoll(net);
   bool hadSockets = false;
   JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVERS,false);
   if (arr) {
@@ -682,7 +1189,8 @@ bool socketIdle(JsNetwork *net) {
       int theClient = -1;
       if ((socketType&ST_TYPE_MASK)!=ST_UDP) {
           int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(server,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
-          theClient = netAccept(net, sckt);
+          if (socketPollReady(sckt))
+            theClient = netAccept(net, sckt);
       }
       if (theClient >= 0) {
         if ((socketType&ST_TYPE_MASK) == ST_HTTP) {
@@ -726,6 +1234,9 @@ bool socketIdle(JsNetwork *net) {
 
   if (socketServerConnectionsIdle(net)) hadSockets = true;
   if (socketClientConnectionsIdle(net)) hadSockets = true;
+#ifndef SAVE_ON_FLASH
+  socketPoolIdle(net);
+#endif
   netCheckError(net);
   return hadSockets;
 }
@@ -832,19 +1343,25 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
   }
   SocketType socketType = socketGetType(httpClientReqVar);
 
-  // Append data to sendData
+  // Add data to the send queue
   JsVar *sendData = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, 0);
   if (!sendData) {
+    sendData = jsvNewEmptyArray();
     JsVar *options = 0;
-    // Only append a header if we're doing HTTP AND we haven't already connected
+    // Only send a header if we're doing HTTP AND we haven't already connected
     if ((socketType&ST_TYPE_MASK) == ST_HTTP)
       if (jsvGetIntegerAndUnLock(jsvObjectGetChild(httpClientReqVar, HTTP_NAME_SOCKET, 0))==0)
         options = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_OPTIONS_VAR, 0);
-    if (options) {
+    if (options && sendData) {
       // We're an HTTP client - make a header
       JsVar *method = jsvObjectGetChild(options, "method", 0);
       JsVar *path = jsvObjectGetChild(options, "path", 0);
-      sendData = jsvVarPrintf("%v %v HTTP/1.1\r\nUser-Agent: Espruino "JS_VERSION"\r\nConnection: close\r\n", method, path);
+      bool keepAlive = false;
+#ifndef SAVE_ON_FLASH
+      keepAlive = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "keepAlive", 0));
+#endif
+      JsVar *header = jsvVarPrintf("%v %v HTTP/1.1\r\nUser-Agent: Espruino "JS_VERSION"\r\nConnection: %s\r\n", method, path,
+          keepAlive ? "keep-alive" : "close");
       jsvUnLock2(method, path);
       JsVar *headers = jsvObjectGetChild(options, "headers", 0);
       bool hasHostHeader = false;
@@ -852,7 +1369,7 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
         JsVar *hostHeader = jsvObjectGetChild(headers, "Host", 0);
         hasHostHeader = hostHeader!=0;
         jsvUnLock(hostHeader);
-        httpAppendHeaders(sendData, headers);
+        httpAppendHeaders(header, headers);
         // if Transfer-Encoding:chunked was set, subsequent writes need to 'chunk' the data that is sent
         if (jsvIsStringEqualAndUnLock(jsvObjectGetChild(headers, "Transfer-Encoding", 0), "chunked")) {
           jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CHUNKED, jsvNewFromBool(true));
@@ -863,43 +1380,47 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
         JsVar *host = jsvObjectGetChild(options, "host", 0);
         int port = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "port", 0));
         if (port>0 && port!=80)
-          jsvAppendPrintf(sendData, "Host: %v:%d\r\n", host, port);
+          jsvAppendPrintf(header, "Host: %v:%d\r\n", host, port);
         else
-          jsvAppendPrintf(sendData, "Host: %v\r\n", host);
+          jsvAppendPrintf(header, "Host: %v\r\n", host);
         jsvUnLock(host);
       }
       // finally add ending newline
-      jsvAppendString(sendData, "\r\n");
-    } else { // !options
-      // We're not HTTP (or were already connected), so don't send any header
-      sendData = jsvNewFromString("");
-    }
+      jsvAppendString(header, "\r\n");
+      jsvArrayPush(sendData, header);
+      jsvUnLock(header);
+    } // else - not HTTP (or already connected): no header, the empty queue marks us started
     jsvObjectSetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, sendData);
     jsvUnLock(options);
   }
   // We have data and aren't out of memory...
   if (data && sendData) {
-    // append the data to what we want to send
+    // add the data to the send queue
     JsVar *s = jsvAsString(data, false);
     if (s) {
       if ((socketType&ST_TYPE_MASK) == ST_HTTP &&
           jsvGetBoolAndUnLock(jsvObjectGetChild(httpClientReqVar, HTTP_NAME_CHUNKED, 0))) {
         // If we asked to send 'chunked' data, we need to wrap it up,
         // prefixed with the length
-        jsvAppendPrintf(sendData, "%x\r\n%v\r\n", jsvGetStringLength(s), s);
-      } else {
-        if ((socketType&ST_TYPE_MASK) == ST_UDP) {
-          char hostName[128];
-          jsvGetString(host, hostName, sizeof(hostName));
-          uint32_t host_addr = 0;
-          uint16_t size = (uint16_t)jsvGetStringLength(s);
-          networkGetHostByName(net, hostName, &host_addr);
-          jsvAppendStringBuf(sendData, (const char*)&host_addr, sizeof(host_addr));
-          jsvAppendStringBuf(sendData, (const char*)&portNumber, sizeof(portNumber));
-          jsvAppendStringBuf(sendData, (const char*)&size, sizeof(size));
+        jsvArrayPushAndUnLock(sendData, jsvVarPrintf("%x\r\n%v\r\n", jsvGetStringLength(s), s));
+      } else if ((socketType&ST_TYPE_MASK) == ST_UDP) {
+        // a datagram's address prefix and payload must stay in one buffer
+        char hostName[128];
+        jsvGetString(host, hostName, sizeof(hostName));
+        uint32_t host_addr = 0;
+        uint16_t size = (uint16_t)jsvGetStringLength(s);
+        networkGetHostByName(net, hostName, &host_addr);
+        JsVar *datagram = jsvNewFromEmptyString();
+        if (datagram) {
+          jsvAppendStringBuf(datagram, (const char*)&host_addr, sizeof(host_addr));
+          jsvAppendStringBuf(datagram, (const char*)&portNumber, sizeof(portNumber));
+          jsvAppendStringBuf(datagram, (const char*)&size, sizeof(size));
+          jsvAppendStringVarComplete(datagram, s);
+          jsvArrayPush(sendData, datagram);
+          jsvUnLock(datagram);
         }
-
-        jsvAppendStringVarComplete(sendData,s);
+      } else {
+        jsvArrayPush(sendData, s); // the queue just references the string - no copy
       }
       jsvUnLock(s);
     }
@@ -952,7 +1473,23 @@ void clientRequestConnect(JsNetwork *net, JsVar *httpClientReqVar) {
     if (port==0) port = 80;
   }
 
-  int sckt =  netCreateSocket(net, socketType, host_addr, port, options);
+  int sckt = -1;
+#ifndef SAVE_ON_FLASH
+  if (socketType == ST_HTTP) { // plain HTTP only - a pooled TLS session can't be resumed
+    if (jsvGetBoolAndUnLock(jsvObjectGetChild(options, "keepAlive", 0))) {
+      // remember where we connected so the socket can be pooled when the response completes
+      jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_HOST_ADDR, jsvNewFromInteger((JsVarInt)host_addr));
+      jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_PORT, jsvNewFromInteger(port));
+    }
+    sckt = socketPoolTake(host_addr, port);
+    if (sckt>=0)
+      jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CONNECTED, jsvNewFromBool(true));
+  }
+  if (sckt<0)
+    sckt = netCreateSocket(net, socketType, host_addr, port, options);
+#else
+  sckt = netCreateSocket(net, socketType, host_addr, port, options);
+#endif
   if (sckt<0) {
     jsExceptionHere(JSET_INTERNALERROR, "Unable to create socket\n");
     // As this is already in the list of connections, an error will be thrown on idle anyway
@@ -984,7 +1521,7 @@ void clientRequestEnd(JsNetwork *net, JsVar *httpClientReqVar) {
     jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CLOSE, jsvNewFromBool(true));
     // if we never sent any data, make sure we close 'now'
     JsVar *sendData = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, 0);
-    if (!sendData || jsvIsEmptyString(sendData))
+    if (socketSendQueueEmpty(sendData))
       jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
     jsvUnLock(sendData);
   }
@@ -1005,10 +1542,13 @@ void serverResponseWriteHead(JsVar *httpServerResponseVar, int statusCode, JsVar
     return;
   }
 
-  sendData = jsvVarPrintf("HTTP/1.1 %d OK\r\nServer: Espruino "JS_VERSION"\r\n", statusCode);
-  if (headers) httpAppendHeaders(sendData, headers);
+  JsVar *header = jsvVarPrintf("HTTP/1.1 %d OK\r\nServer: Espruino "JS_VERSION"\r\n", statusCode);
+  if (headers) httpAppendHeaders(header, headers);
   // finally add ending newline
-  jsvAppendString(sendData, "\r\n");
+  jsvAppendString(header, "\r\n");
+  sendData = jsvNewEmptyArray();
+  if (sendData) jsvArrayPush(sendData, header);
+  jsvUnLock(header);
   jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_SEND_DATA, sendData);
 }
 
@@ -1030,7 +1570,7 @@ void serverResponseWrite(JsVar *httpServerResponseVar, JsVar *data) {
   // check, just in case!
   if (sendData && !jsvIsUndefined(data)) {
     JsVar *s = jsvAsString(data, false);
-    if (s) jsvAppendStringVarComplete(sendData,s);
+    if (s) jsvArrayPush(sendData, s); // the queue just references the string - no copy
     jsvUnLock(s);
   }
   jsvUnLock(sendData);
@@ -24,6 +24,16 @@ void socketInit();
 void socketKill(JsNetwork *net);
 bool socketIdle(JsNetwork *net);
 
+// Pause/unpause receiving on a socket/connection (see Socket.pause)
+void socketSetPaused(JsVar *socket, bool paused);
+
+#ifndef SAVE_ON_FLASH
+// WebSocket framing (see Socket.wsMode/wsSend)
+void socketWsSetMode(JsVar *socket, bool enabled);
+JsVar *socketWsFrame(JsVar *data, int opcode, bool mask);
+bool socketWsDeframe(JsVar *socket, JsVar *data);
+#endif
+
 // -----------------------------
 JsVar *serverNew(SocketType socketType, JsVar *callback);
 void serverAddMembership(JsNetwork *net, JsVar *socket, JsVar *group, JsVar *ip);
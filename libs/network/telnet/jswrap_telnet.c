@@ -262,26 +262,40 @@ bool telnetSendBuf(JsNetwork *net) {
 
 static bool ovf;
 
-void telnetSendChar(char ch) {
+/* Console output is just aggregated in txBuf here - it goes out as one
+ * netSend per idle cycle (see jswrap_telnet_idle), so a busy console makes
+ * full segments rather than one tiny packet every few characters. The only
+ * send outside idle is the flush below when the buffer is completely full. */
+void telnetSendChars(const char *data, unsigned int count) {
   if (tnSrv.sock == 0 || tnSrv.cliSock == 0) return;
-  if (tnSrv.txBufLen >= TX_CHUNK) {
-    // buffer overflow :-(
-    if (!ovf) {
-      printf("tnSrv: send overflow!\n");
-      ovf = true;
+  while (count) {
+    if (tnSrv.txBufLen >= TX_CHUNK) {
+      // buffer full - flush now to make room rather than dropping chars
+      JsNetwork net;
+      if (!networkGetFromVarIfOnline(&net)) return;
+      telnetSendBuf(&net);
+      networkFree(&net);
+      if (tnSrv.txBufLen >= TX_CHUNK) {
+        // socket couldn't take it either - overflow :-(
+        if (!ovf) {
+          printf("tnSrv: send overflow!\n");
+          ovf = true;
+        }
+        return;
+      }
     }
-  } else {
+    unsigned int n = (unsigned int)(TX_CHUNK - tnSrv.txBufLen);
+    if (n > count) n = count;
+    memcpy(tnSrv.txBuf + tnSrv.txBufLen, data, n);
+    tnSrv.txBufLen = (uint16_t)(tnSrv.txBufLen + n);
+    data += n;
+    count -= n;
     ovf = false;
-    tnSrv.txBuf[tnSrv.txBufLen++] = ch;
   }
+}
 
-  // if the buffer has a bunch of chars then try to send, else it'll happen
-  // at idle time.
-  if (tnSrv.txBufLen < TX_CHUNK/4) return;
-  JsNetwork net;
-  if (!networkGetFromVarIfOnline(&net)) return;
-  telnetSendBuf(&net);
-  networkFree(&net);
+void telnetSendChar(char ch) {
+  telnetSendChars(&ch, 1);
 }
 
 // Attempt to receive on an established client connection, returns true if it received something
@@ -100,6 +100,11 @@ void jswrap_trig_setup(Pin pin, JsVar *options) {
   trig->currTooth = 0;
   trig->teethSinceStart = 0;
   trig->wrongTriggerTeeth = 0;
+  // revolution tables
+  trig->activeRevTable = 0;
+  trig->revTableDirty = false;
+  trig->revTableBuilding = false;
+  trigUpdateRevTable(trig);
   // finally set up the watch!
   if (jshIsPinValid(trig->sensorPin))
     jshPinWatch(trig->sensorPin, false);
@@ -152,6 +157,8 @@ void jswrap_trig_setTrigger(JsVarInt num, JsVarFloat position, JsVar *pins, JsVa
     tp->tooth = tp->newTooth;
     tp->toothFraction = tp->newToothFraction;
   }
+  // rebuild the spare revolution table and flip it live
+  trigUpdateRevTable(trig);
   // all done!
 }
 
@@ -176,6 +183,7 @@ void jswrap_trig_killTrigger(JsVarInt num) {
   TriggerPointStruct *tp = &trig->triggers[num];
   tp->tooth = TRIGGERPOINT_TOOTH_DISABLE;
   tp->newTooth = TRIGGERPOINT_TOOTH_DISABLE;
+  trigUpdateRevTable(trig);
 }
 
 /*JSON{
@@ -56,6 +56,37 @@ Needs to have a minRPM to detect when wheel is stationary
 
 TriggerStruct mainTrigger = { (Pin)-1/*pin*/};
 
+/** Build the spare revolution table from the trigger points, then flip it
+ * live. The offsets bake in the current avrTooth, so this needs re-running
+ * when the RPM has drifted (trigOnTimingPulse checks) - but in the steady
+ * state the IRQ just plays the active table untouched. */
+static void trigBuildRevTable(TriggerStruct *data) {
+  TriggerRevTableStruct *tbl = &data->revTables[data->activeRevTable ^ 1];
+  tbl->entryCount = 0;
+  tbl->avrTooth = data->avrTooth;
+  int i;
+  for (i=0;i<TRIGGER_TRIGGERS_COUNT;i++) {
+    TriggerPointStruct *trig = &data->triggers[i];
+    if (trig->tooth == TRIGGERPOINT_TOOTH_DISABLE) continue;
+    TriggerRevEntryStruct *ev = &tbl->entries[tbl->entryCount++];
+    ev->tooth = trig->tooth;
+    ev->trigger = (unsigned char)i;
+    ev->timeOffset = (int)((trig->toothFraction * tbl->avrTooth) >> 8);
+    ev->pulseLength = trig->pulseLength;
+    memcpy(ev->pins, trig->pins, sizeof(ev->pins));
+  }
+  data->revTableDirty = false;
+  data->activeRevTable ^= 1; // publish - a single byte write
+}
+
+void trigUpdateRevTable(TriggerStruct *data) {
+  /* flag that we have the spare table - if a pulse IRQ interrupts us and
+   * wants a rebuild it leaves revTableDirty set and we publish shortly */
+  data->revTableBuilding = true;
+  trigBuildRevTable(data);
+  data->revTableBuilding = false;
+}
+
 void trigOnTimingPulse(TriggerStruct *data, JsSysTime pulseTime) {
   JsSysTime currentTime = jshGetSystemTime();
   int timeDiff = (int)(pulseTime - data->lastTime);
@@ -145,40 +176,57 @@ void trigOnTimingPulse(TriggerStruct *data, JsSysTime pulseTime) {
     if (currTooth < lastTooth) currTooth = (unsigned char)(data->currTooth + data->teethTotal);
     int tooth;
 
+    /* Play events from the active revolution table - the offsets were
+     * precomputed by trigBuildRevTable so there's no per-trigger maths here */
+    TriggerRevTableStruct *tbl = &data->revTables[data->activeRevTable];
+    // if the RPM has drifted since the offsets were computed, ask for a rebuild
+    unsigned int builtTooth = tbl->avrTooth;
+    unsigned int drift = (builtTooth > data->avrTooth) ? builtTooth - data->avrTooth
+                                                       : data->avrTooth - builtTooth;
+    if (drift > (builtTooth>>5)) // > ~3%
+      data->revTableDirty = true;
+
     for (tooth=lastTooth+TRIGGER_LOOKAHEAD;tooth<currTooth+TRIGGER_LOOKAHEAD;tooth++) {
       // actually we want to check a few teeth into the future to give us time
       int i;
-      for (i=0;i<TRIGGER_TRIGGERS_COUNT;i++) {
-        TriggerPointStruct *trig = &data->triggers[i];
-        if (trig->tooth != TRIGGERPOINT_TOOTH_DISABLE) {
-          if ((trig->tooth == tooth) || ((trig->tooth+data->teethTotal) == tooth)) { // because we wrap
-           // doAtTime(data->triggers[i].toothFraction * data->avrTooth >> 8);
-            JsSysTime trigTime = pulseTime +
-                                 ((trig->toothFraction * data->avrTooth) >> 8) +
-                                 (((int)tooth-(int)currTooth) * (int)data->avrTooth);
-            if (trigTime > pulseTime + jshGetTimeFromMilliseconds(500)) {
-              trigTime = jshGetTimeFromMilliseconds(500);
-              data->errors |= TRIGERR_TRIG_IN_FUTURE;
-            }
-            if (trigTime < currentTime) {
-              data->errors |= TRIGERR_TRIG_IN_PAST;
-              //jsiConsolePrint("Trigger already passed\n");
-            }
-
-            if (!jstPinOutputAtTime(trigTime, trig->pins, TRIGGERPOINT_TRIGGERS_COUNT, 0xFF))
+      for (i=0;i<tbl->entryCount;i++) {
+        TriggerRevEntryStruct *ev = &tbl->entries[i];
+        if ((ev->tooth == tooth) || ((ev->tooth+data->teethTotal) == tooth)) { // because we wrap
+          JsSysTime trigTime = pulseTime +
+                               ev->timeOffset +
+                               (((int)tooth-(int)currTooth) * (int)data->avrTooth);
+          if (trigTime > pulseTime + jshGetTimeFromMilliseconds(500)) {
+            trigTime = jshGetTimeFromMilliseconds(500);
+            data->errors |= TRIGERR_TRIG_IN_FUTURE;
+          }
+          if (trigTime < currentTime) {
+            data->errors |= TRIGERR_TRIG_IN_PAST;
+            //jsiConsolePrint("Trigger already passed\n");
+          }
+
+          if (!jstPinOutputAtTime(trigTime, ev->pins, TRIGGERPOINT_TRIGGERS_COUNT, 0xFF))
+            data->errors |= TRIGERR_TIMER_FULL;
+          if (ev->pulseLength>0) {
+            if (!jstPinOutputAtTime(trigTime+ev->pulseLength, ev->pins, TRIGGERPOINT_TRIGGERS_COUNT, 0))
               data->errors |= TRIGERR_TIMER_FULL;
-            if (trig->pulseLength>0) {
-              if (!jstPinOutputAtTime(trigTime+trig->pulseLength, trig->pins, TRIGGERPOINT_TRIGGERS_COUNT, 0))
-                data->errors |= TRIGERR_TIMER_FULL;
-            }
-            // trigger fired, so update it
+          }
+          // trigger fired - if it was due to move, move it and rebuild the table
+          TriggerPointStruct *trig = &data->triggers[ev->trigger];
+          if (trig->tooth != trig->newTooth || trig->toothFraction != trig->newToothFraction) {
             trig->tooth  = trig->newTooth;
             trig->toothFraction = trig->newToothFraction;
+            data->revTableDirty = true;
           }
         }
       }
     }
   }
+
+  /* Rebuild into the spare table if needed. Never touch it while the JS side
+   * is mid-rebuild - it'll publish a fresh table itself in a moment. We're in
+   * the pulse IRQ so nothing can interrupt this build. */
+  if (data->revTableDirty && !data->revTableBuilding)
+    trigBuildRevTable(data);
 }
 
 /** Actually handle a trigger event, and do stuff if it is for us */
@@ -46,6 +46,25 @@ typedef struct TriggerPointStruct {
 } PACKED_FLAGS TriggerPointStruct;
 
 #define TRIGGER_TRIGGERS_COUNT (8)
+
+/** One precomputed output event within a revolution - everything the IRQ
+ * needs to schedule the pulse without touching the trigger points */
+typedef struct TriggerRevEntryStruct {
+  unsigned char tooth; //< Tooth this event is anchored to
+  unsigned char trigger; //< Index of the trigger point this was built from
+  int timeOffset; //< Time offset from the anchor tooth's pulse (from toothFraction)
+  Pin pins[TRIGGERPOINT_TRIGGERS_COUNT];
+  JsSysTime pulseLength;
+} PACKED_FLAGS TriggerRevEntryStruct;
+
+/** A whole revolution's worth of output events, precomputed so the pulse IRQ
+ * just scans a short list rather than doing per-trigger maths every tooth */
+typedef struct TriggerRevTableStruct {
+  TriggerRevEntryStruct entries[TRIGGER_TRIGGERS_COUNT];
+  unsigned char entryCount;
+  unsigned int avrTooth; //< the tooth time the offsets were computed with
+} PACKED_FLAGS TriggerRevTableStruct;
+
 typedef struct TriggerStruct {
   Pin sensorPin;
   // static info
@@ -55,6 +74,13 @@ typedef struct TriggerStruct {
   JsVarFloat keyPosition; // actual position (in degrees) of the first tooth after the missing teeth
   // semi-static info
   TriggerPointStruct triggers[TRIGGER_TRIGGERS_COUNT];
+  /* Double-buffered revolution tables: the IRQ plays entries from
+   * revTables[activeRevTable] while rebuilds go into the other one, then
+   * flip activeRevTable (a single byte write) to publish */
+  TriggerRevTableStruct revTables[2];
+  volatile unsigned char activeRevTable;
+  volatile bool revTableDirty; //< table no longer matches triggers/RPM - rebuild wanted
+  volatile bool revTableBuilding; //< the JS side is mid-rebuild, IRQ mustn't touch the spare table
   // dynamic info
   JsSysTime lastTime, lastTime2;
   unsigned int avrTrigger; // average time for a trigger pulse
@@ -73,3 +99,6 @@ extern TriggerStruct mainTrigger;
 bool trigHandleEXTI(IOEventFlags channel, JsSysTime time);
 /** At a certain time, get which tooth number we're on */
 JsVarFloat trigGetToothAtTime(TriggerStruct *data, JsSysTime time);
+/** Rebuild the spare revolution table from the trigger points and flip it live.
+ * Call this (not trigBuildRevTable) from the JS side after changing triggers */
+void trigUpdateRevTable(TriggerStruct *data);
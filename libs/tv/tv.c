@@ -41,6 +41,30 @@ const char *tvPixelPtr;
 int tvCurrentLine;
 unsigned short ticksPerLine; // timer ticks
 
+/* Precomputed DMA source address for every displayed scanline, so the line
+ * IRQ is just a table lookup and a DMA kick - no scaling arithmetic. Lives
+ * in a flat string that stays locked as long as TV output runs (like
+ * tvPixelPtr, this doesn't survive save()). */
+static JsVar *tvLineTableVar = 0;
+static uint32_t *tvLineAddr = 0;
+static unsigned short tvLineAddrCount = 0;
+
+/** (Re)build the scanline->DMA address table. scanlines is the number of
+ * raw scanlines to cover, and each maps to source line scanline*num/den */
+static void tv_build_line_table(unsigned int scanlines, unsigned int num, unsigned int den) {
+  jsvUnLock(tvLineTableVar);
+  tvLineTableVar = jsvNewFlatStringOfLength((unsigned int)(scanlines*sizeof(uint32_t)));
+  tvLineAddr = 0;
+  tvLineAddrCount = 0;
+  if (!tvLineTableVar) return; // out of memory - the IRQ falls back to doing the maths
+  tvLineAddr = (uint32_t*)jsvGetFlatStringPointer(tvLineTableVar);
+  uint32_t lsize = (uint32_t)tvWidth>>3/*bytes*/;
+  unsigned int i;
+  for (i=0;i<scanlines;i++)
+    tvLineAddr[i] = (uint32_t)tvPixelPtr + (i*num/den)*lsize;
+  tvLineAddrCount = (unsigned short)scanlines;
+}
+
 #define PAL_VBLANK 25 // amount of extra height that is just blank
 
 #define PAL_LINE 64
@@ -174,10 +198,14 @@ ALWAYS_INLINE void tv_start_line_video() {
     lineIdx = ((uint32_t)tvCurrentLine-(317+PAL_VBLANK));
   }
   if (lineIdx<270) {
-    lineIdx = lineIdx*tvHeight/270;
     jshPinSetState(tvPinVideo, JSHPINSTATE_AF_OUT); // re-enable output for SPI
     uint32_t lsize = tvWidth>>3/*bytes*/;
-    dma_start((uint32_t)tvPixelPtr + lineIdx*lsize, lsize);
+    if (lineIdx < tvLineAddrCount) {
+      dma_start(tvLineAddr[lineIdx], lsize);
+    } else { // no table (out of memory at setup) - do the scaling here
+      lineIdx = lineIdx*tvHeight/270;
+      dma_start((uint32_t)tvPixelPtr + lineIdx*lsize, lsize);
+    }
   }
 }
 
@@ -273,10 +301,13 @@ void tv_vga_irq() {
   jshPinSetValue(tvPinSync, 1);
   jshDelayMicroseconds(2);
 
-  uint32_t lineIdx = ((uint32_t)tvCurrentLine - 20) / tvLineRepeat; // 20px = front porch
-  if (lineIdx < tvHeight) {
-    uint32_t lsize = tvWidth>>3/*bytes*/;
-    dma_start((uint32_t)tvPixelPtr + lineIdx*lsize, lsize);
+  uint32_t lineIdx = (uint32_t)tvCurrentLine - 20; // 20px = front porch
+  uint32_t lsize = tvWidth>>3/*bytes*/;
+  if (lineIdx < tvLineAddrCount) {
+    dma_start(tvLineAddr[lineIdx], lsize);
+  } else if (lineIdx/tvLineRepeat < tvHeight && !tvLineAddr) {
+    // no table (out of memory at setup) - do the divide here
+    dma_start((uint32_t)tvPixelPtr + (lineIdx/tvLineRepeat)*lsize, lsize);
   }
 
   if (tvCurrentLine++ > tvHeight*tvLineRepeat + 40) tvCurrentLine=0; // count lines
@@ -300,6 +331,7 @@ JsVar *tv_setup_pal(tv_info_pal *inf) {
   jsvUnLock(buffer);
   tvPixelPtr = (char*)(ab+1);
   jsvUnLock(ab);
+  tv_build_line_table(270, tvHeight, 270); // scanline i shows buffer line i*tvHeight/270
 
   dma_setup(tvWidth * 1000000 / 52); // 52uS of picture
 
@@ -351,6 +383,7 @@ JsVar *tv_setup_vga(tv_info_vga *inf) {
   jsvUnLock(buffer);
   tvPixelPtr = (char*)(ab+1);
   jsvUnLock(ab);
+  tv_build_line_table((unsigned int)(tvHeight*tvLineRepeat), 1, tvLineRepeat); // each buffer line repeats lineRepeat scanlines
 
   dma_setup(tvWidth * 1000000 / 25); // 25uS of picture
   jshPinSetState(tvPinVideo, JSHPINSTATE_AF_OUT); // enable output for SPI
@@ -144,31 +144,142 @@ def getCDeclaration(jsondata, name):
     s.append(toCType(param[1]));
   return toCType(result[0])+" "+name+"("+",".join(s)+")";
 
+# numeric values of the argument types - MUST match JsnArgumentType in jswrapper.h
+argumentTypeValues = {
+  "JSWAT_VOID":0, "JSWAT_JSVAR":1, "JSWAT_ARGUMENT_ARRAY":2, "JSWAT_BOOL":3,
+  "JSWAT_INT32":4, "JSWAT_PIN":5, "JSWAT_JSVARFLOAT":6,
+  "JSWAT_EXECUTE_IMMEDIATELY":0x7000, "JSWAT_THIS_ARG":0x8000 }
+JSWAT_BITS_VALUE = 3
+
+def getArgumentSpecifierValue(jsondata):
+  # the numeric value of getArgumentSpecifier's expression
+  value = 0
+  for part in getArgumentSpecifier(jsondata).split(" | "):
+    m = re.match(r"\((JSWAT_[A-Z_0-9]+) << \(JSWAT_BITS\*([0-9]+)\)\)", part)
+    if m:
+      value |= argumentTypeValues[m.group(1)] << (JSWAT_BITS_VALUE*int(m.group(2)))
+    else:
+      value |= argumentTypeValues[part]
+  return value
+
+# every distinct argument specifier that ends up in a symbol table - these
+# get a directly-cast call in jswCallFunction rather than going through
+# jsnCallFunction's generic argument packing
+callSpecs = set()
+
+def codeOutCallFunction(specs):
+  cArgTypes = { 1:"JsVar*", 2:"JsVar*", 3:"bool", 4:"int", 5:"Pin", 6:"JsVarFloat" }
+  cRetTypes = { 0:"void", 1:"JsVar*", 3:"bool", 4:"int", 5:"Pin", 6:"JsVarFloat" }
+  retWrappers = { 3:"jsvNewFromBool", 4:"jsvNewFromInteger", 5:"jsvNewFromPin", 6:"jsvNewFromFloat" }
+  typeNames = { 0:"void", 1:"JsVar", 2:"JsVarArray", 3:"bool", 4:"int", 5:"Pin", 6:"float" }
+  codeOut("""/** Call a native function by its argument specifier. Every specifier used in
+ * the symbol tables above gets a case here with a direct cast and call, so the
+ * compiler marshals the arguments rather than jsnCallFunction packing them one
+ * at a time into a fake stack frame. Argument arrays are built straight from
+ * the (paramData,paramCount) pair. Anything else (eg. a specifier built at
+ * runtime with jsvNewNativeFunction) falls back to the generic path. */
+JsVar *jswCallFunction(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount) {
+#define jswArg(N) (((N)<paramCount) ? paramData[N] : 0)
+  switch ((unsigned short)argumentSpecifier) {""");
+  for spec in sorted(specs):
+    retType = spec & 7
+    argTypes = []
+    s = (spec & 0x7FF8) >> 3 # stops before JSWAT_EXECUTE_IMMEDIATELY's all-ones tail
+    decodable = retType in cRetTypes
+    while s & 7:
+      if not (s & 7) in cArgTypes: decodable = False; break
+      argTypes.append(s & 7)
+      s >>= 3
+    if not decodable:
+      continue # jsnCallFunction can have it
+    hasThisArg = (spec & 0x8000)!=0
+    cArgs = (["JsVar*"] if hasThisArg else []) + [cArgTypes[t] for t in argTypes]
+    fnType = cRetTypes[retType]+" (*)("+(",".join(cArgs) if cArgs else "void")+")"
+    callArgs = ["thisParam"] if hasThisArg else []
+    arrayIdx = -1
+    for i,t in enumerate(argTypes):
+      if t==1: callArgs.append("jswArg(%d)" % i)
+      elif t==2:
+        arrayIdx = i
+        callArgs.append("argArray")
+      elif t==3: callArgs.append("jsvGetBool(jswArg(%d))" % i)
+      elif t==4: callArgs.append("(int)jsvGetInteger(jswArg(%d))" % i)
+      elif t==5: callArgs.append("jshGetPinFromVar(jswArg(%d))" % i)
+      elif t==6: callArgs.append("jsvGetFloat(jswArg(%d))" % i)
+    call = "(("+fnType+")function)("+", ".join(callArgs)+")"
+    signature = typeNames[retType]+"("+", ".join((["this"] if hasThisArg else [])+[typeNames[t] for t in argTypes])+")"
+    codeOut("  case 0x%04X: { // %s" % (spec, signature))
+    if arrayIdx>=0:
+      codeOut("    JsVar *argArray = jsvNewArray((paramCount>%d)?&paramData[%d]:0, (paramCount>%d)?(paramCount-%d):0);" % (arrayIdx,arrayIdx,arrayIdx,arrayIdx))
+    if retType==0:
+      codeOut("    "+call+";")
+      if arrayIdx>=0: codeOut("    jsvUnLock(argArray);")
+      codeOut("    return 0;")
+    elif retType==1:
+      if arrayIdx>=0:
+        codeOut("    JsVar *r = "+call+";")
+        codeOut("    jsvUnLock(argArray);")
+        codeOut("    return r;")
+      else:
+        codeOut("    return "+call+";")
+    else:
+      if arrayIdx>=0:
+        codeOut("    "+cRetTypes[retType]+" r = "+call+";")
+        codeOut("    jsvUnLock(argArray);")
+        codeOut("    return "+retWrappers[retType]+"(r);")
+      else:
+        codeOut("    return "+retWrappers[retType]+"("+call+");")
+    codeOut("  }")
+  codeOut("""  default:
+    // a specifier we didn't emit a case for - marshal it the slow way
+    return jsnCallFunction(function, argumentSpecifier, thisParam, paramData, paramCount);
+  }
+#undef jswArg
+}""");
+
+def symbolHash(name):
+  # 4-bit first-char+length hash - MUST match jswSymLookup in the emitted code
+  return (ord(name[0]) + 7*len(name)) & 15
+
 def codeOutSymbolTable(builtin):
   codeName = builtin["name"]
   # sort by name
   builtin["functions"] = sorted(builtin["functions"], key=lambda n: n["name"]);
-  # output tables
-  listSymbols = []
-  listChars = ""
-  strLen = 0
+  # pick out the symbols that get emitted...
+  symbols = []
   for sym in builtin["functions"]:
     symName = sym["name"];
 
     if builtin["name"]=="global" and symName in libraries:
       continue # don't include libraries on global namespace
     if "generate" in sym:
-      listSymbols.append("{"+", ".join([str(strLen), getArgumentSpecifier(sym), "(void (*)(void))"+sym["generate"]])+"}")
-      listChars = listChars + symName + "\\0";
-      strLen = strLen + len(symName) + 1
+      symbols.append(sym)
     else:
       print (codeName + "." + symName+" not included in Symbol Table because no 'generate'")
+  # ...and order them by hash bucket (then name) so jswSymLookup can jump
+  # straight to the handful of symbols sharing the name's hash
+  symbols = sorted(symbols, key=lambda s: (symbolHash(s["name"]), s["name"]));
+  # output tables
+  listSymbols = []
+  listChars = ""
+  strLen = 0
+  for sym in symbols:
+    symName = sym["name"];
+    callSpecs.add(getArgumentSpecifierValue(sym))
+    listSymbols.append("{"+", ".join([str(strLen), getArgumentSpecifier(sym), "(void (*)(void))"+sym["generate"]])+"}")
+    listChars = listChars + symName + "\\0";
+    strLen = strLen + len(symName) + 1
+  # bucket h covers symbols [buckets[h],buckets[h+1])
+  buckets = []
+  for b in range(17):
+    buckets.append(str(len([s for s in symbols if symbolHash(s["name"])<b])))
   builtin["symbolTableChars"] = "\""+listChars+"\"";
   builtin["symbolTableCount"] = str(len(listSymbols));
   codeOut("static const JswSymPtr jswSymbols_"+codeName+"[] FLASH_SECT = {\n  "+",\n  ".join(listSymbols)+"\n};");
+  codeOut("static const unsigned char jswSymbols_"+codeName+"_buckets[17] FLASH_SECT = {"+",".join(buckets)+"};");
 
 def codeOutBuiltins(indent, builtin):
-  codeOut(indent+"jswBinarySearch(&jswSymbolTables["+builtin["indexName"]+"], parent, name);");
+  codeOut(indent+"jswSymLookup(&jswSymbolTables["+builtin["indexName"]+"], parent, name);");
 
 #================== to remove JS-definitions given by blacklist==============
 def delete_by_indices(lst, indices):
@@ -243,6 +354,7 @@ codeOut('// Generated by scripts/build_jswrapper.py');
 codeOut('');
 codeOut('#include "jswrapper.h"');
 codeOut('#include "jsnative.h"');
+codeOut('#include "jshardware.h"');
 for include in includes:
   codeOut('#include "'+include+'"');
 codeOut('');
@@ -287,30 +399,23 @@ codeOut('// --------------------------------------------------------------------
 codeOut('');
 
 codeOut("""
-// Binary search coded to allow for JswSyms to be in flash on the esp8266 where they require
-// word accesses
-JsVar *jswBinarySearch(const JswSymList *symbolsPtr, JsVar *parent, const char *name) {
-  uint8_t symbolCount = READ_FLASH_UINT8(&symbolsPtr->symbolCount);
-  int searchMin = 0;
-  int searchMax = symbolCount - 1;
-  while (searchMin <= searchMax) {
-    int idx = (searchMin+searchMax) >> 1;
+// Hash lookup over the bucketed symbol tables. Each table is sorted by a
+// 4-bit hash of the name's first character and length (see symbolHash in
+// build_jswrapper.py), so resolving a name is one hash plus a string compare
+// of the usually-one entry in its bucket. Coded to allow for JswSyms to be
+// in flash on the esp8266 where they require word accesses
+JsVar *jswSymLookup(const JswSymList *symbolsPtr, JsVar *parent, const char *name) {
+  unsigned int h = ((unsigned int)(unsigned char)name[0] + 7*(unsigned int)strlen(name)) & 15;
+  int idx = READ_FLASH_UINT8(&symbolsPtr->hashBuckets[h]);
+  int bucketEnd = READ_FLASH_UINT8(&symbolsPtr->hashBuckets[h+1]);
+  for (;idx<bucketEnd;idx++) {
     const JswSymPtr *sym = &symbolsPtr->symbols[idx];
     unsigned short strOffset = READ_FLASH_UINT16(&sym->strOffset);
-    int cmp = FLASH_STRCMP(name, &symbolsPtr->symbolChars[strOffset]);
-    if (cmp==0) {
+    if (FLASH_STRCMP(name, &symbolsPtr->symbolChars[strOffset])==0) {
       unsigned short functionSpec = READ_FLASH_UINT16(&sym->functionSpec);
       if ((functionSpec & JSWAT_EXECUTE_IMMEDIATELY_MASK) == JSWAT_EXECUTE_IMMEDIATELY)
-        return jsnCallFunction(sym->functionPtr, functionSpec, parent, 0, 0);
+        return jswCallFunction(sym->functionPtr, functionSpec, parent, 0, 0);
       return jsvNewNativeFunction(sym->functionPtr, functionSpec);
-    } else {
-      if (cmp<0) {
-        // searchMin is the same
-        searchMax = idx-1;
-      } else {
-        searchMin = idx+1;
-        // searchMax is the same
-      }
     }
   }
   return 0;
@@ -380,12 +485,17 @@ codeOut('');
 codeOut('const JswSymList jswSymbolTables[] FLASH_SECT = {');
 for b in builtins:
   builtin = builtins[b]
-  codeOut("  {"+", ".join(["jswSymbols_"+builtin["name"], "jswSymbols_"+builtin["name"]+"_str", builtin["symbolTableCount"]])+"},");
+  codeOut("  {"+", ".join(["jswSymbols_"+builtin["name"], "jswSymbols_"+builtin["name"]+"_str", "jswSymbols_"+builtin["name"]+"_buckets", builtin["symbolTableCount"]])+"},");
 codeOut('};');
 
 codeOut('');
 codeOut('');
 
+codeOutCallFunction(callSpecs);
+
+codeOut('');
+codeOut('');
+
 codeOut('const JswSymList *jswGetSymbolListForConstructorProto(JsVar *constructor) {')
 codeOut('  void *constructorPtr = constructor->varData.native.ptr;')
 for className in builtins:
@@ -408,7 +518,7 @@ nativeCheck = "jsvIsNativeFunction(parent) && "
 codeOut('    if (jsvIsNativeFunction(parent)) {')
 codeOut('      JswSymList *l = jswGetSymbolListForObject(parent);')
 codeOut('      if (l) {');
-codeOut('        v = jswBinarySearch(l, parent, name);')
+codeOut('        v = jswSymLookup(l, parent, name);')
 codeOut('        if (v) return v;');
 codeOut('      }')
 codeOut('    }')
@@ -426,7 +536,7 @@ codeOut('    if (constructor && jsvIsNativeFunction(constructor)) {')
 codeOut('      const JswSymList *l = jswGetSymbolListForConstructorProto(constructor);')
 codeOut('      jsvUnLock(constructor);')
 codeOut('      if (l) {');
-codeOut('        v = jswBinarySearch(l, parent, name);')
+codeOut('        v = jswSymLookup(l, parent, name);')
 codeOut('        if (v) return v;');
 codeOut('      }')
 codeOut('    } else {')
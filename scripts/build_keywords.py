@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------
+# Generates a collision-free hash table over the reserved words in
+# src/jslex.h so the lexer can classify keywords with a single probe
+# instead of a compare cascade (see jslGetNextToken).
+#
+#   python scripts/build_keywords.py src/jslex.h gen/jslex_keywords.h
+# ----------------------------------------------------------------------------
+
+import re
+import sys
+
+if len(sys.argv) != 3:
+  print("USAGE: build_keywords.py src/jslex.h gen/jslex_keywords.h")
+  exit(1)
+
+lexFile = sys.argv[1]
+outFile = sys.argv[2]
+
+# Pull the reserved word tokens out of the LEX_TYPES enum - everything
+# between _LEX_R_LIST_START and _LEX_R_LIST_END. The keyword text is just
+# the lower-cased name, eg. LEX_R_INSTANCEOF -> "instanceof"
+keywords = []
+inList = False
+for line in open(lexFile):
+  if "_LEX_R_LIST_START" in line: inList = True
+  if "_LEX_R_LIST_END" in line: inList = False
+  if not inList: continue
+  m = re.search(r"(LEX_R_[A-Z]+)\s*[,=]", line)
+  if m and not m.group(1).startswith("LEX_R_LIST"):
+    token = m.group(1)
+    keywords.append((token[len("LEX_R_"):].lower(), token))
+
+if len(keywords) < 25:
+  print("build_keywords.py: only found "+str(len(keywords))+" keywords in "+lexFile+" - parse broken?")
+  exit(1)
+
+# Find hash parameters giving no collisions:
+#   hash = (len*a + first*b + last) % size
+def hashOf(word, a, b, size):
+  return (len(word)*a + ord(word[0])*b + ord(word[-1])) % size
+
+found = False
+for size in range(len(keywords), 256):
+  for a in range(1, 64):
+    for b in range(1, 64):
+      used = set()
+      ok = True
+      for (word, token) in keywords:
+        h = hashOf(word, a, b, size)
+        if h in used:
+          ok = False
+          break
+        used.add(h)
+      if ok:
+        found = True
+        break
+    if found: break
+  if found: break
+
+if not found:
+  print("build_keywords.py: couldn't find a collision-free hash - add another term?")
+  exit(1)
+
+table = [None] * size
+for (word, token) in keywords:
+  table[hashOf(word, a, b, size)] = (word, token)
+
+out = open(outFile, "w")
+out.write("// Automatically generated by scripts/build_keywords.py from "+lexFile+" - do not edit\n")
+out.write("// Collision-free hash over the "+str(len(keywords))+" reserved words: one probe classifies any identifier\n\n")
+out.write("#define JSLEX_KEYWORD_HASH(STR, LEN) ((unsigned int)((LEN)*"+str(a)+" + ((unsigned char)(STR)[0])*"+str(b)+" + (unsigned char)(STR)[(LEN)-1]) % "+str(size)+")\n\n")
+out.write("typedef struct {\n")
+out.write("  const char *word;  ///< keyword text (0 for empty slots)\n")
+out.write("  unsigned char len; ///< strlen(word), so probes can compare without zero-terminating\n")
+out.write("  unsigned char tk;  ///< the LEX_R_* token\n")
+out.write("} JslKeyword;\n\n")
+out.write("static const JslKeyword jslKeywords["+str(size)+"] = {\n")
+for entry in table:
+  if entry:
+    out.write("  { \""+entry[0]+"\", "+str(len(entry[0]))+", "+entry[1]+" },\n")
+  else:
+    out.write("  { 0, 0, 0 },\n")
+out.write("};\n")
+out.close()
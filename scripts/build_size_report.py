@@ -0,0 +1,114 @@
+#!/usr/bin/python
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Report flash/RAM usage grouped by source directory, from the build's object
+# files (run 'make size-report'). Flash is text+data, RAM is data+bss.
+#
+#   build_size_report.py SIZETOOL [--save FILE] [--compare FILE] OBJ OBJ ...
+#
+# Save a baseline with --save, then --compare against it after your change (or
+# on a saved report from another commit) to see per-directory size deltas -
+# the same idea as the speed benchmarks in benchmark/.
+# ----------------------------------------------------------------------------------------
+
+import subprocess;
+import sys;
+import os;
+
+def group_of(path):
+  # group by source directory: src, gen, libs/graphics, targetlibs/stm32f1, ...
+  # (gen/ and precompiled objects get passed with the repo root prefixed)
+  path = os.path.normpath(path);
+  if os.path.isabs(path):
+    path = os.path.relpath(path);
+  parts = path.split(os.sep);
+  if len(parts)>2 and parts[0] in ["libs","targetlibs","targets","make"]:
+    return parts[0]+"/"+parts[1];
+  return parts[0];
+
+args = sys.argv[1:];
+if len(args)<2:
+  print("USAGE: build_size_report.py SIZETOOL [--save FILE] [--compare FILE] OBJ OBJ ...");
+  exit(1);
+sizetool = args.pop(0);
+savefile = None;
+comparefile = None;
+while args and args[0].startswith("--"):
+  opt = args.pop(0);
+  if opt=="--save": savefile = args.pop(0);
+  elif opt=="--compare": comparefile = args.pop(0);
+  else:
+    print("Unknown option "+opt);
+    exit(1);
+objects = args;
+
+flash = {};
+ram = {};
+# run the size tool in chunks so we don't hit the command line length limit
+CHUNK = 100;
+for start in range(0, len(objects), CHUNK):
+  out = subprocess.check_output([sizetool]+objects[start:start+CHUNK]).decode("utf8");
+  for line in out.splitlines():
+    fields = line.split();
+    if len(fields)<6 or not fields[0].isdigit(): continue; # header line
+    text = int(fields[0]);
+    data = int(fields[1]);
+    bss = int(fields[2]);
+    g = group_of(fields[5]);
+    flash[g] = flash.get(g,0) + text + data;
+    ram[g] = ram.get(g,0) + data + bss;
+
+def read_saved(filename):
+  oldflash = {};
+  oldram = {};
+  for line in open(filename):
+    if line.startswith("#"): continue;
+    fields = line.split();
+    if len(fields)==3:
+      oldflash[fields[0]] = int(fields[1]);
+      oldram[fields[0]] = int(fields[2]);
+  return (oldflash, oldram);
+
+try:
+  commit = subprocess.check_output(["git","log","-1","--format=%h"]).decode("utf8").strip();
+except:
+  commit = "unknown";
+
+if comparefile:
+  (oldflash, oldram) = read_saved(comparefile);
+  groups = sorted(set(list(flash.keys())+list(oldflash.keys())));
+  print("%-24s %10s %10s" % ("", "FLASH", "RAM"));
+  changed = False;
+  for g in groups:
+    df = flash.get(g,0) - oldflash.get(g,0);
+    dr = ram.get(g,0) - oldram.get(g,0);
+    if df or dr:
+      print("%-24s %+10d %+10d" % (g, df, dr));
+      changed = True;
+  if not changed:
+    print("No size changes vs "+comparefile);
+  print("%-24s %+10d %+10d" % ("TOTAL",
+      sum(flash.values())-sum(oldflash.values()),
+      sum(ram.values())-sum(oldram.values())));
+else:
+  print("Size report for commit "+commit);
+  print("%-24s %10s %10s" % ("", "FLASH", "RAM"));
+  for g in sorted(flash.keys(), key=lambda g: -flash[g]):
+    print("%-24s %10d %10d" % (g, flash[g], ram[g]));
+  print("%-24s %10d %10d" % ("TOTAL", sum(flash.values()), sum(ram.values())));
+
+if savefile:
+  f = open(savefile, "w");
+  f.write("# size report, commit "+commit+"\n");
+  for g in sorted(flash.keys()):
+    f.write("%s %d %d\n" % (g, flash[g], ram[g]));
+  f.close();
+  print("Saved to "+savefile);
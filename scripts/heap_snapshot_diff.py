@@ -0,0 +1,129 @@
+#!/usr/bin/python
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Decode (and diff) heap snapshots captured from E.dumpHeap()
+#
+#   ./heap_snapshot_diff.py snapshot.log            - summarise one snapshot
+#   ./heap_snapshot_diff.py before.log after.log    - show what changed
+#
+# The snapshot files are just captured console output - everything outside
+# the =HEAPDUMP/=END markers is ignored, so you can point this at a whole
+# session log.
+# ----------------------------------------------------------------------------------------
+
+import base64
+import struct
+import sys
+
+# Fixed low JsVarFlags type values - must match JSV_* in jsvar.h. The
+# name/string ranges above these depend on the build, so their end markers
+# travel in the =HEAPDUMP header.
+TYPE_NAMES = {
+    0: "unused", 1: "root", 2: "null",
+    3: "array", 4: "arraybuffer", 5: "object", 6: "function",
+    7: "function", 8: "integer", 9: "float", 10: "boolean", 11: "pin",
+}
+
+def make_type_of(name_end, string_end):
+    def type_of(flags):
+        t = flags & 63  # JSV_VARTYPEMASK
+        if t in TYPE_NAMES:
+            return TYPE_NAMES[t]
+        if t <= name_end:
+            return "name"
+        if t <= string_end:
+            return "string"
+        return "stringext"
+    return type_of
+
+def read_snapshot(filename):
+    """Return ({ref: (flags, size, prev, next, first, last, locks)}, type_of)"""
+    data = b""
+    reclen = 16
+    name_end, string_end = 40, 48
+    inside = False
+    for line in open(filename, "rb"):
+        line = line.strip()
+        if line.startswith(b"=HEAPDUMP"):
+            parts = line.split()
+            reclen = int(parts[3])
+            if len(parts) >= 6:
+                name_end, string_end = int(parts[4]), int(parts[5])
+            inside = True
+            data = b""
+        elif line.startswith(b"=END"):
+            inside = False
+        elif inside:
+            try:
+                data += base64.b64decode(line)
+            except Exception:
+                pass  # line noise in the capture - skip it
+    if len(data) == 0:
+        sys.stderr.write("No =HEAPDUMP block found in " + filename + "\n")
+        exit(1)
+    heap = {}
+    for i in range(0, len(data) - reclen + 1, reclen):
+        rec = struct.unpack("<8H", data[i:i + reclen])
+        heap[rec[0]] = rec[1:]
+    return heap, make_type_of(name_end, string_end)
+
+def blocks(heap):
+    return sum(r[1] for r in heap.values())
+
+def by_type(heap, type_of):
+    counts = {}
+    for r in heap.values():
+        t = type_of(r[0])
+        c = counts.get(t, [0, 0])
+        counts[t] = [c[0] + 1, c[1] + r[1]]
+    return counts
+
+def summarise(filename, heap, type_of):
+    print(filename + ": " + str(len(heap)) + " vars, " + str(blocks(heap)) + " blocks")
+    for t, c in sorted(by_type(heap, type_of).items(), key=lambda x: -x[1][1]):
+        print("  %-12s %6d vars %6d blocks" % (t, c[0], c[1]))
+
+if len(sys.argv) == 2:
+    heap, type_of = read_snapshot(sys.argv[1])
+    summarise(sys.argv[1], heap, type_of)
+    exit(0)
+if len(sys.argv) != 3:
+    print("USAGE: heap_snapshot_diff.py before.log [after.log]")
+    exit(1)
+
+before, type_of = read_snapshot(sys.argv[1])
+after, _ = read_snapshot(sys.argv[2])
+summarise(sys.argv[1], before, type_of)
+summarise(sys.argv[2], after, type_of)
+print("")
+print("Change: %+d vars, %+d blocks" % (len(after) - len(before), blocks(after) - blocks(before)))
+
+# per-type growth is usually all you need to name the leak
+tb, ta = by_type(before, type_of), by_type(after, type_of)
+for t in sorted(set(list(tb.keys()) + list(ta.keys()))):
+    db = ta.get(t, [0, 0])[0] - tb.get(t, [0, 0])[0]
+    dv = ta.get(t, [0, 0])[1] - tb.get(t, [0, 0])[1]
+    if db or dv:
+        print("  %-12s %+6d vars %+6d blocks" % (t, db, dv))
+
+# refs that appeared/vanished - same ref with same flags+size counts as
+# survived. On a quiet device the survivors dominate, so this list is short
+# and is usually the leaked allocation itself
+added = [r for r in after if r not in before or after[r][:2] != before[r][:2]]
+removed = [r for r in before if r not in after or after[r][:2] != before[r][:2]]
+print("")
+print(str(len(added)) + " new/changed vars, " + str(len(removed)) + " freed/changed")
+for r in sorted(added)[:40]:
+    f = after[r]
+    print("  +ref %5d %-12s size %2d locks %d links %d,%d,%d,%d" %
+          (r, type_of(f[0]), f[1], f[6], f[2], f[3], f[4], f[5]))
+if len(added) > 40:
+    print("  ... and " + str(len(added) - 40) + " more")
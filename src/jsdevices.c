@@ -12,6 +12,7 @@
  * ----------------------------------------------------------------------------
  */
 #include "jsdevices.h"
+#include "jsvariterator.h"
 #include "jsparse.h"
 #include "jsinteractive.h"
 #ifdef BLUETOOTH
@@ -26,9 +27,113 @@
 #include "trigger.h"
 #endif
 
+// ----------------------------------------------------------------------------
+//                                                        RING BUFFER LOCKING
+/* The IO and transmit rings are filled mostly from IRQs and drained by the
+ * main loop (or vice versa for txBuffer). Each channel is only ever filled
+ * from one context, so on single-core targets a producer can never run
+ * concurrently with the consumer (the main loop is simply preempted for the
+ * duration of the IRQ) and the per-byte paths don't need to mask interrupts
+ * at all - masking is only needed where two different producers can race
+ * over allocating a new event slot. The ESP32 runs the consumer on the
+ * other core though, so anything that appends to an event the consumer
+ * might be popping still takes the cross-core lock (jshInterruptOff is a
+ * spinlock there - see targets/esp32/jshardware.c). */
+#ifdef ESP32
+#define jshIOAppendLock   jshInterruptOff
+#define jshIOAppendUnlock jshInterruptOn
+#else
+#define jshIOAppendLock()
+#define jshIOAppendUnlock()
+#endif
+
+/** Full compiler+CPU memory barrier. Ring buffer contents must be visible
+ * to the other side before the head/tail move that publishes them is. */
+#define jshDataBarrier() __sync_synchronize()
+
 // ----------------------------------------------------------------------------
 //                                                              WATCH CALLBACKS
 JshEventCallbackCallback jshEventCallbacks[EV_EXTI_MAX+1-EV_EXTI0];
+#ifndef SAVE_ON_FLASH
+/** Per-EXTI edge aggregation (setWatch's aggregate option). While the count
+ * is nonzero an event for the channel is already in the IO buffer, so the
+ * IRQ just counts further edges instead of pushing more events - a bouncy
+ * switch or fast encoder then costs one queue slot and one JS callback per
+ * main-loop pass rather than one per edge. */
+volatile uint16_t jshEventAggregateCounts[EV_EXTI_MAX+1-EV_EXTI0];
+static bool jshEventAggregateEnabled[EV_EXTI_MAX+1-EV_EXTI0];
+
+/// Enable/disable edge aggregation for a watch channel (see jshPushIOWatchEvent)
+void jshSetEventAggregation(IOEventFlags channel, bool aggregate) {
+  assert(channel >= EV_EXTI0 && channel <= EV_EXTI_MAX);
+  jshEventAggregateEnabled[channel-EV_EXTI0] = aggregate;
+  jshEventAggregateCounts[channel-EV_EXTI0] = 0;
+}
+
+/// Fetch and reset the number of edges aggregated for a watch channel (0 if aggregation is off)
+int jshGetEventAggregateCount(IOEventFlags channel) {
+  assert(channel >= EV_EXTI0 && channel <= EV_EXTI_MAX);
+  jshInterruptOff();
+  int count = jshEventAggregateCounts[channel-EV_EXTI0];
+  jshEventAggregateCounts[channel-EV_EXTI0] = 0;
+  jshInterruptOn();
+  return count;
+}
+
+/** Per-EXTI edge capture (setWatch's capture option). While a buffer is
+ * bound, every edge is timestamped straight into it from the IRQ as a
+ * time-since-previous-edge in microseconds, and nothing touches the IO event
+ * queue until the buffer fills (one flush event then) or the line goes quiet
+ * (jshGetEventCaptureIdleFlush). Pulse widths measured this way can't be
+ * delayed or dropped by whatever JS happens to be doing, which is what
+ * decoding things like IR remotes needs. */
+typedef struct {
+  uint32_t *data; ///< buffer to record into, 0 if not capturing
+  unsigned int length; ///< number of entries in data
+  volatile unsigned int count; ///< entries recorded so far
+  uint32_t lastEdgeTime; ///< (uint32_t)system time of the last edge
+  uint32_t usPerTickScaled; ///< microseconds per system time tick, *65536
+  uint32_t timeoutTicks; ///< how long with no edges before an idle flush is due
+} JshEventCapture;
+static JshEventCapture jshEventCaptures[EV_EXTI_MAX+1-EV_EXTI0];
+
+void jshSetEventCapture(IOEventFlags channel, uint32_t *data, unsigned int length, JsSysTime timeoutTicks) {
+  assert(channel >= EV_EXTI0 && channel <= EV_EXTI_MAX);
+  JshEventCapture *capture = &jshEventCaptures[channel-EV_EXTI0];
+  jshInterruptOff();
+  capture->data = 0; // the IRQ checks this first
+  capture->length = length;
+  capture->count = 0;
+  capture->lastEdgeTime = (uint32_t)jshGetSystemTime();
+  capture->usPerTickScaled = (uint32_t)(65536000000.0 / (JsVarFloat)jshGetTimeFromMilliseconds(1000));
+  capture->timeoutTicks = (timeoutTicks>0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)timeoutTicks;
+  capture->data = data;
+  jshInterruptOn();
+}
+
+/// Fetch and reset the number of edges captured so far for a watch channel
+int jshGetEventCaptureCount(IOEventFlags channel) {
+  assert(channel >= EV_EXTI0 && channel <= EV_EXTI_MAX);
+  JshEventCapture *capture = &jshEventCaptures[channel-EV_EXTI0];
+  jshInterruptOff();
+  int count = (int)capture->count;
+  capture->count = 0;
+  jshInterruptOn();
+  return count;
+}
+
+/// Return a channel with captured edges whose line has been quiet past its timeout (EV_NONE if none)
+IOEventFlags jshGetEventCaptureIdleFlush(JsSysTime time) {
+  int i;
+  for (i=0;i<=EV_EXTI_MAX-EV_EXTI0;i++) {
+    JshEventCapture *capture = &jshEventCaptures[i];
+    if (capture->data && capture->count &&
+        ((uint32_t)time - capture->lastEdgeTime) > capture->timeoutTicks)
+      return EV_EXTI0+i;
+  }
+  return EV_NONE;
+}
+#endif
 
 // ----------------------------------------------------------------------------
 //                                                         DATA TRANSMIT BUFFER
@@ -46,6 +151,26 @@ typedef struct {
  */
 volatile TxBufferItem txBuffer[TXBUFFERMASK+1];
 
+#ifndef SAVE_ON_FLASH
+/** Zero-copy transmit: large flat strings are queued as a locked JsVar plus
+ * a position, rather than being copied into txBuffer one byte at a time
+ * (which for big writes also means busy-waiting on TXBUFFERMASK's worth of
+ * space). The IRQ drains an active slot before any txBuffer data for the
+ * same device - a slot is only claimed when txBuffer holds nothing for that
+ * device, so byte order is preserved. The IRQ never unlocks the JsVar; it
+ * just sets 'done' and the main loop frees it via jshTransmitFlatStringIdle. */
+typedef struct {
+  JsVar * volatile var;     ///< locked flat string - 0 means the slot is unused
+  const unsigned char *ptr; ///< the string's data
+  volatile size_t pos;      ///< next byte to transmit
+  size_t len;               ///< how many bytes to transmit
+  IOEventFlags device;
+  volatile bool done;       ///< set by the IRQ when all bytes have gone
+} JshTxFlatString;
+#define TXFLATSTRINGS 2
+static JshTxFlatString txFlatStrings[TXFLATSTRINGS];
+#endif
+
 /**
  * The head and tail of the list.
  */
@@ -69,6 +194,58 @@ Pin jshSerialDeviceCTSPins[EV_SERIAL1+USART_COUNT-EV_SERIAL_START];
 volatile IOEvent ioBuffer[IOBUFFERMASK+1];
 volatile unsigned char ioHead=0, ioTail=0;
 
+#ifndef SAVE_ON_FLASH
+/** A second, small ring for latency-critical events (pin watches). It gets
+ * drained before ioBuffer, so a flood of bulk serial data can't delay a
+ * watch event by more than the handling of the event currently in hand. */
+#define IOPRIORITYBUFFERMASK 7 // (max 255)
+volatile IOEvent ioPriorityBuffer[IOPRIORITYBUFFERMASK+1];
+volatile unsigned char ioPriorityHead=0, ioPriorityTail=0;
+#endif
+
+#ifndef SAVE_ON_FLASH
+/** Ring occupancy (in IO events) at which flow control asks the host to
+ * stop/start transmitting. Defaults come from platform_config.h but they
+ * can be moved with Serial.setup's flowStop/flowStart options - eg. pulled
+ * right down for devices that react slowly to RTS/CTS or XOFF. */
+int jshIOBufferXOff = IOBUFFER_XOFF;
+int jshIOBufferXOn = IOBUFFER_XON;
+
+/** How many characters have been pushed into ioBuffer, and how many events
+ * they needed - chars/events is the pack ratio (IOEVENT_MAXCHARS is ideal,
+ * 1 means every char burnt a whole event slot). See E.getIOEventStats() */
+volatile uint32_t jshIOCharsPushed = 0, jshIOCharEventsCreated = 0;
+
+/** Per-device IO telemetry - how many events each device queued and how many
+ * were dropped because ioBuffer was full, plus ring high-water marks. When
+ * serial bytes go missing in the field this is what proves which side dropped
+ * them. See E.getIOStats() */
+volatile JshIODeviceStats jshIODeviceStats[EV_DEVICE_MAX+1];
+volatile unsigned char jshIOBufferMaxUsed = 0, jshTxBufferMaxUsed = 0;
+/// Bitmask of devices that dropped an event since jsiCheckErrors last looked - drives E's 'overflow' event
+volatile uint64_t jshIOOverflowedDevices = 0;
+
+/// Count an event landing in ioBuffer (or the priority buffer) for 'channel'
+static ALWAYS_INLINE void jshIOStatsEventPushed(IOEventFlags channel) {
+  IOEventFlags d = channel & EV_TYPE_MASK;
+  if (d <= EV_DEVICE_MAX) jshIODeviceStats[d].pushed++;
+}
+/// Update the ioBuffer high-water mark - call after ioHead has moved
+static ALWAYS_INLINE void jshIOStatsUpdateMax() {
+  unsigned char used = (unsigned char)((ioHead-ioTail) & IOBUFFERMASK);
+  if (used > jshIOBufferMaxUsed) jshIOBufferMaxUsed = used;
+}
+/// Update the txBuffer high-water mark - call after txHead has moved
+static ALWAYS_INLINE void jshIOStatsTxPushed() {
+  unsigned char used = (unsigned char)((txHead-txTail) & TXBUFFERMASK);
+  if (used > jshTxBufferMaxUsed) jshTxBufferMaxUsed = used;
+}
+#else
+#define jshIOStatsEventPushed(channel)
+#define jshIOStatsUpdateMax()
+#define jshIOStatsTxPushed()
+#endif
+
 // ----------------------------------------------------------------------------
 
 
@@ -93,6 +270,11 @@ void jshResetDevices() {
   // reset callbacks for events
   for (i=EV_EXTI0;i<=EV_EXTI_MAX;i++)
     jshEventCallbacks[i-EV_EXTI0] = 0;
+#ifndef SAVE_ON_FLASH
+  // stop any edge captures - the buffers they point into are owned by JS
+  for (i=EV_EXTI0;i<=EV_EXTI_MAX;i++)
+    jshEventCaptures[i-EV_EXTI0].data = 0;
+#endif
   // Reset pin state for button
 #ifdef BTN1_PININDEX
 #ifdef BTN1_PINSTATE
@@ -165,6 +347,13 @@ void jshTransmit(
     return;
   }
 #endif
+#ifdef USE_TERMINAL
+  if (device == EV_TERMINAL) {
+    extern void terminalSendChar(char c);
+    terminalSendChar((char)data);
+    return;
+  }
+#endif
 #ifndef LINUX
 #ifdef USB
   if (device==EV_USBSERIAL && !jshIsUSBSERIALConnected()) {
@@ -221,14 +410,154 @@ void jshTransmit(
   // Save the device and data for the new character to be transmitted.
   txBuffer[txHead].flags = device;
   txBuffer[txHead].data = data;
+  jshDataBarrier(); // the IRQ consumes the item as soon as the head moves
   txHead = txHeadNext;
+  jshIOStatsTxPushed();
+
+  jshUSARTKick(device); // set up interrupts if required
+}
 
+/**
+ * Queue a run of characters for transmission in one go. The per-device
+ * checks happen once rather than per character, and the USART is only
+ * kicked once everything is in the buffer, so this is much cheaper than
+ * calling jshTransmit in a loop for console output.
+ */
+void jshTransmitChars(
+    IOEventFlags device,      //!< The device to be used for transmission.
+    const unsigned char *data, //!< The characters to transmit.
+    unsigned int count        //!< How many characters.
+  ) {
+  if (!count) return;
+#ifdef LINUX
+  if (device==DEFAULT_CONSOLE_DEVICE) {
+    // one write+flush rather than one per character
+    fwrite(data, 1, count, stdout);
+    fflush(stdout);
+    return;
+  }
+#endif
+  if (device==EV_NONE) return;
+#ifdef USE_TELNET
+  if (device==EV_TELNET) {
+    // as in jshTransmit - but the whole run is buffered in one go
+    extern void telnetSendChars(const char *data, unsigned int count);
+    telnetSendChars((const char *)data, count);
+    return;
+  }
+#endif
+  if (device==EV_LOOPBACKA || device==EV_LOOPBACKB) {
+    /* bulk-push the whole run to the other side's input queue - it gets
+     * coalesced into full events there, so a block costs O(events) rather
+     * than O(bytes) */
+    jshPushIOCharEvents(device==EV_LOOPBACKB ? EV_LOOPBACKA : EV_LOOPBACKB,
+                        (char*)data, count);
+    return;
+  }
+#ifdef USE_TERMINAL
+  if (device==EV_TERMINAL) {
+    // doesn't use the transmit queue - just hand over char by char
+    while (count--) jshTransmit(device, *(data++));
+    return;
+  }
+#endif
+#ifndef LINUX
+#ifdef USB
+  if (device==EV_USBSERIAL && !jshIsUSBSERIALConnected()) {
+    jshTransmitClearDevice(EV_USBSERIAL); // clear out stuff already waiting
+    return;
+  }
+#endif
+#ifdef BLUETOOTH
+  if (device==EV_BLUETOOTH && !jsble_has_simple_connection()) {
+    jshTransmitClearDevice(EV_BLUETOOTH); // clear out stuff already waiting
+    return;
+  }
+#endif
+#endif
+  // Queue as much as fits without kicking the USART between characters
+  while (count) {
+    unsigned char txHeadNext = (unsigned char)((txHead+1)&TXBUFFERMASK);
+    if (txHeadNext==txTail) break; // full - let jshTransmit deal with waiting
+    txBuffer[txHead].flags = device;
+    txBuffer[txHead].data = *(data++);
+    jshDataBarrier(); // the IRQ consumes the item as soon as the head moves
+    txHead = txHeadNext;
+    count--;
+  }
+  jshIOStatsTxPushed();
   jshUSARTKick(device); // set up interrupts if required
+  // anything left over goes the slow way, which waits for the buffer to drain
+  while (count--) jshTransmit(device, *(data++));
 }
 
+#ifndef SAVE_ON_FLASH
+/// Unlock any flat strings the IRQ has finished with. Main loop only!
+void jshTransmitFlatStringIdle() {
+  int i;
+  for (i=0;i<TXFLATSTRINGS;i++)
+    if (txFlatStrings[i].var && txFlatStrings[i].done) {
+      JsVar *v = txFlatStrings[i].var;
+      txFlatStrings[i].var = 0;
+      jsvUnLock(v);
+    }
+}
+
+/** Queue count bytes of a flat string for transmission without copying them
+ * into txBuffer. The string is locked until the IRQ has sent the last byte.
+ * Returns false if it couldn't be queued (not a flat string, no free slot,
+ * or data for this device still waiting in txBuffer) - the caller should
+ * then fall back to jshTransmit. */
+bool jshTransmitFlatString(IOEventFlags device, JsVar *var, size_t offset, size_t count) {
+  const unsigned char *ptr = (const unsigned char *)jsvGetFlatStringPointer(var);
+  if (!ptr || !count) return false;
+  // only devices drained by jshGetCharToTransmit can use this
+  if (device==EV_NONE || device==EV_LIMBO ||
+      device==EV_LOOPBACKA || device==EV_LOOPBACKB) return false;
+#ifdef USE_TELNET
+  if (device==EV_TELNET) return false;
+#endif
+#ifdef USE_TERMINAL
+  if (device==EV_TERMINAL) return false;
+#endif
+#ifdef LINUX
+  if (device==DEFAULT_CONSOLE_DEVICE) return false; // goes straight to stdout
+#endif
+  jshTransmitFlatStringIdle(); // reclaim any finished slots first
+  int i, slot = -1;
+  for (i=0;i<TXFLATSTRINGS;i++) {
+    if (txFlatStrings[i].var) {
+      // one active slot per device keeps the draining order trivial
+      if (txFlatStrings[i].device == device) return false;
+    } else slot = i;
+  }
+  if (slot<0) return false;
+  // anything already in txBuffer for us must be sent first - fall back
+  unsigned char tempTail = txTail;
+  while (tempTail != txHead) {
+    if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == device) return false;
+    tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+  }
+  txFlatStrings[slot].ptr = ptr + offset;
+  txFlatStrings[slot].pos = 0;
+  txFlatStrings[slot].len = count;
+  txFlatStrings[slot].device = device;
+  txFlatStrings[slot].done = false;
+  txFlatStrings[slot].var = jsvLockAgain(var); // set last - this marks the slot in use
+  jshUSARTKick(device); // set up interrupts if required
+  return true;
+}
+#endif
+
 // Return the device at the top of the transmit queue (or EV_NONE)
 IOEventFlags jshGetDeviceToTransmit() {
-  if (!jshHasTransmitData()) return EV_NONE;
+#ifndef SAVE_ON_FLASH
+  int i;
+  for (i=0;i<TXFLATSTRINGS;i++)
+    if (txFlatStrings[i].var && !txFlatStrings[i].done)
+      return txFlatStrings[i].device;
+#endif
+  if (txHead == txTail) return EV_NONE;
   return IOEVENTFLAGS_GETTYPE(txBuffer[txTail].flags);
 }
 
@@ -251,6 +580,21 @@ int jshGetCharToTransmit(
     }
   }
 
+#ifndef SAVE_ON_FLASH
+  /* An active flat string for this device is always older than anything in
+   * txBuffer (see jshTransmitFlatString), so it drains first */
+  int i;
+  for (i=0;i<TXFLATSTRINGS;i++) {
+    JshTxFlatString *b = (JshTxFlatString*)&txFlatStrings[i];
+    if (b->var && !b->done && b->device==device) {
+      unsigned char data = b->ptr[b->pos++];
+      if (b->pos >= b->len)
+        b->done = true; // main loop unlocks the JsVar (jshTransmitFlatStringIdle)
+      return data;
+    }
+  }
+#endif
+
   unsigned char tempTail = txTail;
   while (txHead != tempTail) {
     if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == device) {
@@ -265,6 +609,7 @@ int jshGetCharToTransmit(
           last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
         }
       }
+      jshDataBarrier(); // shifted items must be in place before the freed slot is published
       txTail = (unsigned char)((txTail+1)&TXBUFFERMASK); // advance the tail
       return data; // return data
     }
@@ -285,6 +630,14 @@ void jshTransmitFlush() {
 void jshTransmitClearDevice(
     IOEventFlags device //!< The device to be cleared.
   ) {
+#ifndef SAVE_ON_FLASH
+  /* Drop any queued flat string. Just mark it done - we may be in an IRQ
+   * here, so the unlock is left to jshTransmitFlatStringIdle */
+  int i;
+  for (i=0;i<TXFLATSTRINGS;i++)
+    if (txFlatStrings[i].var && txFlatStrings[i].device==device)
+      txFlatStrings[i].done = true;
+#endif
   // Keep requesting a character to transmit until there are no further characters.
   while (jshGetCharToTransmit(device)>=0);
 }
@@ -302,6 +655,12 @@ void jshTransmitMove(IOEventFlags from, IOEventFlags to) {
   } else {
     // Otherwise just rename the contents of the buffer
     jshInterruptOff();
+#ifndef SAVE_ON_FLASH
+    int i;
+    for (i=0;i<TXFLATSTRINGS;i++)
+      if (txFlatStrings[i].var && txFlatStrings[i].device==from)
+        txFlatStrings[i].device = to;
+#endif
     unsigned char tempTail = txTail;
     while (tempTail != txHead) {
       if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == from) {
@@ -318,15 +677,48 @@ void jshTransmitMove(IOEventFlags from, IOEventFlags to) {
  * \return True if we have data to transmit and false otherwise.
  */
 bool jshHasTransmitData() {
+#ifndef SAVE_ON_FLASH
+  int i;
+  for (i=0;i<TXFLATSTRINGS;i++)
+    if (txFlatStrings[i].var && !txFlatStrings[i].done) return true;
+#endif
   return txHead != txTail;
 }
 
 /**
- * flag that the buffer has overflowed.
+ * Is there anything still queued for transmission on this one device?
+ * \return True if the device has untransmitted data queued.
+ */
+bool jshHasTransmitDataFor(IOEventFlags device) {
+#ifndef SAVE_ON_FLASH
+  int i;
+  for (i=0;i<TXFLATSTRINGS;i++)
+    if (txFlatStrings[i].var && !txFlatStrings[i].done &&
+        txFlatStrings[i].device == device) return true;
+#endif
+  unsigned char tempTail = txTail;
+  while (tempTail != txHead) {
+    if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == device) return true;
+    tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+  }
+  return false;
+}
+
+/**
+ * flag that the buffer has overflowed, and record who lost data.
  */
-void CALLED_FROM_INTERRUPT jshIOEventOverflowed() {
+void CALLED_FROM_INTERRUPT jshIOEventOverflowed(IOEventFlags device) {
   // Error here - just set flag so we don't dump a load of data out
   jsErrorFlags |= JSERR_RX_FIFO_FULL;
+#ifndef SAVE_ON_FLASH
+  device &= EV_TYPE_MASK;
+  if (device <= EV_DEVICE_MAX) {
+    jshIODeviceStats[device].dropped++;
+    jshIOOverflowedDevices |= 1ULL << device;
+  }
+#else
+  NOT_USED(device);
+#endif
 }
 
 
@@ -342,24 +734,34 @@ void jshPushIOCharEvent(
     jsiCtrlC(); // Ctrl-C - force interrupt of execution
     return;
   }
-  // Check for existing buffer (we must have at least 2 in the queue to avoid dropping chars though!)
+#ifndef SAVE_ON_FLASH
+  jshIOCharsPushed++;
+#endif
+  // Check for existing buffer
 #ifndef LINUX // no need for this on linux, and also potentially dodgy when multi-threading
+  /* Appending to the newest event doesn't need interrupts masked: another
+   * channel's producer preempting us would allocate a new event rather than
+   * touch this one, and the consumer (which could pop this event if it's
+   * also the oldest) can't run while we're in an IRQ - except on the ESP32,
+   * where it's on the other core and the append lock is a real lock. */
+  jshIOAppendLock();
   unsigned char lastHead = (unsigned char)((ioHead+IOBUFFERMASK) & IOBUFFERMASK); // one behind head
-  if (ioHead!=ioTail && lastHead!=ioTail) {
-    // we can do this because we only read in main loop, and we're in an interrupt here
+  if (ioHead!=ioTail) {
     if (IOEVENTFLAGS_GETTYPE(ioBuffer[lastHead].flags) == channel) {
       unsigned char c = (unsigned char)IOEVENTFLAGS_GETCHARS(ioBuffer[lastHead].flags);
       if (c < IOEVENT_MAXCHARS) {
         // last event was for this event type, and it has chars left
         ioBuffer[lastHead].data.chars[c] = charData;
         IOEVENTFLAGS_SETCHARS(ioBuffer[lastHead].flags, c+1);
+        jshIOAppendUnlock();
         return; // char added, job done
       }
     }
   }
+  jshIOAppendUnlock();
 #endif
   // Set flow control (as we're going to use more data)
-  if (DEVICE_IS_USART(channel) && jshGetEventsUsed() > IOBUFFER_XOFF)
+  if (DEVICE_IS_USART(channel) && jshGetEventsUsed() > jshIOBufferXOff)
     jshSetFlowControlXON(channel, false);
 
   /* Make new buffer
@@ -371,16 +773,90 @@ void jshPushIOCharEvent(
   unsigned char nextHead = (unsigned char)((ioHead+1) & IOBUFFERMASK);
   if (ioTail == nextHead) {
     jshInterruptOn();
-    jshIOEventOverflowed();
+    jshIOEventOverflowed(channel);
     return; // queue full - dump this event!
   }
   unsigned char oldHead = ioHead;
   ioHead = nextHead;
   ioBuffer[oldHead].flags = channel;
-  // once channel is set we're safe - another IRQ won't touch this
-  jshInterruptOn();
   IOEVENTFLAGS_SETCHARS(ioBuffer[oldHead].flags, 1);
   ioBuffer[oldHead].data.chars[0] = charData;
+  /* the event must be complete before we release the lock - a same-channel
+   * producer could otherwise start appending to it while we fill it in */
+  jshInterruptOn();
+#ifndef SAVE_ON_FLASH
+  jshIOCharEventsCreated++;
+#endif
+  jshIOStatsEventPushed(channel);
+  jshIOStatsUpdateMax();
+}
+
+/**
+ * Send many characters to the specified device at once - eg. a USB bulk
+ * transfer or a UART DMA buffer drain. Packs IOEVENT_MAXCHARS characters
+ * into each event rather than doing the flag packing and head arithmetic
+ * once per byte.
+ */
+void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count) {
+  if (channel==jsiGetConsoleDevice()) {
+    // console data may contain Ctrl-C, which needs spotting per-character
+    unsigned int i;
+    for (i=0;i<count;i++)
+      if (data[i]==3) {
+        for (i=0;i<count;i++) jshPushIOCharEvent(channel, data[i]);
+        return;
+      }
+  }
+  if (!count) return;
+#ifndef SAVE_ON_FLASH
+  jshIOCharsPushed += count;
+#endif
+#ifndef LINUX // no need for this on linux, and also potentially dodgy when multi-threading
+  // Top up the last event if it was for us (see jshPushIOCharEvent for why
+  // this only needs a lock when the consumer is on another core)
+  jshIOAppendLock();
+  unsigned char lastHead = (unsigned char)((ioHead+IOBUFFERMASK) & IOBUFFERMASK); // one behind head
+  if (ioHead!=ioTail &&
+      IOEVENTFLAGS_GETTYPE(ioBuffer[lastHead].flags) == channel) {
+    unsigned char c = (unsigned char)IOEVENTFLAGS_GETCHARS(ioBuffer[lastHead].flags);
+    while (c < IOEVENT_MAXCHARS && count) {
+      ioBuffer[lastHead].data.chars[c++] = *(data++);
+      count--;
+    }
+    IOEVENTFLAGS_SETCHARS(ioBuffer[lastHead].flags, c);
+  }
+  jshIOAppendUnlock();
+#endif
+  // Set flow control once for the whole block (as we're going to use more data)
+  if (DEVICE_IS_USART(channel) && jshGetEventsUsed() > jshIOBufferXOff)
+    jshSetFlowControlXON(channel, false);
+  // Add full events of IOEVENT_MAXCHARS until we run out of data
+  while (count) {
+    jshInterruptOff();
+    unsigned char nextHead = (unsigned char)((ioHead+1) & IOBUFFERMASK);
+    if (ioTail == nextHead) {
+      jshInterruptOn();
+      jshIOEventOverflowed(channel);
+      return; // queue full - dump the rest of this block!
+    }
+    unsigned char oldHead = ioHead;
+    ioHead = nextHead;
+    ioBuffer[oldHead].flags = channel;
+    unsigned int c = (count > IOEVENT_MAXCHARS) ? IOEVENT_MAXCHARS : count;
+    IOEVENTFLAGS_SETCHARS(ioBuffer[oldHead].flags, c);
+    unsigned int i;
+    for (i=0;i<c;i++)
+      ioBuffer[oldHead].data.chars[i] = *(data++);
+    // the event must be complete before we release the lock - a same-channel
+    // producer could otherwise start appending to it while we fill it in
+    jshInterruptOn();
+    count -= c;
+#ifndef SAVE_ON_FLASH
+    jshIOCharEventsCreated++;
+#endif
+    jshIOStatsEventPushed(channel);
+    jshIOStatsUpdateMax();
+  }
 }
 
 /**
@@ -407,11 +883,59 @@ void CALLED_FROM_INTERRUPT jshPushIOWatchEvent(
   // TODO: move to using jshSetEventCallback
   if (trigHandleEXTI(channel | (state?EV_EXTI_IS_HIGH:0), time))
     return;
+#endif
+#ifndef SAVE_ON_FLASH
+  JshEventCapture *capture = &jshEventCaptures[channel-EV_EXTI0];
+  if (capture->data) {
+    // capture mode - record the time since the last edge (32 bit tick maths
+    // copes with wrap) and keep out of the event queue. Extra edges once the
+    // buffer is full are dropped, but their timing still counts.
+    uint32_t delta = (uint32_t)time - capture->lastEdgeTime;
+    capture->lastEdgeTime = (uint32_t)time;
+    if (capture->count < capture->length) {
+      uint64_t us = ((uint64_t)delta * capture->usPerTickScaled) >> 16;
+      capture->data[capture->count++] = (us>0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)us;
+      if (capture->count >= capture->length) // full - queue one event so the main loop flushes us
+        jshPushIOEvent(channel | (state?EV_EXTI_IS_HIGH:0), time);
+    }
+    return;
+  }
+  if (jshEventAggregateEnabled[channel-EV_EXTI0]) {
+    // count the edge; only the first of a burst gets a queue slot
+    if (jshEventAggregateCounts[channel-EV_EXTI0]++) return;
+  }
 #endif
   // Otherwise add this event
+#ifndef SAVE_ON_FLASH
+  // Watches are latency-critical, so they get the priority queue - they
+  // can't be stuck behind a buffer full of serial data there
+  jshPushIOPriorityEvent(channel | (state?EV_EXTI_IS_HIGH:0), time);
+#else
   jshPushIOEvent(channel | (state?EV_EXTI_IS_HIGH:0), time);
+#endif
 }
 
+#ifndef SAVE_ON_FLASH
+/**
+ * Add an event to the priority queue - these get popped before anything in
+ * the main IO buffer, so latency-critical handlers (watches, utility-timer
+ * intervals) aren't stuck behind bulk serial data. If the priority queue is
+ * full the event falls back to the main buffer rather than being dropped.
+ */
+void CALLED_FROM_INTERRUPT jshPushIOPriorityEvent(IOEventFlags flags, JsSysTime time) {
+  unsigned char nextHead = (unsigned char)((ioPriorityHead+1) & IOPRIORITYBUFFERMASK);
+  if (ioPriorityTail != nextHead) {
+    ioPriorityBuffer[ioPriorityHead].flags = flags;
+    ioPriorityBuffer[ioPriorityHead].data.time = (unsigned int)time;
+    jshDataBarrier(); // the event must be complete before the head moves
+    ioPriorityHead = nextHead;
+    jshIOStatsEventPushed(flags);
+    return;
+  }
+  jshPushIOEvent(flags, time);
+}
+#endif
+
 /**
  * Add this IO event to the IO event queue.
  */
@@ -421,24 +945,88 @@ void CALLED_FROM_INTERRUPT jshPushIOEvent(
   ) {
   unsigned char nextHead = (unsigned char)((ioHead+1) & IOBUFFERMASK);
   if (ioTail == nextHead) {
-    jshIOEventOverflowed();
+    jshIOEventOverflowed(channel);
     return; // queue full - dump this event!
   }
   ioBuffer[ioHead].flags = channel;
   ioBuffer[ioHead].data.time = (unsigned int)time;
+  jshDataBarrier(); // the event must be complete before the head moves
   ioHead = nextHead;
+  jshIOStatsEventPushed(channel);
+  jshIOStatsUpdateMax();
 }
 
 // returns true on success
 bool jshPopIOEvent(IOEvent *result) {
+#ifndef SAVE_ON_FLASH
+  // priority events always come off first
+  if (ioPriorityHead!=ioPriorityTail) {
+    *result = ioPriorityBuffer[ioPriorityTail];
+    ioPriorityTail = (unsigned char)((ioPriorityTail+1) & IOPRIORITYBUFFERMASK);
+    return true;
+  }
+#endif
   if (ioHead==ioTail) return false;
+  unsigned char nextTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
+  if (nextTail != ioHead) {
+    /* At least two events are queued. Producers only ever append characters
+     * to the newest event and the head can never lap round to make this one
+     * newest again, so it can't change under us - pop it without touching
+     * the interrupt mask. */
+    *result = ioBuffer[ioTail];
+    jshDataBarrier(); // copy out before the freed slot is published
+    ioTail = nextTail;
+    return true;
+  }
+  /* The tail event is also the newest - a producer could still be appending
+   * characters to it, so the copy and the tail move must happen with IRQs
+   * masked or the new characters would be lost */
+  jshInterruptOff();
   *result = ioBuffer[ioTail];
   ioTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
+  jshInterruptOn();
   return true;
 }
 
+/** Pop every event for the given device from the front of the IO buffer,
+ * appending the characters (masked with charMask) to the string iterator.
+ * This builds the string straight from the consecutive ring buffer bytes
+ * rather than copying events out one at a time. Stops at the first event
+ * belonging to another device. Returns the number of events popped. */
+int jshPopIOEventsAppendToString(IOEventFlags eventType, struct JsvStringIterator *it, char charMask) {
+  int eventsHandled = 0;
+  while (ioHead!=ioTail && IOEVENTFLAGS_GETTYPE(ioBuffer[ioTail].flags)==eventType) {
+    IOEvent event;
+    unsigned char nextTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
+    if (nextTail != ioHead) {
+      // not the newest event, so no producer can be appending to it (see jshPopIOEvent)
+      event = ioBuffer[ioTail];
+      jshDataBarrier(); // copy out before the freed slot is published
+      ioTail = nextTail;
+    } else {
+      // the newest event - a producer may still be appending characters to it
+      jshInterruptOff();
+      event = ioBuffer[ioTail];
+      ioTail = nextTail;
+      jshInterruptOn();
+    }
+    int i, chars = IOEVENTFLAGS_GETCHARS(event.flags);
+    for (i=0;i<chars;i++)
+      jsvStringIteratorAppend(it, (char)(event.data.chars[i] & charMask));
+    eventsHandled++;
+  }
+  return eventsHandled;
+}
+
 // returns true on success
 bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result) {
+#ifndef SAVE_ON_FLASH
+  /* Only watch and fast-timer events ever go in the priority queue, and
+   * nothing currently asks for those by type, so checking its top is enough */
+  if (ioPriorityHead!=ioPriorityTail &&
+      IOEVENTFLAGS_GETTYPE(ioPriorityBuffer[ioPriorityTail].flags) == eventType)
+    return jshPopIOEvent(result);
+#endif
   // Special case for top - it's easier!
   if (IOEVENTFLAGS_GETTYPE(ioBuffer[ioTail].flags) == eventType)
     return jshPopIOEvent(result);
@@ -473,17 +1061,28 @@ bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result) {
  * \return True if there are I/O events to be processed.
  */
 bool jshHasEvents() {
+#ifndef SAVE_ON_FLASH
+  if (ioPriorityHead!=ioPriorityTail) return true;
+#endif
   return ioHead!=ioTail;
 }
 
 /// Check if the top event is for the given device
 bool jshIsTopEvent(IOEventFlags eventType) {
+#ifndef SAVE_ON_FLASH
+  // the priority queue is popped first, so its head is the real top
+  if (ioPriorityHead!=ioPriorityTail)
+    return IOEVENTFLAGS_GETTYPE(ioPriorityBuffer[ioPriorityTail].flags) == eventType;
+#endif
   if (ioHead==ioTail) return false;
   return IOEVENTFLAGS_GETTYPE(ioBuffer[ioTail].flags) == eventType;
 }
 
 int jshGetEventsUsed() {
   int spaceUsed = (ioHead >= ioTail) ? ((int)ioHead-(int)ioTail) : /*or rolled*/((int)ioHead+IOBUFFERMASK+1-(int)ioTail);
+#ifndef SAVE_ON_FLASH
+  spaceUsed += (ioPriorityHead >= ioPriorityTail) ? ((int)ioPriorityHead-(int)ioPriorityTail) : ((int)ioPriorityHead+IOPRIORITYBUFFERMASK+1-(int)ioPriorityTail);
+#endif
   return spaceUsed;
 }
 
@@ -516,6 +1115,9 @@ const char *jshGetDeviceString(
 #endif
 #ifdef USE_TELNET
   case EV_TELNET: return "Telnet";
+#endif
+#ifdef USE_TERMINAL
+  case EV_TERMINAL: return "Terminal";
 #endif
   case EV_SERIAL1: return "Serial1";
   case EV_SERIAL2: return "Serial2";
@@ -572,9 +1174,14 @@ IOEventFlags jshFromDeviceString(
      if (strcmp(&device[1], "luetooth")==0) return EV_BLUETOOTH;
   }
 #endif
-#ifdef USE_TELNET
+#if defined(USE_TELNET) || defined(USE_TERMINAL)
   if (device[0]=='T') {
+#ifdef USE_TELNET
      if (strcmp(&device[1], "elnet")==0) return EV_TELNET;
+#endif
+#ifdef USE_TERMINAL
+     if (strcmp(&device[1], "erminal")==0) return EV_TERMINAL;
+#endif
   }
 #endif
   else if (device[0]=='S') {
@@ -52,6 +52,7 @@ typedef enum {
   EV_EXTI14, // External Interrupt 14
   EV_EXTI15, // External Interrupt 15
   EV_EXTI_MAX = EV_EXTI15,
+  EV_FASTTIMER, // a utility-timer-backed interval fired (see jsiFastTimerStart in jsinteractive.c)
   EV_SERIAL_START,
   EV_LOOPBACKA = EV_SERIAL_START,
   EV_LOOPBACKB,
@@ -62,6 +63,9 @@ typedef enum {
 #endif
 #ifdef USE_TELNET
   EV_TELNET,
+#endif
+#ifdef USE_TERMINAL
+  EV_TERMINAL, // a text terminal rendered to a Graphics instance
 #endif
   EV_SERIAL1,
   EV_SERIAL2,
@@ -135,21 +139,39 @@ typedef struct IOEvent {
 } PACKED_FLAGS IOEvent;
 
 void jshPushIOEvent(IOEventFlags channel, JsSysTime time);
+#ifndef SAVE_ON_FLASH
+/// Add an event to the priority queue - these get popped before anything in the main IO buffer. Falls back to the main buffer when full
+void jshPushIOPriorityEvent(IOEventFlags flags, JsSysTime time);
+#endif
 void jshPushIOWatchEvent(IOEventFlags channel); // push an even when a pin changes state
 /// Push a single character event (for example USART RX)
 void jshPushIOCharEvent(IOEventFlags channel, char charData);
-/// Push many character events at once (for example USB RX)
-static inline void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count) {
-  // TODO: optimise me!
-  unsigned int i;
-  for (i=0;i<count;i++) jshPushIOCharEvent(channel, data[i]);
-}
+/// Push many character events at once (for example USB RX or a UART DMA drain) - packs IOEVENT_MAXCHARS characters per event
+void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count);
 bool jshPopIOEvent(IOEvent *result); ///< returns true on success
 bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result); ///< returns true on success
+/// Pop every event for the given device from the front of the IO buffer, appending the (masked) characters to the string iterator. Returns the number of events popped
+struct JsvStringIterator;
+int jshPopIOEventsAppendToString(IOEventFlags eventType, struct JsvStringIterator *it, char charMask);
 /// Do we have any events pending? Will jshPopIOEvent return true?
 bool jshHasEvents();
 /// Check if the top event is for the given device
 bool jshIsTopEvent(IOEventFlags eventType);
+#ifndef SAVE_ON_FLASH
+/// Enable/disable edge aggregation for a watch channel (see setWatch's aggregate option)
+void jshSetEventAggregation(IOEventFlags channel, bool aggregate);
+/// Fetch and reset the number of edges aggregated for a watch channel (0 if aggregation is off)
+int jshGetEventAggregateCount(IOEventFlags channel);
+/** Start recording edges on a watch channel into 'data' from the IRQ (see
+ * setWatch's capture option). Each entry is the time since the previous edge
+ * in microseconds. 'timeoutTicks' is how long the line must stay quiet before
+ * jshGetEventCaptureIdleFlush reports the channel. data=0 stops capturing. */
+void jshSetEventCapture(IOEventFlags channel, uint32_t *data, unsigned int length, JsSysTime timeoutTicks);
+/// Fetch and reset the number of edges captured so far for a watch channel
+int jshGetEventCaptureCount(IOEventFlags channel);
+/// Return a channel with captured edges whose line has been quiet past its timeout (EV_NONE if none)
+IOEventFlags jshGetEventCaptureIdleFlush(JsSysTime time);
+#endif
 
 /// How many event blocks are left? compare this to IOBUFFERMASK
 int jshGetEventsUsed();
@@ -167,14 +189,24 @@ JsVar *jshGetDeviceObject(IOEventFlags device);
 //                                                         DATA TRANSMIT BUFFER
 /// Queue a character for transmission
 void jshTransmit(IOEventFlags device, unsigned char data);
+/// Queue a run of characters for transmission in one go - cheaper than jshTransmit in a loop
+void jshTransmitChars(IOEventFlags device, const unsigned char *data, unsigned int count);
 /// Wait for transmit to finish
 void jshTransmitFlush();
+#ifndef SAVE_ON_FLASH
+/// Queue a whole flat string for transmission without copying it into the transmit buffer. Returns false if it couldn't be queued - send with jshTransmit instead
+bool jshTransmitFlatString(IOEventFlags device, JsVar *var, size_t offset, size_t count);
+/// Unlock any flat strings that have finished transmitting - called from the idle loop
+void jshTransmitFlatStringIdle();
+#endif
 /// Clear everything from a device
 void jshTransmitClearDevice(IOEventFlags device);
 /// Move all output from one device to another
 void jshTransmitMove(IOEventFlags from, IOEventFlags to);
 /// Do we have anything we need to send?
 bool jshHasTransmitData();
+/// Do we have anything we need to send on this one device?
+bool jshHasTransmitDataFor(IOEventFlags device);
 // Return the device at the top of the transmit queue (or EV_NONE)
 IOEventFlags jshGetDeviceToTransmit();
 /// Try and get a character for transmission - could just return -1 if nothing
@@ -184,6 +216,26 @@ int jshGetCharToTransmit(IOEventFlags device);
 /// Set whether the host should transmit or not
 void jshSetFlowControlXON(IOEventFlags device, bool hostShouldTransmit);
 
+#ifndef SAVE_ON_FLASH
+/// IO buffer occupancy (in events) at which flow control stops/restarts the host - see Serial.setup's flowStop/flowStart
+extern int jshIOBufferXOff, jshIOBufferXOn;
+/// Characters pushed into the IO buffer / events they were packed into - see E.getIOEventStats
+extern volatile uint32_t jshIOCharsPushed, jshIOCharEventsCreated;
+/// Per-device IO event counters - see E.getIOStats
+typedef struct {
+  uint32_t pushed;  ///< IO events queued for this device
+  uint32_t dropped; ///< IO events dropped because the buffer was full
+} JshIODeviceStats;
+extern volatile JshIODeviceStats jshIODeviceStats[EV_DEVICE_MAX+1];
+/// High-water marks of ioBuffer/txBuffer occupancy - see E.getIOStats
+extern volatile unsigned char jshIOBufferMaxUsed, jshTxBufferMaxUsed;
+/// Bitmask of devices that have dropped an event - jsiCheckErrors clears this as it emits E's 'overflow' events
+extern volatile uint64_t jshIOOverflowedDevices;
+#else
+#define jshIOBufferXOff IOBUFFER_XOFF
+#define jshIOBufferXOn IOBUFFER_XON
+#endif
+
 /// Set whether to use flow control on the given device or not. Whether to use software, and if hardware, the pin to use for RTS
 void jshSetFlowControlEnabled(IOEventFlags device, bool software, unsigned char/*Pin*/ pinCTS);
 
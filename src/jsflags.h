@@ -22,9 +22,11 @@ typedef enum {
   JSF_PRETOKENISE         = 1<<1, ///< When adding functions, pre-minify them and tokenise reserved words
   JSF_UNSAFE_FLASH        = 1<<2, ///< Some platforms stop writes/erases to interpreter memory to stop you bricking the device accidentally - this removes that protection
   JSF_UNSYNC_FILES        = 1<<3, ///< When accessing files, *don't* flush all data to the SD card after each command. Faster, but risky if power is lost
+  JSF_FAST_MATH           = 1<<4, ///< Use single-precision maths for Math.sin/cos/atan/atan2/sqrt - much faster on FPUs without double support, at ~7 digit accuracy
+  JSF_WARN_BUILTIN_ALLOC  = 1<<5, ///< Warn when a builtin class or its prototype gets materialised in RAM (normally builtins live entirely in the const symbol tables)
 } PACKED_FLAGS JsFlags;
 
-#define JSFLAG_NAMES "deepSleep\0pretokenise\0unsafeFlash\0unsyncFiles\0"
+#define JSFLAG_NAMES "deepSleep\0pretokenise\0unsafeFlash\0unsyncFiles\0fastMath\0warnBuiltinAlloc\0"
 // NOTE: \0 also added by compiler - two \0's are required!
 
 extern volatile JsFlags jsFlags;
@@ -83,6 +83,18 @@ bool jshIsUSBSERIALConnected();
 
 /// Get the system time (in ticks since the epoch)
 JsSysTime jshGetSystemTime();
+/** Get the system time as cheaply as possible - a raw counter read, with any
+ * smoothing/sleep-recovery work deferred. Monotonic and in the same timebase
+ * as jshGetSystemTime but allowed to lag it very slightly, so only use it
+ * where a short delta or timeout is wanted (the utility timer IRQ and the
+ * idle loop's timestamp maths). Ports whose jshGetSystemTime is expensive
+ * define JSH_HAS_FAST_SYSTEM_TIME and supply their own - everywhere else
+ * this is just jshGetSystemTime. */
+#ifdef JSH_HAS_FAST_SYSTEM_TIME
+JsSysTime jshGetSystemTimeFast();
+#else
+#define jshGetSystemTimeFast jshGetSystemTime
+#endif
 /** Set the system time (in ticks since the epoch) - this should only be called rarely as it
 could mess up things like jsinteractive's timers! */
 void jshSetSystemTime(JsSysTime time);
@@ -99,6 +111,11 @@ void jshDelayMicroseconds(int microsec);  ///< delay a few microseconds. Should
 
 void jshPinSetValue(Pin pin, bool value); ///< Set a digital output to 1 or 0. DOES NOT change pin state OR CHECK PIN VALIDITY
 bool jshPinGetValue(Pin pin); ///< Get the value of a digital input. DOES NOT change pin state OR CHECK PIN VALIDITY
+/** Set several digital outputs in one go. pins[0] gets the most significant bit
+ * of value, pins[count-1] the least significant. Where the hardware allows it,
+ * pins that share a GPIO port are updated with a single port register write so
+ * they change simultaneously. DOES NOT change pin state OR CHECK PIN VALIDITY */
+void jshPinSetValues(int count, Pin *pins, JsVarInt value);
 
 /// Control of the pin mux, i.e. assign functions to pins
 typedef enum {
@@ -182,6 +199,23 @@ JsVarFloat jshPinAnalog(Pin pin);
  * For use from an IRQ where high speed is needed */
 int jshPinAnalogFast(Pin pin);
 
+#ifdef NRF52
+#define JSH_HAS_ANALOG_CAPTURE
+#endif
+#ifdef JSH_HAS_ANALOG_CAPTURE
+/** Start a hardware (DMA) analog capture on the given pin - the ADC paces
+ * itself and writes samples (16 bit LSB first, at the ADC's native
+ * resolution) straight to RAM. buf0 is filled first, then buf1 (or buf0
+ * again if buf1==0), and so on until jshAnalogCaptureStop. Returns false if
+ * the pin/rate/size isn't supported or a capture is already running - the
+ * caller (Waveform.startInput) then falls back to utility-timer sampling. */
+bool jshAnalogCaptureStart(Pin pin, unsigned char *buf0, unsigned char *buf1, unsigned int nSamples, unsigned int samplesPerSec);
+/// Stop a capture started with jshAnalogCaptureStart
+void jshAnalogCaptureStop();
+/// Fetch and reset the number of buffers the ADC has filled since the last call
+int jshAnalogCaptureCompleted();
+#endif
+
 /// Flags for jshPinAnalogOutput
 typedef enum {
   JSAOF_NONE,
@@ -345,6 +379,10 @@ void jshFlashRead(void *buf, uint32_t addr, uint32_t len);
 /** Write data to flash memory from the buffer, the buffer address and flash address are
   * guaranteed to be 4-byte aligned, and length is a multiple of 4.  */
 void jshFlashWrite(void *buf, uint32_t addr, uint32_t len);
+/** Return the address in the CPU's address space where the given flash address is
+  * memory-mapped for reading, or 0 if it isn't. The same flash address must map to
+  * the same memory address every boot, as saved state may contain pointers into it. */
+size_t jshFlashGetMemMapAddress(uint32_t addr);
 
 
 /** Utility timer handling functions
@@ -408,6 +446,28 @@ unsigned int jshGetRandomNumber();
  * speed in Hz though. */
 unsigned int jshSetSystemClock(JsVar *options);
 
+#ifdef ESP32
+#define JSH_HAS_CRYPTO
+#endif
+#ifdef JSH_HAS_CRYPTO
+/// AES block chaining modes understood by jshAES
+typedef enum {
+  JSHAES_ECB, ///< independent 16 byte blocks - iv unused
+  JSHAES_CBC, ///< cipher block chaining - iv updated, so a followup call continues the stream
+  JSHAES_CTR, ///< counter mode - iv is the initial counter, encrypt/decrypt are the same operation
+} JshAESMode;
+/** Run a whole message (len bytes, a multiple of 16) through the hardware AES
+ * engine. keyBits is 128, 192 or 256. Returns false if the hardware can't
+ * handle this mode/key size (or is busy) - the caller then falls back to
+ * software mbedTLS. */
+bool jshAES(JshAESMode mode, bool encrypt, const unsigned char *key, unsigned int keyBits, unsigned char iv[16], const unsigned char *input, unsigned char *output, size_t len);
+/** One-shot hardware SHA of len bytes into digest. shaBits is 1 (=SHA1), 224,
+ * 256, 384 or 512, and digest must be big enough for that variant. Returns
+ * false if the hardware doesn't do that variant - the caller then falls back
+ * to software mbedTLS. */
+bool jshSHA(int shaBits, const unsigned char *data, size_t len, unsigned char *digest);
+#endif
+
 /** Hacky definition of wait cycles used for WAIT_UNTIL.
  * TODO: make this depend on known system clock speed? */
 #if defined(STM32F401xx) || defined(STM32F411xx)
@@ -24,6 +24,7 @@
 #include "jswrap_espruino.h" // jswrap_espruino_getErrorFlagArray
 #include "jswrap_flash.h" // load and save to flash
 #include "jswrap_object.h" // jswrap_object_keys_or_property_names
+#include "jswrap_promise.h" // jspromise_runReaction
 #include "jsnative.h" // jsnSanityTest
 #ifdef BLUETOOTH
 #include "bluetooth.h"
@@ -58,7 +59,18 @@ typedef enum {
 } PACKED_FLAGS InputState;
 
 JsVar *events = 0; // Array of events to execute
+#ifndef SAVE_ON_FLASH
+JsVar *microtasks = 0; // Array of microtasks (promise jobs) - run after the current event callback, before any queued events
+#endif
 JsVarRef timerArray = 0; // Linked List of timers to check and run
+#ifndef SAVE_ON_FLASH
+JsSysTime jsiNextTimerTime = 0; ///< Time from jsiLastIdleTime until the next timer fires - until then idle needn't walk the timer array (0 = walk on the next idle)
+JsSysTime jsiSkippedTimeCounted = 0; ///< While timer checks are being skipped: how much of the time since jsiLastIdleTime was already added to jsiTimeSinceCtrlC
+bool jsiIOFullNotified = false; ///< E.on('ioFull') has fired and the IO buffer hasn't drained below the restart watermark yet
+bool jsiTimerFullNotified = false; ///< E.on('timerFull') has fired and the utility timer task queue hasn't drained since
+#define JSI_FASTTIMERS 4 // max 4 - the slot index travels in the event's 2 spare flag bits
+JsVarInt jsiFastTimerIds[JSI_FASTTIMERS] = {-1,-1,-1,-1}; ///< Timer-array indices of intervals routed to the utility timer (see jsiFastTimerStart), -1 = slot free
+#endif
 JsVarRef watchArray = 0; // Linked List of input watches to check and run
 // ----------------------------------------------------------------------------
 IOEventFlags consoleDevice = DEFAULT_CONSOLE_DEVICE; ///< The console device for user interaction
@@ -87,6 +99,9 @@ JsErrorFlags lastJsErrorFlags = 0; ///< Compare with jsErrorFlags in order to re
 #ifdef USE_DEBUGGER
 void jsiDebuggerLine(JsVar *line);
 #endif
+#ifndef SAVE_ON_FLASH
+static void jsiCheckSlowCallbacks();
+#endif
 
 // ----------------------------------------------------------------------------
 
@@ -155,7 +170,11 @@ void jsiSetConsoleDevice(IOEventFlags device, bool force) {
 
   if (device == consoleDevice) return;
 
-  if (!jshIsDeviceInitialised(device)) {
+  if (!jshIsDeviceInitialised(device)
+#ifdef USE_TERMINAL
+      && device != EV_TERMINAL // not a USART
+#endif
+      ) {
     JshUSARTInfo inf;
     jshUSARTInitInfo(&inf);
     jshUSARTSetup(device, &inf);
@@ -201,12 +220,22 @@ NO_INLINE void jsiConsolePrintChar(char data) {
 
 /**
  * \breif Send a NULL terminated string to the console.
+ *
+ * Output is staged in a small flat buffer and handed to the transmit
+ * queue in batches, rather than one ring-buffer operation per character.
  */
 NO_INLINE void jsiConsolePrintString(const char *str) {
+  char buf[64];
+  unsigned int len = 0;
   while (*str) {
-    if (*str == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(*(str++));
+    if (len >= sizeof(buf)-1) { // leave room for a possible \r\n pair
+      jshTransmitChars(consoleDevice, (unsigned char*)buf, len);
+      len = 0;
+    }
+    if (*str == '\n') buf[len++] = '\r';
+    buf[len++] = *(str++);
   }
+  if (len) jshTransmitChars(consoleDevice, (unsigned char*)buf, len);
 }
 
 #ifdef USE_FLASH_MEMORY
@@ -265,16 +294,23 @@ void jsiConsolePrintStringVarUntilEOL(JsVar *v, size_t fromCharacter, size_t max
 /** Print the contents of a string var - directly - starting from the given character, and
  * using newLineCh to prefix new lines (if it is not 0). */
 void jsiConsolePrintStringVarWithNewLineChar(JsVar *v, size_t fromCharacter, char newLineCh) {
+  char buf[64];
+  unsigned int len = 0;
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, fromCharacter);
   while (jsvStringIteratorHasChar(&it)) {
+    if (len >= sizeof(buf)-2) { // leave room for \r\n + newLineCh
+      jshTransmitChars(consoleDevice, (unsigned char*)buf, len);
+      len = 0;
+    }
     char ch = jsvStringIteratorGetChar(&it);
-    if (ch == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(ch);
-    if (ch == '\n' && newLineCh) jsiConsolePrintChar(newLineCh);
+    if (ch == '\n') buf[len++] = '\r';
+    buf[len++] = ch;
+    if (ch == '\n' && newLineCh) buf[len++] = newLineCh;
     jsvStringIteratorNext(&it);
   }
   jsvStringIteratorFree(&it);
+  if (len) jshTransmitChars(consoleDevice, (unsigned char*)buf, len);
 }
 
 /**
@@ -421,6 +457,9 @@ void jsiSoftInit(bool hasBeenReset) {
   jsErrorFlags = 0;
   lastJsErrorFlags = 0;
   events = jsvNewEmptyArray();
+#ifndef SAVE_ON_FLASH
+  microtasks = jsvNewEmptyArray();
+#endif
   inputLine = jsvNewFromEmptyString();
   inputCursorPos = 0;
   jsiLineNumberOffset = 0;
@@ -439,7 +478,13 @@ void jsiSoftInit(bool hasBeenReset) {
 
   // Make sure we set up lastIdleTime, as this could be used
   // when adding an interval from onInit (called below)
-  jsiLastIdleTime = jshGetSystemTime();
+  jsiLastIdleTime = jshGetSystemTimeFast();
+#ifndef SAVE_ON_FLASH
+  jsiNextTimerTime = 0; // force the next idle to walk the (newly loaded) timer array
+  jsiSkippedTimeCounted = 0;
+  jsiIOFullNotified = false;
+  jsiTimerFullNotified = false;
+#endif
   jsiTimeSinceCtrlC = 0xFFFFFFFF;
 
   // Set up interpreter flags and remove
@@ -481,6 +526,35 @@ void jsiSoftInit(bool hasBeenReset) {
   // Timers are stored by time in the future now, so no need
   // to fiddle with them.
 
+#ifndef SAVE_ON_FLASH
+  // Re-route any utility-timer-backed intervals - their timer tasks died with
+  // the old state. If re-routing fails (no free slot/task) the 'fast' flag is
+  // dropped and they fall back to the ordinary timer path.
+  if (timerArray) {
+    JsVar *timerArrayPtr = jsvLock(timerArray);
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, timerArrayPtr);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *timer = jsvObjectIteratorGetValue(&it);
+      if (jsvGetBoolAndUnLock(jsvObjectGetChild(timer, "fast", 0))) {
+        JsVarInt timerId = jsvGetIntegerAndUnLock(jsvObjectIteratorGetKey(&it));
+        int slot;
+        for (slot=0;slot<JSI_FASTTIMERS && jsiFastTimerIds[slot]!=timerId;slot++);
+        if (slot==JSI_FASTTIMERS) { // not routed yet (intervals made by the boot code just ran already are)
+          jsvObjectRemoveChild(timer, "fast");
+          JsSysTime interval = jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timer, "interval", 0));
+          if (interval>0)
+            jsiFastTimerStart(timer, timerId, interval);
+        }
+      }
+      jsvUnLock(timer);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(timerArrayPtr);
+  }
+#endif
+
   // Execute `init` events on `E`
   JsVar *E = jsvObjectGetChild(execInfo.root, "E", 0);
   if (E) {
@@ -696,11 +770,23 @@ void jsiSoftKill() {
   jswKill();
   // Stop all active timer tasks
   jstReset();
+#ifndef SAVE_ON_FLASH
+  jsiFastTimerStopAll(); // their tasks just died with jstReset - free the slots
+  // stop slow-callback tracing - the refs in the table won't survive a reload
+  jsiSlowCallbackThreshold = 0;
+  jsiSlowCallbacksReset();
+#endif
   // Unref Watches/etc
   if (events) {
     jsvUnLock(events);
     events=0;
   }
+#ifndef SAVE_ON_FLASH
+  if (microtasks) {
+    jsvUnLock(microtasks);
+    microtasks=0;
+  }
+#endif
   if (timerArray) {
     jsvUnRefRef(timerArray);
     timerArray=0;
@@ -1163,6 +1249,31 @@ void jsiCheckErrors() {
     }
     lastJsErrorFlags = jsErrorFlags;
   }
+#ifndef SAVE_ON_FLASH
+  if (jshIOOverflowedDevices) {
+    // IO buffer overflowed - tell JS *which* device lost data (see E's 'overflow' event)
+    jshInterruptOff();
+    uint64_t overflowed = jshIOOverflowedDevices;
+    jshIOOverflowedDevices = 0;
+    jshInterruptOn();
+    JsVar *E = jsvObjectGetChild(execInfo.root, "E", 0);
+    if (E) {
+      JsVar *callback = jsvObjectGetChild(E, JS_EVENT_PREFIX"overflow", 0);
+      if (callback) {
+        int d;
+        for (d=0;d<=EV_DEVICE_MAX;d++)
+          if (overflowed & (1ULL<<d)) {
+            JsVar *v = jsvNewFromString(jshGetDeviceString((IOEventFlags)d));
+            jsiExecuteEventCallback(0, callback, 1, &v);
+            jsvUnLock(v);
+          }
+        jsvUnLock(callback);
+      }
+      jsvUnLock(E);
+    }
+  }
+  jsiCheckSlowCallbacks();
+#endif
 }
 
 
@@ -1587,6 +1698,94 @@ void jsiQueueEvents(JsVar *object, JsVar *callback, JsVar **args, int argCount)
   }
 }
 
+#ifndef SAVE_ON_FLASH
+/// Queue a microtask (eg. a promise reaction) - these run in order after the currently-executing event callback, before any queued events
+void jsiQueueMicrotask(JsVar *object, JsVar *callback, JsVar *arg) {
+  JsVar *task = jsvNewObject();
+  if (!task) return; // out of memory
+  jsvUnLock(jsvAddNamedChild(task, callback, "func"));
+  if (arg) jsvUnLock(jsvAddNamedChild(task, arg, "arg"));
+  if (object) jsvUnLock(jsvAddNamedChild(task, object, "this"));
+  jsvArrayPushAndUnLock(microtasks, task);
+}
+
+/** Queue a promise settling as a microtask. A compact form of
+ * jsiQueueMicrotask for the common promise case: rather than allocating a
+ * native function bound to the promise every time one settles, the task just
+ * records the promise and jsiExecuteMicrotasks hands it straight to
+ * jspromise_runReaction */
+void jsiQueuePromiseReaction(JsVar *promise, JsVar *arg, bool resolve) {
+  JsVar *task = jsvNewObject();
+  if (!task) return; // out of memory
+  jsvUnLock(jsvAddNamedChild(task, promise, "promise"));
+  if (arg) jsvUnLock(jsvAddNamedChild(task, arg, "arg"));
+  if (!resolve) jsvObjectSetChildAndUnLock(task, "reject", jsvNewFromBool(true));
+  jsvArrayPushAndUnLock(microtasks, task);
+}
+
+/// Run microtasks until there are none left. Tasks queued by a running task execute in the same drain
+static void jsiExecuteMicrotasks() {
+  while (microtasks && !jsvArrayIsEmpty(microtasks)) {
+    JsVar *task = jsvSkipNameAndUnLock(jsvArrayPopFirst(microtasks));
+    JsVar *promise = jsvObjectGetChild(task, "promise", 0);
+    if (promise) { // a promise reaction (jsiQueuePromiseReaction)
+      JsVar *arg = jsvObjectGetChild(task, "arg", 0);
+      bool reject = jsvGetBoolAndUnLock(jsvObjectGetChild(task, "reject", 0));
+      jsvUnLock(task);
+      jspromise_runReaction(promise, arg, !reject);
+      jsvUnLock2(arg, promise);
+    } else {
+      JsVar *func = jsvObjectGetChild(task, "func", 0);
+      JsVar *thisVar = jsvObjectGetChild(task, "this", 0);
+      JsVar *arg = jsvObjectGetChild(task, "arg", 0);
+      jsvUnLock(task);
+      jsiExecuteEventCallback(thisVar, func, arg?1:0, &arg);
+      jsvUnLock3(arg, func, thisVar);
+    }
+  }
+}
+#endif
+
+#ifndef SAVE_ON_FLASH
+/** Cache of event listener lookups (eg. JS_EVENT_PREFIX"data" on a serial
+ * port object) so firing the same event over and over skips the child list
+ * walk. Entries remember the *name* var and re-skip it on every hit, so
+ * replacing a listener - or on() turning a single listener into an array of
+ * them - is picked up immediately; anything that frees a name bumps
+ * jsVarStructureVersion and drops the entry (the same guard the parser's
+ * inline caches use, see jsparse.c). */
+#define JSI_LISTENER_CACHE_SIZE 4
+typedef struct {
+  JsVarRef object;               ///< the object the listener lives on (0 = empty slot)
+  const char *name;              ///< the static string the lookup was made with
+  JsVarRef callbackName;         ///< the name var the lookup resolved to
+  unsigned int structureVersion; ///< jsVarStructureVersion when this was cached
+} JsiListenerCacheEntry;
+static JsiListenerCacheEntry jsiListenerCache[JSI_LISTENER_CACHE_SIZE];
+#endif
+
+/// Get the callback with the given name from an object - a cached jsvObjectGetChild for event dispatch
+JsVar *jsiGetObjectCallback(JsVar *object, const char *callbackName) {
+#ifndef SAVE_ON_FLASH
+  JsiListenerCacheEntry *e = &jsiListenerCache[jsvGetRef(object) & (JSI_LISTENER_CACHE_SIZE-1)];
+  if (e->object && e->object==jsvGetRef(object) && e->name==callbackName &&
+      e->structureVersion==jsVarStructureVersion)
+    return jsvSkipNameAndUnLock(jsvLock(e->callbackName));
+  JsVar *child = jsvFindChildFromString(object, callbackName, false);
+  JsVar *callback = jsvSkipName(child);
+  if (child) {
+    e->object = jsvGetRef(object);
+    e->name = callbackName;
+    e->callbackName = jsvGetRef(child);
+    e->structureVersion = jsVarStructureVersion;
+  }
+  jsvUnLock(child);
+  return callback;
+#else
+  return jsvObjectGetChild(object, callbackName, 0);
+#endif
+}
+
 bool jsiObjectHasCallbacks(JsVar *object, const char *callbackName) {
   JsVar *callback = jsvObjectGetChild(object, callbackName, 0);
   bool hasCallbacks = !jsvIsUndefined(callback);
@@ -1595,14 +1794,14 @@ bool jsiObjectHasCallbacks(JsVar *object, const char *callbackName) {
 }
 
 void jsiQueueObjectCallbacks(JsVar *object, const char *callbackName, JsVar **args, int argCount) {
-  JsVar *callback = jsvObjectGetChild(object, callbackName, 0);
+  JsVar *callback = jsiGetObjectCallback(object, callbackName);
   if (!callback) return;
   jsiQueueEvents(object, callback, args, argCount);
   jsvUnLock(callback);
 }
 
 void jsiExecuteObjectCallbacks(JsVar *object, const char *callbackName, JsVar **args, int argCount) {
-  JsVar *callback = jsvObjectGetChild(object, callbackName, 0);
+  JsVar *callback = jsiGetObjectCallback(object, callbackName);
   if (!callback) return;
   jsiExecuteEventCallback(object, callback, (unsigned int)argCount, args);
   jsvUnLock(callback);
@@ -1649,11 +1848,91 @@ NO_INLINE bool jsiExecuteEventCallbackArgsArray(JsVar *thisVar, JsVar *callbackV
   return r;
 }
 
+#ifndef SAVE_ON_FLASH
+/** Slow-callback tracing (see E.setSlowCallbackThreshold). When one callback
+ * overruns, every timer queued behind it silently slips - so we record the
+ * worst offenders here and fire E's 'slowCallback' event from the idle loop
+ * (never from inside the callback machinery itself, which could recurse). */
+JsSysTime jsiSlowCallbackThreshold = 0;
+JsiSlowCallback jsiSlowCallbacks[JSI_SLOW_CALLBACKS];
+static volatile bool jsiSlowCallbackPending = false; ///< emit 'slowCallback' on the next idle
+static JsVarRef jsiSlowCallbackLastRef = 0;
+static JsSysTime jsiSlowCallbackLastTime = 0;
+
+void jsiSlowCallbacksReset() {
+  memset(jsiSlowCallbacks, 0, sizeof(jsiSlowCallbacks));
+  jsiSlowCallbackPending = false;
+  jsiSlowCallbackLastRef = 0;
+}
+
+/// A callback overran the threshold - remember it (keeping the worst if the table is full)
+static void jsiSlowCallbackRecord(JsVarRef ref, JsSysTime time) {
+  int i, slot = -1;
+  for (i=0;i<JSI_SLOW_CALLBACKS;i++) {
+    if (jsiSlowCallbacks[i].ref == ref) { slot = i; break; }
+    if (slot<0 && !jsiSlowCallbacks[i].ref) slot = i;
+  }
+  if (slot<0) {
+    // table full - evict the least-bad entry, but only if we beat it
+    slot = 0;
+    for (i=1;i<JSI_SLOW_CALLBACKS;i++)
+      if (jsiSlowCallbacks[i].worst < jsiSlowCallbacks[slot].worst) slot = i;
+    if (time <= jsiSlowCallbacks[slot].worst) slot = -1;
+  }
+  if (slot>=0) {
+    if (jsiSlowCallbacks[slot].ref != ref) {
+      jsiSlowCallbacks[slot].ref = ref;
+      jsiSlowCallbacks[slot].worst = 0;
+      jsiSlowCallbacks[slot].count = 0;
+    }
+    jsiSlowCallbacks[slot].count++;
+    if (time > jsiSlowCallbacks[slot].worst)
+      jsiSlowCallbacks[slot].worst = time;
+  }
+  jsiSlowCallbackLastRef = ref;
+  jsiSlowCallbackLastTime = time;
+  jsiSlowCallbackPending = true;
+}
+
+/// Fire E's 'slowCallback' event for the latest offender - called from jsiCheckErrors
+static void jsiCheckSlowCallbacks() {
+  if (!jsiSlowCallbackPending) return;
+  jsiSlowCallbackPending = false;
+  JsVar *E = jsvObjectGetChild(execInfo.root, "E", 0);
+  if (!E) return;
+  JsVar *callback = jsvObjectGetChild(E, JS_EVENT_PREFIX"slowCallback", 0);
+  if (callback) {
+    JsVar *info = jsvNewObject();
+    if (info) {
+      JsVar *f = _jsvGetAddressOf(jsiSlowCallbackLastRef);
+      if (f && jsvIsFunction(f))
+        jsvObjectSetChildAndUnLock(info, "callback", jsvLockAgain(f));
+      jsvObjectSetChildAndUnLock(info, "time",
+          jsvNewFromFloat(jshGetMillisecondsFromTime(jsiSlowCallbackLastTime)/1000));
+      // don't trace the handler itself - a slow handler would loop forever
+      JsSysTime threshold = jsiSlowCallbackThreshold;
+      jsiSlowCallbackThreshold = 0;
+      jsiExecuteEventCallback(0, callback, 1, &info);
+      jsiSlowCallbackThreshold = threshold;
+      jsvUnLock(info);
+    }
+    jsvUnLock(callback);
+  }
+  jsvUnLock(E);
+}
+#endif
+
 NO_INLINE bool jsiExecuteEventCallback(JsVar *thisVar, JsVar *callbackVar, unsigned int argCount, JsVar **argPtr) { // array of functions or single function
   JsVar *callbackNoNames = jsvSkipName(callbackVar);
+#ifndef SAVE_ON_FLASH
+  static int eventCallbackDepth = 0; // so microtasks only run once the outermost callback has finished
+#endif
 
   bool ok = true;
   if (callbackNoNames) {
+#ifndef SAVE_ON_FLASH
+    eventCallbackDepth++;
+#endif
     if (jsvIsArray(callbackNoNames)) {
       JsvObjectIterator it;
       jsvObjectIteratorNew(&it, callbackNoNames);
@@ -1665,12 +1944,25 @@ NO_INLINE bool jsiExecuteEventCallback(JsVar *thisVar, JsVar *callbackVar, unsig
       }
       jsvObjectIteratorFree(&it);
     } else if (jsvIsFunction(callbackNoNames)) {
+#ifndef SAVE_ON_FLASH
+      if (jsiSlowCallbackThreshold) {
+        JsSysTime start = jshGetSystemTime();
+        jsvUnLock(jspExecuteFunction(callbackNoNames, thisVar, (int)argCount, argPtr));
+        JsSysTime duration = jshGetSystemTime() - start;
+        if (duration >= jsiSlowCallbackThreshold)
+          jsiSlowCallbackRecord(jsvGetRef(callbackNoNames), duration);
+      } else
+#endif
       jsvUnLock(jspExecuteFunction(callbackNoNames, thisVar, (int)argCount, argPtr));
     } else if (jsvIsString(callbackNoNames)) {
       jsvUnLock(jspEvaluateVar(callbackNoNames, 0, 0));
     } else
       jsError("Unknown type of callback in Event Queue");
     jsvUnLock(callbackNoNames);
+#ifndef SAVE_ON_FLASH
+    eventCallbackDepth--;
+    if (eventCallbackDepth==0) jsiExecuteMicrotasks();
+#endif
   }
   if (!ok || jspIsInterrupted() || jsiTimeSinceCtrlC<CTRL_C_TIME_FOR_BREAK) {
     interruptedDuringEvent = true;
@@ -1742,20 +2034,13 @@ int jsiHandleIOEventForUSART(JsVar *usartClass, IOEvent *event) {
     JsvStringIterator it;
     jsvStringIteratorNew(&it, stringData, 0);
 
+    char charMask = (char)((1<<bytesize)-1);
     int i, chars = IOEVENTFLAGS_GETCHARS(event->flags);
-    while (chars) {
-      for (i=0;i<chars;i++) {
-        char ch = (char)(event->data.chars[i] & ((1<<bytesize)-1)); // mask
-        jsvStringIteratorAppend(&it, ch);
-      }
-      // look down the stack and see if there is more data
-      if (jshIsTopEvent(IOEVENTFLAGS_GETTYPE(event->flags))) {
-        jshPopIOEvent(event);
-        eventsHandled++;
-        chars = IOEVENTFLAGS_GETCHARS(event->flags);
-      } else
-        chars = 0;
-    }
+    for (i=0;i<chars;i++)
+      jsvStringIteratorAppend(&it, (char)(event->data.chars[i] & charMask));
+    // coalesce any more data for this device straight off the ring buffer,
+    // so a burst of input becomes one callback rather than one per event
+    eventsHandled += jshPopIOEventsAppendToString(IOEVENTFLAGS_GETTYPE(event->flags), &it, charMask);
     jsvStringIteratorFree(&it);
 
     // Now run the handler
@@ -1766,12 +2051,250 @@ int jsiHandleIOEventForUSART(JsVar *usartClass, IOEvent *event) {
 }
 
 void jsiHandleIOEventForConsole(IOEvent *event) {
-  int i, c = IOEVENTFLAGS_GETCHARS(event->flags);
+  int i = 0, c = IOEVENTFLAGS_GETCHARS(event->flags);
   jsiSetBusy(BUSY_INTERACTIVE, true);
-  for (i=0;i<c;i++) jsiHandleChar(event->data.chars[i]);
+  while (i<c) {
+    char ch = event->data.chars[i];
+#ifndef SAVE_ON_FLASH
+    if (ch>=32 && ch!=0x7F && ch!='\t' && inputState==IS_NONE && !jsiPasswordProtected()) {
+      /* A run of plain characters - eg. a paste. Gather as much as possible,
+       * including any further console events waiting in the IO buffer, and
+       * add it to the input line in one go (with one echo) rather than
+       * bouncing through jsiHandleChar once per character. */
+      char buf[80];
+      size_t len = 0;
+      do {
+        buf[len++] = ch;
+        if (++i >= c) { // this event is used up - is another one queued right behind?
+          if (!jshIsTopEvent(IOEVENTFLAGS_GETTYPE(event->flags))) break;
+          jshPopIOEvent(event);
+          c = IOEVENTFLAGS_GETCHARS(event->flags);
+          i = 0;
+          if (i>=c) break;
+        }
+        ch = event->data.chars[i];
+      } while (ch>=32 && ch!=0x7F && ch!='\t' && len<sizeof(buf)-1);
+      buf[len] = 0;
+      jsiAppendStringToInputLine(buf);
+      continue;
+    }
+#endif
+    jsiHandleChar(ch);
+    i++;
+  }
   jsiSetBusy(BUSY_INTERACTIVE, false);
 }
 
+#ifndef SAVE_ON_FLASH
+/** IRQ-side half of a utility-timer-backed interval (see jsiFastTimerStart).
+ * Just queue a priority event with the slot index in the spare flag bits -
+ * the JS callback runs from the idle loop as soon as the event is seen,
+ * without waiting on the timer array bookkeeping below. */
+static void jsiFastTimerIRQ(JsSysTime time, void *userdata) {
+  jshPushIOPriorityEvent((IOEventFlags)(EV_FASTTIMER | ((unsigned int)(size_t)userdata << EV_CHARS_SHIFT)), time);
+}
+
+bool jsiFastTimerStart(JsVar *timerPtr, JsVarInt timerId, JsSysTime interval) {
+  int slot;
+  for (slot=0;slot<JSI_FASTTIMERS;slot++)
+    if (jsiFastTimerIds[slot]<0) break;
+  if (slot==JSI_FASTTIMERS) return false;
+  if (interval<1) interval=1;
+  if (interval>0xFFFFFFFFLL) return false; // task periods are 32 bit - but we only route short intervals anyway
+  if (!jstExecuteFn(jsiFastTimerIRQ, (void*)(size_t)slot, jshGetSystemTimeFast()+interval, (uint32_t)interval))
+    return false; // no free timer tasks
+  jsiFastTimerIds[slot] = timerId;
+  jsvObjectSetChildAndUnLock(timerPtr, "fast", jsvNewFromBool(true));
+  return true;
+}
+
+void jsiFastTimerStop(JsVarInt timerId) {
+  int slot;
+  for (slot=0;slot<JSI_FASTTIMERS;slot++)
+    if (jsiFastTimerIds[slot]==timerId) {
+      jstStopExecuteFn(jsiFastTimerIRQ, (void*)(size_t)slot);
+      jsiFastTimerIds[slot] = -1;
+    }
+}
+
+void jsiFastTimerStopAll() {
+  int slot;
+  for (slot=0;slot<JSI_FASTTIMERS;slot++)
+    if (jsiFastTimerIds[slot]>=0) {
+      jstStopExecuteFn(jsiFastTimerIRQ, (void*)(size_t)slot);
+      jsiFastTimerIds[slot] = -1;
+    }
+}
+
+/** An EV_FASTTIMER event - a utility-timer-backed interval fired in the IRQ.
+ * Just run the callback: the deadline lives in the utility timer task, which
+ * reschedules by adding the period to the *scheduled* time (not the time we
+ * got around to running), so jitter here never accumulates into drift. */
+static void jsiFastTimerHandleEvent(IOEvent *event) {
+  unsigned int slot = ((unsigned int)event->flags >> EV_CHARS_SHIFT) & (JSI_FASTTIMERS-1);
+  JsVarInt timerId = jsiFastTimerIds[slot];
+  if (timerId<0) return; // cleared after this event was queued
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsVar *timerPtr = jsvGetArrayItem(timerArrayPtr, timerId);
+  if (timerPtr) {
+    JsVar *timerCallback = jsiGetObjectCallback(timerPtr, "callback");
+    JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
+    bool execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
+    jsvUnLock2(argsArray, timerCallback);
+    if (!execResult) {
+      jsError("Ctrl-C while processing interval - removing it.");
+      jsErrorFlags |= JSERR_CALLBACK;
+      jsiFastTimerStop(timerId);
+      JsVar *idVar = jsvNewFromInteger(timerId);
+      JsVar *child = jsvFindChildFromVar(timerArrayPtr, idVar, false);
+      if (child) {
+        jsvRemoveChild(timerArrayPtr, child);
+        jsvUnLock(child);
+      }
+      jsvUnLock(idVar);
+    }
+    jsvUnLock(timerPtr);
+  } else {
+    // the timer went away without clearInterval telling us - stop the task
+    jsiFastTimerStop(timerId);
+  }
+  jsvUnLock(timerArrayPtr);
+}
+#endif // SAVE_ON_FLASH
+
+/** Walk the timer array, executing any timers that are due and updating the
+ * time left on the rest. Returns the time from jsiLastIdleTime until the next
+ * timer fires (JSSYSTIME_MAX if there are none). timePassed is how long it has
+ * been since the timers were last checked. */
+static JsSysTime jsiCheckTimers(JsSysTime timePassed, bool *wasBusy) {
+  JsSysTime minTimeUntilNext = JSSYSTIME_MAX;
+  jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it) && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
+    bool hasDeletedTimer = false;
+    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+#ifndef SAVE_ON_FLASH
+    /* Utility-timer-backed intervals (see jsiFastTimerStart) fire via
+     * priority events, not from here - leave their bookkeeping alone */
+    if (jsvGetBoolAndUnLock(jsvObjectGetChild(timerPtr, "fast", 0))) {
+      jsvUnLock(timerPtr);
+      jsvObjectIteratorNext(&it);
+      continue;
+    }
+#endif
+    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
+    JsSysTime timeUntilNext = timerTime - timePassed;
+    bool timerDue = timeUntilNext<=0;
+#ifndef SAVE_ON_FLASH
+    if (!timerDue) {
+      /* Timers given slack (E.setTimerSlack) may fire early, so timers with
+       * near-simultaneous deadlines get handled in a single wakeup. We're
+       * awake right now, so anything within its slack is fair game - but a
+       * slack timer on its own never causes an early wakeup (see below,
+       * minTimeUntilNext still uses the nominal deadline). */
+      JsVar *slack = jsvObjectGetChild(timerPtr, "slack", 0);
+      if (slack) {
+        timerDue = timeUntilNext <= (JsSysTime)jsvGetLongInteger(slack);
+        jsvUnLock(slack);
+      }
+    }
+#endif
+
+    if (timerDue) {
+      // we're now doing work
+      jsiSetBusy(BUSY_INTERACTIVE, true);
+      *wasBusy = true;
+      JsVar *timerCallback = jsiGetObjectCallback(timerPtr, "callback");
+      JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0); // for debounce - may be undefined
+      bool exec = true;
+      JsVar *data = 0;
+      if (watchPtr) {
+        data = jsvNewObject();
+        // if we were from a watch then we were delayed by the debounce time...
+        if (data) {
+          JsVarInt delay = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
+          // Create the 'time' variable that will be passed to the user
+          JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(jsiLastIdleTime+timeUntilNext-delay)/1000);
+          // if it was a watch, set the last state up
+          bool state = jsvGetBoolAndUnLock(jsvObjectSetChild(data, "state", jsvObjectGetChild(watchPtr, "state", 0)));
+          exec = jsiShouldExecuteWatch(watchPtr, state);
+          // set up the lastTime variable of data to what was in the watch
+          jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
+          // set up the watches lastTime to this one
+          jsvObjectSetChild(watchPtr, "lastTime", timePtr); // don't unlock
+          jsvObjectSetChildAndUnLock(data, "time", timePtr);
+        }
+      }
+      JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
+      if (exec) {
+        bool execResult;
+        if (data) {
+          execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
+        } else {
+          JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
+          execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
+          jsvUnLock(argsArray);
+        }
+        if (!execResult && interval) {
+          jsError("Ctrl-C while processing interval - removing it.");
+          jsErrorFlags |= JSERR_CALLBACK;
+          // by setting interval to 0, we now think we've for a Timeout,
+          // which will get removed.
+          jsvUnLock(interval);
+          interval = 0;
+        }
+      }
+      jsvUnLock(data);
+      if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
+        jsvObjectRemoveChild(watchPtr, "timeout");
+        // Deal with non-recurring watches
+        if (exec) {
+          bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
+          if (!watchRecurring) {
+            JsVar *watchArrayPtr = jsvLock(watchArray);
+            JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
+            if (watchNamePtr) {
+              jsvRemoveChild(watchArrayPtr, watchNamePtr);
+              jsvUnLock(watchNamePtr);
+            }
+            jsvUnLock(watchArrayPtr);
+            Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+            if (!jsiIsWatchingPin(pin))
+              jshPinWatch(pin, false);
+          }
+        }
+        jsvUnLock(watchPtr);
+      }
+
+      if (interval) {
+        timeUntilNext = timeUntilNext + jsvGetLongIntegerAndUnLock(interval);
+      } else {
+        // free
+        // Beware... may have already been removed!
+        jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
+        hasDeletedTimer = true;
+        timeUntilNext = -1;
+      }
+      jsvUnLock(timerCallback);
+
+    }
+    // update the time until the next timer
+    if (timeUntilNext>=0 && timeUntilNext < minTimeUntilNext)
+      minTimeUntilNext = timeUntilNext;
+    // update the timer's time
+    if (!hasDeletedTimer) {
+      jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timeUntilNext));
+      jsvObjectIteratorNext(&it);
+    }
+    jsvUnLock(timerPtr);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(timerArrayPtr);
+  return minTimeUntilNext;
+}
+
 void jsiIdle() {
   // This is how many times we have been here and not done anything.
   // It will be zeroed if we do stuff later
@@ -1784,6 +2307,36 @@ void jsiIdle() {
   // Just process what was in the event queue at the start
   int maxEvents = jshGetEventsUsed();
 
+#ifndef SAVE_ON_FLASH
+  /* Tell anyone who cares that the IO buffer filled past the stop watermark
+   * (checked before we drain it) - a chance to back off before data is lost */
+  if (!jsiIOFullNotified) {
+    if (maxEvents > jshIOBufferXOff) {
+      jsiIOFullNotified = true;
+      JsVar *E = jsvObjectGetChild(execInfo.root, "E", 0);
+      if (E) {
+        jsiQueueObjectCallbacks(E, JS_EVENT_PREFIX"ioFull", NULL, 0);
+        jsvUnLock(E);
+      }
+    }
+  } else if (maxEvents < jshIOBufferXOn)
+    jsiIOFullNotified = false; // buffer drained - re-arm the notification
+
+  /* Same idea for the utility timer's task queue (digitalPulse/Waveform/
+   * PWM etc) - when it fills, callers block or give up silently, so tell JS */
+  if (!jsiTimerFullNotified) {
+    if (jstUtilTimerOverflowed()) {
+      jsiTimerFullNotified = true;
+      JsVar *E = jsvObjectGetChild(execInfo.root, "E", 0);
+      if (E) {
+        jsiQueueObjectCallbacks(E, JS_EVENT_PREFIX"timerFull", NULL, 0);
+        jsvUnLock(E);
+      }
+    }
+  } else if (jstGetUtilTimerTasksUsed() < UTILTIMERTASK_TASKS/2)
+    jsiTimerFullNotified = false; // queue drained - re-arm the notification
+#endif
+
   while ((maxEvents--)>0 && jshPopIOEvent(&event)) {
     jsiSetBusy(BUSY_INTERACTIVE, true);
     wasBusy = true;
@@ -1815,6 +2368,10 @@ void jsiIdle() {
 #ifdef BLUETOOTH
     } else if (eventType == EV_BLUETOOTH_PENDING) {
       jsble_exec_pending(&event);
+#endif
+#ifndef SAVE_ON_FLASH
+    } else if (eventType == EV_FASTTIMER) { // --------------------------------------------------- UTILITY TIMER INTERVAL
+      jsiFastTimerHandleEvent(&event);
 #endif
     } else if (DEVICE_IS_EXTI(eventType)) { // ---------------------------------------------------------------- PIN WATCH
       // we have an event... find out what it was for...
@@ -1844,6 +2401,50 @@ void jsiIdle() {
 
           // Now actually process the event
           bool pinIsHigh = (event.flags&EV_EXTI_IS_HIGH)!=0;
+#ifndef SAVE_ON_FLASH
+          // edges counted in the IRQ since this event was queued (setWatch aggregate option)
+          int aggregatedEdges = jshGetEventAggregateCount(IOEVENTFLAGS_GETTYPE(event.flags));
+
+          JsVar *captureArr = jsvObjectGetChild(watchPtr, "capture", 0);
+          if (captureArr) {
+            /* Watch is in capture mode (setWatch's capture option). The IRQ
+             * has been recording edge-to-edge times straight into the array,
+             * and this event just means 'flush' - either the buffer filled or
+             * the line went quiet. The callback gets the count of valid
+             * entries; the array itself is reused for the next burst. */
+            int capturedEdges = jshGetEventCaptureCount(IOEVENTFLAGS_GETTYPE(event.flags));
+            if (capturedEdges > 0) {
+              JsVar *watchCallback = jsiGetObjectCallback(watchPtr, "callback");
+              bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
+              JsVar *data = jsvNewObject();
+              if (data) {
+                jsvObjectSetChildAndUnLock(data, "time", jsvNewFromFloat(jshGetMillisecondsFromTime(eventTime)/1000));
+                jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
+                jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
+                jsvObjectSetChildAndUnLock(data, "count", jsvNewFromInteger(capturedEdges));
+                jsvObjectSetChild(data, "data", captureArr); // no unlock
+              }
+              if (!jsiExecuteEventCallback(0, watchCallback, 1, &data) && watchRecurring) {
+                jsError("Ctrl-C while processing watch - removing it.");
+                jsErrorFlags |= JSERR_CALLBACK;
+                watchRecurring = false;
+              }
+              jsvUnLock(data);
+              if (!watchRecurring) {
+                jshSetEventCapture(IOEVENTFLAGS_GETTYPE(event.flags), 0, 0, 0);
+                jsvObjectIteratorRemoveAndGotoNext(&it, watchArrayPtr);
+                hasDeletedWatch = true;
+                if (!jsiIsWatchingPin(pin))
+                  jshPinWatch(pin, false);
+              }
+              jsvUnLock(watchCallback);
+            }
+            jsvUnLock2(captureArr, watchPtr);
+            if (!hasDeletedWatch)
+              jsvObjectIteratorNext(&it);
+            continue;
+          }
+#endif
 
           bool executeNow = false;
           JsVarInt debounce = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
@@ -1858,6 +2459,7 @@ void jsiIdle() {
             if (timeout) { // if we had a timeout, update the callback time
               JsSysTime timeoutTime = jsiLastIdleTime + (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timeout, "time", 0));
               jsvUnLock(jsvObjectSetChild(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce)));
+              jsiTimersChanged();
               if (eventTime > timeoutTime) {
                 // timeout should have fired, but we didn't get around to executing it!
                 // Do it now (with the old timeout time)
@@ -1875,6 +2477,7 @@ void jsiIdle() {
                 jsvObjectSetChildAndUnLock(timeout, "pin", jsvNewFromPin(pin));
                 // Add to timer array
                 jsiTimerAdd(timeout);
+                jsiTimersChanged();
                 // Add to our watch
                 jsvObjectSetChild(watchPtr, "timeout", timeout); // no unlock
               }
@@ -1886,7 +2489,7 @@ void jsiIdle() {
           if (executeNow) {
             JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(eventTime)/1000);
             if (jsiShouldExecuteWatch(watchPtr, pinIsHigh)) { // edge triggering
-              JsVar *watchCallback = jsvObjectGetChild(watchPtr, "callback", 0);
+              JsVar *watchCallback = jsiGetObjectCallback(watchPtr, "callback");
               bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
               JsVar *data = jsvNewObject();
               if (data) {
@@ -1895,6 +2498,10 @@ void jsiIdle() {
                 jsvObjectSetChild(data, "time", timePtr); // no unlock
                 jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
                 jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
+#ifndef SAVE_ON_FLASH
+                if (aggregatedEdges)
+                  jsvObjectSetChildAndUnLock(data, "count", jsvNewFromInteger(aggregatedEdges));
+#endif
               }
               if (!jsiExecuteEventCallback(0, watchCallback, 1, &data) && watchRecurring) {
                 jsError("Ctrl-C while processing watch - removing it.");
@@ -1924,8 +2531,18 @@ void jsiIdle() {
     }
   }
 
+#ifndef SAVE_ON_FLASH
+  /* Edge capture (setWatch's capture option): if a capture buffer has edges
+   * in it and its line has gone quiet, queue a flush event for the channel.
+   * It's then dispatched exactly like the buffer-full flush above. */
+  IOEventFlags captureChannel = jshGetEventCaptureIdleFlush(jshGetSystemTimeFast());
+  if (captureChannel != EV_NONE)
+    jshPushIOEvent(captureChannel | (jshGetWatchedPinState(captureChannel)?EV_EXTI_IS_HIGH:0),
+                   jshGetSystemTimeFast());
+#endif
+
   // Reset Flow control if it was set...
-  if (jshGetEventsUsed() < IOBUFFER_XON) {
+  if (jshGetEventsUsed() < jshIOBufferXOn) {
     jshSetFlowControlXON(EV_USBSERIAL, true);
     int i;
     for (i=0;i<USART_COUNT;i++)
@@ -1934,8 +2551,35 @@ void jsiIdle() {
 
   // Check timers
   JsSysTime minTimeUntilNext = JSSYSTIME_MAX;
-  JsSysTime time = jshGetSystemTime();
+  // idle timestamp maths only ever uses deltas from here, so the fast/raw
+  // time read is fine (and this is the hottest time query in the interpreter)
+  JsSysTime time = jshGetSystemTimeFast();
   JsSysTime timePassed = time - jsiLastIdleTime;
+#ifndef SAVE_ON_FLASH
+  if (!(jsiStatus & JSIS_TIMERS_CHANGED) && timePassed < jsiNextTimerTime) {
+    /* No timer is due yet and none were added/removed/changed since the last
+     * walk, so leave the timer array alone. Timers store their fire time
+     * relative to jsiLastIdleTime so that must stay put too - just keep the
+     * Ctrl-C counter fed with however much time we haven't counted yet. */
+    minTimeUntilNext = jsiNextTimerTime - timePassed;
+    uint32_t oldTimeSinceCtrlC = jsiTimeSinceCtrlC;
+    jsiTimeSinceCtrlC += (uint32_t)(timePassed - jsiSkippedTimeCounted);
+    if (oldTimeSinceCtrlC > jsiTimeSinceCtrlC)
+      jsiTimeSinceCtrlC = 0xFFFFFFFF;
+    jsiSkippedTimeCounted = timePassed;
+  } else {
+    jsiLastIdleTime = time;
+    // add time to Ctrl-C counter, checking for overflow
+    uint32_t oldTimeSinceCtrlC = jsiTimeSinceCtrlC;
+    jsiTimeSinceCtrlC += (uint32_t)(timePassed - jsiSkippedTimeCounted);
+    if (oldTimeSinceCtrlC > jsiTimeSinceCtrlC)
+      jsiTimeSinceCtrlC = 0xFFFFFFFF;
+    jsiSkippedTimeCounted = 0;
+
+    minTimeUntilNext = jsiCheckTimers(timePassed, &wasBusy);
+    jsiNextTimerTime = minTimeUntilNext;
+  }
+#else
   jsiLastIdleTime = time;
   // add time to Ctrl-C counter, checking for overflow
   uint32_t oldTimeSinceCtrlC = jsiTimeSinceCtrlC;
@@ -1943,106 +2587,8 @@ void jsiIdle() {
   if (oldTimeSinceCtrlC > jsiTimeSinceCtrlC)
     jsiTimeSinceCtrlC = 0xFFFFFFFF;
 
-  jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
-  JsVar *timerArrayPtr = jsvLock(timerArray);
-  JsvObjectIterator it;
-  jsvObjectIteratorNew(&it, timerArrayPtr);
-  while (jsvObjectIteratorHasValue(&it) && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
-    bool hasDeletedTimer = false;
-    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
-    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
-    JsSysTime timeUntilNext = timerTime - timePassed;
-
-    if (timeUntilNext<=0) {
-      // we're now doing work
-      jsiSetBusy(BUSY_INTERACTIVE, true);
-      wasBusy = true;
-      JsVar *timerCallback = jsvObjectGetChild(timerPtr, "callback", 0);
-      JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0); // for debounce - may be undefined
-      bool exec = true;
-      JsVar *data = 0;
-      if (watchPtr) {
-        data = jsvNewObject();
-        // if we were from a watch then we were delayed by the debounce time...
-        if (data) {
-          JsVarInt delay = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
-          // Create the 'time' variable that will be passed to the user
-          JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(jsiLastIdleTime+timeUntilNext-delay)/1000);
-          // if it was a watch, set the last state up
-          bool state = jsvGetBoolAndUnLock(jsvObjectSetChild(data, "state", jsvObjectGetChild(watchPtr, "state", 0)));
-          exec = jsiShouldExecuteWatch(watchPtr, state);
-          // set up the lastTime variable of data to what was in the watch
-          jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-          // set up the watches lastTime to this one
-          jsvObjectSetChild(watchPtr, "lastTime", timePtr); // don't unlock
-          jsvObjectSetChildAndUnLock(data, "time", timePtr);
-        }
-      }
-      JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
-      if (exec) {
-        bool execResult;
-        if (data) {
-          execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
-        } else {
-          JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
-          execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
-          jsvUnLock(argsArray);
-        }
-        if (!execResult && interval) {
-          jsError("Ctrl-C while processing interval - removing it.");
-          jsErrorFlags |= JSERR_CALLBACK;
-          // by setting interval to 0, we now think we've for a Timeout,
-          // which will get removed.
-          jsvUnLock(interval);
-          interval = 0;
-        }
-      }
-      jsvUnLock(data);
-      if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
-        jsvObjectRemoveChild(watchPtr, "timeout");
-        // Deal with non-recurring watches
-        if (exec) {
-          bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
-          if (!watchRecurring) {
-            JsVar *watchArrayPtr = jsvLock(watchArray);
-            JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
-            if (watchNamePtr) {
-              jsvRemoveChild(watchArrayPtr, watchNamePtr);
-              jsvUnLock(watchNamePtr);
-            }
-            jsvUnLock(watchArrayPtr);
-            Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
-            if (!jsiIsWatchingPin(pin))
-              jshPinWatch(pin, false);
-          }
-        }
-        jsvUnLock(watchPtr);
-      }
-
-      if (interval) {
-        timeUntilNext = timeUntilNext + jsvGetLongIntegerAndUnLock(interval);
-      } else {
-        // free
-        // Beware... may have already been removed!
-        jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
-        hasDeletedTimer = true;
-        timeUntilNext = -1;
-      }
-      jsvUnLock(timerCallback);
-
-    }
-    // update the time until the next timer
-    if (timeUntilNext>=0 && timeUntilNext < minTimeUntilNext)
-      minTimeUntilNext = timeUntilNext;
-    // update the timer's time
-    if (!hasDeletedTimer) {
-      jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timeUntilNext));
-      jsvObjectIteratorNext(&it);
-    }
-    jsvUnLock(timerPtr);
-  }
-  jsvObjectIteratorFree(&it);
-  jsvUnLock(timerArrayPtr);
+  minTimeUntilNext = jsiCheckTimers(timePassed, &wasBusy);
+#endif
   /* We might have left the timers loop with stuff to do because the contents of it
    * changed. It's not a big deal because it could only have changed because a timer
    * got executed - so `wasBusy` got set and we know we're going to go around the
@@ -2062,6 +2608,10 @@ void jsiIdle() {
   // execute any outstanding events
   if (!jspIsInterrupted()) {
     jsiExecuteEvents();
+#ifndef SAVE_ON_FLASH
+    jsiExecuteMicrotasks(); // promises resolved outside an event callback (eg. at the console)
+    jshTransmitFlatStringIdle(); // unlock any flat strings that finished transmitting
+#endif
   }
 
   // check for TODOs
@@ -2078,12 +2628,15 @@ void jsiIdle() {
       jsiSemiInit(false); // don't autoload
     }
     if ((s&JSIS_TODO_FLASH_SAVE) == JSIS_TODO_FLASH_SAVE) {
-      jsiStatus &= (JsiStatus)~JSIS_TODO_FLASH_SAVE;
+      JsvSaveFlashFlags saveFlags = SFF_SAVE_STATE;
+      if (s & JSIS_SAVE_FUNCTIONS_TO_FLASH) saveFlags |= SFF_FUNCTIONS_TO_FLASH;
+      if (s & JSIS_SAVE_RAW) saveFlags |= SFF_SAVE_RAW;
+      jsiStatus &= (JsiStatus)~(JSIS_TODO_FLASH_SAVE|JSIS_SAVE_FUNCTIONS_TO_FLASH|JSIS_SAVE_RAW);
       jsvGarbageCollect(); // nice to have everything all tidy!
       jsiSoftKill();
       jspSoftKill();
       jsvSoftKill();
-      jsfSaveToFlash(SFF_SAVE_STATE, 0);
+      jsfSaveToFlash(saveFlags, 0);
       jshReset();
       jsvSoftInit();
       jspSoftInit();
@@ -2129,7 +2682,18 @@ void jsiIdle() {
       !jshHasEvents() && //no events have arrived in the mean time
       !jshHasTransmitData()/* && //nothing left to send over serial?
       minTimeUntilNext > SYSTICK_RANGE*5/4*/) { // we are sure we won't miss anything - leave a little leeway (SysTick will wake us up!)
-    jshSleep(minTimeUntilNext);
+    /* Consolidate every wakeup deadline into one: JS timers
+     * (minTimeUntilNext) and pending utility timer tasks (digitalPulse,
+     * Waveform, etc), so jshSleep sees the true earliest deadline and can
+     * pick the deepest sleep that still meets it. */
+    JsSysTime wakeUpTime = minTimeUntilNext;
+    JsSysTime taskTime;
+    if (jstGetNextTaskTime(&taskTime)) {
+      JsSysTime timeUntilTask = taskTime - jshGetSystemTimeFast();
+      if (timeUntilTask < wakeUpTime)
+        wakeUpTime = (timeUntilTask > 0) ? timeUntilTask : 0;
+    }
+    jshSleep(wakeUpTime);
   }
 }
 
@@ -47,6 +47,14 @@ void jsiCtrlC(); // Ctrl-C - force interrupt of execution
 
 /// Queue a function, string, or array (of funcs/strings) to be executed next time around the idle loop
 void jsiQueueEvents(JsVar *object, JsVar *callback, JsVar **args, int argCount);
+#ifndef SAVE_ON_FLASH
+/// Queue a microtask (eg. a promise reaction) - runs after the current event callback, before any queued events
+void jsiQueueMicrotask(JsVar *object, JsVar *callback, JsVar *arg);
+/// Queue a promise resolve/reject as a microtask (a compact jsiQueueMicrotask - see jspromise_runReaction)
+void jsiQueuePromiseReaction(JsVar *promise, JsVar *arg, bool resolve);
+#endif
+/// Get the callback with the given name (must be a static string) from an object - a cached jsvObjectGetChild for event dispatch
+JsVar *jsiGetObjectCallback(JsVar *object, const char *callbackName);
 /// Return true if the object has callbacks...
 bool jsiObjectHasCallbacks(JsVar *object, const char *callbackName);
 /// Queue up callbacks for other things (touchscreen? network?)
@@ -58,6 +66,21 @@ bool jsiExecuteEventCallback(JsVar *thisVar, JsVar *callbackVar, unsigned int ar
 /// Same as above, but with a JsVarArray (this calls jsiExecuteEventCallback, so use jsiExecuteEventCallback where possible)
 bool jsiExecuteEventCallbackArgsArray(JsVar *thisVar, JsVar *callbackVar, JsVar *argsArray);
 
+#ifndef SAVE_ON_FLASH
+/// Slow-callback tracing - see E.setSlowCallbackThreshold
+typedef struct {
+  JsVarRef ref;    ///< ref of the callback function (0 = empty slot)
+  JsSysTime worst; ///< longest run seen
+  uint32_t count;  ///< how many times it overran the threshold
+} JsiSlowCallback;
+#define JSI_SLOW_CALLBACKS 8
+/// Callbacks running longer than this get recorded and fire E's 'slowCallback' event (0 = tracing off)
+extern JsSysTime jsiSlowCallbackThreshold;
+extern JsiSlowCallback jsiSlowCallbacks[JSI_SLOW_CALLBACKS];
+/// Zero the slow-callback table
+void jsiSlowCallbacksReset();
+#endif
+
 
 IOEventFlags jsiGetDeviceFromClass(JsVar *deviceClass);
 JsVar *jsiGetClassNameFromDevice(IOEventFlags device);
@@ -144,6 +167,8 @@ typedef enum {
   JSIS_WATCHDOG_AUTO      = 1<<9, ///< Automatically kick the watchdog timer on idle
   JSIS_PASSWORD_PROTECTED = 1<<10, ///< Password protected
   JSIS_COMPLETELY_RESET   = 1<<11, ///< Has the board powered on, having not loaded anything from flash
+  JSIS_SAVE_FUNCTIONS_TO_FLASH = 1<<12, ///< when the save TODO is handled, also move function code into flash (see save())
+  JSIS_SAVE_RAW           = 1<<13, ///< when the save TODO is handled, store the state uncompressed for a faster boot (see save())
 
   JSIS_ECHO_OFF_MASK = JSIS_ECHO_OFF|JSIS_ECHO_OFF_FOR_LINE,
   JSIS_SOFTINIT_MASK = JSIS_PASSWORD_PROTECTED // stuff that DOESN'T get reset on softinit
@@ -166,6 +191,18 @@ extern JsVarRef watchArray; // Linked List of input watches to check and run
 
 extern JsVarInt jsiTimerAdd(JsVar *timerPtr);
 extern void jsiTimersChanged(); // Flag timers changed so we can skip out of the loop if needed
+#ifndef SAVE_ON_FLASH
+#define TIMER_FAST_INTERVAL 2 // intervals below this (in milliseconds) get routed to the utility timer
+/** Route an interval to the utility timer - it'll fire from the timer IRQ and
+ * queue its callback as a priority event (see EV_FASTTIMER), so short periods
+ * don't depend on the idle loop's timer bookkeeping. Returns false if there's
+ * no free slot/timer task - the caller leaves it on the ordinary timer path */
+bool jsiFastTimerStart(JsVar *timerPtr, JsVarInt timerId, JsSysTime interval);
+/// Stop a utility-timer-backed interval (a no-op if this id isn't routed)
+void jsiFastTimerStop(JsVarInt timerId);
+/// Stop all utility-timer-backed intervals (clearInterval with no argument)
+void jsiFastTimerStopAll();
+#endif
 // end for jswrap_interactive/io.c ------------------------------------------------
 
 #ifdef USE_DEBUGGER
@@ -12,9 +12,14 @@
  * ----------------------------------------------------------------------------
  */
 #include "jslex.h"
+#include "jslex_keywords.h"
 
 JsLex *lex;
 
+#ifndef SAVE_ON_FLASH
+volatile uint32_t jslOpTokenCount = 0;
+#endif
+
 JsLex *jslSetLex(JsLex *l) {
   JsLex *old = lex;
   lex = l;
@@ -38,7 +43,7 @@ static ALWAYS_INLINE char jslNextCh() {
 }
 
 /// Move on to the next character
-static void NO_INLINE jslGetNextCh() {
+static void NO_INLINE HOT_FUNCTION jslGetNextCh() {
   lex->currCh = jslNextCh();
 
   /** NOTE: In this next bit, we DON'T LOCK OR UNLOCK.
@@ -70,16 +75,6 @@ static ALWAYS_INLINE void jslTokenAppendChar(char ch) {
   }
 }
 
-static bool jslIsToken(const char *token, int startOffset) {
-  int i;
-  for (i=startOffset;i<lex->tokenl;i++) {
-    if (lex->token[i]!=token[i]) return false;
-    // if token is smaller than lex->token, there will be a null char
-    // which will be different from the token
-  }
-  return token[lex->tokenl] == 0; // only match if token ends now
-}
-
 typedef enum {
   JSLJT_ID,
   JSLJT_NUMBER,
@@ -332,7 +327,10 @@ static void jslLexRegex() {
   jsvStringIteratorFree(&it);
 }
 
-void jslGetNextToken() {
+HOT_FUNCTION void jslGetNextToken() {
+#ifndef SAVE_ON_FLASH
+  jslOpTokenCount++; // before the label - comment skips restart here, but consume one token
+#endif
   jslGetNextToken_start:
   // Skip whitespace
   while (isWhitespace(lex->currCh))
@@ -379,6 +377,42 @@ void jslGetNextToken() {
       ((unsigned char)lex->currCh) > jslJumpTableEnd) {
     // if unhandled by the jump table, just pass it through as a single character
     jslSingleChar();
+    if (lex->tk>=_LEX_RAW_START && lex->tk<=_LEX_RAW_END) {
+      // a raw literal in a tokenised string - decode it back into a normal token
+      if (lex->tk==LEX_RAW_STRING8 || lex->tk==LEX_RAW_STRING16) {
+        size_t length = (unsigned char)lex->currCh;
+        jslGetNextCh();
+        if (lex->tk==LEX_RAW_STRING16) {
+          length |= ((size_t)(unsigned char)lex->currCh)<<8;
+          jslGetNextCh();
+        }
+        lex->tokenValue = jsvNewFromEmptyString();
+        if (lex->tokenValue) {
+          JsvStringIterator it;
+          jsvStringIteratorNew(&it, lex->tokenValue, 0);
+          while (length--) {
+            jsvStringIteratorAppend(&it, lex->currCh);
+            jslGetNextCh();
+          }
+          jsvStringIteratorFree(&it);
+        } else { // out of memory - just skip the data
+          while (length--) jslGetNextCh();
+        }
+        lex->tk = LEX_STR;
+      } else { // LEX_RAW_INT8/16/32
+        int bytes = (lex->tk==LEX_RAW_INT8) ? 1 : ((lex->tk==LEX_RAW_INT16) ? 2 : 4);
+        uint32_t value = 0;
+        int shift = 0;
+        while (bytes--) {
+          value |= ((uint32_t)(unsigned char)lex->currCh) << shift;
+          shift += 8;
+          jslGetNextCh();
+        }
+        itostr((JsVarInt)value, lex->token, 10);
+        lex->tokenl = (unsigned char)strlen(lex->token);
+        lex->tk = LEX_INT;
+      }
+    }
   } else {
     switch(jslJumpTable[((unsigned char)lex->currCh) - jslJumpTableStart]) {
     case JSLJT_ID: {
@@ -387,54 +421,11 @@ void jslGetNextToken() {
         jslGetNextCh();
       }
       lex->tk = LEX_ID;
-      // We do fancy stuff here to reduce number of compares (hopefully GCC creates a jump table)
-      switch (lex->token[0]) {
-      case 'b': if (jslIsToken("break", 1)) lex->tk = LEX_R_BREAK;
-      break;
-      case 'c': if (jslIsToken("case", 1)) lex->tk = LEX_R_CASE;
-      else if (jslIsToken("catch", 1)) lex->tk = LEX_R_CATCH;
-      else if (jslIsToken("const", 1)) lex->tk = LEX_R_CONST;
-      else if (jslIsToken("continue", 1)) lex->tk = LEX_R_CONTINUE;
-      break;
-      case 'd': if (jslIsToken("default", 1)) lex->tk = LEX_R_DEFAULT;
-      else if (jslIsToken("delete", 1)) lex->tk = LEX_R_DELETE;
-      else if (jslIsToken("do", 1)) lex->tk = LEX_R_DO;
-      else if (jslIsToken("debugger", 1)) lex->tk = LEX_R_DEBUGGER;
-      break;
-      case 'e': if (jslIsToken("else", 1)) lex->tk = LEX_R_ELSE;
-      break;
-      case 'f': if (jslIsToken("false", 1)) lex->tk = LEX_R_FALSE;
-      else if (jslIsToken("finally", 1)) lex->tk = LEX_R_FINALLY;
-      else if (jslIsToken("for", 1)) lex->tk = LEX_R_FOR;
-      else if (jslIsToken("function", 1)) lex->tk = LEX_R_FUNCTION;
-      break;
-      case 'i': if (jslIsToken("if", 1)) lex->tk = LEX_R_IF;
-      else if (jslIsToken("in", 1)) lex->tk = LEX_R_IN;
-      else if (jslIsToken("instanceof", 1)) lex->tk = LEX_R_INSTANCEOF;
-      break;
-      case 'l': if (jslIsToken("let", 1)) lex->tk = LEX_R_LET;
-      break;
-      case 'n': if (jslIsToken("new", 1)) lex->tk = LEX_R_NEW;
-      else if (jslIsToken("null", 1)) lex->tk = LEX_R_NULL;
-      break;
-      case 'r': if (jslIsToken("return", 1)) lex->tk = LEX_R_RETURN;
-      break;
-      case 's': if (jslIsToken("switch", 1)) lex->tk = LEX_R_SWITCH;
-      break;
-      case 't': if (jslIsToken("this", 1)) lex->tk = LEX_R_THIS;
-      else if (jslIsToken("throw", 1)) lex->tk = LEX_R_THROW;
-      else if (jslIsToken("true", 1)) lex->tk = LEX_R_TRUE;
-      else if (jslIsToken("try", 1)) lex->tk = LEX_R_TRY;
-      else if (jslIsToken("typeof", 1)) lex->tk = LEX_R_TYPEOF;
-      break;
-      case 'u': if (jslIsToken("undefined", 1)) lex->tk = LEX_R_UNDEFINED;
-      break;
-      case 'w': if (jslIsToken("while", 1)) lex->tk = LEX_R_WHILE;
-      break;
-      case 'v': if (jslIsToken("var", 1)) lex->tk = LEX_R_VAR;
-      else if (jslIsToken("void", 1)) lex->tk = LEX_R_VOID;
-      break;
-      default: break;
+      // single-probe keyword classification (table generated by scripts/build_keywords.py)
+      if (lex->tokenl>1) {
+        const JslKeyword *kw = &jslKeywords[JSLEX_KEYWORD_HASH(lex->token, lex->tokenl)];
+        if (kw->len == lex->tokenl && strncmp(kw->word, lex->token, lex->tokenl)==0)
+          lex->tk = kw->tk;
       } break;
       case JSLJT_NUMBER: {
         // TODO: check numbers aren't the wrong format
@@ -650,6 +641,9 @@ void jslInit(JsVar *var) {
   lex->tokenl = 0;
   lex->tokenValue = 0;
   lex->lineNumberOffset = 0;
+#ifndef SAVE_ON_FLASH
+  memset(lex->blockSkipStart, 0, sizeof(lex->blockSkipStart));
+#endif
   // set up iterator
   jsvStringIteratorNew(&lex->it, lex->sourceVar, 0);
   jsvUnLock(lex->it.var); // see jslGetNextCh
@@ -868,6 +862,245 @@ bool jslMatch(int expected_tk) {
   return true;
 }
 
+/* If the current token is a literal that can be stored in raw form in a
+ * tokenised string (see LEX_RAW_*) return the number of bytes the raw
+ * encoding needs, otherwise return 0 (meaning: copy the source text). */
+static size_t jslRawLiteralLength() {
+  if (lex->tk==LEX_STR && lex->tokenValue) {
+    size_t len = jsvGetStringLength(lex->tokenValue);
+    if (len<256) return 2+len;
+    if (len<65536) return 3+len;
+  } else if (lex->tk==LEX_INT) {
+    long long v = stringToInt(jslGetTokenValueAsString());
+    if (v>=0) {
+      if (v<=0xFF) return 2;
+      if (v<=0xFFFF) return 3;
+      if (v<=0x7FFFFFFF) return 5; // keep within JsVarInt on all platforms
+    }
+  }
+  return 0;
+}
+
+/* Append the current token to a tokenised string in raw literal form.
+ * Must only be called if jslRawLiteralLength returned nonzero. */
+static void jslAppendRawLiteral(JsvStringIterator *dstit) {
+  if (lex->tk==LEX_STR) {
+    size_t len = jsvGetStringLength(lex->tokenValue);
+    if (len<256) {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_STRING8);
+      jsvStringIteratorSetCharAndNext(dstit, (char)len);
+    } else {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_STRING16);
+      jsvStringIteratorSetCharAndNext(dstit, (char)(len&0xFF));
+      jsvStringIteratorSetCharAndNext(dstit, (char)(len>>8));
+    }
+    JsvStringIterator srcit;
+    jsvStringIteratorNew(&srcit, lex->tokenValue, 0);
+    while (jsvStringIteratorHasChar(&srcit)) {
+      jsvStringIteratorSetCharAndNext(dstit, jsvStringIteratorGetChar(&srcit));
+      jsvStringIteratorNext(&srcit);
+    }
+    jsvStringIteratorFree(&srcit);
+  } else { // LEX_INT
+    uint32_t v = (uint32_t)stringToInt(jslGetTokenValueAsString());
+    int bytes;
+    if (v<=0xFF) {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_INT8);
+      bytes = 1;
+    } else if (v<=0xFFFF) {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_INT16);
+      bytes = 2;
+    } else {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_INT32);
+      bytes = 4;
+    }
+    while (bytes--) {
+      jsvStringIteratorSetCharAndNext(dstit, (char)(v&0xFF));
+      v >>= 8;
+    }
+  }
+}
+
+#ifndef SAVE_ON_FLASH
+/* ------------------------------------------------------------- constant folding
+ * When building a tokenised string we fold subexpressions made only of
+ * literals - eg. `2*3.14159/360` or `"deg"+"C"` - down to a single literal,
+ * so the stored code never re-evaluates them. A fold is only attempted where
+ * the previous token guarantees an expression starts (after `(`, `=`, `,`,
+ * `return` etc), and is only kept if the parse stopped on a token that can't
+ * extend the expression, so something like `a-1+2` is never mis-folded. */
+
+static JsVar *jslFoldExpression(int *tokenCount);
+
+/// Parse a literal, a parenthesised constant expression, or unary minus. 0 = not constant
+static JsVar *jslFoldFactor(int *tokenCount) {
+  JsVar *v;
+  if (lex->tk=='(') {
+    jslGetNextToken(); (*tokenCount)++;
+    v = jslFoldExpression(tokenCount);
+    if (v && lex->tk!=')') {
+      jsvUnLock(v);
+      return 0;
+    }
+    if (v) { jslGetNextToken(); (*tokenCount)++; }
+    return v;
+  }
+  if (lex->tk=='-') {
+    jslGetNextToken(); (*tokenCount)++;
+    v = jslFoldFactor(tokenCount);
+    if (v) {
+      JsVar *zero = jsvNewFromInteger(0);
+      JsVar *negated = jsvMathsOp(zero, v, '-');
+      jsvUnLock2(zero, v);
+      v = negated;
+    }
+    return v;
+  }
+  if (lex->tk==LEX_INT) v = jsvNewFromLongInteger(stringToInt(jslGetTokenValueAsString()));
+  else if (lex->tk==LEX_FLOAT) v = jsvNewFromFloat(stringToFloat(jslGetTokenValueAsString()));
+  else if (lex->tk==LEX_STR) v = jslGetTokenValueAsVar();
+  else return 0;
+  jslGetNextToken(); (*tokenCount)++;
+  return v;
+}
+
+static JsVar *jslFoldTerm(int *tokenCount) {
+  JsVar *a = jslFoldFactor(tokenCount);
+  while (a && (lex->tk=='*' || lex->tk=='/' || lex->tk=='%')) {
+    int op = lex->tk;
+    jslGetNextToken(); (*tokenCount)++;
+    JsVar *b = jslFoldFactor(tokenCount);
+    JsVar *r = b ? jsvMathsOp(a, b, op) : 0;
+    jsvUnLock2(a, b);
+    a = r;
+  }
+  return a;
+}
+
+static JsVar *jslFoldExpression(int *tokenCount) {
+  JsVar *a = jslFoldTerm(tokenCount);
+  while (a && (lex->tk=='+' || lex->tk=='-')) {
+    int op = lex->tk;
+    jslGetNextToken(); (*tokenCount)++;
+    JsVar *b = jslFoldTerm(tokenCount);
+    JsVar *r = b ? jsvMathsOp(a, b, op) : 0;
+    jsvUnLock2(a, b);
+    a = r;
+  }
+  return a;
+}
+
+/// Is lastTk a token directly after which an expression must start?
+static bool jslFoldStartsAfter(int lastTk) {
+  return lastTk=='(' || lastTk=='[' || lastTk=='{' || lastTk==',' ||
+         lastTk==';' || lastTk==':' || lastTk=='?' || lastTk=='=' ||
+         lastTk==LEX_R_RETURN || lastTk==LEX_R_CASE || lastTk==LEX_EOF;
+}
+
+/* Try and fold a constant expression starting at the current token. On
+ * success returns the folded literal with the lexer left on the token after
+ * the expression; on failure returns 0 with the lexer rewound. */
+static JsVar *jslFoldConstant(size_t charTo) {
+  JslCharPos start = jslCharPosClone(&lex->tokenStart);
+  int tokenCount = 0;
+  JsVar *v = jslFoldExpression(&tokenCount);
+  bool ok = v!=0 && tokenCount>=3; // a single literal isn't worth re-emitting
+  if (ok) // must have stopped on a token that can't extend the expression
+    ok = lex->tk==')' || lex->tk==',' || lex->tk==';' || lex->tk==']' ||
+         lex->tk=='}' || lex->tk==':' || lex->tk==LEX_EOF;
+  if (ok) // don't run off the end of the region we're tokenising
+    ok = jsvStringIteratorGetIndex(&lex->tokenStart.it)-1 <= charTo;
+  if (ok && jsvIsFloat(v)) {
+    /* only fold floats that survive a text round trip exactly - this also
+     * throws out NaN/Infinity, which would be emitted as identifiers */
+    char buf[32];
+    JsVarFloat f = jsvGetFloat(v);
+    ftoa_bounded(f, buf, sizeof(buf));
+    ok = stringToFloat(buf)==f;
+  }
+  if (ok && jsvIsString(v))
+    ok = jsvGetStringLength(v)<65536; // must fit a raw string literal
+  if (!ok) {
+    jsvUnLock(v);
+    v = 0;
+    jslSeekToP(&start);
+  }
+  jslCharPosFree(&start);
+  return v;
+}
+
+/// How many bytes will jslAppendFoldedLiteral write for this literal?
+static size_t jslFoldedLiteralLength(JsVar *v) {
+  char buf[32];
+  if (jsvIsString(v)) {
+    size_t len = jsvGetStringLength(v);
+    return (len<256) ? 2+len : 3+len;
+  }
+  if (jsvIsInt(v)) {
+    JsVarInt i = jsvGetInteger(v);
+    if (i>=0 && i<=0x7FFFFFFF) {
+      if (i<=0xFF) return 2;
+      if (i<=0xFFFF) return 3;
+      return 5;
+    }
+    itostr(i, buf, 10); // negative - emit as text, which lexes back fine
+  } else
+    ftoa_bounded(jsvGetFloat(v), buf, sizeof(buf));
+  return strlen(buf);
+}
+
+/// Append a folded literal to a tokenised string, mirroring jslAppendRawLiteral
+static void jslAppendFoldedLiteral(JsVar *v, JsvStringIterator *dstit) {
+  char buf[32];
+  if (jsvIsString(v)) {
+    size_t len = jsvGetStringLength(v);
+    if (len<256) {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_STRING8);
+      jsvStringIteratorSetCharAndNext(dstit, (char)len);
+    } else {
+      jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_STRING16);
+      jsvStringIteratorSetCharAndNext(dstit, (char)(len&0xFF));
+      jsvStringIteratorSetCharAndNext(dstit, (char)(len>>8));
+    }
+    JsvStringIterator srcit;
+    jsvStringIteratorNew(&srcit, v, 0);
+    while (jsvStringIteratorHasChar(&srcit)) {
+      jsvStringIteratorSetCharAndNext(dstit, jsvStringIteratorGetChar(&srcit));
+      jsvStringIteratorNext(&srcit);
+    }
+    jsvStringIteratorFree(&srcit);
+    return;
+  }
+  if (jsvIsInt(v)) {
+    JsVarInt i = jsvGetInteger(v);
+    if (i>=0 && i<=0x7FFFFFFF) {
+      uint32_t u = (uint32_t)i;
+      int bytes;
+      if (u<=0xFF) {
+        jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_INT8);
+        bytes = 1;
+      } else if (u<=0xFFFF) {
+        jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_INT16);
+        bytes = 2;
+      } else {
+        jsvStringIteratorSetCharAndNext(dstit, (char)LEX_RAW_INT32);
+        bytes = 4;
+      }
+      while (bytes--) {
+        jsvStringIteratorSetCharAndNext(dstit, (char)(u&0xFF));
+        u >>= 8;
+      }
+      return;
+    }
+    itostr(i, buf, 10);
+  } else
+    ftoa_bounded(jsvGetFloat(v), buf, sizeof(buf));
+  const char *p;
+  for (p=buf; *p; p++)
+    jsvStringIteratorSetCharAndNext(dstit, *p);
+}
+#endif // SAVE_ON_FLASH
+
 JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
   // New method - tokenise functions
   // save old lex
@@ -886,7 +1119,22 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
       length = 0;
       break;
     }
-    if (lex->tk==LEX_ID ||
+#ifndef SAVE_ON_FLASH
+    if (jslFoldStartsAfter(lastTk) &&
+        (lex->tk==LEX_INT || lex->tk==LEX_FLOAT || lex->tk==LEX_STR || lex->tk=='(' || lex->tk=='-')) {
+      JsVar *folded = jslFoldConstant(charTo);
+      if (folded) {
+        length += jslFoldedLiteralLength(folded);
+        lastTk = jsvIsString(folded) ? LEX_STR : LEX_INT;
+        jsvUnLock(folded);
+        continue; // the lexer is already on the token after the expression
+      }
+    }
+#endif
+    size_t rawLength = jslRawLiteralLength();
+    if (rawLength) {
+      length += rawLength;
+    } else if (lex->tk==LEX_ID ||
         lex->tk==LEX_INT ||
         lex->tk==LEX_FLOAT ||
         lex->tk==LEX_STR ||
@@ -906,8 +1154,23 @@ JsVar *jslNewTokenisedStringFromLexer(JslCharPos *charFrom, size_t charTo) {
     jsvStringIteratorNew(&dstit, var, 0);
     // now start appending
     jslSeekToP(charFrom);
+    lastTk = LEX_EOF;
     while (lex->tk!=LEX_EOF && jsvStringIteratorGetIndex(&lex->it)<=charTo+1) {
-      if (lex->tk==LEX_ID ||
+#ifndef SAVE_ON_FLASH
+      if (jslFoldStartsAfter(lastTk) &&
+          (lex->tk==LEX_INT || lex->tk==LEX_FLOAT || lex->tk==LEX_STR || lex->tk=='(' || lex->tk=='-')) {
+        JsVar *folded = jslFoldConstant(charTo);
+        if (folded) {
+          jslAppendFoldedLiteral(folded, &dstit);
+          lastTk = jsvIsString(folded) ? LEX_STR : LEX_INT;
+          jsvUnLock(folded);
+          continue;
+        }
+      }
+#endif
+      if (jslRawLiteralLength()) {
+        jslAppendRawLiteral(&dstit);
+      } else if (lex->tk==LEX_ID ||
           lex->tk==LEX_INT ||
           lex->tk==LEX_FLOAT ||
           lex->tk==LEX_STR ||
@@ -1009,6 +1272,46 @@ bool jslNeedSpaceBetween(unsigned char lastch, unsigned char ch) {
          (ch>=_LEX_R_LIST_START || isAlpha((char)ch) || isNumeric((char)ch));
 }
 
+/** When printing a tokenised string, check whether `it` points at a raw
+ * literal token (LEX_RAW_*). If so print its source form, step the iterator
+ * past it, update `lastch` to the last printed character and return true. */
+bool jslPrintTokenisedLiteral(JsvStringIterator *it, unsigned char *lastch, vcbprintf_callback user_callback, void *user_data) {
+  unsigned char ch = (unsigned char)jsvStringIteratorGetChar(it);
+  if (ch<_LEX_RAW_START || ch>_LEX_RAW_END) return false;
+  jsvStringIteratorNext(it);
+  if (ch==LEX_RAW_STRING8 || ch==LEX_RAW_STRING16) {
+    size_t length = (unsigned char)jsvStringIteratorGetChar(it);
+    jsvStringIteratorNext(it);
+    if (ch==LEX_RAW_STRING16) {
+      length |= ((size_t)(unsigned char)jsvStringIteratorGetChar(it))<<8;
+      jsvStringIteratorNext(it);
+    }
+    user_callback("\"", user_data);
+    while (length--) {
+      user_callback(escapeCharacter(jsvStringIteratorGetChar(it)), user_data);
+      jsvStringIteratorNext(it);
+    }
+    user_callback("\"", user_data);
+    *lastch = '"';
+  } else { // LEX_RAW_INT8/16/32
+    int bytes = (ch==LEX_RAW_INT8) ? 1 : ((ch==LEX_RAW_INT16) ? 2 : 4);
+    uint32_t value = 0;
+    int shift = 0;
+    while (bytes--) {
+      value |= ((uint32_t)(unsigned char)jsvStringIteratorGetChar(it)) << shift;
+      shift += 8;
+      jsvStringIteratorNext(it);
+    }
+    if (jslNeedSpaceBetween(*lastch, '0'))
+      user_callback(" ", user_data);
+    char buf[16];
+    itostr((JsVarInt)value, buf, 10);
+    user_callback(buf, user_data);
+    *lastch = '0';
+  }
+  return true;
+}
+
 void jslPrintPosition(vcbprintf_callback user_callback, void *user_data, size_t tokenPos) {
   size_t line,col;
   jsvGetLineAndCol(lex->sourceVar, tokenPos, &line, &col);
@@ -1048,6 +1351,10 @@ void jslPrintTokenLineMarker(vcbprintf_callback user_callback, void *user_data,
   while (jsvStringIteratorHasChar(&it) && chars<60) {
     unsigned char ch = (unsigned char)jsvStringIteratorGetChar(&it);
     if (ch == '\n') break;
+    if (jslPrintTokenisedLiteral(&it, &lastch, user_callback, user_data)) {
+      chars++;
+      continue;
+    }
     if (jslNeedSpaceBetween(lastch, ch)) {
       col++;
       user_callback(" ", user_data);
@@ -94,7 +94,19 @@ _LEX_R_LIST_START,
     LEX_R_TYPEOF,
     LEX_R_VOID,
     LEX_R_DEBUGGER,
-_LEX_R_LIST_END = LEX_R_DEBUGGER /* always the last entry */
+_LEX_R_LIST_END = LEX_R_DEBUGGER, /* always the last reserved word */
+
+    /* Tokens below only ever appear in strings made by
+     * jslNewTokenisedStringFromLexer - they are never produced when lexing
+     * normal source code. They let literals be stored in their final form
+     * so they don't have to be re-parsed each time the function runs. */
+_LEX_RAW_START,
+    LEX_RAW_STRING8 = _LEX_RAW_START, ///< +1 byte length, then the string data (unquoted, unescaped)
+    LEX_RAW_STRING16, ///< +2 byte little-endian length, then the string data
+    LEX_RAW_INT8,     ///< +1 byte unsigned integer value
+    LEX_RAW_INT16,    ///< +2 byte little-endian unsigned integer value
+    LEX_RAW_INT32,    ///< +4 byte little-endian unsigned integer value
+_LEX_RAW_END = LEX_RAW_INT32 /* always the last entry */
 } LEX_TYPES;
 
 
@@ -130,10 +142,29 @@ typedef struct JsLex
    */
   JsVar *sourceVar; // the actual string var
   JsvStringIterator it; // Iterator for the string
+
+#ifndef SAVE_ON_FLASH
+#define JSLEX_BLOCKSKIP_CACHE_SIZE 4
+  /** Tiny direct-mapped cache of where the matching '}' was for blocks that
+   * were skipped without being executed, so repeatedly skipping the same
+   * branch (eg. a rarely-taken 'if' inside a loop) becomes a single seek
+   * rather than a full re-lex (see jspeBlockNoBrackets). Entries are only
+   * valid for this lexer, which holds sourceVar locked, so they can never
+   * point into a freed string. blockSkipStart holds the position+1 of the
+   * first token in the block (0 = empty entry), blockSkipEnd the position
+   * of the matching '}'. */
+  uint32_t blockSkipStart[JSLEX_BLOCKSKIP_CACHE_SIZE];
+  uint32_t blockSkipEnd[JSLEX_BLOCKSKIP_CACHE_SIZE];
+#endif
 } JsLex;
 
 // The lexer
 extern JsLex *lex;
+
+#ifndef SAVE_ON_FLASH
+/// Monotonic count of tokens the lexer has consumed - see E.getOpCounters
+extern volatile uint32_t jslOpTokenCount;
+#endif
 /// Set the lexer - return the old one
 JsLex *jslSetLex(JsLex *l);
 
@@ -171,6 +202,11 @@ unsigned int jslGetLineNumber();
 /// Do we need a space between these two characters when printing a function's text?
 bool jslNeedSpaceBetween(unsigned char lastch, unsigned char ch);
 
+/** When printing a tokenised string, check whether `it` points at a raw
+ * literal token (LEX_RAW_*). If so print its source form, step the iterator
+ * past it, update `lastch` to the last printed character and return true. */
+bool jslPrintTokenisedLiteral(JsvStringIterator *it, unsigned char *lastch, vcbprintf_callback user_callback, void *user_data);
+
 /// Print position in the form 'line X col Y'
 void jslPrintPosition(vcbprintf_callback user_callback, void *user_data, size_t tokenPos);
 
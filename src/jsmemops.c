@@ -0,0 +1,92 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2017 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Word-wide memcpy/memset for embedded ARM builds.
+ *
+ * We link with newlib-nano (--specs=nano.specs), whose memcpy and memset
+ * are plain byte loops - so every block copy in the interpreter (string
+ * appends, flat string copies, Graphics fills...) ran at a quarter of the
+ * bandwidth the chip can manage. These replacements copy four words per
+ * iteration once aligned, which the compiler turns into LDM/STM on
+ * Cortex-M. Being linked in before libc is searched, they take priority
+ * over the nano versions everywhere.
+ * ----------------------------------------------------------------------------
+ */
+#include <string.h>
+#include <stdint.h>
+
+#ifndef SAVE_ON_FLASH
+
+/* Without this GCC can recognise these loops as memcpy/memset and turn
+ * them back into calls - to ourselves. */
+#define NO_MEMOP_PATTERNS __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+void NO_MEMOP_PATTERNS *memcpy(void *dst, const void *src, size_t len) {
+  char *d = (char*)dst;
+  const char *s = (const char*)src;
+  // get the destination word-aligned
+  while (len && (((uint32_t)(size_t)d) & 3)) {
+    *d++ = *s++;
+    len--;
+  }
+  if ((((uint32_t)(size_t)s) & 3) == 0) {
+    // source lines up too - copy 4 words at a time (LDM/STM)
+    uint32_t *dw = (uint32_t*)d;
+    const uint32_t *sw = (const uint32_t*)s;
+    while (len >= 16) {
+      uint32_t a = sw[0], b = sw[1], c = sw[2], e = sw[3];
+      dw[0] = a; dw[1] = b; dw[2] = c; dw[3] = e;
+      dw += 4; sw += 4;
+      len -= 16;
+    }
+    while (len >= 4) {
+      *dw++ = *sw++;
+      len -= 4;
+    }
+    d = (char*)dw;
+    s = (const char*)sw;
+  }
+  /* misaligned source (Cortex-M0 can't load words unaligned), or the
+   * last few bytes */
+  while (len) {
+    *d++ = *s++;
+    len--;
+  }
+  return dst;
+}
+
+void NO_MEMOP_PATTERNS *memset(void *dst, int c, size_t len) {
+  char *d = (char*)dst;
+  while (len && (((uint32_t)(size_t)d) & 3)) {
+    *d++ = (char)c;
+    len--;
+  }
+  uint32_t w = (uint8_t)c;
+  w |= w<<8;
+  w |= w<<16;
+  uint32_t *dw = (uint32_t*)d;
+  while (len >= 16) {
+    dw[0] = w; dw[1] = w; dw[2] = w; dw[3] = w;
+    dw += 4;
+    len -= 16;
+  }
+  while (len >= 4) {
+    *dw++ = w;
+    len -= 4;
+  }
+  d = (char*)dw;
+  while (len) {
+    *d++ = (char)c;
+    len--;
+  }
+  return dst;
+}
+
+#endif // SAVE_ON_FLASH
@@ -19,14 +19,174 @@
 #include "jswrap_functions.h" // insane check for eval in jspeFunctionCall
 #include "jswrap_json.h" // for jsfPrintJSON
 #include "jswrap_espruino.h" // for jswrap_espruino_memoryArea
+#include "jsflags.h" // for JSF_WARN_BUILTIN_ALLOC
 #ifndef SAVE_ON_FLASH
 #include "jswrap_regexp.h" // for jswrap_regexp_constructor
+#include "jswrap_error.h" // for the reserved out-of-memory error
 #endif
 
 /* Info about execution when Parsing - this saves passing it on the stack
  * for each call */
 JsExecInfo execInfo;
 
+#ifndef SAVE_ON_FLASH
+/** Tiny direct-mapped inline cache for `obj.field` accesses, keyed by the
+ * position of the field name in the source. Entries remember which child a
+ * given access resolved to last time so repeated accesses (eg. `this.buf`
+ * in a tight loop) skip the child list walk. An entry is only trusted if
+ * jsVarStructureVersion is unchanged (so neither the parent, the child, nor
+ * any other name can have been freed since - see jsvFreePtrInternal), the
+ * parent is the same var, and the cached child's name still matches the
+ * token. Only direct children are cached, never results from the prototype
+ * chain or built-in symbol tables, so lookups that should start shadowing a
+ * prototype member can't return stale results. */
+#define JSPARSE_INLINE_CACHE_SIZE 8
+typedef struct {
+  JsVar *sourceVar;       ///< lex->sourceVar the entry was made with (0 = empty)
+  uint32_t namePos;       ///< position of the field name token in sourceVar
+  unsigned int structureVersion; ///< jsVarStructureVersion when this was cached
+  JsVarRef parentRef;     ///< the object the field was looked up on
+  JsVarRef childRef;      ///< the name var the lookup resolved to
+} JspInlineCache;
+static JspInlineCache jspInlineCache[JSPARSE_INLINE_CACHE_SIZE];
+/** The same idea again for plain variable reads in jspeFactor. Here
+ * parentRef holds the innermost scope at the time of the lookup (so a new
+ * call frame can't see the previous frame's locals), and any `var`
+ * declaration that actually creates a name bumps jsVarStructureVersion so
+ * entries that should become shadowed get dropped. */
+static JspInlineCache jspScopeCache[JSPARSE_INLINE_CACHE_SIZE];
+
+/** Callsite cache for builtin method resolution. Once the direct-child
+ * lookup in jspeFactorMember misses, what's left is a prototype chain walk
+ * plus the symbol-table lookup - and for `"x".charAt` or `a.toString` in a
+ * loop that resolves to the same native function every time. Entries
+ * remember the resolved function pointer and call spec, keyed by source
+ * position and the parent's basic object name (a static string, so its
+ * pointer identifies the class); parents that can have children must also
+ * be the exact same var, since their own __proto__ chain took part in the
+ * lookup. Entries are trusted only while jsVarStructureVersion and
+ * jsVarShadowVersion are both unchanged, so nothing can have appeared (or
+ * been rewired) in any prototype chain to shadow the builtin since. The
+ * direct-child lookup still runs first every time, so own properties
+ * always win. Only plain native functions are cached - properties like
+ * .length execute immediately and never produce one. */
+typedef struct {
+  JsVar *sourceVar;       ///< lex->sourceVar the entry was made with (0 = empty)
+  uint32_t namePos;       ///< position of the field name token in sourceVar
+  unsigned int structureVersion; ///< jsVarStructureVersion when this was cached
+  unsigned int shadowVersion;    ///< jsVarShadowVersion when this was cached
+  const char *classKey;   ///< jswGetBasicObjectName(parent)
+  JsVarRef parentRef;     ///< checked only when the parent can have children
+  void (*functionPtr)(void);     ///< the resolved builtin
+  unsigned short functionSpec;   ///< JsnArgumentType of the resolved builtin
+} JspBuiltinCache;
+static JspBuiltinCache jspBuiltinCache[JSPARSE_INLINE_CACHE_SIZE];
+
+/** Per-object cache of resolved prototype links. Every level of every
+ * inherited lookup re-reads "__proto__" with a string child search (falling
+ * back to root's Object.prototype), and method calls on instances pay that
+ * on each invocation. Entries map an object to what it inherits from, by
+ * ref; they are trusted only while both versions are unchanged, so the
+ * proto can't have been freed (freeing anything with children bumps
+ * jsVarStructureVersion) or rewired (bumps jsVarShadowVersion). */
+typedef struct {
+  JsVarRef objectRef;     ///< the object looked up on (0 = empty)
+  JsVarRef protoRef;      ///< what it inherits from (0 = nothing, not even Object.prototype)
+  unsigned int structureVersion; ///< jsVarStructureVersion when this was cached
+  unsigned int shadowVersion;    ///< jsVarShadowVersion when this was cached
+} JspProtoCache;
+static JspProtoCache jspProtoCache[JSPARSE_INLINE_CACHE_SIZE];
+
+/** Negative cache for names that miss the whole builtin prototype chain.
+ * For non-objects (arrays, strings, numerics...) the chain walk means a
+ * root lookup for each class name up the chain, and a failed lookup (eg.
+ * `if (arr.onData)`) repeats it all every time just to find nothing.
+ * Entries record "this name is on none of this class's prototypes", keyed
+ * by the class's static name pointer; anything that could add a name
+ * (jsvAddName) or graft one into reach (jspReplaceWith) bumps a version. */
+#define JSPARSE_PROTO_MISS_CACHE_SIZE 4
+#define JSPARSE_PROTO_MISS_NAME_LEN 14
+typedef struct {
+  const char *objectName; ///< jswGetBasicObjectName of the parent (0 = empty)
+  char name[JSPARSE_PROTO_MISS_NAME_LEN]; ///< the name that missed
+  unsigned int structureVersion; ///< jsVarStructureVersion when this was cached
+  unsigned int shadowVersion;    ///< jsVarShadowVersion when this was cached
+} JspProtoMissCache;
+static JspProtoMissCache jspProtoMissCache[JSPARSE_PROTO_MISS_CACHE_SIZE];
+
+/** Dispatch cache for switch statements whose case labels are all integer
+ * literals (eg. protocol decoders). The first execution records each case
+ * value and the position of its `case` token; later executions look the
+ * switched-on integer up and jump straight there with jslSeekTo instead of
+ * evaluating every case expression in turn. Before anything is executed via
+ * a cached offset, the `case <value>:`/`default`/`}` tokens are re-checked
+ * against the live source, so a stale entry just falls back to the normal
+ * scan. */
+#define JSPARSE_SWITCH_CACHE_SIZE 2
+#define JSPARSE_SWITCH_CACHE_CASES 48
+typedef struct {
+  JsVar *sourceVar;    ///< lex->sourceVar the entry was made with (0 = empty)
+  uint32_t switchPos;  ///< position of the '{' opening the switch
+  uint32_t endPos;     ///< position of the '}' closing the switch
+  uint32_t defaultPos; ///< position of the `default` token, 0 if none
+  int caseCount;
+  JsVarInt caseValue[JSPARSE_SWITCH_CACHE_CASES];
+  uint32_t casePos[JSPARSE_SWITCH_CACHE_CASES]; ///< position of each `case` token
+} JspSwitchCache;
+static JspSwitchCache jspSwitchCache[JSPARSE_SWITCH_CACHE_SIZE];
+
+/** Pool of recently-finished call frames. When a function returns and
+ * nothing kept a reference to its execution scope (no closure captured it),
+ * the frame is parked here instead of being freed: parameter names, the
+ * function's own name and the return var survive with their values cleared,
+ * so the next call to the same function just refills values instead of
+ * rebuilding the frame var by var. Locals are still removed at park time,
+ * so `var` statements behave exactly as they would in a fresh frame. Both
+ * the function and the frame are kept locked while pooled. */
+#define JSPARSE_FRAME_POOL_SIZE 4
+static JsVar *jspFramePoolFunction[JSPARSE_FRAME_POOL_SIZE]; ///< 0 = empty slot
+static JsVar *jspFramePoolFrame[JSPARSE_FRAME_POOL_SIZE];
+
+/* Opt-in per-function call statistics (E.setFunctionStats/E.getFunctionStats).
+ * Keyed by the function var's ref in a small open-addressed table - no
+ * allocation happens on the call path, just a hash probe and two timer
+ * reads, and none of it runs at all unless stats have been switched on. */
+bool jspFunctionStatsEnabled = false;
+JspFunctionStat jspFunctionStats[JSPARSE_FUNCTION_STATS];
+
+static void jspFunctionStatAdd(JsVarRef ref, JsSysTime time) {
+  int i;
+  for (i=0;i<JSPARSE_FUNCTION_STATS;i++) {
+    JspFunctionStat *s = &jspFunctionStats[(ref+(unsigned)i) & (JSPARSE_FUNCTION_STATS-1)];
+    if (s->ref == ref || !s->ref) {
+      s->ref = ref;
+      s->calls++;
+      s->time += time;
+      return;
+    }
+  }
+  // table full - this function's samples are dropped
+}
+
+void jspFunctionStatsReset() {
+  memset(jspFunctionStats, 0, sizeof(jspFunctionStats));
+}
+#endif
+
+#ifdef USE_HOT_FUNCTIONS
+/** Tiered execution: a function that keeps getting called is worth storing
+ * in the pretokenised form (see jslNewTokenisedStringFromLexer), as if it had
+ * been defined with E.setFlags({pretokenise:1}). We count calls here rather
+ * than in a hidden child so cold functions cost no memory - collisions or
+ * freed functions just mean a counter restarts, which is harmless. Once an
+ * entry passes JSPARSE_HOT_FUNCTION_THRESHOLD its counter parks one above it
+ * so we don't keep retokenising. */
+#define JSPARSE_HOT_FUNCTION_CACHE_SIZE 8
+#define JSPARSE_HOT_FUNCTION_THRESHOLD 8
+static JsVarRef jspHotFunctionRef[JSPARSE_HOT_FUNCTION_CACHE_SIZE];
+static unsigned char jspHotFunctionCalls[JSPARSE_HOT_FUNCTION_CACHE_SIZE];
+#endif
+
 // ----------------------------------------------- Forward decls
 JsVar *jspeAssignmentExpression();
 JsVar *jspeExpression();
@@ -57,6 +217,27 @@ ALWAYS_INLINE void jspDebuggerLoopIfCtrlC() {
 #endif
 }
 
+#ifdef ESP8266
+/* The SDK's soft watchdog resets the chip if we go ~3 seconds without
+ * returning to its scheduler, so a long-running bit of JS (or a big parse)
+ * would reboot the device unless the user remembered to sprinkle delays in.
+ * Instead we poll the cycle counter at statement/loop boundaries and feed
+ * the watchdog ourselves once enough cycles have passed - the check itself
+ * is just a register read and a compare. 32M cycles is ~0.4 sec at 80MHz
+ * (~0.2 sec at 160MHz), comfortably inside the watchdog period. */
+static uint32_t jspWatchdogFedAt = 0;
+ALWAYS_INLINE void jspYieldWatchdogIfNeeded() {
+  uint32_t ccount;
+  asm volatile("rsr %0, ccount" : "=a"(ccount));
+  if (ccount - jspWatchdogFedAt > 32000000) {
+    jspWatchdogFedAt = ccount;
+    jshKickWatchDog();
+  }
+}
+#else
+#define jspYieldWatchdogIfNeeded()
+#endif
+
 /// if interrupting execution, this is set
 bool jspIsInterrupted() {
   return (execInfo.execute & EXEC_INTERRUPTED)!=0;
@@ -70,6 +251,18 @@ void jspSetInterrupted(bool interrupt) {
     execInfo.execute = execInfo.execute & (JsExecFlags)~EXEC_INTERRUPTED;
 }
 
+#ifndef SAVE_ON_FLASH
+/* Preallocated at boot so that running out of memory can still throw
+ * something catchable - building an Error object needs half a dozen free
+ * vars, which is exactly what we haven't got at that point. */
+static JsVar *jspReservedError = 0;
+
+/// Get the error preallocated at boot (or 0 if even that failed)
+JsVar *jspGetReservedError() {
+  return jspReservedError ? jsvLockAgain(jspReservedError) : 0;
+}
+#endif
+
 /// Set the error flag - set lineReported if we've already output the line number
 void jspSetError(bool lineReported) {
   execInfo.execute = (execInfo.execute & (JsExecFlags)~EXEC_YES) | EXEC_ERROR;
@@ -96,6 +289,25 @@ void jspReplaceWith(JsVar *dst, JsVar *src) {
     return;
   }
   jsvSetValueOfName(dst, src);
+#ifndef SAVE_ON_FLASH
+  /* Reassigning __proto__/prototype/constructor rewires a prototype chain
+   * without creating any name, so bump the shadow version by hand or the
+   * builtin callsite cache would miss the change (cheap: only names whose
+   * first char matches get string-compared) */
+  if (jsvIsString(dst)) {
+    if (jsvHasChildren(src)) {
+      /* assigning an object grafts a ready-made subtree (eg. a class with a
+       * populated prototype) into reach, equally without creating a name */
+      jsVarShadowVersion++;
+    } else {
+      char c = dst->varData.str[0];
+      if ((c=='_' && jsvIsStringEqual(dst, JSPARSE_INHERITS_VAR)) ||
+          (c=='p' && jsvIsStringEqual(dst, JSPARSE_PROTOTYPE_VAR)) ||
+          (c=='c' && jsvIsStringEqual(dst, JSPARSE_CONSTRUCTOR_VAR)))
+        jsVarShadowVersion++;
+    }
+  }
+#endif
   /* If dst is flagged as a new child, it means that
    * it was previously undefined, and we need to add it to
    * the given object when it is set.
@@ -166,16 +378,37 @@ JsVar *jspeiFindNameOnTop(JsVar *childName, bool createIfNotFound) {
 JsVar *jspeiFindChildFromStringInParents(JsVar *parent, const char *name) {
   if (jsvIsObject(parent)) {
     // If an object, look for an 'inherits' var
-    JsVar *inheritsFrom = jsvObjectGetChild(parent, JSPARSE_INHERITS_VAR, 0);
-
-    // if there's no inheritsFrom, just default to 'Object.prototype'
-    if (!inheritsFrom) {
-      JsVar *obj = jsvObjectGetChild(execInfo.root, "Object", 0);
-      if (obj) {
-        inheritsFrom = jsvObjectGetChild(obj, JSPARSE_PROTOTYPE_VAR, 0);
-        jsvUnLock(obj);
+    JsVar *inheritsFrom;
+#ifndef SAVE_ON_FLASH
+    JsVarRef parentRef = jsvGetRef(parent);
+    JspProtoCache *pc = &jspProtoCache[parentRef & (JSPARSE_INLINE_CACHE_SIZE-1)];
+    if (pc->objectRef == parentRef &&
+        pc->structureVersion == jsVarStructureVersion &&
+        pc->shadowVersion == jsVarShadowVersion) {
+      inheritsFrom = pc->protoRef ? jsvLock(pc->protoRef) : 0;
+    } else {
+#endif
+      inheritsFrom = jsvObjectGetChild(parent, JSPARSE_INHERITS_VAR, 0);
+
+      // if there's no inheritsFrom, just default to 'Object.prototype'
+      if (!inheritsFrom) {
+        JsVar *obj = jsvObjectGetChild(execInfo.root, "Object", 0);
+        if (obj) {
+          inheritsFrom = jsvObjectGetChild(obj, JSPARSE_PROTOTYPE_VAR, 0);
+          jsvUnLock(obj);
+        }
+      }
+#ifndef SAVE_ON_FLASH
+      /* only things that bump jsVarStructureVersion when freed may be
+       * cached by ref (a daft `o.__proto__=5` stays uncached) */
+      if (!inheritsFrom || jsvHasChildren(inheritsFrom)) {
+        pc->objectRef = parentRef;
+        pc->protoRef = inheritsFrom ? jsvGetRef(inheritsFrom) : 0;
+        pc->structureVersion = jsVarStructureVersion;
+        pc->shadowVersion = jsVarShadowVersion;
       }
     }
+#endif
 
     if (inheritsFrom && inheritsFrom!=parent) {
       // we have what it inherits from (this is ACTUALLY the prototype var)
@@ -189,6 +422,21 @@ JsVar *jspeiFindChildFromStringInParents(JsVar *parent, const char *name) {
       jsvUnLock(inheritsFrom);
   } else { // Not actually an object - but might be an array/string/etc
     const char *objectName = jswGetBasicObjectName(parent);
+#ifndef SAVE_ON_FLASH
+    const char *classKey = objectName; // static string - pointer identifies the class
+    JspProtoMissCache *mc = 0;
+    if (objectName) {
+      size_t nameLen = strlen(name);
+      if (nameLen < JSPARSE_PROTO_MISS_NAME_LEN) {
+        mc = &jspProtoMissCache[((unsigned char)name[0] + nameLen) & (JSPARSE_PROTO_MISS_CACHE_SIZE-1)];
+        if (mc->objectName == classKey &&
+            mc->structureVersion == jsVarStructureVersion &&
+            mc->shadowVersion == jsVarShadowVersion &&
+            strcmp(mc->name, name)==0)
+          return 0; // cached miss - this name is on none of this class's prototypes
+      }
+    }
+#endif
     while (objectName) {
       JsVar *objName = jsvFindChildFromString(execInfo.root, objectName, false);
       if (objName) {
@@ -211,6 +459,15 @@ JsVar *jspeiFindChildFromStringInParents(JsVar *parent, const char *name) {
         a prototype field, so we hard-code it */
       objectName = jswGetBasicObjectPrototypeName(objectName);
     }
+#ifndef SAVE_ON_FLASH
+    if (mc) {
+      // the whole chain missed - remember so the next one returns right away
+      mc->objectName = classKey;
+      strcpy(mc->name, name);
+      mc->structureVersion = jsVarStructureVersion;
+      mc->shadowVersion = jsVarShadowVersion;
+    }
+#endif
   }
 
   // no luck!
@@ -387,11 +644,26 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
   // Get the code - parse it and figure out where it stops
   JslCharPos funcBegin = jslCharPosClone(&lex->tokenStart);
   int lastTokenEnd = -1;
+#ifndef SAVE_ON_FLASH
+  bool usesArguments = false;
+#endif
   if (!expressionOnly) {
     int brackets = 0;
     while (lex->tk && (brackets || lex->tk != '}')) {
       if (lex->tk == '{') brackets++;
       if (lex->tk == '}') brackets--;
+#ifndef SAVE_ON_FLASH
+      /* We're walking every token of the body anyway, so note here whether
+       * 'arguments' could ever be referenced - if not, calls can skip keeping
+       * extra unnamed arguments around. 'eval' could sneak a reference in,
+       * so treat it the same (conservatively - this includes nested bodies) */
+      if (lex->tk == LEX_ID && !usesArguments) {
+        const char *tokenName = jslGetTokenValueAsString(lex);
+        if ((tokenName[0]=='a' && strcmp(tokenName, "arguments")==0) ||
+            (tokenName[0]=='e' && strcmp(tokenName, "eval")==0))
+          usesArguments = true;
+      }
+#endif
       lastTokenEnd = (int)jsvStringIteratorGetIndex(&lex->it)-1;
       JSP_ASSERT_MATCH(lex->tk);
     }
@@ -422,6 +694,30 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
         funcCodeVar = jslNewStringFromLexer(&funcBegin, (size_t)lastTokenEnd);
       }
     }
+#ifndef SAVE_ON_FLASH
+    if (expressionOnly && funcCodeVar) {
+      // expression bodies were parsed with EXEC_NO, so scan their tokens here
+      JsLex scanLex;
+      JsLex *oldLex = jslSetLex(&scanLex);
+      jslInit(funcCodeVar);
+      while (lex->tk && !usesArguments) {
+        if (lex->tk == LEX_ID) {
+          const char *tokenName = jslGetTokenValueAsString(lex);
+          if ((tokenName[0]=='a' && strcmp(tokenName, "arguments")==0) ||
+              (tokenName[0]=='e' && strcmp(tokenName, "eval")==0))
+            usesArguments = true;
+        }
+        jslGetNextToken(lex);
+      }
+      jslKill();
+      jslSetLex(oldLex);
+    }
+    if (usesArguments) {
+      JsVar *marker = jsvNewFromInteger(1);
+      if (marker)
+        jsvUnLock2(jsvAddNamedChild(funcVar, marker, JSPARSE_FUNCTION_USES_ARGUMENTS_NAME), marker);
+    }
+#endif
     jsvUnLock2(jsvAddNamedChild(funcVar, funcCodeVar, JSPARSE_FUNCTION_CODE_NAME), funcCodeVar);
     // scope var
     JsVar *funcScopeVar = jspeiGetScopesAsVar();
@@ -495,6 +791,50 @@ NO_INLINE bool jspeParseFunctionCallBrackets() {
   return 0;
 }
 
+#ifndef SAVE_ON_FLASH
+/// Next parameter name in a reused call frame (see jspFramePool*), 0 when exhausted
+static JsVar *jspeFramePoolNextParam(JsvObjectIterator *frameIt) {
+  while (jsvObjectIteratorHasValue(frameIt)) {
+    JsVar *child = jsvObjectIteratorGetKey(frameIt);
+    jsvObjectIteratorNext(frameIt);
+    if (jsvIsFunctionParameter(child)) return child;
+    jsvUnLock(child);
+  }
+  return 0;
+}
+
+/** Could the function's body reference 'arguments'? Scanned once at
+ * definition time (see jspeFunctionDefinitionInternal); the answer is
+ * cached across one call in *cachedResult (-1 = not looked up yet) */
+static bool jspeFunctionUsesArguments(JsVar *function, int *cachedResult) {
+  if (*cachedResult < 0) {
+    JsVar *marker = jsvFindChildFromString(function, JSPARSE_FUNCTION_USES_ARGUMENTS_NAME, false);
+    *cachedResult = marker ? 1 : 0;
+    jsvUnLock(marker);
+  }
+  return *cachedResult != 0;
+}
+#endif
+
+#ifdef USE_HOT_FUNCTIONS
+/** Build a pretokenised copy of the given function code, so executing it
+ * skips whitespace, comments and keyword recognition. Used when a function
+ * passes the hot-call threshold, and over the whole var pool by save().
+ * Returns 0 on failure (eg. out of memory), in which case the caller just
+ * keeps the original code var. */
+JsVar *jspTokeniseFunctionCode(JsVar *functionCode) {
+  JsLex newLex;
+  JsLex *oldLex = jslSetLex(&newLex);
+  jslInit(functionCode);
+  JslCharPos codeStart = jslCharPosClone(&lex->tokenStart);
+  JsVar *tokenisedCode = jslNewTokenisedStringFromLexer(&codeStart, jsvGetStringLength(functionCode));
+  jslCharPosFree(&codeStart);
+  jslKill();
+  jslSetLex(oldLex);
+  return tokenisedCode;
+}
+#endif
+
 /** Handle a function call (assumes we've parsed the function name and we're
  * on the start bracket). 'thisArg' is the value of the 'this' variable when the
  * function is executed (it's usually the parent object)
@@ -525,6 +865,10 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
       return 0;
     }
     JsVar *thisVar = jsvLockAgainSafe(thisArg);
+#ifndef SAVE_ON_FLASH
+    JsSysTime statStartTime = 0;
+    if (jspFunctionStatsEnabled) statStartTime = jshGetSystemTime();
+#endif
     if (isParsing) JSP_MATCH('(');
 
     /* Ok, so we have 4 options here.
@@ -540,44 +884,58 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 
       unsigned int argPtrSize = 0;
       int boundArgs = 0;
-      // Add 'bound' parameters if there were any
-      JsvObjectIterator it;
-      jsvObjectIteratorNew(&it, function);
-      JsVar *param = jsvObjectIteratorGetKey(&it);
-      while (jsvIsFunctionParameter(param)) {
-        if ((unsigned)argCount>=argPtrSize) {
-          // allocate more space on stack if needed
-          unsigned int newArgPtrSize = argPtrSize?argPtrSize*4:16;
-          JsVar **newArgPtr = (JsVar**)alloca(sizeof(JsVar*)*newArgPtrSize);
-          memcpy(newArgPtr, argPtr, (unsigned)argCount*sizeof(JsVar*));
-          argPtr = newArgPtr;
-          argPtrSize = newArgPtrSize;
+      /* Function.bind stores bound arguments as parameter children and 'this'
+       * as JSPARSE_FUNCTION_THIS_NAME - almost all native functions have no
+       * children at all, so don't even start a walk for those */
+      if (jsvGetFirstChild(function)) {
+        // count 'bound' parameters if there were any
+        JsvObjectIterator it;
+        jsvObjectIteratorNew(&it, function);
+        JsVar *param = jsvObjectIteratorGetKey(&it);
+        while (jsvIsFunctionParameter(param)) {
+          boundArgs++;
+          jsvUnLock(param);
+          jsvObjectIteratorNext(&it);
+          param = jsvObjectIteratorGetKey(&it);
         }
-        // if we already had arguments - shift them up...
-        int i;
-        for (i=argCount-1;i>=boundArgs;i--)
-          argPtr[i+1] = argPtr[i];
-        // add bound argument
-        argPtr[boundArgs] = jsvSkipName(param);
-        argCount++;
-        boundArgs++;
-        jsvUnLock(param);
-        jsvObjectIteratorNext(&it);
-        param = jsvObjectIteratorGetKey(&it);
-      }
-      // check if 'this' was defined
-      while (param) {
-        if (jsvIsStringEqual(param, JSPARSE_FUNCTION_THIS_NAME)) {
-          jsvUnLock(thisVar);
-          thisVar = jsvSkipName(param);
-          break;
+        if (boundArgs) {
+          if ((unsigned)(argCount+boundArgs)>=argPtrSize) {
+            // allocate more space on stack if needed
+            unsigned int newArgPtrSize = argPtrSize?argPtrSize*4:16;
+            while (newArgPtrSize < (unsigned)(argCount+boundArgs)) newArgPtrSize*=4;
+            JsVar **newArgPtr = (JsVar**)alloca(sizeof(JsVar*)*newArgPtrSize);
+            memcpy(newArgPtr, argPtr, (unsigned)argCount*sizeof(JsVar*));
+            argPtr = newArgPtr;
+            argPtrSize = newArgPtrSize;
+          }
+          // splice the stored arguments in below any supplied ones in one move
+          memmove(&argPtr[boundArgs], &argPtr[0], (unsigned)argCount*sizeof(JsVar*));
+          argCount += boundArgs;
+          JsvObjectIterator bIt;
+          jsvObjectIteratorNew(&bIt, function);
+          int i;
+          for (i=0;i<boundArgs;i++) {
+            JsVar *bound = jsvObjectIteratorGetKey(&bIt);
+            argPtr[i] = jsvSkipName(bound);
+            jsvUnLock(bound);
+            jsvObjectIteratorNext(&bIt);
+          }
+          jsvObjectIteratorFree(&bIt);
+        }
+        // check if 'this' was defined
+        while (param) {
+          if (jsvIsStringEqual(param, JSPARSE_FUNCTION_THIS_NAME)) {
+            jsvUnLock(thisVar);
+            thisVar = jsvSkipName(param);
+            break;
+          }
+          jsvUnLock(param);
+          jsvObjectIteratorNext(&it);
+          param = jsvObjectIteratorGetKey(&it);
         }
         jsvUnLock(param);
-        jsvObjectIteratorNext(&it);
-        param = jsvObjectIteratorGetKey(&it);
+        jsvObjectIteratorFree(&it);
       }
-      jsvUnLock(param);
-      jsvObjectIteratorFree(&it);
 
       // Now, if we're parsing add the rest of the arguments
       int allocatedArgCount = boundArgs;
@@ -622,7 +980,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 
 
       if (nativePtr && !JSP_HAS_ERROR) {
-        returnVar = jsnCallFunction(nativePtr, function->varData.native.argTypes, thisVar, argPtr, argCount);
+        returnVar = jswCallFunction(nativePtr, function->varData.native.argTypes, thisVar, argPtr, argCount);
       } else {
         returnVar = 0;
       }
@@ -636,9 +994,23 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 
     } else { // ----------------------------------------------------- NOT NATIVE
       // create a new symbol table entry for execution of this function
-      // OPT: can we cache this function execution environment + param variables?
-      // OPT: Probably when calling a function ONCE, use it, otherwise when recursing, make new?
-      JsVar *functionRoot = jsvNewWithFlags(JSV_FUNCTION);
+      JsVar *functionRoot = 0;
+#ifndef SAVE_ON_FLASH
+      int usesArgumentsCache = -1;
+      bool reusedFrame = false;
+      int framePoolIdx = (int)(jsvGetRef(function) & (JSPARSE_FRAME_POOL_SIZE-1));
+      if (jspFramePoolFunction[framePoolIdx]==function) {
+        // we have this function's last frame parked - reuse it
+        functionRoot = jspFramePoolFrame[framePoolIdx];
+        jsvUnLock(jspFramePoolFunction[framePoolIdx]);
+        jspFramePoolFunction[framePoolIdx] = 0;
+        jspFramePoolFrame[framePoolIdx] = 0;
+        reusedFrame = true;
+      }
+      JsvObjectIterator frameIt;
+      if (reusedFrame) jsvObjectIteratorNew(&frameIt, functionRoot);
+#endif
+      if (!functionRoot) functionRoot = jsvNewWithFlags(JSV_FUNCTION);
       if (!functionRoot) { // out of memory
         jspSetError(false);
         jsvUnLock(thisVar);
@@ -663,14 +1035,24 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
       JsVar *param = jsvObjectIteratorGetKey(&it);
       JsVar *value = jsvObjectIteratorGetValue(&it);
       while (jsvIsFunctionParameter(param) && value) {
-        JsVar *paramName = jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH);
-        if (paramName) { // could be out of memory
-          jsvMakeFunctionParameter(paramName); // force this to be called a function parameter
+        JsVar *paramName = 0;
+#ifndef SAVE_ON_FLASH
+        if (reusedFrame) paramName = jspeFramePoolNextParam(&frameIt);
+        if (paramName) { // the pooled frame already has this parameter
           jsvSetValueOfName(paramName, value);
-          jsvAddName(functionRoot, paramName);
           jsvUnLock(paramName);
         } else
-          jspSetError(false);
+#endif
+        {
+          paramName = jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH);
+          if (paramName) { // could be out of memory
+            jsvMakeFunctionParameter(paramName); // force this to be called a function parameter
+            jsvSetValueOfName(paramName, value);
+            jsvAddName(functionRoot, paramName);
+            jsvUnLock(paramName);
+          } else
+            jspSetError(false);
+        }
         jsvUnLock2(value, param);
         jsvObjectIteratorNext(&it);
         param = jsvObjectIteratorGetKey(&it);
@@ -692,14 +1074,27 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
               value = jspeAssignmentExpression();
             // and if execute, copy it over
             value = jsvSkipNameAndUnLock(value);
-            JsVar *paramName = paramDefined ? jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH) : jsvNewFromEmptyString();
-            if (paramName) { // could be out of memory
-              jsvMakeFunctionParameter(paramName); // force this to be called a function parameter
+            JsVar *paramName = 0;
+#ifndef SAVE_ON_FLASH
+            if (reusedFrame) paramName = jspeFramePoolNextParam(&frameIt);
+            if (paramName) { // the pooled frame already has this parameter
               jsvSetValueOfName(paramName, value);
-              jsvAddName(functionRoot, paramName);
               jsvUnLock(paramName);
+            } else if (!paramDefined && !jspeFunctionUsesArguments(function, &usesArgumentsCache)) {
+              // extra unnamed arguments only exist for 'arguments' to find,
+              // and this function can never reference it - don't keep them
             } else
-              jspSetError(false);
+#endif
+            {
+              paramName = paramDefined ? jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH) : jsvNewFromEmptyString();
+              if (paramName) { // could be out of memory
+                jsvMakeFunctionParameter(paramName); // force this to be called a function parameter
+                jsvSetValueOfName(paramName, value);
+                jsvAddName(functionRoot, paramName);
+                jsvUnLock(paramName);
+              } else
+                jspSetError(false);
+            }
             jsvUnLock(value);
             if (lex->tk!=')') JSP_MATCH(',');
           }
@@ -712,14 +1107,27 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         while (args<argCount) {
           JsVar *param = jsvObjectIteratorGetKey(&it);
           bool paramDefined = jsvIsFunctionParameter(param);
-          JsVar *paramName = paramDefined ? jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH) : jsvNewFromEmptyString();
-          if (paramName) {
-            jsvMakeFunctionParameter(paramName); // force this to be called a function parameter
+          JsVar *paramName = 0;
+#ifndef SAVE_ON_FLASH
+          if (reusedFrame) paramName = jspeFramePoolNextParam(&frameIt);
+          if (paramName) { // the pooled frame already has this parameter
             jsvSetValueOfName(paramName, argPtr[args]);
-            jsvAddName(functionRoot, paramName);
             jsvUnLock(paramName);
+          } else if (!paramDefined && !jspeFunctionUsesArguments(function, &usesArgumentsCache)) {
+            // extra unnamed arguments only exist for 'arguments' to find,
+            // and this function can never reference it - don't keep them
           } else
-            jspSetError(false);
+#endif
+          {
+            paramName = paramDefined ? jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH) : jsvNewFromEmptyString();
+            if (paramName) {
+              jsvMakeFunctionParameter(paramName); // force this to be called a function parameter
+              jsvSetValueOfName(paramName, argPtr[args]);
+              jsvAddName(functionRoot, paramName);
+              jsvUnLock(paramName);
+            } else
+              jspSetError(false);
+          }
           args++;
           jsvUnLock(param);
           if (paramDefined) jsvObjectIteratorNext(&it);
@@ -737,14 +1145,28 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
             thisVar = jsvSkipName(param);
           } else if (jsvIsStringEqual(param, JSPARSE_FUNCTION_LINENUMBER_NAME)) functionLineNumber = (uint16_t)jsvGetIntegerAndUnLock(jsvSkipName(param));
           else if (jsvIsFunctionParameter(param)) {
-            JsVar *paramName = jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH);
-            // paramName is already a name (it's a function parameter)
-            if (paramName) {// could be out of memory - or maybe just not supplied!
-              jsvMakeFunctionParameter(paramName);
+            JsVar *paramName = 0;
+#ifndef SAVE_ON_FLASH
+            if (reusedFrame) paramName = jspeFramePoolNextParam(&frameIt);
+            if (paramName) { // the pooled frame already has this parameter
               JsVar *defaultVal = jsvSkipName(param);
-              if (defaultVal) jsvUnLock(jsvSetValueOfName(paramName, defaultVal));
-              jsvAddName(functionRoot, paramName);
+              if (defaultVal) {
+                jsvSetValueOfName(paramName, defaultVal);
+                jsvUnLock(defaultVal);
+              }
               jsvUnLock(paramName);
+            } else
+#endif
+            {
+              paramName = jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH);
+              // paramName is already a name (it's a function parameter)
+              if (paramName) {// could be out of memory - or maybe just not supplied!
+                jsvMakeFunctionParameter(paramName);
+                JsVar *defaultVal = jsvSkipName(param);
+                if (defaultVal) jsvUnLock(jsvSetValueOfName(paramName, defaultVal));
+                jsvAddName(functionRoot, paramName);
+                jsvUnLock(paramName);
+              }
             }
           }
         }
@@ -754,6 +1176,9 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
       jsvObjectIteratorFree(&it);
 
       // setup a the function's name (if a named function)
+#ifndef SAVE_ON_FLASH
+      if (reusedFrame) jsvObjectIteratorFree(&frameIt);
+#endif
       if (functionInternalName) {
         JsVar *name = jsvMakeIntoVariableName(jsvNewFromStringVar(functionInternalName,0,JSVAPPENDSTRINGVAR_MAXLENGTH), function);
         jsvAddName(functionRoot, name);
@@ -793,6 +1218,27 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
            * have messed up and left us with the wrong Lexer, so
            * we want to be careful here... */
           if (functionCode) {
+#ifdef USE_HOT_FUNCTIONS
+            /* Count calls, and retokenise this function's code once it's
+             * clearly hot. Native strings execute straight from flash so we
+             * leave those alone. */
+            if (!jsvIsNativeString(functionCode)) {
+              JsVarRef hotRef = jsvGetRef(function);
+              int hotIdx = (int)(hotRef & (JSPARSE_HOT_FUNCTION_CACHE_SIZE-1));
+              if (jspHotFunctionRef[hotIdx] != hotRef) {
+                jspHotFunctionRef[hotIdx] = hotRef;
+                jspHotFunctionCalls[hotIdx] = 1;
+              } else if (jspHotFunctionCalls[hotIdx] <= JSPARSE_HOT_FUNCTION_THRESHOLD &&
+                         jspHotFunctionCalls[hotIdx]++ == JSPARSE_HOT_FUNCTION_THRESHOLD) {
+                JsVar *tokenisedCode = jspTokeniseFunctionCode(functionCode);
+                if (tokenisedCode) {
+                  jsvObjectSetChild(function, JSPARSE_FUNCTION_CODE_NAME, tokenisedCode);
+                  jsvUnLock(functionCode);
+                  functionCode = tokenisedCode;
+                }
+              }
+            }
+#endif
 #ifdef USE_DEBUGGER
             bool hadDebuggerNextLineOnly = false;
 
@@ -833,7 +1279,13 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
                 returnVar = jsvSkipNameAndUnLock(jspeExpression());
             } else {
               // setup a return variable
+#ifndef SAVE_ON_FLASH
+              // pooled frames kept their return var child - look it up rather than duplicating it
+              JsVar *returnVarName = reusedFrame ? jsvFindChildFromString(functionRoot, JSPARSE_RETURN_VAR, true) :
+                                                   jsvAddNamedChild(functionRoot, 0, JSPARSE_RETURN_VAR);
+#else
               JsVar *returnVarName = jsvAddNamedChild(functionRoot, 0, JSPARSE_RETURN_VAR);
+#endif
               // parse the whole block
               jspeBlockNoBrackets();
               /* get the real return var before we remove it from our function.
@@ -895,11 +1347,49 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         execInfo.scopeCount = oldScopeCount;
       }
       jsvUnLock(functionCode);
+#ifndef SAVE_ON_FLASH
+      if (!JSP_HAS_ERROR && jsvGetRefs(functionRoot)==0 && jsvGetLocks(functionRoot)==1) {
+        /* Nothing captured the scope (no closure was created in it) so
+         * nobody can ever see this frame again - park it for reuse.
+         * Parameters are kept (values cleared), as are the return var and
+         * the function's own name; locals are removed so the next call
+         * starts from a clean frame. */
+        JsvObjectIterator it;
+        jsvObjectIteratorNew(&it, functionRoot);
+        while (jsvObjectIteratorHasValue(&it)) {
+          JsVar *child = jsvObjectIteratorGetKey(&it);
+          bool keep;
+          if (jsvIsFunctionParameter(child) && jsvGetStringLength(child)>0) {
+            jsvSetValueOfName(child, 0); // don't hold argument values captive
+            keep = true;
+          } else if (jsvIsStringEqual(child, JSPARSE_RETURN_VAR)) {
+            keep = true; // already cleared above
+          } else {
+            keep = false; // locals, the function's name, unnamed extra arguments
+          }
+          jsvUnLock(child);
+          if (keep) jsvObjectIteratorNext(&it);
+          else jsvObjectIteratorRemoveAndGotoNext(&it, functionRoot);
+        }
+        jsvObjectIteratorFree(&it);
+        int idx = (int)(jsvGetRef(function) & (JSPARSE_FRAME_POOL_SIZE-1));
+        jsvUnLock2(jspFramePoolFunction[idx], jspFramePoolFrame[idx]);
+        jspFramePoolFunction[idx] = jsvLockAgain(function);
+        jspFramePoolFrame[idx] = functionRoot; // keep our lock
+      } else
+#endif
       jsvUnLock(functionRoot);
     }
 
     jsvUnLock(thisVar);
 
+#ifndef SAVE_ON_FLASH
+    /* time is inclusive - callees are counted in their callers too. Checking
+     * statStartTime skips the call that turned stats on partway through
+     * (E.setFunctionStats itself) */
+    if (jspFunctionStatsEnabled && statStartTime)
+      jspFunctionStatAdd(jsvGetRef(function), jshGetSystemTime()-statStartTime);
+#endif
     return returnVar;
   } else if (isParsing) { // ---------------------------------- function, but not executing - just parse args and be done
     jspeParseFunctionCallBrackets();
@@ -1081,8 +1571,97 @@ NO_INLINE JsVar *jspeFactorMember(JsVar *a, JsVar **parentResult) {
 
           JsVar *aVar = jsvSkipName(a);
           JsVar *child = 0;
+#ifndef SAVE_ON_FLASH
+          if (aVar) {
+            size_t namePos = jsvStringIteratorGetIndex(&lex->tokenStart.it)-1;
+            JspInlineCache *ic = &jspInlineCache[namePos & (JSPARSE_INLINE_CACHE_SIZE-1)];
+            JsVarRef aRef = jsvGetRef(aVar);
+            if (ic->sourceVar==lex->sourceVar &&
+                ic->namePos==(uint32_t)namePos &&
+                ic->structureVersion==jsVarStructureVersion &&
+                ic->parentRef==aRef) {
+              child = jsvLock(ic->childRef);
+              if (!jsvIsName(child) || !jsvIsStringEqual(child, name)) {
+                // paranoia - shouldn't happen, but a walk is better than a wrong field
+                jsvUnLock(child);
+                child = 0;
+                ic->sourceVar = 0;
+              }
+            }
+            if (!child) {
+              // This is the same lookup jspGetNamedField does, pulled apart
+              // so we only ever cache direct children
+              if (jsvHasChildren(aVar)) {
+                child = jsvFindChildFromString(aVar, name, false);
+                if (child) {
+                  ic->sourceVar = lex->sourceVar;
+                  ic->namePos = (uint32_t)namePos;
+                  ic->structureVersion = jsVarStructureVersion;
+                  ic->parentRef = aRef;
+                  ic->childRef = jsvGetRef(child);
+                }
+              }
+              if (!child) {
+                const char *classKey = jswGetBasicObjectName(aVar);
+                JspBuiltinCache *bc = &jspBuiltinCache[namePos & (JSPARSE_INLINE_CACHE_SIZE-1)];
+                if (classKey && classKey==bc->classKey &&
+                    bc->sourceVar==lex->sourceVar &&
+                    bc->namePos==(uint32_t)namePos &&
+                    bc->structureVersion==jsVarStructureVersion &&
+                    bc->shadowVersion==jsVarShadowVersion &&
+                    (!jsvHasChildren(aVar) || bc->parentRef==aRef)) {
+                  // cached builtin - rebuild the native function without any table work
+                  JsVar *fn = jsvNewNativeFunction(bc->functionPtr, bc->functionSpec);
+                  if (fn) {
+                    JsVar *nameVar = jsvNewFromString(name);
+                    child = jsvCreateNewChild(aVar, nameVar, fn);
+                    jsvUnLock2(nameVar, fn);
+                  }
+                }
+                if (!child) {
+                  /* The same resolution jspGetNamedFieldInParents does,
+                   * pulled apart so we can tell whether the result came
+                   * from the builtin symbol tables (cacheable) or a user
+                   * prototype chain (not) */
+                  child = jspeiFindChildFromStringInParents(aVar, name);
+                  if (!child) {
+                    child = jswFindBuiltInFunction(aVar, name);
+                    if (child && classKey && jsvIsNativeFunction(child)) {
+                      bc->sourceVar = lex->sourceVar;
+                      bc->namePos = (uint32_t)namePos;
+                      bc->structureVersion = jsVarStructureVersion;
+                      bc->shadowVersion = jsVarShadowVersion;
+                      bc->classKey = classKey;
+                      bc->parentRef = aRef;
+                      bc->functionPtr = child->varData.native.ptr;
+                      bc->functionSpec = child->varData.native.argTypes;
+                    }
+                  }
+                  if (child) {
+                    // strip any name and create a new one on aVar (see jspGetNamedFieldInParents)
+                    child = jsvSkipNameAndUnLock(child);
+                    JsVar *nameVar = jsvNewFromString(name);
+                    JsVar *newChild = jsvCreateNewChild(aVar, nameVar, child);
+                    jsvUnLock2(nameVar, child);
+                    child = newChild;
+                  } else if (jsvIsFunction(aVar) && strcmp(name, JSPARSE_PROTOTYPE_VAR)==0) {
+                    // If not found and is the prototype, create it
+                    JsVar *proto = jsvNewObject(); // prototype is supposed to be an object
+                    jsvObjectSetChild(proto, JSPARSE_CONSTRUCTOR_VAR, aVar);
+                    child = jsvAddNamedChild(aVar, proto, JSPARSE_PROTOTYPE_VAR);
+                    jspEnsureIsPrototype(aVar, child);
+                    jsvUnLock(proto);
+                  } else if (strcmp(name, JSPARSE_INHERITS_VAR)==0 && classKey) {
+                    child = jspNewPrototype(classKey);
+                  }
+                }
+              }
+            }
+          }
+#else
           if (aVar)
             child = jspGetNamedField(aVar, name, true);
+#endif
           if (!child) {
             if (jsvHasChildren(aVar)) {
               // if no child found, create a pointer to where it could be
@@ -1485,7 +2064,45 @@ NO_INLINE JsVar *jspeExpressionOrArrowFunction() {
 
 NO_INLINE JsVar *jspeFactor() {
   if (lex->tk==LEX_ID) {
+#ifndef SAVE_ON_FLASH
+    /* Inline cache for variable reads, working just like the one for
+     * obj.field in jspeFactorMember: remember which name var this source
+     * position resolved to, keyed on the innermost scope so each call
+     * frame revalidates, and trust it only while jsVarStructureVersion
+     * says no name anywhere has been freed or declared since. */
+    JsVar *a = 0;
+    if (JSP_SHOULD_EXECUTE) {
+      const char *tokenName = jslGetTokenValueAsString(lex);
+      size_t namePos = jsvStringIteratorGetIndex(&lex->tokenStart.it)-1;
+      JspInlineCache *ic = &jspScopeCache[namePos & (JSPARSE_INLINE_CACHE_SIZE-1)];
+      JsVar *topScope = execInfo.scopeCount ? execInfo.scopes[execInfo.scopeCount-1] : execInfo.root;
+      JsVarRef topScopeRef = jsvGetRef(topScope);
+      if (ic->sourceVar==lex->sourceVar &&
+          ic->namePos==(uint32_t)namePos &&
+          ic->structureVersion==jsVarStructureVersion &&
+          ic->parentRef==topScopeRef) {
+        a = jsvLock(ic->childRef);
+        if (!jsvIsName(a) || !jsvIsStringEqual(a, tokenName)) {
+          // paranoia - shouldn't happen, but a walk is better than a wrong var
+          jsvUnLock(a);
+          a = 0;
+          ic->sourceVar = 0;
+        }
+      }
+      if (!a) {
+        a = jspGetNamedVariable(tokenName);
+        if (a && jsvGetRefs(a)) { // only cache real existing variables
+          ic->sourceVar = lex->sourceVar;
+          ic->namePos = (uint32_t)namePos;
+          ic->structureVersion = jsVarStructureVersion;
+          ic->parentRef = topScopeRef;
+          ic->childRef = jsvGetRef(a);
+        }
+      }
+    }
+#else
     JsVar *a = jspGetNamedVariable(jslGetTokenValueAsString(lex));
+#endif
     JSP_ASSERT_MATCH(LEX_ID);
 #ifndef SAVE_ON_FLASH
     if (lex->tk==LEX_TEMPLATE_LITERAL)
@@ -1907,6 +2524,7 @@ NO_INLINE JsVar *jspeExpression() {
 NO_INLINE void jspeBlockNoBrackets() {
   if (JSP_SHOULD_EXECUTE) {
     while (lex->tk && lex->tk!='}') {
+      jspYieldWatchdogIfNeeded();
       jsvUnLock(jspeStatement());
       if (JSP_HAS_ERROR) {
         if (lex && !(execInfo.execute&EXEC_ERROR_LINE_REPORTED)) {
@@ -1924,12 +2542,29 @@ NO_INLINE void jspeBlockNoBrackets() {
     }
   } else {
     // fast skip of blocks
+#ifndef SAVE_ON_FLASH
+    /* If we've skipped this block before with this lexer, we know where its
+     * matching bracket is so can seek straight there (see JsLex.blockSkipStart) */
+    size_t blockStart = jsvStringIteratorGetIndex(&lex->tokenStart.it)-1;
+    int cacheIdx = blockStart & (JSLEX_BLOCKSKIP_CACHE_SIZE-1);
+    if (lex->blockSkipStart[cacheIdx] == blockStart+1) {
+      jslSeekTo(lex->blockSkipEnd[cacheIdx]);
+      assert(lex->tk == '}');
+      return;
+    }
+#endif
     int brackets = 0;
     while (lex->tk && (brackets || lex->tk != '}')) {
       if (lex->tk == '{') brackets++;
       if (lex->tk == '}') brackets--;
       JSP_ASSERT_MATCH(lex->tk);
     }
+#ifndef SAVE_ON_FLASH
+    if (lex->tk == '}') {
+      lex->blockSkipStart[cacheIdx] = (uint32_t)(blockStart+1);
+      lex->blockSkipEnd[cacheIdx] = (uint32_t)(jsvStringIteratorGetIndex(&lex->tokenStart.it)-1);
+    }
+#endif
   }
   return;
 }
@@ -1976,7 +2611,12 @@ NO_INLINE JsVar *jspeStatementVar() {
   while (hasComma && lex->tk == LEX_ID && !jspIsInterrupted()) {
     JsVar *a = 0;
     if (JSP_SHOULD_EXECUTE) {
-      a = jspeiFindOnTop(jslGetTokenValueAsString(lex), true);
+      const char *varName = jslGetTokenValueAsString(lex);
+      a = jspeiFindOnTop(varName, false);
+      if (!a) {
+        a = jspeiFindOnTop(varName, true);
+        jsVarStructureVersion++; // new name may shadow cached lookups
+      }
       if (!a) { // out of memory
         jspSetError(false);
         return lastDefined;
@@ -2044,12 +2684,135 @@ NO_INLINE JsVar *jspeStatementSwitch() {
   JSP_MATCH_WITH_CLEANUP_AND_RETURN(')', jsvUnLock(switchOn), 0);
   // shortcut if not executing...
   if (!execute) { jsvUnLock(switchOn); jspeBlock(); return 0; }
+#ifndef SAVE_ON_FLASH
+  size_t switchPos = jsvStringIteratorGetIndex(&lex->tokenStart.it)-1;
+  JspSwitchCache *sc = &jspSwitchCache[switchPos & (JSPARSE_SWITCH_CACHE_SIZE-1)];
+  if (sc->sourceVar==lex->sourceVar && sc->switchPos==(uint32_t)switchPos) {
+    JsVar *switchOnValue = jsvSkipName(switchOn);
+    if (jsvIsInt(switchOnValue)) {
+      JsVarInt val = jsvGetInteger(switchOnValue);
+      int found = -1;
+      int i;
+      for (i=0;i<sc->caseCount;i++)
+        if (sc->caseValue[i]==val) { found=i; break; }
+      /* copy what we need out of the entry - statements we execute below
+       * could contain another switch that reuses this slot */
+      size_t endPos = sc->endPos;
+      size_t defaultPos = sc->defaultPos;
+      JslCharPos restore = jslCharPosClone(&lex->tokenStart);
+      // verify every jump target against the source before executing anything
+      jslSeekTo(endPos);
+      bool targetsOk = lex->tk=='}';
+      if (targetsOk && found<0 && defaultPos) {
+        jslSeekTo(defaultPos);
+        targetsOk = lex->tk==LEX_R_DEFAULT;
+        if (targetsOk) {
+          JSP_ASSERT_MATCH(LEX_R_DEFAULT);
+          targetsOk = lex->tk==':';
+          if (targetsOk) jslGetNextToken();
+        }
+      }
+      if (targetsOk && found>=0) {
+        jslSeekTo(sc->casePos[found]);
+        targetsOk = lex->tk==LEX_R_CASE;
+        if (targetsOk) {
+          jslGetNextToken();
+          bool negated = lex->tk=='-';
+          if (negated) jslGetNextToken();
+          targetsOk = lex->tk==LEX_INT;
+          if (targetsOk) {
+            JsVarInt caseVal = (JsVarInt)stringToInt(jslGetTokenValueAsString(lex));
+            if (negated) caseVal = -caseVal;
+            targetsOk = caseVal==val;
+          }
+          if (targetsOk) { jslGetNextToken(); targetsOk = lex->tk==':'; }
+          if (targetsOk) jslGetNextToken();
+        }
+      }
+      if (!targetsOk) {
+        jslSeekToP(&restore); // stale entry - take the normal path below
+        jslCharPosFree(&restore);
+        jsvUnLock(switchOnValue);
+      } else {
+        jslCharPosFree(&restore);
+        jsvUnLock2(switchOnValue, switchOn);
+        if (found<0 && !defaultPos) {
+          // nothing to run at all - just hop over the whole switch
+          JSP_ASSERT_MATCH('}');
+          return 0;
+        }
+        /* run from the matched case (or default), falling through later
+         * labels. Their tests are known to be literals so skipping them
+         * without evaluation can't lose side effects. */
+        execInfo.execute = EXEC_YES|EXEC_IN_SWITCH;
+        while (!JSP_SHOULDNT_PARSE && lex->tk!=LEX_EOF && lex->tk!='}') {
+          if (lex->tk==LEX_R_CASE) {
+            jslGetNextToken();
+            while (lex->tk!=':' && lex->tk!=LEX_EOF) jslGetNextToken();
+            JSP_MATCH(':');
+            continue;
+          }
+          if (lex->tk==LEX_R_DEFAULT) {
+            jslGetNextToken();
+            JSP_MATCH(':');
+            continue;
+          }
+          jsvUnLock(jspeBlockOrStatement());
+        }
+        if (execInfo.execute & EXEC_RETURN)
+          oldExecute |= EXEC_RETURN;
+        if ((execInfo.execute&EXEC_RUN_MASK)==EXEC_BREAK)
+          execInfo.execute=EXEC_YES|EXEC_IN_SWITCH;
+        JSP_RESTORE_EXECUTE();
+        jslSeekTo(endPos);
+        JSP_ASSERT_MATCH('}');
+        return 0;
+      }
+    } else jsvUnLock(switchOnValue);
+  }
+#endif
   JSP_MATCH_WITH_CLEANUP_AND_RETURN('{', jsvUnLock(switchOn), 0);
 
   bool executeDefault = true;
   if (execute) execInfo.execute=EXEC_NO|EXEC_IN_SWITCH;
+#ifndef SAVE_ON_FLASH
+  /* Candidate dispatch table, built as the normal scan walks the cases and
+   * committed at the closing '}' if every case label was an integer literal */
+  JspSwitchCache build;
+  bool buildCache = lex->tk==LEX_R_CASE;
+  build.sourceVar = lex->sourceVar;
+  build.switchPos = (uint32_t)switchPos;
+  build.defaultPos = 0;
+  build.caseCount = 0;
+#endif
   while (lex->tk==LEX_R_CASE) {
+#ifndef SAVE_ON_FLASH
+    size_t casePos = jsvStringIteratorGetIndex(&lex->tokenStart.it)-1;
+#endif
     JSP_MATCH_WITH_CLEANUP_AND_RETURN(LEX_R_CASE, jsvUnLock(switchOn), 0);
+#ifndef SAVE_ON_FLASH
+    if (buildCache) {
+      if (build.caseCount>=JSPARSE_SWITCH_CACHE_CASES) buildCache = false;
+      else {
+        // peek the test - only a lone integer literal (maybe negated) is cacheable
+        JslCharPos testStart = jslCharPosClone(&lex->tokenStart);
+        bool negated = lex->tk=='-';
+        if (negated) jslGetNextToken();
+        if (lex->tk==LEX_INT) {
+          long long cv = stringToInt(jslGetTokenValueAsString(lex));
+          if (negated) cv = -cv;
+          jslGetNextToken();
+          if (lex->tk==':' && cv>=-0x80000000LL && cv<=0x7FFFFFFFLL) {
+            build.caseValue[build.caseCount] = (JsVarInt)cv;
+            build.casePos[build.caseCount] = (uint32_t)casePos;
+            build.caseCount++;
+          } else buildCache = false;
+        } else buildCache = false;
+        jslSeekToP(&testStart); // always evaluate the test normally below
+        jslCharPosFree(&testStart);
+      }
+    }
+#endif
     JsExecFlags oldFlags = execInfo.execute;
     if (execute) execInfo.execute=EXEC_YES|EXEC_IN_SWITCH;
     JsVar *test = jspeAssignmentExpression();
@@ -2076,6 +2839,10 @@ NO_INLINE JsVar *jspeStatementSwitch() {
   JSP_RESTORE_EXECUTE();
 
   if (lex->tk==LEX_R_DEFAULT) {
+#ifndef SAVE_ON_FLASH
+    if (buildCache)
+      build.defaultPos = (uint32_t)(jsvStringIteratorGetIndex(&lex->tokenStart.it)-1);
+#endif
     JSP_ASSERT_MATCH(LEX_R_DEFAULT);
     JSP_MATCH(':');
     JSP_SAVE_EXECUTE();
@@ -2088,6 +2855,12 @@ NO_INLINE JsVar *jspeStatementSwitch() {
     execInfo.execute = execInfo.execute & (JsExecFlags)~EXEC_BREAK;
     JSP_RESTORE_EXECUTE();
   }
+#ifndef SAVE_ON_FLASH
+  if (buildCache && build.caseCount && lex->tk=='}') {
+    build.endPos = (uint32_t)(jsvStringIteratorGetIndex(&lex->tokenStart.it)-1);
+    jspSwitchCache[build.switchPos & (JSPARSE_SWITCH_CACHE_SIZE-1)] = build;
+  }
+#endif
   JSP_MATCH('}');
   return 0;
 }
@@ -2154,6 +2927,7 @@ NO_INLINE JsVar *jspeStatementDoOrWhile(bool isWhile) {
       jslSeekToP(&whileBodyStart);
       execInfo.execute |= EXEC_IN_LOOP;
       jspDebuggerLoopIfCtrlC();
+      jspYieldWatchdogIfNeeded();
       jsvUnLock(jspeBlockOrStatement());
       if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
       if (execInfo.execute & EXEC_CONTINUE)
@@ -2176,6 +2950,99 @@ NO_INLINE JsVar *jspeStatementDoOrWhile(bool isWhile) {
   return 0;
 }
 
+#ifndef SAVE_ON_FLASH
+/** State for the canonical for loop fast path - see jspeStatementFor.
+ * If the condition and iterator have the shape `i<N` / `i++` (and friends)
+ * we evaluate them directly each iteration instead of seeking the lexer
+ * back and re-parsing them from source. */
+typedef struct {
+  bool valid;          ///< condition+iterator were recognised (and still look sane at runtime)
+  char varName[JSLEX_MAX_TOKEN_LENGTH];   ///< the loop variable
+  short condOp;        ///< '<', '>', LEX_LEQUAL or LEX_GEQUAL
+  bool limitIsVar;     ///< is the limit a variable (else limitConst)?
+  char limitName[JSLEX_MAX_TOKEN_LENGTH]; ///< variable the loop variable is compared against
+  JsVarInt limitConst; ///< or the integer literal it's compared against
+  JsVarInt iterStep;   ///< +1 for `i++`/`++i`, -1 for `i--`/`--i`
+} JspFastForLoop;
+
+/** Called with the lexer at the start of a for loop's condition: set
+ * ffl->valid if it has the canonical `i<N` shape. Moves the lexer - the
+ * caller seeks back afterwards. */
+static void jspeFastForScanCond(JspFastForLoop *ffl) {
+  ffl->valid = false;
+  if (lex->tk != LEX_ID) return;
+  strcpy(ffl->varName, jslGetTokenValueAsString(lex));
+  jslGetNextToken(lex);
+  if (lex->tk!='<' && lex->tk!='>' && lex->tk!=LEX_LEQUAL && lex->tk!=LEX_GEQUAL) return;
+  ffl->condOp = lex->tk;
+  jslGetNextToken(lex);
+  if (lex->tk == LEX_INT) {
+    ffl->limitIsVar = false;
+    ffl->limitConst = (JsVarInt)stringToInt(jslGetTokenValueAsString(lex));
+  } else if (lex->tk == LEX_ID) {
+    ffl->limitIsVar = true;
+    strcpy(ffl->limitName, jslGetTokenValueAsString(lex));
+  } else return;
+  jslGetNextToken(lex);
+  if (lex->tk != ';') return;
+  ffl->valid = true;
+}
+
+/** Called with the lexer at the start of a for loop's iterator: keep
+ * ffl->valid only if it's `i++`, `++i`, `i--` or `--i` on the same variable
+ * the condition used. Moves the lexer - the caller seeks back afterwards. */
+static void jspeFastForScanIter(JspFastForLoop *ffl) {
+  ffl->valid = false;
+  if (lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS) { // prefix
+    ffl->iterStep = (lex->tk==LEX_PLUSPLUS) ? 1 : -1;
+    jslGetNextToken(lex);
+    if (lex->tk!=LEX_ID || strcmp(jslGetTokenValueAsString(lex), ffl->varName)) return;
+    jslGetNextToken(lex);
+  } else if (lex->tk==LEX_ID) { // postfix
+    if (strcmp(jslGetTokenValueAsString(lex), ffl->varName)) return;
+    jslGetNextToken(lex);
+    if (lex->tk!=LEX_PLUSPLUS && lex->tk!=LEX_MINUSMINUS) return;
+    ffl->iterStep = (lex->tk==LEX_PLUSPLUS) ? 1 : -1;
+    jslGetNextToken(lex);
+  } else return;
+  if (lex->tk != ')') return;
+  ffl->valid = true;
+}
+
+/** For-in tries to reuse the loop variable's value var between iterations
+ * rather than allocating a fresh copy of each key. That's only safe if
+ * nothing else took hold of the old value (copy-on-escape: stashing the loop
+ * variable in another var or locking it from the body keeps the old value
+ * alive and we fall back to jsvCopyNameOnly). Rewrites `v` with `key`'s
+ * contents and returns it (the caller's lock is carried over), or returns 0
+ * if it can't be reused. */
+static JsVar *jspeForInRewriteIndex(JsVar *v, JsVar *key, JsVar *loopVar) {
+  if (!v) return 0;
+  if (jsvGetLocks(v)!=1) return 0; // something in the loop body still has it locked
+  JsVarRefCounter refs = jsvGetRefs(v);
+  if (refs>1) return 0; // referenced from another name - it escaped
+  if (refs==1 && (jsvIsNameWithValue(loopVar) || // firstChild is a value, not a reference
+                  jsvGetFirstChild(loopVar)!=jsvGetRef(v)))
+    return 0; // the one reference isn't the loop variable's own
+  if (jsvIsInt(key) && jsvIsInt(v)) {
+    v->varData.integer = key->varData.integer;
+    return v;
+  }
+  if (jsvIsString(key) && jsvIsBasicString(v) && !jsvGetLastChild(v)) {
+    size_t len = jsvGetStringLength(key);
+    if (len > JSVAR_DATA_STRING_LEN) return 0; // wouldn't fit in one var
+    jsvGetStringChars(key, 0, v->varData.str, len);
+    // zero the tail: if this var is later copied and made into a name, bytes
+    // past the string data become the name's child/sibling references
+    if (len < JSVAR_DATA_STRING_LEN)
+      memset(&v->varData.str[len], 0, JSVAR_DATA_STRING_LEN-len);
+    jsvSetCharactersInVar(v, len);
+    return v;
+  }
+  return 0; // key and value types don't match up - just copy
+}
+#endif
+
 NO_INLINE JsVar *jspeStatementFor() {
   JSP_ASSERT_MATCH(LEX_R_FOR);
   JSP_MATCH('(');
@@ -2225,6 +3092,9 @@ NO_INLINE JsVar *jspeStatementFor() {
         JsvIterator it;
         jsvIteratorNew(&it, array, JSIF_DEFINED_ARRAY_ElEMENTS);
         bool hasHadBreak = false;
+#ifndef SAVE_ON_FLASH
+        JsVar *lastIndexValue = 0; // kept locked so jspeForInRewriteIndex can reuse it
+#endif
         while (JSP_SHOULD_EXECUTE && jsvIteratorHasElement(&it) && !hasHadBreak) {
           JsVar *loopIndexVar = jsvIteratorGetKey(&it);
           bool ignore = false;
@@ -2235,19 +3105,33 @@ NO_INLINE JsVar *jspeStatementFor() {
               foundPrototype = jsvSkipName(loopIndexVar);
           }
           if (!ignore) {
-            JsVar *indexValue = jsvIsName(loopIndexVar) ?
-                jsvCopyNameOnly(loopIndexVar, false/*no copy children*/, false/*not a name*/) :
-                loopIndexVar;
+            JsVar *indexValue;
+            if (jsvIsName(loopIndexVar)) {
+#ifndef SAVE_ON_FLASH
+              indexValue = jspeForInRewriteIndex(lastIndexValue, loopIndexVar, forStatement);
+              if (!indexValue)
+#endif
+                indexValue = jsvCopyNameOnly(loopIndexVar, false/*no copy children*/, false/*not a name*/);
+            } else
+              indexValue = loopIndexVar;
             if (indexValue) { // could be out of memory
-              assert(!jsvIsName(indexValue) && jsvGetRefs(indexValue)==0);
+              assert(!jsvIsName(indexValue));
               jsvSetValueOfName(forStatement, indexValue);
+#ifndef SAVE_ON_FLASH
+              if (indexValue!=loopIndexVar && indexValue!=lastIndexValue) {
+                jsvUnLock(lastIndexValue);
+                lastIndexValue = indexValue; // hang on to our lock for next time round
+              }
+#else
               if (indexValue!=loopIndexVar) jsvUnLock(indexValue);
+#endif
 
               jsvIteratorNext(&it);
 
               jslSeekToP(&forBodyStart);
               execInfo.execute |= EXEC_IN_LOOP;
               jspDebuggerLoopIfCtrlC();
+              jspYieldWatchdogIfNeeded();
               jsvUnLock(jspeBlockOrStatement());
               if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
 
@@ -2270,6 +3154,9 @@ NO_INLINE JsVar *jspeStatementFor() {
           }
         }
         assert(!foundPrototype);
+#ifndef SAVE_ON_FLASH
+        jsvUnLock(lastIndexValue);
+#endif
         jsvIteratorFree(&it);
       } else if (!jsvIsUndefined(array)) {
         jsExceptionHere(JSET_ERROR, "FOR loop can only iterate over Arrays, Strings or Objects, not %t", array);
@@ -2293,6 +3180,16 @@ NO_INLINE JsVar *jspeStatementFor() {
     jsvUnLock(forStatement);
     JSP_MATCH(';');
     JslCharPos forCondStart = jslCharPosClone(&lex->tokenStart);
+#ifndef SAVE_ON_FLASH
+    JspFastForLoop ffl;
+    ffl.valid = false;
+    JsVar *fastIterName = 0, *fastLimitName = 0;
+    unsigned int fastVersion = 0;
+    if (JSP_SHOULD_EXECUTE) {
+      jspeFastForScanCond(&ffl);
+      jslSeekToP(&forCondStart); // the scan moved the lexer - go back
+    }
+#endif
     if (lex->tk != ';') {
       JsVar *cond = jspeAssignmentExpression(); // condition
       loopCond = JSP_SHOULD_EXECUTE && jsvGetBoolAndUnLock(jsvSkipName(cond));
@@ -2300,6 +3197,12 @@ NO_INLINE JsVar *jspeStatementFor() {
     }
     JSP_MATCH_WITH_CLEANUP_AND_RETURN(';',jslCharPosFree(&forCondStart);,0);
     JslCharPos forIterStart = jslCharPosClone(&lex->tokenStart);
+#ifndef SAVE_ON_FLASH
+    if (ffl.valid) {
+      jspeFastForScanIter(&ffl);
+      jslSeekToP(&forIterStart); // the scan moved the lexer - go back
+    }
+#endif
     if (lex->tk != ')')  { // we could have 'for (;;)'
       JSP_SAVE_EXECUTE();
       jspSetNoExecute();
@@ -2333,6 +3236,53 @@ NO_INLINE JsVar *jspeStatementFor() {
         && loopCount-->0
 #endif
     ) {
+#ifndef SAVE_ON_FLASH
+      bool condDone = false;
+      if (ffl.valid) {
+        /* Canonical `i<N` condition - compare the values directly rather
+         * than re-parsing. The names are resolved once and kept until
+         * jsVarStructureVersion changes (when a scope var might have been
+         * added/removed so the binding has to be looked up again). */
+        if (!fastIterName || fastVersion!=jsVarStructureVersion) {
+          jsvUnLock2(fastIterName, fastLimitName);
+          fastIterName = jspeiFindInScopes(ffl.varName);
+          fastLimitName = ffl.limitIsVar ? jspeiFindInScopes(ffl.limitName) : 0;
+          fastVersion = jsVarStructureVersion;
+          if (!fastIterName || !jsvIsName(fastIterName) ||
+              (ffl.limitIsVar && (!fastLimitName || !jsvIsName(fastLimitName)))) {
+            jsvUnLock2(fastIterName, fastLimitName);
+            fastIterName = 0;
+            fastLimitName = 0;
+            ffl.valid = false; // doesn't resolve to plain variables - give up
+          }
+        }
+        if (ffl.valid) {
+          JsVar *av = jsvSkipName(fastIterName);
+          JsVar *bv = fastLimitName ? jsvSkipName(fastLimitName) : 0;
+          if (jsvIsInt(av) && (!ffl.limitIsVar || (bv && jsvIsInt(bv)))) {
+            JsVarInt ai = jsvGetInteger(av);
+            JsVarInt bi = ffl.limitIsVar ? jsvGetInteger(bv) : ffl.limitConst;
+            if (ffl.condOp=='<') loopCond = ai<bi;
+            else if (ffl.condOp=='>') loopCond = ai>bi;
+            else if (ffl.condOp==LEX_LEQUAL) loopCond = ai<=bi;
+            else loopCond = ai>=bi;
+            condDone = true;
+          } else
+            ffl.valid = false; // not plain integers - give up
+          jsvUnLock2(av, bv);
+        }
+      }
+      if (!condDone) {
+        jslSeekToP(&forCondStart);
+        if (lex->tk == ';') {
+          loopCond = true;
+        } else {
+          JsVar *cond = jspeAssignmentExpression();
+          loopCond = jsvGetBoolAndUnLock(jsvSkipName(cond));
+          jsvUnLock(cond);
+        }
+      }
+#else
       jslSeekToP(&forCondStart);
       ;
       if (lex->tk == ';') {
@@ -2342,10 +3292,12 @@ NO_INLINE JsVar *jspeStatementFor() {
         loopCond = jsvGetBoolAndUnLock(jsvSkipName(cond));
         jsvUnLock(cond);
       }
+#endif
       if (JSP_SHOULD_EXECUTE && loopCond) {
         jslSeekToP(&forBodyStart);
         execInfo.execute |= EXEC_IN_LOOP;
         jspDebuggerLoopIfCtrlC();
+        jspYieldWatchdogIfNeeded();
         jsvUnLock(jspeBlockOrStatement());
         if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
         if (execInfo.execute & EXEC_CONTINUE)
@@ -2356,10 +3308,35 @@ NO_INLINE JsVar *jspeStatementFor() {
         }
       }
       if (JSP_SHOULD_EXECUTE && loopCond && !hasHadBreak) {
+#ifndef SAVE_ON_FLASH
+        bool iterDone = false;
+        if (ffl.valid && fastIterName) {
+          // canonical `i++` - step the value directly rather than re-parsing
+          JsVar *v = jsvSkipName(fastIterName);
+          if (jsvIsInt(v)) {
+            JsVar *n = jsvNewFromInteger(jsvGetInteger(v) + ffl.iterStep);
+            if (n) {
+              jsvSetValueOfName(fastIterName, n);
+              jsvUnLock(n);
+            }
+            iterDone = true;
+          } else
+            ffl.valid = false; // not a plain integer any more - give up
+          jsvUnLock(v);
+        }
+        if (!iterDone) {
+          jslSeekToP(&forIterStart);
+          if (lex->tk != ')') jsvUnLock(jspeExpression());
+        }
+#else
         jslSeekToP(&forIterStart);
         if (lex->tk != ')') jsvUnLock(jspeExpression());
+#endif
       }
     }
+#ifndef SAVE_ON_FLASH
+    jsvUnLock2(fastIterName, fastLimitName);
+#endif
     jslSeekToP(&forBodyEnd);
 
     jslCharPosFree(&forCondStart);
@@ -2389,8 +3366,10 @@ NO_INLINE JsVar *jspeStatementTry() {
     hadCatch = true;
     JSP_MATCH('(');
     JsVar *exceptionVar = 0;
-    if (hadException)
+    if (hadException) {
       exceptionVar = jspeiFindOnTop(jslGetTokenValueAsString(lex), true);
+      jsVarStructureVersion++; // may have created a name that shadows cached lookups
+    }
     JSP_MATCH(LEX_ID);
     JSP_MATCH(')');
     if (exceptionVar) {
@@ -2476,6 +3455,7 @@ NO_INLINE JsVar *jspeStatementFunctionDecl() {
     // find a function with the same name (or make one)
     // OPT: can Find* use just a JsVar that is a 'name'?
     JsVar *existingName = jspeiFindNameOnTop(funcName, true);
+    jsVarStructureVersion++; // may have created a name that shadows cached lookups
     JsVar *existingFunc = jsvSkipName(existingName);
     if (jsvIsFunction(existingFunc)) {
       // 'proper' replace, that keeps the original function var and swaps the children
@@ -2597,6 +3577,7 @@ NO_INLINE JsVar *jspNewPrototype(const char *instanceOf) {
   if (!objFuncName) // out of memory
     return 0;
 
+  bool materialised = false;
   JsVar *objFunc = jsvSkipName(objFuncName);
   if (!objFunc) {
     objFunc = jspNewBuiltin(instanceOf);
@@ -2607,12 +3588,21 @@ NO_INLINE JsVar *jspNewPrototype(const char *instanceOf) {
 
     // set up name
     jsvSetValueOfName(objFuncName, objFunc);
+    materialised = true;
   }
 
   JsVar *prototypeName = jsvFindChildFromString(objFunc, JSPARSE_PROTOTYPE_VAR, true);
+  if (prototypeName && !jsvGetFirstChild(prototypeName))
+    materialised = true;
   jspEnsureIsPrototype(objFunc, prototypeName); // make sure it's an object
   jsvUnLock2(objFunc, objFuncName);
 
+  /* Builtin lookups normally come straight out of the const symbol tables, so
+   * on tight boards it's worth being able to spot code that pulls whole class
+   * objects into RAM (eg. touching __proto__ or monkey-patching a prototype) */
+  if (materialised && jsfGetFlag(JSF_WARN_BUILTIN_ALLOC))
+    jsWarn("Materialising %s in RAM", instanceOf);
+
   return prototypeName;
 }
 
@@ -2688,9 +3678,32 @@ void jspSoftInit() {
   // Root now has a lock and a ref
   execInfo.hiddenRoot = jsvObjectGetChild(execInfo.root, JS_HIDDEN_CHAR_STR, JSV_OBJECT);
   execInfo.execute = EXEC_YES;
+#ifndef SAVE_ON_FLASH
+  if (!jspReservedError) {
+    JsVar *msg = jsvNewFromString("Out of Memory");
+    if (msg) jspReservedError = jswrap_error_constructor(msg);
+    jsvUnLock(msg);
+  }
+#endif
 }
 
 void jspSoftKill() {
+#ifndef SAVE_ON_FLASH
+  // drop any pooled call frames - they reference vars we're about to free
+  int i;
+  for (i=0;i<JSPARSE_FRAME_POOL_SIZE;i++) {
+    jsvUnLock2(jspFramePoolFunction[i], jspFramePoolFrame[i]);
+    jspFramePoolFunction[i] = 0;
+    jspFramePoolFrame[i] = 0;
+  }
+  // stats reference refs of vars we're about to free
+  jspFunctionStatsEnabled = false;
+  jspFunctionStatsReset();
+#endif
+#ifndef SAVE_ON_FLASH
+  jsvUnLock(jspReservedError);
+  jspReservedError = 0;
+#endif
   jsvUnLock(execInfo.hiddenRoot);
   execInfo.hiddenRoot = 0;
   jsvUnLock(execInfo.root);
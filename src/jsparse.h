@@ -52,9 +52,28 @@ void jspSetError(bool lineReported);
 void jspSetException(JsVar *value);
 /** Return the reported exception if there was one (and clear it) */
 JsVar *jspGetException();
+#ifndef SAVE_ON_FLASH
+/** Get the error preallocated at boot, for throwing when there's no memory
+ * left to build one (or 0 if even that failed) */
+JsVar *jspGetReservedError();
+#endif
 /** Return a stack trace string if there was one (and clear it) */
 JsVar *jspGetStackTrace();
 
+#ifndef SAVE_ON_FLASH
+/// Opt-in per-function call statistics - see E.getFunctionStats
+typedef struct {
+  JsVarRef ref;   ///< ref of the function var (0 = empty slot)
+  uint32_t calls; ///< how often it was called
+  JsSysTime time; ///< cumulative (inclusive) execution time
+} JspFunctionStat;
+#define JSPARSE_FUNCTION_STATS 64 // entries in the table - must be a power of 2
+extern bool jspFunctionStatsEnabled;
+extern JspFunctionStat jspFunctionStats[JSPARSE_FUNCTION_STATS];
+/// Zero the function stats table
+void jspFunctionStatsReset();
+#endif
+
 /** Evaluate the given variable as an expression (in current scope) */
 JsVar *jspEvaluateExpressionVar(JsVar *str);
 /** Execute code form a variable and return the result. If lineNumberOffset
@@ -67,6 +86,12 @@ JsVar *jspEvaluateVar(JsVar *str, JsVar *scope, uint16_t lineNumberOffset);
 JsVar *jspEvaluate(const char *str, bool stringIsStatic);
 JsVar *jspExecuteFunction(JsVar *func, JsVar *thisArg, int argCount, JsVar **argPtr);
 
+#ifdef USE_HOT_FUNCTIONS
+/** Build a pretokenised copy of the given function code (whitespace and
+ * comments stripped, keywords as single token bytes), or 0 on failure */
+JsVar *jspTokeniseFunctionCode(JsVar *functionCode);
+#endif
+
 /// Evaluate a JavaScript module and return its exports
 JsVar *jspEvaluateModule(JsVar *moduleContents);
 
@@ -37,7 +37,7 @@ bool jshIsPinValid(Pin pin) {
   return pin < JSH_PIN_COUNT && (pinInfo[pin].port&JSH_PORT_MASK) != JSH_PORT_NONE;
 }
 
-Pin jshGetPinFromString(const char *s) {
+static Pin jshGetPinFromStringInternal(const char *s) {
   if ((s[0]>='A' && s[0]<='I') && s[1]) {
     int port = JSH_PORTA+s[0]-'A';
     int pin = -1;
@@ -95,6 +95,31 @@ Pin jshGetPinFromString(const char *s) {
   return PIN_UNDEFINED;
 }
 
+Pin jshGetPinFromString(const char *s) {
+#ifdef PIN_NAMES_DIRECT
+  /* These boards scan the whole pin table per lookup, and the same pin name
+   * tends to be used over and over - pinInfo never changes, so a successful
+   * lookup can simply be memoized. Names are at most 4 chars ("A123"), so
+   * they pack into a word for the compare. */
+  static uint32_t lastName = 0;
+  static Pin lastPin = PIN_UNDEFINED;
+  uint32_t name = 0;
+  if (s[0] && s[1]) {
+    if (!s[2])      name = (uint32_t)s[0] | (uint32_t)(s[1]<<8);
+    else if (!s[3]) name = (uint32_t)s[0] | (uint32_t)(s[1]<<8) | (uint32_t)(s[2]<<16);
+    else if (!s[4]) name = (uint32_t)s[0] | (uint32_t)(s[1]<<8) | (uint32_t)(s[2]<<16) | ((uint32_t)s[3]<<24);
+  }
+  if (name && name==lastName) return lastPin;
+  Pin pin = jshGetPinFromStringInternal(s);
+  if (name && pin!=PIN_UNDEFINED) {
+    lastName = name;
+    lastPin = pin;
+  }
+  return pin;
+#else
+  return jshGetPinFromStringInternal(s);
+#endif
+}
 
 
 /** Write the pin name to a string. String must have at least 10 characters (to be safe) */
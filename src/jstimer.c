@@ -15,10 +15,55 @@
 #include "jsparse.h"
 #include "jsinteractive.h"
 
+/* utilTimerTasks is a binary min-heap ordered on task time - the soonest task
+ * is always utilTimerTasks[0]. Insertion and removal are O(log n) sifts so the
+ * interrupts-off window stays small and bounded however many tasks are queued
+ * (the old scheme shifted the whole array to keep it sorted). */
 UtilTimerTask utilTimerTasks[UTILTIMERTASK_TASKS];
-volatile unsigned char utilTimerTasksHead = 0;
-volatile unsigned char utilTimerTasksTail = 0;
+volatile unsigned char utilTimerTasksCount = 0;
+#ifndef SAVE_ON_FLASH
+volatile unsigned char utilTimerTasksHighWater = 0; ///< most tasks ever queued at once (see jstGetUtilTimerTasksHighWater)
+volatile bool utilTimerTasksOverflowed = false; ///< the queue hit full - cleared by jstUtilTimerOverflowed
+#endif
+
+
+/// Move the task at index i up towards the heap root until its time is in order
+static void utilTimerHeapSiftUp(unsigned int i) {
+  while (i) {
+    unsigned int parent = (i-1)>>1;
+    if (utilTimerTasks[parent].time <= utilTimerTasks[i].time) break;
+    UtilTimerTask t = utilTimerTasks[parent];
+    utilTimerTasks[parent] = utilTimerTasks[i];
+    utilTimerTasks[i] = t;
+    i = parent;
+  }
+}
 
+/// Move the task at index i down away from the heap root until its time is in order
+static void utilTimerHeapSiftDown(unsigned int i) {
+  for (;;) {
+    unsigned int child = 2*i+1;
+    if (child >= utilTimerTasksCount) break;
+    if (child+1 < utilTimerTasksCount &&
+        utilTimerTasks[child+1].time < utilTimerTasks[child].time)
+      child++;
+    if (utilTimerTasks[i].time <= utilTimerTasks[child].time) break;
+    UtilTimerTask t = utilTimerTasks[child];
+    utilTimerTasks[child] = utilTimerTasks[i];
+    utilTimerTasks[i] = t;
+    i = child;
+  }
+}
+
+/// Remove the task at index i - O(log n). Interrupts must be off
+static void utilTimerHeapRemove(unsigned int i) {
+  utilTimerTasksCount--;
+  if (i == utilTimerTasksCount) return; // it was the last task
+  utilTimerTasks[i] = utilTimerTasks[utilTimerTasksCount];
+  // the replacement could belong in either direction
+  utilTimerHeapSiftDown(i);
+  utilTimerHeapSiftUp(i);
+}
 
 volatile bool utilTimerOn = false;
 unsigned int utilTimerBit;
@@ -78,10 +123,10 @@ static inline unsigned char *jstUtilTimerInterruptHandlerByte(UtilTimerTask *tas
 void jstUtilTimerInterruptHandler() {
   if (utilTimerOn) {
     utilTimerInIRQ = true;
-    JsSysTime time = jshGetSystemTime();
-    // execute any timers that are due
-    while (utilTimerTasksTail!=utilTimerTasksHead && utilTimerTasks[utilTimerTasksTail].time <= time) {
-      UtilTimerTask *task = &utilTimerTasks[utilTimerTasksTail];
+    JsSysTime time = jshGetSystemTimeFast();
+    // execute any timers that are due - the soonest is always the heap root
+    while (utilTimerTasksCount && utilTimerTasks[0].time <= time) {
+      UtilTimerTask *task = &utilTimerTasks[0];
       void (*executeFn)(JsSysTime time, void* userdata) = 0;
       void *executeData = 0;
 
@@ -129,12 +174,11 @@ void jstUtilTimerInterruptHandler() {
         jstUtilTimerInterruptHandlerNextByte(task);
         task->data.buffer.currentValue = (unsigned short)sum;
         // now search for other tasks writing to this pin... (polyphony)
-        int t = (utilTimerTasksTail+1) & (UTILTIMERTASK_TASKS-1);
-        while (t!=utilTimerTasksHead) {
-          if (UET_IS_BUFFER_WRITE_EVENT(utilTimerTasks[t].type) && 
+        unsigned int t;
+        for (t=1;t<utilTimerTasksCount;t++) { // current task is index 0
+          if (UET_IS_BUFFER_WRITE_EVENT(utilTimerTasks[t].type) &&
               utilTimerTasks[t].data.buffer.pinFunction == task->data.buffer.pinFunction)
             sum += ((int)(unsigned int)utilTimerTasks[t].data.buffer.currentValue) - 32768;
-          t = (t+1) & (UTILTIMERTASK_TASKS-1);
         }
         // saturate
         if (sum<0) sum = 0;
@@ -143,6 +187,24 @@ void jstUtilTimerInterruptHandler() {
         jshSetOutputValue(task->data.buffer.pinFunction, sum);
         break;
       }
+      case UET_PULSE_TRAIN: {
+        jshPinSetValue(task->data.buffer.pin, task->data.buffer.currentValue&1);
+        task->data.buffer.currentValue = (unsigned short)(1 - (task->data.buffer.currentValue&1));
+        if (task->data.buffer.var) {
+          // read the next edge's duration - 4 bytes, LSB first
+          uint32_t d = 0;
+          int k;
+          for (k=0;k<4;k++) {
+            d |= (uint32_t)*jstUtilTimerInterruptHandlerByte(task) << (8*k);
+            jstUtilTimerInterruptHandlerNextByte(task);
+          }
+          /* if that was the final duration NextByte cleared repeatInterval,
+           * but we still owe one more edge - so set it regardless */
+          task->repeatInterval = d;
+        } else
+          task->repeatInterval = 0; // that was the final edge - all done
+        break;
+      }
 #endif
       case UET_WAKEUP: // we've already done our job by waking the device up
       default: break;
@@ -152,22 +214,16 @@ void jstUtilTimerInterruptHandler() {
         // update time (we know time > task->time) - what if we're being asked to do too fast? skip one (or 500 :)
         unsigned int t = ((unsigned int)(time+task->repeatInterval - task->time)) / task->repeatInterval;
         if (t<1) t=1;
+#ifndef SAVE_ON_FLASH
+        // a pulse train mustn't skip - each fire consumes one queued edge
+        if (task->type == UET_PULSE_TRAIN) t=1;
+#endif
         task->time = task->time + (JsSysTime)task->repeatInterval*t;
-        // do an in-place bubble sort to ensure that times are still in the right order
-        unsigned char ta = utilTimerTasksTail;
-        unsigned char tb = (ta+1) & (UTILTIMERTASK_TASKS-1);
-        while (tb != utilTimerTasksHead) {
-          if (utilTimerTasks[ta].time > utilTimerTasks[tb].time) {
-            UtilTimerTask task = utilTimerTasks[ta];
-            utilTimerTasks[ta] = utilTimerTasks[tb];
-            utilTimerTasks[tb] = task;
-          }
-          ta = tb;
-          tb = (tb+1) & (UTILTIMERTASK_TASKS-1);
-        }
+        // sift the rescheduled task down to its new place in the heap
+        utilTimerHeapSiftDown(0);
       } else {
-        // Otherwise no repeat - just go straight to the next one!
-        utilTimerTasksTail = (utilTimerTasksTail+1) & (UTILTIMERTASK_TASKS-1);
+        // Otherwise no repeat - pop it off the heap
+        utilTimerHeapRemove(0);
       }
 
       // execute the function if we had one (we do this now, because if we did it earlier we'd have to cope with everything changing)
@@ -175,8 +231,8 @@ void jstUtilTimerInterruptHandler() {
     }
 
     // re-schedule the timer if there is something left to do
-    if (utilTimerTasksTail != utilTimerTasksHead) {
-      jshUtilTimerReschedule(utilTimerTasks[utilTimerTasksTail].time - time);
+    if (utilTimerTasksCount) {
+      jshUtilTimerReschedule(utilTimerTasks[0].time - time);
     } else {
       utilTimerOn = false;
       jshUtilTimerDisable();
@@ -193,14 +249,28 @@ bool jstUtilTimerIsRunning() {
   return utilTimerOn;
 }
 
+/// Get the time of the next utility timer task, false if none are scheduled
+bool jstGetNextTaskTime(JsSysTime *time) {
+  jshInterruptOff(); // tasks are 64 bit - don't let the IRQ move them under us
+  bool hasTask = utilTimerTasksCount != 0;
+  if (hasTask) *time = utilTimerTasks[0].time;
+  jshInterruptOn();
+  return hasTask;
+}
+
 void jstUtilTimerWaitEmpty() {
   WAIT_UNTIL(!jstUtilTimerIsRunning(), "Utility Timer");
 }
 
 /// Is the timer full - can it accept any other signals?
 static bool utilTimerIsFull() {
-  unsigned char nextHead = (utilTimerTasksHead+1) & (UTILTIMERTASK_TASKS-1);
-  return nextHead == utilTimerTasksTail;
+  bool full = utilTimerTasksCount >= UTILTIMERTASK_TASKS;
+#ifndef SAVE_ON_FLASH
+  /* note it even if the caller is just going to block - the idle loop turns
+   * this into E.on('timerFull') so full queues get seen, not guessed at */
+  if (full) utilTimerTasksOverflowed = true;
+#endif
+  return full;
 }
 
 // Queue a task up to be executed when a timer fires... return false on failure
@@ -208,33 +278,22 @@ bool utilTimerInsertTask(UtilTimerTask *task) {
   // check if queue is full or not
   if (utilTimerIsFull()) return false;
 
-
   if (!utilTimerInIRQ) jshInterruptOff();
 
-  // find out where to insert
-  unsigned char insertPos = utilTimerTasksTail;
-  while (insertPos != utilTimerTasksHead && utilTimerTasks[insertPos].time < task->time)
-    insertPos = (insertPos+1) & (UTILTIMERTASK_TASKS-1);
-
-  bool haveChangedTimer = insertPos==utilTimerTasksTail;
-  //jsiConsolePrintf("Insert at %d, Tail is %d\n",insertPos,utilTimerTasksTail);
-  // shift items forward
-  int i = utilTimerTasksHead;
-  while (i != insertPos) {
-    unsigned char next = (i+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-    utilTimerTasks[i] = utilTimerTasks[next];
-    i = next;
-  }
-  // add new item
-  utilTimerTasks[insertPos] = *task;
-  // increase task list size
-  utilTimerTasksHead = (utilTimerTasksHead+1) & (UTILTIMERTASK_TASKS-1);
+  // put the task at the end of the heap and sift it up into place - O(log n)
+  unsigned int i = utilTimerTasksCount++;
+#ifndef SAVE_ON_FLASH
+  if (utilTimerTasksCount > utilTimerTasksHighWater)
+    utilTimerTasksHighWater = utilTimerTasksCount;
+#endif
+  utilTimerTasks[i] = *task;
+  utilTimerHeapSiftUp(i);
+  bool haveChangedTimer = utilTimerTasks[0].time == task->time;
 
-  //jsiConsolePrint("Head is %d\n", utilTimerTasksHead);
   // now set up timer if not already set up...
   if (!utilTimerOn || haveChangedTimer) {
     utilTimerOn = true;
-    jshUtilTimerStart(utilTimerTasks[utilTimerTasksTail].time - jshGetSystemTime());
+    jshUtilTimerStart(utilTimerTasks[0].time - jshGetSystemTimeFast());
   }
 
   if (!utilTimerInIRQ) jshInterruptOn();
@@ -244,50 +303,35 @@ bool utilTimerInsertTask(UtilTimerTask *task) {
 /// Remove the task that that 'checkCallback' returns true for. Returns false if none found
 bool utilTimerRemoveTask(bool (checkCallback)(UtilTimerTask *task, void* data), void *checkCallbackData) {
   jshInterruptOff();
-  unsigned char ptr = utilTimerTasksHead;
-  if (ptr != utilTimerTasksTail) {
-    unsigned char endPtr = ((utilTimerTasksTail+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1));
-    ptr = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-    // now we're at the last timer task - work back until we've just gone back past utilTimerTasksTail
-    while (ptr != endPtr) {
-      if (checkCallback(&utilTimerTasks[ptr], checkCallbackData)) {
-        // shift tail back along
-        unsigned char next = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-        while (next!=endPtr) {
-          utilTimerTasks[ptr] = utilTimerTasks[next];
-          ptr = next;
-          next = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-        }
-        // move 'end' pointer back
-        utilTimerTasksTail = (utilTimerTasksTail+1) & (UTILTIMERTASK_TASKS-1);
-        jshInterruptOn();
-        return true;
-      }
-      ptr = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-    }
+  // find the latest (greatest time) task that matches, as the old
+  // time-ordered list did when searching backwards from the end
+  int found = -1;
+  unsigned int i;
+  for (i=0;i<utilTimerTasksCount;i++) {
+    if (checkCallback(&utilTimerTasks[i], checkCallbackData) &&
+        (found<0 || utilTimerTasks[i].time > utilTimerTasks[found].time))
+      found = (int)i;
   }
+  if (found>=0)
+    utilTimerHeapRemove((unsigned int)found);
   jshInterruptOn();
-  return false;
+  return found>=0;
 }
 
 /// If 'checkCallback' returns true for a task, set 'task' to it and return true. Returns false if none found
 bool utilTimerGetLastTask(bool (checkCallback)(UtilTimerTask *task, void* data), void *checkCallbackData, UtilTimerTask *task) {
   jshInterruptOff();
-  unsigned char ptr = utilTimerTasksHead;
-  if (ptr != utilTimerTasksTail) {
-    ptr = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-    // now we're at the last timer task - work back until we've just gone back past utilTimerTasksTail
-    while (ptr != ((utilTimerTasksTail+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1))) {
-      if (checkCallback(&utilTimerTasks[ptr], checkCallbackData)) {
-        *task = utilTimerTasks[ptr];
-        jshInterruptOn();
-        return true;
-      }
-      ptr = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-    }
+  // 'last' = the matching task with the greatest time
+  int found = -1;
+  unsigned int i;
+  for (i=0;i<utilTimerTasksCount;i++) {
+    if (checkCallback(&utilTimerTasks[i], checkCallbackData) &&
+        (found<0 || utilTimerTasks[i].time > utilTimerTasks[found].time))
+      found = (int)i;
   }
+  if (found>=0) *task = utilTimerTasks[found];
   jshInterruptOn();
-  return false;
+  return found>=0;
 }
 
 // --------------------------------------------------------------------------------------------
@@ -371,30 +415,30 @@ bool jstPinPWM(JsVarFloat freq, JsVarFloat dutyCycle, Pin pin) {
   }
 
   // First, search for existing PWM tasks
-  UtilTimerTask *ptaskon=0, *ptaskoff=0;
+  int taskonIdx=-1, taskoffIdx=-1;
   jshInterruptOff();
-  unsigned char ptr = utilTimerTasksHead;
-  if (ptr != utilTimerTasksTail) {
-    ptr = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
-    // now we're at the last timer task - work back until we've just gone back past utilTimerTasksTail
-    while (ptr != ((utilTimerTasksTail+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1))) {
-      if (jstPinTaskChecker(&utilTimerTasks[ptr], (void*)&pin)) {
-        if (utilTimerTasks[ptr].data.set.value)
-          ptaskon = &utilTimerTasks[ptr];
-        else
-          ptaskoff = &utilTimerTasks[ptr];
-      }
-      ptr = (ptr+UTILTIMERTASK_TASKS-1) & (UTILTIMERTASK_TASKS-1);
+  unsigned int ptr;
+  for (ptr=0;ptr<utilTimerTasksCount;ptr++) {
+    if (jstPinTaskChecker(&utilTimerTasks[ptr], (void*)&pin)) {
+      if (utilTimerTasks[ptr].data.set.value)
+        taskonIdx = (int)ptr;
+      else
+        taskoffIdx = (int)ptr;
     }
   }
-  if (ptaskon && ptaskoff) {
+  if (taskonIdx>=0 && taskoffIdx>=0) {
     // Great! We have PWM... Just update it
+    UtilTimerTask *ptaskon = &utilTimerTasks[taskonIdx];
+    UtilTimerTask *ptaskoff = &utilTimerTasks[taskoffIdx];
     if (ptaskoff->time > ptaskon->time)
       ptaskoff->time = ptaskon->time + pulseLength;
     else
       ptaskoff->time = ptaskon->time + pulseLength - (unsigned int)period;
     ptaskon->repeatInterval = (unsigned int)period;
     ptaskoff->repeatInterval = (unsigned int)period;
+    // we moved the off task's time - sift it back into heap order
+    utilTimerHeapSiftDown((unsigned int)taskoffIdx);
+    utilTimerHeapSiftUp((unsigned int)taskoffIdx);
     /* don't bother rescheduling - everything will work out next time
      * the timer fires anyway. */
     // All done - just return!
@@ -404,7 +448,7 @@ bool jstPinPWM(JsVarFloat freq, JsVarFloat dutyCycle, Pin pin) {
   jshInterruptOn();
 
   /// Remove any tasks using the given pin (if they existed)
-  if (ptaskon || ptaskoff) {
+  if (taskonIdx>=0 || taskoffIdx>=0) {
     while (utilTimerRemoveTask(jstPinTaskChecker, (void*)&pin));
   }
   JsSysTime time = jshGetSystemTime();
@@ -466,9 +510,9 @@ bool jstSetWakeUp(JsSysTime period) {
   // work out if we're waiting for a timer,
   // and if so, when it's going to be
   jshInterruptOff();
-  if (utilTimerTasksTail!=utilTimerTasksHead) {
+  if (utilTimerTasksCount) {
     hasTimer = true;
-    nextTime = utilTimerTasks[utilTimerTasksTail].time;
+    nextTime = utilTimerTasks[0].time;
   }
   jshInterruptOn();
 
@@ -489,51 +533,63 @@ bool jstSetWakeUp(JsSysTime period) {
 void jstClearWakeUp() {
   bool removedTimer = false;
   jshInterruptOff();
-  // while the first item is a wakeup, remove it
-  while (utilTimerTasksTail!=utilTimerTasksHead &&
-      utilTimerTasks[utilTimerTasksTail].type == UET_WAKEUP) {
-    utilTimerTasksTail = (utilTimerTasksTail+1) & (UTILTIMERTASK_TASKS-1);
+  // while the soonest item is a wakeup, remove it
+  while (utilTimerTasksCount &&
+      utilTimerTasks[0].type == UET_WAKEUP) {
+    utilTimerHeapRemove(0);
     removedTimer = true;
   }
   // if the queue is now empty, and we stop the timer
-  if (utilTimerTasksTail==utilTimerTasksHead && removedTimer)
+  if (!utilTimerTasksCount && removedTimer)
     jshUtilTimerDisable();
   jshInterruptOn();
 }
 
 #ifndef SAVE_ON_FLASH
 
-bool jstStartSignal(JsSysTime startTime, JsSysTime period, Pin pin, JsVar *currentData, JsVar *nextData, UtilTimerEventType type) {
+/// Fill in a buffer read/write task without scheduling it - see jstStartSignal
+bool jstBuildSignalTask(JsSysTime period, Pin pin, JsVar *currentData, JsVar *nextData, UtilTimerEventType type, UtilTimerTask *task) {
   assert(jsvIsString(currentData));
   assert(jsvIsUndefined(nextData) || jsvIsString(nextData));
   if (!jshIsPinValid(pin)) return false;
-  UtilTimerTask task;
-  task.repeatInterval = (unsigned int)period;
-  task.time = startTime + period;
-  task.type = type;
+  task->repeatInterval = (unsigned int)period;
+  task->type = type;
   if (UET_IS_BUFFER_WRITE_EVENT(type)) {
-    task.data.buffer.pinFunction = jshGetCurrentPinFunction(pin);
-    if (!task.data.buffer.pinFunction) return false; // no pin function found...
+    task->data.buffer.pinFunction = jshGetCurrentPinFunction(pin);
+    if (!task->data.buffer.pinFunction) return false; // no pin function found...
   } else if (UET_IS_BUFFER_READ_EVENT(type)) {
 #ifndef LINUX
     if (pinInfo[pin].analog == JSH_ANALOG_NONE) return false; // no analog...
 #endif
-    task.data.buffer.pin = pin;
+    task->data.buffer.pin = pin;
   } else {
     assert(0);
     return false;
   }
-  task.data.buffer.currentBuffer = jsvGetRef(currentData);
+  task->data.buffer.currentBuffer = jsvGetRef(currentData);
   if (nextData) {
     // then we're repeating!
-    task.data.buffer.nextBuffer = jsvGetRef(nextData);
+    task->data.buffer.nextBuffer = jsvGetRef(nextData);
   } else {
     // then we're not repeating
-    task.data.buffer.nextBuffer = 0;
+    task->data.buffer.nextBuffer = 0;
   }
-  jstUtilTimerSetupBuffer(&task);
+  jstUtilTimerSetupBuffer(task);
+  return true;
+}
 
-  return utilTimerInsertTask(&task);
+/** Schedule a task built with jstBuildSignalTask. Doesn't touch JsVars so
+ * it is safe to call from an IRQ (eg. a pin watch starting a capture). */
+bool jstStartPreparedTask(UtilTimerTask *task, JsSysTime startTime) {
+  task->time = startTime + task->repeatInterval;
+  return utilTimerInsertTask(task);
+}
+
+bool jstStartSignal(JsSysTime startTime, JsSysTime period, Pin pin, JsVar *currentData, JsVar *nextData, UtilTimerEventType type) {
+  UtilTimerTask task;
+  if (!jstBuildSignalTask(period, pin, currentData, nextData, type, &task))
+    return false;
+  return jstStartPreparedTask(&task, startTime);
 }
 
 
@@ -544,26 +600,93 @@ bool jstStopBufferTimerTask(JsVar *var) {
   return utilTimerRemoveTask(jstBufferTaskChecker, (void*)&ref);
 }
 
+// data = *Pin
+static bool jstPulseTrainPinTaskChecker(UtilTimerTask *task, void *data) {
+  return task->type == UET_PULSE_TRAIN &&
+         task->data.buffer.pin == *(Pin*)data;
+}
+
+bool jstStartPulseSequence(JsSysTime startTime, Pin pin, bool value, JsVar *timeData) {
+  assert(jsvIsString(timeData));
+  if (!jshIsPinValid(pin)) return false;
+  UtilTimerTask task;
+  task.repeatInterval = 0;
+  task.time = startTime;
+  task.type = UET_PULSE_TRAIN;
+  task.data.buffer.pin = pin;
+  task.data.buffer.currentValue = value ? 1 : 0;
+  task.data.buffer.currentBuffer = jsvGetRef(timeData);
+  task.data.buffer.nextBuffer = 0;
+  jstUtilTimerSetupBuffer(&task);
+
+  WAIT_UNTIL(!utilTimerIsFull(), "Utility Timer");
+  return utilTimerInsertTask(&task);
+}
+
+bool jstStopPinPulseSequence(Pin pin) {
+  return utilTimerRemoveTask(jstPulseTrainPinTaskChecker, (void*)&pin);
+}
+
 #endif
 
 void jstReset() {
   jshUtilTimerDisable();
-  utilTimerTasksTail = utilTimerTasksHead = 0;
+  utilTimerTasksCount = 0;
+#ifndef SAVE_ON_FLASH
+  utilTimerTasksHighWater = 0;
+  utilTimerTasksOverflowed = false;
+#endif
+}
+
+#ifndef SAVE_ON_FLASH
+/// Number of utility timer tasks currently queued
+int jstGetUtilTimerTasksUsed() {
+  return (int)utilTimerTasksCount;
+}
+
+/** The most tasks that have ever been queued at once (since boot, jstReset,
+ * or the last reset here). If reset is true the mark restarts from the
+ * current occupancy. */
+int jstGetUtilTimerTasksHighWater(bool reset) {
+  jshInterruptOff();
+  int highWater = (int)utilTimerTasksHighWater;
+  if (reset) utilTimerTasksHighWater = utilTimerTasksCount;
+  jshInterruptOn();
+  return highWater;
 }
 
+/// Did the task queue hit full since the last call? Reading clears the flag
+bool jstUtilTimerOverflowed() {
+  bool overflowed = utilTimerTasksOverflowed;
+  utilTimerTasksOverflowed = false;
+  return overflowed;
+}
+#endif
+
 void jstDumpUtilityTimers() {
   int i;
   UtilTimerTask uTimerTasks[UTILTIMERTASK_TASKS];
   jshInterruptOff();
   for (i=0;i<UTILTIMERTASK_TASKS;i++)
     uTimerTasks[i] = utilTimerTasks[i];
-  unsigned char uTimerTasksHead = utilTimerTasksHead;
-  unsigned char uTimerTasksTail = utilTimerTasksTail;
+  unsigned char uTimerTasksCount = utilTimerTasksCount;
   jshInterruptOn();
 
-  unsigned char t = uTimerTasksTail;
+  // the heap isn't stored in strict time order - sort our copy so the
+  // dump reads soonest-first as it always did (n is tiny)
+  for (i=1;i<(int)uTimerTasksCount;i++) {
+    UtilTimerTask task = uTimerTasks[i];
+    int j = i-1;
+    while (j>=0 && uTimerTasks[j].time > task.time) {
+      uTimerTasks[j+1] = uTimerTasks[j];
+      j--;
+    }
+    uTimerTasks[j+1] = task;
+  }
+
+  unsigned char t = 0;
   bool hadTimers = false;
-  while (t!=uTimerTasksHead) {
+  while (t<uTimerTasksCount) {
     hadTimers = true;
 
     UtilTimerTask task = uTimerTasks[t];
@@ -583,12 +706,13 @@ void jstDumpUtilityTimers() {
     case UET_READ_BYTE : jsiConsolePrintf("READ_BYTE\n"); break;
     case UET_WRITE_SHORT : jsiConsolePrintf("WRITE_SHORT\n"); break;
     case UET_READ_SHORT : jsiConsolePrintf("READ_SHORT\n"); break;
+    case UET_PULSE_TRAIN : jsiConsolePrintf("PULSE_TRAIN %p\n", task.data.buffer.pin); break;
 #endif
     case UET_EXECUTE : jsiConsolePrintf("EXECUTE %x(%x)\n", task.data.execute.fn, task.data.execute.userdata); break;
     default : jsiConsolePrintf("Unknown type %d\n", task.type); break;
     }
 
-    t = (t+1) & (UTILTIMERTASK_TASKS-1);
+    t++;
   }
   if (!hadTimers)
       jsiConsolePrintf("No Timers found.\n");
@@ -27,6 +27,7 @@ typedef enum {
   UET_READ_BYTE, ///< Read a byte from an analog input
   UET_WRITE_SHORT, ///< Write a short to a DAC/Timer
   UET_READ_SHORT, ///< Read a short from an analog input
+  UET_PULSE_TRAIN, ///< Set a pin to alternating values with a buffer of durations
 #endif
 } PACKED_FLAGS UtilTimerEventType;
 
@@ -38,7 +39,8 @@ typedef enum {
   ((T)==UET_WRITE_BYTE) || \
   ((T)==UET_READ_BYTE) || \
   ((T)==UET_WRITE_SHORT) || \
-  ((T)==UET_READ_SHORT))
+  ((T)==UET_READ_SHORT) || \
+  ((T)==UET_PULSE_TRAIN))
 
 #define UET_IS_BUFFER_READ_EVENT(T) (\
   ((T)==UET_READ_BYTE) || \
@@ -103,6 +105,9 @@ void jstUtilTimerWaitEmpty();
 /// Return true if the utility timer is running
 bool jstUtilTimerIsRunning();
 
+/// Get the time of the next utility timer task, false if none are scheduled
+bool jstGetNextTaskTime(JsSysTime *time);
+
 /// Return true if a timer task for the given pin exists (and set 'task' to it)
 bool jstGetLastPinTimerTask(Pin pin, UtilTimerTask *task);
 
@@ -132,6 +137,22 @@ void jstClearWakeUp();
 /// Start writing a string out at the given period between samples
 bool jstStartSignal(JsSysTime startTime, JsSysTime period, Pin pin, JsVar *currentData, JsVar *nextData, UtilTimerEventType type);
 
+/// Fill in a buffer read/write task without scheduling it - see jstStartSignal
+bool jstBuildSignalTask(JsSysTime period, Pin pin, JsVar *currentData, JsVar *nextData, UtilTimerEventType type, UtilTimerTask *task);
+
+/** Schedule a task built with jstBuildSignalTask. Doesn't touch JsVars so
+ * it is safe to call from an IRQ (eg. a pin watch starting a capture). */
+bool jstStartPreparedTask(UtilTimerTask *task, JsSysTime startTime);
+
+/** Play a whole pulse train on a pin from inside the timer IRQ. timeData is a
+ * string of little-endian 32 bit durations (in system time units): at startTime
+ * the pin is set to 'value', each subsequent edge toggles it after the next
+ * duration. The caller must keep timeData referenced until playback finishes. */
+bool jstStartPulseSequence(JsSysTime startTime, Pin pin, bool value, JsVar *timeData);
+
+/// Stop a pulse sequence playing on the given pin (false if none was playing)
+bool jstStopPinPulseSequence(Pin pin);
+
 /// Stop a timer task
 bool jstStopBufferTimerTask(JsVar *var);
 
@@ -141,6 +162,15 @@ void jstReset();
 /// Dump the current list of timers
 void jstDumpUtilityTimers();
 
+#ifndef SAVE_ON_FLASH
+/// Number of utility timer tasks currently queued
+int jstGetUtilTimerTasksUsed();
+/// The most tasks ever queued at once. If reset, the mark restarts from the current occupancy
+int jstGetUtilTimerTasksHighWater(bool reset);
+/// Did the task queue hit full since the last call? Reading clears the flag
+bool jstUtilTimerOverflowed();
+#endif
+
 // Queue a task up to be executed when a timer fires... return false on failure
 bool utilTimerInsertTask(UtilTimerTask *task);
 
@@ -217,26 +217,29 @@ NO_INLINE void jsExceptionHere(JsExceptionType type, const char *fmt, ...) {
 
   jsiConsoleRemoveInputLine();
 
-  JsVar *var = jsvNewFromEmptyString();
-  if (!var) {
-    jspSetError(false);
-    return; // out of memory
-  }
-
-  JsvStringIterator it;
-  jsvStringIteratorNew(&it, var, 0);
-  jsvStringIteratorGotoEnd(&it);
+  JsVar *var;
+  if (!strchr(fmt, '%')) {
+    // no format specifiers - the message is just the format string itself
+    var = jsvNewFromString(fmt);
+  } else {
+    var = jsvNewFromEmptyString();
+    if (var) {
+      JsvStringIterator it;
+      jsvStringIteratorNew(&it, var, 0);
+      jsvStringIteratorGotoEnd(&it);
 
-  vcbprintf_callback cb = (vcbprintf_callback)jsvStringIteratorPrintfCallback;
+      vcbprintf_callback cb = (vcbprintf_callback)jsvStringIteratorPrintfCallback;
 
-  va_list argp;
-  va_start(argp, fmt);
-  vcbprintf(cb,&it, fmt, argp);
-  va_end(argp);
+      va_list argp;
+      va_start(argp, fmt);
+      vcbprintf(cb,&it, fmt, argp);
+      va_end(argp);
 
-  jsvStringIteratorFree(&it);
+      jsvStringIteratorFree(&it);
+    }
+  }
 
-  if (type != JSET_STRING) {
+  if (var && type != JSET_STRING) {
     JsVar *obj = 0;
     if (type == JSET_ERROR) obj = jswrap_error_constructor(var);
     else if (type == JSET_SYNTAXERROR) obj = jswrap_syntaxerror_constructor(var);
@@ -246,6 +249,15 @@ NO_INLINE void jsExceptionHere(JsExceptionType type, const char *fmt, ...) {
     jsvUnLock(var);
     var = obj;
   }
+#ifndef SAVE_ON_FLASH
+  // out of memory - throw the error preallocated at boot so there's still
+  // something catchable, rather than silently dropping the exception
+  if (!var) var = jspGetReservedError();
+#endif
+  if (!var) {
+    jspSetError(false);
+    return; // out of memory
+  }
 
   jspSetException(var);
   jsvUnLock(var);
@@ -295,26 +307,29 @@ NO_INLINE void jsExceptionHere_flash(JsExceptionType type, const char *ffmt, ...
 
   jsiConsoleRemoveInputLine();
 
-  JsVar *var = jsvNewFromEmptyString();
-  if (!var) {
-    jspSetError(false);
-    return; // out of memory
-  }
-
-  JsvStringIterator it;
-  jsvStringIteratorNew(&it, var, 0);
-  jsvStringIteratorGotoEnd(&it);
+  JsVar *var;
+  if (!strchr(fmt, '%')) {
+    // no format specifiers - the message is just the format string itself
+    var = jsvNewFromString(fmt);
+  } else {
+    var = jsvNewFromEmptyString();
+    if (var) {
+      JsvStringIterator it;
+      jsvStringIteratorNew(&it, var, 0);
+      jsvStringIteratorGotoEnd(&it);
 
-  vcbprintf_callback cb = (vcbprintf_callback)jsvStringIteratorPrintfCallback;
+      vcbprintf_callback cb = (vcbprintf_callback)jsvStringIteratorPrintfCallback;
 
-  va_list argp;
-  va_start(argp, ffmt);
-  vcbprintf(cb,&it, fmt, argp);
-  va_end(argp);
+      va_list argp;
+      va_start(argp, ffmt);
+      vcbprintf(cb,&it, fmt, argp);
+      va_end(argp);
 
-  jsvStringIteratorFree(&it);
+      jsvStringIteratorFree(&it);
+    }
+  }
 
-  if (type != JSET_STRING) {
+  if (var && type != JSET_STRING) {
     JsVar *obj = 0;
     if (type == JSET_ERROR) obj = jswrap_error_constructor(var);
     else if (type == JSET_SYNTAXERROR) obj = jswrap_syntaxerror_constructor(var);
@@ -324,6 +339,15 @@ NO_INLINE void jsExceptionHere_flash(JsExceptionType type, const char *ffmt, ...
     jsvUnLock(var);
     var = obj;
   }
+#ifndef SAVE_ON_FLASH
+  // out of memory - throw the error preallocated at boot so there's still
+  // something catchable, rather than silently dropping the exception
+  if (!var) var = jspGetReservedError();
+#endif
+  if (!var) {
+    jspSetError(false);
+    return; // out of memory
+  }
 
   jspSetException(var);
   jsvUnLock(var);
@@ -618,14 +642,32 @@ void ftoa_bounded_extra(JsVarFloat val,char *str, size_t len, int radix, int fra
     if (((JsVarInt)(val+stopAtError)) == (1+(JsVarInt)val))
       val = (JsVarFloat)(1+(JsVarInt)val);
 
-    JsVarFloat d = 1;
-    while (d*radix <= val) d*=radix;
-    while (d >= 1) {
-      int v = (int)(val / d);
-      val -= v*d;
-      if (--len <= 0) { *str=0; return; } // bounds check
-      *(str++) = itoch(v);
-      d /= radix;
+    if (radix==10 && val<1e15) {
+      /* the integer part fits a 64 bit int exactly, so pull the digits out
+       * with integer maths rather than a float divide per digit (the
+       * fractional part below is unchanged - its rounding defines our output) */
+      uint64_t iv = (uint64_t)val;
+      val -= (JsVarFloat)iv;
+      char digits[16];
+      int digitCount = 0;
+      do {
+        digits[digitCount++] = itoch((int)(iv%10));
+        iv /= 10;
+      } while (iv);
+      while (digitCount) {
+        if (--len <= 0) { *str=0; return; } // bounds check
+        *(str++) = digits[--digitCount];
+      }
+    } else {
+      JsVarFloat d = 1;
+      while (d*radix <= val) d*=radix;
+      while (d >= 1) {
+        int v = (int)(val / d);
+        val -= v*d;
+        if (--len <= 0) { *str=0; return; } // bounds check
+        *(str++) = itoch(v);
+        d /= radix;
+      }
     }
 #ifndef USE_NO_FLOATS
     if (((fractionalDigits<0) && val>0) || fractionalDigits>0) {
@@ -703,9 +745,13 @@ void vcbprintf(
         else { assert('d' == *fmt); itostr(v, buf, 10); }
         fmt++; // skip over 'd'
         int len = (int)strlen(buf);
-        while (len < digits) {
-          user_callback("0",user_data);
-          len++;
+        if (len < digits) { // emit all the padding zeros in one callback
+          char pad[10]; // digits is a single char, so at most 9
+          int n = digits-len;
+          if (n >= (int)sizeof(pad)) n = (int)sizeof(pad)-1;
+          memset(pad, '0', (size_t)n);
+          pad[n] = 0;
+          user_callback(pad, user_data);
         }
         user_callback(buf,user_data);
         break;
@@ -726,20 +772,36 @@ void vcbprintf(
         bool quoted = fmtChar=='q';
         if (quoted) user_callback("\"",user_data);
         JsVar *v = jsvAsString(va_arg(argp, JsVar*), false/*no unlock*/);
-        buf[1] = 0;
         if (jsvIsString(v)) {
           JsvStringIterator it;
           jsvStringIteratorNew(&it, v, 0);
-          // OPT: this could be faster than it is (sending whole blocks at once)
+          // batch up runs of plain characters so we don't do a callback for each one
+          size_t chars = 0;
           while (jsvStringIteratorHasChar(&it)) {
-            buf[0] = jsvStringIteratorGetChar(&it);
-            if (quoted) {
-              user_callback(escapeCharacter(buf[0]), user_data);
+            char ch = jsvStringIteratorGetChar(&it);
+            const char *escaped = quoted ? escapeCharacter(ch) : 0;
+            if ((escaped && (escaped[0]!=ch || escaped[1])) || !ch) {
+              if (chars) {
+                buf[chars] = 0;
+                user_callback(buf, user_data);
+                chars = 0;
+              }
+              if (escaped) user_callback(escaped, user_data);
+              // an unquoted embedded \0 gets dropped - as it always was
             } else {
-              user_callback(buf,user_data);
+              buf[chars++] = ch;
+              if (chars+1 >= sizeof(buf)) {
+                buf[chars] = 0;
+                user_callback(buf, user_data);
+                chars = 0;
+              }
             }
             jsvStringIteratorNext(&it);
           }
+          if (chars) {
+            buf[chars] = 0;
+            user_callback(buf, user_data);
+          }
           jsvStringIteratorFree(&it);
           jsvUnLock(v);
         }
@@ -761,9 +823,23 @@ void vcbprintf(
       default: assert(0); return; // eep
       }
     } else {
-      buf[0] = *(fmt++);
-      buf[1] = 0;
-      user_callback(&buf[0], user_data);
+      // emit the whole literal run up to the next '%' in one go, rather
+      // than calling back for every single character
+      const char *pct = strchr(fmt, '%');
+      if (!pct) {
+        user_callback(fmt, user_data);
+        return;
+      }
+      size_t run = (size_t)(pct-fmt);
+      while (run) {
+        size_t chunk = run;
+        if (chunk >= sizeof(buf)) chunk = sizeof(buf)-1;
+        memcpy(buf, fmt, chunk);
+        buf[chunk] = 0;
+        user_callback(buf, user_data);
+        fmt += chunk;
+        run -= chunk;
+      }
     }
   }
 }
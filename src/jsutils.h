@@ -258,6 +258,7 @@ typedef int64_t JsSysTime;
 #define JSPARSE_FUNCTION_THIS_NAME JS_HIDDEN_CHAR_STR"ths" // the 'this' variable - for bound functions
 #define JSPARSE_FUNCTION_NAME_NAME JS_HIDDEN_CHAR_STR"nam" // for named functions (a = function foo() { foo(); })
 #define JSPARSE_FUNCTION_LINENUMBER_NAME JS_HIDDEN_CHAR_STR"lin" // The line number offset of the function
+#define JSPARSE_FUNCTION_USES_ARGUMENTS_NAME JS_HIDDEN_CHAR_STR"arg" // present if the body references 'arguments' (so extra unnamed arguments must be kept)
 #define JS_EVENT_PREFIX "#on"
 #define JS_TIMEZONE_VAR "tz"
 
@@ -289,6 +290,19 @@ typedef int64_t JsSysTime;
 /// Used before functions that we want to ensure are not inlined (eg. "void NO_INLINE foo() {}")
 #define NO_INLINE __attribute__ ((noinline))
 
+/** Put before the interpreter's very hottest functions. On the ESP8266 code
+    normally executes from cached SPI flash and an instruction cache miss costs
+    ~40us, which makes performance bimodal - HOT_FUNCTION places the function
+    in IRAM (the .iram1.* input sections the linker scripts already map there)
+    so the interpreter core runs deterministically. IRAM is tiny and shared
+    with the SDK and interrupt code, so use this very sparingly - only the top
+    few functions on the interpreter's critical path. A no-op elsewhere. */
+#if defined(ESP8266)
+#define HOT_FUNCTION __attribute__((section(".iram1.text.hot")))
+#else
+#define HOT_FUNCTION
+#endif
+
 /// Put before functions that we always want inlined
 #if defined(__GNUC__) && !defined(__clang__)
  #if defined(LINK_TIME_OPTIMISATION) && !defined(SAVE_ON_FLASH) && !defined(DEBUG)
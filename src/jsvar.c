@@ -53,8 +53,67 @@ typedef enum {
 } MemBusyType;
 
 volatile bool touchedFreeList = false;
+/** Incremented whenever a name or a var with children is freed (or vars get
+ * moved by defrag) - lets caches of name lookups (see jspeFactorMember's
+ * inline cache) check cheaply that the refs they remembered are still valid */
+unsigned int jsVarStructureVersion = 0;
+/** Incremented whenever a string-named child gets linked into a parent (and
+ * on __proto__/prototype/constructor reassignment - see jspReplaceWith).
+ * While this AND jsVarStructureVersion are unchanged, a lookup that fell
+ * through to the builtin symbol tables is guaranteed to fall through the
+ * same way - nothing can have appeared in a prototype chain to shadow it.
+ * See jspeFactorMember's builtin callsite cache */
+unsigned int jsVarShadowVersion = 0;
 volatile JsVarRef jsVarFirstEmpty; ///< reference of first unused variable (variables are in a linked list)
 volatile MemBusyType isMemoryBusy; ///< Are we doing garbage collection or similar, so can't access memory?
+/** The highest variable that might be in use - everything above this is
+ * guaranteed free. This is what bounds the GC's pause time on boards with big
+ * variable pools that are mostly empty: the mark/sweep loops only have to scan
+ * up to here rather than over the whole of jsVars. It creeps up as variables
+ * are allocated and is made exact again by each GC sweep. */
+volatile JsVarRef jsVarsHighWaterMark = 0;
+#ifndef SAVE_ON_FLASH
+/** Telemetry for E.memStats - lets long-running devices spot memory
+ * degradation (GC pauses creeping up, fragmentation) before it becomes
+ * a failure in the field. */
+volatile uint32_t jsvOpAllocCount = 0; ///< monotonic count of variable allocations - see E.getOpCounters
+static uint32_t jsvOpAllocCountAtGC = 0; ///< jsvOpAllocCount when the last GC pass finished
+volatile uint32_t jsvOpFindChildProbes = 0; ///< probes made looking children up by name - see E.getOpCounters
+unsigned int jsvGCCount = 0; ///< how many GC passes have run
+/// bucket n counts GC passes that took less than (1<<n) ms - the last bucket gets everything longer
+unsigned int jsvGCPauseHistogram[JSV_GC_PAUSE_HISTOGRAM_SIZE];
+#endif
+
+/* Two-level bitmap of free variables - a set bit means free. The lower level
+ * has one bit per JsVar, the summary level one bit per lower-level word (set
+ * if that word has any free bits), so jsvAllocateContiguous can find a run of
+ * N free blocks with a word-scan - skipping 1024 fully-used vars at a time -
+ * instead of hoping the free list happens to be linked in address order.
+ * Kept in sync wherever the free list itself is updated; the GC sweep
+ * re-derives it completely, which also covers jsvDefragment's stale window. */
+#define JSV_BITMAP_WORDS(vars) (((vars)+31)>>5)
+#ifdef RESIZABLE_JSVARS
+static uint32_t *jsvFreeBitmap = 0;
+static uint32_t *jsvFreeBitmapSummary = 0;
+#else
+static uint32_t jsvFreeBitmap[JSV_BITMAP_WORDS(JSVAR_CACHE_SIZE)];
+static uint32_t jsvFreeBitmapSummary[JSV_BITMAP_WORDS(JSV_BITMAP_WORDS(JSVAR_CACHE_SIZE))];
+#endif
+
+static ALWAYS_INLINE void jsvBitmapSetFree(JsVarRef ref) {
+  unsigned int i = (unsigned int)(ref-1);
+  jsvFreeBitmap[i>>5] |= 1U<<(i&31);
+  jsvFreeBitmapSummary[i>>10] |= 1U<<((i>>5)&31);
+}
+static ALWAYS_INLINE void jsvBitmapSetUsed(JsVarRef ref) {
+  unsigned int i = (unsigned int)(ref-1);
+  if (!(jsvFreeBitmap[i>>5] &= ~(1U<<(i&31))))
+    jsvFreeBitmapSummary[i>>10] &= ~(1U<<((i>>5)&31));
+}
+static void jsvBitmapClearAll() {
+  memset(jsvFreeBitmap, 0, sizeof(uint32_t)*JSV_BITMAP_WORDS(jsVarsSize));
+  memset(jsvFreeBitmapSummary, 0, sizeof(uint32_t)*JSV_BITMAP_WORDS(JSV_BITMAP_WORDS(jsVarsSize)));
+}
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
@@ -173,6 +232,7 @@ void jsvCreateEmptyVarList() {
   assert(!isMemoryBusy);
   isMemoryBusy = MEMBUSY_SYSTEM;
   jsVarFirstEmpty = 0;
+  jsvBitmapClearAll(); // rebuilt below - state may have been loaded right into jsVars
   JsVar firstVar; // temporary var to simplify code in the loop below
   jsvSetNextSibling(&firstVar, 0);
   JsVar *lastEmpty = &firstVar;
@@ -183,6 +243,7 @@ void jsvCreateEmptyVarList() {
     if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) {
       jsvSetNextSibling(lastEmpty, i);
       lastEmpty = var;
+      jsvBitmapSetFree(i);
     } else if (jsvIsFlatString(var)) {
       // skip over used blocks for flat strings
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
@@ -200,6 +261,7 @@ void jsvClearEmptyVarList() {
   assert(!isMemoryBusy);
   isMemoryBusy = MEMBUSY_SYSTEM;
   jsVarFirstEmpty = 0;
+  jsvBitmapClearAll(); // nothing is allocatable until jsvCreateEmptyVarList
   JsVarRef i;
   for (i=1;i<=jsVarsSize;i++) {
     JsVar *var = jsvGetAddressOf(i);
@@ -215,6 +277,10 @@ void jsvClearEmptyVarList() {
 }
 
 void jsvSoftInit() {
+  /* we could have just had state loaded directly into jsVars (eg. load()), so
+   * be conservative - the next GC sweep makes this exact again */
+  jsVarsHighWaterMark = (JsVarRef)jsVarsSize;
+  jsVarStructureVersion++; // any cached name refs are now meaningless
   jsvCreateEmptyVarList();
 }
 
@@ -232,6 +298,7 @@ static JsVarRef jsvInitJsVars(JsVarRef start, unsigned int count) {
     v->flags = JSV_UNUSED;
     // v->locks = 0; // locks is 0 anyway because it is stored in flags
     jsvSetNextSibling(v, (JsVarRef)(i+1)); // link to next
+    jsvBitmapSetFree(i);
   }
   jsvSetNextSibling(jsvGetAddressOf((JsVarRef)(start+count-1)), (JsVarRef)0); // set the final one to 0
   return start;
@@ -242,6 +309,8 @@ void jsvInit() {
   jsVarsSize = JSVAR_BLOCK_SIZE;
   jsVarBlocks = malloc(sizeof(JsVar*)); // just 1
   jsVarBlocks[0] = malloc(sizeof(JsVar) * JSVAR_BLOCK_SIZE);
+  jsvFreeBitmap = calloc(JSV_BITMAP_WORDS(jsVarsSize), sizeof(uint32_t));
+  jsvFreeBitmapSummary = calloc(JSV_BITMAP_WORDS(JSV_BITMAP_WORDS(jsVarsSize)), sizeof(uint32_t));
 #endif
 
   jsVarFirstEmpty = jsvInitJsVars(1/*first*/, jsVarsSize);
@@ -255,6 +324,10 @@ void jsvKill() {
     free(jsVarBlocks[i]);
   free(jsVarBlocks);
   jsVarBlocks = 0;
+  free(jsvFreeBitmap);
+  jsvFreeBitmap = 0;
+  free(jsvFreeBitmapSummary);
+  jsvFreeBitmapSummary = 0;
   jsVarsSize = 0;
 #endif
 }
@@ -310,6 +383,16 @@ void jsvSetMemoryTotal(unsigned int jsNewVarCount) {
   unsigned int i;
   for (i=oldBlockCount;i<newBlockCount;i++)
     jsVarBlocks[i] = malloc(sizeof(JsVar) * JSVAR_BLOCK_SIZE);
+  // grow the free bitmap too, zeroing the new words (block sizes are a
+  // multiple of 1024 vars so the old data always ends on a word boundary)
+  unsigned int oldWords = JSV_BITMAP_WORDS(oldSize);
+  unsigned int newWords = JSV_BITMAP_WORDS(jsVarsSize);
+  jsvFreeBitmap = realloc(jsvFreeBitmap, sizeof(uint32_t)*newWords);
+  memset(&jsvFreeBitmap[oldWords], 0, sizeof(uint32_t)*(newWords-oldWords));
+  unsigned int oldSummaryWords = JSV_BITMAP_WORDS(oldWords);
+  unsigned int newSummaryWords = JSV_BITMAP_WORDS(newWords);
+  jsvFreeBitmapSummary = realloc(jsvFreeBitmapSummary, sizeof(uint32_t)*newSummaryWords);
+  memset(&jsvFreeBitmapSummary[oldSummaryWords], 0, sizeof(uint32_t)*(newSummaryWords-oldSummaryWords));
   /** and now reset all the newly allocated vars. We know jsVarFirstEmpty
    * is 0 (because jsiFreeMoreMemory returned 0) so we can just assign it.  */
   assert(!jsVarFirstEmpty);
@@ -390,6 +473,9 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
   JsVar *v = 0;
   jshInterruptOff(); // to allow this to be used from an IRQ
   if (jsVarFirstEmpty!=0) {
+    if (jsVarFirstEmpty > jsVarsHighWaterMark)
+      jsVarsHighWaterMark = jsVarFirstEmpty;
+    jsvBitmapSetUsed(jsVarFirstEmpty);
     v = jsvGetAddressOf(jsVarFirstEmpty); // jsvResetVariable will lock
     jsVarFirstEmpty = jsvGetNextSibling(v); // move our reference to the next in the fr
     touchedFreeList = true;
@@ -397,6 +483,9 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
   jshInterruptOn();
   if (v) {
     assert(v->flags == JSV_UNUSED);
+#ifndef SAVE_ON_FLASH
+    jsvOpAllocCount++;
+#endif
     // Cope with IRQs/multi-threading when getting a new free variable
  /*   JsVarRef empty;
     JsVarRef next;
@@ -441,11 +530,16 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
 
 ALWAYS_INLINE void jsvFreePtrInternal(JsVar *var) {
   assert(jsvGetLocks(var)==0);
+  jsvStringEndCacheInvalidate(var);
+  if (jsvIsName(var) || jsvHasChildren(var))
+    jsVarStructureVersion++;
   var->flags = JSV_UNUSED;
+  JsVarRef ref = jsvGetRef(var); // outside the lock - needs a block search if RESIZABLE_JSVARS
   // add this to our free list
   jshInterruptOff(); // to allow this to be used from an IRQ
   jsvSetNextSibling(var, jsVarFirstEmpty);
-  jsVarFirstEmpty = jsvGetRef(var);
+  jsVarFirstEmpty = ref;
+  jsvBitmapSetFree(ref);
   touchedFreeList = true;
   jshInterruptOn();
 }
@@ -551,11 +645,18 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
 ALWAYS_INLINE JsVarRef jsvGetRef(JsVar *var) {
   if (!var) return 0;
 #ifdef RESIZABLE_JSVARS
+  /* Consecutive calls are almost always for vars in the same block, so try
+   * the block we matched last time before scanning them all - the scan gets
+   * expensive once the pool has grown. Staleness is harmless as we always
+   * range-check before using it. */
+  static unsigned int lastBlock = 0;
   unsigned int i, c = jsVarsSize>>JSVAR_BLOCK_SHIFT;
+  if (lastBlock<c && var>=jsVarBlocks[lastBlock] && var<&jsVarBlocks[lastBlock][JSVAR_BLOCK_SIZE])
+    return (JsVarRef)(1 + (lastBlock<<JSVAR_BLOCK_SHIFT) + (var - jsVarBlocks[lastBlock]));
   for (i=0;i<c;i++) {
     if (var>=jsVarBlocks[i] && var<&jsVarBlocks[i][JSVAR_BLOCK_SIZE]) {
-      JsVarRef r = (JsVarRef)(1 + (i<<JSVAR_BLOCK_SHIFT) + (var - jsVarBlocks[i]));
-      return r;
+      lastBlock = i;
+      return (JsVarRef)(1 + (i<<JSVAR_BLOCK_SHIFT) + (var - jsVarBlocks[i]));
     }
   }
   return 0;
@@ -565,7 +666,7 @@ ALWAYS_INLINE JsVarRef jsvGetRef(JsVar *var) {
 }
 
 /// Lock this reference and return a pointer - UNSAFE for null refs
-ALWAYS_INLINE JsVar *jsvLock(JsVarRef ref) {
+HOT_FUNCTION ALWAYS_INLINE JsVar *jsvLock(JsVarRef ref) {
   JsVar *var = jsvGetAddressOf(ref);
   //var->locks++;
   assert(jsvGetLocks(var) < JSV_LOCK_MAX);
@@ -580,7 +681,7 @@ ALWAYS_INLINE JsVar *jsvLock(JsVarRef ref) {
 }
 
 /// Lock this pointer and return a pointer - UNSAFE for null pointer
-ALWAYS_INLINE JsVar *jsvLockAgain(JsVar *var) {
+HOT_FUNCTION ALWAYS_INLINE JsVar *jsvLockAgain(JsVar *var) {
   assert(var);
   assert(jsvGetLocks(var) < JSV_LOCK_MAX);
   var->flags += JSV_LOCK_ONE;
@@ -594,7 +695,7 @@ ALWAYS_INLINE JsVar *jsvLockAgainSafe(JsVar *var) {
 
 // CALL ONLY FROM jsvUnlock
 // jsvGetLocks(var) must == 0
-static NO_INLINE void jsvUnLockFreeIfNeeded(JsVar *var) {
+static NO_INLINE HOT_FUNCTION void jsvUnLockFreeIfNeeded(JsVar *var) {
   assert(jsvGetLocks(var) == 0);
   /* if we know we're free, then we can just free this variable right now.
    * Loops of variables are handled by the Garbage Collector.
@@ -608,7 +709,7 @@ static NO_INLINE void jsvUnLockFreeIfNeeded(JsVar *var) {
 
 
 /// Unlock this variable - this is SAFE for null variables
-ALWAYS_INLINE void jsvUnLock(JsVar *var) {
+HOT_FUNCTION ALWAYS_INLINE void jsvUnLock(JsVar *var) {
   if (!var) return;
   assert(jsvGetLocks(var)>0);
   var->flags -= JSV_LOCK_ONE;
@@ -670,93 +771,148 @@ JsVarRef jsvUnRefRef(JsVarRef ref) {
   return 0;
 }
 
-JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
+JsVarRef jsvAllocateContiguous(unsigned int requiredBlocks) {
   if (isMemoryBusy) {
     jsErrorFlags |= JSERR_MEMORY_BUSY;
     return 0;
   }
-  // Work out how many blocks we need. One for the header, plus some for the characters
-  size_t requiredBlocks = 1 + ((byteLength+sizeof(JsVar)-1) / sizeof(JsVar));
-
-  JsVar *flatString = 0;
-
-  /* Now try and find a contiguous set of 'requiredBlocks' blocks by
-  searching the free list. This can be done as long as nobody's
-  messed with the free list in the mean time (which we check for with
-  touchedFreeList). If someone has messed with it, we restart.*/
-  bool memoryTouched = true;
-  while (memoryTouched) {
-    memoryTouched = false;
-    touchedFreeList = false;
-    JsVarRef beforeStartBlock = 0;
-    JsVarRef curr = jsVarFirstEmpty;
-    JsVarRef startBlock = curr;
-    unsigned int blockCount = 1;
-    while (curr && !touchedFreeList) {
-      JsVar *currVar = jsvGetAddressOf(curr);
-      JsVarRef next = jsvGetNextSibling(currVar);
+  assert(requiredBlocks>1);
+  JsVarRef foundBlock = 0;
+
+  /* Scan the free bitmap for the best-fitting run of 'requiredBlocks' set
+  bits. Unlike walking the free list this finds runs even when frees have
+  shuffled the list out of address order, and the summary level skips over
+  1024 fully-used vars per word - which makes a full best-fit scan cheap.
+  Best fit matters here: it reuses holes left by same-sized frees instead
+  of carving small allocations out of the biggest run and slowly
+  destroying it. The scan itself runs with interrupts on - we re-check the
+  run under jshInterruptOff before claiming it, in case an IRQ allocated
+  out of it in the meantime. */
+  unsigned int words = JSV_BITMAP_WORDS(jsVarsSize);
+  bool retry = true;
+  while (retry && !foundBlock) {
+    retry = false;
+    unsigned int run = 0, runStart = 0, w = 0;
+    unsigned int bestStart = 0, bestLen = 0;
+    // close the current run - keep it if it fits and beats what we have
+    #define JSV_CLOSE_RUN() do { \
+      if (run>=requiredBlocks && (!bestLen || run<bestLen)) { \
+        bestLen = run; bestStart = runStart; \
+      } run = 0; \
+    } while (0)
+    while (w < words && bestLen != requiredBlocks) {
 #ifdef RESIZABLE_JSVARS
-      if (jsvGetAddressOf(next)==currVar+1) {
-#else
-      if (next == curr+1) {
+      // blocks of vars are malloc'd separately, so runs can't cross them
+      if (!(w & ((JSVAR_BLOCK_SIZE>>5)-1))) JSV_CLOSE_RUN();
 #endif
-        blockCount++;
-        if (blockCount>=requiredBlocks) {
-          JsVar *nextVar = jsvGetAddressOf(next);
-          JsVarRef nextFree = jsvGetNextSibling(nextVar);
-          jshInterruptOff();
-          if (!touchedFreeList) {
-            // we're there! Quickly re-link free list
-            if (beforeStartBlock) {
-              jsvSetNextSibling(jsvGetAddressOf(beforeStartBlock),nextFree);
-            } else {
-              jsVarFirstEmpty = nextFree;
-            }
-            flatString = jsvGetAddressOf(startBlock);
-            // Set up the header block (including one lock)
-            jsvResetVariable(flatString, JSV_FLAT_STRING);
-            flatString->varData.integer = (JsVarInt)byteLength;
-          }
-          jshInterruptOn();
-          // if success, break out!
-          if (flatString) break;
-        }
+      if (!jsvFreeBitmapSummary[w>>5]) {
+        // 32 fully-used words - skip the lot
+        JSV_CLOSE_RUN();
+        w = ((w>>5)+1)<<5;
+        continue;
+      }
+      uint32_t word = jsvFreeBitmap[w];
+      if (w==words-1 && (jsVarsSize&31))
+        word &= (1U<<(jsVarsSize&31))-1; // mask off anything past jsVarsSize (see jsvSetMaxVarsUsed)
+      if (word == 0) {
+        JSV_CLOSE_RUN();
+      } else if (word == 0xFFFFFFFFU) {
+        if (!run) runStart = w<<5;
+        run += 32;
       } else {
-        // this block is not immediately after the last - restart run
-        blockCount = 1;
-        beforeStartBlock = curr;
-        startBlock = next;
+        unsigned int b;
+        for (b=0;b<32;b++) {
+          if (word & (1U<<b)) {
+            if (!run) runStart = (w<<5)+b;
+            run++;
+          } else
+            JSV_CLOSE_RUN();
+        }
       }
-      // move to next!
-      curr = next;
-    }
-    // memory list has been touched - restart!
-    if (touchedFreeList) {
-      memoryTouched = true;
+      w++;
     }
+    JSV_CLOSE_RUN();
+    #undef JSV_CLOSE_RUN
+    if (!bestLen) break; // no run was big enough
+    unsigned int startIdx = bestStart;
+    unsigned int foundEnd = bestStart+requiredBlocks-1;
+    JsVarRef first = (JsVarRef)(startIdx+1); // bitmap index 0 is ref 1
+    JsVarRef last = (JsVarRef)(foundEnd+1);
+    jshInterruptOff();
+    // re-check the run is still all free - an IRQ may have allocated from it
+    bool stillFree = true;
+    unsigned int i;
+    for (i=startIdx;i<=foundEnd;i++)
+      if (!(jsvFreeBitmap[i>>5] & (1U<<(i&31)))) {
+        stillFree = false;
+        break;
+      }
+    if (stillFree) {
+      // unlink the whole run from the free list in a single walk
+      JsVarRef prev = 0;
+      JsVarRef curr = jsVarFirstEmpty;
+      unsigned int removed = 0;
+      while (curr && removed<requiredBlocks) {
+        JsVarRef next = jsvGetNextSibling(jsvGetAddressOf(curr));
+        if (curr>=first && curr<=last) {
+          if (prev) jsvSetNextSibling(jsvGetAddressOf(prev), next);
+          else jsVarFirstEmpty = next;
+          removed++;
+        } else
+          prev = curr;
+        curr = next;
+      }
+      assert(removed==requiredBlocks);
+      for (i=startIdx;i<=foundEnd;i++)
+        jsvBitmapSetUsed((JsVarRef)(i+1));
+      if (last > jsVarsHighWaterMark)
+        jsVarsHighWaterMark = last;
+      /* We did mess with the free list - set it here in case we
+      are trying to allocate in an IRQ while trying to
+      allocate outside the IRQ too */
+      touchedFreeList = true;
+      foundBlock = first;
+    } else // an IRQ stole part of the run - rescan for another
+      retry = true;
+    jshInterruptOn();
   }
+  return foundBlock;
+}
 
-  /* Nope... we couldn't find a free string. It could be because
-   * the free list is fragmented, so GCing might well fix it - which
-   * we'll try. */
-  if (!flatString) {
+JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
+  // Work out how many blocks we need. One for the header, plus some for the characters
+  size_t requiredBlocks = 1 + ((byteLength+sizeof(JsVar)-1) / sizeof(JsVar));
+  // Grab the whole run of blocks in one operation
+  JsVarRef ref = jsvAllocateContiguous((unsigned int)requiredBlocks);
+  if (!ref) {
+    if (isMemoryBusy) return 0;
+    /* Nope... we couldn't find a free string. It could be because
+     * the free list is fragmented, so GCing might well fix it - which
+     * we'll try. */
     if (jsvGarbageCollect())
       return jsvNewFlatStringOfLength(byteLength);
     return 0;
   }
-
-  /* We now have the string! All that's left is to clear it,
-   * which we can do outside of an IRQ */
-  // clear data
+  JsVar *flatString = jsvGetAddressOf(ref);
+  // Set up the header block (including one lock)
+  jsvResetVariable(flatString, JSV_FLAT_STRING);
+  flatString->varData.integer = (JsVarInt)byteLength;
+  /* The blocks are already unlinked from the free list so nobody else can
+   * touch them - clearing the data can happen outside of an IRQ */
   memset((char*)&flatString[1], 0, sizeof(JsVar)*(requiredBlocks-1));
-  /* We did mess with the free list - set it here in case we
-  are trying to create a flat string in an IRQ while trying to
-  make one outside the IRQ too */
-  touchedFreeList = true;
   // and we're done
   return flatString;
 }
 
+JsVar *jsvNewNativeString(char *ptr, size_t len) {
+  if (len > 65535) len = 65535; // nativeStr.len is only 16 bits
+  JsVar *str = jsvNewWithFlags(JSV_NATIVE_STRING);
+  if (!str) return 0; // out of memory
+  str->varData.nativeStr.ptr = ptr;
+  str->varData.nativeStr.len = (uint16_t)len;
+  return str;
+}
+
 JsVar *jsvNewFromString(const char *str) {
   // Create a var
   JsVar *first = jsvNewWithFlags(JSV_STRING_0);
@@ -803,6 +959,45 @@ JsVar *jsvNewStringOfLength(unsigned int byteLength, const char *initialData) {
       return v;
     }
   }
+  // Work out how many blocks the string chain needs, and try and grab them
+  // all in one go rather than one free-list pop per block
+  unsigned int requiredBlocks = 1;
+  if (byteLength > JSVAR_DATA_STRING_LEN)
+    requiredBlocks += (byteLength - JSVAR_DATA_STRING_LEN + JSVAR_DATA_STRING_MAX_LEN-1) / JSVAR_DATA_STRING_MAX_LEN;
+  if (requiredBlocks>1) {
+    JsVarRef firstBlock = jsvAllocateContiguous(requiredBlocks);
+    if (firstBlock) {
+      JsVar *first = jsvGetAddressOf(firstBlock);
+      jsvResetVariable(first, JSV_STRING_0); // sets the lock we return with
+      JsVar *var = jsvLockAgain(first);
+      unsigned int blocksUsed = 1;
+      while (true) {
+        unsigned int l = (unsigned int)jsvGetMaxCharactersInVar(var);
+        if (l>=byteLength) {
+          if (initialData)
+            memcpy(var->varData.str, initialData, byteLength);
+          jsvSetCharactersInVar(var, byteLength);
+          break;
+        }
+        if (initialData) {
+          memcpy(var->varData.str, initialData, l);
+          initialData+=l;
+        }
+        jsvSetCharactersInVar(var, l);
+        byteLength -= l;
+        assert(blocksUsed < requiredBlocks);
+        JsVar *next = jsvGetAddressOf((JsVarRef)(firstBlock+blocksUsed++));
+        jsvResetVariable(next, JSV_STRING_EXT_0);
+        // we don't ref, because StringExts are never reffed as they only have one owner (and ALWAYS have an owner)
+        jsvSetLastChild(var, jsvGetRef(next));
+        jsvUnLock(var);
+        var = next;
+      }
+      jsvUnLock(var);
+      return first;
+    }
+    // no contiguous run free - fall back to block-at-a-time below
+  }
   // Create a var
   JsVar *first = jsvNewWithFlags(JSV_STRING_0);
   if (!first) return 0; // out of memory, will have already set flag
@@ -911,6 +1106,7 @@ JsVar *jsvMakeIntoVariableName(JsVar *var, JsVar *valueOrZero) {
         jsvUnLock(ext);
       }
       jsvSetCharactersInVar(var, JSVAR_DATA_STRING_NAME_LEN);
+      jsvStringEndCacheInvalidate(var); // we're replacing the StringExt chain
       jsvSetLastChild(var, jsvGetRef(startExt));
       jsvSetNextSibling(var, 0);
       jsvSetPrevSibling(var, 0);
@@ -1143,20 +1339,20 @@ size_t jsvGetString(const JsVar *v, char *str, size_t len) {
 /// Get len bytes of string data from this string. Does not error if string len is not equal to len
 size_t jsvGetStringChars(const JsVar *v, size_t startChar, char *str, size_t len) {
   assert(jsvHasCharacterData(v));
-  size_t l = len;
+  size_t l = 0;
   JsvStringIterator it;
   jsvStringIteratorNewConst(&it, v, startChar);
-  while (jsvStringIteratorHasChar(&it)) {
-    if (l--<=0) {
-      jsvStringIteratorFree(&it);
-      return len;
-    }
-    *(str++) = jsvStringIteratorGetChar(&it);
-    jsvStringIteratorNext(&it);
+  // copy a block at a time rather than iterating each character
+  while (jsvStringIteratorHasChar(&it) && l<len) {
+    size_t chunk = jsvStringIteratorGetCharsLeftInBlock(&it);
+    if (chunk > len-l) chunk = len-l;
+    memcpy(&str[l], jsvStringIteratorGetPtr(&it), chunk);
+    l += chunk;
+    jsvStringIteratorSkipInBlock(&it, chunk);
   }
   jsvStringIteratorFree(&it);
-  *str = 0;
-  return len-l;
+  if (l<len) str[l] = 0;
+  return l;
 }
 
 /// Set the Data in this string. This must JUST overwrite - not extend or shrink
@@ -1361,6 +1557,11 @@ char *jsvGetDataPointer(JsVar *v, size_t *len) {
     *len = jsvGetStringLength(v);
     return jsvGetFlatStringPointer(v);
   }
+  if (jsvIsBasicString(v) && !jsvGetLastChild(v)) {
+    // a string small enough to fit in one var - that's flat memory too
+    *len = jsvGetCharactersInVar(v);
+    return v->varData.str;
+  }
   return 0;
 }
 
@@ -1519,15 +1720,33 @@ void jsvAppendStringVar(JsVar *var, const JsVar *str, size_t stridx, size_t maxL
   JsvStringIterator dst;
   jsvStringIteratorNew(&dst, var, 0);
   jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-     * and is less likely to break :) */
+  // now start appending - copy a run at a time: as much as is left in the
+  // source block and still fits in the destination block
   JsvStringIterator it;
   jsvStringIteratorNewConst(&it, str, stridx);
-  while (jsvStringIteratorHasChar(&it) && (maxLength-->0)) {
-    char ch = jsvStringIteratorGetChar(&it);
-    jsvStringIteratorAppend(&dst, ch);
-    jsvStringIteratorNext(&it);
+  while (jsvStringIteratorHasChar(&it) && maxLength>0) {
+    /* Note: jsvGetMaxCharactersInVar returns the wrong (smaller) length for
+     * flat strings, but then space stays 0 and we take the Append path,
+     * which knows to start a new StringExt - just like a lone Append would */
+    size_t maxCh = jsvGetMaxCharactersInVar(dst.var);
+    size_t space = (dst.charsInVar < maxCh) ? maxCh-dst.charsInVar : 0;
+    if (!space) {
+      // destination block is full - Append allocates the next one
+      jsvStringIteratorAppend(&dst, jsvStringIteratorGetChar(&it));
+      if (!dst.var) break; // out of memory
+      jsvStringIteratorNext(&it);
+      maxLength--;
+      continue;
+    }
+    size_t chunk = jsvStringIteratorGetCharsLeftInBlock(&it);
+    if (chunk > maxLength) chunk = maxLength;
+    if (chunk > space) chunk = space;
+    memcpy(&dst.ptr[dst.charsInVar], jsvStringIteratorGetPtr(&it), chunk);
+    dst.charsInVar += chunk;
+    dst.charIdx = dst.charsInVar-1;
+    jsvSetCharactersInVar(dst.var, dst.charsInVar);
+    jsvStringIteratorSkipInBlock(&it, chunk);
+    maxLength -= chunk;
   }
   jsvStringIteratorFree(&it);
   jsvStringIteratorFree(&dst);
@@ -1547,6 +1766,12 @@ void jsvAppendStringVarComplete(JsVar *var, const JsVar *str) {
 
 char jsvGetCharInString(JsVar *v, size_t idx) {
   if (!jsvIsString(v)) return 0;
+  // Fast path - if the string is contiguous in memory we can just
+  // bounds-check and load the byte, with no iterator setup at all
+  size_t len;
+  char *data = jsvGetDataPointer(v, &len);
+  if (data)
+    return (idx < len) ? data[idx] : 0;
 
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, idx);
@@ -1848,7 +2073,7 @@ bool jsvIsVariableDefined(JsVar *a) {
  * ALWAYS locks - so must unlock what it returns. It MAY
  * return 0. Throws a ReferenceError if variable is not defined,
  * but you can check if it will with jsvIsReferenceError */
-JsVar *jsvSkipName(JsVar *a) {
+HOT_FUNCTION JsVar *jsvSkipName(JsVar *a) {
   if (!a) return 0;
   if (jsvIsArrayBufferName(a)) return jsvArrayBufferGetFromName(a);
   if (jsvIsNameInt(a)) return jsvNewFromInteger((JsVarInt)jsvGetFirstChildSigned(a));
@@ -1936,6 +2161,26 @@ bool jsvIsStringEqualOrStartsWithOffset(JsVar *var, const char *str, bool isStar
 
   JsvStringIterator it;
   jsvStringIteratorNew(&it, var, startIdx);
+#ifdef USE_FLASH_MEMORY
+  if (!jsvIsNativeString(var)) {
+    // native strings may point into flash, which can't be read a block at a time
+#endif
+    /* Compare a whole block at a time with memcmp rather than char by char -
+     * string data is contiguous within each block. On a mismatch just fall
+     * through to the loop below, which will find the differing character. */
+    size_t strLen = strlen(str);
+    while (jsvStringIteratorHasChar(&it) && strLen) {
+      size_t chars = jsvStringIteratorGetCharsLeftInBlock(&it);
+      if (chars > strLen) chars = strLen;
+      if (memcmp(jsvStringIteratorGetPtr(&it), str, chars)!=0)
+        break;
+      str += chars;
+      strLen -= chars;
+      jsvStringIteratorSkipInBlock(&it, chars);
+    }
+#ifdef USE_FLASH_MEMORY
+  }
+#endif
   while (jsvStringIteratorHasChar(&it) && *str) {
     if (jsvStringIteratorGetChar(&it) != *str) {
       jsvStringIteratorFree(&it);
@@ -1979,6 +2224,25 @@ int jsvCompareString(JsVar *va, JsVar *vb, size_t starta, size_t startb, bool eq
   JsvStringIterator ita, itb;
   jsvStringIteratorNew(&ita, va, starta);
   jsvStringIteratorNew(&itb, vb, startb);
+#ifdef USE_FLASH_MEMORY
+  if (!jsvIsNativeString(va) && !jsvIsNativeString(vb)) {
+    // native strings may point into flash, which can't be read a block at a time
+#endif
+    /* Fast pre-pass: step over equal data a block at a time with memcmp,
+     * leaving the char-by-char loop below to deal with mismatches and the
+     * ends of the strings. */
+    while (jsvStringIteratorHasChar(&ita) && jsvStringIteratorHasChar(&itb)) {
+      size_t chars = jsvStringIteratorGetCharsLeftInBlock(&ita);
+      size_t bchars = jsvStringIteratorGetCharsLeftInBlock(&itb);
+      if (bchars < chars) chars = bchars;
+      if (memcmp(jsvStringIteratorGetPtr(&ita), jsvStringIteratorGetPtr(&itb), chars)!=0)
+        break;
+      jsvStringIteratorSkipInBlock(&ita, chars);
+      jsvStringIteratorSkipInBlock(&itb, chars);
+    }
+#ifdef USE_FLASH_MEMORY
+  }
+#endif
   // step to first positions
   while (true) {
     int ca = jsvStringIteratorGetCharOrMinusOne(&ita);
@@ -2039,6 +2303,140 @@ int jsvCompareInteger(JsVar *va, JsVar *vb) {
 
 /** Copy only a name, not what it points to. ALTHOUGH the link to what it points to is maintained unless linkChildren=false
     If keepAsName==false, this will be converted into a normal variable */
+/* Objects with lots of children get a hash index attached to them (as a hidden
+ * child right at the front of the child list, whose value is a flat string of
+ * JsVarRef buckets). jsvFindChildFromString then hashes the name and probes the
+ * buckets rather than walking the whole firstChild/nextSibling list. The index
+ * is built lazily the first time a lookup has to walk further than
+ * JSV_OBJECT_HASH_THRESHOLD children, is kept up to date by jsvAddName, and is
+ * simply thrown away if a child is removed (it'll get rebuilt on the next long
+ * lookup). Small objects are stored exactly as before. */
+#define JSV_OBJECT_HASH_THRESHOLD 32
+#define JSV_OBJECT_HASH_NAME JS_HIDDEN_CHAR_STR"hsh"
+
+typedef struct {
+  uint32_t capacity; ///< the number of buckets - always a power of 2
+  uint32_t count;    ///< how many buckets are in use
+} JsvObjectHashHeader;
+
+static unsigned int jsvObjectHashCString(const char *name) {
+  unsigned int h = 5381;
+  while (*name) h = (h*33) ^ (unsigned char)*(name++);
+  return h;
+}
+
+static unsigned int jsvObjectHashNameVar(JsVar *name) {
+  unsigned int h = 5381;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, name, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    h = (h*33) ^ (unsigned char)jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  return h;
+}
+
+/// Return the object's hash index (locked flat string) if it has one, 0 otherwise
+static JsVar *jsvObjectGetHashIndex(JsVar *object) {
+  JsVarRef childref = jsvGetFirstChild(object);
+  if (!childref) return 0;
+  // the index is always the first child - don't search for it!
+  JsVar *child = jsvGetAddressOf(childref);
+  if (!jsvIsString(child) || jsvIsNameWithValue(child) ||
+      child->varData.str[0]!=JS_HIDDEN_CHAR ||
+      !jsvIsStringEqual(child, JSV_OBJECT_HASH_NAME))
+    return 0;
+  JsVarRef valref = jsvGetFirstChild(child);
+  if (!valref) return 0;
+  JsVar *index = jsvLock(valref);
+  if (!jsvIsFlatString(index)) {
+    // someone has stored their own data under our name - ignore it
+    jsvUnLock(index);
+    return 0;
+  }
+  return index;
+}
+
+/// Remove the object's hash index (if it has one). It'll be rebuilt on the next long lookup
+static void jsvObjectDropHashIndex(JsVar *object) {
+  JsVarRef childref = jsvGetFirstChild(object);
+  if (!childref) return;
+  JsVar *child = jsvGetAddressOf(childref);
+  if (jsvIsString(child) && child->varData.str[0]==JS_HIDDEN_CHAR &&
+      jsvIsStringEqual(child, JSV_OBJECT_HASH_NAME)) {
+    JsVar *c = jsvLockAgain(child);
+    jsvRemoveChild(object, c);
+    jsvUnLock(c);
+  }
+}
+
+/// Walk all the object's children and build a hash index for them
+static void jsvObjectBuildHashIndex(JsVar *object) {
+  // count children - and if any have non-string names we can't hash, give up
+  unsigned int count = 0;
+  JsVarRef childref = jsvGetFirstChild(object);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (!jsvIsString(child)) return;
+    count++;
+    childref = jsvGetNextSibling(child);
+  }
+  unsigned int capacity = 4;
+  while (capacity < count*2) capacity <<= 1;
+  JsVar *index = jsvNewFlatStringOfLength((unsigned int)(sizeof(JsvObjectHashHeader) + capacity*sizeof(JsVarRef)));
+  if (!index) return; // out of memory (or no contiguous block free) - never mind
+  JsvObjectHashHeader *header = (JsvObjectHashHeader*)jsvGetFlatStringPointer(index);
+  JsVarRef *buckets = (JsVarRef*)(header+1);
+  memset(buckets, 0, capacity*sizeof(JsVarRef));
+  header->capacity = capacity;
+  header->count = count;
+  childref = jsvGetFirstChild(object);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    unsigned int b = jsvObjectHashNameVar(child) & (capacity-1);
+    while (buckets[b]) b = (b+1) & (capacity-1); // open addressing
+    buckets[b] = childref;
+    childref = jsvGetNextSibling(child);
+  }
+  // link the index in as a hidden child right at the front of the list
+  JsVar *indexName = jsvMakeIntoVariableName(jsvNewFromString(JSV_OBJECT_HASH_NAME), index);
+  jsvUnLock(index);
+  if (!indexName) return; // out of memory
+  jsvRef(indexName);
+  JsVar *firstChild = jsvLock(jsvGetFirstChild(object));
+  jsvSetPrevSibling(firstChild, jsvGetRef(indexName));
+  jsvSetNextSibling(indexName, jsvGetRef(firstChild));
+  jsvUnLock(firstChild);
+  jsvSetFirstChild(object, jsvGetRef(indexName));
+  jsvUnLock(indexName);
+}
+
+/// A child has just been linked into the object - add it to the hash index if there is one
+static void jsvObjectHashIndexAdd(JsVar *object, JsVar *namedChild) {
+  JsVar *index = jsvObjectGetHashIndex(object);
+  if (!index) return;
+  if (!jsvIsString(namedChild)) {
+    // a name we can't hash (eg. an integer) - stop indexing this object
+    jsvUnLock(index);
+    jsvObjectDropHashIndex(object);
+    return;
+  }
+  JsvObjectHashHeader *header = (JsvObjectHashHeader*)jsvGetFlatStringPointer(index);
+  JsVarRef *buckets = (JsVarRef*)(header+1);
+  if ((header->count+1)*4 > header->capacity*3) {
+    // over 3/4 full - drop it, and the next long lookup rebuilds it bigger
+    jsvUnLock(index);
+    jsvObjectDropHashIndex(object);
+    return;
+  }
+  unsigned int b = jsvObjectHashNameVar(namedChild) & (header->capacity-1);
+  while (buckets[b]) b = (b+1) & (header->capacity-1);
+  buckets[b] = jsvGetRef(namedChild);
+  header->count++;
+  jsvUnLock(index);
+}
+
 JsVar *jsvCopyNameOnly(JsVar *src, bool linkChildren, bool keepAsName) {
   assert(jsvIsName(src));
   JsVarFlags flags = src->flags;
@@ -2159,6 +2557,14 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
       vr = jsvGetFirstChild(src);
       while (vr) {
         JsVar *name = jsvLock(vr);
+        // don't copy a hash index - its buckets reference the old object's children.
+        // The copy will build its own if it gets looked up enough
+        if (jsvIsObject(src) && jsvIsString(name) && !jsvIsNameWithValue(name) &&
+            name->varData.str[0]==JS_HIDDEN_CHAR && jsvIsStringEqual(name, JSV_OBJECT_HASH_NAME)) {
+          vr = jsvGetNextSibling(name);
+          jsvUnLock(name);
+          continue;
+        }
         JsVar *child = jsvCopyNameOnly(name, true/*link children*/, true/*keep as name*/); // NO DEEP COPY!
         if (child) { // could have been out of memory
           jsvAddName(dst, child);
@@ -2178,6 +2584,8 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
 void jsvAddName(JsVar *parent, JsVar *namedChild) {
   namedChild = jsvRef(namedChild); // ref here VERY important as adding to structure!
   assert(jsvIsName(namedChild));
+  if (!jsvIsInt(namedChild))
+    jsVarShadowVersion++; // a new string name could shadow a cached builtin lookup
 
   // update array length
   if (jsvIsArray(parent) && jsvIsInt(namedChild)) {
@@ -2227,6 +2635,8 @@ void jsvAddName(JsVar *parent, JsVar *namedChild) {
     jsvSetFirstChild(parent, r);
     jsvSetLastChild(parent, r);
   }
+  if (jsvIsObject(parent))
+    jsvObjectHashIndexAdd(parent, namedChild);
 }
 
 JsVar *jsvAddNamedChild(JsVar *parent, JsVar *child, const char *name) {
@@ -2285,7 +2695,7 @@ JsVar *jsvSetValueOfName(JsVar *name, JsVar *src) {
   return name;
 }
 
-JsVar *jsvFindChildFromString(JsVar *parent, const char *name, bool addIfNotFound) {
+HOT_FUNCTION JsVar *jsvFindChildFromString(JsVar *parent, const char *name, bool addIfNotFound) {
   /* Pull out first 4 bytes, and ensure that everything
    * is 0 padded so that we can do a nice speedy check. */
   char fastCheck[4];
@@ -2310,18 +2720,57 @@ JsVar *jsvFindChildFromString(JsVar *parent, const char *name, bool addIfNotFoun
   }
 
   assert(jsvHasChildren(parent));
+  if (jsvIsObject(parent)) {
+    JsVar *index = jsvObjectGetHashIndex(parent);
+    if (index) {
+      // big object - probe the hash index rather than walking the child list
+      JsvObjectHashHeader *header = (JsvObjectHashHeader*)jsvGetFlatStringPointer(index);
+      JsVarRef *buckets = (JsVarRef*)(header+1);
+      unsigned int b = jsvObjectHashCString(name) & (header->capacity-1);
+      while (buckets[b]) {
+#ifndef SAVE_ON_FLASH
+        jsvOpFindChildProbes++;
+#endif
+        JsVar *child = jsvGetAddressOf(buckets[b]);
+        if (*(int*)fastCheck==*(int*)child->varData.str && // speedy check of first 4 bytes
+            jsvIsStringEqual(child, name)) {
+          jsvUnLock(index);
+          return jsvLockAgain(child);
+        }
+        b = (b+1) & (header->capacity-1);
+      }
+      jsvUnLock(index);
+      if (addIfNotFound) {
+        JsVar *child = jsvMakeIntoVariableName(jsvNewFromString(name), 0);
+        if (child) // could be out of memory
+          jsvAddName(parent, child); // keeps the index up to date
+        return child;
+      }
+      return 0;
+    }
+  }
+  unsigned int walked = 0;
   JsVarRef childref = jsvGetFirstChild(parent);
   while (childref) {
+#ifndef SAVE_ON_FLASH
+    jsvOpFindChildProbes++;
+#endif
     // Don't Lock here, just use GetAddressOf - to try and speed up the finding
     // TODO: We can do this now, but when/if we move to cacheing vars, it'll break
     JsVar *child = jsvGetAddressOf(childref);
     if (*(int*)fastCheck==*(int*)child->varData.str && // speedy check of first 4 bytes
         jsvIsStringEqual(child, name)) {
       // found it! unlock parent but leave child locked
-      return jsvLockAgain(child);
+      JsVar *locked = jsvLockAgain(child);
+      if (walked >= JSV_OBJECT_HASH_THRESHOLD && jsvIsObject(parent))
+        jsvObjectBuildHashIndex(parent); // this lookup was slow - make the next one fast
+      return locked;
     }
+    walked++;
     childref = jsvGetNextSibling(child);
   }
+  if (walked >= JSV_OBJECT_HASH_THRESHOLD && jsvIsObject(parent))
+    jsvObjectBuildHashIndex(parent);
 
   JsVar *child = 0;
   if (addIfNotFound) {
@@ -2364,6 +2813,34 @@ JsVar *jsvAsName(JsVar *var) {
 /** Non-recursive finding */
 JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound) {
   JsVar *child;
+  if (jsvIsArray(parent) && jsvIsInt(childName)) {
+    /* array children are sorted by index, so don't walk the whole list from
+     * the front - search from the nearest end (or the last-lookup cache) */
+    child = jsvGetArrayIndex(parent, childName->varData.integer);
+    if (child || !addIfNotFound) return child;
+    child = jsvAsName(childName);
+    jsvAddName(parent, child);
+    return child;
+  }
+  if (jsvIsString(childName) && !jsvIsFlatString(childName) &&
+      !jsvIsNativeString(childName) && !jsvGetLastChild(childName)) {
+    /* Key fits in a single var - pull it out as a C string and use the
+     * C-string lookup, which gets the 4-byte prefix compare and (on big
+     * objects) the hash index. Names can't be interned/shared in this
+     * tree because the name var is itself the sibling-list node, so a
+     * fast content compare is the best we can do. */
+    size_t keyLen = jsvGetCharactersInVar(childName);
+    char key[JSVAR_DATA_STRING_LEN+1];
+    memcpy(key, childName->varData.str, keyLen);
+    key[keyLen] = 0;
+    if (strlen(key)==keyLen) { // no embedded \0 - safe as a C string
+      child = jsvFindChildFromString(parent, key, false);
+      if (child || !addIfNotFound) return child;
+      child = jsvAsName(childName);
+      jsvAddName(parent, child);
+      return child;
+    }
+  }
   JsVarRef childref = jsvGetFirstChild(parent);
 
   while (childref) {
@@ -2384,10 +2861,19 @@ JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound)
   return child;
 }
 
+static void jsvArrayIndexCacheForget(JsVar *parent, JsVarRef childref);
+
 void jsvRemoveChild(JsVar *parent, JsVar *child) {
   assert(jsvHasChildren(parent));
   assert(jsvIsName(child));
   JsVarRef childref = jsvGetRef(child);
+  /* If this object has a hash index it's now stale - drop it. The index is
+   * always the very first child, so if that's what's being removed we're
+   * removing the index itself and there's nothing to do. */
+  if (jsvIsObject(parent) && jsvGetFirstChild(parent)!=childref)
+    jsvObjectDropHashIndex(parent);
+  if (jsvIsArray(parent))
+    jsvArrayIndexCacheForget(parent, childref);
   bool wasChild = false;
   // unlink from parent
   if (jsvGetFirstChild(parent) == childref) {
@@ -2635,7 +3121,158 @@ size_t jsvCountJsVarsUsed(JsVar *v) {
   return c;
 }
 
+/** As _jsvCountJsVarsUsedRecursive's counting pass, but accumulate per-type
+ * totals. Must visit exactly the same vars so the existing reset pass can
+ * clear the recursion flags afterwards. inArrayBuffer attributes backing
+ * strings to the arraybuffer bucket rather than the string one. */
+static void _jsvCountJsVarsUsedByTypeRecursive(JsVar *v, JsvSizeInfo *info, bool inArrayBuffer) {
+  if (!v) return;
+  if (v->flags & JSV_IS_RECURSING)
+    return;
+  v->flags |= JSV_IS_RECURSING;
+
+  info->total++;
+  if (jsvIsArrayBuffer(v)) {
+    info->arraybuffers++;
+    inArrayBuffer = true;
+  } else if (jsvIsFunction(v)) info->functions++;
+  else if (jsvIsObject(v) || jsvIsArray(v)) info->objects++;
+  else if (jsvHasCharacterData(v) || jsvIsName(v)) {
+    if (inArrayBuffer) info->arraybuffers++;
+    else info->strings++;
+  } else info->other++;
+
+  if (jsvHasSingleChild(v) || jsvHasChildren(v)) {
+    JsVarRef childref = jsvGetFirstChild(v);
+    while (childref) {
+      JsVar *child = jsvLock(childref);
+      _jsvCountJsVarsUsedByTypeRecursive(child, info, inArrayBuffer);
+      if (jsvHasChildren(v)) childref = jsvGetNextSibling(child);
+      else childref = 0;
+      jsvUnLock(child);
+    }
+  } else if (jsvIsFlatString(v)) {
+    size_t blocks = jsvGetFlatStringBlocks(v);
+    info->total += blocks;
+    if (inArrayBuffer) info->arraybuffers += blocks;
+    else info->strings += blocks;
+  }
+  if (jsvHasCharacterData(v)) {
+    JsVarRef childref = jsvGetLastChild(v);
+    while (childref) {
+      JsVar *child = jsvLock(childref);
+      info->total++;
+      if (inArrayBuffer) info->arraybuffers++;
+      else info->strings++;
+      childref = jsvGetLastChild(child);
+      jsvUnLock(child);
+    }
+  }
+  if (jsvIsName(v) && !jsvIsNameWithValue(v) && jsvGetFirstChild(v)) {
+    JsVar *child = jsvLock(jsvGetFirstChild(v));
+    _jsvCountJsVarsUsedByTypeRecursive(child, info, inArrayBuffer);
+    jsvUnLock(child);
+  }
+}
+
+/** Like jsvCountJsVarsUsed but broken down by type. Cycle-safe the same way */
+void jsvCountJsVarsUsedByType(JsVar *v, JsvSizeInfo *info) {
+  memset(info, 0, sizeof(JsvSizeInfo));
+  _jsvCountJsVarsUsedByTypeRecursive(v, info, false);
+  _jsvCountJsVarsUsedRecursive(v, true); // clear the recursion flags again
+}
+
+/* One-entry cache of the last array index lookup. Sequential access
+ * (for (i=0;i<l;i++) a[i]) is by far the most common pattern, and array
+ * children are kept sorted by index, so stepping a sibling link on from
+ * the last hit makes each access O(1) rather than a walk from one end.
+ * Validity rules are as for jspeFactorMember's inline cache: while
+ * jsVarStructureVersion is unchanged the cached refs can't have been
+ * freed and reused. Index renumbering (eg. Array.shift) doesn't free
+ * anything, so the cached child's own index is re-checked too. */
+static struct {
+  JsVarRef arr, child;
+  JsVarInt index;
+  unsigned int structureVersion;
+} jsvArrayIndexCache;
+
+/* A child is about to be unlinked (it may be re-linked somewhere else without
+ * ever being freed, which jsVarStructureVersion wouldn't catch) */
+static void jsvArrayIndexCacheForget(JsVar *parent, JsVarRef childref) {
+  if (jsvArrayIndexCache.arr == jsvGetRef(parent) ||
+      jsvArrayIndexCache.child == childref)
+    jsvArrayIndexCache.arr = 0;
+}
+
+static void jsvArrayIndexCacheSet(const JsVar *arr, JsVar *child, JsVarInt index) {
+  jsvArrayIndexCache.arr = jsvGetRef((JsVar*)arr);
+  jsvArrayIndexCache.child = jsvGetRef(child);
+  jsvArrayIndexCache.index = index;
+  jsvArrayIndexCache.structureVersion = jsVarStructureVersion;
+}
+
+/* Look index up starting from the cached last lookup. If this sets
+ * 'conclusive' the returned var (which may be 0 = undefined) is the real
+ * answer - otherwise the caller must do the full search. */
+static JsVar *jsvArrayIndexCacheLookup(const JsVar *arr, JsVarInt index, bool *conclusive) {
+  *conclusive = false;
+  if (jsvArrayIndexCache.structureVersion != jsVarStructureVersion ||
+      jsvArrayIndexCache.arr != jsvGetRef((JsVar*)arr))
+    return 0;
+  JsVar *child = jsvGetAddressOf(jsvArrayIndexCache.child);
+  if (!jsvIsInt(child) || child->varData.integer != jsvArrayIndexCache.index)
+    return 0; // the array was renumbered - ignore the cache
+  // if it's further away than this the search below does just as well
+  int maxWalk = 32;
+  if (index >= jsvArrayIndexCache.index) {
+    while (jsvIsInt(child)) {
+      if (child->varData.integer == index) {
+        jsvArrayIndexCacheSet(arr, child, index);
+        *conclusive = true;
+        return jsvLockAgain(child);
+      }
+      if (child->varData.integer > index) {
+        *conclusive = true; // sorted, so it's not in the array at all
+        return 0;
+      }
+      if (maxWalk-- <= 0) return 0;
+      JsVarRef n = jsvGetNextSibling(child);
+      if (!n) {
+        *conclusive = true; // walked off the end
+        return 0;
+      }
+      child = jsvGetAddressOf(n);
+    }
+    *conclusive = true; // we hit the non-integer names that sort after the elements
+    return 0;
+  } else {
+    while (jsvIsInt(child)) {
+      if (child->varData.integer == index) {
+        jsvArrayIndexCacheSet(arr, child, index);
+        *conclusive = true;
+        return jsvLockAgain(child);
+      }
+      if (child->varData.integer < index) {
+        *conclusive = true; // sorted, so it's not in the array at all
+        return 0;
+      }
+      if (maxWalk-- <= 0) return 0;
+      JsVarRef p = jsvGetPrevSibling(child);
+      if (!p) {
+        *conclusive = true; // walked off the front
+        return 0;
+      }
+      child = jsvGetAddressOf(p);
+    }
+    return 0; // something unexpected - do the full search
+  }
+}
+
 JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
+  bool conclusive;
+  JsVar *cached = jsvArrayIndexCacheLookup(arr, index, &conclusive);
+  if (conclusive) return cached;
+  assert(!cached);
   JsVarRef childref = jsvGetLastChild(arr);
   JsVarInt lastArrayIndex = 0;
   // Look at last non-string element!
@@ -2645,6 +3282,7 @@ JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
       lastArrayIndex = child->varData.integer;
       // it was the last element... sorted!
       if (lastArrayIndex == index) {
+        jsvArrayIndexCacheSet(arr, child, index);
         return child;
       }
       jsvUnLock(child);
@@ -2665,6 +3303,7 @@ JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
 
       assert(jsvIsInt(child));
       if (child->varData.integer == index) {
+        jsvArrayIndexCacheSet(arr, child, index);
         return child;
       }
       childref = jsvGetPrevSibling(child);
@@ -2678,6 +3317,7 @@ JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
 
       assert(jsvIsInt(child));
       if (child->varData.integer == index) {
+        jsvArrayIndexCacheSet(arr, child, index);
         return child;
       }
       childref = jsvGetNextSibling(child);
@@ -2962,9 +3602,11 @@ bool jsvMathsOpTypeEqual(JsVar *a, JsVar *b) {
   // check type first, then call again to check data
   bool eql = (a==0) == (b==0);
   if (a && b) {
-    // Check whether both are numbers, otherwise check the variable
-    // type flags themselves
+    // Check whether both are numbers or both are strings (which may be
+    // stored as different types, eg flat vs normal), otherwise check the
+    // variable type flags themselves
     eql = ((jsvIsInt(a)||jsvIsFloat(a)) && (jsvIsInt(b)||jsvIsFloat(b))) ||
+        (jsvIsString(a) && jsvIsString(b)) ||
         ((a->flags & JSV_VARTYPEMASK) == (b->flags & JSV_VARTYPEMASK));
   }
   if (eql) {
@@ -3320,9 +3962,20 @@ static void jsvGarbageCollectMarkUsed(JsVar *var) {
 int jsvGarbageCollect() {
   if (isMemoryBusy) return false;
   isMemoryBusy = MEMBUSY_GC;
+#ifndef SAVE_ON_FLASH
+  JsSysTime gcStartTime = jshGetSystemTime();
+#endif
+  // the sweep below frees vars without going via jsvFreePtrInternal
+  jsvStringEndCache.str = 0;
+  jsvStringPosCache.str = 0;
+  jsVarStructureVersion++;
+  /* everything above the high water mark is guaranteed free, so the loops
+   * below only need to scan up to it */
+  JsVarRef highWaterMark = jsVarsHighWaterMark;
+  assert(highWaterMark <= jsVarsSize);
   JsVarRef i;
   // Add GC flags to anything that is currently used
-  for (i=1;i<=jsVarsSize;i++)  {
+  for (i=1;i<=highWaterMark;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) { // if it is not unused
       var->flags |= (JsVarFlags)JSV_GARBAGE_COLLECT;
@@ -3332,7 +3985,7 @@ int jsvGarbageCollect() {
     }
   }
   /* recursively remove anything that is referenced from a var that is locked. */
-  for (i=1;i<=jsVarsSize;i++)  {
+  for (i=1;i<=highWaterMark;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags & JSV_GARBAGE_COLLECT) && // not already GC'd
         jsvGetLocks(var)>0) // or it is locked
@@ -3347,8 +4000,10 @@ int jsvGarbageCollect() {
    * hopefully helps compact everything towards the start. */
   unsigned int freedCount = 0;
   jsVarFirstEmpty = 0;
+  jsvBitmapClearAll(); // re-derived below, which also fixes it up after jsvDefragment
   JsVar *lastEmpty = 0;
-  for (i=1;i<=jsVarsSize;i++)  {
+  JsVarRef highestUsed = 0;
+  for (i=1;i<=highWaterMark;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if (var->flags & JSV_GARBAGE_COLLECT) {
       if (jsvIsFlatString(var)) {
@@ -3361,6 +4016,7 @@ int jsvGarbageCollect() {
         if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
         else jsVarFirstEmpty = i;
         lastEmpty = var;
+        jsvBitmapSetFree(i);
         // free subsequent blocks
         while (count-- > 0) {
           i++;
@@ -3370,6 +4026,7 @@ int jsvGarbageCollect() {
           if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
           else jsVarFirstEmpty = i;
           lastEmpty = var;
+          jsvBitmapSetFree(i);
         }
       } else {
         // otherwise just free 1 block
@@ -3408,23 +4065,203 @@ int jsvGarbageCollect() {
         if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
         else jsVarFirstEmpty = i;
         lastEmpty = var;
+        jsvBitmapSetFree(i);
         freedCount++;
       }
     } else if (jsvIsFlatString(var)) {
       // if we have a flat string, skip forward that many blocks
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+      highestUsed = i;
     } else if (var->flags == JSV_UNUSED) {
       // this is already free - add it to the free list
       if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
       else jsVarFirstEmpty = i;
       lastEmpty = var;
-    }
+      jsvBitmapSetFree(i);
+    } else
+      highestUsed = i;
+  }
+  /* Everything above the high water mark was already free - just chain it
+   * onto the end of the free list without having to look at it */
+  for (i=(JsVarRef)(highWaterMark+1);i<=jsVarsSize;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    assert((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED);
+    if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
+    else jsVarFirstEmpty = i;
+    lastEmpty = var;
+    jsvBitmapSetFree(i);
   }
   if (lastEmpty) jsvSetNextSibling(lastEmpty, 0);
+  jsVarsHighWaterMark = highestUsed; // now exact again
   isMemoryBusy = MEM_NOT_BUSY;
+#ifndef SAVE_ON_FLASH
+  // log the pause time so E.memStats can report a histogram
+  JsVarFloat gcMs = jshGetMillisecondsFromTime(jshGetSystemTime()-gcStartTime);
+  unsigned int gcBucket = 0;
+  while (gcBucket+1 < JSV_GC_PAUSE_HISTOGRAM_SIZE && gcMs >= (1<<gcBucket))
+    gcBucket++;
+  jsvGCPauseHistogram[gcBucket]++;
+  jsvGCCount++;
+  jsvOpAllocCountAtGC = jsvOpAllocCount;
+#endif
   return (int)freedCount;
 }
 
+#ifndef SAVE_ON_FLASH
+void jsvGetMemoryStatistics(JsvMemoryStats *stats) {
+  memset(stats, 0, sizeof(JsvMemoryStats));
+  stats->total = (unsigned int)jsVarsSize;
+  unsigned int freeRun = 0;
+  JsVarRef i;
+  for (i=1;i<=jsVarsSize;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) {
+      stats->free++;
+      if (!freeRun) stats->freeFragments++;
+      freeRun++;
+      if (freeRun > stats->largestFreeRun) stats->largestFreeRun = freeRun;
+      continue;
+    }
+    freeRun = 0;
+    if (jsvIsFlatString(var)) {
+      stats->flatStrings++;
+      // the data blocks belong to their parent - skip rather than counting them as 'other'
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    } else if (jsvIsStringExt(var)) stats->stringExts++;
+    else if (jsvIsName(var)) stats->names++; // before the string/int checks - names are typed
+    else if (jsvIsString(var)) stats->strings++;
+    else if (jsvIsObject(var)) stats->objects++;
+    else if (jsvIsArray(var)) stats->arrays++;
+    else if (jsvIsFunction(var)) stats->functions++;
+    else if (jsvIsInt(var)) stats->integers++;
+    else if (jsvIsFloat(var)) stats->floats++;
+    else if (jsvIsArrayBuffer(var)) stats->arrayBuffers++;
+    else stats->other++;
+  }
+  stats->allocationsSinceGC = jsvOpAllocCount - jsvOpAllocCountAtGC;
+  stats->gcCount = jsvGCCount;
+  memcpy(stats->gcPauses, (const void*)jsvGCPauseHistogram, sizeof(stats->gcPauses));
+}
+
+void jsvOpCountersReset() {
+  jsvOpAllocCount = 0;
+  jsvOpAllocCountAtGC = 0;
+  jsvOpFindChildProbes = 0;
+  jslOpTokenCount = 0;
+}
+#endif
+
+/** Used by jsvDefragment. Rewrite every link field in 'var' that equals
+ * 'from' to point to 'to' instead. Which fields actually hold links depends
+ * on the type - for strings most of them hold character data. */
+static void jsvDefragPatchLinks(JsVar *var, JsVarRef from, JsVarRef to) {
+  if (jsvIsName(var)) {
+    if (jsvGetPrevSibling(var)==from) jsvSetPrevSibling(var, to);
+    if (jsvGetNextSibling(var)==from) jsvSetNextSibling(var, to);
+    if (!jsvIsNameWithValue(var) && jsvGetFirstChild(var)==from) jsvSetFirstChild(var, to);
+    if (jsvHasCharacterData(var) && jsvGetLastChild(var)==from) jsvSetLastChild(var, to);
+  } else if (jsvHasCharacterData(var)) {
+    // strings and stringexts - only lastChild (the stringext chain) is a link
+    if (jsvGetLastChild(var)==from) jsvSetLastChild(var, to);
+  } else if (jsvHasChildren(var)) {
+    if (jsvGetFirstChild(var)==from) jsvSetFirstChild(var, to);
+    if (jsvGetLastChild(var)==from) jsvSetLastChild(var, to);
+  } else if (jsvHasSingleChild(var)) {
+    if (jsvGetFirstChild(var)==from) jsvSetFirstChild(var, to);
+  }
+}
+
+/** Defragment memory - move movable variables down into free blocks lower in
+ * memory, so the free space that remains forms contiguous runs. This lets
+ * jsvNewFlatStringOfLength succeed on a heap that has fragmented over a long
+ * uptime, even though a garbage collect alone wouldn't help.
+ *
+ * A variable can only be moved if everything pointing at it can be patched
+ * up, so anything locked (native code holds a JsVar* to it) stays put, as
+ * does anything with more than one reference - the extra reference may be a
+ * bare JsVarRef held outside the variable pool (eg. jsinteractive's
+ * timerArray), which we have no way of finding. StringExts are never
+ * referenced or locked so they can always move. Flat strings can't move as
+ * their data blocks would have to come too.
+ *
+ * The caller must make sure nothing is holding unlocked pointers into the
+ * pool - in particular the utility timer must be idle (see
+ * jswrap_espruino_defrag). Returns the number of variables moved. */
+int jsvDefragment() {
+  /* Drop all object hash indexes first - they cache child references inside
+   * a flat string where we can't patch them up. Hot objects will just
+   * rebuild theirs on the next lookup. */
+  JsVarRef i;
+  for (i=1;i<=jsVarsHighWaterMark;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) continue;
+    if (jsvIsFlatString(var))
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    else if (jsvIsObject(var))
+      jsvObjectDropHashIndex(var);
+  }
+  /* Garbage collect - this frees anything unreferenced, invalidates the
+   * string iterator caches, and leaves the free list sorted ascending with
+   * the high water mark exact. The moving pass relies on all three. */
+  jsvGarbageCollect();
+  if (isMemoryBusy) return 0;
+  isMemoryBusy = MEMBUSY_SYSTEM;
+  JsVarRef highWaterMark = jsVarsHighWaterMark;
+  int moved = 0;
+  /* 'dstNext' walks up through memory looking for free blocks to move things
+   * into. It only ever moves forwards: a block we vacate is always above the
+   * one we moved into, so the cursor will find it again later. Note that this
+   * leaves the free list stale (we're allocating blocks that are still on
+   * it), which is why we rebuild it with a garbage collect afterwards. */
+  JsVarRef dstNext = 1;
+  for (i=1;i<=highWaterMark;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) continue;
+    if (jsvIsFlatString(var)) {
+      // flat strings are pinned - skip their data blocks
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+      continue;
+    }
+    if (jsvGetLocks(var)>0) continue; // native code holds a pointer to us
+    if (jsvHasRef(var) && jsvGetRefs(var)!=1) continue; // may be referenced from outside the pool
+    // find the lowest free block below us
+    JsVarRef dst = 0;
+    while (dstNext < i) {
+      JsVar *dstVar = jsvGetAddressOf(dstNext);
+      if ((dstVar->flags&JSV_VARTYPEMASK) == JSV_UNUSED) {
+        dst = dstNext++;
+        break;
+      }
+      if (jsvIsFlatString(dstVar))
+        dstNext = (JsVarRef)(dstNext+jsvGetFlatStringBlocks(dstVar));
+      dstNext++;
+    }
+    if (!dst) continue; // no free block below us
+    // move the variable's data down...
+    *jsvGetAddressOf(dst) = *var;
+    var->flags = JSV_UNUSED;
+    jsvSetNextSibling(var, 0);
+    // ...and patch up whatever was pointing at it
+    JsVarRef j;
+    for (j=1;j<=highWaterMark;j++) {
+      JsVar *v = jsvGetAddressOf(j);
+      if ((v->flags&JSV_VARTYPEMASK) == JSV_UNUSED) continue;
+      if (jsvIsFlatString(v)) {
+        j = (JsVarRef)(j+jsvGetFlatStringBlocks(v)); // no links in flat strings
+        continue;
+      }
+      jsvDefragPatchLinks(v, i, dst);
+    }
+    moved++;
+  }
+  isMemoryBusy = MEM_NOT_BUSY;
+  /* We've been pulling blocks off the free list without putting all the
+   * vacated ones back - collect again to rebuild it (and the water mark) */
+  if (moved)
+    jsvGarbageCollect();
+  return moved;
+}
+
 #ifndef RELEASE
 // Dump any locked variables that aren't referenced from `global` - for debugging memory leaks
 void jsvDumpLockedVars() {
@@ -301,10 +301,42 @@ void jsvShowAllocated(); ///< Show what is still allocated, for debugging memory
 /// Try and allocate more memory - only works if RESIZABLE_JSVARS is defined
 void jsvSetMemoryTotal(unsigned int jsNewVarCount);
 
+#ifndef SAVE_ON_FLASH
+#define JSV_GC_PAUSE_HISTOGRAM_SIZE 8
+/// Memory/GC telemetry filled in by jsvGetMemoryStatistics - see E.memStats
+typedef struct {
+  unsigned int total;              ///< total JsVars
+  unsigned int free;               ///< free JsVars
+  unsigned int freeFragments;      ///< how many separate contiguous runs of free blocks there are
+  unsigned int largestFreeRun;     ///< longest contiguous run of free blocks (bounds flat string allocation)
+  unsigned int allocationsSinceGC; ///< JsVars allocated since the last GC pass
+  unsigned int gcCount;            ///< GC passes since boot
+  unsigned int gcPauses[JSV_GC_PAUSE_HISTOGRAM_SIZE]; ///< bucket n = GC passes shorter than (1<<n) ms, last bucket = longer
+  // per-type counts (flat string data blocks are counted with their parent)
+  unsigned int objects, arrays, functions, strings, stringExts, flatStrings,
+               names, integers, floats, arrayBuffers, other;
+} JsvMemoryStats;
+/// Scan all variables and fill in memory/GC statistics - see E.memStats
+void jsvGetMemoryStatistics(JsvMemoryStats *stats);
+
+/** Deterministic operation counters so tests can assert performance
+ * invariants ("this loop allocates nothing") - see E.getOpCounters */
+extern volatile uint32_t jsvOpAllocCount; ///< jsvNewWithFlags allocations
+extern volatile uint32_t jsvOpFindChildProbes; ///< hash/list probes looking children up by name
+/// Zero the operation counters (including the lexer's - see E.getOpCounters)
+void jsvOpCountersReset();
+#endif
+
 
 // Note that jsvNew* don't REF a variable for you, but the do LOCK it
 JsVar *jsvNewWithFlags(JsVarFlags flags); ///< Create a new variable with the given flags
+/** Claim a run of contiguous variables off the free list in one operation and
+ * return a reference to the first (or 0 if no run could be found). The blocks
+ * are unlinked from the free list but left as JSV_UNUSED - it's up to the
+ * caller to initialise every one of them. */
+JsVarRef jsvAllocateContiguous(unsigned int requiredBlocks);
 JsVar *jsvNewFlatStringOfLength(unsigned int byteLength); ///< Try and create a special flat string
+JsVar *jsvNewNativeString(char *ptr, size_t len); ///< Create a new string referencing (not copying!) data elsewhere in memory - max length 65535
 JsVar *jsvNewFromString(const char *str); ///< Create a new string
 JsVar *jsvNewStringOfLength(unsigned int byteLength, const char *initialData); ///< Create a new string of the given length - full of 0s (or initialData if specified)
 static ALWAYS_INLINE JsVar *jsvNewFromEmptyString() { JsVar *v = jsvNewWithFlags(JSV_STRING_0); return v; } ;///< Create a new empty string
@@ -673,6 +705,16 @@ JsVarInt jsvGetArrayLength(const JsVar *arr); ///< Not the same as GetChildren,
 JsVarInt jsvSetArrayLength(JsVar *arr, JsVarInt length, bool truncate); ///< set an array's length, optionally truncating if the array becomes shorter
 JsVarInt jsvGetLength(const JsVar *src); ///< General purpose length function. Does the 'right' thing
 size_t jsvCountJsVarsUsed(JsVar *v); ///< Count the amount of JsVars used. Mostly useful for debugging
+/// Rough breakdown of JsVar usage by type - filled in by jsvCountJsVarsUsedByType
+typedef struct {
+  size_t total;        ///< every block counted - the sum of the fields below
+  size_t strings;      ///< strings, string extensions and name keys
+  size_t objects;      ///< objects and arrays
+  size_t functions;    ///< function vars themselves (their code/scopes count as strings/objects)
+  size_t arraybuffers; ///< arraybuffers, typed array views and their backing data
+  size_t other;        ///< numbers, pins, and anything else
+} JsvSizeInfo;
+void jsvCountJsVarsUsedByType(JsVar *v, JsvSizeInfo *info); ///< like jsvCountJsVarsUsed but broken down by type
 JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index); ///< Get a 'name' at the specified index in the array if it exists (and lock it)
 JsVar *jsvGetArrayItem(const JsVar *arr, JsVarInt index); ///< Get an item at the specified index in the array if it exists (and lock it)
 void jsvSetArrayItem(JsVar *arr, JsVarInt index, JsVar *item); ///< Set an array item at the specified index in the array
@@ -698,6 +740,24 @@ void jsvTrace(JsVar *var, int indent);
 /** Run a garbage collection sweep - return nonzero if things have been freed */
 int jsvGarbageCollect();
 
+/** Incremented whenever a name or a var with children is freed (or vars get
+ * moved by defrag). While this is unchanged a cached JsVarRef to a name is
+ * guaranteed not to have been freed/reused - see jspeFactorMember */
+extern unsigned int jsVarStructureVersion;
+
+/** Incremented whenever a string-named child is linked into a parent or a
+ * __proto__/prototype/constructor name is reassigned - ie. whenever a
+ * builtin lookup that previously fell through to the symbol tables could
+ * now resolve to something else. See jspeFactorMember's builtin cache */
+extern unsigned int jsVarShadowVersion;
+
+/** Defragment memory - garbage collect, then move movable variables down
+ * into free blocks lower in memory so free space forms contiguous runs
+ * (which jsvNewFlatStringOfLength needs). Only safe to call when nothing
+ * holds unlocked pointers into the pool, eg. while the utility timer is
+ * idle. Returns the number of variables moved. */
+int jsvDefragment();
+
 #ifndef RELEASE
 // Dump any locked variables that aren't referenced from `global` - for debugging memory leaks
 void jsvDumpLockedVars();
@@ -140,6 +140,8 @@ unsigned int jsvIterateCallbackToBytes(JsVar *var, unsigned char *data, unsigned
 
 // --------------------------------------------------------------------------------------------
 
+JsvStringPosCache jsvStringPosCache;
+
 void jsvStringIteratorNew(JsvStringIterator *it, JsVar *str, size_t startIdx) {
   assert(jsvHasCharacterData(str));
   it->var = jsvLockAgain(str);
@@ -153,6 +155,17 @@ void jsvStringIteratorNew(JsvStringIterator *it, JsVar *str, size_t startIdx) {
   } else{
     it->ptr = &it->var->varData.str[0];
   }
+  if (jsvStringPosCache.str==str && startIdx>=jsvStringPosCache.varIndex &&
+      it->charIdx >= it->charsInVar) {
+    // we seeked near here last time - skip straight to that block and walk on from there
+    JsVar *block = jsvLockAgain(jsvStringPosCache.block);
+    jsvUnLock(it->var);
+    it->var = block;
+    it->ptr = &block->varData.str[0];
+    it->varIndex = jsvStringPosCache.varIndex;
+    it->charIdx = startIdx - jsvStringPosCache.varIndex;
+    it->charsInVar = jsvGetCharactersInVar(block);
+  }
   while (it->charIdx>0 && it->charIdx >= it->charsInVar) {
     it->charIdx -= it->charsInVar;
     it->varIndex += it->charsInVar;
@@ -173,6 +186,13 @@ void jsvStringIteratorNew(JsvStringIterator *it, JsVar *str, size_t startIdx) {
       }
     }
   }
+  if (it->varIndex) {
+    // we had to seek into the block chain - remember where we got to so
+    // the next seek nearby doesn't walk the chain from the start
+    jsvStringPosCache.str = str;
+    jsvStringPosCache.block = it->var;
+    jsvStringPosCache.varIndex = it->varIndex;
+  }
 }
 
 JsvStringIterator jsvStringIteratorClone(JsvStringIterator *it) {
@@ -198,19 +218,37 @@ void jsvStringIteratorSetCharAndNext(JsvStringIterator *it, char c) {
   jsvStringIteratorNextInline(it);
 }
 
-void jsvStringIteratorNext(JsvStringIterator *it) {
+HOT_FUNCTION void jsvStringIteratorNext(JsvStringIterator *it) {
   jsvStringIteratorNextInline(it);
 }
 
+JsvStringEndCache jsvStringEndCache;
+
 void jsvStringIteratorGotoEnd(JsvStringIterator *it) {
   assert(it->var);
-  while (jsvGetLastChild(it->var)) {
+  // only remember strings we're at the very start of - otherwise we don't know which string this is
+  JsVar *strVar = (it->varIndex==0) ? it->var : 0;
+  if (strVar && jsvStringEndCache.str==strVar) {
+    // we know where the end of this string was last time - skip straight there
+    JsVar *end = jsvLockAgain(jsvStringEndCache.lastBlock);
+    jsvUnLock(it->var);
+    it->var = end;
+    it->varIndex = jsvStringEndCache.varIndex;
+    it->charsInVar = jsvGetCharactersInVar(end);
+  }
+  while (jsvGetLastChild(it->var)) { // in case more was appended since we cached
     JsVar *next = jsvLock(jsvGetLastChild(it->var));
     jsvUnLock(it->var);
     it->var = next;
     it->varIndex += it->charsInVar;
     it->charsInVar = jsvGetCharactersInVar(it->var);
   }
+  if (strVar && it->varIndex) {
+    // multi-block string - remember where the end was for next time
+    jsvStringEndCache.str = strVar;
+    jsvStringEndCache.lastBlock = it->var;
+    jsvStringEndCache.varIndex = it->varIndex;
+  }
   it->ptr = &it->var->varData.str[0];
   if (it->charsInVar) it->charIdx = it->charsInVar-1;
   else it->charIdx = 0;
@@ -239,6 +277,11 @@ void jsvStringIteratorAppend(JsvStringIterator *it, char ch) {
     }
     // we don't ref, because  StringExts are never reffed as they only have one owner (and ALWAYS have an owner)
     jsvSetLastChild(it->var, jsvGetRef(next));
+    // if we just extended past the cached end of a string, move the cache along with us
+    if (jsvStringEndCache.str && jsvStringEndCache.lastBlock==it->var) {
+      jsvStringEndCache.lastBlock = next;
+      jsvStringEndCache.varIndex = it->varIndex + it->charIdx;
+    }
     jsvUnLock(it->var);
     it->var = next;
     it->ptr = &next->varData.str[0];
@@ -253,9 +296,23 @@ void jsvStringIteratorAppend(JsvStringIterator *it, char ch) {
 void jsvStringIteratorAppendString(JsvStringIterator *it, JsVar *str, size_t startIdx) {
   JsvStringIterator sit;
   jsvStringIteratorNew(&sit, str, startIdx);
-  while (jsvStringIteratorHasChar(&sit)) {
-    jsvStringIteratorAppend(it, jsvStringIteratorGetChar(&sit));
-    jsvStringIteratorNext(&sit);
+  // copy a run at a time: as much as is left in the source block and
+  // still fits in the block we're appending to
+  while (jsvStringIteratorHasChar(&sit) && it->var) {
+    size_t maxCh = jsvGetMaxCharactersInVar(it->var);
+    size_t space = (it->charsInVar < maxCh) ? maxCh-it->charsInVar : 0;
+    if (!space) { // this block is full - Append allocates the next one
+      jsvStringIteratorAppend(it, jsvStringIteratorGetChar(&sit));
+      jsvStringIteratorNext(&sit);
+      continue;
+    }
+    size_t chunk = jsvStringIteratorGetCharsLeftInBlock(&sit);
+    if (chunk > space) chunk = space;
+    memcpy(&it->ptr[it->charsInVar], jsvStringIteratorGetPtr(&sit), chunk);
+    it->charsInVar += chunk;
+    it->charIdx = it->charsInVar-1;
+    jsvSetCharactersInVar(it->var, it->charsInVar);
+    jsvStringIteratorSkipInBlock(&sit, chunk);
   }
   jsvStringIteratorFree(&sit);
 }
@@ -329,6 +386,21 @@ static void jsvArrayBufferIteratorGetValueData(JsvArrayBufferIterator *it, char
   if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return;
   assert(!it->hasAccessedElement); // we just haven't implemented this case yet
   int i,dataLen = (int)JSV_ARRAYBUFFER_GET_SIZE(it->type);
+  /* fast path: the whole element is inside the current string block, so we
+   * can read through the cached pointer rather than stepping (and
+   * bounds-checking) the string iterator for every byte */
+  if (!(it->type & ARRAYBUFFERVIEW_BIG_ENDIAN) &&
+      jsvStringIteratorHasChar(&it->it) &&
+      (size_t)dataLen <= jsvStringIteratorGetCharsLeftInBlock(&it->it)) {
+    char *ptr = jsvStringIteratorGetPtr(&it->it);
+    for (i=0;i<dataLen;i++)
+      data[i] = (char)READ_FLASH_UINT8(&ptr[i]);
+    if (dataLen!=1) {
+      jsvStringIteratorSkipInBlock(&it->it, (size_t)dataLen);
+      it->hasAccessedElement = true;
+    }
+    return;
+  }
   if (it->type & ARRAYBUFFERVIEW_BIG_ENDIAN) {
     for (i=dataLen-1;i>=0;i--) {
        data[i] = jsvStringIteratorGetChar(&it->it);
@@ -442,6 +514,19 @@ void jsvArrayBufferIteratorSetIntegerValue(JsvArrayBufferIterator *it, JsVarInt
     jsvArrayBufferIteratorIntToData(data, dataLen, it->type, v);
   }
 
+  // fast path: write straight into the current string block if it all fits
+  if (jsvStringIteratorHasChar(&it->it) &&
+      (size_t)dataLen <= jsvStringIteratorGetCharsLeftInBlock(&it->it)) {
+    char *ptr = jsvStringIteratorGetPtr(&it->it);
+    for (i=0;i<dataLen;i++)
+      ptr[i] = data[i];
+    if (dataLen!=1) {
+      jsvStringIteratorSkipInBlock(&it->it, (size_t)dataLen);
+      it->hasAccessedElement = true;
+    }
+    return;
+  }
+
   for (i=0;i<dataLen;i++) {
     jsvStringIteratorSetChar(&it->it, data[i]);
     if (dataLen!=1) jsvStringIteratorNext(&it->it);
@@ -461,6 +546,20 @@ void jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value) {
     jsvArrayBufferIteratorIntToData(data, (unsigned)dataLen, it->type, jsvGetInteger(value));
   }
 
+  // fast path: write straight into the current string block if it all fits
+  if (!(it->type & ARRAYBUFFERVIEW_BIG_ENDIAN) &&
+      jsvStringIteratorHasChar(&it->it) &&
+      (size_t)dataLen <= jsvStringIteratorGetCharsLeftInBlock(&it->it)) {
+    char *ptr = jsvStringIteratorGetPtr(&it->it);
+    for (i=0;i<dataLen;i++)
+      ptr[i] = data[i];
+    if (dataLen!=1) {
+      jsvStringIteratorSkipInBlock(&it->it, (size_t)dataLen);
+      it->hasAccessedElement = true;
+    }
+    return;
+  }
+
   if (it->type & ARRAYBUFFERVIEW_BIG_ENDIAN) {
     for (i=dataLen-1;i>=0;i--) {
       jsvStringIteratorSetChar(&it->it, data[i]);
@@ -507,8 +606,12 @@ void   jsvArrayBufferIteratorNext(JsvArrayBufferIterator *it) {
   it->byteOffset += JSV_ARRAYBUFFER_GET_SIZE(it->type);
   if (!it->hasAccessedElement) {
     unsigned int dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
-    while (dataLen--)
-      jsvStringIteratorNext(&it->it);
+    if (jsvStringIteratorHasChar(&it->it) &&
+        (size_t)dataLen <= jsvStringIteratorGetCharsLeftInBlock(&it->it))
+      jsvStringIteratorSkipInBlock(&it->it, (size_t)dataLen);
+    else
+      while (dataLen--)
+        jsvStringIteratorNext(&it->it);
   } else
     it->hasAccessedElement = false;
 }
@@ -31,6 +31,39 @@ int jsvIterateCallbackCount(JsVar *var);
 unsigned int jsvIterateCallbackToBytes(JsVar *var, unsigned char *data, unsigned int dataSize);
 
 // --------------------------------------------------------------------------------------------
+
+/** We remember where the end of the last string we appended to was, so that
+ * repeatedly appending to a long string (eg. building up a log line) doesn't
+ * have to walk the whole StringExt chain each time. The cache just gives
+ * jsvStringIteratorGotoEnd somewhere to start walking from, so it's fine if
+ * more data was appended since - but it MUST be invalidated if any block of
+ * the string is freed (see jsvStringEndCacheInvalidate). */
+typedef struct {
+  JsVar *str;       ///< the first var of the string, or 0 if the cache is empty
+  JsVar *lastBlock; ///< the last block of the string's StringExt chain (never == str)
+  size_t varIndex;  ///< index in the string of the first character of lastBlock
+} JsvStringEndCache;
+extern JsvStringEndCache jsvStringEndCache;
+
+/** Like the end cache, but remembering the last character index we seeked to
+ * with jsvStringIteratorNew. Code like s.charAt(i) in a loop (or the lexer
+ * seeking around) creates a fresh iterator per access, which otherwise walks
+ * the block chain from the start every time. */
+typedef struct {
+  JsVar *str;      ///< the first var of the string, or 0 if the cache is empty
+  JsVar *block;    ///< the block containing the last character we seeked to (never == str)
+  size_t varIndex; ///< index in the string of the first character of block
+} JsvStringPosCache;
+extern JsvStringPosCache jsvStringPosCache;
+
+/// Called when a var is freed - if it was part of a cached string, forget it
+static ALWAYS_INLINE void jsvStringEndCacheInvalidate(JsVar *var) {
+  if (jsvStringEndCache.str==var || jsvStringEndCache.lastBlock==var)
+    jsvStringEndCache.str = 0;
+  if (jsvStringPosCache.str==var || jsvStringPosCache.block==var)
+    jsvStringPosCache.str = 0;
+}
+
 typedef struct JsvStringIterator {
   size_t charIdx; ///< index of character in var
   size_t charsInVar; ///< total characters in var
@@ -99,6 +132,25 @@ static ALWAYS_INLINE void jsvStringIteratorNextInline(JsvStringIterator *it) {
 }
 
 
+/// Number of characters left in the block the iterator is currently on
+static ALWAYS_INLINE size_t jsvStringIteratorGetCharsLeftInBlock(JsvStringIterator *it) {
+  return it->charsInVar - it->charIdx;
+}
+
+/// Pointer to the character the iterator is currently on - only valid while inside the current block
+static ALWAYS_INLINE char *jsvStringIteratorGetPtr(JsvStringIterator *it) {
+  assert(it->ptr && jsvStringIteratorHasChar(it));
+  return &it->ptr[it->charIdx];
+}
+
+/** Skip forward 'count' characters - faster than calling Next repeatedly, but
+ * 1 <= count <= jsvStringIteratorGetCharsLeftInBlock must hold */
+static ALWAYS_INLINE void jsvStringIteratorSkipInBlock(JsvStringIterator *it, size_t count) {
+  assert(count>=1 && count<=jsvStringIteratorGetCharsLeftInBlock(it));
+  it->charIdx += count-1;
+  jsvStringIteratorNextInline(it);
+}
+
 /// Go to the end of the string iterator - for use with jsvStringIteratorAppend
 void jsvStringIteratorGotoEnd(JsvStringIterator *it);
 
@@ -207,10 +207,12 @@ JsVar *_jswrap_array_iterate_with_callback(const char *name, JsVar *parent, JsVa
 
         JsVar *args[3], *cb_result;
         args[0] = jsvIteratorGetValue(&it);
-        args[1] = jsvNewFromInteger(idxValue); // child is a variable name, create a new variable for the index
+        /* if the key is a plain integer (eg from a typed array) it can be passed
+         * straight through - only names need copying into a fresh var */
+        args[1] = jsvIsName(index) ? jsvNewFromInteger(idxValue) : jsvLockAgain(index);
         args[2] = parent;
         cb_result = jspeFunctionCall(funcVar, 0, thisVar, false, 3, args);
-        jsvUnLockMany(2,args);
+        jsvUnLock(args[1]);
         if (cb_result) {
           bool matched;
           if (isBoolCallback)
@@ -218,7 +220,7 @@ JsVar *_jswrap_array_iterate_with_callback(const char *name, JsVar *parent, JsVa
           if (wantArray) {
             if (isBoolCallback) { // filter
               if (matched) {
-                jsvArrayPushAndUnLock(result, jsvIteratorGetValue(&it));
+                jsvArrayPushAndUnLock(result, jsvLockAgain(args[0]));
               }
             } else { // map
               JsVar *name = jsvNewFromInteger(idxValue);
@@ -235,6 +237,7 @@ JsVar *_jswrap_array_iterate_with_callback(const char *name, JsVar *parent, JsVa
           }
           jsvUnLock(cb_result);
         }
+        jsvUnLock(args[0]);
       }
       jsvUnLock(index);
       jsvIteratorNext(&it);
@@ -383,7 +386,7 @@ JsVar *jswrap_array_reduce(JsVar *parent, JsVar *funcVar, JsVar *initialValue) {
       JsVar *args[4];
       args[0] = previousValue;
       args[1] = jsvIteratorGetValue(&it);
-      args[2] = jsvNewFromInteger(idxValue); // child is a variable name, create a new variable for the index
+      args[2] = jsvIsName(index) ? jsvNewFromInteger(idxValue) : jsvLockAgain(index);
       args[3] = parent;
       previousValue = jspeFunctionCall(funcVar, 0, 0, false, 4, args);
       jsvUnLockMany(3,args);
@@ -611,6 +614,66 @@ Returns true if the provided object is an array
  */
 
 
+#ifndef SAVE_ON_FLASH
+/* qsort comparators for the fast numeric sort path. The string variant
+ * reproduces what _jswrap_array_sort_compare does with no compareFn
+ * (compare the printed forms) without creating any vars. */
+static int _jswrap_array_sort_cmp_num(const void *pa, const void *pb) {
+  JsVarFloat a = *(const JsVarFloat*)pa, b = *(const JsVarFloat*)pb;
+  return (a<b) ? -1 : ((a>b) ? 1 : 0);
+}
+static int _jswrap_array_sort_cmp_str(const void *pa, const void *pb) {
+  char bufa[JS_NUMBER_BUFFER_SIZE], bufb[JS_NUMBER_BUFFER_SIZE];
+  ftoa_bounded(*(const JsVarFloat*)pa, bufa, sizeof(bufa));
+  ftoa_bounded(*(const JsVarFloat*)pb, bufb, sizeof(bufb));
+  return strcmp(bufa, bufb);
+}
+
+/* Fast path for sorting with no compare function: if every element is a
+ * number, pull the values out into a C array on the stack, qsort that, and
+ * write the sorted values back in a single pass - rather than calling back
+ * through the iterators (and relinking vars) for every comparison.
+ *
+ * Typed arrays are compared numerically (as the spec says they should be),
+ * normal arrays by printed form to keep `[5,6,8,1].sort()` behaving as
+ * before. Returns false (having changed nothing) if the data isn't all
+ * numeric or there isn't enough stack, in which case the normal sort runs. */
+static bool _jswrap_array_sort_fast(JsVar *array, int n) {
+  if (n<2) return true;
+  if (jsuGetFreeStack() < 256+sizeof(JsVarFloat)*(size_t)n) return false;
+  JsVarFloat *vals = (JsVarFloat*)alloca(sizeof(JsVarFloat)*(size_t)n);
+  bool allInts = true, ok = true;
+  int i = 0;
+  JsvIterator it;
+  jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
+  while (ok && i<n && jsvIteratorHasElement(&it)) {
+    JsVar *v = jsvIteratorGetValue(&it);
+    if (jsvIsInt(v) || jsvIsFloat(v)) {
+      if (!jsvIsInt(v)) allInts = false;
+      vals[i++] = jsvGetFloat(v);
+    } else
+      ok = false;
+    jsvUnLock(v);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  if (!ok || i!=n) return false;
+  qsort(vals, (size_t)n, sizeof(JsVarFloat),
+        jsvIsArrayBuffer(array) ? _jswrap_array_sort_cmp_num : _jswrap_array_sort_cmp_str);
+  jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
+  i = 0;
+  while (i<n && jsvIteratorHasElement(&it)) {
+    JsVar *v = allInts ? jsvNewFromInteger((JsVarInt)vals[i]) : jsvNewFromFloat(vals[i]);
+    jsvIteratorSetValue(&it, v);
+    jsvUnLock(v);
+    i++;
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  return true;
+}
+#endif
+
 NO_INLINE static JsVarInt _jswrap_array_sort_compare(JsVar *a, JsVar *b, JsVar *compareFn) {
   if (compareFn) {
     JsVar *args[2] = {a,b};
@@ -735,6 +798,10 @@ JsVar *jswrap_array_sort (JsVar *array, JsVar *compareFn) {
     n = (int)jsvGetLength(array);
   }
 
+#ifndef SAVE_ON_FLASH
+  if (!compareFn && _jswrap_array_sort_fast(array, n))
+    return jsvLockAgain(array);
+#endif
   jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
   _jswrap_array_sort(&it, n, compareFn);
   jsvIteratorFree(&it);
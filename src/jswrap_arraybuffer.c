@@ -192,7 +192,7 @@ JsVar *jswrap_arraybuffer_constructor(JsVarInt byteLength) {
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -224,7 +224,7 @@ Clamped arrays clamp their values to the allowed range, rather than 'wrapping'.
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -239,7 +239,7 @@ Create a typed array based on the given input. Either an existing Array Buffer,
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -254,7 +254,7 @@ Create a typed array based on the given input. Either an existing Array Buffer,
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -269,7 +269,7 @@ Create a typed array based on the given input. Either an existing Array Buffer,
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -284,7 +284,7 @@ Create a typed array based on the given input. Either an existing Array Buffer,
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -299,7 +299,7 @@ Create a typed array based on the given input. Either an existing Array Buffer,
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
  */
 /*JSON{
   "type" : "constructor",
@@ -314,8 +314,29 @@ Create a typed array based on the given input. Either an existing Array Buffer,
   "return" : ["JsVar","A typed array"],
   "return_object" : "ArrayBufferView"
 }
-Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, or a simple array. If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
- */
+Create a typed array based on the given input. Either an existing Array Buffer, an Integer as a Length, a simple array, or a String (in which case each element is that character's code). If an ArrayBuffer view (eg. Uint8Array rather than ArrayBuffer) is given, it will be completely copied rather than referenced.
+ */
+
+/* If src and dst are ArrayBuffer views with the same element type, both over
+ * contiguous backing data, copy src into dst at dstIdx (in elements) with a
+ * single memmove and return true. memmove because both views can sit on the
+ * same backing buffer. Returns false (nothing copied) if the layouts don't
+ * allow it - the caller should fall back to iterating. */
+static bool arraybufferMemCopy(JsVar *dst, size_t dstIdx, JsVar *src) {
+  if (!jsvIsArrayBuffer(src) || !jsvIsArrayBuffer(dst) ||
+      src->varData.arraybuffer.type != dst->varData.arraybuffer.type)
+    return false;
+  size_t srcLen = 0, dstLen = 0;
+  char *srcPtr = jsvGetDataPointer(src, &srcLen); // len in elements
+  char *dstPtr = jsvGetDataPointer(dst, &dstLen);
+  if (!srcPtr || !dstPtr) return false;
+  if (dstIdx >= dstLen) return true; // nothing to copy to
+  size_t n = srcLen;
+  if (n > dstLen-dstIdx) n = dstLen-dstIdx;
+  size_t elSize = JSV_ARRAYBUFFER_GET_SIZE(dst->varData.arraybuffer.type);
+  memmove(dstPtr + dstIdx*elSize, srcPtr, n*elSize);
+  return true;
+}
 
 JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *arr, JsVarInt byteOffset, JsVarInt length) {
   JsVar *arrayBuffer = 0;
@@ -327,7 +348,7 @@ JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *a
     length = jsvGetInteger(arr);
     byteOffset = 0;
     arrayBuffer = jswrap_arraybuffer_constructor((int)JSV_ARRAYBUFFER_GET_SIZE(type)*length);
-  } else if (jsvIsArray(arr) || jsvIsArrayBuffer(arr)) {
+  } else if (jsvIsArray(arr) || jsvIsArrayBuffer(arr) || jsvIsString(arr)) {
     length = (JsVarInt)jsvGetLength(arr);
     byteOffset = 0;
     arrayBuffer = jswrap_arraybuffer_constructor((int)JSV_ARRAYBUFFER_GET_SIZE(type)*length);
@@ -348,7 +369,27 @@ JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *a
     typedArr->varData.arraybuffer.length = (unsigned short)length;
     jsvSetFirstChild(typedArr, jsvGetRef(jsvRef(arrayBuffer)));
 
-    if (copyData) {
+    if (copyData && jsvIsString(arr)) {
+      // Strings become their character codes. A byte-sized view over
+      // contiguous data can take whole blocks at once
+      size_t dstLen = 0;
+      char *dstPtr = jsvGetDataPointer(typedArr, &dstLen);
+      if (dstPtr && JSV_ARRAYBUFFER_GET_SIZE(type)==1) {
+        jsvGetStringChars(arr, 0, dstPtr, dstLen);
+      } else {
+        JsvStringIterator sit;
+        JsvArrayBufferIterator dit;
+        jsvStringIteratorNew(&sit, arr, 0);
+        jsvArrayBufferIteratorNew(&dit, typedArr, 0);
+        while (jsvStringIteratorHasChar(&sit)) {
+          jsvArrayBufferIteratorSetIntegerValue(&dit, (JsVarInt)(unsigned char)jsvStringIteratorGetChar(&sit));
+          jsvStringIteratorNext(&sit);
+          jsvArrayBufferIteratorNext(&dit);
+        }
+        jsvStringIteratorFree(&sit);
+        jsvArrayBufferIteratorFree(&dit);
+      }
+    } else if (copyData && !arraybufferMemCopy(typedArr, 0, arr)) {
       // if we were given an array, populate this ArrayBuffer
       JsvIterator it;
       jsvIteratorNew(&it, arr, JSIF_DEFINED_ARRAY_ElEMENTS);
@@ -416,6 +457,8 @@ void jswrap_arraybufferview_set(JsVar *parent, JsVar *arr, int offset) {
     jsExceptionHere(JSET_ERROR, "Expecting first argument to be an array, not %t", arr);
     return;
   }
+  if (offset>=0 && arraybufferMemCopy(parent, (size_t)offset, arr))
+    return;
   JsvIterator itsrc;
   jsvIteratorNew(&itsrc, arr, JSIF_EVERY_ARRAY_ELEMENT);
   JsvArrayBufferIterator itdst;
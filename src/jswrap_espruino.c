@@ -18,6 +18,7 @@
 #include "jswrap_arraybuffer.h"
 #include "jswrap_flash.h"
 #include "jswrapper.h"
+#include "jsnative.h"
 #include "jsinteractive.h"
 #include "jstimer.h"
 
@@ -69,6 +70,71 @@ flag was already set nothing will be emitted. To clear error flags
 so that you do get a callback each time a flag is set, call `E.getErrorFlags()`.
 */
 
+/*JSON{
+  "type" : "event",
+  "class" : "E",
+  "name" : "timerFull",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+This event is called when the utility timer's task queue fills up - at that
+point `digitalPulse` and anything else that schedules timer tasks has to
+block (or fail) until a task completes, which usually shows up as glitched
+waveforms. See `E.getTimerUsage()` for the queue statistics, and the
+`util_timer_tasks` entry in the board file to change the queue size.
+
+The event fires once when the queue first fills, and re-arms after the queue
+has drained to half empty.
+*/
+
+/*JSON{
+  "type" : "event",
+  "class" : "E",
+  "name" : "overflow",
+  "ifndef" : "SAVE_ON_FLASH",
+  "params" : [
+    ["device","JsVar","The name of the device that dropped data, eg `'Serial1'`"]
+  ]
+}
+This event is called when the IO event buffer overflows and incoming data
+is lost - unlike the `errorFlag` event it names the device that dropped
+data, and fires for every new overflow rather than only the first one.
+
+```
+E.on('overflow', function(device) {
+  console.log("Lost data from "+device);
+});
+```
+
+See `E.getIOStats()` for running totals of events pushed and dropped per
+device.
+*/
+
+/*JSON{
+  "type" : "event",
+  "class" : "E",
+  "name" : "slowCallback",
+  "ifndef" : "SAVE_ON_FLASH",
+  "params" : [
+    ["info","JsVar","An object `{callback, time}` - the offending function and how long it ran, in seconds"]
+  ]
+}
+This event is fired (from the idle loop) when an event callback - a timer,
+watch, `on('data')` handler, etc - runs for longer than the threshold set
+with `E.setSlowCallbackThreshold()`. While one callback runs, every timer
+queued behind it silently slips, so this is the tool for finding out *which*
+handler causes those hiccups:
+
+```
+E.setSlowCallbackThreshold(10); // flag anything over 10ms
+E.on('slowCallback', function(info) {
+  console.log(info.callback, "took", info.time*1000, "ms");
+});
+```
+
+`E.getSlowCallbacks()` keeps a table of the worst offenders if you'd rather
+poll than listen.
+*/
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "E",
@@ -187,6 +253,108 @@ JsVar *jswrap_espruino_nativeCall(JsVarInt addr, JsVar *signature, JsVar *data)
   return fn;
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "nativeCallBatch",
+  "generate" : "jswrap_espruino_nativeCallBatch",
+  "params" : [
+    ["fn","JsVar","A native function, eg. one returned by `E.nativeCall`"],
+    ["args","JsVar","An array (or typed array) of arguments - these are taken in groups of however many arguments `fn` expects, with one call made per group"]
+  ],
+  "return" : ["JsVar","An array of each call's return value, or the number of calls made if `fn` returns `void`"]
+}
+ADVANCED: Call a native function once per group of arguments, all from a single
+JS call - eg. `E.nativeCallBatch(fusion, samples)` where `samples` is a
+`Float64Array` of interleaved arguments. This avoids the interpreter overhead
+of calling `fusion` from a JS loop, which matters if you're feeding a function
+sensor data at high rates.
+
+The function's numeric arguments are unmarshaled straight out of the array, so
+only `JsVar` arguments and non-`void` return values allocate anything per call.
+ */
+JsVar *jswrap_espruino_nativeCallBatch(JsVar *fn, JsVar *args) {
+  if (!jsvIsNativeFunction(fn)) {
+    jsExceptionHere(JSET_ERROR, "First argument must be a native function, got %t", fn);
+    return 0;
+  }
+  JsnArgumentType argTypes = fn->varData.native.argTypes;
+  if ((argTypes&JSWAT_EXECUTE_IMMEDIATELY_MASK)==JSWAT_EXECUTE_IMMEDIATELY ||
+      (argTypes&JSWAT_THIS_ARG)) {
+    jsExceptionHere(JSET_ERROR, "Can't batch this function");
+    return 0;
+  }
+  // work out what's in each argument slot
+  const int maxArgs = (16/JSWAT_BITS)-1;
+  JsnArgumentType slotType[(16/JSWAT_BITS)-1];
+  int argC = 0;
+  unsigned int argSpec = ((unsigned)argTypes & JSWAT_ARGUMENTS_MASK) >> JSWAT_BITS;
+  while (argSpec && argC<maxArgs) {
+    JsnArgumentType t = (JsnArgumentType)(argSpec & JSWAT_MASK);
+    if (t==JSWAT_ARGUMENT_ARRAY) {
+      jsExceptionHere(JSET_ERROR, "Can't batch a function taking an argument array");
+      return 0;
+    }
+    slotType[argC++] = t;
+    argSpec >>= JSWAT_BITS;
+  }
+  if (!argC) {
+    jsExceptionHere(JSET_ERROR, "Function takes no arguments");
+    return 0;
+  }
+  if (!jsvIsIterable(args)) {
+    jsExceptionHere(JSET_ERROR, "Second argument must be iterable, got %t", args);
+    return 0;
+  }
+  /* set up one var per numeric argument slot and rewrite it each call, so
+   * unmarshaling allocates nothing however many calls we make */
+  JsVar *argData[(16/JSWAT_BITS)-1];
+  bool allocedOk = true;
+  int i;
+  for (i=0;i<argC;i++) {
+    if (slotType[i]==JSWAT_JSVAR) argData[i] = 0; // filled in per call
+    else if (slotType[i]==JSWAT_JSVARFLOAT) allocedOk &= (argData[i] = jsvNewFromFloat(0))!=0;
+    else allocedOk &= (argData[i] = jsvNewFromInteger(0))!=0;
+  }
+  JsVar *results = ((argTypes&JSWAT_MASK)==JSWAT_VOID) ? 0 : jsvNewEmptyArray();
+  if (!allocedOk) {
+    for (i=0;i<argC;i++) jsvUnLock(argData[i]);
+    jsvUnLock(results);
+    return 0;
+  }
+  void *nativePtr = jsvGetNativeFunctionPtr(fn);
+  JsVarInt callCount = 0;
+  JsvIterator it;
+  jsvIteratorNew(&it, args, JSIF_EVERY_ARRAY_ELEMENT);
+  while (jsvIteratorHasElement(&it) && !jspHasError() && !jspIsInterrupted()) {
+    for (i=0;i<argC;i++) {
+      bool hasElement = jsvIteratorHasElement(&it);
+      if (slotType[i]==JSWAT_JSVAR) // passed through as-is, unlocked after the call
+        argData[i] = hasElement ? jsvIteratorGetValue(&it) : 0;
+      else if (slotType[i]==JSWAT_JSVARFLOAT)
+        argData[i]->varData.floating = hasElement ? jsvIteratorGetFloatValue(&it) : 0;
+      else
+        argData[i]->varData.integer = hasElement ? jsvIteratorGetIntegerValue(&it) : 0;
+      if (hasElement) jsvIteratorNext(&it);
+    }
+    JsVar *r = jsnCallFunction(nativePtr, argTypes, 0, argData, argC);
+    callCount++;
+    if (results) jsvArrayPushAndUnLock(results, r);
+    else jsvUnLock(r);
+    for (i=0;i<argC;i++)
+      if (slotType[i]==JSWAT_JSVAR) {
+        jsvUnLock(argData[i]);
+        argData[i] = 0;
+      }
+  }
+  jsvIteratorFree(&it);
+  for (i=0;i<argC;i++)
+    if (slotType[i]!=JSWAT_JSVAR) jsvUnLock(argData[i]);
+  if (results) return results;
+  return jsvNewFromInteger(callCount);
+}
+
 
 /*JSON{
   "type" : "staticmethod",
@@ -324,6 +492,314 @@ JsVarFloat jswrap_espruino_convolve(JsVar *arr1, JsVar *arr2, int offset) {
   return conv;
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "dotProduct",
+  "generate" : "jswrap_espruino_dotProduct",
+  "params" : [
+    ["arr1","JsVar","An array to multiply"],
+    ["arr2","JsVar","An array to multiply"]
+  ],
+  "return" : ["float","The dot product - equivalent to `v=0;for (i in arr1) v+=arr1[i] * arr2[i]`"]
+}
+Multiply the two arrays element-wise and sum the result.
+
+If both arguments are `Int16Array`s the accumulation is done entirely in
+fixed point (64 bit accumulator, two multiply-accumulates per loop so the
+compiler can pair the 16 bit loads), which is fast enough for sample-rate
+DSP work.
+ */
+JsVarFloat jswrap_espruino_dotProduct(JsVar *arr1, JsVar *arr2) {
+  if (!(jsvIsIterable(arr1)) ||
+      !(jsvIsIterable(arr2))) {
+    jsExceptionHere(JSET_ERROR, "Expecting first 2 arguments to be iterable, not %t and %t", arr1, arr2);
+    return NAN;
+  }
+  if (jsvIsArrayBuffer(arr1) && jsvIsArrayBuffer(arr2) &&
+      arr1->varData.arraybuffer.type==ARRAYBUFFERVIEW_INT16 &&
+      arr2->varData.arraybuffer.type==ARRAYBUFFERVIEW_INT16) {
+    size_t l1 = 0, l2 = 0;
+    int16_t *p1 = (int16_t*)jsvGetDataPointer(arr1, &l1);
+    int16_t *p2 = (int16_t*)jsvGetDataPointer(arr2, &l2);
+    if (p1 && p2) {
+      size_t i, n = (l1<l2) ? l1 : l2;
+      int64_t sum = 0;
+      for (i=0;i+1<n;i+=2) // pairs of MACs - SMLAD-shaped for Cortex-M4
+        sum += (int32_t)p1[i]*p2[i] + (int32_t)p1[i+1]*p2[i+1];
+      if (i<n) sum += (int32_t)p1[i]*p2[i];
+      return (JsVarFloat)sum;
+    }
+  }
+  JsVarFloat sum = 0;
+  JsvIterator it1;
+  jsvIteratorNew(&it1, arr1, JSIF_EVERY_ARRAY_ELEMENT);
+  JsvIterator it2;
+  jsvIteratorNew(&it2, arr2, JSIF_EVERY_ARRAY_ELEMENT);
+  while (jsvIteratorHasElement(&it1) && jsvIteratorHasElement(&it2)) {
+    sum += jsvIteratorGetFloatValue(&it1) * jsvIteratorGetFloatValue(&it2);
+    jsvIteratorNext(&it1);
+    jsvIteratorNext(&it2);
+  }
+  jsvIteratorFree(&it1);
+  jsvIteratorFree(&it2);
+  return sum;
+}
+
+/// Read up to n integers out of an iterable into data, returning false if there weren't enough
+static bool jswrap_espruino_getIntArray(JsVar *v, int32_t *data, size_t n) {
+  size_t i = 0;
+  JsvIterator it;
+  jsvIteratorNew(&it, v, JSIF_EVERY_ARRAY_ELEMENT);
+  while (i<n && jsvIteratorHasElement(&it)) {
+    data[i++] = (int32_t)jsvIteratorGetIntegerValue(&it);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  return i==n;
+}
+
+/// Get a contiguous int16 window onto an Int16Array, or 0 (with an exception) if it isn't one
+static int16_t *jswrap_espruino_getInt16Data(JsVar *v, size_t *len, const char *name) {
+  if (jsvIsArrayBuffer(v) && v->varData.arraybuffer.type==ARRAYBUFFERVIEW_INT16) {
+    int16_t *p = (int16_t*)jsvGetDataPointer(v, len);
+    if (p) return p;
+  }
+  jsExceptionHere(JSET_ERROR, "Expecting %s to be a flat Int16Array, got %t", name, v);
+  return 0;
+}
+
+static ALWAYS_INLINE int16_t jswrap_espruino_sat16(int32_t v) {
+  if (v > 32767) return 32767;
+  if (v < -32768) return -32768;
+  return (int16_t)v;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "filterFIR",
+  "generate" : "jswrap_espruino_filterFIR",
+  "params" : [
+    ["dst","JsVar","An Int16Array to write filtered samples into"],
+    ["src","JsVar","An Int16Array of samples to filter"],
+    ["coeffs","JsVar","An array of fixed-point filter coefficients, scaled by `2^shift`"],
+    ["shift","int32","How much to shift the accumulator right by to renormalise (0..31)"]
+  ]
+}
+Run a fixed-point FIR filter over `src`, writing
+`dst[n] = (coeffs[0]*src[n] + coeffs[1]*src[n-1] + ...) >> shift`
+(saturated to 16 bits) for each sample. Samples before the start of
+`src` are treated as zero. `dst` and `src` must be different arrays.
+
+Coefficients are integers scaled by `2^shift` - eg. for a 3 tap moving
+average use `E.filterFIR(dst, src, [85,85,85], 8)`.
+ */
+void jswrap_espruino_filterFIR(JsVar *dst, JsVar *src, JsVar *coeffs, int shift) {
+  size_t dstLen = 0, srcLen = 0;
+  int16_t *dstData = jswrap_espruino_getInt16Data(dst, &dstLen, "dst");
+  if (!dstData) return;
+  int16_t *srcData = jswrap_espruino_getInt16Data(src, &srcLen, "src");
+  if (!srcData) return;
+  if (dstData == srcData) {
+    jsExceptionHere(JSET_ERROR, "dst and src must be different arrays");
+    return;
+  }
+  if (shift<0 || shift>31) {
+    jsExceptionHere(JSET_ERROR, "Shift must be 0..31");
+    return;
+  }
+  size_t ncoeff = (size_t)jsvGetLength(coeffs);
+  if (ncoeff<1 || jsuGetFreeStack() < 256+sizeof(int32_t)*ncoeff) {
+    jsExceptionHere(JSET_ERROR, "Invalid number of coefficients");
+    return;
+  }
+  int32_t *c = (int32_t*)alloca(sizeof(int32_t)*ncoeff);
+  if (!jswrap_espruino_getIntArray(coeffs, c, ncoeff)) return;
+  size_t n, len = (dstLen<srcLen) ? dstLen : srcLen;
+  for (n=0;n<len;n++) {
+    size_t k, kmax = (n+1<ncoeff) ? n+1 : ncoeff;
+    int32_t acc = 0;
+    for (k=0;k<kmax;k++)
+      acc += c[k]*srcData[n-k];
+    dstData[n] = jswrap_espruino_sat16(acc>>shift);
+  }
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "filterBiquad",
+  "generate" : "jswrap_espruino_filterBiquad",
+  "params" : [
+    ["data","JsVar","An Int16Array of samples, filtered in place"],
+    ["coeffs","JsVar","An array of `5*stages` fixed-point coefficients: `b0,b1,b2,a1,a2` per stage, scaled by `2^shift`"],
+    ["shift","int32","How much the coefficients were scaled up by (0..30)"],
+    ["state","JsVar","[optional] an Int32Array of `2*stages` elements carrying filter state between calls (zeroed state is used if not supplied)"]
+  ]
+}
+Run a cascade of fixed-point biquad (second order IIR) sections over
+`data` in place, transposed direct form II:
+
+```
+y    = (b0*x + w1) >> shift
+w1   = b1*x - a1*y + w2
+w2   = b2*x - a2*y
+```
+
+Pass the same `state` array on every call to filter a continuous stream
+block by block.
+ */
+void jswrap_espruino_filterBiquad(JsVar *data, JsVar *coeffs, int shift, JsVar *state) {
+  size_t dataLen = 0;
+  int16_t *samples = jswrap_espruino_getInt16Data(data, &dataLen, "data");
+  if (!samples) return;
+  if (shift<0 || shift>30) {
+    jsExceptionHere(JSET_ERROR, "Shift must be 0..30");
+    return;
+  }
+  size_t ncoeff = (size_t)jsvGetLength(coeffs);
+  size_t stages = ncoeff/5;
+  if (stages<1 || stages*5!=ncoeff ||
+      jsuGetFreeStack() < 256+sizeof(int32_t)*ncoeff) {
+    jsExceptionHere(JSET_ERROR, "Expecting 5 coefficients per stage");
+    return;
+  }
+  int32_t *c = (int32_t*)alloca(sizeof(int32_t)*ncoeff);
+  if (!jswrap_espruino_getIntArray(coeffs, c, ncoeff)) return;
+  int32_t *w = 0;
+  if (!jsvIsUndefined(state)) {
+    size_t stateLen = 0;
+    if (jsvIsArrayBuffer(state) && state->varData.arraybuffer.type==ARRAYBUFFERVIEW_INT32)
+      w = (int32_t*)jsvGetDataPointer(state, &stateLen);
+    if (!w || stateLen < 2*stages) {
+      jsExceptionHere(JSET_ERROR, "Expecting state to be a flat Int32Array of %d elements", 2*stages);
+      return;
+    }
+  }
+  size_t st;
+  for (st=0;st<stages;st++) {
+    int32_t *cs = &c[st*5];
+    int32_t w1 = w ? w[st*2] : 0, w2 = w ? w[st*2+1] : 0;
+    size_t n;
+    for (n=0;n<dataLen;n++) {
+      int32_t x = samples[n];
+      int32_t y = (cs[0]*x + w1) >> shift;
+      w1 = cs[1]*x - cs[3]*y + w2;
+      w2 = cs[2]*x - cs[4]*y;
+      samples[n] = jswrap_espruino_sat16(y);
+    }
+    if (w) {
+      w[st*2] = w1;
+      w[st*2+1] = w2;
+    }
+  }
+}
+
+#define FFT_TWIDDLE_VAR JS_HIDDEN_CHAR_STR"FFTtw"
+
+/* Return the cached twiddle table for an n point FFT - n/2 interleaved
+ * (cos,-sin) pairs kept in a flat string off hiddenRoot, so the repeated
+ * same-size FFTs typical of signal monitoring don't redo the trig every
+ * call. Returns 0 if there wasn't memory to build one. */
+static float *fftGetTwiddles(size_t n) {
+  size_t bytes = sizeof(float)*n; // n/2 entries, 2 floats each
+  JsVar *tw = jsvObjectGetChild(execInfo.hiddenRoot, FFT_TWIDDLE_VAR, 0);
+  if (tw && jsvIsFlatString(tw) && jsvGetStringLength(tw)==bytes) {
+    float *p = (float*)jsvGetFlatStringPointer(tw);
+    jsvUnLock(tw); // hiddenRoot keeps it alive
+    return p;
+  }
+  jsvUnLock(tw);
+  tw = jsvNewFlatStringOfLength((unsigned int)bytes);
+  if (!tw) return 0;
+  float *p = (float*)jsvGetFlatStringPointer(tw);
+  size_t k;
+  for (k=0;k<n/2;k++) {
+    double a = -2.0*PI*(double)k/(double)n;
+    p[k*2] = (float)jswrap_math_sin(a + PI/2); // cos
+    p[k*2+1] = (float)jswrap_math_sin(a);
+  }
+  jsvObjectSetChildAndUnLock(execInfo.hiddenRoot, FFT_TWIDDLE_VAR, tw);
+  return p;
+}
+
+/* In-place complex radix-2 FFT driven by a twiddle table built for
+ * tableN points (tableN may be larger than 2^order - the strides just
+ * get bigger). dir=1 is forward (scales by 1/n), dir=-1 inverse. */
+static void fftExec(int dir, int order, double *x, double *y, const float *tw, size_t tableN) {
+  long n = 1L<<order, i, i1, i2, j, k, l, l1, l2;
+  double tx, ty, t1, t2, u1, u2;
+
+  /* Do the bit reversal */
+  i2 = n >> 1;
+  j = 0;
+  for (i=0;i<n-1;i++) {
+    if (i < j) {
+      tx = x[i]; ty = y[i];
+      x[i] = x[j]; y[i] = y[j];
+      x[j] = tx; y[j] = ty;
+    }
+    k = i2;
+    while (k <= j) {
+      j -= k;
+      k >>= 1;
+    }
+    j += k;
+  }
+
+  /* Butterflies, twiddles straight out of the table */
+  l2 = 1;
+  for (l=0;l<order;l++) {
+    l1 = l2;
+    l2 <<= 1;
+    long step = (long)tableN/l2;
+    for (j=0;j<l1;j++) {
+      long ti = 2*j*step;
+      u1 = tw[ti];
+      u2 = (dir==1) ? tw[ti+1] : -tw[ti+1];
+      for (i=j;i<n;i+=l2) {
+        i1 = i + l1;
+        t1 = u1 * x[i1] - u2 * y[i1];
+        t2 = u1 * y[i1] + u2 * x[i1];
+        x[i1] = x[i] - t1;
+        y[i1] = y[i] - t2;
+        x[i] += t1;
+        y[i] += t2;
+      }
+    }
+  }
+
+  /* Scaling for forward transform */
+  if (dir == 1) {
+    for (i=0;i<n;i++) {
+      x[i] /= (double)n;
+      y[i] /= (double)n;
+    }
+  }
+}
+
+/* Magnitude of output bin k of a real-input pow2 point FFT, recovered from
+ * the pow2/2 point complex FFT of the even/odd packed samples in zr/zi
+ * (already scaled by 2/pow2 - hence the 0.5 here) */
+static double fftRealMag(double *zr, double *zi, const float *tw, size_t pow2, size_t k) {
+  size_t n2 = pow2>>1;
+  if (k>n2) k = pow2-k; // real input - spectrum is symmetric
+  if (k==0) return fabs((zr[0]+zi[0])*0.5);
+  if (k==n2) return fabs((zr[0]-zi[0])*0.5);
+  size_t k2 = n2-k;
+  double ar=zr[k], ai=zi[k], br=zr[k2], bi=zi[k2];
+  double er = (ar+br)*0.5, ei = (ai-bi)*0.5;  // even-sample spectrum
+  double sor = (ai+bi)*0.5, soi = (br-ar)*0.5; // odd-sample spectrum
+  double c = tw[k*2], sn = tw[k*2+1];          // e^(-2pi*i*k/pow2)
+  double xr = er + c*sor - sn*soi;
+  double xi = ei + c*soi + sn*sor;
+  return jswrap_math_sqrt(xr*xr + xi*xi)*0.5;
+}
+
 // http://paulbourke.net/miscellaneous/dft/
 /*
    This computes an in-place complex-to-complex FFT
@@ -431,6 +907,47 @@ void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse) {
     order++;
   }
 
+  bool useModulus = !jsvIsIterable(arrImag);
+  unsigned int i;
+  JsvIterator it;
+
+  /* Real input, forward transform: pack even/odd samples into a half-size
+   * complex FFT and untangle afterwards - half the working memory and a
+   * little over half the butterflies. Needs the twiddle table (also used
+   * for the untangling), so fall through to the complex path without one. */
+  if (useModulus && !inverse && pow2>=4 &&
+      jsuGetFreeStack() >= 100+sizeof(double)*pow2) {
+    float *tw = fftGetTwiddles(pow2);
+    if (tw) {
+      size_t n2 = pow2>>1;
+      double *zr = (double*)alloca(sizeof(double)*n2);
+      double *zi = (double*)alloca(sizeof(double)*n2);
+      i=0;
+      jsvIteratorNew(&it, arrReal, JSIF_EVERY_ARRAY_ELEMENT);
+      while (jsvIteratorHasElement(&it) && i<pow2) {
+        double v = jsvIteratorGetFloatValue(&it);
+        if (i&1) zi[i>>1] = v; else zr[i>>1] = v;
+        i++;
+        jsvIteratorNext(&it);
+      }
+      jsvIteratorFree(&it);
+      while (i<pow2) {
+        if (i&1) zi[i>>1] = 0; else zr[i>>1] = 0;
+        i++;
+      }
+      fftExec(1, order-1, zr, zi, tw, pow2);
+      jsvIteratorNew(&it, arrReal, JSIF_EVERY_ARRAY_ELEMENT);
+      i=0;
+      while (jsvIteratorHasElement(&it)) {
+        jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(fftRealMag(zr, zi, tw, pow2, i))));
+        i++;
+        jsvIteratorNext(&it);
+      }
+      jsvIteratorFree(&it);
+      return;
+    }
+  }
+
   if (jsuGetFreeStack() < 100+sizeof(double)*pow2*2) {
     jsExceptionHere(JSET_ERROR, "Insufficient stack for computing FFT");
     return;
@@ -438,10 +955,7 @@ void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse) {
 
   double *vReal = (double*)alloca(sizeof(double)*pow2);
   double *vImag = (double*)alloca(sizeof(double)*pow2);
-
-  unsigned int i;
   // load data
-  JsvIterator it;
   jsvIteratorNew(&it, arrReal, JSIF_EVERY_ARRAY_ELEMENT);
   i=0;
   while (jsvIteratorHasElement(&it)) {
@@ -464,13 +978,15 @@ void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse) {
   while (i<pow2)
     vImag[i++]=0;
 
-  // do FFT
-  FFT(inverse ? -1 : 1, order, vReal, vImag);
+  // do FFT - via the cached table if we can get one
+  float *tw = (pow2>=4) ? fftGetTwiddles(pow2) : 0;
+  if (tw)
+    fftExec(inverse ? -1 : 1, order, vReal, vImag, tw, pow2);
+  else
+    FFT(inverse ? -1 : 1, order, vReal, vImag);
 
   // Put the results back
   // If we had imaginary data then DON'T modulus the result
-  bool useModulus = !jsvIsIterable(arrImag);
-
   jsvIteratorNew(&it, arrReal, JSIF_EVERY_ARRAY_ELEMENT);
   i=0;
   while (jsvIteratorHasElement(&it)) {
@@ -702,6 +1218,7 @@ Get Espruino's interpreter flags that control the way it handles your JavaScript
 * `pretokenise` - When adding functions, pre-minify them and tokenise reserved words
 * `unsafeFlash` - Some platforms stop writes/erases to interpreter memory to stop you bricking the device accidentally - this removes that protection
 * `unsyncFiles` - When writing files, *don't* flush all data to the SD card after each command (the default is *to* flush). This is much faster, but can cause filesystem damage if power is lost without the filesystem unmounted.
+* `fastMath` - Use single-precision maths for `Math.sin/cos/atan/atan2/sqrt`. Much faster on processors whose FPU only does single precision (eg. Cortex M4F), but results are only accurate to about 7 significant digits.
 */
 /*JSON{
   "type" : "staticmethod",
@@ -737,6 +1254,27 @@ JsVar *jswrap_espruino_toArrayBuffer(JsVar *str) {
   return jsvNewArrayBufferFromString(str, 0);
 }
 
+/* Copy a single String or byte-sized ArrayBuffer view into dstLen contiguous
+ * bytes at dst, a block at a time. Returns false (nothing written) if src's
+ * representation doesn't allow it - the caller should iterate instead. */
+static bool _jswrap_espruino_bytesCopy(char *dst, size_t dstLen, JsVar *src) {
+  if (jsvIsString(src)) {
+    jsvGetStringChars(src, 0, dst, dstLen);
+    return true;
+  }
+  if (jsvIsArrayBuffer(src) &&
+      JSV_ARRAYBUFFER_GET_SIZE(src->varData.arraybuffer.type)==1) {
+    size_t srcLen = 0;
+    char *srcPtr = jsvGetDataPointer(src, &srcLen);
+    if (srcPtr) {
+      if (srcLen > dstLen) srcLen = dstLen;
+      memcpy(dst, srcPtr, srcLen);
+      return true;
+    }
+  }
+  return false;
+}
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "E",
@@ -760,47 +1298,286 @@ void (_jswrap_espruino_toString_char)(int ch,  JsvStringIterator *it) {
 }
 
 JsVar *jswrap_espruino_toString(JsVar *args) {
+  // One argument that is already a flat string? It's immutable - just return it
+  if (jsvGetArrayLength(args)==1) {
+    JsVar *arg = jsvGetArrayItem(args, 0);
+    if (jsvIsFlatString(arg)) return arg;
+    jsvUnLock(arg);
+  }
   JsVar *str = jsvNewFlatStringOfLength((unsigned int)jsvIterateCallbackCount(args));
   if (!str) return 0;
+  // a single string/byte array argument can be copied a block at a time
+  bool copied = false;
+  if (jsvGetArrayLength(args)==1) {
+    JsVar *arg = jsvGetArrayItem(args, 0);
+    copied = _jswrap_espruino_bytesCopy(jsvGetFlatStringPointer(str), jsvGetStringLength(str), arg);
+    jsvUnLock(arg);
+  }
+  if (!copied) {
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, str, 0);
+    jsvIterateCallback(args, (void (*)(int,  void *))_jswrap_espruino_toString_char, &it);
+    jsvStringIteratorFree(&it);
+  }
+  return str;
+}
+
+/// Size in bytes of one element of an E.pack/E.unpack format, or 0 if invalid
+static int structFmtSize(char c) {
+  switch (c) {
+  case 'b': case 'B': case 'x': return 1;
+  case 'h': case 'H': return 2;
+  case 'i': case 'I': case 'f': return 4;
+  case 'd': return 8;
+  default: return 0;
+  }
+}
+
+/* Walk an E.pack/E.unpack format string calling cb for each element.
+ * Digits give a repeat count, '<'/'>' set endianness. Returns the total
+ * byte size, or -1 (with an exception raised) on a bad format. */
+static int structFmtIterate(JsVar *format, void (*cb)(char c, bool bigEndian, size_t byteOffset, void *cbData), void *cbData) {
+  int total = 0;
+  bool bigEndian = false;
+  int repeat = 0;
   JsvStringIterator it;
-  jsvStringIteratorNew(&it, str, 0);
-  jsvIterateCallback(args, (void (*)(int,  void *))_jswrap_espruino_toString_char, &it);
+  jsvStringIteratorNew(&it, format, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    char c = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+    if (c=='<' || c=='>') {
+      bigEndian = (c=='>');
+    } else if (c>='0' && c<='9') {
+      repeat = repeat*10 + (c-'0');
+    } else {
+      int sz = structFmtSize(c);
+      if (!sz) {
+        jsvStringIteratorFree(&it);
+        jsExceptionHere(JSET_ERROR, "Unknown character '%c' in format", c);
+        return -1;
+      }
+      if (repeat<1) repeat = 1;
+      while (repeat--) {
+        if (cb) cb(c, bigEndian, (size_t)total, cbData);
+        total += sz;
+      }
+      repeat = 0;
+    }
+  }
   jsvStringIteratorFree(&it);
-
-  return str;
+  return total;
+}
+
+typedef struct {
+  unsigned char *data; ///< the struct's bytes
+  size_t dataLen;
+  JsVar *values;       ///< array being unpacked into / iterator source when packing
+  JsvIterator it;      ///< next value to pack
+  bool itValid;
+} StructCodecData;
+
+static void structUnpackCb(char c, bool bigEndian, size_t byteOffset, void *cbData) {
+  StructCodecData *d = (StructCodecData*)cbData;
+  int i, sz = structFmtSize(c);
+  if (byteOffset+(size_t)sz > d->dataLen) return; // past the end - caller raises the error
+  union { unsigned char b[8]; int8_t s8; uint16_t u16; int16_t s16; uint32_t u32; int32_t s32; float f; double dbl; } v;
+  // we only build for little endian targets, so swap if the data is big endian
+  for (i=0;i<sz;i++)
+    v.b[i] = d->data[byteOffset + (bigEndian ? (size_t)(sz-1-i) : (size_t)i)];
+  JsVar *var = 0;
+  switch (c) {
+  case 'b': var = jsvNewFromInteger(v.s8); break;
+  case 'B': var = jsvNewFromInteger(v.b[0]); break;
+  case 'h': var = jsvNewFromInteger(v.s16); break;
+  case 'H': var = jsvNewFromInteger(v.u16); break;
+  case 'i': var = jsvNewFromInteger(v.s32); break;
+  case 'I': var = jsvNewFromLongInteger((long long)v.u32); break;
+  case 'f': var = jsvNewFromFloat(v.f); break;
+  case 'd': var = jsvNewFromFloat(v.dbl); break;
+  case 'x': return; // padding - no value
+  }
+  if (var) jsvArrayPushAndUnLock(d->values, var);
+}
+
+static void structPackCb(char c, bool bigEndian, size_t byteOffset, void *cbData) {
+  StructCodecData *d = (StructCodecData*)cbData;
+  int i, sz = structFmtSize(c);
+  union { unsigned char b[8]; int8_t s8; uint16_t u16; int16_t s16; uint32_t u32; int32_t s32; float f; double dbl; } v;
+  v.dbl = 0;
+  if (c!='x') {
+    JsVarFloat fval = 0;
+    JsVarInt ival = 0;
+    if (d->itValid && jsvIteratorHasElement(&d->it)) {
+      if (c=='f' || c=='d') fval = jsvIteratorGetFloatValue(&d->it);
+      else ival = jsvIteratorGetIntegerValue(&d->it);
+      jsvIteratorNext(&d->it);
+    }
+    switch (c) {
+    case 'b': case 'B': v.b[0] = (unsigned char)ival; break;
+    case 'h': case 'H': v.u16 = (uint16_t)ival; break;
+    case 'i': case 'I': v.u32 = (uint32_t)ival; break;
+    case 'f': v.f = (float)fval; break;
+    case 'd': v.dbl = fval; break;
+    }
+  }
+  for (i=0;i<sz;i++)
+    d->data[byteOffset + (bigEndian ? (size_t)(sz-1-i) : (size_t)i)] = v.b[i];
 }
 
 /*JSON{
   "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
   "class" : "E",
-  "name" : "toUint8Array",
-  "generate" : "jswrap_espruino_toUint8Array",
+  "name" : "unpack",
+  "generate" : "jswrap_espruino_unpack",
   "params" : [
-    ["args","JsVarArray","The arguments to convert to a Uint8Array"]
+    ["format","JsVar","A format string (see below)"],
+    ["data","JsVar","A String, Array or ArrayBuffer containing the struct's bytes"],
+    ["offset","int32","The byte offset into `data` to start at (optional)"]
   ],
-  "return" : ["JsVar","A Uint8Array"],
-  "return_object" : "Uint8Array"
-}
-This creates a Uint8Array from the given arguments. If an argument is a String or an Array,
-each element is traversed and added as if it were an 8 bit value. If it is anything else, it is
-converted to an 8 bit value directly.
- */
-void (_jswrap_espruino_toUint8Array_char)(int ch,  JsvArrayBufferIterator *it) {
-  jsvArrayBufferIteratorSetByteValue(it, (char)ch);
-  jsvArrayBufferIteratorNext(it);
+  "return" : ["JsVar","An Array of the decoded values"]
 }
+Decode a packed binary structure into an array of values in a single
+native call - much faster than a DataView getter per field.
 
-JsVar *jswrap_espruino_toUint8Array(JsVar *args) {
-  JsVar *arr = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, jsvIterateCallbackCount(args));
-  if (!arr) return 0;
+The format string contains one character per field:
 
-  JsvArrayBufferIterator it;
-  jsvArrayBufferIteratorNew(&it, arr, 0);
-  jsvIterateCallback(args, (void (*)(int,  void *))_jswrap_espruino_toUint8Array_char, &it);
-  jsvArrayBufferIteratorFree(&it);
+* `b`,`B` - signed/unsigned 8 bit
+* `h`,`H` - signed/unsigned 16 bit
+* `i`,`I` - signed/unsigned 32 bit
+* `f`,`d` - 32/64 bit float
+* `x` - a padding byte (no value produced)
+* `<`,`>` - following fields are little/big endian (little endian is the default)
+* a decimal number repeats the next character, eg `"4H"`
 
-  return arr;
-}
+For example `E.unpack("<HHb", [0x34,0x12,0x78,0x56,0xFF])` returns
+`[0x1234, 0x5678, -1]`.
+ */
+JsVar *jswrap_espruino_unpack(JsVar *format, JsVar *data, int offset) {
+  if (!jsvIsString(format)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting format to be a String, got %t", format);
+    return 0;
+  }
+  int size = structFmtIterate(format, 0, 0);
+  if (size<0) return 0;
+  JSV_GET_AS_CHAR_ARRAY(dataPtr, dataLen, data);
+  if (!dataPtr) return 0;
+  if (offset<0 || (size_t)offset+(size_t)size > dataLen) {
+    jsExceptionHere(JSET_ERROR, "Format needs %d bytes, but only %d available", size, (int)dataLen-offset);
+    return 0;
+  }
+  StructCodecData cbData;
+  cbData.data = (unsigned char*)dataPtr + offset;
+  cbData.dataLen = (size_t)size;
+  cbData.values = jsvNewEmptyArray();
+  cbData.itValid = false;
+  if (!cbData.values) return 0;
+  structFmtIterate(format, structUnpackCb, &cbData);
+  return cbData.values;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "pack",
+  "generate" : "jswrap_espruino_pack",
+  "params" : [
+    ["format","JsVar","A format string (see `E.unpack` for the characters allowed)"],
+    ["data","JsVar","An Array (or other iterable) of values to pack"]
+  ],
+  "return" : ["JsVar","An ArrayBuffer containing the packed structure"]
+}
+Pack an array of values into a binary structure according to `format`
+(see `E.unpack`), returning a new ArrayBuffer. Missing values are
+treated as 0, and padding (`x`) bytes are written as 0.
+
+For example `E.pack("<Hb", [0x1234, -1])` returns an ArrayBuffer
+containing `0x34,0x12,0xFF`.
+ */
+JsVar *jswrap_espruino_pack(JsVar *format, JsVar *data) {
+  if (!jsvIsString(format)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting format to be a String, got %t", format);
+    return 0;
+  }
+  int size = structFmtIterate(format, 0, 0);
+  if (size<0) return 0;
+  JsVar *str = jsvNewFlatStringOfLength((unsigned int)size);
+  if (!str) return 0;
+  StructCodecData cbData;
+  cbData.data = (unsigned char*)jsvGetFlatStringPointer(str);
+  cbData.dataLen = (size_t)size;
+  cbData.values = 0;
+  cbData.itValid = jsvIsIterable(data);
+  if (cbData.itValid)
+    jsvIteratorNew(&cbData.it, data, JSIF_EVERY_ARRAY_ELEMENT);
+  structFmtIterate(format, structPackCb, &cbData);
+  if (cbData.itValid)
+    jsvIteratorFree(&cbData.it);
+  JsVar *ab = jsvNewArrayBufferFromString(str, (unsigned int)size);
+  jsvUnLock(str);
+  return ab;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "toUint8Array",
+  "generate" : "jswrap_espruino_toUint8Array",
+  "params" : [
+    ["args","JsVarArray","The arguments to convert to a Uint8Array"]
+  ],
+  "return" : ["JsVar","A Uint8Array"],
+  "return_object" : "Uint8Array"
+}
+This creates a Uint8Array from the given arguments. If an argument is a String or an Array,
+each element is traversed and added as if it were an 8 bit value. If it is anything else, it is
+converted to an 8 bit value directly.
+
+If the only argument is a flat String the Uint8Array is created as a *view* over the string's
+data (like `new Uint8Array(E.toArrayBuffer(str))`) rather than a copy, so no extra memory is
+used and no time is spent copying.
+ */
+void (_jswrap_espruino_toUint8Array_char)(int ch,  JsvArrayBufferIterator *it) {
+  jsvArrayBufferIteratorSetByteValue(it, (char)ch);
+  jsvArrayBufferIteratorNext(it);
+}
+
+JsVar *jswrap_espruino_toUint8Array(JsVar *args) {
+  // One argument that's a flat string? Return a view over it rather than copying
+  if (jsvGetArrayLength(args)==1) {
+    JsVar *arg = jsvGetArrayItem(args, 0);
+    if (jsvIsFlatString(arg)) {
+      JsVar *ab = jsvNewArrayBufferFromString(arg, 0);
+      jsvUnLock(arg);
+      if (ab) {
+        JsVar *u8 = jswrap_typedarray_constructor(ARRAYBUFFERVIEW_UINT8, ab, 0, 0);
+        jsvUnLock(ab);
+        return u8;
+      }
+    } else
+      jsvUnLock(arg);
+  }
+  JsVar *arr = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, jsvIterateCallbackCount(args));
+  if (!arr) return 0;
+
+  // a single string/byte array argument can be copied a block at a time
+  bool copied = false;
+  size_t dstLen = 0;
+  char *dstPtr = jsvGetDataPointer(arr, &dstLen);
+  if (dstPtr && jsvGetArrayLength(args)==1) {
+    JsVar *arg = jsvGetArrayItem(args, 0);
+    copied = _jswrap_espruino_bytesCopy(dstPtr, dstLen, arg);
+    jsvUnLock(arg);
+  }
+  if (!copied) {
+    JsvArrayBufferIterator it;
+    jsvArrayBufferIteratorNew(&it, arr, 0);
+    jsvIterateCallback(args, (void (*)(int,  void *))_jswrap_espruino_toUint8Array_char, &it);
+    jsvArrayBufferIteratorFree(&it);
+  }
+  return arr;
+}
 
 /*JSON{
   "type" : "staticmethod",
@@ -828,11 +1605,51 @@ JsVar *jswrap_espruino_memoryArea(int addr, int len) {
     jsExceptionHere(JSET_ERROR, "Memory area too long! Max is 65535 bytes\n");
     return 0;
   }
-  JsVar *v = jsvNewWithFlags(JSV_NATIVE_STRING);
-  if (!v) return 0;
-  v->varData.nativeStr.ptr = (char*)(size_t)addr;
-  v->varData.nativeStr.len = (uint16_t)len;
-  return v;
+  return jsvNewNativeString((char*)(size_t)addr, (size_t)len);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "memoryMap",
+  "generate" : "jswrap_espruino_memoryMap",
+  "params" : [
+    ["addr","int","A flash address (as used by the `Flash` module)"],
+    ["len","int","The length (in bytes) of flash to map - max 65535"]
+  ],
+  "return" : ["JsVar","An ArrayBuffer backed directly by flash"]
+}
+Return an ArrayBuffer whose contents are read straight out of flash memory
+rather than being copied into RAM. Typed array views and `DataView` work on
+it as usual, so big lookup or calibration tables written with the `Flash`
+module can be used in place for no RAM cost:
+
+```
+var table = new Uint16Array(E.memoryMap(addr, 1024));
+var y = table[x]; // read straight from flash
+```
+
+The buffer is effectively read-only - writes to it won't change flash, and
+their effect is undefined. On boards where flash isn't visible in the CPU's
+address space this throws an error.
+*/
+JsVar *jswrap_espruino_memoryMap(int addr, int len) {
+  if (len<=0) return 0;
+  if (len>65535) {
+    jsExceptionHere(JSET_ERROR, "Memory area too long! Max is 65535 bytes\n");
+    return 0;
+  }
+  size_t mapped = jshFlashGetMemMapAddress((uint32_t)addr);
+  if (!mapped) {
+    jsExceptionHere(JSET_ERROR, "Flash is not memory-mapped on this board");
+    return 0;
+  }
+  JsVar *str = jsvNewNativeString((char*)mapped, (size_t)len);
+  if (!str) return 0; // out of memory
+  JsVar *ab = jsvNewArrayBufferFromString(str, (unsigned int)len);
+  jsvUnLock(str);
+  return ab;
 }
 
 /*JSON{
@@ -942,6 +1759,75 @@ int jswrap_espruino_reverseByte(int v) {
   return (((b * 0x0802LU & 0x22110LU) | (b * 0x8020LU & 0x88440LU)) * 0x10101LU >> 16) & 0xFF;
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "CRC32",
+  "generate" : "jswrap_espruino_CRC32",
+  "params" : [
+    ["data","JsVar","Data to checksum - a String or an ArrayBuffer/Typed Array"]
+  ],
+  "return" : ["JsVar","The CRC of the supplied data"]
+}
+Calculate the standard (IEEE 802.3/zlib) CRC-32 of the supplied data,
+processed as bytes. This is the same CRC you'd get from `zlib.crc32` or
+`binascii.crc32` in Python, and is many times faster than a byte-by-byte
+JavaScript loop.
+ */
+/* Both CRCs below use a 16 entry nibble table - 4x faster than the
+ * bit-at-a-time loop, but only 64/32 bytes of table instead of the 1KB
+ * a full byte table would cost us in flash. */
+JsVar *jswrap_espruino_CRC32(JsVar *data) {
+  static const uint32_t crc32Table[16] = { // nibble table for poly 0xEDB88320 (reflected)
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  JSV_GET_AS_CHAR_ARRAY(dataPtr, dataLen, data);
+  if (!dataPtr) return 0;
+  uint32_t crc = 0xFFFFFFFF;
+  size_t i;
+  for (i=0;i<dataLen;i++) {
+    crc = (crc>>4) ^ crc32Table[(crc ^ (uint32_t)(unsigned char)dataPtr[i]) & 0x0F];
+    crc = (crc>>4) ^ crc32Table[(crc ^ ((uint32_t)(unsigned char)dataPtr[i] >> 4)) & 0x0F];
+  }
+  return jsvNewFromLongInteger((long long)(crc ^ 0xFFFFFFFF));
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "CRC16",
+  "generate" : "jswrap_espruino_CRC16",
+  "params" : [
+    ["data","JsVar","Data to checksum - a String or an ArrayBuffer/Typed Array"]
+  ],
+  "return" : ["int32","The CRC of the supplied data"]
+}
+Calculate the CRC-16/MODBUS of the supplied data, processed as bytes -
+polynomial `0xA001` (reflected `0x8005`), initial value `0xFFFF`, no final
+XOR. This is the checksum used on Modbus RTU frames and by many radio
+protocols. Note that Modbus sends the result low byte first.
+ */
+int jswrap_espruino_CRC16(JsVar *data) {
+  static const uint16_t crc16Table[16] = { // nibble table for poly 0xA001 (reflected 0x8005)
+    0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+    0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+  };
+  JSV_GET_AS_CHAR_ARRAY(dataPtr, dataLen, data);
+  if (!dataPtr) return 0;
+  uint16_t crc = 0xFFFF;
+  size_t i;
+  for (i=0;i<dataLen;i++) {
+    crc = (uint16_t)((crc>>4) ^ crc16Table[(crc ^ (uint16_t)(unsigned char)dataPtr[i]) & 0x0F]);
+    crc = (uint16_t)((crc>>4) ^ crc16Table[(crc ^ ((uint16_t)(unsigned char)dataPtr[i] >> 4)) & 0x0F]);
+  }
+  return crc;
+}
+
 
 /*JSON{
   "type" : "staticmethod",
@@ -956,6 +1842,597 @@ void jswrap_espruino_dumpTimers() {
   jstDumpUtilityTimers();
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "getTimerUsage",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_getTimerUsage",
+  "params" : [
+    ["reset","bool","If true, restart the high-water mark from the current occupancy"]
+  ],
+  "return" : ["JsVar","An object with utility timer task queue statistics - see below"]
+}
+Return statistics about the utility timer's task queue, which is used by
+`digitalPulse`, `E.pulse`, `Waveform`, software PWM and short intervals:
+
+```
+{ used: 2,       // tasks queued right now
+  total: 16,     // size of the queue ('util_timer_tasks' in the board file)
+  highWater: 9 } // the most tasks ever queued at once
+```
+
+When the queue fills, `digitalPulse` and friends have to block (or give up) -
+watch `highWater` in stress tests to check you have headroom, and see
+`E.on('timerFull', ...)` for an event when it actually fills.
+ */
+JsVar *jswrap_espruino_getTimerUsage(bool reset) {
+  JsVar *o = jsvNewObject();
+  if (!o) return 0;
+  jsvObjectSetChildAndUnLock(o, "used", jsvNewFromInteger(jstGetUtilTimerTasksUsed()));
+  jsvObjectSetChildAndUnLock(o, "total", jsvNewFromInteger(UTILTIMERTASK_TASKS));
+  jsvObjectSetChildAndUnLock(o, "highWater", jsvNewFromInteger(jstGetUtilTimerTasksHighWater(reset)));
+  return o;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "defrag",
+  "generate" : "jswrap_espruino_defrag",
+  "return" : ["int","The number of variables that were moved"]
+}
+Defragment Espruino's variable storage - garbage collect, then move variables
+around so that the free memory that remains is all in one contiguous block.
+
+Allocating a Flat String (used for instance by `Graphics.createArrayBuffer`
+and `E.toString`) needs a run of contiguous free blocks, which can be
+impossible to find on a long-running system even when plenty of memory is
+free in total. Calling `E.defrag()` before making such an allocation will
+usually fix that.
+
+**Note:** this has to move memory around so it can take a while on boards
+with a lot of variables, and it does nothing while the utility timer (eg.
+`analogWrite` with `soft:false`, or Waveforms) is in use.
+*/
+int jswrap_espruino_defrag() {
+  if (jstUtilTimerIsRunning()) {
+    jsWarn("Can't defrag while utility timer is running");
+    return 0;
+  }
+  return jsvDefragment();
+}
+
+#ifndef SAVE_ON_FLASH
+// --------------------------------------------- sampling profiler
+static JsVar *profileCountsVar = 0;  ///< flat string holding the histogram - locked while profiling so the data pointer stays put
+static uint32_t *profileCounts = 0;  ///< points into profileCountsVar's data
+static uint32_t profileBuckets = 0;
+static uint32_t profileRange = 0;
+static uint32_t profileIntervalUs = 0;
+static volatile uint32_t profileSamples = 0;
+static volatile uint32_t profileOutside = 0;
+
+/* Runs in the utility timer IRQ. It only reads the lexer's position fields
+ * and increments words, and the interpreter may be mid-token when we fire -
+ * so a sample can occasionally land in a neighbouring bucket, which doesn't
+ * matter for a histogram. */
+static void jswrap_espruino_profileSample(JsSysTime time, void *userdata) {
+  NOT_USED(time);
+  NOT_USED(userdata);
+  profileSamples++;
+  JsLex *l = lex;
+  if (l) {
+    uint32_t pos = (uint32_t)jsvStringIteratorGetIndex(&l->tokenStart.it);
+    if (pos < profileRange) {
+      profileCounts[(uint32_t)(((uint64_t)pos * profileBuckets) / profileRange)]++;
+      return;
+    }
+  }
+  profileOutside++;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "startProfile",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_startProfile",
+  "params" : [
+    ["options","JsVar","Optional `{ interval : int, range : int, buckets : int }`"]
+  ]
+}
+Start the sampling profiler. A utility timer interrupt fires every `interval`
+microseconds (default 1000) and records which character of the source the
+interpreter is currently executing, into a histogram of `buckets` counters
+(default 256, max 1024) covering source positions `0` to `range` (default
+4096). Call `E.stopProfile()` to stop sampling and get the data.
+
+Sampling carries on while your code runs at full speed, so hot spots show up
+without slowing anything down - though short `interval`s cost some time in
+the interrupt itself.
+*/
+void jswrap_espruino_startProfile(JsVar *options) {
+  JsVarInt interval = 1000, range = 4096, buckets = 256;
+  jsvConfigObject configs[] = {
+      {"interval", JSV_INTEGER, &interval},
+      {"range", JSV_INTEGER, &range},
+      {"buckets", JSV_INTEGER, &buckets}
+  };
+  if (!jsvReadConfigObject(options, configs, sizeof(configs) / sizeof(jsvConfigObject)))
+    return;
+  if (profileCountsVar) {
+    jsExceptionHere(JSET_ERROR, "Profiler is already running");
+    return;
+  }
+  if (interval < 100) interval = 100;
+  if (range < 1) range = 1;
+  if (range > 0x400000) range = 0x400000;
+  if (buckets < 1) buckets = 1;
+  if (buckets > 1024) buckets = 1024;
+  JsVar *counts = jsvNewFlatStringOfLength((unsigned int)buckets * sizeof(uint32_t));
+  if (!counts) {
+    jsExceptionHere(JSET_ERROR, "Not enough contiguous memory for %d buckets", buckets);
+    return;
+  }
+  size_t len;
+  profileCounts = (uint32_t *)jsvGetDataPointer(counts, &len);
+  profileCountsVar = counts; // keep it locked - the IRQ writes through profileCounts
+  profileBuckets = (uint32_t)buckets;
+  profileRange = (uint32_t)range;
+  profileIntervalUs = (uint32_t)interval;
+  profileSamples = 0;
+  profileOutside = 0;
+  JsSysTime t = jshGetTimeFromMilliseconds(interval / 1000.0);
+  if (!jstExecuteFn(jswrap_espruino_profileSample, NULL, jshGetSystemTime() + t, (uint32_t)t)) {
+    jsvUnLock(profileCountsVar);
+    profileCountsVar = 0;
+    profileCounts = 0;
+    jsExceptionHere(JSET_ERROR, "Timer is full");
+  }
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "stopProfile",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_stopProfile",
+  "return" : ["JsVar","An object with the sampled data - see below"]
+}
+Stop the sampling profiler started with `E.startProfile()` and return what it
+saw:
+
+```
+{ interval : 1000,  // microseconds between samples
+  range : 4096,     // source characters covered by the histogram
+  samples : 1234,   // how many samples were taken in total
+  outside : 56,     // samples while idle, or past 'range'
+  counts : Uint32Array(256) } // counts[i] covers source chars [i*range/buckets, (i+1)*range/buckets)
+```
+
+To map a bucket back to code, multiply its index by `range/counts.length` to
+get the character position in the string you evaluated (for a function, use
+`E.getSizeOf`/`trace` or simply search, as positions are within the whole
+source buffer).
+*/
+JsVar *jswrap_espruino_stopProfile() {
+  if (!profileCountsVar) {
+    jsExceptionHere(JSET_ERROR, "Profiler is not running");
+    return 0;
+  }
+  jstStopExecuteFn(jswrap_espruino_profileSample, NULL);
+  JsVar *counts = profileCountsVar;
+  profileCountsVar = 0;
+  profileCounts = 0;
+  JsVar *result = jsvNewObject();
+  if (result) {
+    jsvObjectSetChildAndUnLock(result, "interval", jsvNewFromInteger((JsVarInt)profileIntervalUs));
+    jsvObjectSetChildAndUnLock(result, "range", jsvNewFromInteger((JsVarInt)profileRange));
+    jsvObjectSetChildAndUnLock(result, "samples", jsvNewFromInteger((JsVarInt)profileSamples));
+    jsvObjectSetChildAndUnLock(result, "outside", jsvNewFromInteger((JsVarInt)profileOutside));
+    JsVar *ab = jsvNewArrayBufferFromString(counts, 0);
+    if (ab) {
+      jsvObjectSetChildAndUnLock(result, "counts",
+          jswrap_typedarray_constructor(ARRAYBUFFERVIEW_UINT32, ab, 0, 0));
+      jsvUnLock(ab);
+    }
+  }
+  jsvUnLock(counts);
+  return result;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "setFunctionStats",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_setFunctionStats",
+  "params" : [
+    ["enable","bool","Whether to count function calls or not"]
+  ]
+}
+Enable (or disable) per-function call statistics. While enabled, every
+function call is counted and its execution time accumulated - see
+`E.getFunctionStats()`. Enabling resets any previously collected data.
+
+The only overhead per call is two timer reads and a small hash table
+update, so unlike wrapping functions with `getTime()` by hand this barely
+distorts what you're measuring.
+*/
+void jswrap_espruino_setFunctionStats(bool enable) {
+  if (enable) jspFunctionStatsReset();
+  jspFunctionStatsEnabled = enable;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "getFunctionStats",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_getFunctionStats",
+  "return" : ["JsVar","An array of `{func, calls, time}` objects, most time first"]
+}
+Return what `E.setFunctionStats(true)` has collected so far: one entry per
+function, sorted with the biggest total time first:
+
+```
+[ { func : function () { ... }, // the function itself (if still around)
+    calls : 123,                // invocations
+    time : 0.456 },             // cumulative seconds, including callees
+  ... ]
+```
+
+`time` is inclusive - a function's callees are counted in it too - and is
+measured wall-clock, so interrupts and timer callbacks land in whatever
+was running. The table holds 64 distinct functions; calls beyond that are
+dropped. If a function has been freed since it ran, `func` is left out.
+*/
+JsVar *jswrap_espruino_getFunctionStats() {
+  JsVar *arr = jsvNewEmptyArray();
+  if (!arr) return 0;
+  bool used[JSPARSE_FUNCTION_STATS] = {false};
+  while (true) {
+    // pick the biggest remaining entry - the table's tiny, so just rescan
+    int best = -1;
+    int i;
+    for (i=0;i<JSPARSE_FUNCTION_STATS;i++)
+      if (jspFunctionStats[i].ref && !used[i] &&
+          (best<0 || jspFunctionStats[i].time > jspFunctionStats[best].time))
+        best = i;
+    if (best<0) break;
+    used[best] = true;
+    JspFunctionStat *s = &jspFunctionStats[best];
+    JsVar *o = jsvNewObject();
+    if (!o) break;
+    JsVar *f = _jsvGetAddressOf(s->ref);
+    if (f && jsvIsFunction(f))
+      jsvObjectSetChildAndUnLock(o, "func", jsvLockAgain(f));
+    jsvObjectSetChildAndUnLock(o, "calls", jsvNewFromInteger((JsVarInt)s->calls));
+    jsvObjectSetChildAndUnLock(o, "time", jsvNewFromFloat(jshGetMillisecondsFromTime(s->time)/1000));
+    jsvArrayPushAndUnLock(arr, o);
+  }
+  return arr;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "memStats",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_memStats",
+  "return" : ["JsVar","An object containing memory and garbage collector statistics"]
+}
+Return detailed memory and garbage collector statistics - unlike
+`process.memory()` this doesn't run a GC pass, it just reports on what has
+happened so far:
+
+```
+{ total : 2500,          // total variables
+  free : 1700,           // free variables
+  freeFragments : 12,    // how many separate runs of free blocks there are
+  largestFree : 900,     // longest contiguous free run (the biggest flat string that could be allocated)
+  allocations : 345,     // variables allocated since the last GC pass
+  gcCount : 27,          // GC passes since boot
+  gcPauses : [25,2,0,0,0,0,0,0], // pause histogram - bucket n counts passes shorter than (1<<n) ms
+  types : { object : 40, array : 5, function : 30, string : 200,
+            stringExt : 150, flatString : 2, name : 250,
+            int : 60, float : 10, arraybuffer : 3, other : 0 } }
+```
+
+Checking this periodically lets you spot degradation (GC pauses creeping up,
+`largestFree` shrinking through fragmentation, a runaway allocation rate)
+long before an allocation actually fails. `E.defrag()` can help if
+`largestFree` is much smaller than `free`.
+*/
+JsVar *jswrap_espruino_memStats() {
+  JsvMemoryStats s;
+  jsvGetMemoryStatistics(&s);
+  JsVar *obj = jsvNewObject();
+  if (!obj) return 0;
+  jsvObjectSetChildAndUnLock(obj, "total", jsvNewFromInteger((JsVarInt)s.total));
+  jsvObjectSetChildAndUnLock(obj, "free", jsvNewFromInteger((JsVarInt)s.free));
+  jsvObjectSetChildAndUnLock(obj, "freeFragments", jsvNewFromInteger((JsVarInt)s.freeFragments));
+  jsvObjectSetChildAndUnLock(obj, "largestFree", jsvNewFromInteger((JsVarInt)s.largestFreeRun));
+  jsvObjectSetChildAndUnLock(obj, "allocations", jsvNewFromInteger((JsVarInt)s.allocationsSinceGC));
+  jsvObjectSetChildAndUnLock(obj, "gcCount", jsvNewFromInteger((JsVarInt)s.gcCount));
+  JsVar *pauses = jsvNewEmptyArray();
+  if (pauses) {
+    int i;
+    for (i=0;i<JSV_GC_PAUSE_HISTOGRAM_SIZE;i++)
+      jsvArrayPushAndUnLock(pauses, jsvNewFromInteger((JsVarInt)s.gcPauses[i]));
+    jsvObjectSetChildAndUnLock(obj, "gcPauses", pauses);
+  }
+  JsVar *types = jsvNewObject();
+  if (types) {
+    jsvObjectSetChildAndUnLock(types, "object", jsvNewFromInteger((JsVarInt)s.objects));
+    jsvObjectSetChildAndUnLock(types, "array", jsvNewFromInteger((JsVarInt)s.arrays));
+    jsvObjectSetChildAndUnLock(types, "function", jsvNewFromInteger((JsVarInt)s.functions));
+    jsvObjectSetChildAndUnLock(types, "string", jsvNewFromInteger((JsVarInt)s.strings));
+    jsvObjectSetChildAndUnLock(types, "stringExt", jsvNewFromInteger((JsVarInt)s.stringExts));
+    jsvObjectSetChildAndUnLock(types, "flatString", jsvNewFromInteger((JsVarInt)s.flatStrings));
+    jsvObjectSetChildAndUnLock(types, "name", jsvNewFromInteger((JsVarInt)s.names));
+    jsvObjectSetChildAndUnLock(types, "int", jsvNewFromInteger((JsVarInt)s.integers));
+    jsvObjectSetChildAndUnLock(types, "float", jsvNewFromInteger((JsVarInt)s.floats));
+    jsvObjectSetChildAndUnLock(types, "arraybuffer", jsvNewFromInteger((JsVarInt)s.arrayBuffers));
+    jsvObjectSetChildAndUnLock(types, "other", jsvNewFromInteger((JsVarInt)s.other));
+    jsvObjectSetChildAndUnLock(obj, "types", types);
+  }
+  return obj;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "getOpCounters",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_getOpCounters",
+  "params" : [
+    ["reset","bool","If true, zero the counters after reading them"]
+  ],
+  "return" : ["JsVar","An object `{allocs, childProbes, tokens}`"]
+}
+Return deterministic counts of the interpreter's basic operations:
+
+* `allocs` : variables allocated (`jsvNewWithFlags` calls)
+* `childProbes` : hash/list probes made looking object/array children up by
+  name - the cost of property lookup
+* `tokens` : tokens the lexer has consumed
+
+Unlike timing, these are exactly reproducible run to run, so tests can
+assert performance *invariants* rather than thresholds - "this loop
+allocates nothing", "that change didn't double lookup work":
+
+```
+var a = E.getOpCounters();
+doSomething();
+var b = E.getOpCounters();
+print(b.allocs-a.allocs, "allocations");
+```
+
+See `tests/test_perf_*.js` for examples that run in the test suite.
+*/
+JsVar *jswrap_espruino_getOpCounters(bool reset) {
+  JsVar *o = jsvNewObject();
+  if (!o) return 0;
+  jsvObjectSetChildAndUnLock(o, "allocs", jsvNewFromInteger((JsVarInt)jsvOpAllocCount));
+  jsvObjectSetChildAndUnLock(o, "childProbes", jsvNewFromInteger((JsVarInt)jsvOpFindChildProbes));
+  jsvObjectSetChildAndUnLock(o, "tokens", jsvNewFromInteger((JsVarInt)jslOpTokenCount));
+  if (reset) jsvOpCountersReset();
+  return o;
+}
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+/* Cortex-M3 and up have the DWT cycle counter. The addresses are fixed by
+ * the ARMv7-M architecture, so this works without the vendor headers (which
+ * aren't visible from here anyway). */
+#define BENCH_DWT_CTRL   (*(volatile uint32_t *)0xE0001000)
+#define BENCH_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#define BENCH_DEMCR      (*(volatile uint32_t *)0xE000EDFC)
+#define BENCH_HAS_CYCLE_COUNTER
+static void benchCyclesEnable() {
+  BENCH_DEMCR |= 1<<24;    // TRCENA - turn the DWT on
+  BENCH_DWT_CTRL |= 1;     // CYCCNTENA - start the cycle counter
+}
+#endif
+
+static void benchSortU32(uint32_t *d, int n) {
+  int i;
+  for (i=1;i<n;i++) {
+    uint32_t v = d[i];
+    int j = i-1;
+    while (j>=0 && d[j]>v) { d[j+1]=d[j]; j--; }
+    d[j+1] = v;
+  }
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "bench",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_bench",
+  "params" : [
+    ["fn","JsVar","The function to benchmark"],
+    ["options","JsVar","[optional] An object `{n:10}` - how many times to run `fn` (max 256)"]
+  ],
+  "return" : ["JsVar","An object with the timing results - see below"]
+}
+Run `fn` repeatedly and time each run on the device itself, so the numbers
+don't include serial round-trips or host-side noise:
+
+```
+E.bench(function() { for (var i=0;i<1000;i++); }, {n:20});
+// { iterations : 20,
+//   min : 0.01217,     // fastest run, in seconds
+//   median : 0.01225,  // median run, in seconds
+//   cycles : { min : 875421, median : 881002 } } // Cortex-M3 and up only
+```
+
+The cost of reading the clock around each run is measured first and
+subtracted, and `min`/`median` are reported rather than a mean so that a
+stray interrupt in one run doesn't drag the result around. On boards with
+a DWT cycle counter (Cortex-M3/M4) `cycles` gives the same statistics
+cycle-accurately; elsewhere only the system timer is used.
+*/
+JsVar *jswrap_espruino_bench(JsVar *fn, JsVar *options) {
+  if (!jsvIsFunction(fn)) {
+    jsExceptionHere(JSET_TYPEERROR, "Function expected, got %t", fn);
+    return 0;
+  }
+  JsVarInt n = 10;
+  jsvConfigObject configs[] = {{"n", JSV_INTEGER, &n}};
+  if (!jsvReadConfigObject(options, configs, 1)) return 0;
+  if (n<1) n=1;
+  if (n>256) n=256;
+  // sample storage - a flat string keeps it off the (small) C stack
+  JsVar *buf = jsvNewFlatStringOfLength((unsigned int)(n*8));
+  if (!buf) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory for %d samples", (int)n);
+    return 0;
+  }
+  size_t bufLen;
+  uint32_t *timeSamples = (uint32_t*)jsvGetDataPointer(buf, &bufLen);
+  uint32_t *cycleSamples = &timeSamples[n];
+#ifdef BENCH_HAS_CYCLE_COUNTER
+  benchCyclesEnable();
+#endif
+  /* Measure the cost of the timing bracket itself (with nothing inside it)
+   * and subtract it from every sample - take the minimum of a few tries so
+   * an interrupt during calibration can't inflate it */
+  uint32_t timeOverhead = 0xFFFFFFFF;
+#ifdef BENCH_HAS_CYCLE_COUNTER
+  uint32_t cycleOverhead = 0xFFFFFFFF;
+#endif
+  int i;
+  for (i=0;i<16;i++) {
+    JsSysTime t0 = jshGetSystemTime();
+#ifdef BENCH_HAS_CYCLE_COUNTER
+    uint32_t c0 = BENCH_DWT_CYCCNT;
+    uint32_t dc = BENCH_DWT_CYCCNT - c0;
+    if (dc < cycleOverhead) cycleOverhead = dc;
+#endif
+    JsSysTime dt = jshGetSystemTime() - t0;
+    if ((uint32_t)dt < timeOverhead) timeOverhead = (uint32_t)dt;
+  }
+  bool ok = true;
+  for (i=0;i<n;i++) {
+    JsSysTime t0 = jshGetSystemTime();
+#ifdef BENCH_HAS_CYCLE_COUNTER
+    uint32_t c0 = BENCH_DWT_CYCCNT;
+#endif
+    jsvUnLock(jspExecuteFunction(fn, 0, 0, NULL));
+#ifdef BENCH_HAS_CYCLE_COUNTER
+    uint32_t dc = BENCH_DWT_CYCCNT - c0;
+#endif
+    JsSysTime dt = jshGetSystemTime() - t0;
+    if (jspHasError() || jspIsInterrupted()) {
+      ok = false; // an exception/Ctrl-C in fn - let it propagate
+      break;
+    }
+    if (dt > 0xFFFFFFFF) dt = 0xFFFFFFFF; // a 'micro'benchmark - clamp rather than wrap
+    timeSamples[i] = ((uint32_t)dt > timeOverhead) ? (uint32_t)dt-timeOverhead : 0;
+#ifdef BENCH_HAS_CYCLE_COUNTER
+    cycleSamples[i] = (dc > cycleOverhead) ? dc-cycleOverhead : 0;
+#else
+    cycleSamples[i] = 0;
+#endif
+  }
+  JsVar *obj = 0;
+  if (ok) {
+    benchSortU32(timeSamples, (int)n);
+    benchSortU32(cycleSamples, (int)n);
+    obj = jsvNewObject();
+    if (obj) {
+      jsvObjectSetChildAndUnLock(obj, "iterations", jsvNewFromInteger(n));
+      jsvObjectSetChildAndUnLock(obj, "min", jsvNewFromFloat(jshGetMillisecondsFromTime((JsSysTime)timeSamples[0])/1000));
+      jsvObjectSetChildAndUnLock(obj, "median", jsvNewFromFloat(jshGetMillisecondsFromTime((JsSysTime)timeSamples[n/2])/1000));
+#ifdef BENCH_HAS_CYCLE_COUNTER
+      JsVar *cycles = jsvNewObject();
+      if (cycles) {
+        jsvObjectSetChildAndUnLock(cycles, "min", jsvNewFromInteger((JsVarInt)cycleSamples[0]));
+        jsvObjectSetChildAndUnLock(cycles, "median", jsvNewFromInteger((JsVarInt)cycleSamples[n/2]));
+        jsvObjectSetChildAndUnLock(obj, "cycles", cycles);
+      }
+#endif
+    }
+  }
+  jsvUnLock(buf);
+  return obj;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "setSlowCallbackThreshold",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_setSlowCallbackThreshold",
+  "params" : [
+    ["time","float","Record callbacks that run longer than this many milliseconds (0 or undefined = stop tracing)"]
+  ]
+}
+Start (or stop) timing every event callback. Callbacks that overrun the
+threshold are recorded in a table of worst offenders (`E.getSlowCallbacks()`)
+and reported via `E.on('slowCallback', ...)`. Setting a new threshold clears
+the table.
+
+The overhead while tracing is two timer reads per callback, so it's fine to
+leave on in the field until the culprit is found.
+*/
+void jswrap_espruino_setSlowCallbackThreshold(JsVarFloat time) {
+  jsiSlowCallbacksReset();
+  jsiSlowCallbackThreshold = (time>0) ? jshGetTimeFromMilliseconds(time) : 0;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "getSlowCallbacks",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_getSlowCallbacks",
+  "return" : ["JsVar","An array of `{callback, time, count}` objects, worst first"]
+}
+Return the callbacks that have overrun the threshold set with
+`E.setSlowCallbackThreshold()`, worst first:
+
+```
+[ { callback : function () { ... }, // the offender (if still around)
+    time : 0.052,                   // its longest run, in seconds
+    count : 17 },                   // how often it overran
+  ... ]
+```
+
+The table holds the 8 worst offenders - beyond that, new entries only
+displace old ones by running longer than them.
+*/
+JsVar *jswrap_espruino_getSlowCallbacks() {
+  JsVar *arr = jsvNewEmptyArray();
+  if (!arr) return 0;
+  bool used[JSI_SLOW_CALLBACKS] = {false};
+  while (true) {
+    // worst remaining entry first - the table's tiny, so just rescan
+    int best = -1;
+    int i;
+    for (i=0;i<JSI_SLOW_CALLBACKS;i++)
+      if (jsiSlowCallbacks[i].ref && !used[i] &&
+          (best<0 || jsiSlowCallbacks[i].worst > jsiSlowCallbacks[best].worst))
+        best = i;
+    if (best<0) break;
+    used[best] = true;
+    JsiSlowCallback *c = &jsiSlowCallbacks[best];
+    JsVar *o = jsvNewObject();
+    if (!o) break;
+    JsVar *f = _jsvGetAddressOf(c->ref);
+    if (f && jsvIsFunction(f))
+      jsvObjectSetChildAndUnLock(o, "callback", jsvLockAgain(f));
+    jsvObjectSetChildAndUnLock(o, "time", jsvNewFromFloat(jshGetMillisecondsFromTime(c->worst)/1000));
+    jsvObjectSetChildAndUnLock(o, "count", jsvNewFromInteger((JsVarInt)c->count));
+    jsvArrayPushAndUnLock(arr, o);
+  }
+  return arr;
+}
+#endif // SAVE_ON_FLASH
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "E",
@@ -971,6 +2448,108 @@ void jswrap_espruino_dumpLockedVars() {
 }
 #endif
 
+#ifndef SAVE_ON_FLASH
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "dumpHeap",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_dumpHeap"
+}
+Stream a compact snapshot of the whole variable heap out of the console
+device, for offline analysis. Unlike `E.dumpStr()`/`trace()` output this is
+a walkable object graph - one fixed-size record per variable holding its
+ref, flags, size in blocks and link fields - so it stays usable on heaps
+with thousands of variables.
+
+The snapshot is base64 encoded between `=HEAPDUMP` and `=END` marker lines.
+Capture the console output to a file, then use
+`scripts/heap_snapshot_diff.py` to decode one snapshot or diff two of them -
+taking a snapshot a week apart on a leaking device points straight at what
+grew.
+*/
+void jswrap_espruino_dumpHeap() {
+  // 16 bytes/record so records never straddle the 48-byte base64 groups
+  const unsigned int RECLEN = 16;
+  unsigned char buf[48]; // 3-byte multiple - base64 needs no mid-stream padding
+  char b64[68];
+  static const char b64chars[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  unsigned int total = jsvGetMemoryTotal();
+  /* the name/string type boundaries depend on the build (ref size), so the
+   * header carries them for the offline decoder */
+  jsiConsolePrintf("=HEAPDUMP 1 %d %d %d %d\n", total, RECLEN,
+      _JSV_NAME_END, _JSV_STRING_END);
+  unsigned int fill = 0, count = 0;
+  JsVarRef i;
+  for (i=1;i<=(JsVarRef)total;i++) {
+    JsVar *var = _jsvGetAddressOf(i);
+    if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) continue;
+    uint16_t size = 1, prev = 0, next = 0, first = 0, last = 0;
+    if (jsvIsFlatString(var)) {
+      size = (uint16_t)(1+jsvGetFlatStringBlocks(var));
+    } else {
+      /* which fields really hold links depends on the type - everywhere
+       * else they're character data (see jsvDefragPatchLinks) */
+      if (jsvIsName(var)) {
+        prev = (uint16_t)jsvGetPrevSibling(var);
+        next = (uint16_t)jsvGetNextSibling(var);
+        if (!jsvIsNameWithValue(var)) first = (uint16_t)jsvGetFirstChild(var);
+      } else if (jsvHasChildren(var)) {
+        first = (uint16_t)jsvGetFirstChild(var);
+        last = (uint16_t)jsvGetLastChild(var);
+      } else if (jsvHasSingleChild(var)) {
+        first = (uint16_t)jsvGetFirstChild(var);
+      }
+      if (jsvHasCharacterData(var))
+        last = (uint16_t)jsvGetLastChild(var); // the stringext chain
+    }
+    uint16_t fields[8] = {
+        (uint16_t)i, (uint16_t)var->flags, size, prev, next, first, last,
+        (uint16_t)jsvGetLocks(var) };
+    unsigned int f;
+    for (f=0;f<8;f++) { // little-endian
+      buf[fill++] = (unsigned char)(fields[f]&0xFF);
+      buf[fill++] = (unsigned char)(fields[f]>>8);
+    }
+    count++;
+    if (fill==sizeof(buf)) {
+      unsigned int p, o = 0;
+      for (p=0;p<fill;p+=3) {
+        unsigned int triple = ((unsigned int)buf[p]<<16) |
+            ((unsigned int)buf[p+1]<<8) | buf[p+2];
+        b64[o++] = b64chars[(triple>>18)&0x3F];
+        b64[o++] = b64chars[(triple>>12)&0x3F];
+        b64[o++] = b64chars[(triple>>6)&0x3F];
+        b64[o++] = b64chars[triple&0x3F];
+      }
+      b64[o++] = '\n';
+      b64[o] = 0;
+      jsiConsolePrint(b64);
+      fill = 0;
+    }
+    if (jsvIsFlatString(var))
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+  }
+  if (fill) { // last partial group - fill is always a multiple of RECLEN
+    unsigned int p, o = 0;
+    for (p=0;p<fill;p+=3) {
+      unsigned int triple = (unsigned int)buf[p]<<16;
+      if (p+1<fill) triple |= (unsigned int)buf[p+1]<<8;
+      if (p+2<fill) triple |= buf[p+2];
+      b64[o++] = b64chars[(triple>>18)&0x3F];
+      b64[o++] = b64chars[(triple>>12)&0x3F];
+      b64[o++] = (p+1<fill) ? b64chars[(triple>>6)&0x3F] : '=';
+      b64[o++] = (p+2<fill) ? b64chars[triple&0x3F] : '=';
+    }
+    b64[o++] = '\n';
+    b64[o] = 0;
+    jsiConsolePrint(b64);
+  }
+  jsiConsolePrintf("=END %d\n", count);
+}
+#endif
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
@@ -979,7 +2558,7 @@ void jswrap_espruino_dumpLockedVars() {
   "generate" : "jswrap_espruino_getSizeOf",
   "params" : [
     ["v","JsVar","A variable to get the size of"],
-    ["depth","int","The depth that detail should be provided for. If depth<=0 or undefined, a single integer will be returned"]
+    ["depth","int","The depth that detail should be provided for. If depth is 0 or undefined, a single integer will be returned. If negative, a breakdown by type is returned"]
   ],
   "return" : ["JsVar","Information about the variable size - see below"]
 }
@@ -1013,9 +2592,60 @@ But `E.getSizeOf(function(a,b) { }, 1)` returns:
 In this case setting depth to `2` will make no difference as there are
 no more children to traverse.
 
+If `depth<0` the whole variable is traversed (cycle-safe, sharing no more
+memory than a normal `E.getSizeOf` call) and the block count is broken down
+by type, which is handy for answering "what is using my memory?" on a live
+device:
+
+```
+E.getSizeOf("a string",-1)
+// { "size":2, "strings":2, "objects":0, "functions":0, "arraybuffers":0, "other":0 }
+```
+
+If the variable has children (for instance `E.getSizeOf(global,-1)`) a
+`byName` array is added with one such breakdown per property, so each
+global name's deep footprint can be seen at a glance.
+
 See http://www.espruino.com/Internals for more information
  */
+static void _jswrap_espruino_setSizeInfo(JsVar *obj, JsVar *v) {
+  JsvSizeInfo info;
+  jsvCountJsVarsUsedByType(v, &info);
+  jsvObjectSetChildAndUnLock(obj, "size", jsvNewFromInteger((JsVarInt)info.total));
+  jsvObjectSetChildAndUnLock(obj, "strings", jsvNewFromInteger((JsVarInt)info.strings));
+  jsvObjectSetChildAndUnLock(obj, "objects", jsvNewFromInteger((JsVarInt)info.objects));
+  jsvObjectSetChildAndUnLock(obj, "functions", jsvNewFromInteger((JsVarInt)info.functions));
+  jsvObjectSetChildAndUnLock(obj, "arraybuffers", jsvNewFromInteger((JsVarInt)info.arraybuffers));
+  jsvObjectSetChildAndUnLock(obj, "other", jsvNewFromInteger((JsVarInt)info.other));
+}
+
 JsVar *jswrap_espruino_getSizeOf(JsVar *v, int depth) {
+  if (depth<0) {
+    JsVar *obj = jsvNewObject();
+    if (!obj) return 0;
+    _jswrap_espruino_setSizeInfo(obj, v);
+    if (jsvHasChildren(v)) {
+      JsVar *arr = jsvNewEmptyArray();
+      if (arr) {
+        JsvObjectIterator it;
+        jsvObjectIteratorNew(&it, v);
+        while (jsvObjectIteratorHasValue(&it)) {
+          JsVar *key = jsvObjectIteratorGetKey(&it);
+          JsVar *item = jsvNewObject();
+          if (item) {
+            jsvObjectSetChildAndUnLock(item, "name", jsvAsString(key, false));
+            _jswrap_espruino_setSizeInfo(item, key);
+            jsvArrayPushAndUnLock(arr, item);
+          }
+          jsvUnLock(key);
+          jsvObjectIteratorNext(&it);
+        }
+        jsvObjectIteratorFree(&it);
+        jsvObjectSetChildAndUnLock(obj, "byName", arr);
+      }
+    }
+    return obj;
+  }
   if (depth>0 && jsvHasChildren(v)) {
     JsVar *arr = jsvNewEmptyArray();
     if (!arr) return 0;
@@ -1188,6 +2818,75 @@ rotating to try and make a relatively random value from the noise in the
 signal.
  */
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "getRandomValues",
+  "generate" : "jswrap_espruino_getRandomValues",
+  "params" : [
+    ["array","JsVar","The Typed Array (or ArrayBuffer view) to fill with random bytes"]
+  ],
+  "return" : ["JsVar","The array that was passed in"]
+}
+Fill the given typed array with pseudo-random bytes in one native call -
+vastly faster than a `Math.random()` loop when you need a whole buffer of
+noise (display dithering, backoff jitter, test data):
+
+```
+var noise = new Uint8Array(1024);
+E.getRandomValues(noise);
+```
+
+The generator is xoshiro128**, seeded once at first use from the hardware
+random number source (see `E.hwRand`). It's fast and statistically good,
+but *not* cryptographically secure - don't use it for keys or nonces.
+ */
+JsVar *jswrap_espruino_getRandomValues(JsVar *arr) {
+  // xoshiro128** 1.1 (public domain, by Blackman & Vigna) - all-zero state is
+  // the one invalid value, so it doubles as our 'not seeded yet' marker
+  static uint32_t prngState[4];
+  if (!(prngState[0]|prngState[1]|prngState[2]|prngState[3])) {
+    int i;
+    do {
+      for (i=0;i<4;i++) prngState[i] = (uint32_t)jshGetRandomNumber();
+    } while (!(prngState[0]|prngState[1]|prngState[2]|prngState[3]));
+  }
+  if (!jsvIsArrayBuffer(arr)) {
+    jsExceptionHere(JSET_ERROR, "Expecting a typed array, got %t", arr);
+    return 0;
+  }
+  JsVar *backing = jsvGetArrayBufferBackingString(arr);
+  if (!backing) return 0;
+  // write straight into the view's bytes, whatever the element type
+  size_t byteLength = jsvGetArrayBufferLength(arr) * JSV_ARRAYBUFFER_GET_SIZE(arr->varData.arraybuffer.type);
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, backing, arr->varData.arraybuffer.byteOffset);
+  uint32_t r = 0;
+  unsigned int bytesLeft = 0;
+  while (byteLength-- && jsvStringIteratorHasChar(&it)) {
+    if (!bytesLeft) {
+      uint32_t x = prngState[1]*5;
+      r = ((x<<7)|(x>>25))*9;
+      uint32_t t = prngState[1]<<9;
+      prngState[2] ^= prngState[0];
+      prngState[3] ^= prngState[1];
+      prngState[1] ^= prngState[2];
+      prngState[0] ^= prngState[3];
+      prngState[2] ^= t;
+      prngState[3] = (prngState[3]<<11)|(prngState[3]>>21);
+      bytesLeft = 4;
+    }
+    jsvStringIteratorSetChar(&it, (char)r);
+    r >>= 8;
+    bytesLeft--;
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  jsvUnLock(backing);
+  return jsvLockAgain(arr);
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
@@ -1320,6 +3019,414 @@ void jswrap_espruino_setTimeZone(JsVarFloat zone) {
       jsvNewFromInteger((int)(zone*60)));
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "getTimeUS",
+  "generate" : "jswrap_espruino_getTimeUS",
+  "return" : ["JsVar","The system time in integer microseconds"]
+}
+Return the system time in integer microseconds - the same clock as `getTime()`,
+but without the conversion to floating point seconds. This is the cheapest way
+to take a timestamp from JavaScript, so it's ideal for measuring short
+intervals:
+
+```
+var t = E.getTimeUS();
+doSomething();
+print(E.getTimeUS()-t); // time taken in microseconds
+```
+*/
+JsVar *jswrap_espruino_getTimeUS() {
+  // can't use the 'int' return type - that's 32 bit, and this wraps 32 bits
+  // in 71 minutes. A 64 bit integer stays exact where float seconds wouldn't.
+  return jsvNewFromLongInteger((long long)(jshGetMillisecondsFromTime(jshGetSystemTimeFast())*1000));
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "getIOEventStats",
+  "generate" : "jswrap_espruino_getIOEventStats",
+  "return" : ["JsVar","An object containing IO event statistics"]
+}
+Return statistics on how well incoming IO data is being packed into the
+IO event buffer, as `{chars:..., events:...}` - how many characters have
+been received and how many buffer entries they used. Each entry can hold
+several characters, so `chars/events` close to 1 means bursts are
+arriving slowly enough that every character uses a whole entry, and the
+buffer will fill sooner than the byte count suggests.
+*/
+JsVar *jswrap_espruino_getIOEventStats() {
+  JsVar *o = jsvNewObject();
+  if (!o) return 0;
+  jsvObjectSetChildAndUnLock(o, "chars", jsvNewFromInteger((JsVarInt)jshIOCharsPushed));
+  jsvObjectSetChildAndUnLock(o, "events", jsvNewFromInteger((JsVarInt)jshIOCharEventsCreated));
+  return o;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "getIOStats",
+  "generate" : "jswrap_espruino_getIOStats",
+  "return" : ["JsVar","An object containing IO buffer statistics"]
+}
+Return counters for the IO event and transmit ring buffers:
+
+```
+{ ioBufferSize : 256,  // IO event buffer entries in total
+  ioBufferMax : 23,    // most entries ever in use at once
+  txBufferSize : 256,  // transmit buffer entries in total
+  txBufferMax : 101,   // most entries ever in use at once
+  devices : {          // only devices that have seen traffic are listed
+    Serial1 : { pushed : 1234, // IO events queued from this device
+                dropped : 0 }  // IO events thrown away - buffer was full
+  } }
+```
+
+When bytes go missing, a nonzero `dropped` proves it was this side that
+lost them - and names the device (`E.on('overflow', ...)` reports the
+same thing as it happens). `ioBufferMax` creeping towards `ioBufferSize`
+means you've been getting away with it rather than being safe - consider
+flow control (see `Serial.setup`'s `flowStop`/`flowStart`).
+*/
+JsVar *jswrap_espruino_getIOStats() {
+  JsVar *o = jsvNewObject();
+  if (!o) return 0;
+  jsvObjectSetChildAndUnLock(o, "ioBufferSize", jsvNewFromInteger(IOBUFFERMASK+1));
+  jsvObjectSetChildAndUnLock(o, "ioBufferMax", jsvNewFromInteger(jshIOBufferMaxUsed));
+  jsvObjectSetChildAndUnLock(o, "txBufferSize", jsvNewFromInteger(TXBUFFERMASK+1));
+  jsvObjectSetChildAndUnLock(o, "txBufferMax", jsvNewFromInteger(jshTxBufferMaxUsed));
+  JsVar *devices = jsvNewObject();
+  if (devices) {
+    int d;
+    for (d=0;d<=EV_DEVICE_MAX;d++) {
+      if (!jshIODeviceStats[d].pushed && !jshIODeviceStats[d].dropped)
+        continue;
+      const char *name = jshGetDeviceString((IOEventFlags)d);
+      char buf[16];
+      if (!name[0]) {
+        // EXTIs and internal channels have no device string
+        if (d>=EV_EXTI0 && d<=EV_EXTI_MAX) {
+          strcpy(buf, "EXTI");
+          itostr(d-EV_EXTI0, &buf[4], 10);
+        } else {
+          strcpy(buf, "EV");
+          itostr(d, &buf[2], 10);
+        }
+        name = buf;
+      }
+      JsVar *dev = jsvNewObject();
+      if (dev) {
+        jsvObjectSetChildAndUnLock(dev, "pushed", jsvNewFromInteger((JsVarInt)jshIODeviceStats[d].pushed));
+        jsvObjectSetChildAndUnLock(dev, "dropped", jsvNewFromInteger((JsVarInt)jshIODeviceStats[d].dropped));
+        jsvObjectSetChildAndUnLock(devices, name, dev);
+      }
+    }
+    jsvObjectSetChildAndUnLock(o, "devices", devices);
+  }
+  return o;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "setTimerSlack",
+  "generate" : "jswrap_espruino_setTimerSlack",
+  "params" : [
+    ["id","JsVar","The id returned by a previous call to `setInterval`/`setTimeout`"],
+    ["slack","float","How many milliseconds early the timer may fire (0 = always fire on time)"]
+  ]
+}
+Allow the given timer to fire up to `slack` milliseconds early if Espruino
+is already awake to service another timer or IO. Timers that fire at
+almost-but-not-quite the same time can then share a single wakeup, which
+saves power on battery-operated devices:
+
+```
+setInterval(readSensorA, 1000);
+E.setTimerSlack(setInterval(readSensorB, 1000), 50);
+// readSensorB now piggybacks on readSensorA's wakeup
+```
+
+The timer's schedule isn't changed - an interval that fires early still
+aims for its original multiples of the period afterwards.
+*/
+void jswrap_espruino_setTimerSlack(JsVar *idVar, JsVarFloat slack) {
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsVar *timerName = jsvIsBasic(idVar) ? jsvFindChildFromVar(timerArrayPtr, idVar, false) : 0;
+  if (timerName) {
+    JsVar *timer = jsvSkipNameAndUnLock(timerName);
+    if (slack<0) slack=0;
+    jsvObjectSetChildAndUnLock(timer, "slack",
+        jsvNewFromLongInteger(jshGetTimeFromMilliseconds(slack)));
+    jsvUnLock(timer);
+    jsiTimersChanged(); // mark timers as changed
+  } else {
+    jsExceptionHere(JSET_ERROR, "Unknown Timer");
+  }
+  jsvUnLock(timerArrayPtr);
+}
+
+#ifndef SAVE_ON_FLASH
+#define JSI_PULSE_NAME JS_HIDDEN_CHAR_STR"pulse"
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "pulseSequence",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_pulseSequence",
+  "params" : [
+    ["pin","pin","The pin to pulse"],
+    ["value","bool","The initial state of the pin - the first duration is spent at this level"],
+    ["times","JsVar","An array (or typed array) of durations in milliseconds. The pin toggles after each one"]
+  ]
+}
+Play a whole sequence of pulses on a pin using the utility timer, for example
+`E.pulseSequence(A0, 1, [5,2,4])` outputs the same waveform as
+`digitalPulse(A0, 1, [5,2,4])`. Unlike `digitalPulse` the entire sequence is
+queued as a single timer task, so a long motion profile costs one call and is
+played back entirely from the timer interrupt with no interpreter involvement.
+
+Starting a new sequence on a pin stops any sequence still playing on it.
+
+ **Note:** if you didn't call `pinMode` beforehand then this function will also
+reset pin's state to `"output"`
+ */
+void jswrap_espruino_pulseSequence(Pin pin, bool value, JsVar *times) {
+  if (!jshIsPinValid(pin)) {
+    jsExceptionHere(JSET_ERROR, "Invalid pin!");
+    return;
+  }
+  if (!jsvIsIterable(times)) {
+    jsExceptionHere(JSET_ERROR, "Expecting an array, got %t", times);
+    return;
+  }
+  // pack the durations into a string of 32 bit system-time values for the IRQ
+  JsVar *durations = jsvNewFromEmptyString();
+  if (!durations) return; // out of memory
+  JsvIterator it;
+  jsvIteratorNew(&it, times, JSIF_EVERY_ARRAY_ELEMENT);
+  while (jsvIteratorHasElement(&it)) {
+    JsVarFloat time = jsvIteratorGetFloatValue(&it);
+    JsSysTime d = 0;
+    if (time>0 && !isnan(time)) d = jshGetTimeFromMilliseconds(time);
+    if (d<1) d = 1; // zero would end the sequence early
+    if (d>0xFFFFFFFF) d = 0xFFFFFFFF;
+    char buf[4] = { (char)d, (char)(d>>8), (char)(d>>16), (char)(d>>24) };
+    jsvAppendStringBuf(durations, buf, sizeof(buf));
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  // a new sequence supersedes anything still playing on this pin
+  jstStopPinPulseSequence(pin);
+  // start after any pulse already queued for this pin, like digitalPulse does
+  UtilTimerTask lastTask;
+  JsSysTime startTime;
+  if (jstGetLastPinTimerTask(pin, &lastTask)) {
+    startTime = lastTask.time;
+  } else {
+    jshPinOutput(pin, value); // set the initial state right away
+    startTime = jshGetSystemTime();
+  }
+  /* keep the durations alive (and findable by the idle cleanup) while the
+   * IRQ is reading them - same scheme as the Waveform class buffers */
+  JsVar *sequences = jsvObjectGetChild(execInfo.hiddenRoot, JSI_PULSE_NAME, JSV_ARRAY);
+  if (!sequences) {
+    jsvUnLock(durations);
+    return; // out of memory
+  }
+  jsvArrayPush(sequences, durations);
+  if (!jstStartPulseSequence(startTime, pin, value, durations))
+    jsvUnLock(jsvArrayPop(sequences)); // queue full - don't keep the data
+  jsvUnLock2(sequences, durations);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "pulse",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_espruino_pulse",
+  "params" : [
+    ["pins","JsVar","A pin, or an array of up to 4 pins to pulse together"],
+    ["value","bool","Whether to pulse high (true) or low (false)"],
+    ["time","JsVar","A time in milliseconds, or an array of times (in which case a square wave will be output starting with a pulse of 'value')"],
+    ["options","JsVar","An optional object `{start:float}` - see below"]
+  ]
+}
+Like `digitalPulse`, but can drive several pins from a single timer task and
+can be given an explicit start time:
+
+* All the pins given change level in the *same* timer interrupt, so their
+edges are simultaneous - `E.pulse([A0,A1], 1, 5)` produces two 5ms pulses
+with no skew between them.
+* `options.start` is an absolute time (in seconds, as returned by `getTime()`)
+at which the first edge is scheduled. Several calls given the same `start`
+keep a deterministic phase relationship with each other - eg. quadrature or
+multi-phase stepper waveforms built from a few calls with offset `time`
+arrays. Without `start` the pulse begins immediately (or after anything
+already queued on the pins, like `digitalPulse`).
+
+A start time in the past just plays what remains of the sequence. As with
+`digitalPulse` this is for short, accurate waveforms - each edge uses one
+utility timer task.
+
+ **Note:** if you didn't call `pinMode` beforehand then this function will
+also reset the pins' state to `"output"`
+ */
+void jswrap_espruino_pulse(JsVar *pinVar, bool value, JsVar *times, JsVar *options) {
+  // collect the pins - all of them ride in a single UtilTimerTaskSet
+  Pin pins[UTILTIMERTASK_PIN_COUNT];
+  int pinCount = 0;
+  if (jsvIsArray(pinVar)) {
+    JsvObjectIterator pit;
+    jsvObjectIteratorNew(&pit, pinVar);
+    while (jsvObjectIteratorHasValue(&pit)) {
+      Pin pin = jshGetPinFromVarAndUnLock(jsvObjectIteratorGetValue(&pit));
+      if (!jshIsPinValid(pin) || pinCount>=UTILTIMERTASK_PIN_COUNT) {
+        jsvObjectIteratorFree(&pit);
+        jsExceptionHere(JSET_ERROR, "Expecting up to %d valid pins", UTILTIMERTASK_PIN_COUNT);
+        return;
+      }
+      pins[pinCount++] = pin;
+      jsvObjectIteratorNext(&pit);
+    }
+    jsvObjectIteratorFree(&pit);
+  } else {
+    pins[0] = jshGetPinFromVar(pinVar);
+    pinCount = 1;
+  }
+  if (pinCount==0 || !jshIsPinValid(pins[0])) {
+    jsExceptionHere(JSET_ERROR, "Invalid pin!");
+    return;
+  }
+  if (!jsvIsNumeric(times) && !jsvIsIterable(times)) {
+    jsExceptionHere(JSET_ERROR, "Expecting a number or array, got %t", times);
+    return;
+  }
+  int i;
+  JsSysTime startTime = 0;
+  bool hasStart = false;
+  if (jsvIsObject(options)) {
+    JsVar *start = jsvObjectGetChild(options, "start", 0);
+    if (start) {
+      startTime = jshGetTimeFromMilliseconds(jsvGetFloat(start)*1000);
+      hasStart = true;
+    }
+    jsvUnLock(start);
+  }
+  if (hasStart) {
+    /* explicit start: make the pins outputs without touching their level,
+     * then schedule the leading edge itself - the phase anchor has to fire
+     * from the timer, not from however long this call took to get here */
+    for (i=0;i<pinCount;i++)
+      jshPinSetState(pins[i], JSHPINSTATE_GPIO_OUT);
+    if (!jstPinOutputAtTime(startTime, pins, pinCount, value?0xFF:0)) return;
+  } else {
+    // like digitalPulse: tack onto whatever is already queued for these pins
+    UtilTimerTask task;
+    for (i=0;i<pinCount;i++)
+      if (jstGetLastPinTimerTask(pins[i], &task) && task.time>startTime)
+        startTime = task.time;
+    if (!startTime) {
+      // nothing queued - the leading edge happens right now
+      for (i=0;i<pinCount;i++)
+        jshPinOutput(pins[i], value);
+      startTime = jshGetSystemTime();
+    } else {
+      /* a tick after the queued task, so it can't race our leading edge
+       * when both deadlines land in the same timer interrupt */
+      startTime++;
+      if (!jstPinOutputAtTime(startTime, pins, pinCount, value?0xFF:0)) return;
+    }
+  }
+  // now one task per edge, at absolute times along the sequence
+  JsSysTime t = startTime;
+  if (jsvIsNumeric(times)) {
+    JsVarFloat time = jsvGetFloat(times);
+    if (time<0 || isnan(time)) {
+      jsExceptionHere(JSET_ERROR, "Pulse Time given for E.pulse is less than 0, or not a number");
+      return;
+    }
+    jstPinOutputAtTime(t + jshGetTimeFromMilliseconds(time), pins, pinCount, value?0:0xFF);
+  } else {
+    JsvIterator it;
+    jsvIteratorNew(&it, times, JSIF_EVERY_ARRAY_ELEMENT);
+    while (jsvIteratorHasElement(&it)) {
+      JsVarFloat time = jsvIteratorGetFloatValue(&it);
+      if (time>=0 && !isnan(time)) {
+        t += jshGetTimeFromMilliseconds(time);
+        value = !value;
+        if (!jstPinOutputAtTime(t, pins, pinCount, value?0xFF:0)) break;
+      }
+      jsvIteratorNext(&it);
+    }
+    jsvIteratorFree(&it);
+  }
+}
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_espruino_idle",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+bool jswrap_espruino_idle() {
+  JsVar *sequences = jsvObjectGetChild(execInfo.hiddenRoot, JSI_PULSE_NAME, 0);
+  if (sequences) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, sequences);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *durations = jsvObjectIteratorGetValue(&it);
+      UtilTimerTask task;
+      // drop the data for any sequence that has finished playing
+      if (!jstGetLastBufferTimerTask(durations, &task))
+        jsvObjectIteratorRemoveAndGotoNext(&it, sequences);
+      else
+        jsvObjectIteratorNext(&it);
+      jsvUnLock(durations);
+    }
+    jsvObjectIteratorFree(&it);
+    if (!jsvGetArrayLength(sequences))
+      jsvObjectRemoveChild(execInfo.hiddenRoot, JSI_PULSE_NAME);
+    jsvUnLock(sequences);
+  }
+  return false; // no need to stay awake - an IRQ will wake us
+}
+
+/*JSON{
+  "type" : "kill",
+  "generate" : "jswrap_espruino_kill",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+void jswrap_espruino_kill() {
+  if (profileCountsVar) { // stop the profiler before its histogram is freed from under the IRQ
+    jstStopExecuteFn(jswrap_espruino_profileSample, NULL);
+    jsvUnLock(profileCountsVar);
+    profileCountsVar = 0;
+    profileCounts = 0;
+  }
+  JsVar *sequences = jsvObjectGetChild(execInfo.hiddenRoot, JSI_PULSE_NAME, 0);
+  if (sequences) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, sequences);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *durations = jsvObjectIteratorGetValue(&it);
+      jstStopBufferTimerTask(durations); // stop the IRQ reading soon-to-be-freed data
+      jsvUnLock(durations);
+      jsvObjectIteratorRemoveAndGotoNext(&it, sequences);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(sequences);
+  }
+}
+#endif
+
 // ----------------------------------------- USB Specific Stuff
 
 #ifdef USE_USB_HID
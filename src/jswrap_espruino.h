@@ -16,11 +16,15 @@
 #include "jsflags.h" // for E.get/setFlags
 
 JsVar *jswrap_espruino_nativeCall(JsVarInt addr, JsVar *signature, JsVar *data);
+JsVar *jswrap_espruino_nativeCallBatch(JsVar *fn, JsVar *args);
 
 JsVarFloat jswrap_espruino_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max);
 JsVarFloat jswrap_espruino_sum(JsVar *arr);
 JsVarFloat jswrap_espruino_variance(JsVar *arr, JsVarFloat mean);
 JsVarFloat jswrap_espruino_convolve(JsVar *a, JsVar *b, int offset);
+JsVarFloat jswrap_espruino_dotProduct(JsVar *arr1, JsVar *arr2);
+void jswrap_espruino_filterFIR(JsVar *dst, JsVar *src, JsVar *coeffs, int shift);
+void jswrap_espruino_filterBiquad(JsVar *data, JsVar *coeffs, int shift, JsVar *state);
 void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse);
 
 JsVarFloat jswrap_espruino_interpolate(JsVar *array, JsVarFloat findex);
@@ -33,22 +37,48 @@ JsVar *jswrap_espruino_getErrorFlagArray(JsErrorFlags flags);
 JsVar *jswrap_espruino_getErrorFlags();
 JsVar *jswrap_espruino_toArrayBuffer(JsVar *str);
 JsVar *jswrap_espruino_toUint8Array(JsVar *args);
+JsVar *jswrap_espruino_unpack(JsVar *format, JsVar *data, int offset);
+JsVar *jswrap_espruino_pack(JsVar *format, JsVar *data);
 JsVar *jswrap_espruino_toString(JsVar *args);
 JsVar *jswrap_espruino_memoryArea(int addr, int len);
+JsVar *jswrap_espruino_memoryMap(int addr, int len);
 void jswrap_espruino_setBootCode(JsVar *code, bool alwaysExec);
 int jswrap_espruino_setClock(JsVar *options);
 
 int jswrap_espruino_reverseByte(int v);
+JsVar *jswrap_espruino_CRC32(JsVar *data);
+int jswrap_espruino_CRC16(JsVar *data);
 void jswrap_espruino_dumpTimers();
+JsVar *jswrap_espruino_getTimerUsage(bool reset);
 void jswrap_espruino_dumpLockedVars();
+void jswrap_espruino_dumpHeap();
+int jswrap_espruino_defrag();
+void jswrap_espruino_startProfile(JsVar *options);
+JsVar *jswrap_espruino_stopProfile();
+void jswrap_espruino_setFunctionStats(bool enable);
+JsVar *jswrap_espruino_getFunctionStats();
+JsVar *jswrap_espruino_memStats();
+JsVar *jswrap_espruino_getOpCounters(bool reset);
+JsVar *jswrap_espruino_bench(JsVar *fn, JsVar *options);
+void jswrap_espruino_setSlowCallbackThreshold(JsVarFloat time);
+JsVar *jswrap_espruino_getSlowCallbacks();
 JsVar *jswrap_espruino_getSizeOf(JsVar *v, int depth);
 JsVarInt jswrap_espruino_getAddressOf(JsVar *v, bool flatAddress);
 void jswrap_espruino_mapInPlace(JsVar *from, JsVar *to, JsVar *map, JsVarInt bits);
 JsVar *jswrap_e_dumpStr();
+JsVar *jswrap_espruino_getRandomValues(JsVar *arr);
 JsVar *jswrap_espruino_HSBtoRGB(JsVarFloat hue, JsVarFloat sat, JsVarFloat bri, bool asArray);
 void jswrap_espruino_setPassword(JsVar *pwd);
 void jswrap_espruino_lockConsole();
 void jswrap_espruino_setTimeZone(JsVarFloat zone);
+JsVar *jswrap_espruino_getTimeUS();
+JsVar *jswrap_espruino_getIOEventStats();
+JsVar *jswrap_espruino_getIOStats();
+void jswrap_espruino_setTimerSlack(JsVar *idVar, JsVarFloat slack);
+void jswrap_espruino_pulseSequence(Pin pin, bool value, JsVar *times);
+void jswrap_espruino_pulse(JsVar *pinVar, bool value, JsVar *times, JsVar *options);
+bool jswrap_espruino_idle();
+void jswrap_espruino_kill();
 
 void jswrap_espruino_setUSBHID(JsVar *arr);
 bool jswrap_espruino_sendUSBHID(JsVar *arr);
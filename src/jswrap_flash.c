@@ -17,6 +17,7 @@
 #include "jshardware.h"
 #include "jsvariterator.h"
 #include "jsinteractive.h"
+#include "jswrap_promise.h"
 
 #ifdef USE_HEATSHRINK
   #include "compress_heatshrink.h"
@@ -99,6 +100,193 @@ JsVar *jswrap_flash_getFree() {
   return arr;
 }
 
+#ifndef SAVE_ON_FLASH
+/* Read-ahead cache for Flash.read - on parts like the ESP8266 every
+ * jshFlashRead goes out over SPI, so fetching a whole line at a time and
+ * serving small reads from it cuts the per-access overhead right down.
+ * Anything that writes or erases flash from JS must invalidate it. */
+#define FLASH_READ_CACHE_SIZE 256
+static uint32_t flashReadCacheAddr = 0xFFFFFFFF; ///< line start address, 0xFFFFFFFF = nothing cached
+static unsigned char flashReadCache[FLASH_READ_CACHE_SIZE];
+
+static void jsfInvalidateReadCache() {
+  flashReadCacheAddr = 0xFFFFFFFF;
+}
+
+/// jshFlashRead via the read-ahead cache - big reads just go straight through
+static void jsfCachedFlashRead(unsigned char *dst, uint32_t addr, uint32_t len) {
+  if (len >= FLASH_READ_CACHE_SIZE) {
+    jshFlashRead(dst, addr, len);
+    return;
+  }
+  while (len) {
+    uint32_t lineStart = addr & ~(uint32_t)(FLASH_READ_CACHE_SIZE-1);
+    if (lineStart != flashReadCacheAddr) {
+      jshFlashRead(flashReadCache, lineStart, FLASH_READ_CACHE_SIZE);
+      flashReadCacheAddr = lineStart;
+    }
+    uint32_t i, off = addr - lineStart;
+    uint32_t n = FLASH_READ_CACHE_SIZE - off;
+    if (n > len) n = len;
+    for (i=0;i<n;i++)
+      dst[i] = flashReadCache[off+i];
+    dst += n; addr += n; len -= n;
+  }
+}
+/* ----------------------------------------------------------------------------
+ * Flash wear accounting (see Flash.getStats)
+ *
+ * Every erase and write that goes through this file is counted, both in
+ * global totals and against the page it landed in, so save()-heavy code can
+ * see how fast it is using up the part's rated erase cycles. The counters
+ * live in RAM and start from zero at boot. If a page's erase rate this
+ * session projects to more than the rated endurance within a year, an
+ * E 'flashWear' event is raised (once per page) from the idle loop.
+ * ---------------------------------------------------------------------------- */
+#define JSF_WEAR_PAGES 16
+#define JSF_WEAR_ENDURANCE 10000 ///< guaranteed erase cycles for STM32 flash
+#define JSF_WEAR_MIN_ERASES 32   ///< don't project a rate from fewer erases than this
+
+typedef struct {
+  uint32_t addr;   ///< page start address, length==0 means slot unused
+  uint32_t length;
+  uint32_t erases;
+  uint32_t writes; ///< write calls that landed in this page
+  JsSysTime firstErase; ///< when this page's first erase this session happened
+  bool warned;     ///< wear warning already raised for this page
+} JsfPageStats;
+
+static JsfPageStats jsfPageStats[JSF_WEAR_PAGES];
+static JsfPageStats *jsfWearLastPage = 0; ///< last page touched - saves a jshFlashGetPage per word when saving
+static uint32_t jsfTotalErases = 0, jsfTotalWrites = 0, jsfTotalWriteBytes = 0;
+static uint32_t jsfWearWarnAddr = 0xFFFFFFFF; ///< page with an E 'flashWear' event pending
+
+/// Get (or allocate) the stats slot for the page containing addr - 0 if the table is full
+static JsfPageStats *jsfWearPage(uint32_t addr) {
+  if (jsfWearLastPage && addr>=jsfWearLastPage->addr &&
+      addr<jsfWearLastPage->addr+jsfWearLastPage->length)
+    return jsfWearLastPage;
+  uint32_t pageStart, pageLength;
+  if (!jshFlashGetPage(addr, &pageStart, &pageLength)) return 0;
+  int i, unused = -1;
+  for (i=0;i<JSF_WEAR_PAGES;i++) {
+    if (jsfPageStats[i].length) {
+      if (jsfPageStats[i].addr==pageStart)
+        return jsfWearLastPage = &jsfPageStats[i];
+    } else if (unused<0) unused = i;
+  }
+  if (unused<0) return 0; // table full - the global totals still count it
+  jsfPageStats[unused].addr = pageStart;
+  jsfPageStats[unused].length = pageLength;
+  return jsfWearLastPage = &jsfPageStats[unused];
+}
+
+static void jsfRecordErase(uint32_t addr) {
+  jsfTotalErases++;
+  JsfPageStats *p = jsfWearPage(addr);
+  if (!p) return;
+  JsSysTime now = jshGetSystemTime();
+  if (!p->erases) p->firstErase = now;
+  p->erases++;
+  if (!p->warned && p->erases>=JSF_WEAR_MIN_ERASES) {
+    /* project this session's erase rate out to a year - if that would get
+     * through the rated endurance, flag the page for an E 'flashWear' event */
+    JsVarFloat elapsed = jshGetMillisecondsFromTime(now - p->firstErase)/1000;
+    if (elapsed>0 && (JsVarFloat)p->erases*(365*24*60*60)/elapsed > JSF_WEAR_ENDURANCE) {
+      p->warned = true;
+      jsfWearWarnAddr = p->addr;
+    }
+  }
+}
+
+static void jsfRecordWrite(uint32_t addr, uint32_t len) {
+  jsfTotalWrites++;
+  jsfTotalWriteBytes += len;
+  JsfPageStats *p = jsfWearPage(addr);
+  if (p) p->writes++;
+}
+#else
+#define jsfRecordErase(addr)
+#define jsfRecordWrite(addr,len)
+#endif // SAVE_ON_FLASH
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Flash",
+  "name" : "getStats",
+  "generate" : "jswrap_flash_getStats",
+  "params" : [
+    ["reset","bool","[optional] Zero the counters after reading them"]
+  ],
+  "return" : ["JsVar","An object of flash usage counters - see below"]
+}
+Return counts of the flash erases and writes performed since boot (or since
+the counters were last reset), of the form:
+
+```
+{
+  erases : 20,       // total page erases
+  writes : 1542,     // total write calls
+  bytesWritten : 6168,
+  pages : [          // broken down by the page written/erased
+    { addr : 134217728, length : 1024,
+      erases : 20, writes : 1542,
+      erasesPerHour : 14.2 }
+  ]
+}
+```
+
+Only operations performed via this module (including those done internally
+by `save()`) are counted, and the counters live in RAM - they reset to zero
+at boot. Flash is only rated for a limited number of erase cycles per page
+(around 10000 on STM32 parts), so if a page's erase rate would get through
+that within a year an `E.on('flashWear', ...)` event is raised.
+ */
+JsVar *jswrap_flash_getStats(bool reset) {
+#ifndef SAVE_ON_FLASH
+  JsVar *obj = jsvNewObject();
+  if (!obj) return 0;
+  jsvObjectSetChildAndUnLock(obj, "erases", jsvNewFromInteger((JsVarInt)jsfTotalErases));
+  jsvObjectSetChildAndUnLock(obj, "writes", jsvNewFromInteger((JsVarInt)jsfTotalWrites));
+  jsvObjectSetChildAndUnLock(obj, "bytesWritten", jsvNewFromInteger((JsVarInt)jsfTotalWriteBytes));
+  JsVar *pages = jsvNewEmptyArray();
+  if (pages) {
+    JsSysTime now = jshGetSystemTime();
+    int i;
+    for (i=0;i<JSF_WEAR_PAGES;i++) {
+      JsfPageStats *p = &jsfPageStats[i];
+      if (!p->length) continue;
+      JsVar *pg = jsvNewObject();
+      if (!pg) break;
+      jsvObjectSetChildAndUnLock(pg, "addr", jsvNewFromInteger((JsVarInt)p->addr));
+      jsvObjectSetChildAndUnLock(pg, "length", jsvNewFromInteger((JsVarInt)p->length));
+      jsvObjectSetChildAndUnLock(pg, "erases", jsvNewFromInteger((JsVarInt)p->erases));
+      jsvObjectSetChildAndUnLock(pg, "writes", jsvNewFromInteger((JsVarInt)p->writes));
+      if (p->erases) {
+        JsVarFloat elapsed = jshGetMillisecondsFromTime(now - p->firstErase)/1000;
+        if (elapsed>0)
+          jsvObjectSetChildAndUnLock(pg, "erasesPerHour", jsvNewFromFloat((JsVarFloat)p->erases*3600/elapsed));
+      }
+      jsvArrayPushAndUnLock(pages, pg);
+    }
+    jsvObjectSetChildAndUnLock(obj, "pages", pages);
+  }
+  if (reset) {
+    memset(jsfPageStats, 0, sizeof(jsfPageStats));
+    jsfWearLastPage = 0;
+    jsfTotalErases = jsfTotalWrites = jsfTotalWriteBytes = 0;
+  }
+  return obj;
+#else
+  NOT_USED(reset);
+  return 0;
+#endif
+}
+
+// queue of erases deferred to the idle loop (see Flash.erasePage)
+#define JSF_ERASE_QUEUE_NAME JS_HIDDEN_CHAR_STR"FlErase"
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
@@ -106,17 +294,108 @@ JsVar *jswrap_flash_getFree() {
   "name" : "erasePage",
   "generate" : "jswrap_flash_erasePage",
   "params" : [
-    ["addr","JsVar","An address in the page that is to be erased"]
-  ]
+    ["addr","JsVar","An address in the page that is to be erased"],
+    ["background","bool","[optional] If true, defer the erase until the interpreter is idle and return a Promise"]
+  ],
+  "return" : ["JsVar","A Promise resolved once the erase has been done if `background` is true, otherwise undefined"]
 }
-Erase a page of flash memory
+Erase a page of flash memory.
+
+Erasing a page stalls the CPU for tens of milliseconds, during which serial
+data can be lost. If `background` is true the erase is queued up instead and
+performed from the idle loop once there's nothing waiting in the input buffer,
+and a Promise is returned that resolves when the page has been erased:
+
+```
+require("Flash").erasePage(addr, true).then(function() {
+  require("Flash").write(data, addr);
+});
+```
  */
-void jswrap_flash_erasePage(JsVar *addr) {
+JsVar *jswrap_flash_erasePage(JsVar *addr, bool background) {
   if (!jsvIsInt(addr)) {
     jsExceptionHere(JSET_ERROR, "Address should be an integer, got %t", addr);
-    return;
+    return 0;
   }
+  if (background) {
+    JsVar *promise = jspromise_create();
+    if (!promise) return 0;
+    JsVar *queue = jsvObjectGetChild(execInfo.hiddenRoot, JSF_ERASE_QUEUE_NAME, JSV_ARRAY);
+    JsVar *job = jsvNewObject();
+    if (queue && job) {
+      jsvObjectSetChildAndUnLock(job, "addr", jsvNewFromInteger(jsvGetInteger(addr)));
+      jsvObjectSetChild(job, "promise", promise);
+      jsvArrayPush(queue, job);
+    }
+    jsvUnLock2(job, queue);
+    return promise;
+  }
+#ifndef SAVE_ON_FLASH
+  jsfInvalidateReadCache();
+#endif
   jshFlashErasePage((uint32_t)jsvGetInteger(addr));
+  jsfRecordErase((uint32_t)jsvGetInteger(addr));
+  return 0;
+}
+
+/*JSON{
+  "type" : "event",
+  "class" : "E",
+  "name" : "flashWear",
+  "params" : [
+    ["info","JsVar","An object `{addr, erases}` identifying the page and its erase count this session"]
+  ],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Raised (once per page) when a flash page is being erased so often that the
+current rate would get through the part's rated erase endurance within a
+year - see `Flash.getStats()`.
+ */
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_flash_idle",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+bool jswrap_flash_idle() {
+  if (jsfWearWarnAddr != 0xFFFFFFFF) {
+    JsfPageStats *p = jsfWearPage(jsfWearWarnAddr);
+    jsfWearWarnAddr = 0xFFFFFFFF;
+    JsVar *info = jsvNewObject();
+    if (p && info) {
+      jsvObjectSetChildAndUnLock(info, "addr", jsvNewFromInteger((JsVarInt)p->addr));
+      jsvObjectSetChildAndUnLock(info, "erases", jsvNewFromInteger((JsVarInt)p->erases));
+      JsVar *e = jsvObjectGetChild(execInfo.root, "E", 0);
+      if (e) {
+        JsVar *callback = jsvObjectGetChild(e, JS_EVENT_PREFIX"flashWear", 0);
+        if (callback) jsiExecuteEventCallback(0, callback, 1, &info);
+        jsvUnLock2(callback, e);
+      }
+    }
+    jsvUnLock(info);
+  }
+  JsVar *queue = jsvObjectGetChild(execInfo.hiddenRoot, JSF_ERASE_QUEUE_NAME, 0);
+  if (!queue) return false;
+  bool busy = false;
+  /* An erase stalls the CPU, so do at most one per idle pass and only when
+   * the IO ring is empty - anything arriving mid-erase would be missed */
+  if (jsvGetArrayLength(queue) && !jshGetEventsUsed()) {
+    JsVar *job = jsvSkipNameAndUnLock(jsvArrayPopFirst(queue));
+    if (job) {
+      JsVar *promise = jsvObjectGetChild(job, "promise", 0);
+      jsfInvalidateReadCache();
+      uint32_t eraseAddr = (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(job, "addr", 0));
+      jshFlashErasePage(eraseAddr);
+      jsfRecordErase(eraseAddr);
+      if (promise) jspromise_resolve(promise, 0);
+      jsvUnLock2(promise, job);
+      busy = true;
+    }
+  }
+  if (!jsvGetArrayLength(queue))
+    jsvObjectRemoveChild(execInfo.hiddenRoot, JSF_ERASE_QUEUE_NAME);
+  jsvUnLock(queue);
+  return busy;
 }
 
 /*JSON{
@@ -149,8 +428,13 @@ void jswrap_flash_write(JsVar *data, int addr) {
     return;
   }
 
-  if (flashData && flashDataLen)
+  if (flashData && flashDataLen) {
+#ifndef SAVE_ON_FLASH
+    jsfInvalidateReadCache();
+#endif
     jshFlashWrite(flashData, (unsigned int)addr, (unsigned int)flashDataLen);
+    jsfRecordWrite((uint32_t)addr, (uint32_t)flashDataLen);
+  }
 }
 
 /*JSON{
@@ -161,25 +445,64 @@ void jswrap_flash_write(JsVar *data, int addr) {
   "generate" : "jswrap_flash_read",
   "params" : [
     ["length","int","The amount of data to read (in bytes)"],
-    ["addr","int","The address to start reading from"]
+    ["addr","int","The address to start reading from"],
+    ["data","JsVar","[optional] a Uint8Array/ArrayBuffer to read the data into. If supplied it is filled and returned instead of a new array being allocated"]
   ],
   "return" : ["JsVar","A Uint8Array of data"]
 }
-Read flash memory from the given address
+Read flash memory from the given address.
+
+If `data` is supplied the bytes are read straight into it (it must be at
+least `length` elements long), avoiding any allocation - handy when
+polling flash repeatedly.
  */
-JsVar *jswrap_flash_read(int length, int addr) {
+JsVar *jswrap_flash_read(int length, int addr, JsVar *data) {
   if (length<=0) return 0;
-  JsVar *arr = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, length);
-  if (!arr) return 0;
-  JsvArrayBufferIterator it;
-  jsvArrayBufferIteratorNew(&it, arr, 0);
-  while (jsvArrayBufferIteratorHasElement(&it)) {
-    char c;
-    jshFlashRead(&c, (uint32_t)(addr++), 1);
-    jsvArrayBufferIteratorSetByteValue(&it, c);
-    jsvArrayBufferIteratorNext(&it);
-  }
-  jsvArrayBufferIteratorFree(&it);
+  JsVar *arr;
+  if (data) {
+    if (!jsvIsArrayBuffer(data)) {
+      jsExceptionHere(JSET_TYPEERROR, "Expecting ArrayBuffer to read into, got %t", data);
+      return 0;
+    }
+    if ((int)jsvGetArrayBufferLength(data) < length) {
+      jsExceptionHere(JSET_ERROR, "Supplied array is smaller than the requested read");
+      return 0;
+    }
+    arr = jsvLockAgain(data);
+  } else {
+    arr = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, length);
+    if (!arr) return 0;
+  }
+  size_t dataLen = 0;
+  char *dataPtr = jsvGetDataPointer(arr, &dataLen);
+  if (dataPtr && JSV_ARRAYBUFFER_GET_SIZE(arr->varData.arraybuffer.type)==1) {
+    // contiguous byte array - read straight into it in one go
+#ifndef SAVE_ON_FLASH
+    jsfCachedFlashRead((unsigned char*)dataPtr, (uint32_t)addr, (uint32_t)length);
+#else
+    jshFlashRead(dataPtr, (uint32_t)addr, (uint32_t)length);
+#endif
+  } else {
+    JsvArrayBufferIterator it;
+    jsvArrayBufferIteratorNew(&it, arr, 0);
+    unsigned char buf[64];
+    while (length>0 && jsvArrayBufferIteratorHasElement(&it)) {
+      unsigned int i, n = (unsigned int)length;
+      if (n > sizeof(buf)) n = sizeof(buf);
+#ifndef SAVE_ON_FLASH
+      jsfCachedFlashRead(buf, (uint32_t)addr, n);
+#else
+      jshFlashRead(buf, (uint32_t)addr, n);
+#endif
+      addr += (int)n;
+      length -= (int)n;
+      for (i=0;i<n && jsvArrayBufferIteratorHasElement(&it);i++) {
+        jsvArrayBufferIteratorSetByteValue(&it, (char)buf[i]);
+        jsvArrayBufferIteratorNext(&it);
+      }
+    }
+    jsvArrayBufferIteratorFree(&it);
+  }
   return arr;
 }
 
@@ -197,14 +520,17 @@ void jsfSaveToFlash_writecb(unsigned char ch, uint32_t *cbdata) {
     // write only a word at a time
     cbdata[2]=(uint32_t)(ch<<24) | (cbdata[2]>>8);
 #ifndef FLASH_64BITS_ALIGNEMENT
-    if ((cbdata[1]&3)==3)
+    if ((cbdata[1]&3)==3) {
     jshFlashWrite(&cbdata[2], cbdata[1]&(uint32_t)~3, 4);
+    jsfRecordWrite(cbdata[1]&(uint32_t)~3, 4);
+    }
 #else
 	// We want the flash writes to be done every 64 bits.
 	// Store the first 32 bits and write on next 32 bits word.
     if ((cbdata[1]&7)==7){
       dataToWrite[1] = cbdata[2];
       jshFlashWrite(dataToWrite, cbdata[1]&(uint32_t)~7, 8);
+      jsfRecordWrite(cbdata[1]&(uint32_t)~7, 8);
     } else if ((cbdata[1]&3)==3){
       dataToWrite[0] = cbdata[2];
     }
@@ -245,6 +571,180 @@ void jsfSaveToFlash_writecb(unsigned char ch, uint32_t *cbdata) {
 #endif
 
 
+#ifndef SAVE_ON_FLASH
+/* ----------------------------------------------------------------------------
+ * Segmented (differential) save support
+ *
+ * The var pool is split into SAVE_SEGMENTS pieces and each is compressed as
+ * its own stream. A directory (offset, compressed length and CRC of each
+ * segment) is saved along with the state. On the next save the CRCs tell us
+ * which segments actually changed, so a small change doesn't cost a full
+ * erase and rewrite of every saved-code page - only the pages from the first
+ * changed segment onwards are touched (segments are packed back to back in
+ * flash, so everything after the first change has to shuffle up anyway).
+ *
+ * With save({raw:true}) the segments are stored uncompressed and word-aligned
+ * instead (FLASH_RAW_MAGIC), so loading them at boot is a straight copy
+ * rather than a heatshrink decode - a much faster start at the cost of flash
+ * space. The directory works exactly the same way, and as raw segments never
+ * outgrow their slot a differential save can always rewrite them in place.
+ * ---------------------------------------------------------------------------- */
+#define SAVE_SEGMENTS 16
+#define FLASH_SEGMENT_MAGIC 0x32765345UL // "ESv2" - segments are compressed
+#define FLASH_RAW_MAGIC     0x52765345UL // "ESvR" - segments are stored as-is (see save())
+
+typedef struct {
+  uint32_t magic;    ///< FLASH_SEGMENT_MAGIC or FLASH_RAW_MAGIC
+  uint32_t varCount; ///< jsvGetMemoryTotal() when saved - boundaries depend on it
+  uint32_t endOfData; ///< address just after the last stored byte
+  uint32_t offset[SAVE_SEGMENTS];  ///< where each stored segment starts
+  uint32_t compLen[SAVE_SEGMENTS]; ///< stored length of each segment (== segment length when raw)
+  uint32_t crc[SAVE_SEGMENTS];     ///< CRC of each segment's uncompressed data
+} SaveDirectory;
+
+static uint32_t jsfCrc32(const unsigned char *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  size_t i;
+  while (len--) {
+    crc ^= *(data++);
+    for (i=0;i<8;i++)
+      crc = (crc>>1) ^ (0xEDB88320 & (0-(crc&1)));
+  }
+  return ~crc;
+}
+
+/// Byte offset into the var pool where segment i starts
+static uint32_t jsfSegmentStart(uint32_t totalBytes, int i) {
+  return (uint32_t)(((uint64_t)totalBytes*(uint32_t)i)/SAVE_SEGMENTS);
+}
+
+/* ----------------------------------------------------------------------------
+ * Executing function code straight from flash (see save())
+ *
+ * With SFF_FUNCTIONS_TO_FLASH each function's source string is written to
+ * flash uncompressed during the save, and the function's code child is
+ * replaced by a native string pointing at the memory-mapped copy (via
+ * jshFlashGetMemMapAddress) - so after the save the RAM the source used is
+ * free. Because those pointers get saved as part of the state they survive
+ * a reload unchanged. Before anything is erased we have to do the reverse
+ * and pull any flash-resident code back into RAM (jsfDeExternaliseFunctions),
+ * otherwise the erase would pull the rug out from under running functions.
+ * ---------------------------------------------------------------------------- */
+
+/** If any function's code is a native string pointing into the given
+ * memory-mapped range of flash, copy the code back into a normal RAM string.
+ * Must be called before that range of flash is erased. */
+static void jsfDeExternaliseFunctions(char *mapStart, char *mapEnd) {
+  JsVarRef i, total = (JsVarRef)jsvGetMemoryTotal();
+  for (i=1;i<=total;i++) {
+    JsVar *v = _jsvGetAddressOf(i);
+    if (jsvIsFlatString(v)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip over flat string data
+      continue;
+    }
+    if (!jsvIsFunction(v)) continue;
+    JsVar *fn = jsvLockAgain(v);
+    JsVar *code = jsvObjectGetChild(fn, JSPARSE_FUNCTION_CODE_NAME, 0);
+    if (code && jsvIsNativeString(code) &&
+        code->varData.nativeStr.ptr >= mapStart &&
+        code->varData.nativeStr.ptr < mapEnd) {
+      JsVar *ram = jsvNewFromStringVar(code, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
+      if (ram) {
+        jsvObjectSetChild(fn, JSPARSE_FUNCTION_CODE_NAME, ram);
+        jsvUnLock(ram);
+      } else // if we're out of memory the code is lost when flash is erased :-(
+        jsWarn("Unable to copy function code out of flash - not enough memory\n");
+    }
+    jsvUnLock2(code, fn);
+  }
+}
+
+/** Write each function's source code out to flash (via writecb - cbData laid
+ * out as for jsfSaveToFlash_writecb) and point the function at the
+ * memory-mapped copy instead, freeing the RAM the source occupied. */
+static void jsfExternaliseFunctions(void (*writecb)(unsigned char, uint32_t*), uint32_t *cbData) {
+  unsigned int moved = 0;
+  uint32_t movedBytes = 0;
+  JsVarRef i, total = (JsVarRef)jsvGetMemoryTotal();
+  for (i=1;i<=total;i++) {
+    JsVar *v = _jsvGetAddressOf(i);
+    if (jsvIsFlatString(v)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip over flat string data
+      continue;
+    }
+    if (!jsvIsFunction(v) || jsvIsNativeFunction(v)) continue;
+    JsVar *fn = jsvLockAgain(v);
+    JsVar *code = jsvObjectGetChild(fn, JSPARSE_FUNCTION_CODE_NAME, 0);
+    if (code && jsvIsString(code) && !jsvIsNativeString(code)) {
+      size_t len = jsvGetStringLength(code);
+      char *ptr = (char*)jshFlashGetMemMapAddress(cbData[1]);
+      if (ptr && len && len<=65535 /* native string length limit */ &&
+          cbData[1]+len < cbData[0] /* it has to actually fit */) {
+        JsvStringIterator it;
+        jsvStringIteratorNew(&it, code, 0);
+        while (jsvStringIteratorHasChar(&it)) {
+          writecb((unsigned char)jsvStringIteratorGetChar(&it), cbData);
+          jsvStringIteratorNext(&it);
+        }
+        jsvStringIteratorFree(&it);
+        JsVar *ns = jsvNewNativeString(ptr, len);
+        if (ns) {
+          jsvObjectSetChild(fn, JSPARSE_FUNCTION_CODE_NAME, ns);
+          jsvUnLock(ns);
+          moved++;
+          movedBytes += (uint32_t)len;
+        }
+      }
+    }
+    jsvUnLock2(code, fn);
+  }
+  if (moved)
+    jsiConsolePrintf("\nMoved %d functions (%d bytes) into flash", moved, movedBytes);
+}
+
+#ifdef USE_HOT_FUNCTIONS
+/** Replace every function's source with the lexer's pretokenised form before
+ * saving - comments and whitespace go, and keywords shrink to single token
+ * bytes - so the saved image is smaller and the code lexes faster forever
+ * after. This is the same form hot functions get retokenised into at runtime
+ * (see jsparse.c), so it's idempotent: already-compact code comes out the
+ * same size and is left alone. */
+static void jsfPretokeniseFunctions() {
+  /* we get called mid-save (after the soft kill), so bring the interpreter
+   * back up while we shuffle vars around - see the retry in jsfSaveToFlash */
+  jsvSoftInit();
+  jspSoftInit();
+  unsigned int shrunk = 0;
+  JsVarRef i, total = (JsVarRef)jsvGetMemoryTotal();
+  for (i=1;i<=total;i++) {
+    JsVar *v = _jsvGetAddressOf(i);
+    if (jsvIsFlatString(v)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(v)); // skip over flat string data
+      continue;
+    }
+    if (!jsvIsFunction(v) || jsvIsNativeFunction(v)) continue;
+    JsVar *fn = jsvLockAgain(v);
+    JsVar *code = jsvObjectGetChild(fn, JSPARSE_FUNCTION_CODE_NAME, 0);
+    if (code && jsvIsString(code) && !jsvIsNativeString(code)) {
+      JsVar *tok = jspTokeniseFunctionCode(code);
+      if (tok) {
+        if (jsvGetStringLength(tok) < jsvGetStringLength(code)) {
+          jsvObjectSetChild(fn, JSPARSE_FUNCTION_CODE_NAME, tok);
+          shrunk += (unsigned int)(jsvGetStringLength(code)-jsvGetStringLength(tok));
+        }
+        jsvUnLock(tok);
+      }
+    }
+    jsvUnLock2(code, fn);
+  }
+  if (shrunk)
+    jsiConsolePrintf("Stripped %d bytes of comments and whitespace\n", shrunk);
+  jspSoftKill();
+  jsvSoftKill();
+}
+#endif // USE_HOT_FUNCTIONS
+#endif // SAVE_ON_FLASH
+
 // ------------------------------------------------------------------------
 // ------------------------------------------------------------------------
 //                                                  Global flash read/write
@@ -282,8 +782,328 @@ void jsfSaveToFlash_writecb(unsigned char ch, uint32_t *cbdata) {
 #define FLASH_BOOT_CODE_INFO_LOCATION FLASH_SAVED_CODE_START
 #define FLASH_STATE_END_LOCATION (FLASH_SAVED_CODE_START+FLASH_UNITARY_WRITE_SIZE)
 #define FLASH_DATA_LOCATION (FLASH_SAVED_CODE_START+2*FLASH_UNITARY_WRITE_SIZE)
+#ifndef SAVE_ON_FLASH
+// the segment directory sits just below the magic word
+#define FLASH_DIRECTORY_LOCATION (FLASH_MAGIC_LOCATION - sizeof(SaveDirectory))
+#endif
+
+#if !defined(LINUX) && !defined(SAVE_ON_FLASH)
+/** Try a differential save: if flash already holds a segmented save for the
+ * same var pool size, only erase and rewrite from the first changed segment
+ * onwards (segments are packed, so later ones have to shuffle up anyway).
+ * Returns true if the save has been dealt with - false means the caller
+ * should do a full save. */
+static bool jsfSaveStateDiff(uint32_t *basePtr, uint32_t totalBytes, bool raw) {
+  SaveDirectory dir;
+  jshFlashRead(&dir, FLASH_DIRECTORY_LOCATION, sizeof(SaveDirectory));
+  // a format change (raw<->compressed) means a full save - offsets all move
+  if (dir.magic!=(raw ? FLASH_RAW_MAGIC : FLASH_SEGMENT_MAGIC) ||
+      dir.varCount!=jsvGetMemoryTotal())
+    return false;
+  uint32_t newCrc[SAVE_SEGMENTS];
+  int i, firstChanged = -1;
+  for (i=0;i<SAVE_SEGMENTS;i++) {
+    uint32_t segStart = jsfSegmentStart(totalBytes, i);
+    newCrc[i] = jsfCrc32((unsigned char*)basePtr+segStart, jsfSegmentStart(totalBytes, i+1)-segStart);
+    if (firstChanged<0 && newCrc[i]!=dir.crc[i]) firstChanged = i;
+  }
+  if (firstChanged<0) {
+    jsiConsolePrint("No changes to save\n");
+    return true;
+  }
+  uint32_t writeFrom = dir.offset[firstChanged];
+  uint32_t pageStart, pageLength;
+  if (!jshFlashGetPage(writeFrom, &pageStart, &pageLength)) return false;
+  /* Anything earlier in the first erased page (boot code, unchanged
+   * segments) has to survive, so buffer it and write it back afterwards */
+  uint32_t prefixLen = writeFrom-pageStart;
+  char *prefix = 0;
+  if (prefixLen) {
+    if (prefixLen+64 > jsuGetFreeStack()) return false; // no room to buffer - full save
+    prefix = (char *)alloca(prefixLen);
+    jshFlashRead(prefix, pageStart, prefixLen);
+  }
+  jsiConsolePrint("Erasing changed flash...");
+  uint32_t addr = pageStart;
+  uint32_t ps, pl;
+  if (jshFlashGetPage(addr, &ps, &pl)) {
+    jshFlashErasePage(ps);
+    jsfRecordErase(ps);
+    while (ps+pl < FLASH_MAGIC_LOCATION) {
+      jsiConsolePrint(".");
+      addr = ps+pl;
+      if (!jshFlashGetPage(addr, &ps, &pl)) break;
+      jshFlashErasePage(ps);
+      jsfRecordErase(ps);
+    }
+  }
+  uint32_t cbData[3];
+  cbData[0] = (uint32_t)FLASH_DIRECTORY_LOCATION; // end of available flash
+  cbData[1] = pageStart;
+  cbData[2] = 0;
+  uint32_t j;
+  for (j=0;j<prefixLen;j++)
+    jsfSaveToFlash_writecb((unsigned char)prefix[j], cbData);
+  jsiConsolePrintf("\nWriting %d of %d segments...", SAVE_SEGMENTS-firstChanged, SAVE_SEGMENTS);
+  for (i=firstChanged;i<SAVE_SEGMENTS;i++) {
+    uint32_t segStart = jsfSegmentStart(totalBytes, i);
+    uint32_t segLen = jsfSegmentStart(totalBytes, i+1)-segStart;
+    if (raw) // raw segments stay word-aligned so loading them is a straight copy
+      while (cbData[1]&(FLASH_UNITARY_WRITE_SIZE-1))
+        jsfSaveToFlash_writecb(0, cbData);
+    dir.offset[i] = cbData[1];
+    if (raw) {
+      for (j=0;j<segLen;j++)
+        jsfSaveToFlash_writecb(((unsigned char*)basePtr)[segStart+j], cbData);
+    } else
+      COMPRESS((unsigned char*)basePtr+segStart, segLen, jsfSaveToFlash_writecb, cbData);
+    dir.compLen[i] = cbData[1]-dir.offset[i];
+    dir.crc[i] = newCrc[i];
+  }
+  dir.endOfData = cbData[1];
+  for (j=0;j<FLASH_UNITARY_WRITE_SIZE;j++)
+    jsfSaveToFlash_writecb(0, cbData); // make sure we write everything in buffer
+  if (cbData[1]>=cbData[0]) return false; // didn't fit after all - do a full save
+  jshFlashWrite(&dir, FLASH_DIRECTORY_LOCATION, sizeof(SaveDirectory));
+  jsfRecordWrite(FLASH_DIRECTORY_LOCATION, sizeof(SaveDirectory));
+  uint32_t magic = FLASH_MAGIC;
+  jshFlashWrite(&magic, FLASH_MAGIC_LOCATION, FLASH_UNITARY_WRITE_SIZE);
+  jsfRecordWrite(FLASH_MAGIC_LOCATION, FLASH_UNITARY_WRITE_SIZE);
+  jsiConsolePrint("\nChecking...");
+  uint32_t errors = 0;
+  for (i=firstChanged;i<SAVE_SEGMENTS;i++) {
+    uint32_t cbData2[2];
+    cbData2[0] = dir.offset[i];
+    cbData2[1] = 0;
+    uint32_t segStart = jsfSegmentStart(totalBytes, i);
+    uint32_t segLen = jsfSegmentStart(totalBytes, i+1)-segStart;
+    if (raw) {
+      for (j=0;j<segLen;j++)
+        jsfSaveToFlash_checkcb(((unsigned char*)basePtr)[segStart+j], cbData2);
+    } else
+      COMPRESS((unsigned char*)basePtr+segStart, segLen, jsfSaveToFlash_checkcb, cbData2);
+    errors += cbData2[1];
+  }
+  if (errors)
+    jsiConsolePrintf("\nThere were %d errors!\n", errors);
+  else
+    jsiConsolePrint("\nDone!\n");
+  return true;
+}
+#endif // !LINUX && !SAVE_ON_FLASH
+
+#if defined(LINUX) && !defined(SAVE_ON_FLASH)
+// bounded file reader, so each compressed segment can be decoded as its own stream
+typedef struct { FILE *f; uint32_t remaining; } SegFileRead;
+static int jsfSegFileReadCb(uint32_t *cbdata) {
+  SegFileRead *r = (SegFileRead*)cbdata;
+  if (!r->remaining) return -1;
+  int c = fgetc(r->f);
+  if (c<0) return -1;
+  r->remaining--;
+  return c;
+}
+// compress-to-memory, so we know a segment's size before touching the file
+typedef struct { unsigned char *buf; uint32_t len, size; } SegBuf;
+static void jsfSegBufWriteCb(unsigned char ch, uint32_t *cbdata) {
+  SegBuf *b = (SegBuf*)cbdata;
+  if (b->len >= b->size) {
+    b->size = b->size ? b->size*2 : 1024;
+    b->buf = realloc(b->buf, b->size);
+  }
+  b->buf[b->len++] = ch;
+}
+/// Space a segment gets in the file - some headroom so it can grow a bit without a full rewrite
+static uint32_t jsfSegFileAlloc(uint32_t compLen) {
+  return (compLen + compLen/8 + 64 + 255) & (uint32_t)~255;
+}
+
+/* On Linux state is saved to espruino.state rather than flash, so function
+ * code saved with save(true) is parked in the fake flash area instead - the
+ * top FUNCTION_POOL_PAGES pages of the last free area (the Storage module
+ * claims its pages from the bottom of the first). */
+#define FUNCTION_POOL_PAGES 4
+
+/* Note: this runs in the middle of a save, so it mustn't allocate any JsVars
+ * (which rules out jshFlashGetFree) - it just walks the pages instead. */
+static bool jsfGetFunctionPool(uint32_t *poolStart, uint32_t *poolEnd) {
+  uint32_t addr = 0, pageStart, pageLen = 0, end = 0;
+  while (jshFlashGetPage(addr, &pageStart, &pageLen)) {
+    end = pageStart+pageLen;
+    addr = end;
+  }
+  if (!end || end < (FUNCTION_POOL_PAGES+1)*pageLen) return false;
+  *poolEnd = end;
+  *poolStart = end - FUNCTION_POOL_PAGES*pageLen;
+  return true;
+}
+
+// cbdata = uint32_t[end_address, address, data] - same layout the embedded jsfSaveToFlash_writecb uses
+static void jsfPoolWriteCb(unsigned char ch, uint32_t *cbdata) {
+  if (cbdata[1]<cbdata[0]) {
+    cbdata[2]=(uint32_t)(ch<<24) | (cbdata[2]>>8);
+    if ((cbdata[1]&3)==3) {
+      jshFlashWrite(&cbdata[2], cbdata[1]&(uint32_t)~3, 4);
+      jsfRecordWrite(cbdata[1]&(uint32_t)~3, 4);
+    }
+  }
+  cbdata[1]++;
+}
+
+/// Rewrite the function code pool in fake flash and point functions at it (see save())
+static void jsfSaveFunctionsToFlash() {
+  uint32_t poolStart, poolEnd;
+  char *map;
+  if (!jsfGetFunctionPool(&poolStart, &poolEnd) ||
+      !(map = (char*)jshFlashGetMemMapAddress(poolStart))) {
+    jsWarn("No memory-mapped flash for function code - it stays in RAM\n");
+    return;
+  }
+  /* we get called mid-save (after the soft kill), so bring the interpreter
+   * back up while we shuffle vars around - see the retry in jsfSaveToFlash */
+  jsvSoftInit();
+  jspSoftInit();
+  jsfDeExternaliseFunctions(map, map+(poolEnd-poolStart));
+  uint32_t addr = poolStart, pageStart, pageLen;
+  while (addr<poolEnd && jshFlashGetPage(addr, &pageStart, &pageLen)) {
+    jshFlashErasePage(pageStart);
+    jsfRecordErase(pageStart);
+    addr = pageStart+pageLen;
+  }
+  uint32_t cbData[3] = {poolEnd, poolStart, 0};
+  jsfExternaliseFunctions(jsfPoolWriteCb, cbData);
+  int i;
+  for (i=0;i<4;i++) jsfPoolWriteCb(0xFF, cbData); // flush the word buffer
+  jspSoftKill();
+  jsvSoftKill();
+}
+
+/** Save state to espruino.state in the segmented format, rewriting only the
+ * segments whose contents changed since the last save when possible. With
+ * raw set the segments are stored uncompressed (see save()). */
+static void jsfSaveStateToFile(bool raw) {
+  unsigned int jsVarCount = jsvGetMemoryTotal();
+  uint32_t totalBytes = (uint32_t)(jsVarCount*sizeof(JsVar));
+  unsigned char *basePtr = (unsigned char*)_jsvGetAddressOf(1);
+  uint32_t magic = raw ? FLASH_RAW_MAGIC : FLASH_SEGMENT_MAGIC;
+  SaveDirectory dir, oldDir;
+  bool oldValid = false;
+  FILE *f = fopen("espruino.state","rb");
+  if (f) {
+    unsigned int oldCount;
+    // a format change (raw<->compressed) means a full rewrite - offsets all move
+    if (fread(&oldCount, sizeof(unsigned int), 1, f)==1 &&
+        fread(&oldDir, sizeof(SaveDirectory), 1, f)==1 &&
+        oldDir.magic==magic && oldCount==jsVarCount)
+      oldValid = true;
+    fclose(f);
+  }
+  memset(&dir, 0, sizeof(dir));
+  dir.magic = magic;
+  dir.varCount = jsVarCount;
+  SegBuf bufs[SAVE_SEGMENTS];
+  memset(bufs, 0, sizeof(bufs));
+  bool changedSeg[SAVE_SEGMENTS];
+  bool fullSave = !oldValid;
+  int i, changed = 0;
+  for (i=0;i<SAVE_SEGMENTS;i++) {
+    uint32_t segStart = jsfSegmentStart(totalBytes, i);
+    uint32_t segLen = jsfSegmentStart(totalBytes, i+1)-segStart;
+    dir.crc[i] = jsfCrc32(basePtr+segStart, segLen);
+    changedSeg[i] = !oldValid || dir.crc[i]!=oldDir.crc[i];
+    if (!changedSeg[i]) continue;
+    changed++;
+    if (raw) continue; // stored as-is - always fits its slot, nothing to compress
+    COMPRESS(basePtr+segStart, segLen, jsfSegBufWriteCb, (uint32_t*)&bufs[i]);
+    if (oldValid) {
+      uint32_t oldAlloc = ((i<SAVE_SEGMENTS-1) ? oldDir.offset[i+1] : oldDir.endOfData) - oldDir.offset[i];
+      if (bufs[i].len > oldAlloc) fullSave = true; // grown past its slot
+    }
+  }
+  if (oldValid && !changed) {
+    jsiConsolePrint("\nNo changes to save\n");
+    return;
+  }
+  if (!fullSave) {
+    f = fopen("espruino.state","r+b");
+    if (f) {
+      jsiConsolePrintf("\nSaving %d bytes (%d of %d segments)...", totalBytes, changed, SAVE_SEGMENTS);
+      for (i=0;i<SAVE_SEGMENTS;i++) {
+        uint32_t segStart = jsfSegmentStart(totalBytes, i);
+        dir.offset[i] = oldDir.offset[i];
+        dir.compLen[i] = raw ? (jsfSegmentStart(totalBytes, i+1)-segStart) :
+                         changedSeg[i] ? bufs[i].len : oldDir.compLen[i];
+        if (changedSeg[i]) {
+          fseek(f, (long)dir.offset[i], SEEK_SET);
+          if (raw)
+            fwrite(basePtr+segStart, 1, dir.compLen[i], f);
+          else
+            fwrite(bufs[i].buf, 1, bufs[i].len, f);
+        }
+      }
+      dir.endOfData = oldDir.endOfData;
+      fseek(f, (long)sizeof(unsigned int), SEEK_SET);
+      fwrite(&dir, sizeof(SaveDirectory), 1, f);
+      fclose(f);
+      jsiConsolePrint("\nDone!\n");
+      for (i=0;i<SAVE_SEGMENTS;i++) free(bufs[i].buf);
+      return;
+    }
+    fullSave = true; // couldn't reopen - rewrite from scratch
+  }
+  // full save - compress whatever we skipped above and lay the file out afresh
+  uint32_t off = (uint32_t)(sizeof(unsigned int)+sizeof(SaveDirectory));
+  for (i=0;i<SAVE_SEGMENTS;i++) {
+    uint32_t segStart = jsfSegmentStart(totalBytes, i);
+    uint32_t segLen = jsfSegmentStart(totalBytes, i+1)-segStart;
+    if (raw) {
+      dir.offset[i] = off;
+      dir.compLen[i] = segLen;
+      off += (segLen+3) & (uint32_t)~3; // keep raw segments word-aligned
+      continue;
+    }
+    if (!bufs[i].buf)
+      COMPRESS(basePtr+segStart, segLen, jsfSegBufWriteCb, (uint32_t*)&bufs[i]);
+    dir.offset[i] = off;
+    dir.compLen[i] = bufs[i].len;
+    off += jsfSegFileAlloc(bufs[i].len);
+  }
+  dir.endOfData = off;
+  f = fopen("espruino.state","wb");
+  if (f) {
+    jsiConsolePrintf("\nSaving %d bytes%s...", totalBytes, raw?" uncompressed":"");
+    fwrite(&jsVarCount, sizeof(unsigned int), 1, f);
+    fwrite(&dir, sizeof(SaveDirectory), 1, f);
+    for (i=0;i<SAVE_SEGMENTS;i++) {
+      fseek(f, (long)dir.offset[i], SEEK_SET);
+      if (raw)
+        fwrite(basePtr+jsfSegmentStart(totalBytes, i), 1, dir.compLen[i], f);
+      else
+        fwrite(bufs[i].buf, 1, bufs[i].len, f);
+    }
+    // pad the file out to its full size so segments can be rewritten in place
+    fseek(f, (long)(dir.endOfData-1), SEEK_SET);
+    char zero = 0;
+    fwrite(&zero, 1, 1, f);
+    fclose(f);
+    jsiConsolePrint("\nDone!\n");
+  } else {
+    jsiConsolePrint("\nFile open of espruino.state failed... \n");
+  }
+  for (i=0;i<SAVE_SEGMENTS;i++) free(bufs[i].buf);
+}
+#endif // LINUX && !SAVE_ON_FLASH
 
 void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
+#ifndef SAVE_ON_FLASH
+  jsfInvalidateReadCache(); // saved state is about to overwrite flash
+#endif
+#if !defined(SAVE_ON_FLASH) && defined(USE_HOT_FUNCTIONS)
+  // strip function source down to the pretokenised form first, so the
+  // compact version is what gets saved (and run from here on)
+  if (flags & SFF_SAVE_STATE)
+    jsfPretokeniseFunctions();
+#endif
 #ifdef LINUX
   if (bootCode) {
     FILE *f = fopen("espruino.boot","wb");
@@ -301,7 +1121,17 @@ void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
     }
   }
 
+#ifndef SAVE_ON_FLASH
+  // move function code into the fake flash area first, so the state we
+  // save below is already pointing at it
+  if (flags & SFF_FUNCTIONS_TO_FLASH)
+    jsfSaveFunctionsToFlash();
+#endif
+
   if (flags & SFF_SAVE_STATE) {
+#ifndef SAVE_ON_FLASH
+    jsfSaveStateToFile((flags&SFF_SAVE_RAW)!=0);
+#else
     FILE *f = fopen("espruino.state","wb");
     if (f) {
       unsigned int jsVarCount = jsvGetMemoryTotal();
@@ -335,10 +1165,21 @@ void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
     } else {
       jsiConsolePrint("\nFile open of espruino.state failed... \n");
     }
+#endif // SAVE_ON_FLASH
   }
 #else // !LINUX
   unsigned int dataSize = jsvGetMemoryTotal() * sizeof(JsVar);
   uint32_t *basePtr = (uint32_t *)_jsvGetAddressOf(1);
+#ifndef SAVE_ON_FLASH
+  /* If it's just state being saved (no new boot code) see if we can get away
+   * with only rewriting the segments that changed since the last save */
+  if ((flags & SFF_SAVE_STATE) && !(flags & SFF_FUNCTIONS_TO_FLASH) &&
+      !(jsvIsString(bootCode) && jsvGetStringLength(bootCode)) &&
+      jsfFlashContainsCode() && jsfSaveStateDiff(basePtr, dataSize, (flags&SFF_SAVE_RAW)!=0))
+    return;
+  SaveDirectory dir;
+  memset(&dir, 0, sizeof(dir));
+#endif
   uint32_t pageStart, pageLength;
   bool tryAgain = true;
   bool success = false;
@@ -374,19 +1215,38 @@ void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
 
   while (tryAgain) {
     tryAgain = false;
+#ifndef SAVE_ON_FLASH
+    /* A previous save(true) may have left function code living in the area
+     * we're about to erase - pull it back into RAM first. We're mid-save so
+     * the interpreter has to come back up while vars get shuffled around. */
+    char *mapStart = (char*)jshFlashGetMemMapAddress(FLASH_SAVED_CODE_START);
+    if (mapStart) {
+      jsvSoftInit();
+      jspSoftInit();
+      jsfDeExternaliseFunctions(mapStart, mapStart+(FLASH_MAGIC_LOCATION-FLASH_SAVED_CODE_START));
+      jspSoftKill();
+      jsvSoftKill();
+    }
+#endif
     jsiConsolePrint("Erasing Flash...");
     uint32_t addr = FLASH_SAVED_CODE_START;
     if (jshFlashGetPage((uint32_t)addr, &pageStart, &pageLength)) {
       jshFlashErasePage(pageStart);
+      jsfRecordErase(pageStart);
       while (pageStart+pageLength < FLASH_MAGIC_LOCATION) { // until end address
         jsiConsolePrint(".");
         addr = pageStart+pageLength; // next page
         if (!jshFlashGetPage((uint32_t)addr, &pageStart, &pageLength)) break;
         jshFlashErasePage(pageStart);
+        jsfRecordErase(pageStart);
       }
     }
     // Now start writing
+#ifndef SAVE_ON_FLASH
+    cbData[0] = (uint32_t)FLASH_DIRECTORY_LOCATION; // end of available flash (directory sits above)
+#else
     cbData[0] = FLASH_MAGIC_LOCATION; // end of available flash
+#endif
     cbData[1] = FLASH_DATA_LOCATION;
     cbData[2] = 0; // word data (can only save a word ata a time)
     jsiConsolePrint("\nWriting...");
@@ -418,9 +1278,46 @@ void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
     }
     // write size of boot code to flash
     jshFlashWrite(&originalBootCodeInfo, FLASH_BOOT_CODE_INFO_LOCATION, FLASH_UNITARY_WRITE_SIZE);
+    jsfRecordWrite(FLASH_BOOT_CODE_INFO_LOCATION, FLASH_UNITARY_WRITE_SIZE);
+#ifndef SAVE_ON_FLASH
+    // function code (if requested) sits between the boot code and the compressed state
+    if (flags & SFF_FUNCTIONS_TO_FLASH) {
+      if (jshFlashGetMemMapAddress(FLASH_SAVED_CODE_START)) {
+        jsvSoftInit();
+        jspSoftInit();
+        jsfExternaliseFunctions(jsfSaveToFlash_writecb, cbData);
+        jspSoftKill();
+        jsvSoftKill();
+      } else
+        jsWarn("Flash is not memory-mapped on this board - function code stays in RAM\n");
+    }
+#endif
     // state....
     if (flags & SFF_SAVE_STATE) {
+#ifndef SAVE_ON_FLASH
+      dir.magic = (flags & SFF_SAVE_RAW) ? FLASH_RAW_MAGIC : FLASH_SEGMENT_MAGIC;
+      dir.varCount = jsvGetMemoryTotal();
+      int segi;
+      for (segi=0;segi<SAVE_SEGMENTS;segi++) {
+        uint32_t segStart = jsfSegmentStart(dataSize, segi);
+        uint32_t segLen = jsfSegmentStart(dataSize, segi+1)-segStart;
+        if (flags & SFF_SAVE_RAW) // raw segments stay word-aligned so loading them is a straight copy
+          while (cbData[1]&(FLASH_UNITARY_WRITE_SIZE-1))
+            jsfSaveToFlash_writecb(0, cbData);
+        dir.offset[segi] = cbData[1];
+        if (flags & SFF_SAVE_RAW) {
+          uint32_t j;
+          for (j=0;j<segLen && cbData[1]<cbData[0];j++)
+            jsfSaveToFlash_writecb(((unsigned char*)basePtr)[segStart+j], cbData);
+        } else
+          COMPRESS((unsigned char*)basePtr+segStart, segLen, jsfSaveToFlash_writecb, cbData);
+        dir.compLen[segi] = cbData[1]-dir.offset[segi];
+        dir.crc[segi] = jsfCrc32((unsigned char*)basePtr+segStart, segLen);
+      }
+      dir.endOfData = cbData[1];
+#else
       COMPRESS((unsigned char*)basePtr, dataSize, jsfSaveToFlash_writecb, cbData);
+#endif
     }
     endOfData = cbData[1];
     // make sure we write everything in buffer
@@ -431,6 +1328,15 @@ void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
     writtenBytes = endOfData - FLASH_SAVED_CODE_START;
 
     if (cbData[1]>=cbData[0]) {
+#ifndef SAVE_ON_FLASH
+      if (flags & SFF_SAVE_RAW) {
+        // the uncompressed image doesn't fit - fall back to the normal format
+        jsiConsolePrint("\nRaw image too big for flash - saving compressed instead\n");
+        flags &= (JsvSaveFlashFlags)~SFF_SAVE_RAW;
+        tryAgain = true;
+        continue;
+      }
+#endif
       jsiConsolePrintf("\nERROR: Too big to save to flash (%d vs %d bytes)\n", writtenBytes, FLASH_MAGIC_LOCATION-FLASH_SAVED_CODE_START);
       jsvSoftInit();
       jspSoftInit();
@@ -447,21 +1353,52 @@ void jsfSaveToFlash(JsvSaveFlashFlags flags, JsVar *bootCode) {
   }
 
   if (success) {
+#ifndef SAVE_ON_FLASH
+    if (flags & SFF_SAVE_RAW)
+      jsiConsolePrintf("\nSaved %d bytes uncompressed", writtenBytes);
+    else
+#endif
     jsiConsolePrintf("\nCompressed %d bytes to %d", dataSize, writtenBytes);
     jshFlashWrite(&endOfData, FLASH_STATE_END_LOCATION, FLASH_UNITARY_WRITE_SIZE); // write position of end of data, at start of address space
+    jsfRecordWrite(FLASH_STATE_END_LOCATION, FLASH_UNITARY_WRITE_SIZE);
+#ifndef SAVE_ON_FLASH
+    if (flags & SFF_SAVE_STATE) {
+      jshFlashWrite(&dir, FLASH_DIRECTORY_LOCATION, sizeof(SaveDirectory));
+      jsfRecordWrite(FLASH_DIRECTORY_LOCATION, sizeof(SaveDirectory));
+    }
+#endif
 
     uint32_t magic = FLASH_MAGIC;
     jshFlashWrite(&magic, FLASH_MAGIC_LOCATION, FLASH_UNITARY_WRITE_SIZE);
+    jsfRecordWrite(FLASH_MAGIC_LOCATION, FLASH_UNITARY_WRITE_SIZE);
 
     jsiConsolePrint("\nChecking...");
+    cbData[1] = 0; // increment if fails
+    // TODO: check boot code written ok
+#ifndef SAVE_ON_FLASH
+    // each segment is its own compressed stream, so check them one at a time
+    if (flags & SFF_SAVE_STATE) {
+      int segi;
+      for (segi=0;segi<SAVE_SEGMENTS;segi++) {
+        cbData[0] = dir.offset[segi];
+        uint32_t segStart = jsfSegmentStart(dataSize, segi);
+        uint32_t segLen = jsfSegmentStart(dataSize, segi+1)-segStart;
+        if (flags & SFF_SAVE_RAW) {
+          uint32_t j;
+          for (j=0;j<segLen;j++)
+            jsfSaveToFlash_checkcb(((unsigned char*)basePtr)[segStart+j], cbData);
+        } else
+          COMPRESS((unsigned char*)basePtr+segStart, segLen, jsfSaveToFlash_checkcb, cbData);
+      }
+    }
+#else
     cbData[0] = FLASH_DATA_LOCATION;
     if (bootCodeLen) {
       cbData[0] += bootCodeLen;
     }
-    cbData[1] = 0; // increment if fails
-    // TODO: check boot code written ok
     if (flags & SFF_SAVE_STATE)
       COMPRESS((unsigned char*)basePtr, dataSize, jsfSaveToFlash_checkcb, cbData);
+#endif
     uint32_t errors = cbData[1];
 
     if (!jsfFlashContainsCode()) {
@@ -486,7 +1423,48 @@ void jsfLoadStateFromFlash() {
   if (f) {
     unsigned int jsVarCount;
     fread(&jsVarCount, sizeof(unsigned int), 1, f);
+#ifndef SAVE_ON_FLASH
+    // saved state may contain native strings pointing into memory-mapped
+    // flash (see save()) - make sure the mapping exists before they're used
+    jshFlashGetMemMapAddress(0);
+#endif
 
+#ifndef SAVE_ON_FLASH
+    SaveDirectory dir;
+    bool haveDir = fread(&dir, sizeof(SaveDirectory), 1, f)==1;
+    if (haveDir && dir.magic==FLASH_RAW_MAGIC) {
+      // raw format - the state is stored as-is, so just read it straight in
+      jsiConsolePrintf("\nLoading %d bytes...", jsVarCount*sizeof(JsVar));
+      jsvSetMemoryTotal(jsVarCount);
+      uint32_t totalBytes = (uint32_t)(jsVarCount*sizeof(JsVar));
+      unsigned char *basePtr = (unsigned char*)_jsvGetAddressOf(1);
+      int i;
+      for (i=0;i<SAVE_SEGMENTS;i++) {
+        fseek(f, (long)dir.offset[i], SEEK_SET);
+        fread(basePtr + jsfSegmentStart(totalBytes, i), 1, dir.compLen[i], f);
+      }
+      fclose(f);
+      return;
+    }
+    if (haveDir && dir.magic==FLASH_SEGMENT_MAGIC) {
+      // segmented format - each segment is its own compressed stream
+      jsiConsolePrintf("\nDecompressing to %d bytes...", jsVarCount*sizeof(JsVar));
+      jsvSetMemoryTotal(jsVarCount);
+      uint32_t totalBytes = (uint32_t)(jsVarCount*sizeof(JsVar));
+      unsigned char *basePtr = (unsigned char*)_jsvGetAddressOf(1);
+      int i;
+      for (i=0;i<SAVE_SEGMENTS;i++) {
+        SegFileRead r;
+        r.f = f;
+        r.remaining = dir.compLen[i];
+        fseek(f, (long)dir.offset[i], SEEK_SET);
+        DECOMPRESS(jsfSegFileReadCb, (uint32_t*)&r, basePtr + jsfSegmentStart(totalBytes, i));
+      }
+      fclose(f);
+      return;
+    }
+    fseek(f, (long)sizeof(unsigned int), SEEK_SET); // not segmented - must be the old single-stream format
+#endif
     jsiConsolePrintf("\nDecompressing to %d bytes...", jsVarCount*sizeof(JsVar));
     jsvSetMemoryTotal(jsVarCount);
     /*JsVarRef i;
@@ -507,6 +1485,34 @@ void jsfLoadStateFromFlash() {
   //  unsigned int dataSize = jsvGetMemoryTotal() * sizeof(JsVar);
   uint32_t *basePtr = (uint32_t *)_jsvGetAddressOf(1);
 
+#ifndef SAVE_ON_FLASH
+  SaveDirectory dir;
+  jshFlashRead(&dir, FLASH_DIRECTORY_LOCATION, sizeof(SaveDirectory));
+  if (dir.magic==FLASH_RAW_MAGIC) {
+    // raw format - the state is stored as-is, so just copy it straight in
+    uint32_t totalBytes = dir.varCount*(uint32_t)sizeof(JsVar);
+    jsiConsolePrintf("Loading %d bytes from flash...\n", totalBytes);
+    int i;
+    for (i=0;i<SAVE_SEGMENTS;i++) {
+      uint32_t segStart = jsfSegmentStart(totalBytes, i);
+      jshFlashRead((unsigned char*)basePtr + segStart, dir.offset[i], jsfSegmentStart(totalBytes, i+1)-segStart);
+    }
+    return;
+  }
+  if (dir.magic==FLASH_SEGMENT_MAGIC) {
+    // segmented format - each segment is its own compressed stream
+    uint32_t totalBytes = dir.varCount*(uint32_t)sizeof(JsVar);
+    jsiConsolePrintf("Loading %d bytes from flash...\n", dir.endOfData-FLASH_SAVED_CODE_START);
+    int i;
+    for (i=0;i<SAVE_SEGMENTS;i++) {
+      uint32_t segData[2];
+      segData[0] = dir.offset[i]+dir.compLen[i]; // end address
+      segData[1] = dir.offset[i]; // start address
+      DECOMPRESS(jsfLoadFromFlash_readcb, segData, (unsigned char*)basePtr + jsfSegmentStart(totalBytes, i));
+    }
+    return;
+  }
+#endif
   uint32_t cbData[2];
   uint32_t bootCodeLen;
   jshFlashRead(&bootCodeLen, FLASH_BOOT_CODE_INFO_LOCATION, 4); // length of boot code
@@ -609,11 +1615,13 @@ void jsfRemoveCodeFromFlash() {
   uint32_t addr = FLASH_SAVED_CODE_START;
   if (jshFlashGetPage((uint32_t)addr, &pageStart, &pageLength)) {
     jshFlashErasePage(pageStart);
+    jsfRecordErase(pageStart);
     while (pageStart+pageLength < FLASH_MAGIC_LOCATION) { // until end address
       jsiConsolePrint(".");
       addr = pageStart+pageLength; // next page
       if (!jshFlashGetPage((uint32_t)addr, &pageStart, &pageLength)) break;
       jshFlashErasePage(pageStart);
+      jsfRecordErase(pageStart);
     }
   }
 #endif
@@ -15,13 +15,17 @@
 
 JsVar *jswrap_flash_getPage(int addr);
 JsVar *jswrap_flash_getFree();
-void jswrap_flash_erasePage(JsVar *addr);
+JsVar *jswrap_flash_erasePage(JsVar *addr, bool background);
+JsVar *jswrap_flash_getStats(bool reset);
+bool jswrap_flash_idle();
 void jswrap_flash_write(JsVar *data, int addr);
-JsVar *jswrap_flash_read(int length, int addr);
+JsVar *jswrap_flash_read(int length, int addr, JsVar *data);
 
 typedef enum {
   SFF_SAVE_STATE = 1,      // Should we save state to flash?
-  SFF_BOOT_CODE_ALWAYS = 2 // When saving boot code, ensure it should always be run - even after reset
+  SFF_BOOT_CODE_ALWAYS = 2, // When saving boot code, ensure it should always be run - even after reset
+  SFF_FUNCTIONS_TO_FLASH = 4, // Write function code to flash uncompressed and execute it from there (see save())
+  SFF_SAVE_RAW = 8         // Store the state uncompressed - loads much faster but needs more flash (see save())
 } JsvSaveFlashFlags;
 
 /// Save contents of JsVars into Flash. If bootCode is specified, save bootup code too.
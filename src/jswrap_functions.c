@@ -86,6 +86,9 @@ JsVar *jswrap_function_constructor(JsVar *args) {
     jsvObjectIteratorNext(&it);
   }
   jsvObjectIteratorFree(&it);
+  // the code wasn't scanned for 'arguments' like parsed definitions are
+  // (see jspeFunctionDefinitionInternal), so assume it could be referenced
+  jsvObjectSetChildAndUnLock(fn, JSPARSE_FUNCTION_USES_ARGUMENTS_NAME, jsvNewFromInteger(1));
   jsvObjectSetChildAndUnLock(fn, JSPARSE_FUNCTION_CODE_NAME, v);
   return fn;
 }
@@ -200,13 +203,11 @@ bool jswrap_isNaN(JsVar *v) {
 }
 
 
+static const char jswrap_btoa_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
 NO_INLINE static int jswrap_btoa_encode(int c) {
-  c = c & 0x3F;
-  if (c<26) return 'A'+c;
-  if (c<52) return 'a'+c-26;
-  if (c<62) return '0'+c-52;
-  if (c==62) return '+';
-  return '/'; // c==63
+  return jswrap_btoa_chars[c & 0x3F];
 }
 
 NO_INLINE static int jswrap_atob_decode(int c) {
@@ -240,6 +241,58 @@ JsVar *jswrap_btoa(JsVar *binaryData) {
   int outputLength = ((inputLength+2)/3)*4;
   JsVar* base64Data = jsvNewStringOfLength(outputLength, NULL);
   if (!base64Data) return 0;
+  size_t dstLen;
+  char *dst = jsvGetDataPointer(base64Data, &dstLen);
+  if (jsvIsString(binaryData) && dst) {
+    /* The output of jsvNewStringOfLength is always contiguous, so write
+     * straight into it and pull the input out a block-sized run at a
+     * time, encoding 3 bytes -> 4 chars with a lookup table */
+    JsvStringIterator itb;
+    jsvStringIteratorNew(&itb, binaryData, 0);
+    int remaining = inputLength;
+    while (remaining>=3) {
+      size_t left = jsvStringIteratorGetCharsLeftInBlock(&itb);
+      if (left>=3) {
+        unsigned char *p = (unsigned char *)jsvStringIteratorGetPtr(&itb);
+        size_t groups = left/3;
+        if (groups > (size_t)remaining/3) groups = (size_t)remaining/3;
+        remaining -= (int)(groups*3);
+        jsvStringIteratorSkipInBlock(&itb, groups*3);
+        while (groups--) {
+          unsigned int triple = ((unsigned int)p[0]<<16) | ((unsigned int)p[1]<<8) | p[2];
+          p += 3;
+          *(dst++) = jswrap_btoa_chars[(triple>>18)&0x3F];
+          *(dst++) = jswrap_btoa_chars[(triple>>12)&0x3F];
+          *(dst++) = jswrap_btoa_chars[(triple>>6)&0x3F];
+          *(dst++) = jswrap_btoa_chars[triple&0x3F];
+        }
+      } else { // group straddles a block boundary - take the bytes singly
+        unsigned int triple = 0;
+        int k;
+        for (k=0;k<3;k++) {
+          triple = (triple<<8) | (unsigned char)jsvStringIteratorGetChar(&itb);
+          jsvStringIteratorNext(&itb);
+        }
+        *(dst++) = jswrap_btoa_chars[(triple>>18)&0x3F];
+        *(dst++) = jswrap_btoa_chars[(triple>>12)&0x3F];
+        *(dst++) = jswrap_btoa_chars[(triple>>6)&0x3F];
+        *(dst++) = jswrap_btoa_chars[triple&0x3F];
+        remaining -= 3;
+      }
+    }
+    if (remaining) { // 1 or 2 bytes left - pad with '='
+      unsigned int triple = (unsigned int)(unsigned char)jsvStringIteratorGetChar(&itb)<<16;
+      jsvStringIteratorNext(&itb);
+      if (remaining>1)
+        triple |= (unsigned int)(unsigned char)jsvStringIteratorGetChar(&itb)<<8;
+      *(dst++) = jswrap_btoa_chars[(triple>>18)&0x3F];
+      *(dst++) = jswrap_btoa_chars[(triple>>12)&0x3F];
+      *(dst++) = (remaining>1) ? jswrap_btoa_chars[(triple>>6)&0x3F] : '=';
+      *(dst++) = '=';
+    }
+    jsvStringIteratorFree(&itb);
+    return base64Data;
+  }
   JsvIterator itsrc;
   JsvStringIterator itdst;
   jsvIteratorNew(&itsrc, binaryData, JSIF_EVERY_ARRAY_ELEMENT);
@@ -298,6 +351,48 @@ JsVar *jswrap_atob(JsVar *base64Data) {
   int outputLength = inputLength*3/4;
   JsVar* binaryData = jsvNewStringOfLength(outputLength, NULL);
   if (!binaryData) return 0;
+  size_t dstLen;
+  char *dst = jsvGetDataPointer(binaryData, &dstLen);
+  if (dst) {
+    /* The output of jsvNewStringOfLength is always contiguous, so write
+     * straight into it and pull the base64 text out a block-sized run at
+     * a time, carrying the 4-char group state across block boundaries */
+    JsvStringIterator itb;
+    jsvStringIteratorNew(&itb, base64Data, 0);
+    uint32_t triple = 0;
+    int i = 0, valid = 0;
+    bool leadingWhitespace = true;
+    while (jsvStringIteratorHasChar(&itb)) {
+      size_t n, left = jsvStringIteratorGetCharsLeftInBlock(&itb);
+      char *p = jsvStringIteratorGetPtr(&itb);
+      for (n=0;n<left;n++) {
+        char ch = p[n];
+        if (leadingWhitespace) {
+          if (isWhitespace(ch)) continue;
+          leadingWhitespace = false;
+        }
+        int sextet = jswrap_atob_decode(ch);
+        if (sextet>=0) {
+          triple |= (unsigned int)(sextet) << ((3-i)*6);
+          valid=i;
+        }
+        if (++i == 4) {
+          if (valid>0) *(dst++) = (char)(triple >> 16);
+          if (valid>1) *(dst++) = (char)(triple >> 8);
+          if (valid>2) *(dst++) = (char)(triple);
+          triple = 0; i = 0; valid = 0;
+        }
+      }
+      jsvStringIteratorSkipInBlock(&itb, left);
+    }
+    jsvStringIteratorFree(&itb);
+    if (i) { // partial group left at the end of the string
+      if (valid>0) *(dst++) = (char)(triple >> 16);
+      if (valid>1) *(dst++) = (char)(triple >> 8);
+      if (valid>2) *(dst++) = (char)(triple);
+    }
+    return binaryData;
+  }
   JsvStringIterator itsrc;
   JsvStringIterator itdst;
   jsvStringIteratorNew(&itsrc, base64Data, 0);
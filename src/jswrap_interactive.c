@@ -162,11 +162,28 @@ executed by Espruino every time it starts.
 /*JSON{
   "type" : "function",
   "name" : "save",
-  "generate_full" : "jsiStatus|=JSIS_TODO_FLASH_SAVE;"
+  "generate" : "jswrap_interface_save",
+  "params" : [
+    ["options","JsVar","[optional] `true`, or an object `{flashFunctions:bool, raw:bool}` - see below"]
+  ]
 }
 Save program memory into flash. It will then be loaded automatically every time
 Espruino powers on or is hard-reset.
 
+If `options.flashFunctions` is true (`save(true)` is a shorthand) then as well
+as saving the interpreter's state, the source code of each function is moved
+out of RAM into the saved area of flash, and the function is left pointing
+straight at the copy in flash. On boards where flash is memory-mapped (for
+instance ESP8266) this can free a large number of JsVars for programs with a
+lot of code in them. A later plain `save()` moves the code back into RAM.
+
+If `options.raw` is true the state is stored uncompressed. That takes
+several times more flash, but loading it at boot is just a straight copy
+rather than a decompression, which can knock hundreds of milliseconds off
+the cold-start time - useful if you wake, sample and sleep on a timer. If
+the uncompressed image doesn't fit in the available flash, Espruino falls
+back to the normal compressed format automatically.
+
 This command only executes when the Interpreter returns to the Idle state - for
 instance ```a=1;save();a=2;``` will save 'a' as 2.
 
@@ -181,6 +198,18 @@ hold down Button 1 while also pressing reset. On some boards, Button 1 enters
 bootloader mode, so you will need to press Reset with Button 1 raised, and then
 hold Button 1 down a fraction of a second later.
  */
+void jswrap_interface_save(JsVar *options) {
+  jsiStatus |= JSIS_TODO_FLASH_SAVE;
+  jsiStatus &= (JsiStatus)~(JSIS_SAVE_FUNCTIONS_TO_FLASH|JSIS_SAVE_RAW);
+  if (jsvIsObject(options)) {
+    if (jsvGetBoolAndUnLock(jsvObjectGetChild(options, "flashFunctions", 0)))
+      jsiStatus |= JSIS_SAVE_FUNCTIONS_TO_FLASH;
+    if (jsvGetBoolAndUnLock(jsvObjectGetChild(options, "raw", 0)))
+      jsiStatus |= JSIS_SAVE_RAW;
+  } else if (jsvGetBool(options)) // save(true) is shorthand for {flashFunctions:true}
+    jsiStatus |= JSIS_SAVE_FUNCTIONS_TO_FLASH;
+}
+
 /*JSON{
   "type" : "function",
   "name" : "reset",
@@ -423,6 +452,16 @@ setInterval(function (a,b) {
 If you want to stop your function from being called, pass the number that
 was returned by `setInterval` into the `clearInterval` function.
 
+ **Note:** Intervals of less than 2ms are driven directly by the utility timer
+on boards that have one: the period is kept by the timer interrupt (the next
+deadline is always the last *scheduled* deadline plus the period, so jitter
+never accumulates into drift) and the callback is queued as a priority event,
+ahead of any buffered serial data. This gives bounded-jitter periodic
+execution right down to sub-millisecond periods - but the callback still runs
+from the interpreter, so if it can't keep up, fires are skipped rather than
+queued without bound. Only 4 intervals can be driven this way at once; any
+more behave like normal intervals.
+
  **Note:** If `setDeepSleep(true)` has been called and the interval is greater than 5 seconds, Espruino may execute the interval up to 1 second late. This is because Espruino can only wake from deep sleep every second - and waking early would cause Espruino to waste power while it waited for the correct time.
  */
 /*JSON{
@@ -483,6 +522,14 @@ JsVar *_jswrap_interface_setTimeoutOrInterval(JsVar *func, JsVarFloat interval,
 
     // Add to array
     itemIndex = jsvNewFromInteger(jsiTimerAdd(timerPtr));
+#if !defined(SAVE_ON_FLASH) && !defined(LINUX)
+    /* Short intervals can't hold their rate through the idle loop's timer
+     * bookkeeping, so route them straight to the utility timer (not on the
+     * Linux build - its utility timer IRQ never fires). If no slot is free
+     * the interval just stays on the ordinary timer path. */
+    if (!isTimeout && interval < TIMER_FAST_INTERVAL)
+      jsiFastTimerStart(timerPtr, jsvGetInteger(itemIndex), intervalInt);
+#endif
     jsvUnLock(timerPtr);
     jsiTimersChanged(); // mark timers as changed
   }
@@ -544,9 +591,15 @@ void _jswrap_interface_clearTimeoutOrInterval(JsVar *idVar, bool isTimeout) {
       jsvUnLock2(watchPtr, timerPtr);
     }
     jsvObjectIteratorFree(&it);
+#ifndef SAVE_ON_FLASH
+    jsiFastTimerStopAll(); // watch timeouts are never routed, so all routed intervals just went
+#endif
   } else {
     JsVar *child = jsvIsBasic(idVar) ? jsvFindChildFromVar(timerArrayPtr, idVar, false) : 0;
     if (child) {
+#ifndef SAVE_ON_FLASH
+      jsiFastTimerStop(jsvGetInteger(idVar)); // a no-op unless this interval was utility-timer-backed
+#endif
       JsVar *timerArrayPtr = jsvLock(timerArray);
       jsvRemoveChild(timerArrayPtr, child);
       jsvUnLock2(child, timerArrayPtr);
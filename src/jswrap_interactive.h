@@ -18,6 +18,7 @@ void jswrap_interface_setBusyIndicator(JsVar *pinVar);
 void jswrap_interface_setSleepIndicator(JsVar *pinVar);
 void jswrap_interface_setDeepSleep(bool sleep);
 void jswrap_interface_trace(JsVar *root);
+void jswrap_interface_save(JsVar *options);
 void jswrap_interface_reset(bool clearFlash);
 void jswrap_interface_print(JsVar *v);
 void jswrap_interface_edit(JsVar *funcName);
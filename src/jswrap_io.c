@@ -254,6 +254,10 @@ In this case, pin values are set least significant bit first (from the right-han
 of the array of pins). This means you can use the same pin multiple times, for
 example `digitalWrite([A1,A1,A0,A0],0b0101)` would pulse A0 followed by A1.
 
+If all the pins in the array are distinct they are written together, using a
+single port register write for pins that share a GPIO port - so an 8 pin bus
+can be updated in one operation with all pins changing simultaneously.
+
 If the pin argument is an object with a `write` method, the `write` method will
 be called with the value passed through.
 */
@@ -263,6 +267,39 @@ void jswrap_io_digitalWrite(
   ) {
   // Handle the case where it is an array of pins.
   if (jsvIsArray(pinVar)) {
+#ifndef SAVE_ON_FLASH
+    /* Try and write all pins in one go (a single port register write where
+     * pins share a port). We can only do this if every pin is valid and
+     * distinct - writing the same pin twice is documented to pulse it, which
+     * needs the one-at-a-time path below. */
+    Pin pins[sizeof(JsVarInt)*8];
+    int pinCount = 0;
+    bool batched = true;
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, pinVar);
+    while (batched && jsvObjectIteratorHasValue(&it)) {
+      JsVar *pinPtr = jsvObjectIteratorGetValue(&it);
+      Pin pin = jshGetPinFromVar(pinPtr);
+      jsvUnLock(pinPtr);
+      int i;
+      for (i=0;i<pinCount;i++)
+        if (pins[i]==pin) batched = false; // duplicate
+      if (!jshIsPinValid(pin) || pinCount>=(int)(sizeof(JsVarInt)*8))
+        batched = false;
+      if (batched) pins[pinCount++] = pin;
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    if (batched) {
+      int i;
+      jshPinSetValues(pinCount, pins, value);
+      // set the output value before the pin state, just like jshPinOutput
+      for (i=0;i<pinCount;i++)
+        if (!jshGetPinStateIsManual(pins[i]))
+          jshPinSetState(pins[i], JSHPINSTATE_GPIO_OUT);
+      return;
+    }
+#endif
     JsVarRef pinName = jsvGetLastChild(pinVar); // NOTE: start at end and work back!
     while (pinName) {
       JsVar *pinNamePtr = jsvLock(pinName);
@@ -589,12 +626,26 @@ void jswrap_io_shiftOut(JsVar *pins, JsVar *options, JsVar *data) {
   "params" : [
     ["function", "JsVar", "A Function or String to be executed"],
     ["pin", "pin", "The pin to watch"],
-    ["options", "JsVar",[ "If this is a boolean or integer, it determines whether to call this once (false = default) or every time a change occurs (true)","If this is an object, it can contain the following information: ```{ repeat: true/false(default), edge:'rising'/'falling'/'both'(default), debounce:10}```. `debounce` is the time in ms to wait for bounces to subside, or 0."]]
+    ["options", "JsVar",[ "If this is a boolean or integer, it determines whether to call this once (false = default) or every time a change occurs (true)","If this is an object, it can contain the following information: ```{ repeat: true/false(default), edge:'rising'/'falling'/'both'(default), debounce:10, aggregate:true/false(default), capture:Uint32Array, captureTimeout:10}```. `debounce` is the time in ms to wait for bounces to subside, or 0. With `aggregate:true` edges are counted in the interrupt and delivered as one callback per burst (with a `count` field in the callback's argument), so fast signals can't flood the event queue. See below for `capture`."]]
   ],
   "return" : ["JsVar","An ID that can be passed to clearWatch"]
 }
 Call the function specified when the pin changes. Watches set with `setWatch` can be removed using `clearWatch`.
 
+With `capture:myUint32Array` the watch switches to edge capture mode: every
+edge (rising *and* falling, whatever `edge` says) is timestamped from within
+the interrupt, and the time since the previous edge is written into the array
+in microseconds. The callback only fires once the array is full or the line
+has been quiet for `captureTimeout` ms (10 by default), with
+`{state:bool, time:float, pin:Pin, count:int, data:Uint32Array}` - the first
+`count` entries of `data` are the pulse widths of the burst. Because nothing
+happens at JavaScript speed until the burst is over, this is accurate enough
+to decode IR remote controls and other fast pulse trains that per-edge
+watches drop or mistime under load. The array must be a flat Uint32Array
+(create it with `new Uint32Array(n)` and don't grow it afterwards), and it is
+reused for every burst, so copy anything you need to keep. `debounce` and
+`aggregate` are ignored while capturing.
+
 The function may also take an argument, which is an object of type `{state:bool, time:float, lastTime:float}`.
 
  * `state` is whether the pin is currently a `1` or a `0`
@@ -635,6 +686,11 @@ JsVar *jswrap_interface_setWatch(
   JsVarFloat debounce = 0;
   int edge = 0;
   bool isIRQ = false;
+#ifndef SAVE_ON_FLASH
+  bool aggregate = false;
+  JsVar *captureArr = 0;
+  JsVarFloat captureTimeout = 10;
+#endif
   if (jsvIsObject(repeatOrObject)) {
     JsVar *v;
     repeat = jsvGetBoolAndUnLock(jsvObjectGetChild(repeatOrObject, "repeat", 0));
@@ -655,9 +711,32 @@ JsVar *jswrap_interface_setWatch(
       return 0;
     }
     isIRQ = jsvGetBoolAndUnLock(jsvObjectGetChild(repeatOrObject, "irq", 0));
+#ifndef SAVE_ON_FLASH
+    aggregate = jsvGetBoolAndUnLock(jsvObjectGetChild(repeatOrObject, "aggregate", 0));
+    captureArr = jsvObjectGetChild(repeatOrObject, "capture", 0);
+    v = jsvObjectGetChild(repeatOrObject, "captureTimeout", 0);
+    if (v) captureTimeout = jsvGetFloat(v);
+    jsvUnLock(v);
+    if (isnan(captureTimeout) || captureTimeout<0) captureTimeout = 10;
+#endif
   } else
     repeat = jsvGetBool(repeatOrObject);
 
+#ifndef SAVE_ON_FLASH
+  uint32_t *captureBuf = 0;
+  size_t captureLen = 0; // for arraybuffers jsvGetDataPointer gives the element count
+  if (captureArr) {
+    if (!jsvIsArrayBuffer(captureArr) ||
+        captureArr->varData.arraybuffer.type != ARRAYBUFFERVIEW_UINT32 ||
+        !(captureBuf = (uint32_t*)jsvGetDataPointer(captureArr, &captureLen)) ||
+        (((size_t)captureBuf)&3) || !captureLen) {
+      jsExceptionHere(JSET_ERROR, "'capture' must be a flat Uint32Array");
+      jsvUnLock(captureArr);
+      return 0;
+    }
+  }
+#endif
+
   JsVarInt itemIndex = -1;
   if (!jsvIsFunction(func) && !jsvIsString(func)) {
     jsExceptionHere(JSET_ERROR, "Function or String not supplied!");
@@ -676,6 +755,11 @@ JsVar *jswrap_interface_setWatch(
       if (debounce>0) jsvObjectSetChildAndUnLock(watchPtr, "debounce", jsvNewFromInteger((JsVarInt)jshGetTimeFromMilliseconds(debounce)));
       if (edge) jsvObjectSetChildAndUnLock(watchPtr, "edge", jsvNewFromInteger(edge));
       jsvObjectSetChild(watchPtr, "callback", func); // no unlock intentionally
+#ifndef SAVE_ON_FLASH
+      // the watch holds the capture array - the IRQ writes through a raw
+      // pointer into it, so it must stay alive until the capture is stopped
+      if (captureArr) jsvObjectSetChild(watchPtr, "capture", captureArr);
+#endif
     }
 
     // If nothing already watching the pin, set up a watch
@@ -685,6 +769,13 @@ JsVar *jswrap_interface_setWatch(
     // disable event callbacks by default
     if (exti) {
       jshSetEventCallback(exti, 0);
+#ifndef SAVE_ON_FLASH
+      jshSetEventAggregation(exti, aggregate);
+      jshSetEventCapture(exti, captureBuf, (unsigned int)captureLen,
+                         jshGetTimeFromMilliseconds(captureTimeout));
+      // clearWatch needs to know which channel to stop capturing on
+      if (captureArr && watchPtr) jsvObjectSetChildAndUnLock(watchPtr, "exti", jsvNewFromInteger(exti));
+#endif
       if (isIRQ) {
         if (jsvIsNativeFunction(func)) {
           jshSetEventCallback(exti, (JshEventCallbackCallback)jsvGetNativeFunctionPtr(func));
@@ -704,6 +795,9 @@ JsVar *jswrap_interface_setWatch(
 
 
   }
+#ifndef SAVE_ON_FLASH
+  jsvUnLock(captureArr);
+#endif
   return (itemIndex>=0) ? jsvNewFromInteger(itemIndex) : 0/*undefined*/;
 }
 
@@ -727,6 +821,11 @@ void jswrap_interface_clearWatch(JsVar *idVar) {
       JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
       JsVar *watchPin = jsvObjectGetChild(watchPtr, "pin", 0);
       jshPinWatch(jshGetPinFromVar(watchPin), false);
+#ifndef SAVE_ON_FLASH
+      JsVar *extiVar = jsvObjectGetChild(watchPtr, "exti", 0);
+      if (extiVar) // watch was capturing edges - stop before its buffer is freed
+        jshSetEventCapture((IOEventFlags)jsvGetIntegerAndUnLock(extiVar), 0, 0, 0);
+#endif
       jsvUnLock2(watchPin, watchPtr);
       jsvObjectIteratorNext(&it);
     }
@@ -741,6 +840,11 @@ void jswrap_interface_clearWatch(JsVar *idVar) {
     if (watchNamePtr) { // child is a 'name'
       JsVar *watchPtr = jsvSkipName(watchNamePtr);
       Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+#ifndef SAVE_ON_FLASH
+      JsVar *extiVar = jsvObjectGetChild(watchPtr, "exti", 0);
+      if (extiVar) // watch was capturing edges - stop before its buffer is freed
+        jshSetEventCapture((IOEventFlags)jsvGetIntegerAndUnLock(extiVar), 0, 0, 0);
+#endif
       jsvUnLock(watchPtr);
 
       JsVar *watchArrayPtr = jsvLock(watchArray);
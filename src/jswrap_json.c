@@ -55,23 +55,19 @@ Convert the given object into a JSON string which can subsequently be parsed wit
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space) {
   NOT_USED(replacer);
   JSONFlags flags = JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY;
-  JsVar *result = jsvNewFromEmptyString();
-  if (result) {// could be out of memory
-    char whitespace[11] = "";
-    if (jsvIsUndefined(space) || jsvIsNull(space)) {
-      // nothing
-    } else if (jsvIsNumeric(space)) {
-      unsigned int s = (unsigned int)jsvGetInteger(space);
-      if (s>10) s=10;
-      whitespace[s] = 0;
-      while (s) whitespace[--s]=' ';
-    } else {
-      jsvGetString(space, whitespace, sizeof(whitespace));
-    }
-    if (strlen(whitespace)) flags |= JSON_ALL_NEWLINES|JSON_PRETTY;
-    jsfGetJSONWhitespace(v, result, flags, whitespace);
+  char whitespace[11] = "";
+  if (jsvIsUndefined(space) || jsvIsNull(space)) {
+    // nothing
+  } else if (jsvIsNumeric(space)) {
+    unsigned int s = (unsigned int)jsvGetInteger(space);
+    if (s>10) s=10;
+    whitespace[s] = 0;
+    while (s) whitespace[--s]=' ';
+  } else {
+    jsvGetString(space, whitespace, sizeof(whitespace));
   }
-  return result;
+  if (strlen(whitespace)) flags |= JSON_ALL_NEWLINES|JSON_PRETTY;
+  return jsfGetJSONNewString(v, flags, whitespace);
 }
 
 
@@ -227,6 +223,8 @@ void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_ca
 
         while (jsvStringIteratorHasChar(&it)) {
           unsigned char ch = (unsigned char)jsvStringIteratorGetChar(&it);
+          if (jslPrintTokenisedLiteral(&it, &lastch, user_callback, user_data))
+            continue;
           if (jslNeedSpaceBetween(lastch, ch))
             user_callback(" ", user_data);
           jslFunctionCharAsString(ch, buf, sizeof(buf));
@@ -481,6 +479,46 @@ void jsfGetJSON(JsVar *var, JsVar *result, JSONFlags flags) {
   jsfGetJSONWhitespace(var, result, flags, 0);
 }
 
+static void _jsfGetJSONLenCallback(const char *str, void *user_data) {
+  *(size_t*)user_data += strlen(str);
+}
+
+typedef struct {
+  char *ptr;
+  size_t idx, len;
+} JsfJSONWriteData;
+
+static void _jsfGetJSONWriteCallback(const char *str, void *user_data) {
+  JsfJSONWriteData *data = (JsfJSONWriteData*)user_data;
+  size_t l = strlen(str);
+  if (l > data->len - data->idx) l = data->len - data->idx; // the passes always agree - but don't trust that with memory
+  memcpy(&data->ptr[data->idx], str, l);
+  data->idx += l;
+}
+
+JsVar *jsfGetJSONNewString(JsVar *var, JSONFlags flags, const char *whitespace) {
+  /* Stringifying is deterministic, so measure first and build the result in
+   * one flat allocation with block writes, rather than a string append per
+   * character (which grows the result a block at a time - hundreds of little
+   * allocations for a few KB of output, and as much again for the GC to
+   * sweep up when the result is dropped) */
+  size_t len = 0;
+  jsfGetJSONWithCallback(var, flags, whitespace, _jsfGetJSONLenCallback, &len);
+  JsVar *flat = len ? jsvNewFlatStringOfLength((unsigned int)len) : 0;
+  if (flat) {
+    JsfJSONWriteData data;
+    data.ptr = jsvGetFlatStringPointer(flat);
+    data.idx = 0;
+    data.len = len;
+    jsfGetJSONWithCallback(var, flags, whitespace, _jsfGetJSONWriteCallback, &data);
+    return flat;
+  }
+  // no contiguous block free (or nothing to print) - use a normal growing string
+  JsVar *result = jsvNewFromEmptyString();
+  if (result) jsfGetJSONWhitespace(var, result, flags, whitespace);
+  return result;
+}
+
 void jsfPrintJSON(JsVar *var, JSONFlags flags) {
   jsfGetJSONWithCallback(var, flags, 0, (vcbprintf_callback)jsiConsolePrintString, 0);
 }
@@ -41,6 +41,10 @@ void jsfGetJSONWhitespace(JsVar *var, JsVar *result, JSONFlags flags, const char
 /* Convenience function for using jsfGetJSONWithCallback - print to var */
 void jsfGetJSON(JsVar *var, JsVar *result, JSONFlags flags);
 
+/* Stringify into a new string (flat if possible - the output is measured
+ * with a pre-pass so it can be allocated in one go) */
+JsVar *jsfGetJSONNewString(JsVar *var, JSONFlags flags, const char *whitespace);
+
 /* Convenience function for using jsfGetJSONWithCallback - print to console */
 void jsfPrintJSON(JsVar *var, JSONFlags flags);
 /* Convenience function for using jsfGetJSONForFunctionWithCallback - print to console */
@@ -0,0 +1,474 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript JSONStream - incremental JSON parser that can be fed a
+ * chunk at a time (so the whole document never has to fit in RAM)
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_jsonstream.h"
+#include "jsvar.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+#ifndef SAVE_ON_FLASH
+
+/*JSON{
+  "type" : "class",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "JSONStream"
+}
+An incremental JSON parser. Unlike `JSON.parse` the source doesn't have
+to exist in memory all at once - feed it a chunk at a time (for instance
+straight from a socket's `data` events) and the object tree is built as
+the chunks arrive:
+
+```
+var s = new JSONStream();
+s.write('{"a":1,"b'); // ...more calls as data arrives
+s.write('":[2,3]}');
+var obj = s.end();    // { a:1, b:[2,3] }
+```
+
+Or give the constructor a callback to get `(path, value)` for every
+primitive value instead - nothing is kept in memory at all, which lets
+you pull a few fields out of a document bigger than free RAM:
+
+```
+var s = new JSONStream(function(path, value) {
+  if (path=="config.interval") interval = value;
+});
+s.write(chunk); // ... for each chunk
+s.end();
+```
+ */
+
+// parser states, kept in the "state" child between write() calls
+#define JSONSTREAM_EXPECT_VALUE      0
+#define JSONSTREAM_EXPECT_KEY_OR_END 1
+#define JSONSTREAM_EXPECT_KEY        2
+#define JSONSTREAM_EXPECT_COLON      3
+#define JSONSTREAM_AFTER_VALUE       4
+#define JSONSTREAM_IN_STRING         5
+#define JSONSTREAM_IN_KEY            6
+#define JSONSTREAM_IN_NUMBER         7
+#define JSONSTREAM_IN_KEYWORD        8
+#define JSONSTREAM_COMPLETE          9
+#define JSONSTREAM_ERROR             10
+
+// escape sub-states while inside a string
+#define JSONSTREAM_ESC_NONE    0
+#define JSONSTREAM_ESC_SLASH   1 ///< just seen a backslash
+#define JSONSTREAM_ESC_HEX0    2 ///< 2..5 = collecting \uXXXX hex digits
+
+/// Everything a write() call needs, unpacked from the JSONStream's children
+typedef struct {
+  JsVar *parent; ///< the JSONStream object itself
+  JsVar *stack;  ///< open containers (only used when building the tree)
+  JsVar *path;   ///< current key (string) or index (int) for each open container
+  JsVar *tok;    ///< text of the token being assembled
+  JsVar *cb;     ///< value callback, or 0 = build the tree
+  int state;
+  int esc;       ///< escape sub-state (JSONSTREAM_ESC_*)
+  int uni;       ///< accumulated \uXXXX value
+} JsonStreamCtx;
+
+static void jsonStreamError(JsonStreamCtx *ctx, char ch) {
+  if (ch) jsExceptionHere(JSET_SYNTAXERROR, "Unexpected character '%c' in JSON", ch);
+  else jsExceptionHere(JSET_SYNTAXERROR, "Unexpected end of JSON");
+  ctx->state = JSONSTREAM_ERROR;
+}
+
+/// Build "a.b[2].c" from the path array (event mode)
+static JsVar *jsonStreamGetPathString(JsonStreamCtx *ctx) {
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, ctx->path);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *entry = jsvObjectIteratorGetValue(&it);
+    if (jsvIsString(entry)) {
+      if (jsvGetStringLength(str)) jsvAppendCharacter(str, '.');
+      jsvAppendStringVarComplete(str, entry);
+    } else {
+      jsvAppendPrintf(str, "[%d]", (int)jsvGetInteger(entry));
+    }
+    jsvUnLock(entry);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  return str;
+}
+
+/// Get the value of the last element of an array (the top of our stacks)
+static JsVar *jsonStreamTop(JsVar *arr) {
+  JsVarRef ref = jsvGetLastChild(arr);
+  if (!ref) return 0;
+  return jsvSkipNameAndUnLock(jsvLock(ref));
+}
+
+/// Replace the value of the last element of an array (unlocks value)
+static void jsonStreamSetTopAndUnLock(JsVar *arr, JsVar *value) {
+  jsvUnLock(jsvArrayPop(arr));
+  jsvArrayPushAndUnLock(arr, value);
+}
+
+/// Add a value to the container we're inside (tree mode)
+static void jsonStreamAttach(JsonStreamCtx *ctx, JsVar *value) {
+  JsVar *container = jsonStreamTop(ctx->stack);
+  if (jsvIsArray(container)) {
+    jsvArrayPush(container, value);
+  } else {
+    JsVar *keyStr = jsonStreamTop(ctx->path);
+    JsVar *key = jsvAsArrayIndexAndUnLock(jsvCopy(keyStr, false));
+    jsvUnLock(keyStr);
+    if (key) {
+      jsvAddName(container, jsvMakeIntoVariableName(key, value));
+      jsvUnLock(key);
+    }
+  }
+  jsvUnLock(container);
+}
+
+/// A complete value has been parsed - attach it / report it, and move on
+static void jsonStreamEmitValue(JsonStreamCtx *ctx, JsVar *value) {
+  if (ctx->cb) {
+    JsVar *args[2];
+    args[0] = jsonStreamGetPathString(ctx);
+    args[1] = value;
+    jsvUnLock(jspExecuteFunction(ctx->cb, ctx->parent, 2, args));
+    jsvUnLock(args[0]);
+  } else if (jsvGetArrayLength(ctx->stack)) {
+    jsonStreamAttach(ctx, value);
+  } else {
+    jsvObjectSetChild(ctx->parent, "res", value);
+  }
+  ctx->state = jsvGetArrayLength(ctx->path) ? JSONSTREAM_AFTER_VALUE : JSONSTREAM_COMPLETE;
+}
+
+/// '{' or '[' - open a container (which in tree mode is attached to its parent right away)
+static void jsonStreamOpenContainer(JsonStreamCtx *ctx, bool isArray) {
+  if (!ctx->cb) {
+    JsVar *container = isArray ? jsvNewEmptyArray() : jsvNewObject();
+    if (!container) { jsonStreamError(ctx, isArray?'[':'{'); return; }
+    if (jsvGetArrayLength(ctx->stack)) jsonStreamAttach(ctx, container);
+    else jsvObjectSetChild(ctx->parent, "res", container);
+    jsvArrayPushAndUnLock(ctx->stack, container);
+  }
+  // path entry: arrays hold the current index, objects the current key
+  jsvArrayPushAndUnLock(ctx->path, isArray ? jsvNewFromInteger(0) : jsvNewFromEmptyString());
+  ctx->state = isArray ? JSONSTREAM_EXPECT_VALUE : JSONSTREAM_EXPECT_KEY_OR_END;
+}
+
+/// '}' or ']' - close the innermost container
+static void jsonStreamCloseContainer(JsonStreamCtx *ctx, bool isArray) {
+  JsVar *entry = jsonStreamTop(ctx->path);
+  bool wasArray = jsvIsInt(entry);
+  jsvUnLock(entry);
+  if (!jsvGetArrayLength(ctx->path) || wasArray!=isArray) {
+    jsonStreamError(ctx, isArray?']':'}');
+    return;
+  }
+  jsvUnLock(jsvArrayPop(ctx->path));
+  if (!ctx->cb) jsvUnLock(jsvArrayPop(ctx->stack));
+  ctx->state = jsvGetArrayLength(ctx->path) ? JSONSTREAM_AFTER_VALUE : JSONSTREAM_COMPLETE;
+}
+
+/// The token in ctx->tok is a finished number/keyword - turn it into a value
+static void jsonStreamFinishToken(JsonStreamCtx *ctx) {
+  char buf[32];
+  jsvGetString(ctx->tok, buf, sizeof(buf));
+  JsVar *value = 0;
+  if (ctx->state == JSONSTREAM_IN_NUMBER) {
+    if (strchr(buf, '.') || strchr(buf, 'e') || strchr(buf, 'E'))
+      value = jsvNewFromFloat(stringToFloat(buf));
+    else
+      value = jsvNewFromLongInteger(stringToInt(buf));
+  } else if (strcmp(buf, "true")==0) value = jsvNewFromBool(true);
+  else if (strcmp(buf, "false")==0) value = jsvNewFromBool(false);
+  else if (strcmp(buf, "null")==0) value = jsvNewWithFlags(JSV_NULL);
+  else {
+    jsonStreamError(ctx, buf[0]);
+    return;
+  }
+  jsvUnLock(ctx->tok);
+  ctx->tok = jsvNewFromEmptyString();
+  jsonStreamEmitValue(ctx, value);
+  jsvUnLock(value);
+}
+
+static bool jsonStreamIsWhitespace(char ch) {
+  return ch==' ' || ch=='\t' || ch=='\n' || ch=='\r';
+}
+
+/** Feed one character in. Returns true if the character should be
+ * processed again (a number/keyword is only known to have ended when
+ * the delimiter after it arrives) */
+static bool jsonStreamProcessChar(JsonStreamCtx *ctx, char ch) {
+  switch (ctx->state) {
+  case JSONSTREAM_EXPECT_VALUE:
+    if (jsonStreamIsWhitespace(ch)) break;
+    if (ch=='{') jsonStreamOpenContainer(ctx, false);
+    else if (ch=='[') jsonStreamOpenContainer(ctx, true);
+    else if (ch=='"') { ctx->state = JSONSTREAM_IN_STRING; ctx->esc = JSONSTREAM_ESC_NONE; }
+    else if (ch=='-' || (ch>='0' && ch<='9')) {
+      jsvAppendCharacter(ctx->tok, ch);
+      ctx->state = JSONSTREAM_IN_NUMBER;
+    } else if (ch=='t' || ch=='f' || ch=='n') {
+      jsvAppendCharacter(ctx->tok, ch);
+      ctx->state = JSONSTREAM_IN_KEYWORD;
+    } else if (ch==']') {
+      // only valid as the end of an empty array
+      JsVar *entry = jsonStreamTop(ctx->path);
+      bool emptyArray = jsvIsInt(entry) && jsvGetInteger(entry)==0;
+      jsvUnLock(entry);
+      if (emptyArray) jsonStreamCloseContainer(ctx, true);
+      else jsonStreamError(ctx, ch);
+    } else jsonStreamError(ctx, ch);
+    break;
+  case JSONSTREAM_EXPECT_KEY_OR_END:
+    if (jsonStreamIsWhitespace(ch)) break;
+    if (ch=='}') { jsonStreamCloseContainer(ctx, false); break; }
+    /* fall through */
+  case JSONSTREAM_EXPECT_KEY:
+    if (jsonStreamIsWhitespace(ch)) break;
+    if (ch=='"') { ctx->state = JSONSTREAM_IN_KEY; ctx->esc = JSONSTREAM_ESC_NONE; }
+    else jsonStreamError(ctx, ch);
+    break;
+  case JSONSTREAM_EXPECT_COLON:
+    if (jsonStreamIsWhitespace(ch)) break;
+    if (ch==':') ctx->state = JSONSTREAM_EXPECT_VALUE;
+    else jsonStreamError(ctx, ch);
+    break;
+  case JSONSTREAM_AFTER_VALUE:
+    if (jsonStreamIsWhitespace(ch)) break;
+    if (ch==',') {
+      JsVar *entry = jsonStreamTop(ctx->path);
+      if (jsvIsInt(entry)) { // in an array - move to the next index
+        jsonStreamSetTopAndUnLock(ctx->path, jsvNewFromInteger(jsvGetInteger(entry)+1));
+        ctx->state = JSONSTREAM_EXPECT_VALUE;
+      } else
+        ctx->state = JSONSTREAM_EXPECT_KEY;
+      jsvUnLock(entry);
+    }
+    else if (ch==']') jsonStreamCloseContainer(ctx, true);
+    else if (ch=='}') jsonStreamCloseContainer(ctx, false);
+    else jsonStreamError(ctx, ch);
+    break;
+  case JSONSTREAM_IN_STRING:
+  case JSONSTREAM_IN_KEY:
+    if (ctx->esc == JSONSTREAM_ESC_SLASH) {
+      ctx->esc = JSONSTREAM_ESC_NONE;
+      switch (ch) {
+      case 'b': jsvAppendCharacter(ctx->tok, '\b'); break;
+      case 'f': jsvAppendCharacter(ctx->tok, '\f'); break;
+      case 'n': jsvAppendCharacter(ctx->tok, '\n'); break;
+      case 'r': jsvAppendCharacter(ctx->tok, '\r'); break;
+      case 't': jsvAppendCharacter(ctx->tok, '\t'); break;
+      case 'u': ctx->esc = JSONSTREAM_ESC_HEX0; ctx->uni = 0; break;
+      default: jsvAppendCharacter(ctx->tok, ch); break; // covers \" \\ \/
+      }
+    } else if (ctx->esc >= JSONSTREAM_ESC_HEX0) {
+      int digit = chtod(ch);
+      if (digit<0 || digit>15) { jsonStreamError(ctx, ch); break; }
+      ctx->uni = (ctx->uni<<4) | digit;
+      if (++ctx->esc == JSONSTREAM_ESC_HEX0+4) {
+        // as with the lexer, we only do 8 bit chars
+        jsvAppendCharacter(ctx->tok, (ctx->uni<256) ? (char)ctx->uni : '?');
+        ctx->esc = JSONSTREAM_ESC_NONE;
+      }
+    } else if (ch=='\\') {
+      ctx->esc = JSONSTREAM_ESC_SLASH;
+    } else if (ch=='"') {
+      JsVar *str = ctx->tok;
+      ctx->tok = jsvNewFromEmptyString();
+      if (ctx->state == JSONSTREAM_IN_KEY) {
+        // the key lives in the path array until the value is done
+        jsonStreamSetTopAndUnLock(ctx->path, jsvLockAgain(str));
+        ctx->state = JSONSTREAM_EXPECT_COLON;
+      } else {
+        jsonStreamEmitValue(ctx, str);
+      }
+      jsvUnLock(str);
+    } else {
+      jsvAppendCharacter(ctx->tok, ch);
+    }
+    break;
+  case JSONSTREAM_IN_NUMBER:
+    if (ch=='-' || ch=='+' || ch=='.' || ch=='e' || ch=='E' || (ch>='0' && ch<='9')) {
+      jsvAppendCharacter(ctx->tok, ch);
+    } else {
+      jsonStreamFinishToken(ctx);
+      return true; // the delimiter still needs handling in the new state
+    }
+    break;
+  case JSONSTREAM_IN_KEYWORD:
+    if (ch>='a' && ch<='z') {
+      jsvAppendCharacter(ctx->tok, ch);
+    } else {
+      jsonStreamFinishToken(ctx);
+      return true;
+    }
+    break;
+  case JSONSTREAM_COMPLETE:
+    if (!jsonStreamIsWhitespace(ch)) jsonStreamError(ctx, ch);
+    break;
+  default: // JSONSTREAM_ERROR - ignore everything
+    break;
+  }
+  return false;
+}
+
+/// Unpack a JSONStream's children ready for parsing. Returns false (with an exception) if it isn't valid
+static bool jsonStreamGetCtx(JsVar *parent, JsonStreamCtx *ctx) {
+  ctx->parent = parent;
+  ctx->stack = jsvObjectGetChild(parent, "stack", 0);
+  ctx->path = jsvObjectGetChild(parent, "path", 0);
+  ctx->tok = jsvObjectGetChild(parent, "tok", 0);
+  ctx->cb = jsvObjectGetChild(parent, "cb", 0);
+  ctx->state = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "state", 0));
+  ctx->esc = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "esc", 0));
+  ctx->uni = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "uni", 0));
+  if (jsvIsArray(ctx->path) && jsvIsString(ctx->tok) && (ctx->cb || jsvIsArray(ctx->stack)))
+    return true;
+  jsvUnLock2(ctx->stack, ctx->path);
+  jsvUnLock2(ctx->tok, ctx->cb);
+  jsExceptionHere(JSET_ERROR, "Not a valid JSONStream object");
+  return false;
+}
+
+static void jsonStreamFreeCtx(JsonStreamCtx *ctx) {
+  jsvObjectSetChildAndUnLock(ctx->parent, "state", jsvNewFromInteger(ctx->state));
+  jsvObjectSetChildAndUnLock(ctx->parent, "esc", jsvNewFromInteger(ctx->esc));
+  jsvObjectSetChildAndUnLock(ctx->parent, "uni", jsvNewFromInteger(ctx->uni));
+  jsvObjectSetChild(ctx->parent, "tok", ctx->tok); // may have been replaced
+  jsvUnLock2(ctx->stack, ctx->path);
+  jsvUnLock2(ctx->tok, ctx->cb);
+}
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "JSONStream",
+  "name" : "JSONStream",
+  "generate" : "jswrap_jsonstream_constructor",
+  "params" : [
+    ["callback","JsVar","[optional] A function `(path, value)` called for every primitive value. If supplied, no object tree is built"]
+  ],
+  "return" : ["JsVar","A new JSONStream"]
+}
+Create an incremental JSON parser. Without a callback, feed it data with
+`write` and collect the parsed tree from `end()` (or the `result`
+property). With a callback, each primitive value is reported as
+`(path, value)` - eg. `("config.items[2].name", "foo")` - and nothing
+is kept.
+ */
+JsVar *jswrap_jsonstream_constructor(JsVar *callback) {
+  if (!jsvIsUndefined(callback) && !jsvIsFunction(callback)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a function, got %t", callback);
+    return 0;
+  }
+  JsVar *stream = jspNewObject(0, "JSONStream");
+  if (!stream) return 0;
+  if (jsvIsFunction(callback))
+    jsvObjectSetChild(stream, "cb", callback);
+  else
+    jsvObjectSetChildAndUnLock(stream, "stack", jsvNewEmptyArray());
+  jsvObjectSetChildAndUnLock(stream, "path", jsvNewEmptyArray());
+  jsvObjectSetChildAndUnLock(stream, "tok", jsvNewFromEmptyString());
+  jsvObjectSetChildAndUnLock(stream, "state", jsvNewFromInteger(JSONSTREAM_EXPECT_VALUE));
+  return stream;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONStream",
+  "name" : "write",
+  "generate" : "jswrap_jsonstream_write",
+  "params" : [
+    ["data","JsVar","A String containing the next chunk of JSON"]
+  ],
+  "return" : ["bool","False if a parse error has occurred (an exception is thrown too)"]
+}
+Feed the parser the next chunk of the document. Chunks can split the
+text anywhere - even in the middle of a number, string or escape.
+ */
+bool jswrap_jsonstream_write(JsVar *parent, JsVar *data) {
+  if (!jsvIsString(data)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a String, got %t", data);
+    return false;
+  }
+  JsonStreamCtx ctx;
+  if (!jsonStreamGetCtx(parent, &ctx)) return false;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, data, 0);
+  while (jsvStringIteratorHasChar(&it) && ctx.state!=JSONSTREAM_ERROR && !jspHasError()) {
+    char ch = jsvStringIteratorGetChar(&it);
+    if (jsonStreamProcessChar(&ctx, ch))
+      jsonStreamProcessChar(&ctx, ch); // token ended - char belongs to what follows
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  bool ok = ctx.state != JSONSTREAM_ERROR;
+  jsonStreamFreeCtx(&ctx);
+  return ok;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONStream",
+  "name" : "end",
+  "generate" : "jswrap_jsonstream_end",
+  "return" : ["JsVar","The parsed value (or undefined if a callback was used)"]
+}
+Signal that the document is complete. Throws if the JSON ended
+mid-value. Returns the parsed tree (like `JSON.parse`) unless a
+callback was supplied to the constructor.
+ */
+JsVar *jswrap_jsonstream_end(JsVar *parent) {
+  JsonStreamCtx ctx;
+  if (!jsonStreamGetCtx(parent, &ctx)) return 0;
+  // a top-level number/keyword is only finished by the end of the document
+  if (ctx.state==JSONSTREAM_IN_NUMBER || ctx.state==JSONSTREAM_IN_KEYWORD)
+    jsonStreamFinishToken(&ctx);
+  if (ctx.state != JSONSTREAM_COMPLETE && ctx.state != JSONSTREAM_ERROR)
+    jsonStreamError(&ctx, 0);
+  jsonStreamFreeCtx(&ctx);
+  return jsvObjectGetChild(parent, "res", 0);
+}
+
+/*JSON{
+  "type" : "property",
+  "class" : "JSONStream",
+  "name" : "complete",
+  "generate" : "jswrap_jsonstream_complete",
+  "return" : ["bool","True if a complete value has been parsed"]
+}
+True once a complete JSON value has been parsed
+ */
+bool jswrap_jsonstream_complete(JsVar *parent) {
+  return jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "state", 0)) == JSONSTREAM_COMPLETE;
+}
+
+/*JSON{
+  "type" : "property",
+  "class" : "JSONStream",
+  "name" : "result",
+  "generate" : "jswrap_jsonstream_result",
+  "return" : ["JsVar","The value parsed so far (undefined if a callback was used)"]
+}
+The tree parsed so far. Valid once `complete` is true, but can also be
+peeked at while parsing is still going on.
+ */
+JsVar *jswrap_jsonstream_result(JsVar *parent) {
+  return jsvObjectGetChild(parent, "res", 0);
+}
+
+#endif // SAVE_ON_FLASH
@@ -0,0 +1,21 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * JavaScript JSONStream - incremental JSON parser that can be fed a
+ * chunk at a time (so the whole document never has to fit in RAM)
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_jsonstream_constructor(JsVar *callback);
+bool jswrap_jsonstream_write(JsVar *parent, JsVar *data);
+JsVar *jswrap_jsonstream_end(JsVar *parent);
+bool jswrap_jsonstream_complete(JsVar *parent);
+JsVar *jswrap_jsonstream_result(JsVar *parent);
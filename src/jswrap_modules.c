@@ -22,6 +22,19 @@
 #ifdef USE_FILESYSTEM
 #include "jswrap_fs.h"
 #endif
+#ifndef SAVE_ON_FLASH
+#include "jswrap_storage.h"
+#include "jswrap_json.h" // for snapshotting pure module exports
+#ifdef USE_HEATSHRINK
+  #include "compress_heatshrink.h"
+  #define COMPRESS heatshrink_encode
+  #define DECOMPRESS heatshrink_decode
+#else
+  #include "compress_rle.h"
+  #define COMPRESS rle_encode
+  #define DECOMPRESS rle_decode
+#endif
+#endif
 
 /*JSON{
   "type" : "class",
@@ -34,6 +47,119 @@ static JsVar *jswrap_modules_getModuleList() {
   return jsvObjectGetChild(execInfo.hiddenRoot, JSPARSE_MODULE_CACHE_NAME, JSV_OBJECT);
 }
 
+#ifndef SAVE_ON_FLASH
+/* Stored module archive (see Modules.addStored) - each module's source is
+ * kept heatshrink-compressed in the Storage log under a "mod:" key, and
+ * require() decompresses it on demand. Once a module has run, only its
+ * exports stay in RAM (that's all the module cache ever keeps) - so the
+ * source costs nothing between the store and the first require(). */
+#define JSMODULE_STORAGE_PREFIX "mod:"
+#define JSMODULE_EXPORTS_PREFIX "exp:"
+// Storage keys max out at 24 chars, minus the prefix
+#define JSMODULE_MAX_NAME_LEN 20
+/// Top bit of the packed length header marks a 'pure' module (see Modules.addStored)
+#define JSMODULE_LEN_PURE_FLAG 0x80000000U
+
+static void jsfModuleCompressCb(unsigned char ch, uint32_t *cbdata) {
+  jsvAppendCharacter((JsVar*)cbdata, (char)ch);
+}
+static int jsfModuleDecompressCb(uint32_t *cbdata) {
+  JsvStringIterator *it = (JsvStringIterator*)cbdata;
+  if (!jsvStringIteratorHasChar(it)) return -1;
+  int ch = (unsigned char)jsvStringIteratorGetChar(it);
+  jsvStringIteratorNext(it);
+  return ch;
+}
+
+/// Build the Storage key for a module, or 0 if the name can't be a stored module
+static JsVar *jswrap_modules_getStorageKey(JsVar *moduleName, const char *prefix) {
+  if (jsvGetStringLength(moduleName) > JSMODULE_MAX_NAME_LEN) return 0;
+  JsVar *key = jsvNewFromString(prefix);
+  if (key) jsvAppendStringVarComplete(key, moduleName);
+  return key;
+}
+
+/// Read a compressed blob back from Storage - 0 if not there. flagOut gets the header's top bit
+static JsVar *jswrap_modules_readPacked(JsVar *moduleName, const char *prefix, bool *flagOut) {
+  JsVar *key = jswrap_modules_getStorageKey(moduleName, prefix);
+  if (!key) return 0;
+  JsVar *packed = jswrap_storage_read(key);
+  jsvUnLock(key);
+  if (!packed) return 0;
+  JsVar *source = 0;
+  if (jsvGetStringLength(packed) > 4) {
+    // 4 byte uncompressed length, then the compressed stream
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, packed, 0);
+    uint32_t origLen = 0;
+    int i;
+    for (i=0;i<4;i++) {
+      origLen |= (uint32_t)(unsigned char)jsvStringIteratorGetChar(&it) << (8*i);
+      jsvStringIteratorNext(&it);
+    }
+    if (flagOut) *flagOut = (origLen & JSMODULE_LEN_PURE_FLAG)!=0;
+    origLen &= (uint32_t)~JSMODULE_LEN_PURE_FLAG;
+    if (origLen)
+      source = jsvNewFlatStringOfLength(origLen); // the decompressor needs contiguous output
+    if (source)
+      DECOMPRESS(jsfModuleDecompressCb, (uint32_t*)&it, (unsigned char*)jsvGetFlatStringPointer(source));
+    jsvStringIteratorFree(&it);
+  }
+  jsvUnLock(packed);
+  return source;
+}
+
+/// Compress a string into Storage with the 4 byte length header. flag sets the header's top bit
+static void jswrap_modules_writePacked(JsVar *moduleName, const char *prefix, JsVar *source, bool flag) {
+  JsVar *key = jswrap_modules_getStorageKey(moduleName, prefix);
+  if (!key) {
+    jsExceptionHere(JSET_ERROR, "Module name must be %d characters or less", JSMODULE_MAX_NAME_LEN);
+    return;
+  }
+  // the compressor needs its input contiguous
+  size_t sourceLen = jsvGetStringLength(source);
+  JsVar *flat = jsvNewFlatStringOfLength((unsigned int)sourceLen);
+  JsVar *packed = jsvNewFromEmptyString();
+  if (flat && packed) {
+    jsvGetStringChars(source, 0, jsvGetFlatStringPointer(flat), sourceLen);
+    // 4 byte uncompressed length, then the compressed stream
+    uint32_t header = (uint32_t)sourceLen | (flag ? JSMODULE_LEN_PURE_FLAG : 0);
+    int i;
+    for (i=0;i<4;i++)
+      jsvAppendCharacter(packed, (char)((header>>(8*i))&0xFF));
+    COMPRESS((unsigned char*)jsvGetFlatStringPointer(flat), sourceLen, jsfModuleCompressCb, (uint32_t*)packed);
+    jsvUnLock(flat);
+    flat = 0;
+    jswrap_storage_write(key, packed);
+  }
+  jsvUnLock3(flat, packed, key);
+}
+
+/// Get a module's source out of the stored archive, decompressed - 0 if not stored
+static JsVar *jswrap_modules_getStored(JsVar *moduleName, bool *isPure) {
+  return jswrap_modules_readPacked(moduleName, JSMODULE_STORAGE_PREFIX, isPure);
+}
+
+/// Get a pure module's snapshotted exports back (see Modules.addStored) - 0 if none stored
+static JsVar *jswrap_modules_getStoredExports(JsVar *moduleName) {
+  JsVar *src = jswrap_modules_readPacked(moduleName, JSMODULE_EXPORTS_PREFIX, 0);
+  if (!src) return 0;
+  JsVar *exports = jspEvaluateVar(src, 0, 0);
+  jsvUnLock(src);
+  return exports;
+}
+
+/// Snapshot a pure module's exports so the next boot can relink them without running the body
+static void jswrap_modules_storeExports(JsVar *moduleName, JsVar *moduleExport) {
+  JsVar *src = jsvNewFromString("(");
+  if (!src) return;
+  jsfGetJSON(moduleExport, src, JSON_NONE);
+  jsvAppendString(src, ")");
+  jswrap_modules_writePacked(moduleName, JSMODULE_EXPORTS_PREFIX, src, false);
+  jsvUnLock(src);
+}
+#endif // SAVE_ON_FLASH
+
 /*JSON{
   "type" : "function",
   "name" : "require",
@@ -73,29 +199,49 @@ JsVar *jswrap_require(JsVar *moduleName) {
   } else {
     // Now try and load it
     JsVar *fileContents = 0;
+#ifndef SAVE_ON_FLASH
+    bool pureModule = false;
+#endif
     //if (jsvIsStringEqual(moduleName,"http")) {}
     //if (jsvIsStringEqual(moduleName,"fs")) {}
-#ifdef USE_FILESYSTEM
-    JsVar *modulePath = jsvNewFromString("node_modules/");
-    if (!modulePath) return 0; // out of memory
-    jsvAppendStringVarComplete(modulePath, moduleName);
-    jsvAppendString(modulePath,".js");
-    fileContents = jswrap_fs_readFile(modulePath);
-    jsvUnLock(modulePath);
-    JsVar *exception = jspGetException();
-    if (exception) {  // throw away exception & file if we had one
-      execInfo.execute = execInfo.execute & (JsExecFlags)~EXEC_EXCEPTION;
-      jsvUnLock2(fileContents, exception);
-      fileContents = 0;
+#ifndef SAVE_ON_FLASH
+    /* a pure stored module may have its exports snapshotted from a previous
+     * require() - relink those rather than running the module body again */
+    moduleExport = jswrap_modules_getStoredExports(moduleName);
+    if (!moduleExport) {
+      // is it in the stored module archive? (see Modules.addStored)
+      fileContents = jswrap_modules_getStored(moduleName, &pureModule);
     }
 #endif
-    if (!fileContents || jsvIsStringEqual(fileContents,"")) {
+    if (!moduleExport) {
+#ifdef USE_FILESYSTEM
+      if (!fileContents) {
+        JsVar *modulePath = jsvNewFromString("node_modules/");
+        if (!modulePath) return 0; // out of memory
+        jsvAppendStringVarComplete(modulePath, moduleName);
+        jsvAppendString(modulePath,".js");
+        fileContents = jswrap_fs_readFile(modulePath);
+        jsvUnLock(modulePath);
+        JsVar *exception = jspGetException();
+        if (exception) {  // throw away exception & file if we had one
+          execInfo.execute = execInfo.execute & (JsExecFlags)~EXEC_EXCEPTION;
+          jsvUnLock2(fileContents, exception);
+          fileContents = 0;
+        }
+      }
+#endif
+      if (!fileContents || jsvIsStringEqual(fileContents,"")) {
+        jsvUnLock(fileContents);
+        jsExceptionHere(JSET_ERROR, "Module %q not found", moduleName);
+        return 0;
+      }
+      moduleExport = jspEvaluateModule(fileContents);
       jsvUnLock(fileContents);
-      jsExceptionHere(JSET_ERROR, "Module %q not found", moduleName);
-      return 0;
+#ifndef SAVE_ON_FLASH
+      if (moduleExport && pureModule && !jspHasError())
+        jswrap_modules_storeExports(moduleName, moduleExport);
+#endif
     }
-    moduleExport = jspEvaluateModule(fileContents);
-    jsvUnLock(fileContents);
   }
 
   // Now save module
@@ -216,3 +362,43 @@ void jswrap_modules_addCached(JsVar *id, JsVar *sourceCode) {
   jsvUnLock(moduleList);
 
 }
+
+#ifndef SAVE_ON_FLASH
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Modules",
+  "name" : "addStored",
+  "generate" : "jswrap_modules_addStored",
+  "params" : [
+    ["id","JsVar","The module name (20 characters max)"],
+    ["sourcecode","JsVar","The module's sourcecode"],
+    ["pure","bool","If true, the module's exports are snapshotted the first time `require()` runs it, and later boots relink the snapshot instead of executing the module body again (see below)"]
+  ]
+}
+Compress the given module's source code and store it in flash (using the
+`Storage` module, under the key `mod:` + the module name). Unlike
+`Modules.addCached` the source isn't executed and doesn't use any RAM - it
+is decompressed and run the first time `require()` asks for it, after
+which only the module's exports are kept.
+
+Marking a module `pure` promises that its exports depend on nothing but the
+source itself: no closed-over internal state, hardware setup or other side
+effects. The exports object is then serialised (functions included) to the
+Storage key `exp:` + the module name after the first `require()`, and
+subsequent boots evaluate that snapshot directly - the module body never
+runs again, which can cut boot time considerably. Don't mark modules pure
+if their functions share hidden state!
+
+Use `require("Storage").erase("mod:"+name)` to remove a stored module (and
+`"exp:"+name` for a pure module's snapshot), and `Modules.removeCached(name)`
+if it has already been `require`d.
+ */
+void jswrap_modules_addStored(JsVar *id, JsVar *sourceCode, bool pure) {
+  if (!jsvIsString(id) || !jsvIsString(sourceCode)) {
+    jsExceptionHere(JSET_ERROR, "args must be addStored(string, string)");
+    return;
+  }
+  jswrap_modules_writePacked(id, JSMODULE_STORAGE_PREFIX, sourceCode, pure);
+}
+#endif // SAVE_ON_FLASH
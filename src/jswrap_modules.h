@@ -19,3 +19,4 @@ JsVar *jswrap_modules_getCached();
 void jswrap_modules_removeCached(JsVar *id);
 void jswrap_modules_removeAllCached();
 void jswrap_modules_addCached(JsVar *id, JsVar *sourceCode);
+void jswrap_modules_addStored(JsVar *id, JsVar *sourceCode, bool pure);
@@ -406,7 +406,7 @@ bool jswrap_object_hasOwnProperty(JsVar *parent, JsVar *name) {
       char str[32];
       jsvGetString(propName, str, sizeof(str));
 
-      JsVar *v = jswBinarySearch(symbols, parent, str);
+      JsVar *v = jswSymLookup(symbols, parent, str);
       if (v) contains = true;
       jsvUnLock(v);
     }
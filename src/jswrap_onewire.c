@@ -16,6 +16,7 @@
 #include "jswrap_onewire.h"
 #include "jsdevices.h"
 #include "jsinteractive.h"
+#include "jswrap_promise.h"
 
 /*JSON{
   "type" : "class",
@@ -88,6 +89,25 @@ static void NO_INLINE OneWireWrite(Pin pin, int bits, unsigned long long data) {
   }
 }
 
+/** Decode a 16 character hex ROM string (as returned by search) to the 64 bit address */
+static unsigned long long OneWireDecodeROM(JsVar *rom) {
+  unsigned long long romdata = 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, rom, 0);
+  int i;
+  for (i=0;i<8;i++) {
+    char b[3];
+    b[0] = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+    b[1] = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+    b[2] = 0;
+    romdata = romdata | (((unsigned long long)stringToIntWithRadix(b,16,0)) << (i*8));
+  }
+  jsvStringIteratorFree(&it);
+  return romdata;
+}
+
 /*JSON{
   "type" : "constructor",
   "class" : "OneWire",
@@ -145,26 +165,9 @@ void jswrap_onewire_select(JsVar *parent, JsVar *rom) {
   // perform a reset
   OneWireReset(pin);
 
-  // decode the address
-  unsigned long long romdata = 0;
-  JsvStringIterator it;
-  jsvStringIteratorNew(&it, rom, 0);
-  int i;
-  for (i=0;i<8;i++) {
-    char b[3];
-    b[0] = jsvStringIteratorGetChar(&it);
-    jsvStringIteratorNext(&it);
-    b[1] = jsvStringIteratorGetChar(&it);
-    jsvStringIteratorNext(&it);
-    b[2] = 0;
-    romdata = romdata | (((unsigned long long)stringToIntWithRadix(b,16,0)) << (i*8));
-
-  }
-  jsvStringIteratorFree(&it);
-
   // finally write data out
   OneWireWrite(pin, 8, 0x55);
-  OneWireWrite(pin, 64, romdata);
+  OneWireWrite(pin, 64, OneWireDecodeROM(rom));
 }
 
 /*JSON{
@@ -247,6 +250,103 @@ JsVar *jswrap_onewire_read(JsVar *parent, JsVar *count) {
 }
 
 
+/*JSON{
+  "type" : "method",
+  "class" : "OneWire",
+  "name" : "transact",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_onewire_transact",
+  "params" : [
+    ["data","JsVar","A byte (or array of bytes) to write after the reset"],
+    ["options","JsVar","The number of bytes to read back, or `{rx:int, rom:\"..\", power:bool, async:bool}` (see below)"]
+  ],
+  "return" : ["JsVar","A Uint8Array of the bytes read (if `rx` was requested), otherwise whether a device responded to the reset - or a Promise of the same with `async:true`"]
+}
+Perform a whole OneWire transaction in one native operation: a reset, then
+optionally a ROM select, then the given bytes written, then `rx` bytes read
+back. Unlike doing the same with `reset`/`select`/`write`/`read`, no
+JavaScript runs between the phases, so the bus timing is as tight as the
+protocol allows.
+
+The second argument can just be the number of bytes to read, or an object:
+
+ * `rx` - number of bytes to read after writing (default 0)
+ * `rom` - a device address from `OneWire.search()`. If set, the device is
+   selected (like `select`) before `data` is written
+ * `power` - leave the bus powered afterwards (like `write`'s power argument)
+ * `async` - return a Promise. The transaction itself still runs to
+   completion first, but completion is reported via the job queue so
+   `.then` callbacks fire from the idle loop
+
+For example reading a DS18B20's scratchpad is just
+`ow.transact([0xCC,0xBE], 9)`, or for one device of several,
+`ow.transact([0xBE], {rom:device, rx:9})`.
+
+If no device responds to the reset, nothing is written and the result is
+`false`.
+ */
+JsVar *jswrap_onewire_transact(JsVar *parent, JsVar *data, JsVar *options) {
+  Pin pin = onewire_getpin(parent);
+  if (!jshIsPinValid(pin)) return 0;
+
+  JsVarInt rx = 0;
+  JsVar *rom = 0;
+  bool power = false, async = false;
+  if (jsvIsObject(options)) {
+    rx = jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "rx", 0));
+    rom = jsvObjectGetChild(options, "rom", 0);
+    power = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "power", 0));
+    async = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "async", 0));
+  } else if (jsvIsNumeric(options))
+    rx = jsvGetInteger(options);
+  if (rom && !(jsvIsString(rom) && jsvGetStringLength(rom)==16)) {
+    jsExceptionHere(JSET_TYPEERROR, "Invalid OneWire device address %q", rom);
+    jsvUnLock(rom);
+    return 0;
+  }
+
+  JsVar *result = 0;
+  if (OneWireReset(pin)) {
+    if (rom) {
+      OneWireWrite(pin, 8, 0x55);
+      OneWireWrite(pin, 64, OneWireDecodeROM(rom));
+    }
+    jsvIterateCallback(data, (void (*)(int,  void *))_jswrap_onewire_write_cb, (void*)&pin);
+    if (power) {
+      // actively pull the line high for parasitically powered devices (see write)
+      jshPinSetValue(pin, 1);
+      jshPinSetState(pin, JSHPINSTATE_GPIO_OUT);
+    }
+    if (rx>0) {
+      result = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, rx);
+      if (result) {
+        JsvArrayBufferIterator it;
+        jsvArrayBufferIteratorNew(&it, result, 0);
+        while (rx--) {
+          jsvArrayBufferIteratorSetByteValue(&it, (char)OneWireRead(pin, 8));
+          jsvArrayBufferIteratorNext(&it);
+        }
+        jsvArrayBufferIteratorFree(&it);
+      }
+    } else
+      result = jsvNewFromBool(true);
+  } else
+    result = jsvNewFromBool(false);
+  jsvUnLock(rom);
+
+  if (async) {
+    /* As with I2C's async mode - the transaction has already run, but
+     * completion is reported via a promise resolved through the job queue,
+     * so .then fires from the idle loop. A port driving OneWire from a
+     * hardware peripheral could return with the transaction still going. */
+    JsVar *promise = jspromise_create();
+    if (promise) jspromise_resolve(promise, result);
+    jsvUnLock(result);
+    return promise;
+  }
+  return result;
+}
+
 /*JSON{
   "type" : "method",
   "class" : "OneWire",
@@ -29,6 +29,17 @@
 #include "jswrap_pipe.h"
 #include "jswrap_object.h"
 #include "jswrap_stream.h"
+#ifdef USE_FILESYSTEM
+#include "jswrap_file.h"
+#endif
+#ifdef USE_NET
+#include "jswrap_net.h"
+#endif
+
+/// Largest chunk adaptive sizing will grow to (see handlePipe)
+#define JSPIPE_CHUNK_MAX 2048
+/// Most bytes all pipes together may move per idle cycle
+#define JSPIPE_IDLE_BUDGET 16384
 
 static JsVar* pipeGetArray(bool create) {
   return jsvObjectGetChild(execInfo.hiddenRoot, "pipes", create ? JSV_ARRAY : 0);
@@ -100,9 +111,59 @@ static void handlePipeClose(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
   jsvUnLock(idx);
 }
 
-static bool handlePipe(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
+/** Fast path for pipes between built-in streams. If read/write are still the
+ * native functions we know, we can move the data entirely in C - the stream's
+ * whole receive buffer is handed straight to the destination in one go, with
+ * no JS function calls at all (JS only hears about the pipe again when it
+ * completes). Returns false if this isn't a pairing we know, in which case
+ * the caller should fall back to executing read/write as JS. */
+static bool handlePipeNative(JsVar *pipe, JsVar *source, JsVar *destination,
+                             JsVar *readFunc, JsVar *writeFunc,
+                             JsVarInt chunkSize, JsVar *position, bool *dataTransferred) {
+  void *readPtr = jsvGetNativeFunctionPtr(readFunc);
+  void *writePtr = jsvGetNativeFunctionPtr(writeFunc);
+  bool streamSource = readPtr==(void*)jswrap_stream_read;
+  bool fileSource = false, fileDest = false, socketDest = false;
+#ifdef USE_FILESYSTEM
+  fileSource = readPtr==(void*)jswrap_file_read;
+  fileDest = writePtr==(void*)jswrap_file_write;
+#endif
+#ifdef USE_NET
+  socketDest = writePtr==(void*)jswrap_net_socket_write;
+#endif
+  if (!(streamSource||fileSource) || !(fileDest||socketDest))
+    return false;
+  /* a stream source buffers between idles anyway, so take everything it has
+   * in one go (for a socket this is usually a claimed flat string, so it's
+   * never copied) rather than a chunk at a time */
+  JsVar *buffer = streamSource ? jswrap_stream_read(source, 0)
+                               : jswrap_file_read(source, (int)chunkSize);
+  if (!buffer) return true; // undefined -> source is finished, close the pipe
+  JsVarInt bufferSize = (JsVarInt)jsvGetStringLength(buffer);
+  if (bufferSize>0) {
+    if (fileDest) {
+      jswrap_file_write(destination, buffer);
+    } else {
+      jswrap_net_socket_write(destination, buffer);
+      // socket writes just queue the data - wait for 'drain' before reading more
+      jsvObjectSetChildAndUnLock(pipe,"drainWait",jsvNewFromBool(true));
+    }
+    jsvSetInteger(position, jsvGetInteger(position) + bufferSize);
+  }
+  jsvUnLock(buffer);
+  *dataTransferred = true; // "" just means the source is waiting for more data
+  return true;
+}
+
+/** Service one pipe - move up to one chunk of data. Returns the number of
+ * bytes moved, or -1 if nothing happened (the pipe is stalled waiting for
+ * 'drain', or it just closed). The working chunk size adapts per-pipe: while
+ * the source keeps filling whole chunks it doubles (up to JSPIPE_CHUNK_MAX)
+ * so fast pipes aren't throttled, and it halves again when the destination
+ * pushes back - the configured chunkSize is the floor. */
+static JsVarInt handlePipe(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
   bool paused = jsvGetBoolAndUnLock(jsvObjectGetChild(pipe,"drainWait",0));
-  if (paused) return false;
+  if (paused) return -1;
 
   JsVar *position = jsvObjectGetChild(pipe,"position",0);
   JsVar *chunkSize = jsvObjectGetChild(pipe,"chunkSize",0);
@@ -110,24 +171,41 @@ static bool handlePipe(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
   JsVar *destination = jsvObjectGetChild(pipe,"destination",0);
 
   bool dataTransferred = false;
+  bool backpressure = false;
+  JsVarInt bytesMoved = 0;
+  JsVarInt baseChunk = jsvGetInteger(chunkSize);
+  JsVarInt curChunk = jsvGetIntegerAndUnLock(jsvObjectGetChild(pipe,"curChunk",0));
+  if (curChunk < baseChunk) curChunk = baseChunk; // not set yet -> start at the configured size
   if(source && destination && chunkSize && position) {
     JsVar *readFunc = jspGetNamedField(source, "read", false);
     JsVar *writeFunc = jspGetNamedField(destination, "write", false);
     if (jsvIsFunction(readFunc) && jsvIsFunction(writeFunc)) { // do the objects have the necessary methods on them?
-      JsVar *buffer = jspExecuteFunction(readFunc, source, 1, &chunkSize);
-      if(buffer) {
-        JsVarInt bufferSize = jsvGetLength(buffer);
-        if (bufferSize>0) {
-          JsVar *response = jspExecuteFunction(writeFunc, destination, 1, &buffer);
-          if (jsvIsBoolean(response) && jsvGetBool(response)==false) {
-            // If boolean false was returned, wait for drain event (http://nodejs.org/api/stream.html#stream_writable_write_chunk_encoding_callback)
-            jsvObjectSetChildAndUnLock(pipe,"drainWait",jsvNewFromBool(true));
+      JsVarInt posBefore = jsvGetInteger(position);
+      if (jsvIsNativeFunction(readFunc) && jsvIsNativeFunction(writeFunc) &&
+          handlePipeNative(pipe, source, destination, readFunc, writeFunc,
+                           curChunk, position, &dataTransferred)) {
+        // data was moved entirely in C - nothing to execute
+        bytesMoved = jsvGetInteger(position) - posBefore;
+      } else {
+        JsVar *readArg = jsvNewFromInteger(curChunk);
+        JsVar *buffer = jspExecuteFunction(readFunc, source, 1, &readArg);
+        jsvUnLock(readArg);
+        if(buffer) {
+          JsVarInt bufferSize = jsvGetLength(buffer);
+          if (bufferSize>0) {
+            JsVar *response = jspExecuteFunction(writeFunc, destination, 1, &buffer);
+            if (jsvIsBoolean(response) && jsvGetBool(response)==false) {
+              // If boolean false was returned, wait for drain event (http://nodejs.org/api/stream.html#stream_writable_write_chunk_encoding_callback)
+              jsvObjectSetChildAndUnLock(pipe,"drainWait",jsvNewFromBool(true));
+              backpressure = true;
+            }
+            jsvUnLock(response);
+            jsvSetInteger(position, jsvGetInteger(position) + bufferSize);
+            bytesMoved = bufferSize;
           }
-          jsvUnLock(response);
-          jsvSetInteger(position, jsvGetInteger(position) + bufferSize);
+          jsvUnLock(buffer);
+          dataTransferred = true; // so we don't close the pipe if we get an empty string
         }
-        jsvUnLock(buffer);
-        dataTransferred = true; // so we don't close the pipe if we get an empty string
       }
     } else {
       if(!jsvIsFunction(readFunc))
@@ -140,10 +218,21 @@ static bool handlePipe(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
 
   if(!dataTransferred) { // when no more chunks are possible, execute the callback
     handlePipeClose(arr, it, pipe);
+  } else {
+    JsVarInt newChunk = curChunk;
+    if (backpressure) {
+      newChunk = curChunk/2;
+      if (newChunk < baseChunk) newChunk = baseChunk;
+    } else if (bytesMoved >= curChunk && curChunk < JSPIPE_CHUNK_MAX) {
+      newChunk = curChunk*2;
+      if (newChunk > JSPIPE_CHUNK_MAX) newChunk = JSPIPE_CHUNK_MAX;
+    }
+    if (newChunk != curChunk)
+      jsvObjectSetChildAndUnLock(pipe,"curChunk",jsvNewFromInteger(newChunk));
   }
   jsvUnLock3(source, destination, chunkSize);
   jsvUnLock(position);
-  return dataTransferred;
+  return dataTransferred ? bytesMoved : -1;
 }
 
 /*JSON{
@@ -155,15 +244,29 @@ bool jswrap_pipe_idle() {
   bool wasBusy = false;
   JsVar *arr = pipeGetArray(false);
   if (arr) {
-    JsvObjectIterator it;
-    jsvObjectIteratorNew(&it, arr);
-    while (jsvObjectIteratorHasValue(&it)) {
-      JsVar *pipe = jsvObjectIteratorGetValue(&it);
-      wasBusy |= handlePipe(arr, &it, pipe);
-      jsvUnLock(pipe);
-      jsvObjectIteratorNext(&it);
+    /* Round-robin with a shared byte budget: every pipe gets one chunk per
+     * round, and we keep doing rounds while data is still moving. A fast
+     * pipe isn't capped at a single chunk per idle any more, but because
+     * the rounds interleave it can't starve a slower one either. */
+    JsVarInt budget = JSPIPE_IDLE_BUDGET;
+    bool moving = true;
+    while (moving && budget>0) {
+      moving = false;
+      JsvObjectIterator it;
+      jsvObjectIteratorNew(&it, arr);
+      while (jsvObjectIteratorHasValue(&it) && budget>0) {
+        JsVar *pipe = jsvObjectIteratorGetValue(&it);
+        JsVarInt moved = handlePipe(arr, &it, pipe);
+        if (moved>=0) wasBusy = true;
+        if (moved>0) {
+          budget -= moved;
+          moving = true;
+        }
+        jsvUnLock(pipe);
+        jsvObjectIteratorNext(&it);
+      }
+      jsvObjectIteratorFree(&it);
     }
-    jsvObjectIteratorFree(&it);
     jsvUnLock(arr);
   }
   return wasBusy;
@@ -245,7 +348,7 @@ static void jswrap_pipe_dst_close_listener(JsVar *destination) {
   "params" : [
     ["source","JsVar","The source file/stream that will send content."],
     ["destination","JsVar","The destination file/stream that will receive content from the source."],
-    ["options","JsVar",["An optional object `{ chunkSize : int=64, end : bool=true, complete : function }`","chunkSize : The amount of data to pipe from source to destination at a time","complete : a function to call when the pipe activity is complete","end : call the 'end' function on the destination when the source is finished"]]
+    ["options","JsVar",["An optional object `{ chunkSize : int=64, end : bool=true, complete : function }`","chunkSize : The initial amount of data to pipe from source to destination at a time (while the pipe keeps up this grows automatically, and it shrinks back to this on backpressure)","complete : a function to call when the pipe activity is complete","end : call the 'end' function on the destination when the source is finished"]]
   ]
 }*/
 void jswrap_pipe(JsVar* source, JsVar* dest, JsVar* options) {
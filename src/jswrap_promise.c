@@ -45,7 +45,11 @@ bool _jswrap_promise_is_promise(JsVar *promise) {
 }
 
 
-void _jswrap_promise_resolve_or_reject(JsVar *promise, JsVar *data, JsVar *fn) {
+/* Run the reaction(s) in 'fn' for a promise that just settled. A reaction is
+ * usually a function, but may also be another promise - meaning 'settle it
+ * the same way we just settled' (how chains onto a promise-returning handler
+ * are stored) - or an array of either. 'resolve' is which way we settled. */
+void _jswrap_promise_resolve_or_reject(JsVar *promise, JsVar *data, JsVar *fn, bool resolve) {
   JsVar *result = 0;
   if (jsvIsArray(fn)) {
     JsvObjectIterator it;
@@ -53,15 +57,23 @@ void _jswrap_promise_resolve_or_reject(JsVar *promise, JsVar *data, JsVar *fn) {
     bool first = true;
     while (jsvObjectIteratorHasValue(&it)) {
       JsVar *f = jsvObjectIteratorGetValue(&it);
-      JsVar *v = jspExecuteFunction(f, promise, 1, &data);
-      if (first) {
-        first = false;
-        result = v;
-      } else jsvUnLock(v);
+      if (_jswrap_promise_is_promise(f)) {
+        if (resolve) _jswrap_promise_queueresolve(f, data);
+        else _jswrap_promise_queuereject(f, data);
+      } else {
+        JsVar *v = jspExecuteFunction(f, promise, 1, &data);
+        if (first) {
+          first = false;
+          result = v;
+        } else jsvUnLock(v);
+      }
       jsvUnLock(f);
       jsvObjectIteratorNext(&it);
     }
     jsvObjectIteratorFree(&it);
+  } else if (_jswrap_promise_is_promise(fn)) {
+    if (resolve) _jswrap_promise_queueresolve(fn, data);
+    else _jswrap_promise_queuereject(fn, data);
   } else if (fn) {
     result = jspExecuteFunction(fn, promise, 1, &data);
   }
@@ -79,16 +91,11 @@ void _jswrap_promise_resolve_or_reject(JsVar *promise, JsVar *data, JsVar *fn) {
 
   if (chainedPromise) {
     if (_jswrap_promise_is_promise(result)) {
-      // if we were given a promise, loop its 'then' in here
-      JsVar *fnres = jsvNewNativeFunction((void (*)(void))_jswrap_promise_queueresolve, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_JSVAR<<JSWAT_BITS));
-      JsVar *fnrej = jsvNewNativeFunction((void (*)(void))_jswrap_promise_queuereject, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_JSVAR<<JSWAT_BITS));
-      if (fnres && fnrej) {
-        jsvObjectSetChild(fnres, JSPARSE_FUNCTION_THIS_NAME, chainedPromise);
-        jsvObjectSetChild(fnrej, JSPARSE_FUNCTION_THIS_NAME, chainedPromise);
-        _jswrap_promise_add(result, fnres, true);
-        _jswrap_promise_add(result, fnrej, false);
-      }
-      jsvUnLock2(fnres,fnrej);
+      /* the handler returned a promise - settle chainedPromise the same way
+       * when it settles. Storing the target promise itself as the reaction
+       * saves allocating two bound native functions per chain link */
+      _jswrap_promise_add(result, chainedPromise, true);
+      _jswrap_promise_add(result, chainedPromise, false);
     } else {
       _jswrap_promise_queueresolve(chainedPromise, result);
     }
@@ -104,7 +111,7 @@ void _jswrap_promise_resolve_or_reject_chain(JsVar *promise, JsVar *data, bool r
     while (chainedPromise) {
       fn = jsvObjectGetChild(chainedPromise, eventName, 0);
       if (fn) {
-        _jswrap_promise_resolve_or_reject(chainedPromise, data, fn);
+        _jswrap_promise_resolve_or_reject(chainedPromise, data, fn, resolve);
         jsvUnLock2(fn, chainedPromise);
         return;
       }
@@ -114,7 +121,7 @@ void _jswrap_promise_resolve_or_reject_chain(JsVar *promise, JsVar *data, bool r
     }
   }
   if (fn) {
-    _jswrap_promise_resolve_or_reject(promise, data, fn);
+    _jswrap_promise_resolve_or_reject(promise, data, fn, resolve);
     jsvUnLock(fn);
   } else {
     if (resolve)
@@ -124,26 +131,17 @@ void _jswrap_promise_resolve_or_reject_chain(JsVar *promise, JsVar *data, bool r
   }
 }
 
-void _jswrap_promise_resolve(JsVar *promise, JsVar *data) {
-  _jswrap_promise_resolve_or_reject_chain(promise, data, true);
-}
 void _jswrap_promise_queueresolve(JsVar *promise, JsVar *data) {
-  JsVar *fn = jsvNewNativeFunction((void (*)(void))_jswrap_promise_resolve, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_JSVAR<<JSWAT_BITS));
-  if (!fn) return;
-  jsvObjectSetChild(fn, JSPARSE_FUNCTION_THIS_NAME, promise);
-  jsiQueueEvents(promise, fn, &data, 1);
-  jsvUnLock(fn);
+  jsiQueuePromiseReaction(promise, data, true);
 }
 
-void _jswrap_promise_reject(JsVar *promise, JsVar *data) {
-  _jswrap_promise_resolve_or_reject_chain(promise, data, false);
-}
 void _jswrap_promise_queuereject(JsVar *promise, JsVar *data) {
-  JsVar *fn = jsvNewNativeFunction((void (*)(void))_jswrap_promise_reject, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_JSVAR<<JSWAT_BITS));
-  if (!fn) return;
-  jsvObjectSetChild(fn, JSPARSE_FUNCTION_THIS_NAME, promise);
-  jsiQueueEvents(promise, fn, &data, 1);
-  jsvUnLock(fn);
+  jsiQueuePromiseReaction(promise, data, false);
+}
+
+/// Run a queued settling - called by jsiExecuteMicrotasks when a reaction task comes up
+void jspromise_runReaction(JsVar *promise, JsVar *data, bool resolve) {
+  _jswrap_promise_resolve_or_reject_chain(promise, data, resolve);
 }
 
 void jswrap_promise_all_resolve(JsVar *promise, JsVarInt index, JsVar *data) {
@@ -331,7 +329,9 @@ JsVar *jswrap_promise_reject(JsVar *data) {
 }
 
 void _jswrap_promise_add(JsVar *parent, JsVar *callback, bool resolve) {
-  if (!jsvIsFunction(callback)) {
+  // a promise is allowed as a reaction - it gets settled the same way we do
+  // (see _jswrap_promise_resolve_or_reject)
+  if (!jsvIsFunction(callback) && !_jswrap_promise_is_promise(callback)) {
     jsExceptionHere(JSET_TYPEERROR, "Callback must be a function, got %t", callback);
     return;
   }
@@ -340,13 +340,15 @@ void _jswrap_promise_add(JsVar *parent, JsVar *callback, bool resolve) {
     // Check to see if promise has already been resolved
     /* Note: we use jsvFindChildFromString not ObjectGetChild so we get the name.
      * If we didn't then we wouldn't know if it was resolved, but with undefined */
-    JsVar *resolved = jsvFindChildFromString(parent, JS_PROMISE_RESOLVED_NAME, 0);
-    if (resolved) {
-      resolved = jsvSkipNameAndUnLock(resolved);
-      // If so, queue a resolve event
-      jsiQueueEvents(0, callback, &resolved, 1);
-      jsvUnLock(resolved);
-      return;
+    JsVar *resolvedName = jsvFindChildFromString(parent, JS_PROMISE_RESOLVED_NAME, 0);
+    if (resolvedName) {
+      JsVar *resolved = jsvSkipName(resolvedName);
+      /* Already resolved - store the callback as normal but re-queue the
+       * resolution, so the callback (and anything chained off this promise)
+       * runs via the microtask queue just as if we'd still been pending */
+      jsvRemoveChild(parent, resolvedName);
+      _jswrap_promise_queueresolve(parent, resolved);
+      jsvUnLock2(resolved, resolvedName);
     }
   }
 
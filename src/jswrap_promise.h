@@ -20,6 +20,8 @@ JsVar *jspromise_create();
 void jspromise_resolve(JsVar *promise, JsVar *data);
 /// Reject the given promise
 void jspromise_reject(JsVar *promise, JsVar *data);
+/// Run a queued resolve/reject - called by jsiExecuteMicrotasks for tasks queued with jsiQueuePromiseReaction
+void jspromise_runReaction(JsVar *promise, JsVar *data, bool resolve);
 
 JsVar *jswrap_promise_constructor(JsVar *executor);
 JsVar *jswrap_promise_all(JsVar *arr);
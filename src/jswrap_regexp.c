@@ -27,15 +27,203 @@
 
 #define MAX_GROUPS 9
 
+/* Patterns are compiled once into a compact program (cached in a hidden
+ * child of the RegExp) so matching doesn't have to re-parse the pattern
+ * text at every input position. The program is:
+ *
+ *   [flags] [star count] op... RXOP_MATCH
+ *
+ * Character sets and escapes like \d all compile down to a 256 bit set,
+ * so testing a char at match time is a single bit lookup. */
+#define RXPROG_NAME JS_HIDDEN_CHAR_STR"prg"
+#define RXPROG_SRC_NAME JS_HIDDEN_CHAR_STR"prgSrc"
+#define RXPROG_HEADER 2
+#define RXPROG_ANCHORED 1 ///< flags bit - the pattern began with '^'
+
+#define RXOP_MATCH       0 ///< end of the pattern - we matched
+#define RXOP_CHAR        1 ///< one literal character (1 byte operand)
+#define RXOP_ANY         2 ///< '.'
+#define RXOP_CLASS       3 ///< 256 bit set of matching chars (32 byte operand)
+#define RXOP_GROUP_START 4
+#define RXOP_GROUP_END   5
+#define RXOP_EOL         6 ///< '$' at the end of the pattern
+#define RXOP_STAR        7 ///< greedy repeat of the char op after it (1 byte star index operand first)
+
+#define RXCLASS_BYTES 32
+
 typedef struct {
   JsVar *sourceStr;
   size_t startIndex;
   int groups;
   size_t groupStart[MAX_GROUPS];
   size_t groupEnd[MAX_GROUPS];
+  unsigned char *memo; ///< failed (star, position) pairs, so backtracking doesn't retry them. May be 0
+  size_t memoRowBytes; ///< bytes per star in memo
 } matchInfo;
 
-JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info);
+static void rxClassSet(unsigned char *bitmap, unsigned char ch) {
+  bitmap[ch>>3] |= (unsigned char)(1<<(ch&7));
+}
+static bool rxClassGet(const unsigned char *bitmap, unsigned char ch) {
+  return (bitmap[ch>>3]>>(ch&7))&1;
+}
+
+/** Compile one char/escape/set from the pattern, ORing every character it
+ * can match into bitmap and advancing *rp. Returns false on error (with an
+ * exception thrown) */
+static bool rxCompileSetBits(const char **rp, unsigned char *bitmap) {
+  const char *r = *rp;
+  int i;
+  if (r[0]=='[') { // Character set (any char inside '[]')
+    r++;
+    bool inverted = *r=='^';
+    if (inverted) r++;
+    unsigned char sub[RXCLASS_BYTES];
+    memset(sub, 0, sizeof(sub));
+    while (*r && *r!=']')
+      if (!rxCompileSetBits(&r, sub)) return false;
+    if (*r!=']') {
+      jsExceptionHere(JSET_ERROR, "Unfinished character set in RegEx");
+      return false;
+    }
+    r++;
+    for (i=0;i<RXCLASS_BYTES;i++)
+      bitmap[i] |= inverted ? (unsigned char)~sub[i] : sub[i];
+    *rp = r;
+    return true;
+  }
+  if (r[0]=='.') { // '.' matches anything
+    memset(bitmap, 0xFF, RXCLASS_BYTES);
+    *rp = r+1;
+    return true;
+  }
+  if (r[0]=='\\') { // escape character
+    char c;
+    switch (r[1]) {
+    case '\\': c='\\'; break;
+    case '/': c='/'; break;
+    case 'f': c=0x0C; break;
+    case 'n': c=0x0A; break;
+    case 'r': c=0x0D; break;
+    case 't': c=0x09; break;
+    case 'v': c=0x0B; break;
+    case '0': c=0x00; break;
+    case 'd': case 'D': case 's': case 'S': case 'w': case 'W':
+      for (i=0;i<256;i++) {
+        char ch = (char)i;
+        bool m = false;
+        switch (r[1]) {
+        case 'd': m = isNumeric(ch); break;
+        case 'D': m = !isNumeric(ch); break;
+        case 's': m = isWhitespace(ch); break;
+        case 'S': m = !isWhitespace(ch); break;
+        case 'w': m = isNumeric(ch) || isAlpha(ch) || ch=='_'; break;
+        case 'W': m = !(isNumeric(ch) || isAlpha(ch) || ch=='_'); break;
+        }
+        if (m) rxClassSet(bitmap, (unsigned char)i);
+      }
+      *rp = r+2;
+      return true;
+    case 'x':
+      if (r[2] && r[3]) {
+        rxClassSet(bitmap, (unsigned char)((chtod(r[2])<<4) | chtod(r[3])));
+        *rp = r+4;
+        return true;
+      }
+      // not enough digits - report it like any other bad escape
+      jsExceptionHere(JSET_ERROR, "Unknown escape character %d in RegEx", (int)r[1]);
+      return false;
+    default:
+      jsExceptionHere(JSET_ERROR, "Unknown escape character %d in RegEx", (int)r[1]);
+      return false;
+    }
+    rxClassSet(bitmap, (unsigned char)c);
+    *rp = r+2;
+    return true;
+  }
+  rxClassSet(bitmap, (unsigned char)r[0]);
+  *rp = r+1;
+  return true;
+}
+
+/// Compile a single character matcher to an op. Returns the op length, or 0 on error
+static size_t rxCompileOp(const char **rp, unsigned char *op) {
+  const char *r = *rp;
+  if (r[0]=='.') { op[0]=RXOP_ANY; *rp=r+1; return 1; }
+  if (r[0]!='[' && r[0]!='\\') { op[0]=RXOP_CHAR; op[1]=(unsigned char)r[0]; *rp=r+1; return 2; }
+  // sets and escapes all compile down to a 256 bit set
+  op[0] = RXOP_CLASS;
+  memset(&op[1], 0, RXCLASS_BYTES);
+  if (!rxCompileSetBits(rp, &op[1])) return 0;
+  // a simple escape like \n only sets one bit - store it as a plain char
+  int bit = -1, i;
+  for (i=0;i<256;i++)
+    if (rxClassGet(&op[1], (unsigned char)i)) {
+      if (bit>=0) { bit=-1; break; }
+      bit = i;
+    }
+  if (bit>=0) { op[0]=RXOP_CHAR; op[1]=(unsigned char)bit; return 2; }
+  return 1+RXCLASS_BYTES;
+}
+
+/// Compile a pattern to a program string. Returns 0 (with an exception thrown) on error
+static JsVar *rxCompile(JsVar *source) {
+  size_t regexLen = jsvGetStringLength(source);
+  // worst case: every pattern char is an escape with a star (33+2 bytes)
+  size_t progMax = RXPROG_HEADER + 35*(regexLen+1) + 1;
+  if (jsuGetFreeStack() < 256 + regexLen+1 + progMax) {
+    jsExceptionHere(JSET_ERROR, "Insufficient stack to compile RegExp");
+    return 0;
+  }
+  char *regexPtr = (char *)alloca(regexLen+1);
+  unsigned char *prog = (unsigned char *)alloca(progMax);
+  jsvGetString(source, regexPtr, regexLen+1);
+  const char *r = regexPtr;
+  int starCount = 0;
+  prog[0] = 0;
+  if (*r=='^') {
+    prog[0] |= RXPROG_ANCHORED;
+    r++;
+  }
+  size_t len = RXPROG_HEADER;
+  while (*r) {
+    if (*r=='(') { prog[len++]=RXOP_GROUP_START; r++; continue; }
+    if (*r==')') { prog[len++]=RXOP_GROUP_END; r++; continue; }
+    if (*r=='$' && !r[1]) { prog[len++]=RXOP_EOL; r++; continue; }
+    unsigned char op[1+RXCLASS_BYTES];
+    size_t opLen = rxCompileOp(&r, op);
+    if (!opLen) return 0;
+    if (*r=='*' || *r=='+') { // in this engine '+' has always matched like '*'
+      r++;
+      prog[len++] = RXOP_STAR;
+      prog[len++] = (unsigned char)((starCount<255) ? starCount : 255);
+      if (starCount<255) starCount++;
+    }
+    memcpy(&prog[len], op, opLen);
+    len += opLen;
+  }
+  prog[len++] = RXOP_MATCH;
+  prog[1] = (unsigned char)starCount;
+  return jsvNewStringOfLength((unsigned int)len, (char *)prog);
+}
+
+/// Get the compiled program for this RegExp, compiling and caching it if needed
+static JsVar *rxGetProgram(JsVar *parent, JsVar *source) {
+  JsVar *prog = jsvObjectGetChild(parent, RXPROG_NAME, 0);
+  JsVar *progSrc = jsvObjectGetChild(parent, RXPROG_SRC_NAME, 0);
+  bool cached = jsvIsString(prog) && progSrc==source; // same var = 'source' hasn't been swapped out
+  jsvUnLock(progSrc);
+  if (cached) return prog;
+  jsvUnLock(prog);
+  prog = rxCompile(source);
+  if (prog) {
+    jsvObjectSetChild(parent, RXPROG_NAME, prog);
+    jsvObjectSetChild(parent, RXPROG_SRC_NAME, source);
+  }
+  return prog;
+}
+
+static JsVar *rxMatchHere(const unsigned char *prog, JsvStringIterator *txtIt, matchInfo info);
 
 JsVar *matchfound(JsvStringIterator *txtIt, matchInfo info) {
   JsVar *rmatch = jsvNewEmptyArray();
@@ -55,116 +243,68 @@ JsVar *matchfound(JsvStringIterator *txtIt, matchInfo info) {
   return rmatch;
 }
 
-/* match: search for regexp anywhere in text */
-JsVar *match(char *regexp, JsVar *str, size_t startIndex) {
-  matchInfo info;
-  info.sourceStr = str;
-  info.startIndex = startIndex;
-  info.groups = 0;
-
-  JsvStringIterator txtIt;
-  jsvStringIteratorNew(&txtIt, str, startIndex);
-  if (regexp[0] == '^')
-    return matchhere(regexp+1, &txtIt, info);
-  /* must look even if string is empty */
-  JsVar *rmatch = matchhere(regexp, &txtIt, info);
-  while (!rmatch && jsvStringIteratorHasChar(&txtIt)) {
-    jsvStringIteratorNext(&txtIt);
-    info.startIndex++;
-    JsvStringIterator txtIt2 = jsvStringIteratorClone(&txtIt);
-    rmatch = matchhere(regexp, &txtIt2, info);
-    jsvStringIteratorFree(&txtIt2);
-  }
-  jsvStringIteratorFree(&txtIt);
-  return rmatch;
+/// Does this char op match the given character?
+static bool rxMatchChar(const unsigned char *op, char ch) {
+  if (op[0]==RXOP_CHAR) return op[1]==(unsigned char)ch;
+  if (op[0]==RXOP_ANY) return true;
+  assert(op[0]==RXOP_CLASS);
+  return rxClassGet(&op[1], (unsigned char)ch);
 }
 
-bool matchcharacter(char *regexp, JsvStringIterator *txtIt, int *length) {
-  *length = 1;
-  char ch = jsvStringIteratorGetChar(txtIt);
-  if (regexp[0]=='.') return true;
-  if (regexp[0]=='[') { // Character set (any char inside '[]')
-    bool inverted = regexp[1]=='^';
-    if (inverted) (*length)++;
-    bool matchAny = false;
-    while (regexp[*length] && regexp[*length]!=']') {
-      int matchLen;
-      matchAny |= matchcharacter(&regexp[*length], txtIt, &matchLen);
-      (*length) += matchLen;
-    }
-    if (regexp[*length]==']') {
-      (*length)++;
-    } else {
-      jsExceptionHere(JSET_ERROR, "Unfinished character set in RegEx");
-      return false;
-    }
-    return matchAny != inverted;
-  }
-  if (regexp[0]=='\\') { // escape character
-    *length = 2;
-    // missing quite a few here
-    // https://developer.mozilla.org/en-US/docs/Web/JavaScript/Guide/Regular_Expressions
-    if (regexp[1]=='\\') return ch=='\\';
-    if (regexp[1]=='/') return ch=='/';
-    if (regexp[1]=='d') return isNumeric(ch);
-    if (regexp[1]=='D') return !isNumeric(ch);
-    if (regexp[1]=='f') return ch==0x0C;
-    if (regexp[1]=='n') return ch==0x0A;
-    if (regexp[1]=='r') return ch==0x0D;
-    if (regexp[1]=='s') return isWhitespace(ch);
-    if (regexp[1]=='S') return !isWhitespace(ch);
-    if (regexp[1]=='t') return ch==0x09;
-    if (regexp[1]=='v') return ch==0x0B;
-    if (regexp[1]=='w') return isNumeric(ch) || isAlpha(ch) || ch=='_';
-    if (regexp[1]=='W') return !(isNumeric(ch) || isAlpha(ch) || ch=='_');
-    if (regexp[1]=='0') return ch==0x00;
-    if (regexp[1]=='x' && regexp[2] && regexp[3]) {
-      *length = 4;
-      char code = (char)((chtod(regexp[2])<<4) | chtod(regexp[3]));
-      return ch==code;
-    }
-    jsExceptionHere(JSET_ERROR, "Unknown escape character %d in RegEx", (int)regexp[1]);
-    return false;
-  }
-  return regexp[0]==ch;
+static size_t rxOpLength(const unsigned char *op) {
+  if (op[0]==RXOP_CHAR) return 2;
+  if (op[0]==RXOP_CLASS) return 1+RXCLASS_BYTES;
+  return 1; // RXOP_ANY
 }
 
-/* matchhere: search for regexp at beginning of text */
-JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info) {
+/* rxMatchHere: run the program against text at the iterator's position */
+static JsVar *rxMatchHere(const unsigned char *prog, JsvStringIterator *txtIt, matchInfo info) {
   if (jspIsInterrupted()) return 0;
-  if (regexp[0] == '\0')
+  if (prog[0] == RXOP_MATCH)
     return matchfound(txtIt, info);
-  if (regexp[0] == '(') {
-    info.groupStart[info.groups] = jsvStringIteratorGetIndex(txtIt);
-    info.groupEnd[info.groups] = info.groupStart[info.groups];
-    if (info.groups<MAX_GROUPS) info.groups++;
-    return matchhere(regexp+1, txtIt, info);
+  if (prog[0] == RXOP_GROUP_START) {
+    if (info.groups<MAX_GROUPS) {
+      info.groupStart[info.groups] = jsvStringIteratorGetIndex(txtIt);
+      info.groupEnd[info.groups] = info.groupStart[info.groups];
+      info.groups++;
+    }
+    return rxMatchHere(prog+1, txtIt, info);
   }
-  if (regexp[0] == ')') {
-    info.groupEnd[info.groups-1] = jsvStringIteratorGetIndex(txtIt);
-    return matchhere(regexp+1, txtIt, info);
+  if (prog[0] == RXOP_GROUP_END) {
+    if (info.groups>0)
+      info.groupEnd[info.groups-1] = jsvStringIteratorGetIndex(txtIt);
+    return rxMatchHere(prog+1, txtIt, info);
   }
-  int charLength;
-  bool charMatched = matchcharacter(regexp, txtIt, &charLength);
-  if (regexp[charLength] == '*' || regexp[charLength] == '+') {
-    bool starOperator = regexp[charLength] == '*';
-    char *regexpAfterStar = regexp+charLength+1;
-    JsvStringIterator txtIt2;
+  if (prog[0] == RXOP_EOL) { // End of regex
+    if (!jsvStringIteratorHasChar(txtIt))
+      return matchfound(txtIt, info);
+    else
+      return 0;
+  }
+  if (prog[0] == RXOP_STAR) {
+    const unsigned char *charOp = prog+2;
+    const unsigned char *progAfterStar = charOp + rxOpLength(charOp);
+    // if we already know matching from here fails, don't try again
+    unsigned char *memoBit = 0;
+    size_t memoPos = 0;
+    if (info.memo && prog[1]<255) {
+      memoPos = jsvStringIteratorGetIndex(txtIt);
+      memoBit = &info.memo[prog[1]*info.memoRowBytes + (memoPos>>3)];
+      if ((*memoBit>>(memoPos&7))&1) return 0;
+    }
+    bool charMatched = rxMatchChar(charOp, jsvStringIteratorGetChar(txtIt));
     // Try and match everything after right now
-    txtIt2 = jsvStringIteratorClone(txtIt);
-    JsVar *lastrmatch = matchhere(regexpAfterStar, &txtIt2, info);
+    JsvStringIterator txtIt2 = jsvStringIteratorClone(txtIt);
+    JsVar *lastrmatch = rxMatchHere(progAfterStar, &txtIt2, info);
     jsvStringIteratorFree(&txtIt2);
-    // For star - nothing matched - so push straight through with whatever we had
-    if (starOperator && !charMatched)
-      return lastrmatch;
     // Otherwise try and match more than one
     while (jsvStringIteratorHasChar(txtIt) && charMatched) {
       // We had this character matched, so move on and see if we can match with the new one
       jsvStringIteratorNext(txtIt);
-      charMatched = matchcharacter(regexp, txtIt, &charLength);
+      charMatched = rxMatchChar(charOp, jsvStringIteratorGetChar(txtIt));
       // See if we can match after the character...
       txtIt2 = jsvStringIteratorClone(txtIt);
-      JsVar *rmatch = matchhere(regexpAfterStar, &txtIt2, info);
+      JsVar *rmatch = rxMatchHere(progAfterStar, &txtIt2, info);
       jsvStringIteratorFree(&txtIt2);
       // can't match with this - use the last one
       if (rmatch) {
@@ -172,23 +312,60 @@ JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info) {
         lastrmatch = rmatch;
       }
     }
+    if (!lastrmatch && memoBit)
+      *memoBit |= (unsigned char)(1<<(memoPos&7));
     return lastrmatch;
   }
-  // End of regex
-  if (regexp[0] == '$' && regexp[1] == '\0') {
-    if (!jsvStringIteratorHasChar(txtIt))
-      return matchfound(txtIt, info);
-    else
-      return 0;
-  }
-  //
-  if (jsvStringIteratorHasChar(txtIt) && charMatched) {
+  // a single character op
+  if (jsvStringIteratorHasChar(txtIt) && rxMatchChar(prog, jsvStringIteratorGetChar(txtIt))) {
     jsvStringIteratorNext(txtIt);
-    return matchhere(regexp+charLength, txtIt, info);
+    return rxMatchHere(prog+rxOpLength(prog), txtIt, info);
   }
   return 0;
 }
 
+/* rxMatch: search for the compiled pattern anywhere in text */
+static JsVar *rxMatch(const unsigned char *prog, JsVar *str, size_t startIndex, unsigned char *memo, size_t memoRowBytes) {
+  matchInfo info;
+  info.sourceStr = str;
+  info.startIndex = startIndex;
+  info.groups = 0;
+  info.memo = memo;
+  info.memoRowBytes = memoRowBytes;
+  const unsigned char *ops = prog+RXPROG_HEADER;
+
+  /* If the pattern starts with a definite character match (group starts
+   * don't consume input), the scan below can reject most start positions
+   * with one char test instead of a full match attempt */
+  const unsigned char *firstOp = ops;
+  while (*firstOp==RXOP_GROUP_START) firstOp++;
+  if (*firstOp!=RXOP_CHAR && *firstOp!=RXOP_CLASS) firstOp = 0;
+
+  JsvStringIterator txtIt;
+  jsvStringIteratorNew(&txtIt, str, startIndex);
+  JsVar *rmatch;
+  if (prog[0] & RXPROG_ANCHORED) {
+    rmatch = rxMatchHere(ops, &txtIt, info);
+  } else {
+    /* must look even if string is empty */
+    JsvStringIterator txtIt2 = jsvStringIteratorClone(&txtIt);
+    rmatch = rxMatchHere(ops, &txtIt2, info);
+    jsvStringIteratorFree(&txtIt2);
+    while (!rmatch && jsvStringIteratorHasChar(&txtIt)) {
+      jsvStringIteratorNext(&txtIt);
+      info.startIndex++;
+      if (firstOp && jsvStringIteratorHasChar(&txtIt) &&
+          !rxMatchChar(firstOp, jsvStringIteratorGetChar(&txtIt)))
+        continue;
+      txtIt2 = jsvStringIteratorClone(&txtIt);
+      rmatch = rxMatchHere(ops, &txtIt2, info);
+      jsvStringIteratorFree(&txtIt2);
+    }
+  }
+  jsvStringIteratorFree(&txtIt);
+  return rmatch;
+}
+
 /*JSON{
   "type" : "class",
   "ifndef" : "SAVE_ON_FLASH",
@@ -222,6 +399,14 @@ JsVar *jswrap_regexp_constructor(JsVar *str, JsVar *flags) {
   }
   JsVar *r = jspNewObject(0,"RegExp");
   jsvObjectSetChild(r, "source", str);
+  // compile now - a bad pattern throws here rather than on first use
+  JsVar *prog = rxCompile(str);
+  if (!prog) {
+    jsvUnLock(r);
+    return 0;
+  }
+  jsvObjectSetChildAndUnLock(r, RXPROG_NAME, prog);
+  jsvObjectSetChild(r, RXPROG_SRC_NAME, str);
   if (!jsvIsUndefined(flags)) {
     if (!jsvIsString(flags))
       jsExceptionHere(JSET_TYPEERROR, "Expecting String as first argument, got %t", str);
@@ -274,15 +459,28 @@ JsVar *jswrap_regexp_exec(JsVar *parent, JsVar *str) {
     jsvUnLock(regex);
     return 0;
   }
-  size_t regexLen = jsvGetStringLength(regex);
-  char *regexPtr = (char *)alloca(regexLen+1);
-  if (!regexPtr) {
-    jsvUnLock(regex);
+  JsVar *prog = rxGetProgram(parent, regex);
+  jsvUnLock(regex);
+  if (!prog) return 0;
+  size_t progLen = jsvGetStringLength(prog);
+  if (jsuGetFreeStack() < 256 + progLen) {
+    jsvUnLock(prog);
+    jsExceptionHere(JSET_ERROR, "Insufficient stack to run RegExp");
     return 0;
   }
-  jsvGetString(regex, regexPtr, regexLen+1);
-  jsvUnLock(regex);
-  JsVar *rmatch = match(regexPtr, str, (size_t)lastIndex);
+  unsigned char *progPtr = (unsigned char *)alloca(progLen);
+  jsvGetStringChars(prog, 0, (char *)progPtr, progLen);
+  jsvUnLock(prog);
+  // memoize failed backtracks if the table isn't too much stack
+  size_t memoRowBytes = (jsvGetStringLength(str)+8)>>3;
+  size_t stars = progPtr[1];
+  unsigned char *memo = 0;
+  if (stars && stars<255 && memoRowBytes*stars<=4096 &&
+      jsuGetFreeStack() >= 256 + memoRowBytes*stars) {
+    memo = (unsigned char *)alloca(memoRowBytes*stars);
+    memset(memo, 0, memoRowBytes*stars);
+  }
+  JsVar *rmatch = rxMatch(progPtr, str, (size_t)lastIndex, memo, memoRowBytes);
   if (!rmatch) {
     rmatch = jsvNewWithFlags(JSV_NULL);
     lastIndex = 0;
@@ -0,0 +1,246 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript RingBuffer - fixed-size circular byte buffer for
+ * continuous capture without repeated reallocation/copying
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_ringbuffer.h"
+#include "jswrap_arraybuffer.h"
+#include "jsvar.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+#ifndef SAVE_ON_FLASH
+
+/*JSON{
+  "type" : "class",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "RingBuffer"
+}
+A fixed-size circular byte buffer. Data pushed in is appended after the
+newest byte, data shifted out comes from the oldest - with no
+reallocation or copying of the backing store, unlike growing an Array
+or ArrayBuffer. Use it for continuous capture:
+
+```
+var buf = new RingBuffer(1024);
+buf.push([1,2,3]);        // returns 3 (bytes stored)
+buf.push("data");         // strings, arrays and typed arrays all work
+var oldest = buf.shift(); // 1
+var batch = buf.shift(4); // Uint8Array [2,3,100,97]
+```
+ */
+
+/// Internal state of a RingBuffer, unpacked from its child vars
+typedef struct {
+  unsigned char *data; ///< backing bytes (flat string)
+  size_t capacity;
+  size_t head;  ///< index of the oldest byte
+  size_t count; ///< number of bytes stored
+} RingBufferState;
+
+/// Read a RingBuffer's state. Returns the locked data var, or 0 (with an exception) if it isn't valid
+static JsVar *ringBufferGetState(JsVar *parent, RingBufferState *s) {
+  JsVar *data = jsvObjectGetChild(parent, "data", 0);
+  if (jsvIsFlatString(data)) {
+    s->data = (unsigned char *)jsvGetFlatStringPointer(data);
+    s->capacity = jsvGetStringLength(data);
+    s->head = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "head", 0));
+    s->count = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, "count", 0));
+    if (s->head < s->capacity && s->count <= s->capacity)
+      return data;
+  }
+  jsvUnLock(data);
+  jsExceptionHere(JSET_ERROR, "Not a valid RingBuffer object");
+  return 0;
+}
+
+static void ringBufferSetState(JsVar *parent, RingBufferState *s) {
+  jsvObjectSetChildAndUnLock(parent, "head", jsvNewFromInteger((JsVarInt)s->head));
+  jsvObjectSetChildAndUnLock(parent, "count", jsvNewFromInteger((JsVarInt)s->count));
+}
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "RingBuffer",
+  "name" : "RingBuffer",
+  "generate" : "jswrap_ringbuffer_constructor",
+  "params" : [
+    ["size","int","The number of bytes the buffer should hold"]
+  ],
+  "return" : ["JsVar","A new RingBuffer"]
+}
+Create a ring buffer holding up to `size` bytes. The backing store is
+allocated once, as a single flat block.
+ */
+JsVar *jswrap_ringbuffer_constructor(JsVarInt size) {
+  if (size<1 || size>65535) {
+    jsExceptionHere(JSET_ERROR, "Invalid RingBuffer size %d", (int)size);
+    return 0;
+  }
+  JsVar *data = jsvNewFlatStringOfLength((unsigned int)size);
+  if (!data) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory for RingBuffer");
+    return 0;
+  }
+  JsVar *ringBuffer = jspNewObject(0, "RingBuffer");
+  if (ringBuffer) {
+    jsvObjectSetChild(ringBuffer, "data", data);
+    jsvObjectSetChildAndUnLock(ringBuffer, "head", jsvNewFromInteger(0));
+    jsvObjectSetChildAndUnLock(ringBuffer, "count", jsvNewFromInteger(0));
+  }
+  jsvUnLock(data);
+  return ringBuffer;
+}
+
+typedef struct {
+  RingBufferState *s;
+  size_t stored;
+} RingBufferPushData;
+
+static void ringBufferPushCb(int ch, void *cbData) {
+  RingBufferPushData *p = (RingBufferPushData*)cbData;
+  RingBufferState *s = p->s;
+  if (s->count >= s->capacity) return; // full - drop the rest
+  s->data[(s->head + s->count) % s->capacity] = (unsigned char)ch;
+  s->count++;
+  p->stored++;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "RingBuffer",
+  "name" : "push",
+  "generate" : "jswrap_ringbuffer_push",
+  "params" : [
+    ["data","JsVar","A number, String, Array or ArrayBuffer of bytes to append"]
+  ],
+  "return" : ["int","The number of bytes actually stored"]
+}
+Append data after the newest byte in the buffer. If there isn't room
+for everything, as much as fits is stored and the rest is dropped - the
+return value says how much was taken.
+ */
+JsVarInt jswrap_ringbuffer_push(JsVar *parent, JsVar *data) {
+  RingBufferState s;
+  JsVar *dataVar = ringBufferGetState(parent, &s);
+  if (!dataVar) return 0;
+  RingBufferPushData p;
+  p.s = &s;
+  p.stored = 0;
+  jsvIterateCallback(data, ringBufferPushCb, &p);
+  jsvUnLock(dataVar);
+  ringBufferSetState(parent, &s);
+  return (JsVarInt)p.stored;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "RingBuffer",
+  "name" : "shift",
+  "generate" : "jswrap_ringbuffer_shift",
+  "params" : [
+    ["count","JsVar","[optional] How many bytes to remove - if not supplied, a single byte is returned as a number"]
+  ],
+  "return" : ["JsVar","The oldest byte (or undefined if empty), or a Uint8Array of up to `count` bytes"]
+}
+Remove and return the oldest data in the buffer. `shift()` returns one
+byte as a number, `shift(n)` returns a Uint8Array of up to `n` bytes
+(fewer if the buffer doesn't contain that many).
+ */
+JsVar *jswrap_ringbuffer_shift(JsVar *parent, JsVar *countVar) {
+  RingBufferState s;
+  JsVar *dataVar = ringBufferGetState(parent, &s);
+  if (!dataVar) return 0;
+  JsVar *result = 0;
+  if (jsvIsUndefined(countVar)) {
+    if (s.count) {
+      result = jsvNewFromInteger(s.data[s.head]);
+      s.head = (s.head+1) % s.capacity;
+      s.count--;
+    }
+  } else {
+    JsVarInt n = jsvGetInteger(countVar);
+    if (n<0) n=0;
+    if ((size_t)n > s.count) n = (JsVarInt)s.count;
+    result = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, n);
+    if (result) {
+      JsvArrayBufferIterator it;
+      jsvArrayBufferIteratorNew(&it, result, 0);
+      while (n--) {
+        jsvArrayBufferIteratorSetByteValue(&it, (char)s.data[s.head]);
+        jsvArrayBufferIteratorNext(&it);
+        s.head = (s.head+1) % s.capacity;
+        s.count--;
+      }
+      jsvArrayBufferIteratorFree(&it);
+    }
+  }
+  jsvUnLock(dataVar);
+  ringBufferSetState(parent, &s);
+  return result;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "RingBuffer",
+  "name" : "clear",
+  "generate" : "jswrap_ringbuffer_clear"
+}
+Remove all data from the buffer (the backing store is kept allocated)
+ */
+void jswrap_ringbuffer_clear(JsVar *parent) {
+  RingBufferState s;
+  JsVar *dataVar = ringBufferGetState(parent, &s);
+  if (!dataVar) return;
+  jsvUnLock(dataVar);
+  s.head = 0;
+  s.count = 0;
+  ringBufferSetState(parent, &s);
+}
+
+/*JSON{
+  "type" : "property",
+  "class" : "RingBuffer",
+  "name" : "length",
+  "generate" : "jswrap_ringbuffer_length",
+  "return" : ["int","The number of bytes currently stored"]
+}
+The number of bytes currently in the buffer
+ */
+JsVarInt jswrap_ringbuffer_length(JsVar *parent) {
+  RingBufferState s;
+  JsVar *dataVar = ringBufferGetState(parent, &s);
+  if (!dataVar) return 0;
+  jsvUnLock(dataVar);
+  return (JsVarInt)s.count;
+}
+
+/*JSON{
+  "type" : "property",
+  "class" : "RingBuffer",
+  "name" : "free",
+  "generate" : "jswrap_ringbuffer_free",
+  "return" : ["int","The number of bytes that can be pushed before data is dropped"]
+}
+The amount of free space in the buffer, in bytes
+ */
+JsVarInt jswrap_ringbuffer_free(JsVar *parent) {
+  RingBufferState s;
+  JsVar *dataVar = ringBufferGetState(parent, &s);
+  if (!dataVar) return 0;
+  jsvUnLock(dataVar);
+  return (JsVarInt)(s.capacity - s.count);
+}
+
+#endif // SAVE_ON_FLASH
@@ -0,0 +1,24 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript RingBuffer - fixed-size circular byte buffer for
+ * continuous capture without repeated reallocation/copying
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_ringbuffer_constructor(JsVarInt size);
+JsVarInt jswrap_ringbuffer_push(JsVar *parent, JsVar *data);
+JsVar *jswrap_ringbuffer_shift(JsVar *parent, JsVar *countVar);
+void jswrap_ringbuffer_clear(JsVar *parent);
+JsVarInt jswrap_ringbuffer_length(JsVar *parent);
+JsVarInt jswrap_ringbuffer_free(JsVar *parent);
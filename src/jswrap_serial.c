@@ -16,6 +16,9 @@
 #include "jswrap_serial.h"
 #include "jsdevices.h"
 #include "jsinteractive.h"
+#ifndef SAVE_ON_FLASH
+#include "jswrap_promise.h" // Serial.flush promises
+#endif
 
 /*JSON{
   "type" : "class",
@@ -207,6 +210,8 @@ Setup this Serial port with the given baud rate and options.
                                     // (default none) Parity bit
   stopbits:1,                       // (default 1) Number of stop bits to use
   flow:null/undefined/'none'/'xon', // (default none) software flow control
+  flowStop:48,                      // (default depends on board) IO buffer level (in events) at which incoming flow is paused
+  flowStart:24,                     // (default depends on board) IO buffer level at which it is resumed
   path:null/undefined/string        // Linux Only - the path to the Serial device to use
   errors:false                      // (default false) whether to forward framing/parity errors
 }
@@ -227,6 +232,10 @@ port as well - until you set them to something else using `digitalWrite` or
 Flow control can be xOn/xOff (`flow:'xon'`) or hardware flow control
 (receive only) if `cts` is specified. If `cts` is set to a pin, the
 pin's value will be 0 when Espruino is ready for data and 1 when it isn't.
+Both are driven by how full the shared IO buffer is: past `flowStop`
+events the host is asked to stop, and below `flowStart` it may carry on.
+When the buffer passes `flowStop`, `E.emit('ioFull')` fires (once per
+fill-up) so your code can shed load before data is actually lost.
 
 By default, framing or parity errors don't create `framing` or `parity` events
 on the `Serial` object because storing these errors uses up additional
@@ -250,6 +259,7 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
   JsVar *parity = 0;
   JsVar *flow = 0;
   JsVar *path = 0;
+  JsVarInt flowStop = -1, flowStart = -1;
   jsvConfigObject configs[] = {
       {"rx", JSV_PIN, &inf.pinRX},
       {"tx", JSV_PIN, &inf.pinTX},
@@ -260,6 +270,8 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
       {"path", JSV_STRING_0, &path},
       {"parity", JSV_OBJECT /* a variable */, &parity},
       {"flow", JSV_OBJECT /* a variable */, &flow},
+      {"flowStop", JSV_INTEGER, &flowStop},
+      {"flowStart", JSV_INTEGER, &flowStart},
       {"errors", JSV_BOOLEAN, &inf.errorHandling},
   };
 
@@ -301,6 +313,22 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
       }
     }
 
+#ifndef SAVE_ON_FLASH
+    if (ok && (flowStop>=0 || flowStart>=0)) {
+      /* The watermarks belong to the shared IO buffer, so setting them here
+       * affects every device using flow control */
+      if (flowStop<0) flowStop = jshIOBufferXOff;
+      if (flowStart<0) flowStart = jshIOBufferXOn;
+      if (flowStart<flowStop && flowStop<=IOBUFFERMASK) {
+        jshIOBufferXOff = (int)flowStop;
+        jshIOBufferXOn = (int)flowStart;
+      } else {
+        jsExceptionHere(JSET_ERROR, "Invalid flow control watermarks");
+        ok = false;
+      }
+    }
+#endif
+
 #ifdef LINUX
     if (ok && jsvIsString(path))
       jsvObjectSetChildAndUnLock(parent, "path", path);
@@ -324,22 +352,62 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
 }
 
 
+/* Buffers bytes coming out of jsvIterateCallback so the device sees whole
+ * runs via jshTransmitChars - for loopback that means a message becomes a
+ * few coalesced input events instead of one per byte */
+typedef struct {
+  IOEventFlags device;
+  unsigned int len;
+  unsigned char buf[64];
+} JsSerialWriteState;
+
 static void _jswrap_serial_print_cb(int data, void *userData) {
-  IOEventFlags device = *(IOEventFlags*)userData;
-  jshTransmit(device, (unsigned char)data);
+  JsSerialWriteState *s = (JsSerialWriteState*)userData;
+  s->buf[s->len++] = (unsigned char)data;
+  if (s->len >= sizeof(s->buf)) {
+    jshTransmitChars(s->device, s->buf, s->len);
+    s->len = 0;
+  }
 }
 void _jswrap_serial_print(JsVar *parent, JsVar *arg, bool isPrint, bool newLine) {
   NOT_USED(parent);
   IOEventFlags device = jsiGetDeviceFromClass(parent);
   if (!DEVICE_IS_USART(device)) return;
+  JsSerialWriteState state;
+  state.device = device;
+  state.len = 0;
 
   if (isPrint) arg = jsvAsString(arg, false);
-  jsvIterateCallback(arg, _jswrap_serial_print_cb, (void*)&device);
+#ifndef SAVE_ON_FLASH
+  /* Big flat strings - or typed arrays viewing one - get queued for
+   * transmission in place (locked until the last byte has gone) rather
+   * than being copied out a byte at a time */
+  JsVar *flat = 0; // the flat string actually holding the bytes
+  size_t flatOffset = 0, flatLen = 0;
+  if (jsvIsFlatString(arg)) {
+    flat = jsvLockAgain(arg);
+    flatLen = jsvGetStringLength(arg);
+  } else if (jsvIsArrayBuffer(arg) &&
+             JSV_ARRAYBUFFER_GET_SIZE(arg->varData.arraybuffer.type)==1) {
+    // 1 byte per element, so the view's bytes are exactly what we'd iterate
+    JsVar *backing = jsvGetArrayBufferBackingString(arg);
+    if (jsvIsFlatString(backing)) {
+      flat = backing;
+      flatOffset = arg->varData.arraybuffer.byteOffset;
+      flatLen = arg->varData.arraybuffer.length;
+    } else jsvUnLock(backing);
+  }
+  bool sent = flat && jshTransmitFlatString(device, flat, flatOffset, flatLen);
+  jsvUnLock(flat);
+  if (!sent)
+#endif
+  jsvIterateCallback(arg, _jswrap_serial_print_cb, (void*)&state);
   if (isPrint) jsvUnLock(arg);
   if (newLine) {
-    _jswrap_serial_print_cb((unsigned char)'\r', (void*)&device);
-    _jswrap_serial_print_cb((unsigned char)'\n', (void*)&device);
+    _jswrap_serial_print_cb((unsigned char)'\r', (void*)&state);
+    _jswrap_serial_print_cb((unsigned char)'\n', (void*)&state);
   }
+  if (state.len) jshTransmitChars(device, state.buf, state.len);
 }
 
 /*JSON{
@@ -388,9 +456,75 @@ Write a character or array of data to the serial port
 This method writes unmodified data, eg `Serial.write([1,2,3])` is equivalent to `Serial.write("\1\2\3")`. If you'd like data converted to a string first, use `Serial.print`.
  */
 void jswrap_serial_write(JsVar *parent, JsVar *args) {
-  _jswrap_serial_print(parent, args, false, false);
+  // a single argument is unwrapped, so one big flat string can go zero-copy
+  JsVar *arg = (jsvGetArrayLength(args)==1) ? jsvGetArrayItem(args, 0) : 0;
+  _jswrap_serial_print(parent, arg ? arg : args, false, false);
+  jsvUnLock(arg);
+}
+
+#ifndef SAVE_ON_FLASH
+#define JS_SERIAL_FLUSH_NAME JS_HIDDEN_CHAR_STR"flush"
+/// How many Serial objects have an unresolved flush promise (so idle can skip the scan)
+static int serialFlushesPending = 0;
+
+/*JSON{
+  "type" : "method",
+  "class" : "Serial",
+  "name" : "flush",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_serial_flush",
+  "return" : ["JsVar","A Promise that resolves when all data queued for this device has been sent"]
+}
+Return a Promise that resolves once everything queued for transmission on
+this port (including zero-copy writes of flat strings and typed arrays) has
+actually been sent - so you can await the drain of a large transfer instead
+of polling.
+ */
+JsVar *jswrap_serial_flush(JsVar *parent) {
+  IOEventFlags device = jsiGetDeviceFromClass(parent);
+  if (!DEVICE_IS_USART(device)) return 0;
+  JsVar *promise = jsvObjectGetChild(parent, JS_SERIAL_FLUSH_NAME, 0);
+  if (promise) return promise; // already waiting - share the same promise
+  promise = jspromise_create();
+  if (!promise) return 0;
+  if (!jshHasTransmitDataFor(device)) {
+    jspromise_resolve(promise, 0); // nothing queued - resolve at next idle
+  } else {
+    jsvObjectSetChild(parent, JS_SERIAL_FLUSH_NAME, promise);
+    serialFlushesPending++;
+  }
+  return promise;
 }
 
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_serial_idle",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+bool jswrap_serial_idle() {
+  if (!serialFlushesPending) return false;
+  int stillPending = 0;
+  IOEventFlags device;
+  for (device=EV_SERIAL_START;device<=EV_SERIAL_MAX;device++) {
+    JsVar *obj = jshGetDeviceObject(device);
+    if (!obj) continue;
+    JsVar *promise = jsvObjectGetChild(obj, JS_SERIAL_FLUSH_NAME, 0);
+    if (promise) {
+      if (jshHasTransmitDataFor(device)) {
+        stillPending++;
+      } else {
+        jsvObjectRemoveChild(obj, JS_SERIAL_FLUSH_NAME);
+        jspromise_resolve(promise, 0);
+      }
+    }
+    jsvUnLock2(promise, obj);
+  }
+  // recount rather than decrement - promises vanish wholesale on reset/load
+  serialFlushesPending = stillPending;
+  return false;
+}
+#endif
+
 /*JSON{
   "type" : "method",
   "class" : "Serial",
@@ -18,4 +18,6 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options);
 void jswrap_serial_print(JsVar *parent, JsVar *str);
 void jswrap_serial_println(JsVar *parent, JsVar *str);
 void jswrap_serial_write(JsVar *parent, JsVar *data);
+JsVar *jswrap_serial_flush(JsVar *parent);
+bool jswrap_serial_idle();
 void jswrap_serial_onData(JsVar *parent, JsVar *funcVar);
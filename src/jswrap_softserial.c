@@ -0,0 +1,377 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript Software Serial - a timer-driven UART on any GPIO pin.
+ *
+ * Transmit runs off the utility timer (one UET_EXECUTE task per instance,
+ * ticking at the bit rate), so several instances can run at once. Receive
+ * decodes the timestamped edge events that the setWatch machinery already
+ * queues from the EXTI interrupt - no per-bit interrupts, and no JS code
+ * runs per edge.
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_softserial.h"
+#include "jswrap_io.h" // setWatch/clearWatch
+#include "jsvar.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+#include "jsinteractive.h"
+#include "jstimer.h"
+#include "jswrapper.h"
+
+#ifndef SAVE_ON_FLASH
+
+#define JSI_SOFTSERIAL_NAME JS_HIDDEN_CHAR_STR"sws"
+
+#define SOFTSERIAL_COUNT 2 ///< simultaneous instances
+#define SOFTSERIAL_TX_BUFFER_SIZE 64 ///< must be a power of 2
+#define SOFTSERIAL_RX_BUFFER_SIZE 32 ///< must be a power of 2
+
+typedef struct {
+  bool inUse;
+  Pin txPin, rxPin;
+  unsigned int bitTime; ///< system time units per bit (for the utility timer)
+  JsVarFloat bitTimeSec; ///< seconds per bit (for decoding edge timestamps)
+  // Transmit - ring filled by `write`, drained one bit at a time in the timer IRQ
+  volatile unsigned char txBuffer[SOFTSERIAL_TX_BUFFER_SIZE];
+  volatile unsigned char txHead, txTail;
+  volatile unsigned short txFrame; ///< bits left of the current frame, LSB next
+  volatile unsigned char txFrameBits;
+  bool txRunning; ///< is a utility timer task scheduled?
+  // Receive - decoded at idle time from setWatch's timestamped edge events
+  JsVarFloat rxFrameStart; ///< time of the start bit's falling edge
+  unsigned char rxBitIdx;
+  unsigned char rxData;
+  bool rxFrameActive;
+  unsigned char rxBuffer[SOFTSERIAL_RX_BUFFER_SIZE];
+  unsigned char rxHead, rxTail;
+} SoftSerialState;
+
+static SoftSerialState softSerialStates[SOFTSERIAL_COUNT];
+
+/*JSON{
+  "type" : "class",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "SoftSerial"
+}
+A software serial port (UART) on any GPIO pins, for when you've run out of
+hardware USARTs. Transmit is clocked off the utility timer and receive is
+decoded from timestamped pin change events, so both work without running
+JavaScript for every bit (or even every byte).
+
+Baud rates up to 9600 are reliable; two instances can run at once.
+ */
+
+static SoftSerialState *softserial_getState(JsVar *parent) {
+  JsVar *idxVar = jsvObjectGetChild(parent, "idx", 0);
+  if (!idxVar) return 0;
+  int idx = (int)jsvGetIntegerAndUnLock(idxVar);
+  if (idx<0 || idx>=SOFTSERIAL_COUNT || !softSerialStates[idx].inUse)
+    return 0;
+  return &softSerialStates[idx];
+}
+
+/// Bit clock for transmit - called from the utility timer IRQ
+static void softserial_txTimerFn(JsSysTime time, void *userdata) {
+  NOT_USED(time);
+  SoftSerialState *s = (SoftSerialState*)userdata;
+  if (!s->txFrameBits) {
+    if (s->txTail == s->txHead) return; // nothing to send - line stays idle until we're stopped
+    // frame = start bit (0), 8 data bits LSB first, stop bit (1)
+    s->txFrame = (unsigned short)(0x200 | (s->txBuffer[s->txTail] << 1));
+    s->txTail = (unsigned char)((s->txTail+1) & (SOFTSERIAL_TX_BUFFER_SIZE-1));
+    s->txFrameBits = 10;
+  }
+  jshPinSetValue(s->txPin, s->txFrame & 1);
+  s->txFrame >>= 1;
+  s->txFrameBits--;
+}
+
+/// Store a received byte (main loop only - idle will emit a 'data' event)
+static void softserial_rxPush(SoftSerialState *s, unsigned char data) {
+  unsigned char nextHead = (unsigned char)((s->rxHead+1) & (SOFTSERIAL_RX_BUFFER_SIZE-1));
+  if (nextHead == s->rxTail) return; // overflow - drop
+  s->rxBuffer[s->rxHead] = data;
+  s->rxHead = nextHead;
+}
+
+/** Feed the decoder with a line level change. The line was at !state from the
+ * last edge up until 'time', so every data bit sampling point we've passed
+ * gets that level. Sampling points are at frameStart + (1.5+bit)*bitTime. */
+static void softserial_rxEdge(SoftSerialState *s, JsVarFloat time, bool state) {
+  if (s->rxFrameActive) {
+    while (s->rxBitIdx<8 && s->rxFrameStart + (1.5+s->rxBitIdx)*s->bitTimeSec <= time) {
+      if (!state) s->rxData = (unsigned char)(s->rxData | (1<<s->rxBitIdx));
+      s->rxBitIdx++;
+    }
+    if (s->rxBitIdx>=8) { // all data bits seen - stop bit is just idle line
+      softserial_rxPush(s, s->rxData);
+      s->rxFrameActive = false;
+    }
+  }
+  if (!s->rxFrameActive && !state) { // falling edge when idle -> start bit
+    s->rxFrameActive = true;
+    s->rxFrameStart = time;
+    s->rxBitIdx = 0;
+    s->rxData = 0;
+  }
+}
+
+/// Native callback given to setWatch - `data` is the watch's {time,state,pin} object
+static void softserial_rxCallback(JsVar *data) {
+  if (!jsvIsObject(data)) return;
+  Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(data, "pin", 0));
+  int i;
+  for (i=0;i<SOFTSERIAL_COUNT;i++) {
+    SoftSerialState *s = &softSerialStates[i];
+    if (s->inUse && s->rxPin == pin) {
+      JsVarFloat time = jsvGetFloatAndUnLock(jsvObjectGetChild(data, "time", 0));
+      bool state = jsvGetBoolAndUnLock(jsvObjectGetChild(data, "state", 0));
+      softserial_rxEdge(s, time, state);
+      return;
+    }
+  }
+}
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_softserial_idle",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+bool jswrap_softserial_idle() {
+  JsVar *list = jsvObjectGetChild(execInfo.hiddenRoot, JSI_SOFTSERIAL_NAME, 0);
+  if (!list) return false;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, list);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *serial = jsvObjectIteratorGetValue(&it);
+    SoftSerialState *s = softserial_getState(serial);
+    if (s) {
+      // if a frame ended with the line idle there's no final edge - flush it by time
+      if (s->rxFrameActive &&
+          jshGetMillisecondsFromTime(jshGetSystemTime())/1000.0 > s->rxFrameStart + 10*s->bitTimeSec) {
+        bool level = jshPinGetValue(s->rxPin);
+        while (s->rxBitIdx<8) {
+          if (level) s->rxData = (unsigned char)(s->rxData | (1<<s->rxBitIdx));
+          s->rxBitIdx++;
+        }
+        softserial_rxPush(s, s->rxData);
+        s->rxFrameActive = false;
+      }
+      // emit received data
+      if (s->rxHead != s->rxTail) {
+        JsVar *str = jsvNewFromEmptyString();
+        if (str) {
+          while (s->rxHead != s->rxTail) {
+            char ch = (char)s->rxBuffer[s->rxTail];
+            s->rxTail = (unsigned char)((s->rxTail+1) & (SOFTSERIAL_RX_BUFFER_SIZE-1));
+            jsvAppendStringBuf(str, &ch, 1);
+          }
+          jsiQueueObjectCallbacks(serial, JS_EVENT_PREFIX"data", &str, 1);
+          jsvUnLock(str);
+        }
+      }
+      // stop the transmit bit clock once everything has been shifted out
+      if (s->txRunning && !s->txFrameBits && s->txTail==s->txHead) {
+        jstStopExecuteFn(softserial_txTimerFn, s);
+        s->txRunning = false;
+      }
+    }
+    jsvUnLock(serial);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(list);
+  return false;
+}
+
+/*JSON{
+  "type" : "kill",
+  "generate" : "jswrap_softserial_kill",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+void jswrap_softserial_kill() {
+  int i;
+  for (i=0;i<SOFTSERIAL_COUNT;i++) {
+    SoftSerialState *s = &softSerialStates[i];
+    if (s->inUse && s->txRunning)
+      jstStopExecuteFn(softserial_txTimerFn, s);
+    s->inUse = false;
+  }
+  jsvObjectRemoveChild(execInfo.hiddenRoot, JSI_SOFTSERIAL_NAME);
+}
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "SoftSerial",
+  "name" : "SoftSerial",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_softserial_constructor",
+  "params" : [
+    ["options","JsVar","An object `{rx:pin, tx:pin, baud:int}`. At least one of `rx`/`tx` must be given, `baud` defaults to 9600"]
+  ],
+  "return" : ["JsVar","A SoftSerial object"]
+}
+Create a software serial port, eg:
+
+```
+var s = new SoftSerial({rx:B3, tx:B4, baud:9600});
+s.on('data', function(d) { print("Got "+JSON.stringify(d)); });
+s.write("Hello");
+```
+
+Received data is emitted as a 'data' event, just like a hardware Serial port.
+ */
+JsVar *jswrap_softserial_constructor(JsVar *options) {
+  if (!jsvIsObject(options)) {
+    jsExceptionHere(JSET_ERROR, "Expecting options to be an Object, not %t", options);
+    return 0;
+  }
+  Pin rxPin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(options, "rx", 0));
+  Pin txPin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(options, "tx", 0));
+  JsVarInt baud = jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "baud", 0));
+  if (baud<=0) baud = 9600;
+  if (!jshIsPinValid(rxPin) && !jshIsPinValid(txPin)) {
+    jsExceptionHere(JSET_ERROR, "Need at least one of rx/tx to be a valid pin");
+    return 0;
+  }
+  // find a free instance
+  int idx;
+  for (idx=0;idx<SOFTSERIAL_COUNT;idx++)
+    if (!softSerialStates[idx].inUse) break;
+  if (idx>=SOFTSERIAL_COUNT) {
+    jsExceptionHere(JSET_ERROR, "All software serial ports are in use");
+    return 0;
+  }
+  JsVar *serial = jspNewObject(0, "SoftSerial");
+  if (!serial) return 0;
+
+  SoftSerialState *s = &softSerialStates[idx];
+  memset(s, 0, sizeof(SoftSerialState));
+  s->inUse = true;
+  s->rxPin = rxPin;
+  s->txPin = txPin;
+  s->bitTime = (unsigned int)jshGetTimeFromMilliseconds(1000.0/(JsVarFloat)baud);
+  s->bitTimeSec = 1.0/(JsVarFloat)baud;
+
+  jsvObjectSetChildAndUnLock(serial, "idx", jsvNewFromInteger(idx));
+  jsvObjectSetChildAndUnLock(serial, "baud", jsvNewFromInteger(baud));
+  if (jshIsPinValid(txPin)) {
+    jsvObjectSetChildAndUnLock(serial, "tx", jsvNewFromPin(txPin));
+    jshPinOutput(txPin, 1); // idle level
+  }
+  if (jshIsPinValid(rxPin)) {
+    jsvObjectSetChildAndUnLock(serial, "rx", jsvNewFromPin(rxPin));
+    // watch edges with a native callback - no JS is executed per edge
+    JsVar *watchFn = jsvNewNativeFunction((void (*)(void))softserial_rxCallback, JSWAT_VOID|(JSWAT_JSVAR<<JSWAT_BITS));
+    JsVar *watchOpts = jsvNewObject();
+    if (watchFn && watchOpts) {
+      jsvObjectSetChildAndUnLock(watchOpts, "repeat", jsvNewFromBool(true));
+      JsVar *watchId = jswrap_interface_setWatch(watchFn, rxPin, watchOpts);
+      if (watchId)
+        jsvObjectSetChildAndUnLock(serial, "watch", watchId);
+    }
+    jsvUnLock2(watchFn, watchOpts);
+  }
+  // Add to our list of active ports so idle/kill can find us
+  JsVar *list = jsvObjectGetChild(execInfo.hiddenRoot, JSI_SOFTSERIAL_NAME, JSV_ARRAY);
+  if (list) {
+    jsvArrayPush(list, serial);
+    jsvUnLock(list);
+  }
+  return serial;
+}
+
+static void softserial_writeCb(int item, void *callbackData) {
+  SoftSerialState *s = (SoftSerialState*)callbackData;
+  unsigned char nextHead = (unsigned char)((s->txHead+1) & (SOFTSERIAL_TX_BUFFER_SIZE-1));
+  if (nextHead == s->txTail) {
+    // wait for the timer IRQ to drain a byte
+    while (nextHead == s->txTail && jstUtilTimerIsRunning()) {};
+    if (nextHead == s->txTail) return; // timer not running - drop rather than deadlock
+  }
+  s->txBuffer[s->txHead] = (unsigned char)item;
+  s->txHead = nextHead;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "SoftSerial",
+  "name" : "write",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_softserial_write",
+  "params" : [
+    ["data","JsVar","A byte, a string, or an array of bytes to send"]
+  ]
+}
+Queue data to be sent out of the software serial port. Transmission happens
+from the utility timer interrupt, so this returns immediately.
+ */
+void jswrap_softserial_write(JsVar *parent, JsVar *data) {
+  SoftSerialState *s = softserial_getState(parent);
+  if (!s) {
+    jsExceptionHere(JSET_ERROR, "SoftSerial port is closed");
+    return;
+  }
+  if (!jshIsPinValid(s->txPin)) {
+    jsExceptionHere(JSET_ERROR, "No tx pin defined");
+    return;
+  }
+  // start the bit clock first so the buffer drains even if we fill it below
+  if (!s->txRunning) {
+    if (!jstExecuteFn(softserial_txTimerFn, s, jshGetSystemTime()+s->bitTime, s->bitTime)) {
+      jsExceptionHere(JSET_ERROR, "Unable to schedule a timer");
+      return;
+    }
+    s->txRunning = true;
+  }
+  jsvIterateCallback(data, softserial_writeCb, s);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "SoftSerial",
+  "name" : "close",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_softserial_close"
+}
+Close the software serial port, freeing up its pins and its utility timer slot
+for use by another instance.
+ */
+void jswrap_softserial_close(JsVar *parent) {
+  SoftSerialState *s = softserial_getState(parent);
+  if (!s) {
+    jsExceptionHere(JSET_ERROR, "SoftSerial port is closed");
+    return;
+  }
+  if (s->txRunning)
+    jstStopExecuteFn(softserial_txTimerFn, s);
+  JsVar *watchId = jsvObjectGetChild(parent, "watch", 0);
+  if (watchId) {
+    jswrap_interface_clearWatch(watchId);
+    jsvUnLock(watchId);
+    jsvObjectRemoveChild(parent, "watch");
+  }
+  s->inUse = false;
+  jsvObjectRemoveChild(parent, "idx");
+  // remove from the active list
+  JsVar *list = jsvObjectGetChild(execInfo.hiddenRoot, JSI_SOFTSERIAL_NAME, 0);
+  if (list) {
+    JsVar *idx = jsvGetIndexOf(list, parent, true);
+    if (idx) {
+      jsvRemoveChild(list, idx);
+      jsvUnLock(idx);
+    }
+    jsvUnLock(list);
+  }
+}
+#endif
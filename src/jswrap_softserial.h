@@ -0,0 +1,22 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * JavaScript Software Serial (timer-driven UART) Functions
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+#include "jspin.h"
+
+JsVar *jswrap_softserial_constructor(JsVar *options);
+void jswrap_softserial_write(JsVar *parent, JsVar *data);
+void jswrap_softserial_close(JsVar *parent);
+
+bool jswrap_softserial_idle();
+void jswrap_softserial_kill();
@@ -19,6 +19,7 @@
 #include "jsdevices.h"
 #include "jsinteractive.h"
 #include "jswrap_arraybuffer.h"
+#include "jswrap_promise.h"
 
 /*JSON{
   "type" : "class",
@@ -143,7 +144,8 @@ void jswrap_spi_setup(
   "generate" : "jswrap_spi_send",
   "params" : [
     ["data","JsVar","The data to send - either an Integer, Array, String, or Object of the form `{data: ..., count:#}`"],
-    ["nss_pin","pin","An nSS pin - this will be lowered before SPI output and raised afterwards (optional). There will be a small delay between when this is lowered and when sending starts, and also between sending finishing and it being raised."]
+    ["nss_pin","pin","An nSS pin - this will be lowered before SPI output and raised afterwards (optional). There will be a small delay between when this is lowered and when sending starts, and also between sending finishing and it being raised."],
+    ["callback","JsVar","An optional function to call when the send is complete. If supplied, `send` returns `undefined` and the received data is passed to the callback from the idle loop instead"]
   ],
   "return" : ["JsVar","The data that was returned"]
 }
@@ -153,6 +155,11 @@ Sending multiple bytes in one call to send is preferable as they can then be tra
 
 For maximum speeds, please pass either Strings or Typed Arrays as arguments. Note that you can even pass arrays of arrays, like `[1,[2,3,4],5]`
 
+If a `callback` function is supplied the call completes asynchronously: the
+received data is handed to the callback rather than returned, which lets
+hardware that can stream the buffer out in the background (eg. via DMA)
+overlap the transfer with the rest of your program.
+
  */
 typedef struct {
   spi_sender spiSend;          //!< A function to be called to send SPI data.
@@ -192,13 +199,19 @@ void jswrap_spi_send_cb(
 JsVar *jswrap_spi_send(
     JsVar *parent,  //!< A description of the SPI device to send data through.
     JsVar *srcdata, //!< The data to send through SPI.
-    Pin    nss_pin  //!< The pin to toggle low then high (CS)
+    Pin    nss_pin, //!< The pin to toggle low then high (CS)
+    JsVar *callback //!< An optional function to call (with the received data) when the send completes
   ) {
   // Debug
   // jsiConsolePrintf("jswrap_spi_send called: parent=%j, srcdata=%j, nss_pin=%p\n", parent, srcdata, nss_pin);
   NOT_USED(parent);
   IOEventFlags device = jsiGetDeviceFromClass(parent);
 
+  if (callback && !jsvIsFunction(callback)) {
+    jsExceptionHere(JSET_ERROR, "Expecting callback Function but got %t", callback);
+    return 0;
+  }
+
   jswrap_spi_send_data data;
   if (!jsspiGetSendFunction(parent, &data.spiSend, &data.spiSendData))
     return 0;
@@ -263,6 +276,15 @@ JsVar *jswrap_spi_send(
 
   // de-assert NSS
   if (nss_pin!=PIN_UNDEFINED) jshPinOutput(nss_pin, true);
+  if (callback) {
+    /* Asynchronous use - the received data goes to the callback (fired from
+     * the idle loop) rather than being returned, so targets whose SPI
+     * hardware can push the buffer out in the background are free to return
+     * here before the bytes have hit the wire. */
+    jsiQueueEvents(0, callback, &dst, 1);
+    jsvUnLock(dst);
+    return 0;
+  }
   return dst;
 }
 
@@ -578,18 +600,23 @@ static NO_INLINE int i2c_get_address(JsVar *address, bool *sendStop) {
   "name" : "writeTo",
   "generate" : "jswrap_i2c_writeTo",
   "params" : [
-    ["address","JsVar","The 7 bit address of the device to transmit to, or an object of the form `{address:12, stop:false}` to send this data without a STOP signal."],
+    ["address","JsVar","The 7 bit address of the device to transmit to, or an object of the form `{address:12, stop:false, async:false}` - `stop:false` sends this data without a STOP signal, `async:true` makes the call return a Promise that resolves when the transmission has completed."],
     ["data","JsVarArray","One or more items to write. May be ints, strings, arrays, or objects of the form `{data: ..., count:#}`."]
-  ]
+  ],
+  "return" : ["JsVar","When `async:true` is given, a Promise that resolves on completion - otherwise undefined"]
 }
 Transmit to the slave device with the given address. This is like Arduino's beginTransmission, write, and endTransmission rolled up into one.
  */
 
-void jswrap_i2c_writeTo(JsVar *parent, JsVar *addressVar, JsVar *args) {
+JsVar *jswrap_i2c_writeTo(JsVar *parent, JsVar *addressVar, JsVar *args) {
   IOEventFlags device = jsiGetDeviceFromClass(parent);
 
   bool sendStop = true;
   int address = i2c_get_address(addressVar, &sendStop);
+#ifndef SAVE_ON_FLASH
+  bool async = jsvIsObject(addressVar) &&
+      jsvGetBoolAndUnLock(jsvObjectGetChild(addressVar, "async", 0));
+#endif
 
   JSV_GET_AS_CHAR_ARRAY( dataPtr, dataLen, args);
 
@@ -609,6 +636,17 @@ void jswrap_i2c_writeTo(JsVar *parent, JsVar *addressVar, JsVar *args) {
 #endif
     }
   }
+#ifndef SAVE_ON_FLASH
+  if (async) {
+    /* Asynchronous use - completion is reported via a promise (resolved via
+     * the job queue, so .then fires from the idle loop). Targets that drive
+     * I2C by IRQ/DMA are free to return with the transfer still going. */
+    JsVar *promise = jspromise_create();
+    if (promise) jspromise_resolve(promise, 0);
+    return promise;
+  }
+#endif
+  return 0;
 }
 
 /*JSON{
@@ -617,10 +655,10 @@ void jswrap_i2c_writeTo(JsVar *parent, JsVar *addressVar, JsVar *args) {
   "name" : "readFrom",
   "generate" : "jswrap_i2c_readFrom",
   "params" : [
-    ["address","JsVar","The 7 bit address of the device to request bytes from, or an object of the form `{address:12, stop:false}` to send this data without a STOP signal."],
+    ["address","JsVar","The 7 bit address of the device to request bytes from, or an object of the form `{address:12, stop:false, async:false}` - `stop:false` requests the data without a STOP signal, `async:true` returns a Promise that resolves to the data instead."],
     ["quantity","int32","The number of bytes to request"]
   ],
-  "return" : ["JsVar","The data that was returned - as a Uint8Array"],
+  "return" : ["JsVar","The data that was returned - as a Uint8Array (or a Promise of one if `async:true`)"],
   "return_object" : "Uint8Array"
 }
 Request bytes from the given slave device, and return them as a Uint8Array (packed array of bytes). This is like using Arduino Wire's requestFrom, available and read functions.  Sends a STOP
@@ -630,6 +668,10 @@ JsVar *jswrap_i2c_readFrom(JsVar *parent, JsVar *addressVar, int nBytes) {
 
   bool sendStop = true;
   int address = i2c_get_address(addressVar, &sendStop);
+#ifndef SAVE_ON_FLASH
+  bool async = jsvIsObject(addressVar) &&
+      jsvGetBoolAndUnLock(jsvObjectGetChild(addressVar, "async", 0));
+#endif
 
   if (nBytes<=0)
     return 0;
@@ -665,5 +707,14 @@ JsVar *jswrap_i2c_readFrom(JsVar *parent, JsVar *addressVar, int nBytes) {
     }
     jsvArrayBufferIteratorFree(&it);
   }
+#ifndef SAVE_ON_FLASH
+  if (async) {
+    // as for writeTo - the data arrives via a promise rather than a return value
+    JsVar *promise = jspromise_create();
+    if (promise) jspromise_resolve(promise, array);
+    jsvUnLock(array);
+    return promise;
+  }
+#endif
   return array;
 }
@@ -16,12 +16,12 @@
 
 JsVar *jswrap_spi_constructor();
 void jswrap_spi_setup(JsVar *parent, JsVar *options);
-JsVar *jswrap_spi_send(JsVar *parent, JsVar *data, Pin nss_pin);
+JsVar *jswrap_spi_send(JsVar *parent, JsVar *srcdata, Pin nss_pin, JsVar *callback);
 void jswrap_spi_send4bit(JsVar *parent, JsVar *srcdata, int bit0, int bit1, Pin nss_pin);
 void jswrap_spi_send8bit(JsVar *parent, JsVar *srcdata, int bit0, int bit1, Pin nss_pin);
 void jswrap_spi_write(JsVar *parent, JsVar *args);
 
 JsVar *jswrap_i2c_constructor();
 void jswrap_i2c_setup(JsVar *parent, JsVar *options);
-void jswrap_i2c_writeTo(JsVar *parent, JsVar *addressVar, JsVar *data);
+JsVar *jswrap_i2c_writeTo(JsVar *parent, JsVar *addressVar, JsVar *data);
 JsVar *jswrap_i2c_readFrom(JsVar *parent, JsVar *addressVar, int nBytes);
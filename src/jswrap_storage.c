@@ -0,0 +1,516 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Log-structured key-value store in flash memory
+ *
+ * The store lives in STORAGE_PAGES pages taken from the start of the first
+ * big enough area returned by jshFlashGetFree(). One page is 'active' and
+ * holds an append-only log of records; the others are kept erased. Writing
+ * a key just appends a record (a few word writes, no page erase), and the
+ * latest record for a key wins. When the active page fills up, the live
+ * records are copied to the next page and the old one is erased - so page
+ * erases are amortised over a whole page worth of writes and the erase load
+ * rotates over all the pages.
+ *
+ * Record layout (everything 4-byte aligned):
+ *   +0  keyLen  (1 byte - 0xFF here means erased flash, ie. end of log)
+ *   +1  flags   (1 byte - bits are cleared to 0, see STORAGE_FLAG_*)
+ *   +2  dataLen (2 bytes)
+ *   +4  key bytes, immediately followed by data bytes, padded to a word
+ *
+ * The header word is written before the data with STORAGE_FLAG_WRITTEN
+ * still set, and rewritten with it cleared once all the data is in flash,
+ * so a record interrupted by a reset is skipped rather than read back as
+ * truncated data. Each page starts with a magic word and a sequence
+ * number; the sequence number is written last during compaction, so an
+ * interrupted compaction leaves the old page intact.
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_storage.h"
+#include "jshardware.h"
+#include "jsvariterator.h"
+#include "jsinteractive.h"
+
+#ifndef SAVE_ON_FLASH
+
+#define STORAGE_PAGES 2
+#define STORAGE_MAGIC 0x4C564B53UL
+#define STORAGE_MAX_KEY_LEN 24
+
+// flag bits - a bit is CLEARED (to 0) when set, as flash erases to 1s
+#define STORAGE_FLAG_WRITTEN   1 ///< cleared once the whole record is in flash
+#define STORAGE_FLAG_TOMBSTONE 2 ///< cleared if this record deletes the key
+
+#define STORAGE_PAD4(x) (((x)+3U)&(uint32_t)~3U)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq; ///< incremented on each compaction - the highest valid page is active
+} StoragePageHeader;
+
+typedef struct {
+  unsigned char keyLen;
+  unsigned char flags;
+  unsigned short dataLen;
+} StorageRecordHeader;
+
+static bool storageMounted;
+static uint32_t storagePage[STORAGE_PAGES]; ///< page start addresses
+static uint32_t storagePageSize;
+static int storageActive;    ///< index into storagePage of the page holding the log
+static uint32_t storageAppend; ///< address in the active page where the next record goes
+static uint32_t storageSeq;
+
+static uint32_t storageRecordSize(StorageRecordHeader *hdr) {
+  return 4 + STORAGE_PAD4((uint32_t)hdr->keyLen + hdr->dataLen);
+}
+
+/** Read the record header at addr and check it makes sense. Returns false at
+ * the end of the log - either erased flash or anything unparseable. */
+static bool storageReadRecord(uint32_t addr, uint32_t pageEnd, StorageRecordHeader *hdr) {
+  if (addr+4 > pageEnd) return false;
+  jshFlashRead(hdr, addr, sizeof(StorageRecordHeader));
+  if (hdr->keyLen==0 || hdr->keyLen>STORAGE_MAX_KEY_LEN) return false;
+  if (addr+storageRecordSize(hdr) > pageEnd) return false;
+  return true;
+}
+
+/// Does the record at addr (not a tombstone check!) match the given key?
+static bool storageRecordMatches(uint32_t addr, StorageRecordHeader *hdr, const char *key, size_t keyLen) {
+  char buf[STORAGE_MAX_KEY_LEN];
+  if (hdr->keyLen != keyLen) return false;
+  jshFlashRead(buf, addr+4, (uint32_t)keyLen);
+  return memcmp(buf, key, keyLen)==0;
+}
+
+/** Is there a complete record for the same key after endOfRec? Used to spot
+ * superseded records when compacting and listing. */
+static bool storageHasLaterRecord(uint32_t addr, StorageRecordHeader *hdr, uint32_t searchFrom) {
+  char key[STORAGE_MAX_KEY_LEN];
+  jshFlashRead(key, addr+4, hdr->keyLen);
+  uint32_t a = searchFrom;
+  StorageRecordHeader h;
+  while (storageReadRecord(a, storageAppend, &h)) {
+    if (!(h.flags & STORAGE_FLAG_WRITTEN) &&
+        storageRecordMatches(a, &h, key, hdr->keyLen))
+      return true;
+    a += storageRecordSize(&h);
+  }
+  return false;
+}
+
+/// Word-at-a-time streaming writer, so we can write byte data to word-write-only flash
+typedef struct {
+  uint32_t addr;
+  uint32_t word;
+  unsigned int bytes;
+} StorageWriter;
+
+static void storageWriterStart(StorageWriter *sw, uint32_t addr) {
+  sw->addr = addr;
+  sw->word = 0xFFFFFFFF;
+  sw->bytes = 0;
+}
+static void storageWriterByte(StorageWriter *sw, unsigned char b) {
+  sw->word = (sw->word & ~(0xFFU << (8*sw->bytes))) | ((uint32_t)b << (8*sw->bytes));
+  if (++sw->bytes == 4) {
+    jshFlashWrite(&sw->word, sw->addr, 4);
+    sw->addr += 4;
+    sw->word = 0xFFFFFFFF;
+    sw->bytes = 0;
+  }
+}
+static void storageWriterFlush(StorageWriter *sw) {
+  if (sw->bytes)
+    jshFlashWrite(&sw->word, sw->addr, 4); // unused bytes stay 0xFF
+}
+
+/// Erase the given page and make it the empty active log (seq already decided)
+static void storageFormatPage(int page, uint32_t seq) {
+  jshFlashErasePage(storagePage[page]);
+  StoragePageHeader ph;
+  ph.magic = STORAGE_MAGIC;
+  ph.seq = seq;
+  jshFlashWrite(&ph, storagePage[page], sizeof(StoragePageHeader));
+  storageActive = page;
+  storageSeq = seq;
+  storageAppend = storagePage[page] + sizeof(StoragePageHeader);
+}
+
+/** Find flash for the store and work out which page is active and where the
+ * log ends. Idempotent - returns false (with an exception) if there's no
+ * suitable flash on this board. */
+static bool storageMount() {
+  if (storageMounted) return true;
+
+  // find STORAGE_PAGES consecutive free pages
+  JsVar *freeList = jshFlashGetFree();
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, freeList);
+  while (jsvObjectIteratorHasValue(&it) && !storagePageSize) {
+    JsVar *area = jsvObjectIteratorGetValue(&it);
+    uint32_t areaStart = (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(area, "addr", 0));
+    uint32_t areaEnd = areaStart + (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(area, "length", 0));
+    jsvUnLock(area);
+    uint32_t pageStart, pageLen;
+    if (jshFlashGetPage(areaStart, &pageStart, &pageLen)) {
+      if (pageStart < areaStart) pageStart += pageLen; // align up to a page boundary
+      if (pageStart + STORAGE_PAGES*pageLen <= areaEnd) {
+        int i;
+        for (i=0;i<STORAGE_PAGES;i++)
+          storagePage[i] = pageStart + (uint32_t)i*pageLen;
+        storagePageSize = pageLen;
+      }
+    }
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(freeList);
+  if (!storagePageSize) {
+    jsExceptionHere(JSET_ERROR, "No free flash available for storage");
+    return false;
+  }
+  storageMounted = true;
+
+  // the valid page with the highest sequence number is the log - any other
+  // valid page is left over from an interrupted compaction
+  int i, active = -1;
+  uint32_t bestSeq = 0;
+  for (i=0;i<STORAGE_PAGES;i++) {
+    StoragePageHeader ph;
+    jshFlashRead(&ph, storagePage[i], sizeof(StoragePageHeader));
+    if (ph.magic==STORAGE_MAGIC && (active<0 || ph.seq>bestSeq)) {
+      active = i;
+      bestSeq = ph.seq;
+    }
+  }
+  if (active<0) {
+    storageFormatPage(0, 1); // nothing here yet
+    return true;
+  }
+  for (i=0;i<STORAGE_PAGES;i++) {
+    if (i==active) continue;
+    StoragePageHeader ph;
+    jshFlashRead(&ph, storagePage[i], sizeof(StoragePageHeader));
+    if (ph.magic==STORAGE_MAGIC)
+      jshFlashErasePage(storagePage[i]); // stale copy - finish the interrupted compaction
+  }
+  storageActive = active;
+  storageSeq = bestSeq;
+  // walk the log to find where to append
+  uint32_t pageEnd = storagePage[active] + storagePageSize;
+  uint32_t addr = storagePage[active] + sizeof(StoragePageHeader);
+  StorageRecordHeader hdr;
+  while (storageReadRecord(addr, pageEnd, &hdr))
+    addr += storageRecordSize(&hdr);
+  if (addr+4 <= pageEnd) {
+    uint32_t word;
+    jshFlashRead(&word, addr, 4);
+    if (word != 0xFFFFFFFF) addr = pageEnd; // corrupt - force a compaction on the next write
+  }
+  storageAppend = addr;
+  return true;
+}
+
+/// Copy live records to the next page and erase this one
+static void storageCompact() {
+  int dst = (storageActive+1) % STORAGE_PAGES;
+  jshFlashErasePage(storagePage[dst]);
+  uint32_t w = storagePage[dst] + sizeof(StoragePageHeader);
+  uint32_t addr = storagePage[storageActive] + sizeof(StoragePageHeader);
+  StorageRecordHeader hdr;
+  while (storageReadRecord(addr, storageAppend, &hdr)) {
+    uint32_t recSize = storageRecordSize(&hdr);
+    if (!(hdr.flags & STORAGE_FLAG_WRITTEN) && // complete
+        (hdr.flags & STORAGE_FLAG_TOMBSTONE) && // not a deletion
+        !storageHasLaterRecord(addr, &hdr, addr+recSize)) { // latest version
+      // copy the whole record over, word by word
+      uint32_t i;
+      for (i=0;i<recSize;i+=4) {
+        uint32_t word;
+        jshFlashRead(&word, addr+i, 4);
+        jshFlashWrite(&word, w, 4);
+        w += 4;
+      }
+    }
+    addr += recSize;
+  }
+  // the new page only becomes valid now - a reset before this leaves the old page in charge
+  StoragePageHeader ph;
+  ph.magic = STORAGE_MAGIC;
+  ph.seq = storageSeq+1;
+  jshFlashWrite(&ph, storagePage[dst], sizeof(StoragePageHeader));
+  jshFlashErasePage(storagePage[storageActive]);
+  storageActive = dst;
+  storageSeq = ph.seq;
+  storageAppend = w;
+}
+
+/// Get the key out of a JsVar, checking it's sane. Returns length, 0 on error (with exception)
+static size_t storageGetKey(JsVar *key, char *keyBuf) {
+  if (!jsvIsString(key)) {
+    jsExceptionHere(JSET_ERROR, "Expecting key to be a string, got %t", key);
+    return 0;
+  }
+  size_t l = jsvGetStringLength(key);
+  if (l==0 || l>STORAGE_MAX_KEY_LEN) {
+    jsExceptionHere(JSET_ERROR, "Key must be 1..%d characters", STORAGE_MAX_KEY_LEN);
+    return 0;
+  }
+  jsvGetString(key, keyBuf, STORAGE_MAX_KEY_LEN+1);
+  return l;
+}
+
+/// Find the latest record for a key - returns its address, or 0 if it was never written
+static uint32_t storageFindLatest(const char *key, size_t keyLen, StorageRecordHeader *outHdr) {
+  uint32_t addr = storagePage[storageActive] + sizeof(StoragePageHeader);
+  uint32_t found = 0;
+  StorageRecordHeader hdr;
+  while (storageReadRecord(addr, storageAppend, &hdr)) {
+    if (!(hdr.flags & STORAGE_FLAG_WRITTEN) &&
+        storageRecordMatches(addr, &hdr, key, keyLen)) {
+      found = addr;
+      *outHdr = hdr;
+    }
+    addr += storageRecordSize(&hdr);
+  }
+  return found;
+}
+
+/// Append a record to the log, compacting first if it doesn't fit
+static bool storageAppendRecord(const char *key, size_t keyLen, JsVar *data, bool tombstone) {
+  uint32_t dataLen = data ? (uint32_t)jsvGetStringLength(data) : 0;
+  if (dataLen > 0xFFFF) {
+    jsExceptionHere(JSET_ERROR, "Data too long");
+    return false;
+  }
+  uint32_t recSize = 4 + STORAGE_PAD4((uint32_t)keyLen + dataLen);
+  uint32_t pageEnd = storagePage[storageActive] + storagePageSize;
+  if (storageAppend + recSize > pageEnd) {
+    storageCompact();
+    pageEnd = storagePage[storageActive] + storagePageSize;
+    if (storageAppend + recSize > pageEnd) {
+      jsExceptionHere(JSET_ERROR, "Not enough free storage space");
+      return false;
+    }
+  }
+  StorageRecordHeader hdr;
+  hdr.keyLen = (unsigned char)keyLen;
+  hdr.flags = 0xFF; // STORAGE_FLAG_WRITTEN still set - not complete yet
+  hdr.dataLen = (unsigned short)dataLen;
+  jshFlashWrite(&hdr, storageAppend, 4);
+  StorageWriter sw;
+  storageWriterStart(&sw, storageAppend+4);
+  size_t i;
+  for (i=0;i<keyLen;i++)
+    storageWriterByte(&sw, (unsigned char)key[i]);
+  if (data) {
+    JsvStringIterator sit;
+    jsvStringIteratorNew(&sit, data, 0);
+    while (jsvStringIteratorHasChar(&sit)) {
+      storageWriterByte(&sw, (unsigned char)jsvStringIteratorGetChar(&sit));
+      jsvStringIteratorNext(&sit);
+    }
+    jsvStringIteratorFree(&sit);
+  }
+  storageWriterFlush(&sw);
+  // rewrite the header with the 'written' bit (and maybe the tombstone bit) cleared
+  hdr.flags = (unsigned char)(0xFF & ~STORAGE_FLAG_WRITTEN);
+  if (tombstone) hdr.flags = (unsigned char)(hdr.flags & ~STORAGE_FLAG_TOMBSTONE);
+  jshFlashWrite(&hdr, storageAppend, 4);
+  storageAppend += recSize;
+  return true;
+}
+
+/*JSON{
+  "type" : "library",
+  "class" : "Storage",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+This module implements a simple key-value store in a small area of flash
+memory, for persisting things like counters, calibration or telemetry
+checkpoints that change far too often for `save()`.
+
+Writes are appended to a log, so writing a value usually costs a few word
+writes and no page erase - the slow (and wearing) page erase only happens
+once a whole page of writes has accumulated, and rotates between pages so
+no one page wears out first. This means a value can be rewritten thousands
+of times a day without stalling JavaScript or wearing a hole in the flash.
+
+The store uses a few pages of the free flash area reported by
+`Flash.getFree()` - don't write to that area directly if you're using this
+module.
+
+```
+var storage = require("Storage");
+storage.write("count", "42");
+print(storage.read("count")); // "42"
+```
+*/
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "read",
+  "generate" : "jswrap_storage_read",
+  "params" : [
+    ["key","JsVar","The name of the value to read"]
+  ],
+  "return" : ["JsVar","A string of data, or `undefined`"]
+}
+Read a value from storage. Returns `undefined` if the key was never
+written (or has been erased).
+*/
+JsVar *jswrap_storage_read(JsVar *key) {
+  char keyBuf[STORAGE_MAX_KEY_LEN+1];
+  size_t keyLen = storageGetKey(key, keyBuf);
+  if (!keyLen || !storageMount()) return 0;
+  StorageRecordHeader hdr;
+  uint32_t addr = storageFindLatest(keyBuf, keyLen, &hdr);
+  if (!addr || !(hdr.flags & STORAGE_FLAG_TOMBSTONE)) return 0; // never written, or deleted
+  JsVar *v = jsvNewFlatStringOfLength(hdr.dataLen);
+  if (!v) return 0; // out of memory
+  if (hdr.dataLen)
+    jshFlashRead(jsvGetFlatStringPointer(v), addr+4+hdr.keyLen, hdr.dataLen);
+  return v;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "write",
+  "generate" : "jswrap_storage_write",
+  "params" : [
+    ["key","JsVar","The name of the value to write (1..24 characters)"],
+    ["data","JsVar","The data to write - it is converted to a string"]
+  ],
+  "return" : ["bool","True on success"]
+}
+Write a value to storage, replacing any previous value with that key.
+*/
+bool jswrap_storage_write(JsVar *key, JsVar *data) {
+  char keyBuf[STORAGE_MAX_KEY_LEN+1];
+  size_t keyLen = storageGetKey(key, keyBuf);
+  if (!keyLen || !storageMount()) return false;
+  JsVar *dataStr = jsvAsString(data, false);
+  if (!dataStr) return false;
+  bool ok = storageAppendRecord(keyBuf, keyLen, dataStr, false);
+  jsvUnLock(dataStr);
+  return ok;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "erase",
+  "generate" : "jswrap_storage_erase",
+  "params" : [
+    ["key","JsVar","The name of the value to erase"]
+  ]
+}
+Erase a single value from storage.
+*/
+void jswrap_storage_erase(JsVar *key) {
+  char keyBuf[STORAGE_MAX_KEY_LEN+1];
+  size_t keyLen = storageGetKey(key, keyBuf);
+  if (!keyLen || !storageMount()) return;
+  StorageRecordHeader hdr;
+  uint32_t addr = storageFindLatest(keyBuf, keyLen, &hdr);
+  if (!addr || !(hdr.flags & STORAGE_FLAG_TOMBSTONE)) return; // nothing to erase
+  storageAppendRecord(keyBuf, keyLen, 0, true);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "eraseAll",
+  "generate" : "jswrap_storage_eraseAll"
+}
+Erase the entire key-value store.
+*/
+void jswrap_storage_eraseAll() {
+  if (!storageMount()) return;
+  int i;
+  for (i=1;i<STORAGE_PAGES;i++)
+    jshFlashErasePage(storagePage[i]);
+  storageFormatPage(0, 1);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "list",
+  "generate" : "jswrap_storage_list",
+  "return" : ["JsVar","An array of the names of all stored values"]
+}
+List the names of all values currently in storage.
+*/
+JsVar *jswrap_storage_list() {
+  if (!storageMount()) return 0;
+  JsVar *arr = jsvNewEmptyArray();
+  if (!arr) return 0;
+  uint32_t addr = storagePage[storageActive] + sizeof(StoragePageHeader);
+  StorageRecordHeader hdr;
+  while (storageReadRecord(addr, storageAppend, &hdr)) {
+    uint32_t recSize = storageRecordSize(&hdr);
+    if (!(hdr.flags & STORAGE_FLAG_WRITTEN) &&
+        (hdr.flags & STORAGE_FLAG_TOMBSTONE) &&
+        !storageHasLaterRecord(addr, &hdr, addr+recSize)) {
+      char keyBuf[STORAGE_MAX_KEY_LEN];
+      jshFlashRead(keyBuf, addr+4, hdr.keyLen);
+      jsvArrayPushAndUnLock(arr, jsvNewStringOfLength(hdr.keyLen, keyBuf));
+    }
+    addr += recSize;
+  }
+  return arr;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "getFree",
+  "generate" : "jswrap_storage_getFree",
+  "return" : ["int","The number of bytes free in the append log"]
+}
+Return how many bytes can be written before the next (automatic)
+compaction. `compact()` may free more space than this suggests if values
+have been rewritten or erased.
+*/
+int jswrap_storage_getFree() {
+  if (!storageMount()) return 0;
+  return (int)(storagePage[storageActive] + storagePageSize - storageAppend);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "compact",
+  "generate" : "jswrap_storage_compact"
+}
+Copy all current values to a fresh page and erase the old one, reclaiming
+the space used by rewritten and erased values. This happens automatically
+when the log fills up - call it yourself if you'd rather take the page
+erase stall at a convenient moment.
+*/
+void jswrap_storage_compact() {
+  if (!storageMount()) return;
+  storageCompact();
+}
+
+#endif // SAVE_ON_FLASH
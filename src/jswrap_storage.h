@@ -0,0 +1,22 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Log-structured key-value store in flash memory
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_storage_read(JsVar *key);
+bool jswrap_storage_write(JsVar *key, JsVar *data);
+void jswrap_storage_erase(JsVar *key);
+void jswrap_storage_eraseAll();
+JsVar *jswrap_storage_list();
+int jswrap_storage_getFree();
+void jswrap_storage_compact();
@@ -104,6 +104,14 @@ JsVar *jswrap_string_charAt(JsVar *parent, JsVarInt idx) {
   // We do this so we can handle '/0' in a string
   JsVar *r = jsvNewFromEmptyString();
   if (r && jsvIsString(parent) && idx>=0) {
+    // if the string is contiguous, index it directly - no iterator needed
+    size_t len;
+    char *data = jsvGetDataPointer(parent, &len);
+    if (data) {
+      if ((size_t)idx < len)
+        jsvAppendStringBuf(r, &data[idx], 1);
+      return r;
+    }
     JsvStringIterator it;
     jsvStringIteratorNew(&it, parent, (size_t)idx);
     if (jsvStringIteratorHasChar(&it)) {
@@ -160,9 +168,80 @@ Return the index of substring in this string, or -1 if not found
 }
 Return the last index of substring in this string, or -1 if not found
  */
+/** Forward substring search. When the haystack is contiguous in memory we
+ * use Boyer-Moore-Horspool (or memchr for 1-2 char needles); otherwise we
+ * memchr each string block for the first character and only then compare,
+ * so we're not paying the iterator overhead on every single character. */
+static int _jswrap_string_search(JsVar *parent, JsVar *substring, int startIdx, int parentLength, int subStringLength) {
+  size_t m = (size_t)subStringLength;
+  int lastPossible = parentLength - subStringLength;
+  char needle[64];
+  if (m <= sizeof(needle)) {
+    jsvGetStringChars(substring, 0, needle, m);
+    size_t hayLen = 0;
+    char *hay = jsvGetDataPointer(parent, &hayLen);
+    if (hay) {
+#ifndef SAVE_ON_FLASH
+      if (m > 2) { // Boyer-Moore-Horspool - skip over chars that can't match
+        unsigned char skip[256];
+        size_t i;
+        memset(skip, (int)m, sizeof(skip));
+        for (i=0;i+1<m;i++)
+          skip[(unsigned char)needle[i]] = (unsigned char)(m-1-i);
+        size_t pos = (size_t)startIdx;
+        while (pos <= (size_t)lastPossible) {
+          unsigned char last = (unsigned char)hay[pos+m-1];
+          if (last==(unsigned char)needle[m-1] && memcmp(&hay[pos], needle, m-1)==0)
+            return (int)pos;
+          pos += skip[last];
+        }
+        return -1;
+      }
+#endif
+      const char *p = &hay[startIdx];
+      const char *end = &hay[lastPossible+1];
+      while (p < end) {
+        const char *found = (const char *)memchr(p, needle[0], (size_t)(end-p));
+        if (!found) return -1;
+        if (m==1 || memcmp(found+1, &needle[1], m-1)==0) return (int)(found-hay);
+        p = found+1;
+      }
+      return -1;
+    }
+  }
+  // haystack is chained blocks (or a huge needle) - memchr each block for
+  // the first character and verify candidates in place
+  char first = jsvGetCharInString(substring, 0);
+  int idx = startIdx;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, parent, (size_t)startIdx);
+  while (idx <= lastPossible && jsvStringIteratorHasChar(&it)) {
+    size_t chunk = jsvStringIteratorGetCharsLeftInBlock(&it);
+    char *ptr = jsvStringIteratorGetPtr(&it);
+    char *found = (char *)memchr(ptr, first, chunk);
+    if (!found) {
+      idx += (int)chunk;
+      jsvStringIteratorSkipInBlock(&it, chunk);
+      continue;
+    }
+    size_t skipped = (size_t)(found-ptr);
+    if (skipped) {
+      idx += (int)skipped;
+      jsvStringIteratorSkipInBlock(&it, skipped);
+    }
+    if (idx <= lastPossible && jsvCompareString(parent, substring, (size_t)idx, 0, true)==0) {
+      jsvStringIteratorFree(&it);
+      return idx;
+    }
+    idx++;
+    jsvStringIteratorSkipInBlock(&it, 1);
+  }
+  jsvStringIteratorFree(&it);
+  return -1;
+}
+
 int jswrap_string_indexOf(JsVar *parent, JsVar *substring, JsVar *fromIndex, bool lastIndexOf) {
   if (!jsvIsString(parent)) return 0;
-  // slow, but simple!
   substring = jsvAsString(substring, false);
   if (!substring) return 0; // out of memory
   int parentLength = (int)jsvGetStringLength(parent);
@@ -193,6 +272,12 @@ int jswrap_string_indexOf(JsVar *parent, JsVar *substring, JsVar *fromIndex, boo
     }
   }
 
+  if (!lastIndexOf && subStringLength>0) {
+    int found = _jswrap_string_search(parent, substring, idx, parentLength, subStringLength);
+    jsvUnLock(substring);
+    return found;
+  }
+  // lastIndexOf (and the empty substring): slow, but simple!
   for (;idx!=end;idx+=dir) {
     if (jsvCompareString(parent, substring, (size_t)idx, 0, true)==0) {
       jsvUnLock(substring);
@@ -448,22 +533,25 @@ JsVar *jswrap_string_split(JsVar *parent, JsVar *split) {
 
   int idx, last = 0;
   int splitlen = jsvIsUndefined(split) ? 0 : (int)jsvGetStringLength(split);
-  int l = (int)jsvGetStringLength(parent) + 1 - splitlen;
-
-  for (idx=0;idx<=l;idx++) {
-    if (splitlen==0 && idx==0) continue; // special case for where split string is ""
-    if (idx==l || splitlen==0 || jsvCompareString(parent, split, (size_t)idx, 0, true)==0) {
-      if (idx==l) {
-        idx=l+splitlen; // if the last element, do to the end of the string
-        if (splitlen==0) break;
-      }
+  int l = (int)jsvGetStringLength(parent);
 
-      JsVar *part = jsvNewFromStringVar(parent, (size_t)last, (size_t)(idx-last));
-      if (!part) break; // out of memory
-      jsvArrayPush(array, part);
-      jsvUnLock(part);
-      last = idx+splitlen;
-    }
+  if (splitlen==0) {
+    // special case for where split string is "" - one element per character
+    for (idx=0;idx<l;idx++)
+      jsvArrayPushAndUnLock(array, jsvNewFromStringVar(parent, (size_t)idx, 1));
+    jsvUnLock(split);
+    return array;
+  }
+  // find each separator with the fast search rather than comparing at every position
+  for (;;) {
+    idx = (splitlen<=l) ? _jswrap_string_search(parent, split, last, l, splitlen) : -1;
+    JsVar *part = jsvNewFromStringVar(parent, (size_t)last,
+        (idx<0) ? JSVAPPENDSTRINGVAR_MAXLENGTH : (size_t)(idx-last));
+    if (!part) break; // out of memory
+    jsvArrayPush(array, part);
+    jsvUnLock(part);
+    if (idx<0) break;
+    last = idx+splitlen;
   }
   jsvUnLock(split);
   return array;
@@ -24,6 +24,42 @@
 
 #ifndef SAVE_ON_FLASH
 
+/* One Waveform at a time may be armed to start from a pin watch (the
+ * 'trigger' option). The timer task is built in the main thread, so the
+ * IRQ below only has to stamp a start time on it and queue it - no JsVar
+ * access, no JS latency, and the leading edge of a transient is kept. */
+static UtilTimerTask waveformTriggerTask;
+static volatile IOEventFlags waveformTriggerChannel = EV_NONE;
+
+/// Runs in the EXTI IRQ - start the prepared capture right now
+static void jswrap_waveform_triggerIRQ(bool state, IOEventFlags flags) {
+  NOT_USED(flags);
+  IOEventFlags channel = waveformTriggerChannel;
+  if (channel == EV_NONE) return;
+  waveformTriggerChannel = EV_NONE; // one-shot
+  jshSetEventCallback(channel, 0);
+  JsSysTime time = jshGetSystemTime();
+  jstStartPreparedTask(&waveformTriggerTask, time);
+  // queue the edge as a normal watch event so any setWatch on the pin
+  // still gets its JS callback (after the capture has started)
+  jshPushIOEvent(channel | (state?EV_EXTI_IS_HIGH:0), time);
+}
+
+/// Disarm a pending trigger (if any). Returns true if it hadn't fired yet
+static bool jswrap_waveform_disarmTrigger(Pin trigPin, bool removeWatch) {
+  jshInterruptOff();
+  IOEventFlags channel = waveformTriggerChannel;
+  if (channel != EV_NONE) {
+    waveformTriggerChannel = EV_NONE;
+    jshSetEventCallback(channel, 0);
+  }
+  jshInterruptOn();
+  // don't pull the pin watch away from an active setWatch
+  if (removeWatch && !jsiIsWatchingPin(trigPin))
+    jshPinWatch(trigPin, false);
+  return channel != EV_NONE;
+}
+
 /*JSON{
   "type" : "class",
   "ifndef" : "SAVE_ON_FLASH",
@@ -61,7 +97,55 @@ bool jswrap_waveform_idle() {
       JsVar *waveform = jsvObjectIteratorGetValue(&it);
 
       bool running = jsvGetBoolAndUnLock(jsvObjectGetChild(waveform, "running", 0));
+#ifdef JSH_HAS_ANALOG_CAPTURE
+      if (running && jsvGetBoolAndUnLock(jsvObjectGetChild(waveform, "hw", 0))) {
+        // hardware capture - the ADC's DMA fills the buffers itself, we just
+        // report them. 'filled' may be >1 if the idle loop was held up.
+        int filled = jshAnalogCaptureCompleted();
+        if (filled) {
+          if (!jsvGetBoolAndUnLock(jsvObjectGetChild(waveform, "repeat", 0))) {
+            jshAnalogCaptureStop();
+            jsvObjectRemoveChild(waveform, "hw");
+            JsVar *arrayBuffer = jsvObjectGetChild(waveform, "buffer", 0);
+            jsiQueueObjectCallbacks(waveform, JS_EVENT_PREFIX"finish", &arrayBuffer, 1);
+            jsvUnLock(arrayBuffer);
+            running = false;
+            jsvObjectSetChildAndUnLock(waveform, "running", jsvNewFromBool(running));
+          } else {
+            JsVar *buffer2 = jsvObjectGetChild(waveform, "buffer2", 0);
+            if (buffer2) {
+              // double-buffered - work out which buffer the ADC moved on to,
+              // and hand over the one it just finished
+              int currentBuffer = (jsvGetIntegerAndUnLock(jsvObjectGetChild(waveform, "currentBuffer", JSV_INTEGER)) + filled) & 1;
+              jsvObjectSetChildAndUnLock(waveform, "currentBuffer", jsvNewFromInteger(currentBuffer));
+              JsVar *arrayBuffer = jsvObjectGetChild(waveform, currentBuffer ? "buffer" : "buffer2", 0);
+              jsiQueueObjectCallbacks(waveform, JS_EVENT_PREFIX"buffer", &arrayBuffer, 1);
+              jsvUnLock(arrayBuffer);
+            }
+            jsvUnLock(buffer2);
+          }
+        }
+      } else
+#endif
       if (running) {
+        bool waitingForTrigger = false;
+        JsVar *trigPinVar = jsvObjectGetChild(waveform, "trigPin", 0);
+        if (trigPinVar) {
+          if (waveformTriggerChannel != EV_NONE) {
+            // still armed - there's no timer task to check on yet
+            waitingForTrigger = true;
+          } else {
+            // the trigger fired - tidy up the watch we added
+            jsvObjectRemoveChild(waveform, "trigPin");
+            jswrap_waveform_disarmTrigger(jshGetPinFromVar(trigPinVar), true);
+          }
+          jsvUnLock(trigPinVar);
+        }
+        if (waitingForTrigger) {
+          jsvUnLock(waveform);
+          jsvObjectIteratorNext(&it);
+          continue;
+        }
         JsVar *buffer = jswrap_waveform_getBuffer(waveform,0,0);
         UtilTimerTask task;
         // Search for a timer task
@@ -116,12 +200,25 @@ void jswrap_waveform_kill() { // be sure to remove all waveforms...
     while (jsvObjectIteratorHasValue(&it)) {
       JsVar *waveform = jsvObjectIteratorGetValue(&it);
       bool running = jsvGetBoolAndUnLock(jsvObjectGetChild(waveform, "running", 0));
+#ifdef JSH_HAS_ANALOG_CAPTURE
+      if (running && jsvGetBoolAndUnLock(jsvObjectGetChild(waveform, "hw", 0))) {
+        jshAnalogCaptureStop();
+      } else
+#endif
       if (running) {
-        JsVar *buffer = jswrap_waveform_getBuffer(waveform,0,0);
-        if (!jstStopBufferTimerTask(buffer)) {
-          jsExceptionHere(JSET_ERROR, "Waveform couldn't be stopped");
+        bool wasPending = false;
+        JsVar *trigPinVar = jsvObjectGetChild(waveform, "trigPin", 0);
+        if (trigPinVar) {
+          wasPending = jswrap_waveform_disarmTrigger(jshGetPinFromVar(trigPinVar), true);
+          jsvUnLock(trigPinVar);
+        }
+        if (!wasPending) {
+          JsVar *buffer = jswrap_waveform_getBuffer(waveform,0,0);
+          if (!jstStopBufferTimerTask(buffer)) {
+            jsExceptionHere(JSET_ERROR, "Waveform couldn't be stopped");
+          }
+          jsvUnLock(buffer);
         }
-        jsvUnLock(buffer);
       }
       jsvUnLock(waveform);
       // if not running, remove waveform from this list
@@ -140,40 +237,63 @@ void jswrap_waveform_kill() { // be sure to remove all waveforms...
   "ifndef" : "SAVE_ON_FLASH",
   "generate" : "jswrap_waveform_constructor",
   "params" : [
-    ["samples","int32","The number of samples"],
-    ["options","JsVar","Optional options struct `{doubleBuffer:bool, bits : 8/16}` where: `doubleBuffer` is whether to allocate two buffers or not (default false), and bits is the amount of bits to use (default 8)."]
+    ["samples","JsVar","The number of samples, or an ArrayBuffer/Typed Array to use as the buffer directly"],
+    ["options","JsVar","Optional options struct `{doubleBuffer:bool, bits : 8/16, buffer2 : ArrayBuffer}` where: `doubleBuffer` is whether to allocate two buffers or not (default false), bits is the amount of bits to use (default 8), and `buffer2` is an ArrayBuffer to use as the second buffer (implies double-buffering)."]
   ],
   "return" : ["JsVar","An Waveform object"]
 }
 Create a waveform class. This allows high speed input and output of waveforms. It has an internal variable called `buffer` (as well as `buffer2` when double-buffered - see `options` below) which contains the data to input/output.
 
-When double-buffered, a 'buffer' event will be emitted each time a buffer is finished with (the argument is that buffer). When the recording stops, a 'finish' event will be emitted (with the first argument as the buffer).
+Instead of a sample count you can supply an ArrayBuffer (or Typed Array) of data, which will be used as `buffer` without copying. A second ArrayBuffer of the same length can be supplied as `buffer2` in `options`, in which case the Waveform is double-buffered using your buffers.
+
+When double-buffered, a 'buffer' event will be emitted each time a buffer is finished with (the argument is that buffer) - fill it to keep output (with `repeat:true`) streaming seamlessly, as the timer interrupt switches straight to the other buffer. When the recording stops, a 'finish' event will be emitted (with the first argument as the buffer).
  */
-JsVar *jswrap_waveform_constructor(int samples, JsVar *options) {
+JsVar *jswrap_waveform_constructor(JsVar *samplesVar, JsVar *options) {
+  JsVar *arrayBuffer = 0, *arrayBuffer2 = 0;
+  int samples;
+  if (jsvIsArrayBuffer(samplesVar)) {
+    // use the supplied buffer directly (no copy)
+    arrayBuffer = jsvLockAgain(samplesVar);
+    samples = (int)jsvGetArrayBufferLength(arrayBuffer);
+  } else
+    samples = (int)jsvGetInteger(samplesVar);
   if (samples<=0) {
     jsExceptionHere(JSET_ERROR, "Samples must be greater than 0");
+    jsvUnLock(arrayBuffer);
     return 0;
   }
 
   bool doubleBuffer = false;
   bool use16bit = false;
+  if (arrayBuffer && JSV_ARRAYBUFFER_GET_SIZE(arrayBuffer->varData.arraybuffer.type)==2)
+    use16bit = true;
   if (jsvIsObject(options)) {
     doubleBuffer = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "doubleBuffer", 0));
 
     int bits = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "bits", 0));
     if (bits!=0 && bits!=8 && bits!=16) {
       jsExceptionHere(JSET_ERROR, "Invalid number of bits");
+      jsvUnLock(arrayBuffer);
       return 0;
     } else if (bits==16) use16bit = true;
 
+    arrayBuffer2 = jsvObjectGetChild(options, "buffer2", 0);
+    if (arrayBuffer2) {
+      if (!jsvIsArrayBuffer(arrayBuffer2) ||
+          (int)jsvGetArrayBufferLength(arrayBuffer2)!=samples) {
+        jsExceptionHere(JSET_ERROR, "buffer2 must be an ArrayBuffer with the same number of samples");
+        jsvUnLock2(arrayBuffer, arrayBuffer2);
+        return 0;
+      }
+      doubleBuffer = true;
+    }
   } else if (!jsvIsUndefined(options)) {
     jsExceptionHere(JSET_ERROR, "Expecting options to be undefined or an Object, not %t", options);
   }
 
   JsVarDataArrayBufferViewType bufferType = use16bit ? ARRAYBUFFERVIEW_UINT16 : ARRAYBUFFERVIEW_UINT8;
-  JsVar *arrayBuffer = jsvNewTypedArray(bufferType, samples);
-  JsVar *arrayBuffer2 = 0;
-  if (doubleBuffer) arrayBuffer2 = jsvNewTypedArray(bufferType, samples);
+  if (!arrayBuffer) arrayBuffer = jsvNewTypedArray(bufferType, samples);
+  if (doubleBuffer && !arrayBuffer2) arrayBuffer2 = jsvNewTypedArray(bufferType, samples);
   JsVar *waveform = jspNewObject(0, "Waveform");
 
 
@@ -204,11 +324,21 @@ static void jswrap_waveform_start(JsVar *waveform, Pin pin, JsVarFloat freq, JsV
 
   JsSysTime startTime = jshGetSystemTime();
   bool repeat = false;
+  Pin triggerPin = PIN_UNDEFINED;
   if (jsvIsObject(options)) {
     JsVarFloat t = jsvGetFloatAndUnLock(jsvObjectGetChild(options, "time", 0));
     if (isfinite(t) && t>0)
       startTime = jshGetTimeFromMilliseconds(t*1000);
     repeat = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "repeat", 0));
+    JsVar *trigVar = jsvObjectGetChild(options, "trigger", 0);
+    if (trigVar) {
+      triggerPin = jshGetPinFromVar(trigVar);
+      jsvUnLock(trigVar);
+      if (!jshIsPinValid(triggerPin)) {
+        jsExceptionHere(JSET_ERROR, "Invalid trigger pin");
+        return;
+      }
+    }
   } else if (!jsvIsUndefined(options)) {
     jsExceptionHere(JSET_ERROR, "Expecting options to be undefined or an Object, not %t", options);
   }
@@ -225,6 +355,65 @@ static void jswrap_waveform_start(JsVar *waveform, Pin pin, JsVarFloat freq, JsV
     eventType = isWriting ? UET_WRITE_BYTE : UET_READ_BYTE;
   }
 
+  if (jshIsPinValid(triggerPin)) {
+    /* Triggered start - build the timer task now, arm a watch on the
+     * trigger pin, and let the IRQ queue the task when the edge arrives */
+    if (waveformTriggerChannel != EV_NONE) {
+      jsExceptionHere(JSET_ERROR, "Another Waveform is already waiting for a trigger");
+      jsvUnLock2(buffer,buffer2);
+      return;
+    }
+    if (!jstBuildSignalTask(jshGetTimeFromMilliseconds(1000.0 / freq), pin, buffer, repeat?(buffer2?buffer2:buffer):0, eventType, &waveformTriggerTask)) {
+      jsWarn("Unable to schedule a timer");
+      jsvUnLock2(buffer,buffer2);
+      return;
+    }
+    IOEventFlags channel = jshPinWatch(triggerPin, true);
+    jsvUnLock2(buffer,buffer2);
+    if (channel == EV_NONE) {
+      jsExceptionHere(JSET_ERROR, "Unable to watch trigger pin");
+      return;
+    }
+    jsvObjectSetChildAndUnLock(waveform, "trigPin", jsvNewFromPin(triggerPin));
+    jsvObjectSetChildAndUnLock(waveform, "running", jsvNewFromBool(true));
+    jsvObjectSetChildAndUnLock(waveform, "freq", jsvNewFromFloat(freq));
+    // Add to our list of active waveforms
+    JsVar *waveforms = jsvObjectGetChild(execInfo.hiddenRoot, JSI_WAVEFORM_NAME, JSV_ARRAY);
+    if (waveforms) {
+      jsvArrayPush(waveforms, waveform);
+      jsvUnLock(waveforms);
+    }
+    // set the callback last - once it is set the IRQ can fire at any moment
+    waveformTriggerChannel = channel;
+    jshSetEventCallback(channel, jswrap_waveform_triggerIRQ);
+    return;
+  }
+
+#ifdef JSH_HAS_ANALOG_CAPTURE
+  if (!isWriting && is16Bit) {
+    /* Try hardware (DMA) capture first - soft sampling from the utility
+     * timer tops out at a few kHz, the ADC itself doesn't. Only possible
+     * when the buffers are flat blocks of memory. */
+    size_t len0 = 0, len1 = 0;
+    unsigned char *buf0 = (unsigned char*)jsvGetDataPointer(buffer, &len0);
+    unsigned char *buf1 = buffer2 ? (unsigned char*)jsvGetDataPointer(buffer2, &len1) : 0;
+    if (buf0 && (!buffer2 || (buf1 && len1==len0)) &&
+        jshAnalogCaptureStart(pin, buf0, buf1, (unsigned int)(len0>>1), (unsigned int)freq)) {
+      jsvUnLock2(buffer,buffer2);
+      jsvObjectSetChildAndUnLock(waveform, "hw", jsvNewFromBool(true));
+      if (repeat) jsvObjectSetChildAndUnLock(waveform, "repeat", jsvNewFromBool(true));
+      jsvObjectSetChildAndUnLock(waveform, "running", jsvNewFromBool(true));
+      jsvObjectSetChildAndUnLock(waveform, "freq", jsvNewFromFloat(freq));
+      // Add to our list of active waveforms
+      JsVar *waveforms = jsvObjectGetChild(execInfo.hiddenRoot, JSI_WAVEFORM_NAME, JSV_ARRAY);
+      if (waveforms) {
+        jsvArrayPush(waveforms, waveform);
+        jsvUnLock(waveforms);
+      }
+      return;
+    }
+  }
+#endif
 
   // And finally set it up
   if (!jstStartSignal(startTime, jshGetTimeFromMilliseconds(1000.0 / freq), pin, buffer, repeat?(buffer2?buffer2:buffer):0, eventType))
@@ -250,7 +439,7 @@ static void jswrap_waveform_start(JsVar *waveform, Pin pin, JsVarFloat freq, JsV
   "params" : [
     ["output","pin","The pin to output on"],
     ["freq","float","The frequency to output each sample at"],
-    ["options","JsVar","Optional options struct `{time:float,repeat:bool}` where: `time` is the that the waveform with start output at, e.g. `getTime()+1` (otherwise it is immediate), `repeat` is a boolean specifying whether to repeat the give sample"]
+    ["options","JsVar","Optional options struct `{time:float,repeat:bool,trigger:pin}` where: `time` is the that the waveform with start output at, e.g. `getTime()+1` (otherwise it is immediate), `repeat` is a boolean specifying whether to repeat the give sample, `trigger` is a pin to start from (see `startInput`)"]
   ]
 }
 Will start outputting the waveform on the given pin - the pin must have previously been initialised with analogWrite. If not repeating, it'll emit a `finish` event when it is done.
@@ -268,10 +457,25 @@ void jswrap_waveform_startOutput(JsVar *waveform, Pin pin, JsVarFloat freq, JsVa
   "params" : [
     ["output","pin","The pin to output on"],
     ["freq","float","The frequency to output each sample at"],
-    ["options","JsVar","Optional options struct `{time:float,repeat:bool}` where: `time` is the that the waveform with start output at, e.g. `getTime()+1` (otherwise it is immediate), `repeat` is a boolean specifying whether to repeat the give sample"]
+    ["options","JsVar","Optional options struct `{time:float,repeat:bool,trigger:pin}` where: `time` is the that the waveform with start output at, e.g. `getTime()+1` (otherwise it is immediate), `repeat` is a boolean specifying whether to repeat the give sample, `trigger` is a pin to start capture from"]
   ]
 }
 Will start inputting the waveform on the given pin that supports analog. If not repeating, it'll emit a `finish` event when it is done.
+
+If a `trigger` pin is given, nothing happens until that pin changes state:
+the capture is then started directly from the pin's interrupt, so the first
+sample is taken microseconds after the edge rather than after the
+milliseconds a JS `setWatch` callback would add - ideal for catching the
+leading edge of a transient. The `time` option is ignored, only one
+Waveform may wait for a trigger at a time, and any `setWatch` on the
+trigger pin still fires (just after the capture has started).
+
+On devices with a DMA-capable ADC (nRF52), a 16 bit Waveform is captured by
+the ADC hardware itself, so high sample rates (50kHz+) work without losing
+samples - use `doubleBuffer:true` and the `buffer` event to stream
+continuously. Samples are then at the ADC's native resolution rather than
+scaled to 16 bits, and the `time` option is ignored (capture starts
+immediately).
  */
 void jswrap_waveform_startInput(JsVar *waveform, Pin pin, JsVarFloat freq, JsVar *options) {
   // Setup analog, and also bail out on failure
@@ -295,6 +499,31 @@ void jswrap_waveform_stop(JsVar *waveform) {
     jsExceptionHere(JSET_ERROR, "Waveform is not running");
     return;
   }
+#ifdef JSH_HAS_ANALOG_CAPTURE
+  if (jsvGetBoolAndUnLock(jsvObjectGetChild(waveform, "hw", 0))) {
+    jshAnalogCaptureStop();
+    jsvObjectRemoveChild(waveform, "hw");
+    JsVar *arrayBuffer = jsvObjectGetChild(waveform, "buffer", 0);
+    jsiQueueObjectCallbacks(waveform, JS_EVENT_PREFIX"finish", &arrayBuffer, 1);
+    jsvUnLock(arrayBuffer);
+    jsvObjectSetChildAndUnLock(waveform, "running", jsvNewFromBool(false));
+    return; // the idle loop drops it from the active list
+  }
+#endif
+  JsVar *trigPinVar = jsvObjectGetChild(waveform, "trigPin", 0);
+  if (trigPinVar) {
+    jsvObjectRemoveChild(waveform, "trigPin");
+    bool wasPending = jswrap_waveform_disarmTrigger(jshGetPinFromVar(trigPinVar), true);
+    jsvUnLock(trigPinVar);
+    if (wasPending) {
+      // never triggered, so there's no timer task - just finish up here
+      jsvObjectSetChildAndUnLock(waveform, "running", jsvNewFromBool(false));
+      JsVar *arrayBuffer = jsvObjectGetChild(waveform, "buffer", 0);
+      jsiQueueObjectCallbacks(waveform, JS_EVENT_PREFIX"finish", &arrayBuffer, 1);
+      jsvUnLock(arrayBuffer);
+      return; // the idle loop drops it from the active list
+    }
+  }
   JsVar *buffer = jswrap_waveform_getBuffer(waveform,0,0);
   if (!jstStopBufferTimerTask(buffer)) {
     jsExceptionHere(JSET_ERROR, "Waveform couldn't be stopped");
@@ -15,7 +15,7 @@
 
 bool jswrap_waveform_idle();
 void jswrap_waveform_kill();
-JsVar *jswrap_waveform_constructor(int samples, JsVar *options);
+JsVar *jswrap_waveform_constructor(JsVar *samplesVar, JsVar *options);
 void jswrap_waveform_startOutput(JsVar *waveform, Pin pin, JsVarFloat freq, JsVar *options);
 void jswrap_waveform_startInput(JsVar *waveform, Pin pin, JsVarFloat freq, JsVar *options);
 void jswrap_waveform_stop(JsVar *waveform);
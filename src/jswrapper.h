@@ -77,11 +77,17 @@ typedef struct {
 typedef struct {
   const JswSymPtr *symbols;
   const char *symbolChars;
+  const unsigned char *hashBuckets; ///< 17 entries - symbols whose name hashes to h are [hashBuckets[h],hashBuckets[h+1])
   unsigned char symbolCount;
 } PACKED_JSW_SYM JswSymList;
 
-/// Do a binary search of the symbol table list
-JsVar *jswBinarySearch(const JswSymList *symbolsPtr, JsVar *parent, const char *name);
+/// Look a name up in the symbol table list via its hash buckets
+JsVar *jswSymLookup(const JswSymList *symbolsPtr, JsVar *parent, const char *name);
+
+/** Call a native function. Argument specifiers used by the symbol tables get
+ * a directly-cast call generated by build_jswrapper.py; anything else falls
+ * back to jsnCallFunction's generic argument marshaling. */
+JsVar *jswCallFunction(void *function, JsnArgumentType argumentSpecifier, JsVar *thisParam, JsVar **paramData, int paramCount);
 
 /** If 'name' is something that belongs to an internal function, execute it.  */
 JsVar *jswFindBuiltInFunction(JsVar *parent, const char *name);
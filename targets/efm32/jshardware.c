@@ -476,6 +476,12 @@ void jshPinSetValue(Pin pin, bool value) {
   }
 }
 
+void jshPinSetValues(int count, Pin *pins, JsVarInt value) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 bool jshPinGetValue(Pin pin) {
   return GPIO_PinInGet(efm32PortFromPin(pin),
                        pinInfo[pin].pin);
@@ -919,6 +925,12 @@ void jshFlashWrite(void * buf, uint32_t addr, uint32_t len)
   NVMHAL_DeInit();
 }
 
+// Flash is memory-mapped at address 0, so flash addresses are directly readable
+size_t jshFlashGetMemMapAddress(uint32_t addr)
+{
+  return (size_t)addr;
+}
+
 /// Enter simple sleep mode (can be woken up by interrupts). Returns true on success
 bool jshSleep(JsSysTime timeUntilWake) {
 #ifdef USE_RTC
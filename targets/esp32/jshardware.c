@@ -48,9 +48,12 @@
 #include "rom/uart.h"
 #include "driver/gpio.h"
 #include "soc/gpio_sig_map.h"
+#include "hwcrypto/aes.h" // hardware AES/SHA engines, for jshAES/jshSHA
+#include "hwcrypto/sha.h"
 
 #include "jshardwareI2c.h"
 #include "jshardwareSpi.h"
+#include "rtosutil.h" // espruinoIrqMux
 
 #define FLASH_MAX (4*1024*1024) //4MB
 #define FLASH_PAGE_SHIFT 12 // Shift is much faster than division by 4096 (size of page)
@@ -177,12 +180,17 @@ int jshGetSerialNumber(unsigned char *data, int maxChars) {
   return 6;
 }
 
-void jshInterruptOff() { 
-  taskDISABLE_INTERRUPTS();
+/* With the interpreter pinned to one core and the console/serial and
+ * network tasks on the other, disabling interrupts on the current core
+ * no longer protects the IO buffer and utility timer queue - take a
+ * cross-core spinlock as well (recursive on the same core, so nested
+ * jshInterruptOff calls are fine). */
+void jshInterruptOff() {
+  portENTER_CRITICAL(&espruinoIrqMux);
 }
 
 void jshInterruptOn()  {
-  taskENABLE_INTERRUPTS();
+  portEXIT_CRITICAL(&espruinoIrqMux);
 }
 
 /// Are we currently in an interrupt?
@@ -300,6 +308,19 @@ void jshPinSetValue(
 }
 
 
+/**
+ * Set the value of several pins at once, pins[0] being the most significant bit of value.
+ */
+void jshPinSetValues(
+    int count,     //!< The number of pins to set.
+    Pin *pins,     //!< The pins to have their values changed.
+    JsVarInt value //!< The new values of the pins, one bit per pin.
+  ) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 /**
  * Get the value of the corresponding pin.
  * \return The current value of the pin.
@@ -673,6 +694,16 @@ void jshFlashWrite(
   spi_flash_write(addr, buf, len);
 }
 
+/**
+ * Flash is only visible through the cache's partition mappings, not linearly,
+ * so we can't hand out a direct pointer to it.
+ */
+size_t jshFlashGetMemMapAddress(
+    uint32_t addr  //!< Flash address
+  ) {
+  return 0;
+}
+
 
 /**
  * Return start address and size of the flash page the given address resides in.
@@ -723,6 +754,47 @@ unsigned int jshSetSystemClock(JsVar *options) {
   return 0;
 }
 
+bool jshAES(JshAESMode mode, bool encrypt, const unsigned char *key, unsigned int keyBits, unsigned char iv[16], const unsigned char *input, unsigned char *output, size_t len) {
+  if (keyBits!=128 && keyBits!=192 && keyBits!=256)
+    return false; // let software mbedTLS report the bad key
+  esp_aes_context aes;
+  esp_aes_init(&aes);
+  esp_aes_setkey(&aes, key, keyBits);
+  int err = 0;
+  switch (mode) {
+  case JSHAES_ECB: {
+    size_t i;
+    for (i=0;!err && i+15<len;i+=16)
+      err = esp_aes_crypt_ecb(&aes, encrypt ? ESP_AES_ENCRYPT : ESP_AES_DECRYPT, &input[i], &output[i]);
+    break;
+  }
+  case JSHAES_CBC:
+    err = esp_aes_crypt_cbc(&aes, encrypt ? ESP_AES_ENCRYPT : ESP_AES_DECRYPT, len, iv, input, output);
+    break;
+  case JSHAES_CTR: {
+    size_t nc_off = 0;
+    unsigned char stream_block[16];
+    err = esp_aes_crypt_ctr(&aes, len, &nc_off, iv, stream_block, input, output);
+    break;
+  }
+  default:
+    err = -1;
+    break;
+  }
+  esp_aes_free(&aes);
+  return err==0;
+}
+
+bool jshSHA(int shaBits, const unsigned char *data, size_t len, unsigned char *digest) {
+  switch (shaBits) {
+  case 1:   esp_sha(SHA1,     data, len, digest); return true;
+  case 256: esp_sha(SHA2_256, data, len, digest); return true;
+  case 384: esp_sha(SHA2_384, data, len, digest); return true;
+  case 512: esp_sha(SHA2_512, data, len, digest); return true;
+  default: return false; // no SHA224 in the engine - fall back to software
+  }
+}
+
 /**
  * Convert an Espruino pin id to a native ESP32 pin id.
  */
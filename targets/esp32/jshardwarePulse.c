@@ -18,8 +18,11 @@
  
 #include "jshardwarePulse.h"
 #include "driver/rmt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #define RMTPinEmpty 111
 
@@ -49,7 +52,16 @@ void RMTReset(){
 }  
 void RMTInit(){
   int i;
-  for(i = 0; i < RMTChannelMax; i++) RMTChannels[i].pin = RMTPinEmpty;
+  for(i = 0; i < RMTChannelMax; i++) {
+    RMTChannels[i].pin = RMTPinEmpty;
+    RMTChannels[i].mode = RMTModeNone;
+  }
+}
+//give a channel back so it can be reconfigured (eg Tx -> Rx)
+static void releaseRMT(int i){
+  rmt_driver_uninstall(i);
+  RMTChannels[i].pin = RMTPinEmpty;
+  RMTChannels[i].mode = RMTModeNone;
 }
 int RMTInitChannel(Pin pin, bool pulsePolarity){
   rmt_config_t config;
@@ -67,13 +79,36 @@ int RMTInitChannel(Pin pin, bool pulsePolarity){
     config.tx_config.carrier_duty_percent = 50;
     config.tx_config.carrier_freq_hz = 10000;
     config.tx_config.carrier_level = 1;
-    config.clk_div = 80;
+    config.clk_div = 80; //80MHz APB clock / 80 -> 1 tick = 1 microsecond
     rmt_config(&config);
     rmt_driver_install(config.channel, 0, 0);
+    RMTChannels[i].mode = RMTModeTx;
+    RMTChannels[i].idleLevel = pulsePolarity;
     return i;
   }
   else return -1;
-} 
+}
+int RMTInitRxChannel(Pin pin, unsigned int idleThresholdUs){
+  rmt_config_t config;
+  int i = getFreeRMT(pin);
+  if(i >= 0){
+    config.rmt_mode = RMT_MODE_RX;
+    config.channel = i;
+    config.gpio_num = pin;
+    config.mem_block_num = 1;
+    config.clk_div = 80; //1 tick = 1 microsecond, same as Tx
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = 100; //ignore glitches <1.25us (counted in 80MHz ticks)
+    config.rx_config.idle_threshold = idleThresholdUs;
+    rmt_config(&config);
+    rmt_driver_install(config.channel, 1000, 0); //ringbuffer for captured items
+    rmt_set_pin(i, RMT_MODE_RX, pin);
+    RMTChannels[i].mode = RMTModeRx;
+    RMTChannels[i].idleThreshold = idleThresholdUs;
+    return i;
+  }
+  else return -1;
+}
 
 void setPulseLow(int duration){
   items[0].duration0 = duration;
@@ -101,4 +136,71 @@ void sendPulse(Pin pin, bool pulsePolarity, int duration){
   else printf("all RMT channels in use\n");
   return;
 }
+
+int RMTWriteRaw(Pin pin, bool startLevel, bool idleLevel,
+    const unsigned short *durations, unsigned int count){
+  int i = getRMTIndex(pin);
+  if(i >= 0 && (RMTChannels[i].mode != RMTModeTx || RMTChannels[i].idleLevel != idleLevel)){
+    releaseRMT(i);
+    i = -1;
+  }
+  if(i < 0) i = RMTInitChannel(pin, idleLevel);
+  if(i < 0) return -1;
+  //pack pairs of durations into RMT items, alternating the level each time
+  unsigned int itemCount = (count+1)/2;
+  rmt_item32_t *txItems = malloc(itemCount * sizeof(rmt_item32_t));
+  if(!txItems) return -1;
+  unsigned int n;
+  bool level = startLevel;
+  for(n = 0; n < count; n++){
+    if(n&1){
+      txItems[n/2].duration1 = durations[n];
+      txItems[n/2].level1 = level;
+    } else {
+      txItems[n/2].duration0 = durations[n];
+      txItems[n/2].level0 = level;
+    }
+    level = !level;
+  }
+  if(count&1){ //odd number of durations - pad with a zero-length idle slot
+    txItems[count/2].duration1 = 0;
+    txItems[count/2].level1 = idleLevel;
+  }
+  rmt_set_pin(i, RMT_MODE_TX, pin); //in case the pin was reset to GPIO (see jshPinSetValue)
+  rmt_write_items(i, txItems, itemCount, 1); //wait - txItems must stay valid while sending
+  free(txItems);
+  return 0;
+}
+
+int RMTReadRaw(Pin pin, unsigned int idleThresholdUs, unsigned int timeoutMs,
+    unsigned short *durations, unsigned int maxCount){
+  if(idleThresholdUs < 1) idleThresholdUs = 1;
+  if(idleThresholdUs > 65535) idleThresholdUs = 65535;
+  int i = getRMTIndex(pin);
+  if(i >= 0 && (RMTChannels[i].mode != RMTModeRx || RMTChannels[i].idleThreshold != idleThresholdUs)){
+    releaseRMT(i);
+    i = -1;
+  }
+  if(i < 0) i = RMTInitRxChannel(pin, idleThresholdUs);
+  if(i < 0) return -1;
+  RingbufHandle_t rb = NULL;
+  rmt_get_ringbuf_handler(i, &rb);
+  rmt_rx_start(i, true);
+  unsigned int n = 0;
+  TickType_t waitTicks = timeoutMs / portTICK_PERIOD_MS;
+  while(n < maxCount){
+    size_t rxSize = 0;
+    rmt_item32_t *rxItems = (rmt_item32_t *)xRingbufferReceive(rb, &rxSize, waitTicks);
+    if(!rxItems) break; //nothing (more) captured before the timeout
+    unsigned int j;
+    for(j = 0; j < rxSize/sizeof(rmt_item32_t); j++){
+      if(rxItems[j].duration0 && n < maxCount) durations[n++] = rxItems[j].duration0;
+      if(rxItems[j].duration1 && n < maxCount) durations[n++] = rxItems[j].duration1;
+    }
+    vRingbufferReturnItem(rb, (void *)rxItems);
+    waitTicks = 2; //got a burst - just mop up anything else already buffered
+  }
+  rmt_rx_stop(i);
+  return (int)n;
+}
 	
\ No newline at end of file
@@ -19,7 +19,16 @@
 
 #define RMTChannelMax 8 //maximum RMT channel
 
-struct RMTChannel{Pin pin;}; //will be extended once we know more about RMT functions for Espruino on ESP32
+#define RMTModeNone 0
+#define RMTModeTx 1
+#define RMTModeRx 2
+
+struct RMTChannel{
+  Pin pin;
+  char mode;                    //!< RMTModeNone/Tx/Rx - what the channel is currently configured for
+  bool idleLevel;               //!< Tx only: level the pin rests at between transmissions
+  unsigned short idleThreshold; //!< Rx only: microseconds of quiet that end a capture
+};
 struct RMTChannel RMTChannels[RMTChannelMax];
 
 void RMTInit();
@@ -28,3 +37,15 @@ void sendPulse(Pin pin,              //!< The pin to be pulsed.
     bool pulsePolarity,   //!< The value to be pulsed into the pin.
     int duration  //!< The duration in microseconds to hold the pin.
 );
+/** Transmit an arbitrary pulse train with the RMT peripheral (no CPU involved).
+ * durations are in microseconds (1..32767), alternating levels starting at
+ * startLevel, with the pin left at idleLevel afterwards. Blocks until sent.
+ * Returns 0 on success, -1 if no RMT channel is free. */
+int RMTWriteRaw(Pin pin, bool startLevel, bool idleLevel,
+    const unsigned short *durations, unsigned int count);
+/** Capture edge durations (microseconds) on a pin with the RMT peripheral.
+ * Waits up to timeoutMs for the first edge, then records until the line has
+ * been quiet for idleThresholdUs (max 65535). Returns the number of durations
+ * stored into the buffer, or -1 if no RMT channel is free. */
+int RMTReadRaw(Pin pin, unsigned int idleThresholdUs, unsigned int timeoutMs,
+    unsigned short *durations, unsigned int maxCount);
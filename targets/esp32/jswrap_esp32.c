@@ -15,6 +15,8 @@
  
 #include "jswrap_esp32.h"
 #include "jshardwareAnalog.h"
+#include "jshardwarePulse.h"
+#include "jsvariterator.h"
 
 #include "esp_system.h"
 #include "app_update/include/esp_ota_ops.h"
@@ -108,3 +110,127 @@ JsVar *jswrap_ESP32_setBoot(JsVar *jsPartitionName) {
   esp_partition_iterator_release(it);  
   return esp32State;
 } // End of jswrap_ESP32_setBoot
+
+/*JSON{
+  "type"     : "staticmethod",
+  "class"    : "ESP32",
+  "name"     : "rmtWrite",
+  "generate" : "jswrap_ESP32_rmtWrite",
+  "params"   : [
+    ["pin", "pin", "Pin to output the pulse train on"],
+    ["durations", "JsVar", "An array of pulse durations in microseconds (eg an Int16Array), alternating levels"],
+    ["options", "JsVar", "Optional `{ start : bool, idle : bool }`"]
+  ]
+}
+Output an arbitrary pulse train on a pin using the RMT peripheral - the
+waveform is clocked out by hardware with no CPU involvement, so the timing
+is exact no matter what JavaScript is doing. Useful for IR remote control,
+1-wire style protocols, etc.
+
+Each element of `durations` is how long (in microseconds, 1..32767) the pin
+holds one level before flipping to the other. The first duration is output
+at the level given by `start` (default: the opposite of `idle`), and the pin
+is left at `idle` (default low) afterwards. Blocks until the train has been
+sent.
+
+```
+// 38kHz-free raw IR style burst: 9ms mark, 4.5ms space, ...
+ESP32.rmtWrite(D4, [9000,4500,560,560,560,1690]);
+```
+*/
+void jswrap_ESP32_rmtWrite(Pin pin, JsVar *durations, JsVar *options) {
+  if (!jshIsPinValid(pin)) {
+    jsExceptionHere(JSET_ERROR, "Invalid pin!");
+    return;
+  }
+  if (!jsvIsIterable(durations)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting an array of durations, got %t", durations);
+    return;
+  }
+  bool idleLevel = false;
+  bool startLevel, haveStartLevel = false;
+  if (jsvIsObject(options)) {
+    idleLevel = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "idle", 0));
+    JsVar *s = jsvObjectGetChild(options, "start", 0);
+    if (s) {
+      startLevel = jsvGetBoolAndUnLock(s);
+      haveStartLevel = true;
+    }
+  }
+  if (!haveStartLevel) startLevel = !idleLevel;
+  unsigned int count = (unsigned int)jsvGetLength(durations);
+  if (!count) return;
+  if (count > 512) {
+    jsExceptionHere(JSET_ERROR, "Too many durations (max 512)");
+    return;
+  }
+  unsigned short *buf = (unsigned short *)alloca(count * sizeof(unsigned short));
+  unsigned int n = 0;
+  JsvIterator it;
+  jsvIteratorNew(&it, durations, JSIF_EVERY_ARRAY_ELEMENT);
+  while (jsvIteratorHasElement(&it) && n < count) {
+    JsVarInt d = jsvIteratorGetIntegerValue(&it);
+    if (d < 1) d = 1;
+    if (d > 32767) d = 32767;
+    buf[n++] = (unsigned short)d;
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  if (RMTWriteRaw(pin, startLevel, idleLevel, buf, n) < 0)
+    jsExceptionHere(JSET_ERROR, "No free RMT channels");
+}
+
+/*JSON{
+  "type"     : "staticmethod",
+  "class"    : "ESP32",
+  "name"     : "rmtRead",
+  "generate" : "jswrap_ESP32_rmtRead",
+  "params"   : [
+    ["pin", "pin", "Pin to capture edges on"],
+    ["options", "JsVar", "Optional `{ timeout : int, idle : int }`"]
+  ],
+  "return"   : ["JsVar", "A Uint16Array of pulse durations in microseconds, empty if nothing was seen"]
+}
+Capture a pulse train on a pin using the RMT peripheral. The hardware
+timestamps every edge (sub-microsecond glitches are filtered out), so fast
+protocols can be read without the interpreter keeping up.
+
+Waits up to `timeout` milliseconds (default 1000) for the first edge, then
+records until the line has been quiet for `idle` microseconds (default 5000,
+max 65535). Returns the durations of each level in microseconds, in the
+order they happened - at most 256 of them. Blocks while waiting.
+*/
+JsVar *jswrap_ESP32_rmtRead(Pin pin, JsVar *options) {
+  if (!jshIsPinValid(pin)) {
+    jsExceptionHere(JSET_ERROR, "Invalid pin!");
+    return 0;
+  }
+  int timeoutMs = 1000;
+  int idleUs = 5000;
+  if (jsvIsObject(options)) {
+    JsVar *v = jsvObjectGetChild(options, "timeout", 0);
+    if (v) timeoutMs = (int)jsvGetIntegerAndUnLock(v);
+    v = jsvObjectGetChild(options, "idle", 0);
+    if (v) idleUs = (int)jsvGetIntegerAndUnLock(v);
+  }
+  if (timeoutMs < 0) timeoutMs = 0;
+  if (idleUs < 1) idleUs = 1;
+  if (idleUs > 65535) idleUs = 65535;
+  unsigned short buf[256];
+  int n = RMTReadRaw(pin, (unsigned int)idleUs, (unsigned int)timeoutMs, buf, 256);
+  if (n < 0) {
+    jsExceptionHere(JSET_ERROR, "No free RMT channels");
+    return 0;
+  }
+  JsVar *arr = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT16, n);
+  if (!arr) return 0;
+  JsvArrayBufferIterator ait;
+  jsvArrayBufferIteratorNew(&ait, arr, 0);
+  int j;
+  for (j = 0; j < n; j++) {
+    jsvArrayBufferIteratorSetIntegerValue(&ait, buf[j]);
+    jsvArrayBufferIteratorNext(&ait);
+  }
+  jsvArrayBufferIteratorFree(&ait);
+  return arr;
+}
@@ -23,4 +23,6 @@ JsVar *jswrap_ESP32_getState();
 JsVar *jswrap_ESP32_setBoot(JsVar *jsPartitionName);
 void   jswrap_ESP32_reboot();
 void   jswrap_ESP32_setAtten(Pin pin,int atten);
+void   jswrap_ESP32_rmtWrite(Pin pin, JsVar *durations, JsVar *options);
+JsVar *jswrap_ESP32_rmtRead(Pin pin, JsVar *options);
 #endif /* TARGETS_ESP32_JSWRAP_ESP32_H_ */
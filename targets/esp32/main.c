@@ -77,13 +77,19 @@ int app_main(void)
   }
   esp_partition_iterator_release(it);
   
+  /* The WiFi/network stack and its event handling are pinned by the IDF to
+   * core 0 (PRO CPU), so the interpreter gets core 1 (APP CPU) to itself -
+   * JS timer latency then no longer depends on network load. The console
+   * and serial servicing stays on core 0 with the network stack; it only
+   * talks to the interpreter through the IO event buffer, which is made
+   * safe for cross-core producers by the espruinoIrqMux spinlock. */
 #ifdef RTOS
   queues_init();
   tasks_init();
-  task_init(espruinoTask,"EspruinoTask",25000,5,0);
+  task_init(espruinoTask,"EspruinoTask",25000,5,1);
   task_init(uartTask,"ConsoleTask",2200,20,0);
 #else
-  xTaskCreatePinnedToCore(&espruinoTask, "espruinoTask", 25000, NULL, 5, NULL, 0);
+  xTaskCreatePinnedToCore(&espruinoTask, "espruinoTask", 25000, NULL, 5, NULL, 1);
   xTaskCreatePinnedToCore(&uartTask,"uartTask",2200,NULL,20,NULL,0);
 #endif
   return 0;
@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <string.h>
 
+portMUX_TYPE espruinoIrqMux = portMUX_INITIALIZER_UNLOCKED;
+
 // implementation of simple queue oriented commands. see header file for more info.
 void queues_init(){
   int i;
@@ -167,7 +169,11 @@ void IRAM_ATTR espruino_isr(void *para){
     TIMERG0.hw_timer[TIMER_1].update = 1;
     TIMERG0.int_clr_timers.t1 = 1;
   }
+  // the utility timer queue is shared with the interpreter task, which may
+  // be running on the other core - take the cross-core lock while we use it
+  portENTER_CRITICAL_ISR(&espruinoIrqMux);
   jstUtilTimerInterruptHandler();
+  portEXIT_CRITICAL_ISR(&espruinoIrqMux);
 }
 void IRAM_ATTR test_isr(void *para){
   int idx = (int) para;
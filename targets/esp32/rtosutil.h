@@ -19,6 +19,12 @@
 #include "freertos/queue.h"
 #include "freertos/task.h"
 
+// Spinlock guarding Espruino's IRQ-off critical sections. Now that the
+// interpreter task and the console/serial task run on different cores,
+// plain interrupt disabling isn't enough - anything that produces into
+// the shared IO buffer must take this lock (see jshInterruptOff).
+extern portMUX_TYPE espruinoIrqMux;
+
 
 #define queueMax 10 //for queus we use an array of name/handle info. Core RTOS is not very helpful for this
 struct RTOSqueue{ char *name;QueueHandle_t handle;};
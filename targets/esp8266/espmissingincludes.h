@@ -84,6 +84,7 @@ void *pvPortRealloc(void* ptr, size_t size);
 
 void uart_div_modify(int no, unsigned int freq);
 uint32 system_get_time();
+void system_soft_wdt_feed(void);
 int rand(void);
 void ets_bzero(void *s, size_t n);
 void ets_delay_us(int ms);
@@ -509,6 +509,19 @@ void jshPinSetValue(
 }
 
 
+/**
+ * Set the value of several pins at once, pins[0] being the most significant bit of value.
+ */
+void jshPinSetValues(
+    int count,     //!< The number of pins to set.
+    Pin *pins,     //!< The pins to have their values changed.
+    JsVarInt value //!< The new values of the pins, one bit per pin.
+  ) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 /**
  * Get the value of the corresponding pin.
  * \return The current value of the pin.
@@ -620,7 +633,7 @@ void jshEnableWatchDog(JsVarFloat timeout) {
 
 // Kick the watchdog
 void jshKickWatchDog() {
-  os_printf("ESP8266: jshKickWatchDog\n");
+  system_soft_wdt_feed();
 }
 
 
@@ -1304,6 +1317,17 @@ void jshFlashWrite(
       res == SPI_FLASH_RESULT_ERR ? "error" : "timeout");
 }
 
+/**
+ * Return the memory-mapped address of the given flash address. Only the first
+ * megabyte of flash is mapped into the instruction space window at 0x40200000.
+ */
+size_t jshFlashGetMemMapAddress(
+    uint32_t addr  //!< Flash address
+  ) {
+  if (addr >= 0x100000) return 0;
+  return (size_t)(addr + 0x40200000);
+}
+
 
 /**
  * Return start address and size of the flash page the given address resides in.
@@ -16,6 +16,7 @@
  #include <stdio.h>
  #include <unistd.h>
  #include <sys/time.h>
+ #include <sys/mman.h>
 #ifdef __MINGW32__
  #include <conio.h>
 #else//!__MINGW32__
@@ -23,6 +24,10 @@
  #include <termios.h>
  #include <fcntl.h>
 #endif//__MINGW32__
+#ifdef __linux__
+ #include <sys/epoll.h>
+ #include <sys/eventfd.h>
+#endif
  #include <signal.h>
  #include <inttypes.h>
 
@@ -52,6 +57,52 @@
 int ioDevices[EV_DEVICE_MAX+1]; // list of open IO devices (or 0)
 JshPinState gpioState[JSH_PIN_COUNT]; // will be set to UNDEFINED if it isn't exported
 
+#ifdef __linux__
+/* Rather than polling with sleeps, both threads block in epoll: the input
+ * thread on stdin and any open serial/SPI devices, the main thread (in
+ * jshSleep) on an eventfd the input thread pokes whenever it pushes IO
+ * events, plus any sockets libs/network/linux has asked us to watch. Idle
+ * CPU is then near zero and data wakes whoever needs it immediately. */
+static int inputEpollFd = -1;  ///< watched by the input thread: stdin, open ioDevices, inputWakeFd
+static int mainEpollFd = -1;   ///< watched by jshSleep: mainWakeFd, sockets from jshPollWatchFd
+static int inputWakeFd = -1;   ///< eventfd - kicks the input thread (jshUSARTKick)
+static int mainWakeFd = -1;    ///< eventfd - cuts jshSleep short (new IO events/Ctrl-C)
+static int watchedSocketCount = 0; ///< how many sockets are in mainEpollFd
+static bool stdinIsEOF = false;    ///< stdin hit end of file - stop watching it
+
+static void linuxWakeWrite(int fd) {
+  if (fd>=0) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one))) {} // can't do anything on failure anyway
+  }
+}
+static void linuxWakeDrain(int fd) {
+  uint64_t v;
+  if (fd>=0)
+    while (read(fd, &v, sizeof(v))==sizeof(v));
+}
+static bool linuxEpollAdd(int epFd, int fd) {
+  if (epFd<0 || fd<0) return false;
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl(epFd, EPOLL_CTL_ADD, fd, &ev)==0;
+}
+
+/** Watch a socket so data arriving on it wakes jshSleep (called from
+ * libs/network/linux). Pair with jshPollUnwatchFd before closing it. */
+void jshPollWatchFd(int fd) {
+  if (linuxEpollAdd(mainEpollFd, fd))
+    watchedSocketCount++;
+}
+void jshPollUnwatchFd(int fd) {
+  if (mainEpollFd<0 || fd<0) return;
+  if (!epoll_ctl(mainEpollFd, EPOLL_CTL_DEL, fd, NULL))
+    watchedSocketCount--;
+}
+#endif//__linux__
+
 #ifdef SYSFS_GPIO_DIR
 
 #include <unistd.h>
@@ -99,22 +150,30 @@ JsVarInt sysfs_read_int(const char *path) {
 #endif
 // ----------------------------------------------------------------------------
 #ifdef USE_WIRINGPI
-void irqEXTI0() { jshPushIOWatchEvent(EV_EXTI0); }
-void irqEXTI1() { jshPushIOWatchEvent(EV_EXTI1); }
-void irqEXTI2() { jshPushIOWatchEvent(EV_EXTI2); }
-void irqEXTI3() { jshPushIOWatchEvent(EV_EXTI3); }
-void irqEXTI4() { jshPushIOWatchEvent(EV_EXTI4); }
-void irqEXTI5() { jshPushIOWatchEvent(EV_EXTI5); }
-void irqEXTI6() { jshPushIOWatchEvent(EV_EXTI6); }
-void irqEXTI7() { jshPushIOWatchEvent(EV_EXTI7); }
-void irqEXTI8() { jshPushIOWatchEvent(EV_EXTI8); }
-void irqEXTI9() { jshPushIOWatchEvent(EV_EXTI9); }
-void irqEXTI10() { jshPushIOWatchEvent(EV_EXTI10); }
-void irqEXTI11() { jshPushIOWatchEvent(EV_EXTI11); }
-void irqEXTI12() { jshPushIOWatchEvent(EV_EXTI12); }
-void irqEXTI13() { jshPushIOWatchEvent(EV_EXTI13); }
-void irqEXTI14() { jshPushIOWatchEvent(EV_EXTI14); }
-void irqEXTI15() { jshPushIOWatchEvent(EV_EXTI15); }
+// these run on wiringPi's interrupt threads, so the main thread may be
+// asleep in jshSleep's epoll_wait - wake it up after pushing the event
+static void irqEXTICommon(IOEventFlags exti) {
+  jshPushIOWatchEvent(exti);
+#ifdef __linux__
+  linuxWakeWrite(mainWakeFd);
+#endif
+}
+void irqEXTI0() { irqEXTICommon(EV_EXTI0); }
+void irqEXTI1() { irqEXTICommon(EV_EXTI1); }
+void irqEXTI2() { irqEXTICommon(EV_EXTI2); }
+void irqEXTI3() { irqEXTICommon(EV_EXTI3); }
+void irqEXTI4() { irqEXTICommon(EV_EXTI4); }
+void irqEXTI5() { irqEXTICommon(EV_EXTI5); }
+void irqEXTI6() { irqEXTICommon(EV_EXTI6); }
+void irqEXTI7() { irqEXTICommon(EV_EXTI7); }
+void irqEXTI8() { irqEXTICommon(EV_EXTI8); }
+void irqEXTI9() { irqEXTICommon(EV_EXTI9); }
+void irqEXTI10() { irqEXTICommon(EV_EXTI10); }
+void irqEXTI11() { irqEXTICommon(EV_EXTI11); }
+void irqEXTI12() { irqEXTICommon(EV_EXTI12); }
+void irqEXTI13() { irqEXTICommon(EV_EXTI13); }
+void irqEXTI14() { irqEXTICommon(EV_EXTI14); }
+void irqEXTI15() { irqEXTICommon(EV_EXTI15); }
 void irqEXTIDoNothing() { }
 
 void (*irqEXTIs[16])(void) = {
@@ -225,8 +284,11 @@ int getch()
 {
     int r;
     unsigned char c;
-    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) < 0) {
-        return r;
+    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) <= 0) {
+#ifdef __linux__
+        if (r == 0) stdinIsEOF = true; // end of piped-in input - stop epoll waking us for it
+#endif
+        return -1;
     } else {
         return c;
     }
@@ -244,14 +306,17 @@ void jshInputThread() {
       execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C_WAIT) | EXEC_INTERRUPTED;
     if (execInfo.execute & EXEC_CTRL_C)
       execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C) | EXEC_CTRL_C_WAIT;
+    bool hadInput = false;
     // Read from the console
     while (kbhit()) {
       int ch = getch();
       if (ch<0) break;
       jshPushIOCharEvent(EV_USBSERIAL, (char)ch);
+      hadInput = true;
     }
     // Read from any open devices - if we have space
-    if (jshGetEventsUsed() < IOBUFFERMASK/2) {
+    bool ioBufferBusy = jshGetEventsUsed() >= IOBUFFERMASK/2;
+    if (!ioBufferBusy) {
       int i;
       for (i=0;i<=EV_DEVICE_MAX;i++) {
         if (ioDevices[i]) {
@@ -262,6 +327,7 @@ void jshInputThread() {
             //int j; for (j=0;j<bytes;j++) printf("]] '%c'\r\n", buf[j]);
             jshPushIOCharEvents(i, buf, (unsigned int)bytes);
             shortSleep = true;
+            hadInput = true;
           }
         }
       }
@@ -288,10 +354,48 @@ void jshInputThread() {
         if (state != gpioLastState[pin]) {
           jshPushIOEvent(pinToEVEXTI(pin) | (state?EV_EXTI_IS_HIGH:0), jshGetSystemTime());
           gpioLastState[pin] = state;
+          hadInput = true;
         }
       }
 #endif
 
+#ifdef __linux__
+    // anything we pushed (including a Ctrl-C handled inside
+    // jshPushIOCharEvent) should cut the main thread's jshSleep short
+    if (hadInput)
+      linuxWakeWrite(mainWakeFd);
+    if (inputEpollFd>=0) {
+      if (stdinIsEOF) {
+        epoll_ctl(inputEpollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL); // nothing more is coming
+        stdinIsEOF = false; // don't try to remove it again
+      }
+      if (ioBufferBusy) {
+        /* The event buffer is filling and we skipped reading, so the device
+         * fds may still be hot - epoll would return instantly. Back off and
+         * give the main thread a chance to drain the buffer instead. */
+        usleep(1000);
+      } else {
+        /* Block until there's data, or the main thread kicks us because it
+         * queued something to transmit (jshUSARTKick). A short timeout only
+         * when something genuinely needs polling: promotion of a pending
+         * Ctrl-C to an interrupt, or sysfs GPIO watches (shortSleep). */
+        int timeoutMs = -1;
+        if (execInfo.execute & (EXEC_CTRL_C|EXEC_CTRL_C_WAIT))
+          timeoutMs = 50;
+        if (shortSleep)
+          timeoutMs = 1;
+        struct epoll_event events[4];
+        int n = epoll_wait(inputEpollFd, events, 4, timeoutMs);
+        int e;
+        for (e=0;e<n;e++)
+          if (events[e].data.fd == inputWakeFd)
+            linuxWakeDrain(inputWakeFd);
+      }
+    } else
+#else
+    NOT_USED(hadInput);
+    NOT_USED(ioBufferBusy);
+#endif
     usleep(shortSleep ? 1000 : 50000);
   }
 }
@@ -340,6 +444,16 @@ void jshInit() {
   }
 #endif
 
+#ifdef __linux__
+  inputEpollFd = epoll_create1(0);
+  mainEpollFd = epoll_create1(0);
+  inputWakeFd = eventfd(0, EFD_NONBLOCK);
+  mainWakeFd = eventfd(0, EFD_NONBLOCK);
+  linuxEpollAdd(inputEpollFd, inputWakeFd);
+  linuxEpollAdd(inputEpollFd, STDIN_FILENO);
+  linuxEpollAdd(mainEpollFd, mainWakeFd);
+#endif
+
   isInitialised = true;
   int err = pthread_create(&inputThread, NULL, &jshInputThread, NULL);
   if (err != 0)
@@ -354,6 +468,9 @@ void jshKill() {
   int i;
 
   isInitialised = false;
+#ifdef __linux__
+  linuxWakeWrite(inputWakeFd); // get the input thread out of epoll_wait so it sees we're done
+#endif
 
   for (i=0;i<=EV_DEVICE_MAX;i++)
     if (ioDevices[i]) {
@@ -477,6 +594,12 @@ void jshPinSetValue(Pin pin, bool value) {
 #endif
 }
 
+void jshPinSetValues(int count, Pin *pins, JsVarInt value) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 bool jshPinGetValue(Pin pin) {
 #ifdef SYSFS_GPIO_DIR
   char path[64] = SYSFS_GPIO_DIR"/gpio";
@@ -634,6 +757,9 @@ void jshUSARTSetup(IOEventFlags device, JshUSARTInfo *inf) {
     if (!ioDevices[device]) {
       jsError("Open of path %s failed", path);
     } else {
+#ifdef __linux__
+      linuxEpollAdd(inputEpollFd, ioDevices[device]); // closing the fd unwatches it
+#endif
       struct termios settings;
       tcgetattr(ioDevices[device], &settings); // get current settings
 
@@ -712,7 +838,11 @@ void jshUSARTSetup(IOEventFlags device, JshUSARTInfo *inf) {
  * to set up interrupts */
 void jshUSARTKick(IOEventFlags device) {
   assert(DEVICE_IS_USART(device) || DEVICE_IS_SPI(device));
-  // all done by the idle loop
+#ifdef __linux__
+  // wake the input thread so queued characters go out now, not at the next poll
+  if (ioDevices[device])
+    linuxWakeWrite(inputWakeFd);
+#endif
 }
 
 void jshSPISetup(IOEventFlags device, JshSPIInfo *inf) {
@@ -725,6 +855,9 @@ void jshSPISetup(IOEventFlags device, JshSPIInfo *inf) {
      if (!ioDevices[device]) {
        jsError("Open of path %s failed", path);
      } else {
+#ifdef __linux__
+       linuxEpollAdd(inputEpollFd, ioDevices[device]); // closing the fd unwatches it
+#endif
      }
    } else {
      jsError("No path defined for device");
@@ -779,12 +912,35 @@ bool jshSleep(JsSysTime timeUntilWake) {
  
   JsVarFloat usecfloat = jshGetMillisecondsFromTime(timeUntilWake)*1000;
   unsigned int usecs = (usecfloat < 0xFFFFFFFF) ? (unsigned int)usecfloat : 0xFFFFFFFF;
-  if (hasWatches && usecs>1000) 
+  if (hasWatches && usecs>1000)
     usecs=1000; // don't sleep much if we have watches - we need to keep polling them
+#ifdef __linux__
+  if (mainEpollFd>=0) {
+    /* Block until the input thread pushes IO events our way, a watched
+     * socket has data, or the next timer is due - rather than waking every
+     * 50ms to look. While sockets are open the wait is still capped,
+     * because not everything about them shows up as the fd turning
+     * readable (eg. an outgoing connect completing) and those cases are
+     * polled from the idle loop. */
+    linuxWakeDrain(mainWakeFd);
+    if (jshHasEvents()) return true; // something arrived while we were working
+    if (usecs == 0xFFFFFFFF)
+      usecs = 50000; /* no deadline at all - keep the old slow tick so loops
+                        that poll an exit condition around jsiLoop (eg the
+                        test harness in main.c) still get control back */
+    else if (watchedSocketCount && usecs > 50000)
+      usecs = 50000;
+    if (usecs >= 1000) {
+      struct epoll_event ev;
+      epoll_wait(mainEpollFd, &ev, 1, (int)(usecs/1000));
+    }
+    return true;
+  }
+#endif
   if (usecs > 50000)
     usecs = 50000; // don't want to sleep too much (user input/HTTP/etc)
-  if (usecs >= 1000)  
-    usleep(usecs); 
+  if (usecs >= 1000)
+    usleep(usecs);
   return true;
 }
 
@@ -815,7 +971,7 @@ JsVarFloat jshReadVRef()  { return NAN; };
 unsigned int jshGetRandomNumber() { return rand(); }
 
 bool jshFlashGetPage(uint32_t addr, uint32_t *startAddr, uint32_t *pageSize) {
-  if (addr > (FAKE_FLASH_BLOCKSIZE * FAKE_FLASH_BLOCKS))
+  if (addr >= (FAKE_FLASH_BLOCKSIZE * FAKE_FLASH_BLOCKS))
       return false;
   *startAddr = (uint32_t) (floor(addr / FAKE_FLASH_BLOCKSIZE) * FAKE_FLASH_BLOCKSIZE);
   *pageSize = FAKE_FLASH_BLOCKSIZE;
@@ -885,6 +1041,36 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
   fclose(f);
 }
 
+size_t jshFlashGetMemMapAddress(uint32_t addr) {
+  static char *flashMemMap = 0;
+  if (addr >= FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS) return 0;
+  if (!flashMemMap) {
+    /* Map the fake flash file at a fixed address so that pointers into it
+     * (eg. function code saved as native strings) stay valid from one run
+     * to the next, just as memory-mapped flash would on real hardware. If
+     * the address is taken we report flash as not memory-mapped at all. */
+#if defined(__x86_64__) || defined(__aarch64__)
+    void *hint = (void*)0x5a5a00000000UL;
+#else
+    void *hint = (void*)0x60000000UL;
+#endif
+    FILE *f = jshFlashOpenFile(); // makes sure the file exists and is full-size
+    if (!f) return 0;
+    fclose(f);
+    f = fopen(FAKE_FLASH_FILENAME, "rb"); // a fresh file may have been opened write-only
+    if (!f) return 0;
+    void *map = mmap(hint, FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS, PROT_READ, MAP_SHARED, fileno(f), 0);
+    fclose(f); // the mapping stays around after the file is closed
+    if (map==MAP_FAILED) return 0;
+    if (map!=hint) {
+      munmap(map, FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS);
+      return 0;
+    }
+    flashMemMap = (char*)map;
+  }
+  return (size_t)(flashMemMap + addr);
+}
+
 unsigned int jshSetSystemClock(JsVar *options) {
   return 0;
 }
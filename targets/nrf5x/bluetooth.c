@@ -81,7 +81,12 @@ __ALIGN(4) static ble_gap_lesc_dhkey_t m_lesc_dhkey;   /**< LESC ECC DH Key*/
 // -----------------------------------------------------------------------------------
 
 #if (NRF_SD_BLE_API_VERSION == 3)
-#define NRF_BLE_MAX_MTU_SIZE            GATT_MTU_SIZE_DEFAULT                       /**< MTU size used in the softdevice enabling and to reply to a BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST event. */
+#ifndef NRF_BLE_MAX_MTU_SIZE
+/* MTU size used in the softdevice enabling and to reply to a BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST event.
+ * Boards with enough spare softdevice RAM can define this bigger (eg 64) in their build, which
+ * lets each NUS notification carry NRF_BLE_MAX_MTU_SIZE-3 bytes instead of 20. */
+#define NRF_BLE_MAX_MTU_SIZE            GATT_MTU_SIZE_DEFAULT
+#endif
 #endif
 
 /* We want to listen as much of the time as possible. Not sure if 100/100 is feasible (50/100 is what's used in examples), but it seems to work fine like this. */
@@ -115,6 +120,7 @@ static bool                             m_in_boot_mode = false;
 #endif
 
 volatile uint16_t                       m_conn_handle = BLE_CONN_HANDLE_INVALID;    /**< Handle of the current connection. */
+static volatile uint16_t                nus_max_packet = GATT_MTU_SIZE_DEFAULT-3;   /**< Bytes per NUS notification on the current connection (negotiated ATT MTU minus 3) */
 #if CENTRAL_LINK_COUNT>0
 volatile uint16_t                       m_central_conn_handle = BLE_CONN_HANDLE_INVALID; /**< Handle for central mode connection */
 #endif
@@ -359,28 +365,46 @@ static void nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t lengt
 }
 
 bool nus_transmit_string() {
+  static uint8_t buf[BLE_NUS_MAX_DATA_LEN];
+  static int bufLen = 0; ///< bytes in buf still waiting to be accepted by the softdevice
   if (!jsble_has_simple_connection() ||
       !(bleStatus & BLE_NUS_INITED) ||
       (bleStatus & BLE_IS_SLEEPING)) {
     // If no connection, drain the output buffer
+    bufLen = 0;
     while (jshGetCharToTransmit(EV_BLUETOOTH)>=0);
     return false;
   }
   if (bleStatus & BLE_IS_SENDING) return false;
-  static uint8_t buf[BLE_NUS_MAX_DATA_LEN];
-  int idx = 0;
-  int ch = jshGetCharToTransmit(EV_BLUETOOTH);
-  while (ch>=0) {
-    buf[idx++] = ch;
-    if (idx>=BLE_NUS_MAX_DATA_LEN) break;
-    ch = jshGetCharToTransmit(EV_BLUETOOTH);
-  }
-  if (idx>0) {
-    uint32_t err_code = ble_nus_string_send(&m_nus, buf, idx);
-    if (err_code == NRF_SUCCESS)
-      bleStatus |= BLE_IS_SENDING;
+  bool sent = false;
+  while (true) {
+    if (!bufLen) {
+      // pack up to a full (negotiated MTU sized) notification
+      int ch = jshGetCharToTransmit(EV_BLUETOOTH);
+      while (ch>=0) {
+        buf[bufLen++] = (uint8_t)ch;
+        if (bufLen>=(int)nus_max_packet) break;
+        ch = jshGetCharToTransmit(EV_BLUETOOTH);
+      }
+      if (!bufLen) break; // nothing left to send
+    }
+    uint32_t err_code = ble_nus_string_send(&m_nus, buf, (uint16_t)bufLen);
+    if (err_code == NRF_SUCCESS) {
+      // keep queueing notifications until the softdevice's buffers for this
+      // connection event are full - we get several packets per interval that way
+      bufLen = 0;
+      sent = true;
+    } else {
+      /* TX buffers full - keep this chunk pending (so nothing is lost) and set
+       * BLE_IS_SENDING so we don't retry until BLE_EVT_TX_COMPLETE. Other errors
+       * (eg notifications not enabled yet) just leave the chunk pending for the
+       * next radio notification. */
+      if (err_code == BLE_ERROR_NO_TX_PACKETS)
+        bleStatus |= BLE_IS_SENDING;
+      break;
+    }
   }
-  return idx>0;
+  return sent;
 }
 
 /// Radio Notification handler
@@ -486,6 +510,7 @@ static void on_ble_evt(ble_evt_t * p_ble_evt) {
           if (bleStatus & BLE_IS_RSSI_SCANNING) // attempt to restart RSSI scan
             sd_ble_gap_rssi_start(m_conn_handle, 0, 0);
           bleStatus &= ~BLE_IS_SENDING; // reset state - just in case
+          nus_max_packet = GATT_MTU_SIZE_DEFAULT-3; // until the central negotiates a bigger MTU
 #if BLE_HIDS_ENABLED
           bleStatus &= ~BLE_IS_SENDING_HID;
 #endif
@@ -656,11 +681,17 @@ static void on_ble_evt(ble_evt_t * p_ble_evt) {
       } break; // BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST
 
 #if (NRF_SD_BLE_API_VERSION == 3)
-      case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST:
+      case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST: {
           err_code = sd_ble_gatts_exchange_mtu_reply(p_ble_evt->evt.gatts_evt.conn_handle,
                                                      NRF_BLE_MAX_MTU_SIZE);
           APP_ERROR_CHECK(err_code);
-          break; // BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST
+          // the effective MTU is the lower of ours and the client's - size NUS packets to it
+          uint16_t mtu = p_ble_evt->evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu;
+          if (mtu > NRF_BLE_MAX_MTU_SIZE) mtu = NRF_BLE_MAX_MTU_SIZE;
+          if (mtu < GATT_MTU_SIZE_DEFAULT) mtu = GATT_MTU_SIZE_DEFAULT;
+          if (p_ble_evt->evt.gatts_evt.conn_handle == m_conn_handle)
+            nus_max_packet = mtu-3;
+      } break; // BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST
 #endif
 
 
@@ -1900,6 +1931,23 @@ uint32_t jsble_disconnect(uint16_t conn_handle) {
   return sd_ble_gap_disconnect(conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
 }
 
+/// Set the connection interval (in ms) preferred (and, if connected as a peripheral, requested) for connections
+uint32_t jsble_set_periph_connection_interval(JsVarFloat min, JsVarFloat max) {
+  ble_gap_conn_params_t   gap_conn_params;
+  memset(&gap_conn_params, 0, sizeof(gap_conn_params));
+  gap_conn_params.min_conn_interval = MSEC_TO_UNITS(min, UNIT_1_25_MS);
+  gap_conn_params.max_conn_interval = MSEC_TO_UNITS(max, UNIT_1_25_MS);
+  gap_conn_params.slave_latency     = 0;
+  gap_conn_params.conn_sup_timeout  = MSEC_TO_UNITS(4000, UNIT_10_MS);
+  // set the preferred parameters for any new connection...
+  uint32_t err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
+  if (err_code) return err_code;
+  // ...and if something is connected to us right now, ask it to renegotiate
+  if (m_conn_handle != BLE_CONN_HANDLE_INVALID)
+    err_code = ble_conn_params_change_conn_params(&gap_conn_params);
+  return err_code;
+}
+
 #if BLE_HIDS_ENABLED
 void jsble_send_hid_input_report(uint8_t *data, int length) {
   if (!(bleStatus & BLE_HID_INITED)) {
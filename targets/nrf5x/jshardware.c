@@ -393,6 +393,12 @@ void jshPinSetValue(Pin pin, bool value) {
   nrf_gpio_pin_write((uint32_t)pinInfo[pin].pin, value);
 }
 
+void jshPinSetValues(int count, Pin *pins, JsVarInt value) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 bool jshPinGetValue(Pin pin) {
   bool value = nrf_gpio_pin_read((uint32_t)pinInfo[pin].pin);
   if (pinInfo[pin].port & JSH_PIN_NEGATED) value=!value;
@@ -613,6 +619,104 @@ int jshPinAnalogFast(Pin pin) {
 #endif
 }
 
+#ifdef JSH_HAS_ANALOG_CAPTURE
+/* Hardware analog capture (Waveform.startInput). The SAADC paces itself
+ * with its internal sample timer and writes to RAM with EasyDMA, so sample
+ * timing never depends on the CPU. The IRQ only queues the next buffer
+ * (STARTED fires once the current buffer's address is latched, so there is
+ * a whole buffer's worth of time to do it) and restarts on END. */
+static struct {
+  unsigned char *buf[2];
+  unsigned int samples;
+  volatile int filled; ///< buffers filled since jshAnalogCaptureCompleted
+  volatile int next; ///< buffer index to queue on the next STARTED event
+  bool active;
+} saadcCapture;
+
+bool jshAnalogCaptureStart(Pin pin, unsigned char *buf0, unsigned char *buf1, unsigned int nSamples, unsigned int samplesPerSec) {
+  if (saadcCapture.active) return false; // only one SAADC
+  if (pinInfo[pin].analog == JSH_ANALOG_NONE) return false;
+  // SAADC sample timer: CC in 16MHz ticks, valid range 80..2047 (~7.8kHz to 200kHz)
+  uint32_t cc = 16000000 / samplesPerSec;
+  if (cc < 80 || cc > 2047) return false;
+  if (!nSamples || nSamples > 0x7FFF) return false; // RESULT.MAXCNT is 15 bit
+
+  if (!jshGetPinStateIsManual(pin))
+    jshPinSetState(pin, JSHPINSTATE_ADC_IN);
+  nrf_saadc_input_t ain = 1 + (pinInfo[pin].analog & JSH_MASK_ANALOG_CH);
+
+  nrf_saadc_channel_config_t config;
+  config.acq_time = NRF_SAADC_ACQTIME_3US;
+  config.gain = NRF_SAADC_GAIN1_4; // 1/4 of input volts
+  config.mode = NRF_SAADC_MODE_SINGLE_ENDED;
+  config.pin_p = ain;
+  config.pin_n = ain;
+  config.reference = NRF_SAADC_REFERENCE_VDD4; // VDD/4 as reference.
+  config.resistor_p = NRF_SAADC_RESISTOR_DISABLED;
+  config.resistor_n = NRF_SAADC_RESISTOR_DISABLED;
+
+  nrf_saadc_enable();
+  nrf_saadc_resolution_set(NRF_SAADC_RESOLUTION_14BIT);
+  nrf_saadc_channel_init(0, &config);
+
+  saadcCapture.buf[0] = buf0;
+  saadcCapture.buf[1] = buf1 ? buf1 : buf0; // single buffer just refills
+  saadcCapture.samples = nSamples;
+  saadcCapture.filled = 0;
+  saadcCapture.next = 1;
+  saadcCapture.active = true;
+
+  NRF_SAADC->SAMPLERATE = (SAADC_SAMPLERATE_MODE_Timers << SAADC_SAMPLERATE_MODE_Pos) |
+                          (cc << SAADC_SAMPLERATE_CC_Pos);
+  nrf_saadc_buffer_init((nrf_saadc_value_t*)buf0, nSamples);
+  nrf_saadc_event_clear(NRF_SAADC_EVENT_STARTED);
+  nrf_saadc_event_clear(NRF_SAADC_EVENT_END);
+  nrf_saadc_int_enable(NRF_SAADC_INT_STARTED | NRF_SAADC_INT_END);
+  NVIC_SetPriority(SAADC_IRQn, 6);
+  NVIC_ClearPendingIRQ(SAADC_IRQn);
+  NVIC_EnableIRQ(SAADC_IRQn);
+  nrf_saadc_task_trigger(NRF_SAADC_TASK_START);
+  // in sample-timer mode one SAMPLE task starts continuous sampling
+  nrf_saadc_task_trigger(NRF_SAADC_TASK_SAMPLE);
+  return true;
+}
+
+void jshAnalogCaptureStop() {
+  if (!saadcCapture.active) return;
+  NVIC_DisableIRQ(SAADC_IRQn);
+  nrf_saadc_int_disable(NRF_SAADC_INT_STARTED | NRF_SAADC_INT_END);
+  nrf_saadc_task_trigger(NRF_SAADC_TASK_STOP);
+  while(!nrf_saadc_event_check(NRF_SAADC_EVENT_STOPPED));
+  nrf_saadc_event_clear(NRF_SAADC_EVENT_STOPPED);
+  NRF_SAADC->SAMPLERATE = 0; // back to task-per-sample for jshPinAnalog
+  nrf_saadc_channel_input_set(0, NRF_SAADC_INPUT_DISABLED, NRF_SAADC_INPUT_DISABLED);
+  nrf_saadc_disable();
+  saadcCapture.active = false;
+}
+
+int jshAnalogCaptureCompleted() {
+  jshInterruptOff();
+  int filled = saadcCapture.filled;
+  saadcCapture.filled = 0;
+  jshInterruptOn();
+  return filled;
+}
+
+void SAADC_IRQHandler(void) {
+  if (nrf_saadc_event_check(NRF_SAADC_EVENT_STARTED)) {
+    nrf_saadc_event_clear(NRF_SAADC_EVENT_STARTED);
+    // current buffer address is latched - queue the other one behind it
+    nrf_saadc_buffer_init((nrf_saadc_value_t*)saadcCapture.buf[saadcCapture.next], saadcCapture.samples);
+    saadcCapture.next = 1 - saadcCapture.next;
+  }
+  if (nrf_saadc_event_check(NRF_SAADC_EVENT_END)) {
+    nrf_saadc_event_clear(NRF_SAADC_EVENT_END);
+    saadcCapture.filled++;
+    nrf_saadc_task_trigger(NRF_SAADC_TASK_START); // start filling the queued buffer
+  }
+}
+#endif // JSH_HAS_ANALOG_CAPTURE
+
 JshPinFunction jshGetFreeTimer(JsVarFloat freq) {
   int timer, channel, pin;
   for (timer=0;timer<3;timer++) {
@@ -1177,6 +1281,11 @@ void jshFlashWrite(void * buf, uint32_t addr, uint32_t len) {
   //nrf_nvmc_write_bytes(addr, buf, len);
 }
 
+// Flash is memory-mapped at address 0, so flash addresses are directly readable
+size_t jshFlashGetMemMapAddress(uint32_t addr) {
+  return (size_t)addr;
+}
+
 /// Enter simple sleep mode (can be woken up by interrupts). Returns true on success
 bool jshSleep(JsSysTime timeUntilWake) {
   /* Wake ourselves up if we're supposed to, otherwise if we're not waiting for
@@ -1199,6 +1308,17 @@ bool jshSleep(JsSysTime timeUntilWake) {
     jstSetWakeUp(timeUntilWake);
 #endif
   }
+#ifdef NRF52
+  /* Stop the SysTick interrupt while we sleep. Its only jobs (the delayed
+   * Ctrl-C promotion and the one-second-after-start console swap) matter
+   * while we're executing JS, not while we're idle - and left running it
+   * would wake us 4 times a second even when the RTC compare says nothing
+   * is due for ages. Don't touch it until startup has finished, or if a
+   * Ctrl-C is part-way through being promoted to an interrupt. */
+  bool pauseSysTick = (ticksSinceStart > 5) &&
+      !(execInfo.execute & (EXEC_CTRL_C|EXEC_CTRL_C_WAIT));
+  if (pauseSysTick) SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+#endif
   hadEvent = false;
   jsiSetSleep(JSI_SLEEP_ASLEEP);
   while (!hadEvent) {
@@ -1206,6 +1326,9 @@ bool jshSleep(JsSysTime timeUntilWake) {
     jshGetSystemTime(); // check for RTC overflows
   }
   jsiSetSleep(JSI_SLEEP_AWAKE);
+#ifdef NRF52
+  if (pauseSysTick) SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+#endif
 #ifdef BLUETOOTH
   // we don't care about the return codes...
   app_timer_stop(m_wakeup_timer_id);
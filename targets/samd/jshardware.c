@@ -293,6 +293,11 @@ void jshFlashWrite(void * buf, uint32_t addr, uint32_t len) {
 	flash_lock((uint32_t)addr, (uint32_t)addr + len - 1, 0, 0);
 }
 
+// Flash is memory-mapped at address 0, so flash addresses are directly readable
+size_t jshFlashGetMemMapAddress(uint32_t addr) {
+	return (size_t)addr;
+}
+
 void jshFlashRead(void * buf, uint32_t addr, uint32_t len) {
 //	jsiConsolePrintf("\ntcjshFlashRead addr 0x%x len 0x%x", addr, len);
 	memcpy(buf, (void*)addr, len);
@@ -341,6 +346,12 @@ bool jshIsDeviceInitialised(IOEventFlags device) {
 void jshI2CSetup(IOEventFlags device, JshI2CInfo *inf) {
 }
 
+void jshPinSetValues(int count, Pin *pins, JsVarInt value) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 bool jshPinGetValue(Pin pin) {
 	PIO_Get(mypins[pin][0], PIO_INPUT, mypins[pin][1]);
 }
@@ -865,6 +865,15 @@ void jshPinSetState(Pin pin, JshPinState state) {
   BITFIELD_SET(jshPinOpendrainPullup, pin, state==JSHPINSTATE_GPIO_OUT_OPENDRAIN_PULLUP);
 #endif
 
+  /* If the GPIO registers already describe exactly this state there's nothing
+   * to do - jshPinOutput/jshPinInput/jshPinAnalog call us on every access, so
+   * this turns the usual digitalWrite/analogRead into a couple of register
+   * reads instead of a full GPIO_Init. The hardware is the cache, so it can
+   * never go stale; and jshPinGetState never reports the USART/I2C/DAC
+   * pseudo-states, so those always take the full path below. */
+  if ((jshPinGetState(pin)&JSHPINSTATE_MASK) == state)
+    return;
+
   GPIO_InitTypeDef GPIO_InitStructure;
   bool out = JSHPINSTATE_IS_OUTPUT(state);
   bool af = JSHPINSTATE_IS_AF(state);
@@ -1019,6 +1028,39 @@ bool jshPinGetValue(Pin pin) {
   return GPIO_ReadInputDataBit(stmPort(pin), stmPin(pin)) != 0;
 }
 
+void jshPinSetValues(int count, Pin *pins, JsVarInt value) {
+  int i, j;
+  for (i=0;i<count;i++) {
+    GPIO_TypeDef *port = stmPort(pins[i]);
+    // if an earlier pin shared this port, the whole port has been written already
+    bool written = false;
+    for (j=0;j<i;j++)
+      if (stmPort(pins[j])==port) { written = true; break; }
+    if (written) continue;
+    // gather set/reset bits for every pin on this port, then write them in one go
+    uint32_t set = 0, reset = 0;
+    for (j=i;j<count;j++) {
+      if (stmPort(pins[j])!=port) continue;
+      bool on = (value >> (count-1-j)) & 1;
+#ifdef STM32F1
+      if (BITFIELD_GET(jshPinOpendrainPullup, pins[j])) {
+        jshPinSetValue(pins[j], on); // needs the pin mode hack - can't batch
+        continue;
+      }
+#endif
+      if (on) set |= stmPin(pins[j]);
+      else reset |= stmPin(pins[j]);
+    }
+#if defined(STM32F2) || defined(STM32L1)
+    // these CMSIS headers split BSRR into two 16 bit halves
+    port->BSRRL = (uint16_t)set;
+    port->BSRRH = (uint16_t)reset;
+#else
+    port->BSRR = set | (reset<<16);
+#endif
+  }
+}
+
 // ----------------------------------------------------------------------------
 static void jshResetPeripherals() {
   // Set pin state to analog input - saves some power
@@ -2922,6 +2964,11 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
 #endif
 }
 
+// Internal flash is visible in the CPU's address space at the same addresses we use for it
+size_t jshFlashGetMemMapAddress(uint32_t addr) {
+  return (size_t)addr;
+}
+
 int jshSetSystemClockPClk(JsVar *options, const char *clkName) {
   JsVar *v = jsvObjectGetChild(options, clkName, 0);
   JsVarInt i = jsvGetIntegerAndUnLock(v);
@@ -296,8 +296,15 @@ NO_INLINE static void USART_IRQHandler(USART_TypeDef *USART, IOEventFlags device
   if(USART_GetITStatus(USART, USART_IT_RXNE) != RESET) {
     /* Clear the USART Receive interrupt */
     USART_ClearITPendingBit(USART, USART_IT_RXNE);
-    /* Read one byte from the receive data register */
-    jshPushIOCharEvent(device, (char)USART_ReceiveData(USART));
+    /* Drain everything the UART has for us in one go. At high baud rates
+     * more data can arrive while we're in here, and pushing it as a block
+     * avoids the per-byte event packing cost */
+    char buf[IOEVENT_MAXCHARS];
+    unsigned int n = 0;
+    do {
+      buf[n++] = (char)USART_ReceiveData(USART);
+    } while (n<sizeof(buf) && USART_GetFlagStatus(USART, USART_FLAG_RXNE) != RESET);
+    jshPushIOCharEvents(device, buf, n);
   }
   /* If overrun condition occurs, clear the ORE flag and recover communication */
   if (USART_GetFlagStatus(USART, USART_FLAG_ORE) != RESET) {
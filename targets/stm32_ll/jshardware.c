@@ -1220,6 +1220,12 @@ void jshPinSetValue(Pin pin, bool value){
 }
 ///< Set a digital output to 1 or 0. DOES NOT change pin state OR CHECK PIN VALIDITY
 
+void jshPinSetValues(int count, Pin *pins, JsVarInt value) {
+  int i;
+  for (i=0;i<count;i++)
+    jshPinSetValue(pins[i], (value >> (count-1-i)) & 1);
+}
+
 bool jshPinGetValue(Pin pin){
     return LL_GPIO_IsInputPinSet(stmPort(pin), stmPin(pin)) != 0;
 }
@@ -1979,6 +1985,11 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len){
 
 }
 
+// Internal flash is visible in the CPU's address space at the same addresses we use for it
+size_t jshFlashGetMemMapAddress(uint32_t addr) {
+  return (size_t)addr;
+}
+
 
 /** Utility timer handling functions
  *  ------------------------------------------
@@ -0,0 +1,30 @@
+// Constant subexpressions should be folded when code is tokenised,
+// without changing results, and without touching anything non-constant
+
+E.setFlags({pretokenise:1});
+eval('function f(x) {'+
+     '  var b = "deg" + "C";'+
+     '  var c = x * (3 + 4);'+  // inner (3+4) folds, the rest can't
+     '  var d = -5 * 2;'+
+     '  var e = 1 - 2 + 3;'+    // left assoc, = 2
+     '  var g = x - 1 + 2;'+    // must NOT fold: (x-1)+2
+     '  var h = 1 / 4;'+
+     '  return [b,c,d,e,g,h].join(",");'+
+     '}');
+E.setFlags({pretokenise:0});
+
+var r = f(10);
+var src = f.toString();
+
+var tests = [
+  r == "degC,70,-10,2,11,0.25",
+  f(10) == r, // stable on re-execution
+  src.indexOf('"degC"') >= 0,  // folded to a single literal
+  src.indexOf("(7)") >= 0,
+  src.indexOf("-10") >= 0,
+  src.indexOf("0.25") >= 0,
+  src.indexOf("x-1+2") >= 0    // untouched
+];
+
+var result = tests.every(function(t) { return t; });
+if (!result) console.log(tests, r, src);
@@ -0,0 +1,25 @@
+// E.defrag() should compact fragmented memory so that flat strings
+// (which need contiguous blocks) can be allocated again.
+
+// Fill memory with 4-block strings, then free every other one so free
+// space is plenty but scattered in small runs
+var keep = [];
+while (process.memory().free > 20)
+  keep.push("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+for (var i=0;i<keep.length;i+=2) keep[i]=0;
+
+// build a ~1600 byte normal string in the holes
+var s = "";
+for (var i=0;i<100;i++) s+="0123456789abcdef";
+
+var flatFailedWhenFragmented = E.toString(s)===undefined;
+E.defrag();
+var flat = E.toString(s);
+var flatOKAfterDefrag = flat!==undefined && flat==s;
+
+// everything we kept must have survived being moved around
+var survived = true;
+for (var i=1;i<keep.length;i+=2)
+  if (keep[i]!="xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx") survived = false;
+
+result = flatFailedWhenFragmented && flatOKAfterDefrag && survived;
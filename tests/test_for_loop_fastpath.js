@@ -0,0 +1,43 @@
+// The canonical for(;i<N;i++) shape takes a fast path in jspeStatementFor -
+// make sure it behaves identically when the loop is interfered with
+var r = [];
+
+// loop variable modified in the body
+var s = 0;
+for (var i=0;i<10;i++) { s++; if (i==4) i = 7; }
+r.push(s==7); // i jumps to 7, iterator bumps it to 8
+
+// limit variable modified in the body
+var n = 10, c = 0;
+for (i=0;i<n;i++) { c++; if (i==3) n = 6; }
+r.push(c==6);
+
+// break and continue
+s = 0;
+for (i=0;i<10;i++) { if (i==2) continue; if (i==8) break; s+=i; }
+r.push(s==0+1+3+4+5+6+7 && i==8);
+
+// loop variable becomes a float mid-loop
+s = 0;
+for (i=0;i<5;i++) { s++; if (i==2) i = 2.5; }
+r.push(s==5);
+
+// downward loop, prefix op, <=
+s = 0;
+for (i=5;i>0;--i) s+=i;
+r.push(s==15);
+s = 0;
+for (i=1;i<=5;i++) s+=i;
+r.push(s==15);
+
+// the loop variable is still a real variable - closures see it
+var f;
+for (i=0;i<3;i++) if (i==1) f = function() { return i; };
+r.push(f()==3);
+
+// nested loops sharing fast paths
+s = 0;
+for (i=0;i<4;i++) for (var j=0;j<4;j++) s++;
+r.push(s==16);
+
+result = r.every(function(x){return x;});
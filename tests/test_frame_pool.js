@@ -0,0 +1,37 @@
+// Call frames are pooled and reused between calls (see jspeFunctionCall) -
+// check that reuse is invisible: locals start fresh, closures survive,
+// arguments/recursion/bind all behave as before
+
+function f(a,b){ var x; var ok = (x===undefined); x=a+b; return ok && x===a+b; }
+var t1=true;
+for (var i=0;i<100;i++) t1 = t1 && f(i,1);
+
+// varying argument counts against the same pooled frame
+function g(a){ return arguments.length; }
+var t2 = g(1)===1 && g(1,2,3)===3 && g(1,2)===2 && g(5)===1;
+
+// a captured scope must never be handed back to the pool
+function mk(n){ return function(){ return n; }; }
+var c1=mk(1), c2=mk(2); mk(99); mk(98);
+var t3 = c1()===1 && c2()===2;
+
+// recursion - the pooled frame belongs to the innermost finished call
+function fact(n){ return n<2 ? 1 : n*fact(n-1); }
+var t4 = fact(6)===720 && fact(5)===120;
+
+// named function expressions see their own name each call
+var nf = function inner(n){ return n<=0 ? 0 : n + inner(n-1); };
+var t5 = nf(4)===10 && nf(3)===6;
+
+// unsupplied parameters are undefined again after a call that supplied them
+function h(a,b){ return b===undefined; }
+var t6 = h(1)===true && h(1,2)===false && h(3)===true;
+
+function bf(a,b){ return this.v+a+b; }
+var bb = bf.bind({v:10},1);
+var t7 = bb(2)===13 && bb(5)===16;
+
+var obj = { v:7, m: function(){ return this.v; } };
+var t8 = obj.m()===7 && obj.m()===7;
+
+var result = t1&&t2&&t3&&t4&&t5&&t6&&t7&&t8;
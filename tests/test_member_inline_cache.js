@@ -0,0 +1,21 @@
+// Repeated obj.field accesses go through an inline cache (jspeFactorMember)
+// - make sure it never returns stale results when objects change shape
+function O() { this.a = 1; }
+O.prototype.b = 10;
+
+var o = new O();
+var protoReads = 0, ownReads = 0;
+for (var i=0;i<50;i++) {
+  if (i==25) o.b = 20;  // start shadowing the prototype member mid-loop
+  if (o.b==10) protoReads++;
+  if (o.b==20) ownReads++;
+}
+
+// deleting a field mustn't leave the cache pointing at freed vars
+var sum = 0;
+for (i=0;i<50;i++) {
+  sum += o.a;
+  if (i==25) { delete o.a; o.a = 2; }
+}
+
+result = protoReads==25 && ownReads==25 && sum==25+24*2+1;
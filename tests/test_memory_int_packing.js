@@ -0,0 +1,24 @@
+// Small integer values are packed straight into the parent name
+// (JSV_NAME_INT_INT / JSV_NAME_STRING_INT_0) rather than stored as a
+// separate JsVar, so N small ints in an array/object should cost
+// roughly one JsVar per element - not two.
+
+function used() { return process.memory().usage; }
+
+var base = used();
+var a = [];
+for (var i=0;i<100;i++) a.push(i);
+var arrCost = used()-base;
+
+base = used();
+var o = {};
+for (var i=0;i<100;i++) o["k"+i] = i;
+var objCost = used()-base;
+
+// check the values survived packing intact
+var ok = true;
+for (var i=0;i<100;i++)
+  if (a[i]!==i || o["k"+i]!==i) ok = false;
+
+// unpacked storage would be ~2 vars per element (~200+)
+result = ok && arrCost<150 && objCost<180;
@@ -0,0 +1,31 @@
+// Objects with >32 children get a hidden hash index attached for fast
+// property lookup - make sure it stays invisible and consistent
+
+var o = {};
+var N = 100;
+for (var i=0;i<N;i++) o["key"+i] = i;
+
+var r = [];
+// every property reads back correctly
+var readsOk = true;
+for (var i=0;i<N;i++) if (o["key"+i]!==i) readsOk = false;
+r.push(readsOk);
+// the index mustn't show up in enumeration
+r.push(Object.keys(o).length==N);
+var forInCount = 0;
+for (var k in o) forInCount++;
+r.push(forInCount==N);
+// delete and re-add still works once indexed
+delete o.key50;
+r.push(o.key50===undefined && o.key51===51);
+o.key50 = "back";
+r.push(o.key50==="back");
+// copies of a big object behave independently
+var o2 = {};
+for (var k in o) o2[k] = o[k];
+o2.key60 = "changed";
+r.push(o.key60===60 && o2.key60==="changed");
+r.push(Object.keys(o2).length==N);
+
+var result = 1;
+r.forEach(function(v) { if (v!==true) result = 0; });
@@ -0,0 +1,23 @@
+// E.getOpCounters() returns deterministic operation counts - the same code
+// run from the same heap state must report the same deltas every time,
+// or perf tests can't rely on them
+
+var o = {a:1, b:2, c:3};
+var c1, c2, r;
+
+function cost() {
+  var before = E.getOpCounters();
+  for (var i=0;i<20;i++) o.b;
+  var after = E.getOpCounters();
+  return (after.allocs-before.allocs)+","+
+         (after.childProbes-before.childProbes)+","+
+         (after.tokens-before.tokens);
+}
+
+c1 = cost();
+c2 = cost();
+
+r = E.getOpCounters(true); // reset...
+r = E.getOpCounters();     // ...so the next read starts near zero
+
+result = c1==c2 && c1!="0,0,0" && r.allocs<100 && r.tokens<100;
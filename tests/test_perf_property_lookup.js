@@ -0,0 +1,20 @@
+// Regression guard: property lookup on a small object shouldn't suddenly
+// start allocating or probing much more than it does today. Thresholds are
+// loose so refactors have headroom, but a big regression will trip them.
+
+var o = {a:1, b:2, c:3, d:4, e:5};
+
+// warm up so lazy allocations (hash buckets etc) happen before we measure
+for (var i=0;i<10;i++) o.c;
+
+var before = E.getOpCounters();
+var sum = 0;
+for (var i=0;i<100;i++) sum += o.c;
+var after = E.getOpCounters();
+
+var allocs = after.allocs - before.allocs;
+var probes = after.childProbes - before.childProbes;
+
+result = sum==300 &&
+         allocs <= 1500 && // ~7 per iteration today
+         probes <= 500;    // ~1 per iteration today
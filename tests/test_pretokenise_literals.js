@@ -0,0 +1,15 @@
+// Pretokenised functions store string and integer literals in raw form
+// (LEX_RAW_*) - check values and function.toString() survive the round trip
+E.setFlags({pretokenise:1});
+
+function f(a) {
+  var s = "he\"llo\n" + a;
+  return [s, s.length + 250 + 65000 + 2147483647];
+}
+
+var r = f("!");
+var str = f.toString();
+result = r[0]=="he\"llo\n!" && r[1]==2147548905 &&
+         str.indexOf('he\\"llo\\n')>=0 && // strings get re-escaped when printed
+         str.indexOf("250")>=0 && str.indexOf("65000")>=0 &&
+         str.indexOf("2147483647")>=0;
@@ -0,0 +1,36 @@
+// Variable reads go through an inline cache in jspeFactor - check that
+// scope changes invalidate it correctly
+var x = 1;
+function f() {
+  var r = [];
+  for (var i=0;i<20;i++) {
+    r.push(x);
+    if (i==9) var x = 100; // declared mid-loop, shadows the global from then on
+  }
+  return r;
+}
+var a = f();
+// the var is created when the statement executes, so reads 0..9 see the
+// global and 10..19 see the local
+var early = a.slice(0,10).every(function(v){return v===1;});
+var late = a.slice(10).every(function(v){return v===100;});
+
+// each call frame gets its own locals - recursion mustn't reuse a
+// parent frame's cached slot
+function g(depth) {
+  var local = depth;
+  var below = depth>0 ? g(depth-1) : 0;
+  return local + below;
+}
+var rec = g(4)==10;
+
+// delete + recreate a global read in a loop
+var sum = 0;
+q = 5;
+for (var i=0;i<10;i++) {
+  sum += q;
+  if (i==4) { delete q; q = 50; }
+}
+var del = sum==5*5+50*5;
+
+result = early && late && rec && del;
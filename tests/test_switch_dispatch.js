@@ -0,0 +1,36 @@
+function dec(c) {
+  var r;
+  switch (c) {
+    case 0: r = "zero"; break;
+    case 1: r = "one"; // fall through test
+    case 2: r = (r||"")+"+two"; break;
+    case -3: r = "minusthree"; break;
+    case 100: return "early"; // return from case
+    default: r = "other";
+  }
+  return r;
+}
+var a = [];
+for (var i=0;i<3;i++)  // repeat so cached path is used after first pass
+  a = [dec(0),dec(1),dec(2),dec(-3),dec(100),dec(7),dec("1"),dec(1.5)];
+console.log(a.join("|"));
+var result = a.join("|") == "zero|one+two|+two|minusthree|early|other|other|other";
+
+// switch with no default
+function nd(c) {
+  var r = "none";
+  switch (c) { case 5: r="five"; break; case 6: r="six"; }
+  return r;
+}
+for (i=0;i<3;i++) var b = [nd(5),nd(6),nd(7)].join("|");
+console.log(b);
+result = result && b=="five|six|none";
+
+// non-literal cases must still work (uncacheable)
+function nl(c) {
+  var k = 2;
+  switch (c) { case k: return "k"; case k+1: return "k1"; default: return "d"; }
+}
+for (i=0;i<3;i++) var d = [nl(2),nl(3),nl(4)].join("|");
+console.log(d);
+result = result && d=="k|k1|d";